@@ -0,0 +1,894 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * File System Virtual Channel
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <winpr/crt.h>
+#include <winpr/file.h>
+#include <winpr/synch.h>
+#include <winpr/string.h>
+#include <winpr/sysinfo.h>
+#include <winpr/interlocked.h>
+#include <winpr/collections.h>
+
+#ifdef HAVE_SYS_INOTIFY_H
+#include <unistd.h>
+#include <sys/inotify.h>
+#endif
+
+#include "drive_cache.h"
+#include "drive_file.h"
+
+#ifdef HAVE_SYS_INOTIFY_H
+#define DRIVE_CACHE_WATCH_MASK                                                     \
+	(IN_CREATE | IN_DELETE | IN_MODIFY | IN_ATTRIB | IN_MOVED_FROM | IN_MOVED_TO | \
+	 IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR)
+#endif
+
+typedef struct _DRIVE_CACHE_ATTRIBUTES DRIVE_CACHE_ATTRIBUTES;
+typedef struct _DRIVE_CACHE_FILE DRIVE_CACHE_FILE;
+
+struct _DRIVE_CACHE_ATTRIBUTES
+{
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	UINT64 expires;
+};
+
+/* a file holding data read ahead, registered by drive_cache_watch_file */
+struct _DRIVE_CACHE_FILE
+{
+	UINT64 changed; /* generation of the last invalidation */
+	size_t users;
+};
+
+/**
+ * Keys are UTF-8 full paths as built by drive_file_combine_fullpath, the entries of a listing
+ * are stored under its directory followed by '/' and the entry name.
+ */
+
+struct _DRIVE_CACHE
+{
+	CRITICAL_SECTION lock;
+	wHashTable* attributes; /* path -> DRIVE_CACHE_ATTRIBUTES */
+	wHashTable* listings;   /* search pattern -> DRIVE_CACHE_LISTING */
+	wHashTable* files;      /* path -> DRIVE_CACHE_FILE */
+	UINT64 generation;      /* incremented by each invalidation */
+#ifdef HAVE_SYS_INOTIFY_H
+	int notify;
+	wHashTable* watches;     /* watch descriptor -> directory */
+	wHashTable* directories; /* directory -> watch descriptor */
+#endif
+};
+
+static char* drive_cache_key(const WCHAR* path)
+{
+	char* key = NULL;
+
+	if (ConvertFromUnicode(CP_UTF8, 0, path, -1, &key, 0, NULL, NULL) <= 0)
+		return NULL;
+
+	return key;
+}
+
+static char* drive_cache_join(const char* directory, size_t length, const char* name)
+{
+	const size_t size = length + strlen(name) + 2;
+	char* path = (char*)malloc(size);
+
+	if (!path)
+		return NULL;
+
+	CopyMemory(path, directory, length);
+	path[length] = '/';
+	CopyMemory(&path[length + 1], name, size - length - 1);
+	return path;
+}
+
+/* path is located below directory */
+static BOOL drive_cache_is_below(const char* path, const char* directory, size_t length)
+{
+	return (strncmp(path, directory, length) == 0) && (path[length] == '/');
+}
+
+/* directory is the parent of path */
+static BOOL drive_cache_is_parent(const char* directory, const char* path)
+{
+	const char* slash = strrchr(path, '/');
+
+	if (!slash)
+		return FALSE;
+
+	return (strlen(directory) == (size_t)(slash - path)) &&
+	       (strncmp(directory, path, (size_t)(slash - path)) == 0);
+}
+
+static void drive_cache_string_keys(wHashTable* table)
+{
+	table->hash = HashTable_StringHash;
+	table->keyCompare = HashTable_StringCompare;
+	table->keyClone = HashTable_StringClone;
+	table->keyFree = HashTable_StringFree;
+}
+
+static void drive_cache_listing_free(DRIVE_CACHE_LISTING* listing)
+{
+	size_t i;
+
+	for (i = 0; i < listing->count; i++)
+		free(listing->entries[i].name);
+
+	free(listing->entries);
+	free(listing->directory);
+	free(listing);
+}
+
+void drive_cache_listing_release(DRIVE_CACHE_LISTING* listing)
+{
+	if (listing && (InterlockedDecrement(&listing->refCount) == 0))
+		drive_cache_listing_free(listing);
+}
+
+static void drive_cache_listing_value_free(void* value)
+{
+	drive_cache_listing_release((DRIVE_CACHE_LISTING*)value);
+}
+
+/**
+ * Drops the state cached for path, for everything below it if tree is set and the listings
+ * of the directories containing it. Called with the cache lock held.
+ */
+
+static void drive_cache_invalidate_key(DRIVE_CACHE* cache, const char* key, BOOL tree)
+{
+	int i;
+	int count;
+	ULONG_PTR* keys = NULL;
+	const char* slash = strrchr(key, '/');
+	const size_t length = strlen(key);
+
+	DRIVE_CACHE_FILE* file;
+
+	cache->generation++;
+	HashTable_Remove(cache->attributes, (void*)key);
+
+	if ((file = (DRIVE_CACHE_FILE*)HashTable_GetItemValue(cache->files, (void*)key)))
+		file->changed = cache->generation;
+
+	/* the time stamps of the parent directory change with its entries */
+	if (slash)
+	{
+		char* parent = _strdup(key);
+
+		if (parent)
+		{
+			parent[slash - key] = '\0';
+			HashTable_Remove(cache->attributes, parent);
+			free(parent);
+		}
+	}
+
+	if (tree)
+	{
+		count = HashTable_GetKeys(cache->attributes, &keys);
+
+		for (i = 0; i < count; i++)
+		{
+			if (drive_cache_is_below((const char*)keys[i], key, length))
+				HashTable_Remove(cache->attributes, (void*)keys[i]);
+		}
+
+		free(keys);
+		keys = NULL;
+		count = HashTable_GetKeys(cache->files, &keys);
+
+		for (i = 0; i < count; i++)
+		{
+			if (!drive_cache_is_below((const char*)keys[i], key, length))
+				continue;
+
+			file = (DRIVE_CACHE_FILE*)HashTable_GetItemValue(cache->files, (void*)keys[i]);
+
+			if (file)
+				file->changed = cache->generation;
+		}
+
+		free(keys);
+		keys = NULL;
+	}
+
+	count = HashTable_GetKeys(cache->listings, &keys);
+
+	for (i = 0; i < count; i++)
+	{
+		const DRIVE_CACHE_LISTING* listing =
+		    (const DRIVE_CACHE_LISTING*)HashTable_GetItemValue(cache->listings, (void*)keys[i]);
+
+		if (!listing)
+			continue;
+
+		if (drive_cache_is_parent(listing->directory, key) ||
+		    (strcmp(listing->directory, key) == 0) ||
+		    (tree && drive_cache_is_below(listing->directory, key, length)))
+			HashTable_Remove(cache->listings, (void*)keys[i]);
+	}
+
+	free(keys);
+}
+
+static void drive_cache_clear(DRIVE_CACHE* cache)
+{
+	int i;
+	int count;
+	ULONG_PTR* keys = NULL;
+
+	cache->generation++;
+	HashTable_Clear(cache->attributes);
+	HashTable_Clear(cache->listings);
+	count = HashTable_GetKeys(cache->files, &keys);
+
+	for (i = 0; i < count; i++)
+	{
+		DRIVE_CACHE_FILE* file =
+		    (DRIVE_CACHE_FILE*)HashTable_GetItemValue(cache->files, (void*)keys[i]);
+
+		if (file)
+			file->changed = cache->generation;
+	}
+
+	free(keys);
+}
+
+#ifdef HAVE_SYS_INOTIFY_H
+
+static void drive_cache_watch(DRIVE_CACHE* cache, const char* directory)
+{
+	int wd;
+	char* name;
+
+	if ((cache->notify < 0) || (directory[0] == '\0') ||
+	    HashTable_ContainsKey(cache->directories, (void*)directory) ||
+	    (HashTable_Count(cache->directories) >= DRIVE_CACHE_MAX_WATCHES))
+		return;
+
+	wd = inotify_add_watch(cache->notify, directory, DRIVE_CACHE_WATCH_MASK);
+
+	if (wd < 0)
+		return;
+
+	/* another spelling of an already watched directory, keep reporting the first one */
+	if (HashTable_ContainsKey(cache->watches, (void*)(size_t)wd))
+		return;
+
+	name = _strdup(directory);
+
+	if (!name || (HashTable_Add(cache->watches, (void*)(size_t)wd, name) < 0))
+	{
+		free(name);
+		inotify_rm_watch(cache->notify, wd);
+		return;
+	}
+
+	if (HashTable_Add(cache->directories, (void*)directory, (void*)(size_t)wd) < 0)
+	{
+		HashTable_Remove(cache->watches, (void*)(size_t)wd);
+		inotify_rm_watch(cache->notify, wd);
+	}
+}
+
+static void drive_cache_process_event(DRIVE_CACHE* cache, const struct inotify_event* event)
+{
+	const char* directory;
+
+	if (event->mask & IN_Q_OVERFLOW)
+	{
+		drive_cache_clear(cache);
+		return;
+	}
+
+	directory = (const char*)HashTable_GetItemValue(cache->watches, (void*)(size_t)event->wd);
+
+	if (!directory)
+		return;
+
+	if (event->mask & IN_IGNORED)
+	{
+		/* the watch is gone with the directory */
+		drive_cache_invalidate_key(cache, directory, TRUE);
+		HashTable_Remove(cache->directories, (void*)directory);
+		HashTable_Remove(cache->watches, (void*)(size_t)event->wd);
+	}
+	else if (event->len > 0)
+	{
+		char* path = drive_cache_join(directory, strlen(directory), event->name);
+
+		if (path)
+			drive_cache_invalidate_key(cache, path, (event->mask & IN_ISDIR) ? TRUE : FALSE);
+		else
+			drive_cache_clear(cache);
+
+		free(path);
+	}
+	else
+		drive_cache_invalidate_key(cache, directory,
+		                           (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF)) ? TRUE : FALSE);
+}
+
+#endif
+
+/* applies the changes reported since the last call. Called with the cache lock held. */
+static void drive_cache_process_events(DRIVE_CACHE* cache)
+{
+#ifdef HAVE_SYS_INOTIFY_H
+	union {
+		struct inotify_event event;
+		char data[4096];
+	} buffer;
+
+	if (cache->notify < 0)
+		return;
+
+	for (;;)
+	{
+		size_t offset = 0;
+		const ssize_t length = read(cache->notify, buffer.data, sizeof(buffer.data));
+
+		if (length <= 0)
+			break;
+
+		while (offset + sizeof(struct inotify_event) <= (size_t)length)
+		{
+			const struct inotify_event* event =
+			    (const struct inotify_event*)&buffer.data[offset];
+			offset += sizeof(struct inotify_event) + event->len;
+			drive_cache_process_event(cache, event);
+		}
+	}
+#else
+	WINPR_UNUSED(cache);
+#endif
+}
+
+/* watches the directory containing path, called with the cache lock held */
+static void drive_cache_watch_parent(DRIVE_CACHE* cache, char* path)
+{
+#ifdef HAVE_SYS_INOTIFY_H
+	char* slash = strrchr(path, '/');
+
+	if (!slash)
+		return;
+
+	*slash = '\0';
+	drive_cache_watch(cache, path);
+	*slash = '/';
+#else
+	WINPR_UNUSED(cache);
+	WINPR_UNUSED(path);
+#endif
+}
+
+/* drops expired entries, everything if that does not make room */
+static void drive_cache_purge_attributes(DRIVE_CACHE* cache, UINT64 now)
+{
+	int i;
+	int count;
+	ULONG_PTR* keys = NULL;
+
+	count = HashTable_GetKeys(cache->attributes, &keys);
+
+	for (i = 0; i < count; i++)
+	{
+		const DRIVE_CACHE_ATTRIBUTES* entry = (const DRIVE_CACHE_ATTRIBUTES*)HashTable_GetItemValue(
+		    cache->attributes, (void*)keys[i]);
+
+		if (entry && (entry->expires <= now))
+			HashTable_Remove(cache->attributes, (void*)keys[i]);
+	}
+
+	free(keys);
+
+	if (HashTable_Count(cache->attributes) >= DRIVE_CACHE_MAX_ATTRIBUTES)
+		HashTable_Clear(cache->attributes);
+}
+
+static void drive_cache_put_attributes(DRIVE_CACHE* cache, const char* key,
+                                       const WIN32_FILE_ATTRIBUTE_DATA* data, UINT64 now)
+{
+	DRIVE_CACHE_ATTRIBUTES* entry;
+
+	if ((HashTable_Count(cache->attributes) >= DRIVE_CACHE_MAX_ATTRIBUTES) &&
+	    !HashTable_ContainsKey(cache->attributes, (void*)key))
+		drive_cache_purge_attributes(cache, now);
+
+	entry = (DRIVE_CACHE_ATTRIBUTES*)malloc(sizeof(DRIVE_CACHE_ATTRIBUTES));
+
+	if (!entry)
+		return;
+
+	entry->data = *data;
+	entry->expires = now + DRIVE_CACHE_TTL;
+
+	if (HashTable_Add(cache->attributes, (void*)key, entry) < 0)
+		free(entry);
+}
+
+/**
+ * Returns the attributes of path, from the cache if they were retrieved less than
+ * DRIVE_CACHE_TTL ms ago and no change was reported since.
+ */
+
+BOOL drive_cache_get_attributes(DRIVE_CACHE* cache, const WCHAR* path,
+                                WIN32_FILE_ATTRIBUTE_DATA* data)
+{
+	BOOL rc;
+	char* key;
+	UINT64 now;
+	UINT64 generation;
+	const DRIVE_CACHE_ATTRIBUTES* entry;
+
+	if (!cache || !path || !data || !(key = drive_cache_key(path)))
+		return GetFileAttributesExW(path, GetFileExInfoStandard, data);
+
+	now = GetTickCount64();
+	EnterCriticalSection(&cache->lock);
+	drive_cache_process_events(cache);
+	entry = (const DRIVE_CACHE_ATTRIBUTES*)HashTable_GetItemValue(cache->attributes, key);
+
+	if (entry && (entry->expires > now))
+	{
+		*data = entry->data;
+		LeaveCriticalSection(&cache->lock);
+		free(key);
+		return TRUE;
+	}
+
+	/* watch before reading, a change in between is then reported */
+	drive_cache_watch_parent(cache, key);
+	generation = cache->generation;
+	LeaveCriticalSection(&cache->lock);
+
+	rc = GetFileAttributesExW(path, GetFileExInfoStandard, data);
+
+	if (rc)
+	{
+		EnterCriticalSection(&cache->lock);
+		drive_cache_process_events(cache);
+
+		/* an invalidation while reading may have been for this path */
+		if (generation == cache->generation)
+			drive_cache_put_attributes(cache, key, data, now);
+
+		LeaveCriticalSection(&cache->lock);
+	}
+
+	free(key);
+	return rc;
+}
+
+/* reads the entries matching pattern, fails for directories with too many entries */
+static DRIVE_CACHE_LISTING* drive_cache_list(const WCHAR* pattern, const char* directory,
+                                             size_t length, UINT64 now)
+{
+	HANDLE handle;
+	size_t capacity = 0;
+	WIN32_FIND_DATAW find_data;
+	DRIVE_CACHE_LISTING* listing;
+
+	handle = FindFirstFileW(pattern, &find_data);
+
+	if (handle == INVALID_HANDLE_VALUE)
+		return NULL;
+
+	listing = (DRIVE_CACHE_LISTING*)calloc(1, sizeof(DRIVE_CACHE_LISTING));
+
+	if (!listing)
+		goto fail;
+
+	listing->refCount = 1;
+	listing->expires = now + DRIVE_CACHE_TTL;
+	listing->directory = (char*)calloc(length + 1, sizeof(char));
+
+	if (!listing->directory)
+		goto fail;
+
+	CopyMemory(listing->directory, directory, length);
+
+	do
+	{
+		DRIVE_CACHE_ENTRY* entry;
+
+		if (listing->count == capacity)
+		{
+			DRIVE_CACHE_ENTRY* entries;
+
+			if (capacity >= DRIVE_CACHE_MAX_LISTING_ENTRIES)
+				goto fail;
+
+			capacity = (capacity > 0) ? capacity * 2 : 32;
+			entries = (DRIVE_CACHE_ENTRY*)realloc(listing->entries,
+			                                      capacity * sizeof(DRIVE_CACHE_ENTRY));
+
+			if (!entries)
+				goto fail;
+
+			listing->entries = entries;
+		}
+
+		entry = &listing->entries[listing->count];
+		entry->name = _wcsdup(find_data.cFileName);
+
+		if (!entry->name)
+			goto fail;
+
+		entry->data.dwFileAttributes = find_data.dwFileAttributes;
+		entry->data.ftCreationTime = find_data.ftCreationTime;
+		entry->data.ftLastAccessTime = find_data.ftLastAccessTime;
+		entry->data.ftLastWriteTime = find_data.ftLastWriteTime;
+		entry->data.nFileSizeHigh = find_data.nFileSizeHigh;
+		entry->data.nFileSizeLow = find_data.nFileSizeLow;
+		listing->count++;
+	} while (FindNextFileW(handle, &find_data));
+
+	FindClose(handle);
+	return listing;
+fail:
+	FindClose(handle);
+
+	if (listing)
+		drive_cache_listing_free(listing);
+
+	return NULL;
+}
+
+static size_t drive_cache_listed_entries(DRIVE_CACHE* cache)
+{
+	int i;
+	int count;
+	size_t entries = 0;
+	ULONG_PTR* keys = NULL;
+
+	count = HashTable_GetKeys(cache->listings, &keys);
+
+	for (i = 0; i < count; i++)
+	{
+		const DRIVE_CACHE_LISTING* listing =
+		    (const DRIVE_CACHE_LISTING*)HashTable_GetItemValue(cache->listings, (void*)keys[i]);
+
+		if (listing)
+			entries += listing->count;
+	}
+
+	free(keys);
+	return entries;
+}
+
+/* drops expired listings, everything if that does not make room for entries more */
+static void drive_cache_purge_listings(DRIVE_CACHE* cache, UINT64 now, size_t entries)
+{
+	int i;
+	int count;
+	ULONG_PTR* keys = NULL;
+
+	count = HashTable_GetKeys(cache->listings, &keys);
+
+	for (i = 0; i < count; i++)
+	{
+		const DRIVE_CACHE_LISTING* listing =
+		    (const DRIVE_CACHE_LISTING*)HashTable_GetItemValue(cache->listings, (void*)keys[i]);
+
+		if (listing && (listing->expires <= now))
+			HashTable_Remove(cache->listings, (void*)keys[i]);
+	}
+
+	free(keys);
+
+	if ((HashTable_Count(cache->listings) >= DRIVE_CACHE_MAX_LISTINGS) ||
+	    (drive_cache_listed_entries(cache) + entries > DRIVE_CACHE_MAX_LISTED_ENTRIES))
+		HashTable_Clear(cache->listings);
+}
+
+static void drive_cache_put_listing(DRIVE_CACHE* cache, const char* key,
+                                    DRIVE_CACHE_LISTING* listing, UINT64 now)
+{
+	size_t i;
+	const size_t length = strlen(listing->directory);
+
+	if ((HashTable_Count(cache->listings) >= DRIVE_CACHE_MAX_LISTINGS) ||
+	    (drive_cache_listed_entries(cache) + listing->count > DRIVE_CACHE_MAX_LISTED_ENTRIES))
+		drive_cache_purge_listings(cache, now, listing->count);
+
+	InterlockedIncrement(&listing->refCount);
+
+	if (HashTable_Add(cache->listings, (void*)key, listing) < 0)
+	{
+		InterlockedDecrement(&listing->refCount);
+		return;
+	}
+
+	/* the listing has the attributes of its entries, a query for them usually follows */
+	for (i = 0; i < listing->count; i++)
+	{
+		char* name;
+		char* path;
+		const DRIVE_CACHE_ENTRY* entry = &listing->entries[i];
+
+		if ((entry->name[0] == '.') &&
+		    ((entry->name[1] == '\0') || ((entry->name[1] == '.') && (entry->name[2] == '\0'))))
+			continue;
+
+		if (!(name = drive_cache_key(entry->name)))
+			continue;
+
+		path = drive_cache_join(listing->directory, length, name);
+
+		if (path)
+			drive_cache_put_attributes(cache, path, &entry->data, now);
+
+		free(path);
+		free(name);
+	}
+}
+
+/**
+ * Returns the entries matching pattern with a reference held by the caller, NULL if the search
+ * failed or the directory is too large to be cached. The caller then searches itself.
+ */
+
+DRIVE_CACHE_LISTING* drive_cache_get_listing(DRIVE_CACHE* cache, const WCHAR* pattern)
+{
+	char* key;
+	char* slash;
+	UINT64 now;
+	UINT64 generation;
+	DRIVE_CACHE_LISTING* listing;
+
+	if (!cache || !pattern || !(key = drive_cache_key(pattern)))
+		return NULL;
+
+	if (!(slash = strrchr(key, '/')))
+	{
+		free(key);
+		return NULL;
+	}
+
+	now = GetTickCount64();
+	EnterCriticalSection(&cache->lock);
+	drive_cache_process_events(cache);
+	listing = (DRIVE_CACHE_LISTING*)HashTable_GetItemValue(cache->listings, key);
+
+	if (listing && (listing->expires > now))
+	{
+		InterlockedIncrement(&listing->refCount);
+		LeaveCriticalSection(&cache->lock);
+		free(key);
+		return listing;
+	}
+
+	drive_cache_watch_parent(cache, key);
+	generation = cache->generation;
+	LeaveCriticalSection(&cache->lock);
+
+	listing = drive_cache_list(pattern, key, (size_t)(slash - key), now);
+
+	if (listing)
+	{
+		EnterCriticalSection(&cache->lock);
+		drive_cache_process_events(cache);
+
+		/* still a valid snapshot for the caller, but possibly outdated already */
+		if (generation == cache->generation)
+			drive_cache_put_listing(cache, key, listing, now);
+
+		LeaveCriticalSection(&cache->lock);
+	}
+
+	free(key);
+	return listing;
+}
+
+/**
+ * Called for changes made through the drive, tree for directories that were removed or renamed.
+ */
+
+void drive_cache_invalidate(DRIVE_CACHE* cache, const WCHAR* path, BOOL tree)
+{
+	char* key;
+	DWORD lastError;
+
+	if (!cache || !path)
+		return;
+
+	/* callers report the error of the operation that preceded the invalidation */
+	lastError = GetLastError();
+	key = drive_cache_key(path);
+	EnterCriticalSection(&cache->lock);
+
+	if (key)
+		drive_cache_invalidate_key(cache, key, tree);
+	else
+		drive_cache_clear(cache);
+
+	LeaveCriticalSection(&cache->lock);
+	free(key);
+	SetLastError(lastError);
+}
+
+/**
+ * Registers a file holding data read ahead, changes to path made through any handle of the
+ * drive or reported by the host are then returned by drive_cache_file_changed.
+ */
+
+BOOL drive_cache_watch_file(DRIVE_CACHE* cache, const WCHAR* path)
+{
+	char* key;
+	DRIVE_CACHE_FILE* file;
+	BOOL rc = FALSE;
+
+	if (!cache || !path || !(key = drive_cache_key(path)))
+		return FALSE;
+
+	EnterCriticalSection(&cache->lock);
+	drive_cache_process_events(cache);
+	file = (DRIVE_CACHE_FILE*)HashTable_GetItemValue(cache->files, key);
+
+	if (!file)
+	{
+		if (!(file = (DRIVE_CACHE_FILE*)calloc(1, sizeof(DRIVE_CACHE_FILE))))
+			goto out;
+
+		if (HashTable_Add(cache->files, key, file) < 0)
+		{
+			free(file);
+			goto out;
+		}
+
+		drive_cache_watch_parent(cache, key);
+	}
+
+	file->users++;
+	rc = TRUE;
+out:
+	LeaveCriticalSection(&cache->lock);
+	free(key);
+	return rc;
+}
+
+void drive_cache_unwatch_file(DRIVE_CACHE* cache, const WCHAR* path)
+{
+	char* key;
+	DRIVE_CACHE_FILE* file;
+
+	if (!cache || !path || !(key = drive_cache_key(path)))
+		return;
+
+	EnterCriticalSection(&cache->lock);
+	file = (DRIVE_CACHE_FILE*)HashTable_GetItemValue(cache->files, key);
+
+	if (file && (--file->users == 0))
+		HashTable_Remove(cache->files, key);
+
+	LeaveCriticalSection(&cache->lock);
+	free(key);
+}
+
+/* taken before reading a file, the data read is outdated once drive_cache_file_changed */
+UINT64 drive_cache_generation(DRIVE_CACHE* cache)
+{
+	UINT64 generation;
+
+	if (!cache)
+		return 0;
+
+	EnterCriticalSection(&cache->lock);
+	drive_cache_process_events(cache);
+	generation = cache->generation;
+	LeaveCriticalSection(&cache->lock);
+	return generation;
+}
+
+/* the watched file at path was changed after generation, unknown files count as changed */
+BOOL drive_cache_file_changed(DRIVE_CACHE* cache, const WCHAR* path, UINT64 generation)
+{
+	char* key;
+	const DRIVE_CACHE_FILE* file;
+	BOOL changed = TRUE;
+
+	if (!cache || !path || !(key = drive_cache_key(path)))
+		return TRUE;
+
+	EnterCriticalSection(&cache->lock);
+	drive_cache_process_events(cache);
+	file = (const DRIVE_CACHE_FILE*)HashTable_GetItemValue(cache->files, key);
+
+	if (file)
+		changed = file->changed > generation;
+
+	LeaveCriticalSection(&cache->lock);
+	free(key);
+	return changed;
+}
+
+DRIVE_CACHE* drive_cache_new(void)
+{
+	DRIVE_CACHE* cache = (DRIVE_CACHE*)calloc(1, sizeof(DRIVE_CACHE));
+
+	if (!cache)
+	{
+		WLog_ERR(TAG, "calloc failed!");
+		return NULL;
+	}
+
+	InitializeCriticalSection(&cache->lock);
+#ifdef HAVE_SYS_INOTIFY_H
+	cache->notify = -1;
+#endif
+	cache->attributes = HashTable_New(FALSE);
+	cache->listings = HashTable_New(FALSE);
+	cache->files = HashTable_New(FALSE);
+
+	if (!cache->attributes || !cache->listings || !cache->files)
+		goto fail;
+
+	drive_cache_string_keys(cache->attributes);
+	cache->attributes->valueFree = free;
+	drive_cache_string_keys(cache->listings);
+	cache->listings->valueFree = drive_cache_listing_value_free;
+	drive_cache_string_keys(cache->files);
+	cache->files->valueFree = free;
+#ifdef HAVE_SYS_INOTIFY_H
+	cache->watches = HashTable_New(FALSE);
+	cache->directories = HashTable_New(FALSE);
+
+	if (!cache->watches || !cache->directories)
+		goto fail;
+
+	cache->watches->valueFree = free;
+	drive_cache_string_keys(cache->directories);
+	cache->notify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+	if (cache->notify < 0)
+		WLog_WARN(TAG, "inotify_init1 failed, cached entries are only refreshed on expiry");
+#endif
+	return cache;
+fail:
+	WLog_ERR(TAG, "HashTable_New failed!");
+	drive_cache_free(cache);
+	return NULL;
+}
+
+void drive_cache_free(DRIVE_CACHE* cache)
+{
+	if (!cache)
+		return;
+
+#ifdef HAVE_SYS_INOTIFY_H
+	if (cache->notify >= 0)
+		close(cache->notify);
+
+	HashTable_Free(cache->directories);
+	HashTable_Free(cache->watches);
+#endif
+	HashTable_Free(cache->files);
+	HashTable_Free(cache->listings);
+	HashTable_Free(cache->attributes);
+	DeleteCriticalSection(&cache->lock);
+	free(cache);
+}
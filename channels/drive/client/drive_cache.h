@@ -0,0 +1,65 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * File System Virtual Channel
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_CHANNEL_DRIVE_CLIENT_CACHE_H
+#define FREERDP_CHANNEL_DRIVE_CLIENT_CACHE_H
+
+#include <winpr/wtypes.h>
+#include <winpr/file.h>
+
+/* lifetime of an entry in ms, bounds staleness where no change notification is available */
+#define DRIVE_CACHE_TTL 2000
+#define DRIVE_CACHE_MAX_ATTRIBUTES 4096
+#define DRIVE_CACHE_MAX_LISTINGS 64
+#define DRIVE_CACHE_MAX_LISTING_ENTRIES 4096 /* larger directories are not cached */
+#define DRIVE_CACHE_MAX_LISTED_ENTRIES 16384 /* sum over all cached listings */
+#define DRIVE_CACHE_MAX_WATCHES 256
+
+typedef struct _DRIVE_CACHE DRIVE_CACHE;
+typedef struct _DRIVE_CACHE_ENTRY DRIVE_CACHE_ENTRY;
+typedef struct _DRIVE_CACHE_LISTING DRIVE_CACHE_LISTING;
+
+struct _DRIVE_CACHE_ENTRY
+{
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	WCHAR* name;
+};
+
+/* result of a directory search, shared by the cache and the files enumerating it */
+struct _DRIVE_CACHE_LISTING
+{
+	LONG volatile refCount;
+	UINT64 expires;
+	char* directory; /* search pattern up to the last '/' */
+	size_t count;
+	DRIVE_CACHE_ENTRY* entries;
+};
+
+DRIVE_CACHE* drive_cache_new(void);
+void drive_cache_free(DRIVE_CACHE* cache);
+
+BOOL drive_cache_get_attributes(DRIVE_CACHE* cache, const WCHAR* path,
+                                WIN32_FILE_ATTRIBUTE_DATA* data);
+DRIVE_CACHE_LISTING* drive_cache_get_listing(DRIVE_CACHE* cache, const WCHAR* pattern);
+void drive_cache_listing_release(DRIVE_CACHE_LISTING* listing);
+void drive_cache_invalidate(DRIVE_CACHE* cache, const WCHAR* path, BOOL tree);
+BOOL drive_cache_watch_file(DRIVE_CACHE* cache, const WCHAR* path);
+void drive_cache_unwatch_file(DRIVE_CACHE* cache, const WCHAR* path);
+UINT64 drive_cache_generation(DRIVE_CACHE* cache);
+BOOL drive_cache_file_changed(DRIVE_CACHE* cache, const WCHAR* path, UINT64 generation);
+
+#endif /* FREERDP_CHANNEL_DRIVE_CLIENT_CACHE_H */
@@ -335,7 +335,7 @@ static BOOL drive_file_init(DRIVE_FILE* file)
 
 DRIVE_FILE* drive_file_new(const WCHAR* base_path, const WCHAR* path, UINT32 PathLength, UINT32 id,
                            UINT32 DesiredAccess, UINT32 CreateDisposition, UINT32 CreateOptions,
-                           UINT32 FileAttributes, UINT32 SharedAccess)
+                           UINT32 FileAttributes, UINT32 SharedAccess, DRIVE_CACHE* cache)
 {
 	DRIVE_FILE* file;
 
@@ -359,6 +359,7 @@ DRIVE_FILE* drive_file_new(const WCHAR* base_path, const WCHAR* path, UINT32 Pat
 	file->CreateDisposition = CreateDisposition;
 	file->CreateOptions = CreateOptions;
 	file->SharedAccess = SharedAccess;
+	file->cache = cache;
 	drive_file_set_fullpath(file, drive_file_combine_fullpath(base_path, path, PathLength));
 
 	if (!drive_file_init(file))
@@ -369,9 +370,30 @@ DRIVE_FILE* drive_file_new(const WCHAR* base_path, const WCHAR* path, UINT32 Pat
 		return NULL;
 	}
 
+	/* every other disposition may have created or truncated the file */
+	if (CreateDisposition != FILE_OPEN)
+		drive_cache_invalidate(file->cache, file->fullpath, FALSE);
+
 	return file;
 }
 
+static void drive_file_discard_read_ahead(DRIVE_FILE* file)
+{
+	file->read_ahead_length = 0;
+	file->sequential_reads = 0;
+}
+
+/* the buffer is registered with the cache under fullpath, released before it changes */
+static void drive_file_release_read_ahead(DRIVE_FILE* file)
+{
+	if (file->read_ahead)
+		drive_cache_unwatch_file(file->cache, file->fullpath);
+
+	free(file->read_ahead);
+	file->read_ahead = NULL;
+	drive_file_discard_read_ahead(file);
+}
+
 BOOL drive_file_free(DRIVE_FILE* file)
 {
 	BOOL rc = FALSE;
@@ -391,20 +413,25 @@ BOOL drive_file_free(DRIVE_FILE* file)
 		file->find_handle = INVALID_HANDLE_VALUE;
 	}
 
+	drive_cache_listing_release(file->listing);
+
 	if (file->delete_pending)
 	{
 		if (file->is_dir)
-		{
-			if (!drive_file_remove_dir(file->fullpath))
-				goto fail;
-		}
-		else if (!DeleteFileW(file->fullpath))
+			rc = drive_file_remove_dir(file->fullpath);
+		else
+			rc = DeleteFileW(file->fullpath);
+
+		drive_cache_invalidate(file->cache, file->fullpath, file->is_dir);
+
+		if (!rc)
 			goto fail;
 	}
 
 	rc = TRUE;
 fail:
 	DEBUG_WSTR("Free %s", file->fullpath);
+	drive_file_release_read_ahead(file);
 	free(file->fullpath);
 	free(file);
 	return rc;
@@ -442,25 +469,128 @@ BOOL drive_file_read(DRIVE_FILE* file, BYTE* buffer, UINT32* Length)
 	return FALSE;
 }
 
+/**
+ * Reads Length bytes at Offset, using data read ahead by drive_file_read_ahead where possible.
+ */
+
+BOOL drive_file_read_at(DRIVE_FILE* file, UINT64 Offset, BYTE* buffer, UINT32* Length)
+{
+	UINT32 cached = 0;
+	UINT32 remaining;
+
+	if (!file || !buffer || !Length)
+		return FALSE;
+
+	/* other handles and the host may have written the file since it was read ahead */
+	if ((Offset >= file->read_ahead_offset) &&
+	    (Offset - file->read_ahead_offset < file->read_ahead_length) &&
+	    drive_cache_file_changed(file->cache, file->fullpath, file->read_ahead_generation))
+		drive_file_discard_read_ahead(file);
+
+	if ((Offset >= file->read_ahead_offset) &&
+	    (Offset - file->read_ahead_offset < file->read_ahead_length))
+	{
+		const UINT64 skip = Offset - file->read_ahead_offset;
+		cached = (UINT32)MIN(*Length, file->read_ahead_length - skip);
+		CopyMemory(buffer, &file->read_ahead[skip], cached);
+	}
+
+	remaining = *Length - cached;
+
+	if (remaining > 0)
+	{
+		if (!drive_file_seek(file, Offset + cached) ||
+		    !drive_file_read(file, &buffer[cached], &remaining))
+			return FALSE;
+	}
+
+	*Length = cached + remaining;
+
+	if ((Offset == file->next_offset) && (*Length > 0))
+		file->sequential_reads++;
+	else
+		file->sequential_reads = 0;
+
+	file->next_offset = Offset + *Length;
+	return TRUE;
+}
+
+/**
+ * Called after a read was completed. Once the reads look sequential the data following them
+ * is read while the server processes the reply, the next read is then served from memory.
+ */
+
+void drive_file_read_ahead(DRIVE_FILE* file)
+{
+	UINT64 generation;
+	UINT32 length = DRIVE_FILE_READ_AHEAD_SIZE;
+
+	if (!file || !file->cache || (file->sequential_reads < DRIVE_FILE_READ_AHEAD_THRESHOLD))
+		return;
+
+	/* files shared for writing are likely to change behind the buffer */
+	if (file->is_dir || (file->SharedAccess & FILE_SHARE_WRITE))
+		return;
+
+	/* keep the buffer as long as at least half of it is ahead of the reader */
+	if ((file->next_offset >= file->read_ahead_offset) &&
+	    (file->read_ahead_offset + file->read_ahead_length >=
+	     file->next_offset + DRIVE_FILE_READ_AHEAD_SIZE / 2))
+		return;
+
+	if (!file->read_ahead)
+	{
+		if (!drive_cache_watch_file(file->cache, file->fullpath))
+			return;
+
+		file->read_ahead = (BYTE*)malloc(DRIVE_FILE_READ_AHEAD_SIZE);
+
+		if (!file->read_ahead)
+		{
+			drive_cache_unwatch_file(file->cache, file->fullpath);
+			return;
+		}
+	}
+
+	file->read_ahead_length = 0;
+	/* taken before reading, a change while reading then outdates the data */
+	generation = drive_cache_generation(file->cache);
+
+	if (!drive_file_seek(file, file->next_offset) ||
+	    !drive_file_read(file, file->read_ahead, &length))
+		return;
+
+	file->read_ahead_offset = file->next_offset;
+	file->read_ahead_length = length;
+	file->read_ahead_generation = generation;
+}
+
 BOOL drive_file_write(DRIVE_FILE* file, BYTE* buffer, UINT32 Length)
 {
+	BOOL rc = TRUE;
 	UINT32 written;
 
 	if (!file || !buffer)
 		return FALSE;
 
+	drive_file_discard_read_ahead(file);
+
 	DEBUG_WSTR("Write file %s", file->fullpath);
 
 	while (Length > 0)
 	{
 		if (!WriteFile(file->file_handle, buffer, Length, &written, NULL))
-			return FALSE;
+		{
+			rc = FALSE;
+			break;
+		}
 
 		Length -= written;
 		buffer += written;
 	}
 
-	return TRUE;
+	drive_cache_invalidate(file->cache, file->fullpath, FALSE);
+	return rc;
 }
 
 BOOL drive_file_query_information(DRIVE_FILE* file, UINT32 FsInformationClass, wStream* output)
@@ -471,7 +601,7 @@ BOOL drive_file_query_information(DRIVE_FILE* file, UINT32 FsInformationClass, w
 	if (!file || !output)
 		return FALSE;
 
-	if (!GetFileAttributesExW(file->fullpath, GetFileExInfoStandard, &fileAttributes))
+	if (!drive_cache_get_attributes(file->cache, file->fullpath, &fileAttributes))
 		goto out_fail;
 
 	switch (FsInformationClass)
@@ -544,8 +674,8 @@ out_fail:
 	return FALSE;
 }
 
-BOOL drive_file_set_information(DRIVE_FILE* file, UINT32 FsInformationClass, UINT32 Length,
-                                wStream* input)
+static BOOL drive_file_apply_information(DRIVE_FILE* file, UINT32 FsInformationClass,
+                                         UINT32 Length, wStream* input)
 {
 	INT64 size;
 	WCHAR* fullpath;
@@ -566,9 +696,6 @@ BOOL drive_file_set_information(DRIVE_FILE* file, UINT32 FsInformationClass, UIN
 	UINT8 ReplaceIfExists;
 	DWORD attr;
 
-	if (!file || !input)
-		return FALSE;
-
 	switch (FsInformationClass)
 	{
 		case FileBasicInformation:
@@ -737,6 +864,9 @@ BOOL drive_file_set_information(DRIVE_FILE* file, UINT32 FsInformationClass, UIN
 			                MOVEFILE_COPY_ALLOWED |
 			                    (ReplaceIfExists ? MOVEFILE_REPLACE_EXISTING : 0)))
 			{
+				drive_cache_invalidate(file->cache, file->fullpath, file->is_dir);
+				drive_cache_invalidate(file->cache, fullpath, TRUE);
+
 				if (!drive_file_set_fullpath(file, fullpath))
 					return FALSE;
 			}
@@ -758,6 +888,47 @@ BOOL drive_file_set_information(DRIVE_FILE* file, UINT32 FsInformationClass, UIN
 	return TRUE;
 }
 
+BOOL drive_file_set_information(DRIVE_FILE* file, UINT32 FsInformationClass, UINT32 Length,
+                                wStream* input)
+{
+	BOOL rc;
+
+	if (!file || !input)
+		return FALSE;
+
+	/* a rename changes the path the buffer is registered under */
+	drive_file_release_read_ahead(file);
+	rc = drive_file_apply_information(file, FsInformationClass, Length, input);
+	/* after the change, a concurrent lookup could otherwise cache the previous state */
+	drive_cache_invalidate(file->cache, file->fullpath, FALSE);
+	return rc;
+}
+
+/* copies the next entry of the cached listing to find_data */
+static BOOL drive_file_next_listing_entry(DRIVE_FILE* file)
+{
+	size_t length;
+	const DRIVE_CACHE_ENTRY* entry;
+
+	if (file->listing_index >= file->listing->count)
+	{
+		SetLastError(ERROR_NO_MORE_FILES);
+		return FALSE;
+	}
+
+	entry = &file->listing->entries[file->listing_index++];
+	ZeroMemory(&file->find_data, sizeof(file->find_data));
+	file->find_data.dwFileAttributes = entry->data.dwFileAttributes;
+	file->find_data.ftCreationTime = entry->data.ftCreationTime;
+	file->find_data.ftLastAccessTime = entry->data.ftLastAccessTime;
+	file->find_data.ftLastWriteTime = entry->data.ftLastWriteTime;
+	file->find_data.nFileSizeHigh = entry->data.nFileSizeHigh;
+	file->find_data.nFileSizeLow = entry->data.nFileSizeLow;
+	length = MIN(_wcslen(entry->name), ARRAYSIZE(file->find_data.cFileName) - 1);
+	CopyMemory(file->find_data.cFileName, entry->name, length * sizeof(WCHAR));
+	return TRUE;
+}
+
 BOOL drive_file_query_directory(DRIVE_FILE* file, UINT32 FsInformationClass, BYTE InitialQuery,
                                 const WCHAR* path, UINT32 PathLength, wStream* output)
 {
@@ -773,15 +944,25 @@ BOOL drive_file_query_directory(DRIVE_FILE* file, UINT32 FsInformationClass, BYT
 		if (file->find_handle != INVALID_HANDLE_VALUE)
 			FindClose(file->find_handle);
 
+		file->find_handle = INVALID_HANDLE_VALUE;
+		drive_cache_listing_release(file->listing);
+		file->listing_index = 0;
 		ent_path = drive_file_combine_fullpath(file->basepath, path, PathLength);
+		file->listing = drive_cache_get_listing(file->cache, ent_path);
+
 		/* open new search handle and retrieve the first entry */
-		file->find_handle = FindFirstFileW(ent_path, &file->find_data);
+		if (!file->listing)
+			file->find_handle = FindFirstFileW(ent_path, &file->find_data);
+
 		free(ent_path);
 
-		if (file->find_handle == INVALID_HANDLE_VALUE)
+		if (!file->listing && (file->find_handle == INVALID_HANDLE_VALUE))
 			goto out_fail;
 	}
-	else if (!FindNextFileW(file->find_handle, &file->find_data))
+	else if (!file->listing && !FindNextFileW(file->find_handle, &file->find_data))
+		goto out_fail;
+
+	if (file->listing && !drive_file_next_listing_entry(file))
 		goto out_fail;
 
 	length = _wcslen(file->find_data.cFileName) * 2;
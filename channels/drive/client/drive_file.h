@@ -29,8 +29,14 @@
 #include <winpr/stream.h>
 #include <freerdp/channels/log.h>
 
+#include "drive_cache.h"
+
 #define TAG CHANNELS_TAG("drive.client")
 
+/* size of the read ahead buffer and number of consecutive reads that enable it */
+#define DRIVE_FILE_READ_AHEAD_SIZE (512 * 1024)
+#define DRIVE_FILE_READ_AHEAD_THRESHOLD 2
+
 typedef struct _DRIVE_FILE DRIVE_FILE;
 
 struct _DRIVE_FILE
@@ -40,6 +46,9 @@ struct _DRIVE_FILE
 	HANDLE file_handle;
 	HANDLE find_handle;
 	WIN32_FIND_DATAW find_data;
+	DRIVE_CACHE* cache;
+	DRIVE_CACHE_LISTING* listing; /* enumerated instead of find_handle when cached */
+	size_t listing_index;
 	const WCHAR* basepath;
 	WCHAR* fullpath;
 	WCHAR* filename;
@@ -49,16 +58,24 @@ struct _DRIVE_FILE
 	UINT32 DesiredAccess;
 	UINT32 CreateDisposition;
 	UINT32 CreateOptions;
+	UINT64 next_offset; /* offset following the last read */
+	UINT32 sequential_reads;
+	BYTE* read_ahead; /* DRIVE_FILE_READ_AHEAD_SIZE bytes, allocated for sequential reads */
+	UINT64 read_ahead_offset;
+	UINT32 read_ahead_length;
+	UINT64 read_ahead_generation; /* of the cache when read, see drive_cache_file_changed */
 };
 
 DRIVE_FILE* drive_file_new(const WCHAR* base_path, const WCHAR* path, UINT32 PathLength, UINT32 id,
                            UINT32 DesiredAccess, UINT32 CreateDisposition, UINT32 CreateOptions,
-                           UINT32 FileAttributes, UINT32 SharedAccess);
+                           UINT32 FileAttributes, UINT32 SharedAccess, DRIVE_CACHE* cache);
 BOOL drive_file_free(DRIVE_FILE* file);
 
 BOOL drive_file_open(DRIVE_FILE* file);
 BOOL drive_file_seek(DRIVE_FILE* file, UINT64 Offset);
 BOOL drive_file_read(DRIVE_FILE* file, BYTE* buffer, UINT32* Length);
+BOOL drive_file_read_at(DRIVE_FILE* file, UINT64 Offset, BYTE* buffer, UINT32* Length);
+void drive_file_read_ahead(DRIVE_FILE* file);
 BOOL drive_file_write(DRIVE_FILE* file, BYTE* buffer, UINT32 Length);
 BOOL drive_file_query_information(DRIVE_FILE* file, UINT32 FsInformationClass, wStream* output);
 BOOL drive_file_set_information(DRIVE_FILE* file, UINT32 FsInformationClass, UINT32 Length,
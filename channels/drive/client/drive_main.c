@@ -41,12 +41,23 @@
 #include <winpr/interlocked.h>
 #include <winpr/collections.h>
 #include <winpr/shell.h>
+#include <winpr/pool.h>
 
 #include <freerdp/channels/rdpdr.h>
 
 #include "drive_file.h"
 
+#define DRIVE_IO_THREADS 4
+
 typedef struct _DRIVE_DEVICE DRIVE_DEVICE;
+typedef struct _DRIVE_IRP_CHAIN DRIVE_IRP_CHAIN;
+
+/* IRPs for one FileId, processed in order by one I/O thread at a time */
+struct _DRIVE_IRP_CHAIN
+{
+	UINT32 FileId;
+	wLinkedList* irps;
+};
 
 struct _DRIVE_DEVICE
 {
@@ -56,9 +67,15 @@ struct _DRIVE_DEVICE
 	BOOL automount;
 	UINT32 PathLength;
 	wListDictionary* files;
+	DRIVE_CACHE* cache; /* attributes and listings shared by all files */
 
-	HANDLE thread;
-	wMessageQueue* IrpQueue;
+	PTP_POOL pool;
+	PTP_WORK work;
+	TP_CALLBACK_ENVIRON environment;
+	CRITICAL_SECTION lock;   /* protects chains and ready */
+	wListDictionary* chains; /* FileId -> DRIVE_IRP_CHAIN with IRPs queued or in progress */
+	wQueue* ready;           /* chains waiting for an I/O thread */
+	LONG volatile error;
 
 	DEVMAN* devman;
 
@@ -185,7 +202,7 @@ static UINT drive_process_irp_create(DRIVE_DEVICE* drive, IRP* irp)
 	path = (const WCHAR*)Stream_Pointer(irp->input);
 	FileId = irp->devman->id_sequence++;
 	file = drive_file_new(drive->path, path, PathLength, FileId, DesiredAccess, CreateDisposition,
-	                      CreateOptions, FileAttributes, SharedAccess);
+	                      CreateOptions, FileAttributes, SharedAccess, drive->cache);
 
 	if (!file)
 	{
@@ -270,6 +287,7 @@ static UINT drive_process_irp_close(DRIVE_DEVICE* drive, IRP* irp)
  */
 static UINT drive_process_irp_read(DRIVE_DEVICE* drive, IRP* irp)
 {
+	UINT error;
 	DRIVE_FILE* file;
 	UINT32 Length;
 	UINT64 Offset;
@@ -289,9 +307,9 @@ static UINT drive_process_irp_read(DRIVE_DEVICE* drive, IRP* irp)
 		irp->IoStatus = STATUS_UNSUCCESSFUL;
 		Length = 0;
 	}
-	else if (!drive_file_seek(file, Offset))
+	else if (Offset > INT64_MAX)
 	{
-		irp->IoStatus = drive_map_windows_err(GetLastError());
+		irp->IoStatus = STATUS_INVALID_PARAMETER;
 		Length = 0;
 	}
 
@@ -306,7 +324,7 @@ static UINT drive_process_irp_read(DRIVE_DEVICE* drive, IRP* irp)
 	{
 		BYTE* buffer = Stream_Pointer(irp->output) + sizeof(UINT32);
 
-		if (!drive_file_read(file, buffer, &Length))
+		if (!drive_file_read_at(file, Offset, buffer, &Length))
 		{
 			irp->IoStatus = drive_map_windows_err(GetLastError());
 			Stream_Write_UINT32(irp->output, 0);
@@ -318,7 +336,13 @@ static UINT drive_process_irp_read(DRIVE_DEVICE* drive, IRP* irp)
 		}
 	}
 
-	return irp->Complete(irp);
+	error = irp->Complete(irp);
+
+	/* IRPs for this file wait until the read ahead is done, it overlaps the round trip */
+	if (!error && file)
+		drive_file_read_ahead(file);
+
+	return error;
 }
 
 /**
@@ -751,57 +775,65 @@ static UINT drive_process_irp(DRIVE_DEVICE* drive, IRP* irp)
 	return error;
 }
 
-static DWORD WINAPI drive_thread_func(LPVOID arg)
+static void drive_irp_chain_free(DRIVE_IRP_CHAIN* chain)
+{
+	if (!chain)
+		return;
+
+	LinkedList_Free(chain->irps);
+	free(chain);
+}
+
+/**
+ * Runs the first IRP of the next ready chain. A chain with more IRPs is queued again behind the
+ * other ready chains, so a long transfer on one file does not hold up the others.
+ */
+
+static VOID CALLBACK drive_irp_work_callback(PTP_CALLBACK_INSTANCE instance, void* context,
+                                             PTP_WORK work)
 {
 	IRP* irp;
-	wMessage message;
-	DRIVE_DEVICE* drive = (DRIVE_DEVICE*)arg;
-	UINT error = CHANNEL_RC_OK;
+	UINT error;
+	DRIVE_IRP_CHAIN* chain;
+	DRIVE_DEVICE* drive = (DRIVE_DEVICE*)context;
 
-	if (!drive)
-	{
-		error = ERROR_INVALID_PARAMETER;
-		goto fail;
-	}
+	EnterCriticalSection(&drive->lock);
+	chain = (DRIVE_IRP_CHAIN*)Queue_Dequeue(drive->ready);
+	irp = chain ? (IRP*)LinkedList_First(chain->irps) : NULL;
 
-	while (1)
-	{
-		if (!MessageQueue_Wait(drive->IrpQueue))
-		{
-			WLog_ERR(TAG, "MessageQueue_Wait failed!");
-			error = ERROR_INTERNAL_ERROR;
-			break;
-		}
+	if (irp)
+		LinkedList_RemoveFirst(chain->irps);
 
-		if (!MessageQueue_Peek(drive->IrpQueue, &message, TRUE))
-		{
-			WLog_ERR(TAG, "MessageQueue_Peek failed!");
-			error = ERROR_INTERNAL_ERROR;
-			break;
-		}
+	LeaveCriticalSection(&drive->lock);
 
-		if (message.id == WMQ_QUIT)
-			break;
+	if (!irp)
+		return;
 
-		irp = (IRP*)message.wParam;
+	/* after an error the channel is going down, like the former IRP thread */
+	if (drive->error)
+		error = irp->Discard(irp);
+	else if ((error = drive_process_irp(drive, irp)))
+	{
+		WLog_ERR(TAG, "drive_process_irp failed with error %" PRIu32 "!", error);
 
-		if (irp)
-		{
-			if ((error = drive_process_irp(drive, irp)))
-			{
-				WLog_ERR(TAG, "drive_process_irp failed with error %" PRIu32 "!", error);
-				break;
-			}
-		}
+		if ((InterlockedCompareExchange(&drive->error, (LONG)error, 0) == 0) && drive->rdpcontext)
+			setChannelError(drive->rdpcontext, error, "drive_irp_work_callback reported an error");
 	}
 
-fail:
+	EnterCriticalSection(&drive->lock);
 
-	if (error && drive && drive->rdpcontext)
-		setChannelError(drive->rdpcontext, error, "drive_thread_func reported an error");
+	if (LinkedList_Count(chain->irps) > 0)
+	{
+		Queue_Enqueue(drive->ready, chain);
+		SubmitThreadpoolWork(drive->work);
+	}
+	else
+	{
+		ListDictionary_Remove(drive->chains, (void*)(size_t)chain->FileId);
+		drive_irp_chain_free(chain);
+	}
 
-	ExitThread(error);
-	return error;
+	LeaveCriticalSection(&drive->lock);
 }
 
 /**
@@ -811,18 +843,61 @@ fail:
  */
 static UINT drive_irp_request(DEVICE* device, IRP* irp)
 {
+	void* key;
+	DRIVE_IRP_CHAIN* chain;
+	UINT error = CHANNEL_RC_OK;
 	DRIVE_DEVICE* drive = (DRIVE_DEVICE*)device;
 
-	if (!drive)
+	if (!drive || !irp)
 		return ERROR_INVALID_PARAMETER;
 
-	if (!MessageQueue_Post(drive->IrpQueue, NULL, 0, (void*)irp, NULL))
+	key = (void*)(size_t)irp->FileId;
+	EnterCriticalSection(&drive->lock);
+	chain = (DRIVE_IRP_CHAIN*)ListDictionary_GetItemValue(drive->chains, key);
+
+	/* IRPs of a file with IRPs in flight are picked up by the thread processing them */
+	if (chain)
 	{
-		WLog_ERR(TAG, "MessageQueue_Post failed!");
-		return ERROR_INTERNAL_ERROR;
+		if (!LinkedList_AddLast(chain->irps, irp))
+			error = CHANNEL_RC_NO_MEMORY;
+
+		goto out;
 	}
 
-	return CHANNEL_RC_OK;
+	chain = (DRIVE_IRP_CHAIN*)calloc(1, sizeof(DRIVE_IRP_CHAIN));
+
+	if (!chain || !(chain->irps = LinkedList_New()) || !LinkedList_AddLast(chain->irps, irp))
+	{
+		drive_irp_chain_free(chain);
+		error = CHANNEL_RC_NO_MEMORY;
+		goto out;
+	}
+
+	chain->FileId = irp->FileId;
+
+	if (!ListDictionary_Add(drive->chains, key, chain))
+	{
+		drive_irp_chain_free(chain);
+		error = CHANNEL_RC_NO_MEMORY;
+		goto out;
+	}
+
+	if (!Queue_Enqueue(drive->ready, chain))
+	{
+		ListDictionary_Remove(drive->chains, key);
+		drive_irp_chain_free(chain);
+		error = CHANNEL_RC_NO_MEMORY;
+		goto out;
+	}
+
+	SubmitThreadpoolWork(drive->work);
+out:
+	LeaveCriticalSection(&drive->lock);
+
+	if (error)
+		WLog_ERR(TAG, "failed to queue IRP with error %" PRIu32 "!", error);
+
+	return error;
 }
 
 static UINT drive_free_int(DRIVE_DEVICE* drive)
@@ -832,9 +907,17 @@ static UINT drive_free_int(DRIVE_DEVICE* drive)
 	if (!drive)
 		return ERROR_INVALID_PARAMETER;
 
-	CloseHandle(drive->thread);
+	if (drive->work)
+		CloseThreadpoolWork(drive->work);
+
+	if (drive->pool)
+		CloseThreadpool(drive->pool);
+
+	DeleteCriticalSection(&drive->lock);
+	ListDictionary_Free(drive->chains);
+	Queue_Free(drive->ready);
 	ListDictionary_Free(drive->files);
-	MessageQueue_Free(drive->IrpQueue);
+	drive_cache_free(drive->cache);
 	Stream_Free(drive->device.data, TRUE);
 	free(drive->path);
 	free(drive);
@@ -848,18 +931,19 @@ static UINT drive_free_int(DRIVE_DEVICE* drive)
  */
 static UINT drive_free(DEVICE* device)
 {
+	BOOL busy = TRUE;
 	DRIVE_DEVICE* drive = (DRIVE_DEVICE*)device;
-	UINT error = CHANNEL_RC_OK;
 
 	if (!drive)
 		return ERROR_INVALID_PARAMETER;
 
-	if (MessageQueue_PostQuit(drive->IrpQueue, 0) &&
-	    (WaitForSingleObject(drive->thread, INFINITE) == WAIT_FAILED))
+	/* queued IRPs are still processed, each one submits the work again */
+	while (drive->work && busy)
 	{
-		error = GetLastError();
-		WLog_ERR(TAG, "WaitForSingleObject failed with error %" PRIu32 "", error);
-		return error;
+		WaitForThreadpoolWorkCallbacks(drive->work, FALSE);
+		EnterCriticalSection(&drive->lock);
+		busy = ListDictionary_Count(drive->chains) > 0;
+		LeaveCriticalSection(&drive->lock);
 	}
 
 	return drive_free_int(drive);
@@ -903,6 +987,7 @@ static UINT drive_register_drive_path(PDEVICE_SERVICE_ENTRY_POINTS pEntryPoints,
 			return CHANNEL_RC_NO_MEMORY;
 		}
 
+		InitializeCriticalSection(&drive->lock);
 		drive->device.type = RDPDR_DTYP_FILESYSTEM;
 		drive->device.IRPRequest = drive_irp_request;
 		drive->device.Free = drive_free;
@@ -964,29 +1049,53 @@ static UINT drive_register_drive_path(PDEVICE_SERVICE_ENTRY_POINTS pEntryPoints,
 		}
 
 		ListDictionary_ValueObject(drive->files)->fnObjectFree = drive_file_objfree;
-		drive->IrpQueue = MessageQueue_New(NULL);
+		drive->cache = drive_cache_new();
 
-		if (!drive->IrpQueue)
+		if (!drive->cache)
+		{
+			WLog_ERR(TAG, "drive_cache_new failed!");
+			error = CHANNEL_RC_NO_MEMORY;
+			goto out_error;
+		}
+
+		drive->chains = ListDictionary_New(FALSE);
+		drive->ready = Queue_New(FALSE, -1, -1);
+
+		if (!drive->chains || !drive->ready)
 		{
 			WLog_ERR(TAG, "ListDictionary_New failed!");
 			error = CHANNEL_RC_NO_MEMORY;
 			goto out_error;
 		}
 
-		if ((error = pEntryPoints->RegisterDevice(pEntryPoints->devman, (DEVICE*)drive)))
+		if (!(drive->pool = CreateThreadpool(NULL)))
 		{
-			WLog_ERR(TAG, "RegisterDevice failed with error %" PRIu32 "!", error);
+			WLog_ERR(TAG, "CreateThreadpool failed!");
+			goto out_error;
+		}
+
+		if (!SetThreadpoolThreadMinimum(drive->pool, DRIVE_IO_THREADS))
+		{
+			WLog_ERR(TAG, "SetThreadpoolThreadMinimum failed!");
 			goto out_error;
 		}
 
-		if (!(drive->thread =
-		          CreateThread(NULL, 0, drive_thread_func, drive, CREATE_SUSPENDED, NULL)))
+		SetThreadpoolThreadMaximum(drive->pool, DRIVE_IO_THREADS);
+		InitializeThreadpoolEnvironment(&drive->environment);
+		SetThreadpoolCallbackPool(&drive->environment, drive->pool);
+
+		if (!(drive->work =
+		          CreateThreadpoolWork(drive_irp_work_callback, drive, &drive->environment)))
 		{
-			WLog_ERR(TAG, "CreateThread failed!");
+			WLog_ERR(TAG, "CreateThreadpoolWork failed!");
 			goto out_error;
 		}
 
-		ResumeThread(drive->thread);
+		if ((error = pEntryPoints->RegisterDevice(pEntryPoints->devman, (DEVICE*)drive)))
+		{
+			WLog_ERR(TAG, "RegisterDevice failed with error %" PRIu32 "!", error);
+			goto out_error;
+		}
 	}
 
 	return CHANNEL_RC_OK;
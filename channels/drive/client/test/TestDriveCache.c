@@ -0,0 +1,400 @@
+
+#include <stdio.h>
+
+#include <winpr/crt.h>
+#include <winpr/file.h>
+#include <winpr/path.h>
+#include <winpr/string.h>
+#include <winpr/thread.h>
+#include <winpr/sysinfo.h>
+
+#include "drive_cache.h"
+
+static const char* test_files[] = { "a.txt", "x.txt", "y.txt", "sub/b.txt", "sub/deep/c.txt",
+	                                "moved/b.txt", "moved/deep/c.txt", "other/d.txt" };
+static const char* test_directories[] = { "sub/deep", "sub", "moved/deep", "moved", "other" };
+
+static WCHAR* test_path(const char* root, const char* name)
+{
+	char path[MAX_PATH];
+	WCHAR* wpath = NULL;
+
+	if (name)
+		sprintf_s(path, sizeof(path), "%s/%s", root, name);
+	else
+		sprintf_s(path, sizeof(path), "%s", root);
+
+	if (ConvertToUnicode(CP_UTF8, 0, path, -1, &wpath, 0) <= 0)
+		return NULL;
+
+	return wpath;
+}
+
+static BOOL test_write_file(const char* root, const char* name, size_t size, const char* mode)
+{
+	BOOL rc;
+	char path[MAX_PATH];
+	BYTE data[512] = { 0 };
+	FILE* fp;
+	sprintf_s(path, sizeof(path), "%s/%s", root, name);
+	fp = winpr_fopen(path, mode);
+
+	if (!fp || (size > sizeof(data)))
+	{
+		if (fp)
+			fclose(fp);
+
+		return FALSE;
+	}
+
+	rc = fwrite(data, 1, size, fp) == size;
+	fclose(fp);
+	return rc;
+}
+
+static BOOL test_move(const char* root, const char* from, const char* to)
+{
+	char src[MAX_PATH];
+	char dst[MAX_PATH];
+	sprintf_s(src, sizeof(src), "%s/%s", root, from);
+	sprintf_s(dst, sizeof(dst), "%s/%s", root, to);
+	return MoveFileExA(src, dst, MOVEFILE_REPLACE_EXISTING);
+}
+
+static void test_invalidate(DRIVE_CACHE* cache, const char* root, const char* name, BOOL tree)
+{
+	WCHAR* path = test_path(root, name);
+	drive_cache_invalidate(cache, path, tree);
+	free(path);
+}
+
+static BOOL test_equal_attributes(const WIN32_FILE_ATTRIBUTE_DATA* a,
+                                  const WIN32_FILE_ATTRIBUTE_DATA* b)
+{
+	return (a->dwFileAttributes == b->dwFileAttributes) &&
+	       (a->nFileSizeHigh == b->nFileSizeHigh) && (a->nFileSizeLow == b->nFileSizeLow) &&
+	       (a->ftLastWriteTime.dwLowDateTime == b->ftLastWriteTime.dwLowDateTime) &&
+	       (a->ftLastWriteTime.dwHighDateTime == b->ftLastWriteTime.dwHighDateTime);
+}
+
+/* the cached attributes of name are the ones on disk, or both are missing */
+static BOOL test_attributes(DRIVE_CACHE* cache, const char* root, const char* name)
+{
+	BOOL rc = FALSE;
+	BOOL cached, actual;
+	WIN32_FILE_ATTRIBUTE_DATA cachedData = { 0 };
+	WIN32_FILE_ATTRIBUTE_DATA actualData = { 0 };
+	WCHAR* path = test_path(root, name);
+
+	if (!path)
+		return FALSE;
+
+	cached = drive_cache_get_attributes(cache, path, &cachedData);
+	actual = GetFileAttributesExW(path, GetFileExInfoStandard, &actualData);
+
+	if (cached != actual)
+		fprintf(stderr, "%s: cached %s, on disk %s\n", name, cached ? "exists" : "missing",
+		        actual ? "exists" : "missing");
+	else if (actual && !test_equal_attributes(&cachedData, &actualData))
+		fprintf(stderr, "%s: cached attributes differ, size %" PRIu32 " instead of %" PRIu32 "\n",
+		        name, cachedData.nFileSizeLow, actualData.nFileSizeLow);
+	else
+		rc = TRUE;
+
+	free(path);
+	return rc;
+}
+
+/* the cached listing of directory has the entries on disk, or both are missing */
+static BOOL test_listing(DRIVE_CACHE* cache, const char* root, const char* directory,
+                         DRIVE_CACHE_LISTING** pListing)
+{
+	BOOL rc = FALSE;
+	size_t count = 0;
+	char pattern[MAX_PATH];
+	WCHAR* wpattern;
+	HANDLE handle;
+	WIN32_FIND_DATAW findData;
+	DRIVE_CACHE_LISTING* listing;
+
+	if (directory[0] == '\0')
+		sprintf_s(pattern, sizeof(pattern), "*");
+	else
+		sprintf_s(pattern, sizeof(pattern), "%s/*", directory);
+
+	wpattern = test_path(root, pattern);
+
+	if (!wpattern)
+		return FALSE;
+
+	listing = drive_cache_get_listing(cache, wpattern);
+	handle = FindFirstFileW(wpattern, &findData);
+
+	if (!listing || (handle == INVALID_HANDLE_VALUE))
+	{
+		rc = !listing && (handle == INVALID_HANDLE_VALUE);
+
+		if (!rc)
+			fprintf(stderr, "%s: listing %s, directory %s\n", directory,
+			        listing ? "cached" : "missing",
+			        (handle != INVALID_HANDLE_VALUE) ? "exists" : "missing");
+
+		goto out;
+	}
+
+	do
+	{
+		size_t i;
+		WIN32_FILE_ATTRIBUTE_DATA data = { 0 };
+		data.dwFileAttributes = findData.dwFileAttributes;
+		data.ftLastWriteTime = findData.ftLastWriteTime;
+		data.nFileSizeHigh = findData.nFileSizeHigh;
+		data.nFileSizeLow = findData.nFileSizeLow;
+		count++;
+
+		for (i = 0; i < listing->count; i++)
+		{
+			if (_wcscmp(listing->entries[i].name, findData.cFileName) == 0)
+				break;
+		}
+
+		if ((i == listing->count) || !test_equal_attributes(&listing->entries[i].data, &data))
+		{
+			fprintf(stderr, "%s: entry %" PRIuz " missing or outdated in the listing\n",
+			        directory, count);
+			goto out;
+		}
+	} while (FindNextFileW(handle, &findData));
+
+	if (count != listing->count)
+	{
+		fprintf(stderr, "%s: %" PRIuz " entries listed, %" PRIuz " on disk\n", directory,
+		        listing->count, count);
+		goto out;
+	}
+
+	rc = TRUE;
+out:
+	if (handle != INVALID_HANDLE_VALUE)
+		FindClose(handle);
+
+	if (pListing && rc)
+		*pListing = listing;
+	else
+		drive_cache_listing_release(listing);
+
+	free(wpattern);
+	return rc;
+}
+
+static BOOL test_file_changed(DRIVE_CACHE* cache, const char* root, const char* name,
+                              UINT64 generation, BOOL expected)
+{
+	WCHAR* path = test_path(root, name);
+	const BOOL changed = drive_cache_file_changed(cache, path, generation);
+	free(path);
+
+	if (changed != expected)
+	{
+		fprintf(stderr, "%s: reported %s\n", name, changed ? "changed" : "unchanged");
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static BOOL test_populate(DRIVE_CACHE* cache, const char* root)
+{
+	size_t i;
+	const char* directories[] = { "", "sub", "sub/deep", "other" }; /* "" for the root */
+	const char* files[] = { "a.txt", "x.txt", "y.txt", "sub", "sub/b.txt", "sub/deep/c.txt",
+		                    "other/d.txt" };
+
+	for (i = 0; i < ARRAYSIZE(directories); i++)
+	{
+		if (!test_listing(cache, root, directories[i], NULL))
+			return FALSE;
+	}
+
+	for (i = 0; i < ARRAYSIZE(files); i++)
+	{
+		if (!test_attributes(cache, root, files[i]))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static BOOL test_drive_cache(DRIVE_CACHE* cache, const char* root)
+{
+	BOOL rc = FALSE;
+	UINT64 generation;
+	WCHAR* watched[2] = { 0 };
+	DRIVE_CACHE_LISTING* other = NULL;
+	DRIVE_CACHE_LISTING* listing = NULL;
+
+	if (!test_populate(cache, root) || !test_listing(cache, root, "other", &other))
+		goto out;
+
+	/* an unchanged directory is served from the cache */
+	if (!test_listing(cache, root, "other", &listing) || (listing != other))
+	{
+		fprintf(stderr, "other: listing was not cached\n");
+		goto out;
+	}
+
+	drive_cache_listing_release(listing);
+	listing = NULL;
+
+	/* a file written through the drive */
+	if (!test_write_file(root, "a.txt", 300, "ab"))
+		goto out;
+
+	test_invalidate(cache, root, "a.txt", FALSE);
+
+	if (!test_attributes(cache, root, "a.txt") || !test_listing(cache, root, "", NULL))
+		goto out;
+
+	/* a rename replacing its target, invalidated like drive_file_set_information does */
+	if (!test_move(root, "x.txt", "y.txt"))
+		goto out;
+
+	test_invalidate(cache, root, "x.txt", FALSE);
+	test_invalidate(cache, root, "y.txt", TRUE);
+
+	if (!test_attributes(cache, root, "x.txt") || !test_attributes(cache, root, "y.txt") ||
+	    !test_listing(cache, root, "", NULL))
+		goto out;
+
+	/* a renamed directory tree */
+	if (!test_move(root, "sub", "moved"))
+		goto out;
+
+	test_invalidate(cache, root, "sub", TRUE);
+	test_invalidate(cache, root, "moved", TRUE);
+
+	if (!test_attributes(cache, root, "sub") || !test_attributes(cache, root, "sub/b.txt") ||
+	    !test_attributes(cache, root, "sub/deep/c.txt") ||
+	    !test_attributes(cache, root, "moved/deep/c.txt") || !test_listing(cache, root, "", NULL) ||
+	    !test_listing(cache, root, "sub", NULL) || !test_listing(cache, root, "sub/deep", NULL) ||
+	    !test_listing(cache, root, "moved/deep", NULL))
+		goto out;
+
+	/* invalidations elsewhere keep the listing */
+	if (!test_listing(cache, root, "other", &listing) || (listing != other))
+	{
+		fprintf(stderr, "other: listing was dropped by an unrelated invalidation\n");
+		goto out;
+	}
+
+	/* files holding read ahead data */
+	watched[0] = test_path(root, "a.txt");
+	watched[1] = test_path(root, "other/d.txt");
+
+	if (!watched[0] || !watched[1] || !drive_cache_watch_file(cache, watched[0]) ||
+	    !drive_cache_watch_file(cache, watched[1]))
+		goto out;
+
+	generation = drive_cache_generation(cache);
+
+	if (!test_file_changed(cache, root, "a.txt", generation, FALSE) ||
+	    !test_file_changed(cache, root, "other/d.txt", generation, FALSE) ||
+	    !test_file_changed(cache, root, "y.txt", generation, TRUE))
+		goto out;
+
+	test_invalidate(cache, root, "a.txt", FALSE);
+
+	if (!test_file_changed(cache, root, "a.txt", generation, TRUE) ||
+	    !test_file_changed(cache, root, "other/d.txt", generation, FALSE))
+		goto out;
+
+	test_invalidate(cache, root, "other", TRUE);
+
+	if (!test_file_changed(cache, root, "other/d.txt", generation, TRUE) ||
+	    !test_listing(cache, root, "other", NULL))
+		goto out;
+
+	/* unwatched files are unknown to the cache and always count as changed */
+	drive_cache_unwatch_file(cache, watched[0]);
+	generation = drive_cache_generation(cache);
+
+	if (!test_file_changed(cache, root, "a.txt", generation, TRUE))
+		goto out;
+
+	rc = TRUE;
+out:
+	if (watched[1])
+		drive_cache_unwatch_file(cache, watched[1]);
+
+	free(watched[0]);
+	free(watched[1]);
+	drive_cache_listing_release(listing);
+	drive_cache_listing_release(other);
+	return rc;
+}
+
+static void test_cleanup(const char* root)
+{
+	size_t i;
+	char path[MAX_PATH];
+
+	for (i = 0; i < ARRAYSIZE(test_files); i++)
+	{
+		sprintf_s(path, sizeof(path), "%s/%s", root, test_files[i]);
+		DeleteFileA(path);
+	}
+
+	for (i = 0; i < ARRAYSIZE(test_directories); i++)
+	{
+		sprintf_s(path, sizeof(path), "%s/%s", root, test_directories[i]);
+		RemoveDirectoryA(path);
+	}
+
+	RemoveDirectoryA(root);
+}
+
+int TestDriveCache(int argc, char* argv[])
+{
+	int rc = -1;
+	char name[64];
+	char path[MAX_PATH];
+	char* root = NULL;
+	DRIVE_CACHE* cache = NULL;
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+	sprintf_s(name, sizeof(name), "TestDriveCache-%" PRIu32 "-%" PRIu64, GetCurrentProcessId(),
+	          GetTickCount64());
+	root = GetKnownSubPath(KNOWN_PATH_TEMP, name);
+
+	if (!root)
+		return -1;
+
+	sprintf_s(path, sizeof(path), "%s/sub/deep", root);
+
+	if (!winpr_PathMakePath(path, NULL))
+		goto fail;
+
+	sprintf_s(path, sizeof(path), "%s/other", root);
+
+	if (!winpr_PathMakePath(path, NULL))
+		goto fail;
+
+	if (!test_write_file(root, "a.txt", 100, "wb") || !test_write_file(root, "x.txt", 10, "wb") ||
+	    !test_write_file(root, "y.txt", 20, "wb") ||
+	    !test_write_file(root, "sub/b.txt", 30, "wb") ||
+	    !test_write_file(root, "sub/deep/c.txt", 40, "wb") ||
+	    !test_write_file(root, "other/d.txt", 50, "wb"))
+		goto fail;
+
+	cache = drive_cache_new();
+
+	if (!cache || !test_drive_cache(cache, root))
+		goto fail;
+
+	rc = 0;
+fail:
+	drive_cache_free(cache);
+	test_cleanup(root);
+	free(root);
+	return rc;
+}
@@ -0,0 +1,510 @@
+
+#include <stdio.h>
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <winpr/crt.h>
+#include <winpr/file.h>
+#include <winpr/path.h>
+#include <winpr/synch.h>
+#include <winpr/thread.h>
+#include <winpr/sysinfo.h>
+#include <winpr/interlocked.h>
+
+#include <freerdp/channels/rdpdr.h>
+
+#include "drive_file.h"
+
+#ifdef BUILTIN_CHANNELS
+#define DeviceServiceEntry drive_DeviceServiceEntry
+#endif
+
+UINT DeviceServiceEntry(PDEVICE_SERVICE_ENTRY_POINTS pEntryPoints);
+
+#define TEST_FILE_SIZE (3 * 1024 * 1024 + 123)
+#define TEST_READ_LENGTH (64 * 1024)
+#define TEST_TIMEOUT 10000
+
+/* IRPs stay with the test when completed, the order is the position among all completions */
+typedef struct
+{
+	IRP irp;
+	HANDLE event;
+	LONG order;
+} TEST_IRP;
+
+static LONG test_order = 0;
+static DEVICE* test_device = NULL;
+
+static UINT test_register_device(DEVMAN* devman, DEVICE* device)
+{
+	WINPR_UNUSED(devman);
+	test_device = device;
+	return CHANNEL_RC_OK;
+}
+
+static UINT test_irp_complete(IRP* irp)
+{
+	TEST_IRP* test = (TEST_IRP*)irp;
+	test->order = InterlockedIncrement(&test_order);
+	SetEvent(test->event);
+	return CHANNEL_RC_OK;
+}
+
+static UINT test_irp_discard(IRP* irp)
+{
+	TEST_IRP* test = (TEST_IRP*)irp;
+	test->order = -1;
+	SetEvent(test->event);
+	return CHANNEL_RC_OK;
+}
+
+static void test_irp_free(TEST_IRP* test)
+{
+	if (!test)
+		return;
+
+	Stream_Free(test->irp.input, TRUE);
+	Stream_Free(test->irp.output, TRUE);
+
+	if (test->event)
+		CloseHandle(test->event);
+
+	free(test);
+}
+
+static TEST_IRP* test_irp_new(DEVMAN* devman, UINT32 FileId, UINT32 MajorFunction, size_t length)
+{
+	TEST_IRP* test = (TEST_IRP*)calloc(1, sizeof(TEST_IRP));
+
+	if (!test)
+		return NULL;
+
+	test->irp.device = test_device;
+	test->irp.devman = devman;
+	test->irp.FileId = FileId;
+	test->irp.MajorFunction = MajorFunction;
+	test->irp.Complete = test_irp_complete;
+	test->irp.Discard = test_irp_discard;
+	test->irp.input = Stream_New(NULL, length);
+	test->irp.output = Stream_New(NULL, 64);
+	test->event = CreateEventA(NULL, TRUE, FALSE, NULL);
+
+	if (!test->irp.input || !test->irp.output || !test->event)
+	{
+		test_irp_free(test);
+		return NULL;
+	}
+
+	return test;
+}
+
+/* queues the IRP without waiting for it, like rdpdr does for each server request */
+static TEST_IRP* test_irp_submit(TEST_IRP* test)
+{
+	if (!test)
+		return NULL;
+
+	Stream_SealLength(test->irp.input);
+	Stream_SetPosition(test->irp.input, 0);
+
+	if (test_device->IRPRequest(test_device, &test->irp) != CHANNEL_RC_OK)
+	{
+		test_irp_free(test);
+		return NULL;
+	}
+
+	return test;
+}
+
+static BOOL test_irp_wait(TEST_IRP* test)
+{
+	if (!test || (WaitForSingleObject(test->event, TEST_TIMEOUT) != WAIT_OBJECT_0))
+	{
+		fprintf(stderr, "IRP not completed\n");
+		return FALSE;
+	}
+
+	if ((test->order < 0) || (test->irp.IoStatus != STATUS_SUCCESS))
+	{
+		fprintf(stderr, "IRP 0x%08" PRIX32 " failed with 0x%08" PRIX32 "\n",
+		        test->irp.MajorFunction, test->irp.IoStatus);
+		return FALSE;
+	}
+
+	Stream_SealLength(test->irp.output);
+	Stream_SetPosition(test->irp.output, 0);
+	return TRUE;
+}
+
+static TEST_IRP* test_create(DEVMAN* devman, const char* name, UINT32 DesiredAccess)
+{
+	TEST_IRP* test;
+	WCHAR* path = NULL;
+	const int length = ConvertToUnicode(CP_UTF8, 0, name, -1, &path, 0);
+
+	if (length <= 0)
+		return NULL;
+
+	test = test_irp_new(devman, 0, IRP_MJ_CREATE, 32 + length * sizeof(WCHAR));
+
+	if (test)
+	{
+		wStream* s = test->irp.input;
+		Stream_Write_UINT32(s, DesiredAccess);
+		Stream_Write_UINT64(s, 0); /* AllocationSize */
+		Stream_Write_UINT32(s, FILE_ATTRIBUTE_NORMAL);
+		Stream_Write_UINT32(s, FILE_SHARE_READ);
+		Stream_Write_UINT32(s, FILE_OPEN);
+		Stream_Write_UINT32(s, FILE_NON_DIRECTORY_FILE);
+		Stream_Write_UINT32(s, length * sizeof(WCHAR));
+		Stream_Write(s, path, length * sizeof(WCHAR));
+		test = test_irp_submit(test);
+	}
+
+	free(path);
+	return test;
+}
+
+static BOOL test_created(TEST_IRP* test, UINT32* FileId)
+{
+	if (!test_irp_wait(test) || (Stream_GetRemainingLength(test->irp.output) < 5))
+		return FALSE;
+
+	Stream_Read_UINT32(test->irp.output, *FileId);
+	return *FileId != 0;
+}
+
+static TEST_IRP* test_read(DEVMAN* devman, UINT32 FileId, UINT64 Offset, UINT32 Length)
+{
+	TEST_IRP* test = test_irp_new(devman, FileId, IRP_MJ_READ, 32);
+
+	if (!test)
+		return NULL;
+
+	Stream_Write_UINT32(test->irp.input, Length);
+	Stream_Write_UINT64(test->irp.input, Offset);
+	Stream_Zero(test->irp.input, 20); /* Padding */
+	return test_irp_submit(test);
+}
+
+/* the read returned the expected bytes, short at the end of the file */
+static BOOL test_read_done(TEST_IRP* test, const BYTE* expected, UINT64 Offset, UINT32 Length)
+{
+	UINT32 read;
+	const UINT64 available = (Offset < TEST_FILE_SIZE) ? (TEST_FILE_SIZE - Offset) : 0;
+
+	if (!test_irp_wait(test) || (Stream_GetRemainingLength(test->irp.output) < 4))
+		return FALSE;
+
+	Stream_Read_UINT32(test->irp.output, read);
+
+	if ((read != MIN(Length, available)) || (Stream_GetRemainingLength(test->irp.output) < read))
+	{
+		fprintf(stderr, "read at %" PRIu64 ": %" PRIu32 " bytes returned\n", Offset, read);
+		return FALSE;
+	}
+
+	if (memcmp(Stream_Pointer(test->irp.output), &expected[Offset], read) != 0)
+	{
+		fprintf(stderr, "read at %" PRIu64 ": data differs from the file\n", Offset);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static TEST_IRP* test_write(DEVMAN* devman, UINT32 FileId, UINT64 Offset, const BYTE* data,
+                            UINT32 Length)
+{
+	TEST_IRP* test = test_irp_new(devman, FileId, IRP_MJ_WRITE, 32 + Length);
+
+	if (!test)
+		return NULL;
+
+	Stream_Write_UINT32(test->irp.input, Length);
+	Stream_Write_UINT64(test->irp.input, Offset);
+	Stream_Zero(test->irp.input, 20); /* Padding */
+	Stream_Write(test->irp.input, data, Length);
+	return test_irp_submit(test);
+}
+
+static BOOL test_written(TEST_IRP* test, UINT32 Length)
+{
+	UINT32 written;
+
+	if (!test_irp_wait(test) || (Stream_GetRemainingLength(test->irp.output) < 4))
+		return FALSE;
+
+	Stream_Read_UINT32(test->irp.output, written);
+	return written == Length;
+}
+
+static TEST_IRP* test_close(DEVMAN* devman, UINT32 FileId)
+{
+	TEST_IRP* test = test_irp_new(devman, FileId, IRP_MJ_CLOSE, 32);
+
+	if (!test)
+		return NULL;
+
+	Stream_Zero(test->irp.input, 32); /* Padding */
+	return test_irp_submit(test);
+}
+
+/* pseudo random bytes, a mix up of the read offsets shows as a difference */
+static void test_fill(BYTE* data, size_t size, UINT32 seed)
+{
+	size_t i;
+
+	for (i = 0; i < size; i++)
+	{
+		seed = seed * 1103515245 + 12345;
+		data[i] = (BYTE)(seed >> 16);
+	}
+}
+
+static BOOL test_file_contents(const char* path, const BYTE* expected)
+{
+	BOOL rc = FALSE;
+	BYTE* data = (BYTE*)malloc(TEST_FILE_SIZE + 1);
+	FILE* fp = winpr_fopen(path, "rb");
+
+	if (fp && data)
+		rc = (fread(data, 1, TEST_FILE_SIZE + 1, fp) == TEST_FILE_SIZE) &&
+		     (memcmp(data, expected, TEST_FILE_SIZE) == 0);
+
+	if (!rc)
+		fprintf(stderr, "%s: contents differ from the expected data\n", path);
+
+	if (fp)
+		fclose(fp);
+
+	free(data);
+	return rc;
+}
+
+/**
+ * Two handles read the whole file with all IRPs in flight at once. The drive runs the IRPs of
+ * each file in order, with the read ahead of one file overlapping the reads of the other.
+ */
+
+static BOOL test_pipelined(DEVMAN* devman, const BYTE* data)
+{
+	size_t i, j;
+	BOOL rc = FALSE;
+	UINT32 ids[2] = { 0 };
+	TEST_IRP* creates[2] = { 0 };
+	TEST_IRP* closes[2] = { 0 };
+	const UINT32 lengths[2] = { TEST_READ_LENGTH, 40000 };
+	const size_t count = TEST_FILE_SIZE / 40000 + 1;
+	TEST_IRP** reads = (TEST_IRP**)calloc(2 * count, sizeof(TEST_IRP*));
+
+	if (!reads)
+		return FALSE;
+
+	for (i = 0; i < 2; i++)
+		creates[i] = test_create(devman, "\\data.bin", GENERIC_READ);
+
+	for (i = 0; i < 2; i++)
+	{
+		if (!test_created(creates[i], &ids[i]))
+			goto fail;
+	}
+
+	if (ids[0] == ids[1])
+		goto fail;
+
+	for (j = 0; j < count; j++)
+	{
+		for (i = 0; i < 2; i++)
+		{
+			if ((j * lengths[i] < TEST_FILE_SIZE) &&
+			    !(reads[i * count + j] = test_read(devman, ids[i], j * lengths[i], lengths[i])))
+				goto fail;
+		}
+	}
+
+	for (i = 0; i < 2; i++)
+		closes[i] = test_close(devman, ids[i]);
+
+	for (i = 0; i < 2; i++)
+	{
+		LONG order = 0;
+
+		for (j = 0; (j < count) && reads[i * count + j]; j++)
+		{
+			TEST_IRP* read = reads[i * count + j];
+
+			if (!test_read_done(read, data, j * lengths[i], lengths[i]))
+				goto fail;
+
+			if (read->order <= order)
+			{
+				fprintf(stderr, "file %" PRIu32 ": read %" PRIuz " completed out of order\n",
+				        ids[i], j);
+				goto fail;
+			}
+
+			order = read->order;
+		}
+
+		if (!test_irp_wait(closes[i]) || (closes[i]->order <= order))
+			goto fail;
+	}
+
+	rc = TRUE;
+fail:
+	/* after a failure IRPs may still be in flight, they are left to the process exit */
+	if (rc)
+	{
+		for (i = 0; i < 2; i++)
+		{
+			test_irp_free(creates[i]);
+			test_irp_free(closes[i]);
+		}
+
+		for (i = 0; i < 2 * count; i++)
+			test_irp_free(reads[i]);
+
+		free(reads);
+	}
+
+	return rc;
+}
+
+/**
+ * A second handle writes the file while the first one reads ahead, once after the read ahead
+ * and once racing it. The reads that follow return the written data.
+ */
+
+static BOOL test_write_read_ahead(DEVMAN* devman, BYTE* data)
+{
+	size_t i;
+	UINT32 reader = 0;
+	UINT32 writer = 0;
+	BYTE update[1000];
+	TEST_IRP* irps[12] = { 0 };
+	const UINT64 first = DRIVE_FILE_READ_AHEAD_SIZE / 2 + 100;
+	const UINT64 second = DRIVE_FILE_READ_AHEAD_SIZE - 1000;
+
+	irps[0] = test_create(devman, "\\data.bin", GENERIC_READ);
+	irps[1] = test_create(devman, "\\data.bin", GENERIC_READ | GENERIC_WRITE);
+
+	if (!test_created(irps[0], &reader) || !test_created(irps[1], &writer))
+		return FALSE;
+
+	/* the read ahead follows the second read, the third one is served from it */
+	for (i = 0; i < 3; i++)
+	{
+		const UINT64 offset = i * TEST_READ_LENGTH;
+		irps[2 + i] = test_read(devman, reader, offset, TEST_READ_LENGTH);
+
+		if (!test_read_done(irps[2 + i], data, offset, TEST_READ_LENGTH))
+			return FALSE;
+	}
+
+	test_fill(update, sizeof(update), 1);
+	CopyMemory(&data[first], update, sizeof(update));
+	irps[5] = test_write(devman, writer, first, update, sizeof(update));
+
+	if (!test_written(irps[5], sizeof(update)))
+		return FALSE;
+
+	irps[6] = test_read(devman, reader, 3 * TEST_READ_LENGTH, 2 * TEST_READ_LENGTH);
+
+	if (!test_read_done(irps[6], data, 3 * TEST_READ_LENGTH, 2 * TEST_READ_LENGTH))
+		return FALSE;
+
+	/* the write is queued while the read before it is followed by the next read ahead */
+	test_fill(update, sizeof(update), 2);
+	irps[7] = test_read(devman, reader, 5 * TEST_READ_LENGTH, TEST_READ_LENGTH);
+	irps[8] = test_write(devman, writer, second, update, sizeof(update));
+
+	if (!test_read_done(irps[7], data, 5 * TEST_READ_LENGTH, TEST_READ_LENGTH) ||
+	    !test_written(irps[8], sizeof(update)))
+		return FALSE;
+
+	CopyMemory(&data[second], update, sizeof(update));
+	irps[9] = test_read(devman, reader, 6 * TEST_READ_LENGTH, 4 * TEST_READ_LENGTH);
+
+	if (!test_read_done(irps[9], data, 6 * TEST_READ_LENGTH, 4 * TEST_READ_LENGTH))
+		return FALSE;
+
+	irps[10] = test_close(devman, reader);
+	irps[11] = test_close(devman, writer);
+
+	if (!test_irp_wait(irps[10]) || !test_irp_wait(irps[11]))
+		return FALSE;
+
+	for (i = 0; i < ARRAYSIZE(irps); i++)
+		test_irp_free(irps[i]);
+
+	return TRUE;
+}
+
+int TestDriveIrp(int argc, char* argv[])
+{
+	int rc = -1;
+	char name[64];
+	char path[MAX_PATH];
+	char* root = NULL;
+	BYTE* data = NULL;
+	FILE* fp = NULL;
+	DEVMAN devman = { 0 };
+	RDPDR_DRIVE drive = { 0 };
+	DEVICE_SERVICE_ENTRY_POINTS entryPoints = { 0 };
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+	sprintf_s(name, sizeof(name), "TestDriveIrp-%" PRIu32 "-%" PRIu64, GetCurrentProcessId(),
+	          GetTickCount64());
+	root = GetKnownSubPath(KNOWN_PATH_TEMP, name);
+
+	if (!root)
+		return -1;
+
+	sprintf_s(path, sizeof(path), "%s/data.bin", root);
+	data = (BYTE*)malloc(TEST_FILE_SIZE);
+
+	if (!data || !winpr_PathMakePath(root, NULL) || !(fp = winpr_fopen(path, "wb")))
+		goto fail;
+
+	test_fill(data, TEST_FILE_SIZE, 0);
+
+	if (fwrite(data, 1, TEST_FILE_SIZE, fp) != TEST_FILE_SIZE)
+		goto fail;
+
+	fclose(fp);
+	fp = NULL;
+	devman.id_sequence = 1;
+	drive.Type = RDPDR_DTYP_FILESYSTEM;
+	drive.Name = name;
+	drive.Path = root;
+	entryPoints.devman = &devman;
+	entryPoints.RegisterDevice = test_register_device;
+	entryPoints.device = (RDPDR_DEVICE*)&drive;
+
+	if ((DeviceServiceEntry(&entryPoints) != CHANNEL_RC_OK) || !test_device)
+		goto fail;
+
+	if (!test_pipelined(&devman, data) || !test_write_read_ahead(&devman, data))
+		goto fail;
+
+	if (!test_file_contents(path, data))
+		goto fail;
+
+	rc = 0;
+fail:
+	if (test_device)
+		test_device->Free(test_device);
+
+	if (fp)
+		fclose(fp);
+
+	DeleteFileA(path);
+	RemoveDirectoryA(root);
+	free(data);
+	free(root);
+	return rc;
+}
@@ -39,6 +39,7 @@
 
 #include <freerdp/addin.h>
 #include <freerdp/channels/log.h>
+#include <freerdp/utils/session_dump.h>
 
 #include "rdpgfx_common.h"
 #include "rdpgfx_codec.h"
@@ -556,6 +557,164 @@ fail:
 	return error;
 }
 
+static BOOL rdpgfx_persistent_cache_enabled(RDPGFX_PLUGIN* gfx)
+{
+	return gfx->settings->BitmapCachePersistEnabled && gfx->settings->GfxCachePersistFile;
+}
+
+/**
+ * Offers the entries saved by a previous session. The cache import reply lists the slot the
+ * server assigned to each offered entry in offer order, which is the order of the file.
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT rdpgfx_send_cache_offer(RDPGFX_PLUGIN* gfx)
+{
+	UINT error = CHANNEL_RC_OK;
+	PERSISTENT_CACHE_ENTRY entry;
+	RDPGFX_CACHE_IMPORT_OFFER_PDU pdu = { 0 };
+	rdpPersistentCache* persistent;
+	RdpgfxClientContext* context = (RdpgfxClientContext*)gfx->iface.pInterface;
+
+	if (!context || !rdpgfx_persistent_cache_enabled(gfx))
+		return CHANNEL_RC_OK;
+
+	persistent = persistent_cache_new();
+
+	if (!persistent)
+		return CHANNEL_RC_NO_MEMORY;
+
+	/* Nothing to offer until a session saved the cache */
+	if (!persistent_cache_open(persistent, gfx->settings->GfxCachePersistFile, FALSE))
+		goto out;
+
+	pdu.cacheEntries = (RDPGFX_CACHE_ENTRY_METADATA*)calloc(RDPGFX_CACHE_ENTRY_MAX_COUNT,
+	                                                        sizeof(RDPGFX_CACHE_ENTRY_METADATA));
+
+	if (!pdu.cacheEntries)
+	{
+		error = CHANNEL_RC_NO_MEMORY;
+		goto out;
+	}
+
+	while ((pdu.cacheEntriesCount < RDPGFX_CACHE_ENTRY_MAX_COUNT - 1) &&
+	       persistent_cache_read_entry(persistent, &entry, FALSE))
+	{
+		RDPGFX_CACHE_ENTRY_METADATA* metadata = &pdu.cacheEntries[pdu.cacheEntriesCount++];
+		metadata->cacheKey = entry.key64;
+		metadata->bitmapLength = entry.size;
+	}
+
+	DEBUG_RDPGFX(gfx->log, "offering %" PRIu16 " cache entries from %s", pdu.cacheEntriesCount,
+	             gfx->settings->GfxCachePersistFile);
+
+	if (pdu.cacheEntriesCount > 0)
+		error = IFCALLRESULT(ERROR_BAD_CONFIGURATION, context->CacheImportOffer, context, &pdu);
+
+out:
+	free(pdu.cacheEntries);
+	persistent_cache_free(persistent);
+	return error;
+}
+
+/**
+ * Function description
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT rdpgfx_load_cache_import_reply(RDPGFX_PLUGIN* gfx,
+                                           const RDPGFX_CACHE_IMPORT_REPLY_PDU* pdu)
+{
+	UINT16 index;
+	UINT error = CHANNEL_RC_OK;
+	PERSISTENT_CACHE_ENTRY entry;
+	rdpPersistentCache* persistent;
+	RdpgfxClientContext* context = (RdpgfxClientContext*)gfx->iface.pInterface;
+
+	if (!context || !context->ImportCacheEntry || !rdpgfx_persistent_cache_enabled(gfx))
+		return CHANNEL_RC_OK;
+
+	persistent = persistent_cache_new();
+
+	if (!persistent)
+		return CHANNEL_RC_NO_MEMORY;
+
+	if (!persistent_cache_open(persistent, gfx->settings->GfxCachePersistFile, FALSE))
+		goto out;
+
+	for (index = 0; index < pdu->importedEntriesCount; index++)
+	{
+		const UINT16 cacheSlot = pdu->cacheSlots[index];
+
+		/* Entries the server declined are skipped without reading their pixels */
+		if (!persistent_cache_read_entry(persistent, &entry, cacheSlot != 0))
+			break;
+
+		if (cacheSlot == 0)
+			continue;
+
+		error = context->ImportCacheEntry(context, cacheSlot, &entry);
+
+		if (error != CHANNEL_RC_OK)
+			break;
+	}
+
+out:
+	persistent_cache_free(persistent);
+	return error;
+}
+
+static void rdpgfx_save_persistent_cache(RDPGFX_PLUGIN* gfx)
+{
+	UINT16 index;
+	UINT32 count = 0;
+	BOOL cached = FALSE;
+	rdpPersistentCache* persistent;
+	RdpgfxClientContext* context = (RdpgfxClientContext*)gfx->iface.pInterface;
+
+	if (!context || !context->ExportCacheEntry || !rdpgfx_persistent_cache_enabled(gfx))
+		return;
+
+	/* Keep the previous file if the slots were already evicted */
+	for (index = 0; (index < gfx->MaxCacheSlots) && !cached; index++)
+		cached = gfx->CacheSlots[index] != NULL;
+
+	if (!cached)
+		return;
+
+	persistent = persistent_cache_new();
+
+	if (!persistent || !persistent_cache_open(persistent, gfx->settings->GfxCachePersistFile, TRUE))
+	{
+		persistent_cache_free(persistent);
+		return;
+	}
+
+	for (index = 0; (index < gfx->MaxCacheSlots) && (count < RDPGFX_CACHE_ENTRY_MAX_COUNT - 1);
+	     index++)
+	{
+		PERSISTENT_CACHE_ENTRY entry = { 0 };
+		const UINT16 cacheSlot = index + 1;
+
+		if (!gfx->CacheSlots[index])
+			continue;
+
+		if (context->ExportCacheEntry(context, cacheSlot, &entry) != CHANNEL_RC_OK)
+			continue;
+
+		entry.cacheIndex = cacheSlot;
+
+		if (persistent_cache_write_entry(persistent, &entry))
+			count++;
+
+		free(entry.data);
+	}
+
+	DEBUG_RDPGFX(gfx->log, "saved %" PRIu32 " cache entries to %s", count,
+	             gfx->settings->GfxCachePersistFile);
+	persistent_cache_free(persistent);
+}
+
 /**
  * Function description
  *
@@ -702,6 +861,13 @@ static UINT rdpgfx_recv_cache_import_reply_pdu(RDPGFX_CHANNEL_CALLBACK* callback
 
 	Stream_Read_UINT16(s, pdu.importedEntriesCount); /* cacheSlot (2 bytes) */
 
+	if (pdu.importedEntriesCount >= RDPGFX_CACHE_ENTRY_MAX_COUNT)
+	{
+		WLog_Print(gfx->log, WLOG_ERROR, "invalid importedEntriesCount: %" PRIu16 "",
+		           pdu.importedEntriesCount);
+		return ERROR_INVALID_DATA;
+	}
+
 	if (Stream_GetRemainingLength(s) < (size_t)(pdu.importedEntriesCount * 2))
 	{
 		WLog_Print(gfx->log, WLOG_ERROR, "not enough data!");
@@ -724,6 +890,14 @@ static UINT rdpgfx_recv_cache_import_reply_pdu(RDPGFX_CHANNEL_CALLBACK* callback
 	DEBUG_RDPGFX(gfx->log, "RecvCacheImportReplyPdu: importedEntriesCount: %" PRIu16 "",
 	             pdu.importedEntriesCount);
 
+	if ((error = rdpgfx_load_cache_import_reply(gfx, &pdu)))
+	{
+		WLog_Print(gfx->log, WLOG_ERROR,
+		           "rdpgfx_load_cache_import_reply failed with error %" PRIu32 "", error);
+		free(pdu.cacheSlots);
+		return error;
+	}
+
 	if (context)
 	{
 		IFCALLRET(context->CacheImportReply, error, context, &pdu);
@@ -1718,6 +1892,9 @@ static UINT rdpgfx_recv_pdu(RDPGFX_CHANNEL_CALLBACK* callback, wStream* s)
 			if ((error = rdpgfx_recv_caps_confirm_pdu(callback, s)))
 				WLog_Print(gfx->log, WLOG_ERROR,
 				           "rdpgfx_recv_caps_confirm_pdu failed with error %" PRIu32 "!", error);
+			else if ((error = rdpgfx_send_cache_offer(gfx)))
+				WLog_Print(gfx->log, WLOG_ERROR,
+				           "rdpgfx_send_cache_offer failed with error %" PRIu32 "!", error);
 
 			break;
 
@@ -1786,6 +1963,8 @@ static UINT rdpgfx_on_data_received(IWTSVirtualChannelCallback* pChannelCallback
 	RDPGFX_CHANNEL_CALLBACK* callback = (RDPGFX_CHANNEL_CALLBACK*)pChannelCallback;
 	RDPGFX_PLUGIN* gfx = (RDPGFX_PLUGIN*)callback->plugin;
 	UINT error = CHANNEL_RC_OK;
+	freerdp_session_dump(gfx->rdpcontext, SESSION_DUMP_GFX, Stream_Pointer(data),
+	                     Stream_GetRemainingLength(data));
 	status = zgfx_decompress(gfx->zgfx, Stream_Pointer(data), Stream_GetRemainingLength(data),
 	                         &pDstData, &DstSize, 0);
 
@@ -1858,6 +2037,7 @@ static UINT rdpgfx_on_close(IWTSVirtualChannelCallback* pChannelCallback)
 	RdpgfxClientContext* context = (RdpgfxClientContext*)gfx->iface.pInterface;
 
 	DEBUG_RDPGFX(gfx->log, "OnClose");
+	rdpgfx_save_persistent_cache(gfx);
 	free_surfaces(context, gfx->SurfaceTable);
 	evict_cache_slots(context, gfx->MaxCacheSlots, gfx->CacheSlots);
 
@@ -2162,6 +2342,7 @@ void rdpgfx_client_context_free(RdpgfxClientContext* context)
 
 	gfx = (RDPGFX_PLUGIN*)context->handle;
 
+	rdpgfx_save_persistent_cache(gfx);
 	free_surfaces(context, gfx->SurfaceTable);
 	evict_cache_slots(context, gfx->MaxCacheSlots, gfx->CacheSlots);
 
@@ -1129,7 +1129,7 @@ static UINT rdpgfx_recv_cache_import_offer_pdu(RdpgfxServerContext* context, wSt
 	Stream_Read_UINT16(s, pdu.cacheEntriesCount);
 
 	/* 2.2.2.16 RDPGFX_CACHE_IMPORT_OFFER_PDU */
-	if (pdu.cacheEntriesCount >= 5462)
+	if (pdu.cacheEntriesCount >= RDPGFX_CACHE_ENTRY_MAX_COUNT)
 	{
 		WLog_ERR(TAG, "Invalid cacheEntriesCount: %" PRIu16 "", pdu.cacheEntriesCount);
 		return ERROR_INVALID_DATA;
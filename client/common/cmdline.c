@@ -1569,6 +1569,49 @@ static BOOL parseSizeValue(const char* input, unsigned long* v1, unsigned long*
 	return TRUE;
 }
 
+static BOOL freerdp_client_set_default_cache_file(rdpSettings* settings, size_t id,
+                                                 const char* name)
+{
+	BOOL rc;
+	char* path;
+
+	if (freerdp_settings_get_string(settings, id) || !settings->ConfigPath)
+		return TRUE;
+
+	path = GetCombinedPath(settings->ConfigPath, name);
+
+	if (!path)
+		return FALSE;
+
+	rc = freerdp_settings_set_string(settings, id, path);
+	free(path);
+	return rc;
+}
+
+static BOOL freerdp_client_set_persistent_cache(rdpSettings* settings, BOOL enable,
+                                                const char* file)
+{
+	UINT32 x;
+
+	settings->BitmapCachePersistEnabled = enable;
+
+	for (x = 0; x < 5; x++)
+		settings->BitmapCacheV2CellInfo[x].persistent = enable;
+
+	if (file && !freerdp_settings_set_string(settings, FreeRDP_BitmapCachePersistFile, file))
+		return FALSE;
+
+	if (!enable)
+		return TRUE;
+
+	if (!freerdp_client_set_default_cache_file(settings, FreeRDP_BitmapCachePersistFile,
+	                                           "bmpcache.bmc"))
+		return FALSE;
+
+	return freerdp_client_set_default_cache_file(settings, FreeRDP_GfxCachePersistFile,
+	                                             "gfxcache.bmc");
+}
+
 static BOOL prepare_default_settings(rdpSettings* settings, const COMMAND_LINE_ARGUMENT_A* args,
                                      BOOL rdp_file)
 {
@@ -3087,6 +3130,16 @@ int freerdp_client_settings_parse_command_line_arguments(rdpSettings* settings,
 		{
 			settings->BitmapCacheEnabled = enable;
 		}
+		CommandLineSwitchCase(arg, "persist-cache")
+		{
+			if (!freerdp_client_set_persistent_cache(settings, enable, NULL))
+				return COMMAND_LINE_ERROR_MEMORY;
+		}
+		CommandLineSwitchCase(arg, "persist-cache-file")
+		{
+			if (!freerdp_client_set_persistent_cache(settings, TRUE, arg->Value))
+				return COMMAND_LINE_ERROR_MEMORY;
+		}
 		CommandLineSwitchCase(arg, "offscreen-cache")
 		{
 			settings->OffscreenSupportLevel = (UINT32)enable;
@@ -3166,11 +3219,20 @@ int freerdp_client_settings_parse_command_line_arguments(rdpSettings* settings,
 		{
 			settings->AsyncChannels = enable;
 		}
+		CommandLineSwitchCase(arg, "async-transport")
+		{
+			settings->AsyncTransport = enable;
+		}
 		CommandLineSwitchCase(arg, "wm-class")
 		{
 			if (!copy_value(arg->Value, &settings->WmClass))
 				return COMMAND_LINE_ERROR_MEMORY;
 		}
+		CommandLineSwitchCase(arg, "dump-session")
+		{
+			if (!copy_value(arg->Value, &settings->DumpSessionFile))
+				return COMMAND_LINE_ERROR_MEMORY;
+		}
 		CommandLineSwitchCase(arg, "play-rfx")
 		{
 			if (!copy_value(arg->Value, &settings->PlayRemoteFxFile))
@@ -23,6 +23,8 @@ else()
 	option(WITH_SSE2 "Enable SSE2 optimization." OFF)
 endif()
 
+cmake_dependent_option(WITH_AVX2 "Enable AVX2 optimization (runtime dispatched)." ON "WITH_SSE2" OFF)
+
 if(TARGET_ARCH MATCHES "ARM")
 	if (NOT DEFINED WITH_NEON)
 		option(WITH_NEON "Enable NEON optimization." ON)
@@ -80,6 +82,7 @@ option(BUILTIN_CHANNELS "Combine all channels into their respective base library
 option(WITH_CHANNELS "Build virtual channel plugins" ON)
 
 option(WITH_WINPR_TOOLS "Build WinPR helper binaries" ON)
+option(WITH_TOOLS "Build FreeRDP developer tools (benchmarks)" OFF)
 
 CMAKE_DEPENDENT_OPTION(WITH_CLIENT_CHANNELS "Build virtual channel plugins" ON
 	"WITH_CLIENT_COMMON;WITH_CHANNELS" OFF)
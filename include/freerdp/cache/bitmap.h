@@ -56,6 +56,7 @@ struct rdp_bitmap_cache
 	rdpUpdate* update;
 	rdpContext* context;
 	rdpSettings* settings;
+	BOOL persistentLoaded;
 };
 
 #ifdef __cplusplus
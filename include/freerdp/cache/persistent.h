@@ -0,0 +1,76 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Persistent Bitmap Cache
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_PERSISTENT_CACHE_H
+#define FREERDP_PERSISTENT_CACHE_H
+
+#include <freerdp/api.h>
+#include <freerdp/types.h>
+
+typedef struct rdp_persistent_cache rdpPersistentCache;
+
+#define PERSISTENT_CACHE_VERSION 3
+
+/* Largest bitmap accepted from a cache file, in pixels per side */
+#define PERSISTENT_CACHE_MAX_DIMENSION 4096
+
+struct _PERSISTENT_CACHE_ENTRY
+{
+	UINT64 key64;
+	UINT16 width;
+	UINT16 height;
+	UINT16 cacheId;
+	UINT16 cacheIndex;
+	UINT32 size;
+	BYTE* data; /* PIXEL_FORMAT_BGRA32, top-down, width * height * 4 bytes */
+};
+typedef struct _PERSISTENT_CACHE_ENTRY PERSISTENT_CACHE_ENTRY;
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+	/**
+	 * Opens a cache file. Files written by another version are rejected when reading.
+	 * A file opened for writing replaces the existing one on persistent_cache_close().
+	 */
+	FREERDP_API BOOL persistent_cache_open(rdpPersistentCache* persistent, const char* filename,
+	                                       BOOL write);
+	FREERDP_API BOOL persistent_cache_close(rdpPersistentCache* persistent);
+
+	FREERDP_API UINT32 persistent_cache_get_version(rdpPersistentCache* persistent);
+	FREERDP_API UINT32 persistent_cache_get_count(rdpPersistentCache* persistent);
+
+	/**
+	 * Reads the next entry. entry->data points to memory owned by the cache, which stays
+	 * valid until the next read. With withData set to FALSE the pixels are skipped and
+	 * entry->data is NULL.
+	 */
+	FREERDP_API BOOL persistent_cache_read_entry(rdpPersistentCache* persistent,
+	                                             PERSISTENT_CACHE_ENTRY* entry, BOOL withData);
+	FREERDP_API BOOL persistent_cache_write_entry(rdpPersistentCache* persistent,
+	                                              const PERSISTENT_CACHE_ENTRY* entry);
+
+	FREERDP_API rdpPersistentCache* persistent_cache_new(void);
+	FREERDP_API void persistent_cache_free(rdpPersistentCache* persistent);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FREERDP_PERSISTENT_CACHE_H */
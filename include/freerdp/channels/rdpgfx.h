@@ -334,6 +334,9 @@ struct _RDPGFX_CACHE_ENTRY_METADATA
 };
 typedef struct _RDPGFX_CACHE_ENTRY_METADATA RDPGFX_CACHE_ENTRY_METADATA;
 
+/* [MS-RDPEGFX] 2.2.2.16: cacheEntriesCount MUST be less than 5462 */
+#define RDPGFX_CACHE_ENTRY_MAX_COUNT 5462
+
 struct _RDPGFX_CACHE_IMPORT_OFFER_PDU
 {
 	UINT16 cacheEntriesCount;
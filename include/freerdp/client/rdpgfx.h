@@ -23,6 +23,7 @@
 #define FREERDP_CHANNEL_RDPGFX_CLIENT_RDPGFX_H
 
 #include <freerdp/channels/rdpgfx.h>
+#include <freerdp/cache/persistent.h>
 #include <freerdp/utils/profiler.h>
 
 /**
@@ -59,6 +60,10 @@ typedef UINT (*pcRdpgfxCacheImportReply)(RdpgfxClientContext* context,
                                          const RDPGFX_CACHE_IMPORT_REPLY_PDU* cacheImportReply);
 typedef UINT (*pcRdpgfxEvictCacheEntry)(RdpgfxClientContext* context,
                                         const RDPGFX_EVICT_CACHE_ENTRY_PDU* evictCacheEntry);
+typedef UINT (*pcRdpgfxImportCacheEntry)(RdpgfxClientContext* context, UINT16 cacheSlot,
+                                         const PERSISTENT_CACHE_ENTRY* importCacheEntry);
+typedef UINT (*pcRdpgfxExportCacheEntry)(RdpgfxClientContext* context, UINT16 cacheSlot,
+                                         PERSISTENT_CACHE_ENTRY* exportCacheEntry);
 typedef UINT (*pcRdpgfxMapSurfaceToOutput)(RdpgfxClientContext* context,
                                            const RDPGFX_MAP_SURFACE_TO_OUTPUT_PDU* surfaceToOutput);
 typedef UINT (*pcRdpgfxMapSurfaceToScaledOutput)(
@@ -148,6 +153,10 @@ struct _rdpgfx_client_context
 
 	CRITICAL_SECTION mux;
 	PROFILER_DEFINE(SurfaceProfiler)
+
+	/* Persistent cache, implementations require locking */
+	pcRdpgfxImportCacheEntry ImportCacheEntry;
+	pcRdpgfxExportCacheEntry ExportCacheEntry;
 };
 
 FREERDP_API RdpgfxClientContext* rdpgfx_client_context_new(rdpSettings* settings);
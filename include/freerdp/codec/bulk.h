@@ -36,4 +36,11 @@
 #define L1_COMPRESSED 0x01
 #define L1_INNER_COMPRESSION 0x10
 
+/* Match finder levels of the MPPC and NCrush compressors */
+
+#define BULK_MATCH_LEVEL_LEGACY 0  /* single hash slot, the historic output */
+#define BULK_MATCH_LEVEL_FAST 1    /* single candidate, literal runs are searched sparsely */
+#define BULK_MATCH_LEVEL_DEFAULT 2 /* longer hash chains with lazy matching */
+#define BULK_MATCH_LEVEL_BEST 3    /* deep hash chains with lazy matching */
+
 #endif /* FREERDP_CODEC_BULK_H */
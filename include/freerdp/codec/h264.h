@@ -27,6 +27,7 @@
 #include <freerdp/channels/rdpgfx.h>
 
 typedef struct _H264_CONTEXT H264_CONTEXT;
+typedef struct _H264_CONTEXT_WORKERS H264_CONTEXT_WORKERS;
 
 typedef BOOL (*pfnH264SubsystemInit)(H264_CONTEXT* h264);
 typedef void (*pfnH264SubsystemUninit)(H264_CONTEXT* h264);
@@ -78,6 +79,10 @@ struct _H264_CONTEXT
 
 	void* lumaData;
 	wLog* log;
+
+	/* Split the color conversion of large regions across a thread pool */
+	BOOL UseThreads;
+	H264_CONTEXT_WORKERS* workers;
 };
 #ifdef __cplusplus
 extern "C"
@@ -41,6 +41,8 @@ extern "C"
 
 	FREERDP_API void mppc_set_compression_level(MPPC_CONTEXT* mppc, DWORD CompressionLevel);
 
+	FREERDP_API BOOL mppc_set_match_level(MPPC_CONTEXT* mppc, UINT32 level);
+
 	FREERDP_API void mppc_context_reset(MPPC_CONTEXT* mppc, BOOL flush);
 
 	FREERDP_API MPPC_CONTEXT* mppc_context_new(DWORD CompressionLevel, BOOL Compressor);
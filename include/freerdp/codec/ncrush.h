@@ -39,6 +39,8 @@ extern "C"
 	FREERDP_API int ncrush_decompress(NCRUSH_CONTEXT* ncrush, BYTE* pSrcData, UINT32 SrcSize,
 	                                  BYTE** ppDstData, UINT32* pDstSize, UINT32 flags);
 
+	FREERDP_API BOOL ncrush_set_match_level(NCRUSH_CONTEXT* ncrush, UINT32 level);
+
 	FREERDP_API void ncrush_context_reset(NCRUSH_CONTEXT* ncrush, BOOL flush);
 
 	FREERDP_API NCRUSH_CONTEXT* ncrush_context_new(BOOL Compressor);
@@ -25,6 +25,7 @@
 #include <winpr/crt.h>
 
 typedef struct _BITMAP_PLANAR_CONTEXT BITMAP_PLANAR_CONTEXT;
+typedef struct _BITMAP_PLANAR_WORKERS BITMAP_PLANAR_WORKERS;
 
 #include <freerdp/codec/color.h>
 #include <freerdp/codec/bitmap.h>
@@ -73,6 +74,18 @@ struct _RDP6_BITMAP_STREAM
 };
 typedef struct _RDP6_BITMAP_STREAM RDP6_BITMAP_STREAM;
 
+struct _PLANAR_TILE
+{
+	UINT32 nXSrc;
+	UINT32 nYSrc;
+	UINT32 nWidth;
+	UINT32 nHeight;
+
+	BYTE* pDstData;
+	UINT32 DstSize; /* in: size of pDstData, out: size of the planar bitmap */
+};
+typedef struct _PLANAR_TILE PLANAR_TILE;
+
 struct _BITMAP_PLANAR_CONTEXT
 {
 	UINT32 maxWidth;
@@ -99,6 +112,8 @@ struct _BITMAP_PLANAR_CONTEXT
 	UINT32 nTempStep;
 
 	BOOL bgr;
+
+	BITMAP_PLANAR_WORKERS* workers;
 };
 
 #ifdef __cplusplus
@@ -111,6 +126,11 @@ extern "C"
 	                                                 UINT32 height, UINT32 scanline, BYTE* dstData,
 	                                                 UINT32* pDstSize);
 
+	FREERDP_API BOOL freerdp_bitmap_planar_compress_tiles(BITMAP_PLANAR_CONTEXT* context,
+	                                                      const BYTE* data, UINT32 format,
+	                                                      UINT32 scanline, PLANAR_TILE* tiles,
+	                                                      UINT32 numTiles);
+
 	FREERDP_API BOOL freerdp_bitmap_planar_context_reset(BITMAP_PLANAR_CONTEXT* context,
 	                                                     UINT32 width, UINT32 height);
 
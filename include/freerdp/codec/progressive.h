@@ -48,6 +48,12 @@ extern "C"
 	                                        UINT32 Height, UINT32 ScanLine,
 	                                        const REGION16* invalidRegion, BYTE** ppDstData,
 	                                        UINT32* pDstSize);
+	FREERDP_API int progressive_compress_surface(PROGRESSIVE_CONTEXT* progressive,
+	                                             UINT16 surfaceId, const BYTE* pSrcData,
+	                                             UINT32 SrcSize, UINT32 SrcFormat, UINT32 Width,
+	                                             UINT32 Height, UINT32 ScanLine,
+	                                             const REGION16* invalidRegion, BYTE** ppDstData,
+	                                             UINT32* pDstSize);
 #if !defined(DEFINE_NO_DEPRECATED)
 	FREERDP_API WINPR_DEPRECATED(INT32 progressive_decompress(
 	    PROGRESSIVE_CONTEXT* progressive, const BYTE* pSrcData, UINT32 SrcSize, BYTE* pDstData,
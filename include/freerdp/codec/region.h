@@ -125,6 +125,20 @@ extern "C"
 	FREERDP_API BOOL region16_union_rect(REGION16* dst, const REGION16* src,
 	                                     const RECTANGLE_16* rect);
 
+	/** adds several rectangles in src and stores the resulting region in dst.
+	 * The region is rebuilt once for all rectangles, which is much cheaper than
+	 * calling region16_union_rect for each of them. Each band of the result costs
+	 * the number of rectangles spanning it, so many tall overlapping rectangles
+	 * are still quadratic.
+	 * @param dst destination region
+	 * @param src source region
+	 * @param rects the rectangles to add, they may overlap each other
+	 * @param count the number of rectangles
+	 * @return if the operation was successful (false meaning out-of-memory)
+	 */
+	FREERDP_API BOOL region16_union_rects(REGION16* dst, const REGION16* src,
+	                                      const RECTANGLE_16* rects, UINT32 count);
+
 	/** returns if a rectangle intersects the region
 	 * @param src the region
 	 * @param arg2 the rectangle
@@ -120,6 +120,15 @@ extern "C"
 	};
 	typedef enum _RFX_STATE RFX_STATE;
 
+	enum _RFX_SIMD
+	{
+		RFX_SIMD_GENERIC,
+		RFX_SIMD_SSE2,
+		RFX_SIMD_AVX2,
+		RFX_SIMD_NEON
+	};
+	typedef enum _RFX_SIMD RFX_SIMD;
+
 #define _RFX_DECODED_SYNC 0x00000001
 #define _RFX_DECODED_CONTEXT 0x00000002
 #define _RFX_DECODED_VERSIONS 0x00000004
@@ -208,6 +217,12 @@ extern "C"
 	FREERDP_API RFX_CONTEXT* rfx_context_new(BOOL encoder);
 	FREERDP_API void rfx_context_free(RFX_CONTEXT* context);
 
+	/**
+	 * Replace the automatically selected encode/decode kernels with the given instruction set.
+	 * Returns FALSE if it was not compiled in or is not supported by the CPU.
+	 */
+	FREERDP_API BOOL rfx_context_set_simd(RFX_CONTEXT* context, RFX_SIMD simd);
+
 #ifdef __cplusplus
 }
 #endif
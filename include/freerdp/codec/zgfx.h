@@ -49,6 +49,12 @@ extern "C"
 
 	FREERDP_API void zgfx_context_reset(ZGFX_CONTEXT* zgfx, BOOL flush);
 
+	/**
+	 * Selects the speed/ratio trade-off of the compressor, from 0 (segments are sent
+	 * uncompressed) to 9 (longest match search). The default is 4.
+	 */
+	FREERDP_API BOOL zgfx_context_set_compression_level(ZGFX_CONTEXT* zgfx, UINT32 level);
+
 	FREERDP_API ZGFX_CONTEXT* zgfx_context_new(BOOL Compressor);
 	FREERDP_API void zgfx_context_free(ZGFX_CONTEXT* zgfx);
 
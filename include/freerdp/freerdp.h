@@ -477,6 +477,12 @@ extern "C"
 	FREERDP_API BOOL freerdp_get_stats(rdpRdp* rdp, UINT64* inBytes, UINT64* outBytes,
 	                                   UINT64* inPackets, UINT64* outPackets);
 
+	/* Record data of the given SESSION_DUMP_* type if the session is being dumped */
+	FREERDP_API BOOL freerdp_session_dump(rdpContext* context, BYTE type, const BYTE* data,
+	                                      size_t length);
+	/* Decode recorded fastpath updates without a connection, for offline replay */
+	FREERDP_API int freerdp_session_replay_fastpath(rdpContext* context, wStream* s);
+
 	FREERDP_API void freerdp_get_version(int* major, int* minor, int* revision);
 	FREERDP_API const char* freerdp_get_version_string(void);
 	FREERDP_API const char* freerdp_get_build_date(void);
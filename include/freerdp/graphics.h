@@ -69,7 +69,8 @@ extern "C"
 
 		BOOL compressed;          /* 32 */
 		BOOL ephemeral;           /* 33 */
-		UINT32 paddingC[64 - 34]; /* 34 */
+		UINT64 key64;             /* 34 */
+		UINT32 paddingC[64 - 36]; /* 36 */
 	};
 
 	FREERDP_API rdpBitmap* Bitmap_Alloc(rdpContext* context);
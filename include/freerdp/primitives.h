@@ -83,6 +83,11 @@ typedef pstatus_t (*__copy_8u_t)(const BYTE* pSrc, BYTE* pDst, INT32 len);
 typedef pstatus_t (*__copy_8u_AC4r_t)(const BYTE* pSrc, INT32 srcStep, /* bytes */
                                       BYTE* pDst, INT32 dstStep,       /* bytes */
                                       INT32 width, INT32 height);      /* pixels */
+typedef pstatus_t (*__copy_no_overlap_t)(BYTE* pDstData, DWORD DstFormat, UINT32 nDstStep,
+                                         UINT32 nXDst, UINT32 nYDst, UINT32 nWidth, UINT32 nHeight,
+                                         const BYTE* pSrcData, DWORD SrcFormat, UINT32 nSrcStep,
+                                         UINT32 nXSrc, UINT32 nYSrc, const gdiPalette* palette,
+                                         UINT32 flags);
 typedef pstatus_t (*__set_8u_t)(BYTE val, BYTE* pDst, UINT32 len);
 typedef pstatus_t (*__set_32s_t)(INT32 val, INT32* pDst, UINT32 len);
 typedef pstatus_t (*__set_32u_t)(UINT32 val, UINT32* pDst, UINT32 len);
@@ -188,6 +193,8 @@ typedef struct
 	/* flags */
 	DWORD flags;
 	primitives_uninit_t uninit;
+	/* Pixel copy with format conversion, source and destination must not overlap */
+	__copy_no_overlap_t copy_no_overlap;
 } primitives_t;
 
 typedef enum
@@ -710,6 +710,7 @@ typedef struct _RDPDR_PARALLEL RDPDR_PARALLEL;
 #define FreeRDP_AsyncInput (1544)
 #define FreeRDP_AsyncUpdate (1545)
 #define FreeRDP_AsyncChannels (1546)
+#define FreeRDP_AsyncTransport (1547)
 #define FreeRDP_ToggleFullscreen (1548)
 #define FreeRDP_WmClass (1549)
 #define FreeRDP_EmbeddedWindow (1550)
@@ -737,6 +738,7 @@ typedef struct _RDPDR_PARALLEL RDPDR_PARALLEL;
 #define FreeRDP_PlayRemoteFx (1857)
 #define FreeRDP_DumpRemoteFxFile (1858)
 #define FreeRDP_PlayRemoteFxFile (1859)
+#define FreeRDP_DumpSessionFile (1860)
 #define FreeRDP_GatewayUsageMethod (1984)
 #define FreeRDP_GatewayPort (1985)
 #define FreeRDP_GatewayHostname (1986)
@@ -801,6 +803,7 @@ typedef struct _RDPDR_PARALLEL RDPDR_PARALLEL;
 #define FreeRDP_BitmapCachePersistEnabled (2500)
 #define FreeRDP_BitmapCacheV2NumCells (2501)
 #define FreeRDP_BitmapCacheV2CellInfo (2502)
+#define FreeRDP_BitmapCachePersistFile (2503)
 #define FreeRDP_ColorPointerFlag (2560)
 #define FreeRDP_PointerCacheSize (2561)
 #define FreeRDP_KeyboardRemappingList (2622)
@@ -857,6 +860,7 @@ typedef struct _RDPDR_PARALLEL RDPDR_PARALLEL;
 #define FreeRDP_GfxSendQoeAck (3846)
 #define FreeRDP_GfxAVC444v2 (3847)
 #define FreeRDP_GfxCapsFilter (3848)
+#define FreeRDP_GfxCachePersistFile (3849)
 #define FreeRDP_BitmapCacheV3CodecId (3904)
 #define FreeRDP_DrawNineGridEnabled (3968)
 #define FreeRDP_DrawNineGridCacheSize (3969)
@@ -1189,7 +1193,7 @@ struct rdp_settings
 	ALIGN64 BOOL AsyncInput;              /* 1544 */
 	ALIGN64 BOOL AsyncUpdate;             /* 1545 */
 	ALIGN64 BOOL AsyncChannels;           /* 1546 */
-	UINT64 padding1548[1548 - 1547];      /* 1547 */
+	ALIGN64 BOOL AsyncTransport;          /* 1547 */
 	ALIGN64 BOOL ToggleFullscreen;        /* 1548 */
 	ALIGN64 char* WmClass;                /* 1549 */
 	ALIGN64 BOOL EmbeddedWindow;          /* 1550 */
@@ -1232,7 +1236,8 @@ struct rdp_settings
 	ALIGN64 BOOL PlayRemoteFx;       /* 1857 */
 	ALIGN64 char* DumpRemoteFxFile;  /* 1858 */
 	ALIGN64 char* PlayRemoteFxFile;  /* 1859 */
-	UINT64 padding1920[1920 - 1860]; /* 1860 */
+	ALIGN64 char* DumpSessionFile;   /* 1860 */
+	UINT64 padding1920[1920 - 1861]; /* 1861 */
 	UINT64 padding1984[1984 - 1920]; /* 1920 */
 
 	/**
@@ -1334,7 +1339,8 @@ struct rdp_settings
 	ALIGN64 BOOL BitmapCachePersistEnabled;                   /* 2500 */
 	ALIGN64 UINT32 BitmapCacheV2NumCells;                     /* 2501 */
 	ALIGN64 BITMAP_CACHE_V2_CELL_INFO* BitmapCacheV2CellInfo; /* 2502 */
-	UINT64 padding2560[2560 - 2503];                          /* 2503 */
+	ALIGN64 char* BitmapCachePersistFile;                     /* 2503 */
+	UINT64 padding2560[2560 - 2504];                          /* 2504 */
 
 	/* Pointer Capabilities */
 	ALIGN64 BOOL ColorPointerFlag;   /* 2560 */
@@ -1447,16 +1453,17 @@ struct rdp_settings
 	ALIGN64 UINT32 JpegQuality;      /* 3778 */
 	UINT64 padding3840[3840 - 3779]; /* 3779 */
 
-	ALIGN64 BOOL GfxThinClient;      /* 3840 */
-	ALIGN64 BOOL GfxSmallCache;      /* 3841 */
-	ALIGN64 BOOL GfxProgressive;     /* 3842 */
-	ALIGN64 BOOL GfxProgressiveV2;   /* 3843 */
-	ALIGN64 BOOL GfxH264;            /* 3844 */
-	ALIGN64 BOOL GfxAVC444;          /* 3845 */
-	ALIGN64 BOOL GfxSendQoeAck;      /* 3846 */
-	ALIGN64 BOOL GfxAVC444v2;        /* 3847 */
-	ALIGN64 UINT32 GfxCapsFilter;    /* 3848 */
-	UINT64 padding3904[3904 - 3849]; /* 3849 */
+	ALIGN64 BOOL GfxThinClient;        /* 3840 */
+	ALIGN64 BOOL GfxSmallCache;        /* 3841 */
+	ALIGN64 BOOL GfxProgressive;       /* 3842 */
+	ALIGN64 BOOL GfxProgressiveV2;     /* 3843 */
+	ALIGN64 BOOL GfxH264;              /* 3844 */
+	ALIGN64 BOOL GfxAVC444;            /* 3845 */
+	ALIGN64 BOOL GfxSendQoeAck;        /* 3846 */
+	ALIGN64 BOOL GfxAVC444v2;          /* 3847 */
+	ALIGN64 UINT32 GfxCapsFilter;      /* 3848 */
+	ALIGN64 char* GfxCachePersistFile; /* 3849 */
+	UINT64 padding3904[3904 - 3850];   /* 3850 */
 
 	/**
 	 * Caches
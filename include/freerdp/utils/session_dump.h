@@ -0,0 +1,57 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Session Dump Utils
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_UTILS_SESSION_DUMP_H
+#define FREERDP_UTILS_SESSION_DUMP_H
+
+#include <winpr/stream.h>
+
+#include <freerdp/api.h>
+#include <freerdp/types.h>
+
+/**
+ * A session dump is a pcap file of the server to client data a client
+ * decoded, one record per PDU. Each record starts with one of the types
+ * below, the payload follows.
+ */
+
+#define SESSION_DUMP_DESKTOP 0x01  /* desktop width, height and color depth (UINT32 each) */
+#define SESSION_DUMP_FASTPATH 0x02 /* fastpath updates of one PDU, after decryption */
+#define SESSION_DUMP_GFX 0x03      /* RDPGFX channel data as received, zgfx compressed */
+
+typedef struct rdp_session_dump rdpSessionDump;
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+	FREERDP_API rdpSessionDump* session_dump_open(const char* filename, BOOL write);
+	FREERDP_API void session_dump_close(rdpSessionDump* dump);
+
+	FREERDP_API BOOL session_dump_write(rdpSessionDump* dump, BYTE type, const BYTE* data,
+	                                    size_t length);
+	FREERDP_API BOOL session_dump_write_desktop(rdpSessionDump* dump, UINT32 width,
+	                                            UINT32 height, UINT32 colorDepth);
+	FREERDP_API BOOL session_dump_read(rdpSessionDump* dump, BYTE* type, wStream* s,
+	                                   UINT64* timestamp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FREERDP_UTILS_SESSION_DUMP_H */
@@ -31,6 +31,8 @@
 
 #include <freerdp/log.h>
 #include <freerdp/cache/bitmap.h>
+#include <freerdp/cache/persistent.h>
+#include <freerdp/codec/color.h>
 #include <freerdp/gdi/bitmap.h>
 
 #include "../gdi/gdi.h"
@@ -43,6 +45,7 @@
 static rdpBitmap* bitmap_cache_get(rdpBitmapCache* bitmapCache, UINT32 id, UINT32 index);
 static BOOL bitmap_cache_put(rdpBitmapCache* bitmap_cache, UINT32 id, UINT32 index,
                              rdpBitmap* bitmap);
+static BOOL bitmap_cache_load_persistent(rdpBitmapCache* bitmapCache);
 
 static BOOL update_gdi_memblt(rdpContext* context, MEMBLT_ORDER* memblt)
 {
@@ -158,6 +161,9 @@ static BOOL update_gdi_cache_bitmap_v2(rdpContext* context, CACHE_BITMAP_V2_ORDE
 		return FALSE;
 	}
 
+	if (cacheBitmapV2->flags & CBR2_PERSISTENT_KEY_PRESENT)
+		bitmap->key64 = ((UINT64)cacheBitmapV2->key2 << 32) | cacheBitmapV2->key1;
+
 	prevBitmap = bitmap_cache_get(cache->bitmap, cacheBitmapV2->cacheId, cacheBitmapV2->cacheIndex);
 
 	if (!bitmap->New(context, bitmap))
@@ -204,6 +210,7 @@ static BOOL update_gdi_cache_bitmap_v3(rdpContext* context, CACHE_BITMAP_V3_ORDE
 		return FALSE;
 	}
 
+	bitmap->key64 = ((UINT64)cacheBitmapV3->key2 << 32) | cacheBitmapV3->key1;
 	prevBitmap = bitmap_cache_get(cache->bitmap, cacheBitmapV3->cacheId, cacheBitmapV3->cacheIndex);
 	Bitmap_Free(context, prevBitmap);
 	return bitmap_cache_put(cache->bitmap, cacheBitmapV3->cacheId, cacheBitmapV3->cacheIndex,
@@ -214,6 +221,9 @@ rdpBitmap* bitmap_cache_get(rdpBitmapCache* bitmapCache, UINT32 id, UINT32 index
 {
 	rdpBitmap* bitmap;
 
+	if (!bitmapCache->persistentLoaded)
+		bitmap_cache_load_persistent(bitmapCache);
+
 	if (id >= bitmapCache->maxCells)
 	{
 		WLog_ERR(TAG, "get invalid bitmap cell id: %" PRIu32 "", id);
@@ -236,6 +246,9 @@ rdpBitmap* bitmap_cache_get(rdpBitmapCache* bitmapCache, UINT32 id, UINT32 index
 
 BOOL bitmap_cache_put(rdpBitmapCache* bitmapCache, UINT32 id, UINT32 index, rdpBitmap* bitmap)
 {
+	if (!bitmapCache->persistentLoaded)
+		bitmap_cache_load_persistent(bitmapCache);
+
 	if (id > bitmapCache->maxCells)
 	{
 		WLog_ERR(TAG, "put invalid bitmap cell id: %" PRIu32 "", id);
@@ -256,6 +269,271 @@ BOOL bitmap_cache_put(rdpBitmapCache* bitmapCache, UINT32 id, UINT32 index, rdpB
 	return TRUE;
 }
 
+static BOOL bitmap_cache_persistent_enabled(const rdpSettings* settings)
+{
+	return settings->BitmapCachePersistEnabled && settings->BitmapCachePersistFile;
+}
+
+/**
+ * The keys announced in the Persistent Key List PDU occupy the cell entries in the order they
+ * were sent, so the key list and the bitmaps loaded into the cache must make the same choice:
+ * entries are taken in file order, and an entry is used if its cell is persistent and not yet
+ * full.
+ */
+static BOOL bitmap_cache_persistent_entry_usable(const rdpSettings* settings,
+                                                 const PERSISTENT_CACHE_ENTRY* entry,
+                                                 UINT32 numEntries[5])
+{
+	const BITMAP_CACHE_V2_CELL_INFO* info;
+
+	if ((entry->key64 == 0) || (entry->cacheId >= settings->BitmapCacheV2NumCells) ||
+	    (entry->cacheId >= 5))
+		return FALSE;
+
+	info = &settings->BitmapCacheV2CellInfo[entry->cacheId];
+
+	if (!info->persistent || (numEntries[entry->cacheId] >= info->numEntries))
+		return FALSE;
+
+	return TRUE;
+}
+
+UINT64* bitmap_cache_persistent_keys(const rdpSettings* settings, UINT32 numEntries[5])
+{
+	UINT32 x;
+	UINT32 count = 0;
+	UINT32 offsets[5] = { 0 };
+	UINT64* keys = NULL;
+	PERSISTENT_CACHE_ENTRY entry;
+	rdpPersistentCache* persistent = NULL;
+
+	for (x = 0; x < 5; x++)
+		numEntries[x] = 0;
+
+	if (!bitmap_cache_persistent_enabled(settings))
+		return NULL;
+
+	persistent = persistent_cache_new();
+
+	if (!persistent || !persistent_cache_open(persistent, settings->BitmapCachePersistFile, FALSE))
+		goto fail;
+
+	/* First pass counts the usable entries of each cell, the second one places the keys
+	 * grouped by cell. */
+	while (persistent_cache_read_entry(persistent, &entry, FALSE))
+	{
+		if (!bitmap_cache_persistent_entry_usable(settings, &entry, numEntries))
+			continue;
+
+		numEntries[entry.cacheId]++;
+		count++;
+	}
+
+	if (count == 0)
+		goto fail;
+
+	keys = (UINT64*)calloc(count, sizeof(UINT64));
+
+	if (!keys)
+		goto fail;
+
+	for (x = 1; x < 5; x++)
+		offsets[x] = offsets[x - 1] + numEntries[x - 1];
+
+	for (x = 0; x < 5; x++)
+		numEntries[x] = 0;
+
+	if (!persistent_cache_open(persistent, settings->BitmapCachePersistFile, FALSE))
+		goto fail;
+
+	while (persistent_cache_read_entry(persistent, &entry, FALSE))
+	{
+		if (!bitmap_cache_persistent_entry_usable(settings, &entry, numEntries))
+			continue;
+
+		keys[offsets[entry.cacheId] + numEntries[entry.cacheId]] = entry.key64;
+		numEntries[entry.cacheId]++;
+	}
+
+	persistent_cache_free(persistent);
+	return keys;
+fail:
+	free(keys);
+
+	for (x = 0; x < 5; x++)
+		numEntries[x] = 0;
+
+	persistent_cache_free(persistent);
+	return NULL;
+}
+
+static rdpBitmap* bitmap_cache_persistent_bitmap_new(rdpContext* context,
+                                                     const PERSISTENT_CACHE_ENTRY* entry)
+{
+	rdpBitmap* bitmap = Bitmap_Alloc(context);
+
+	if (!bitmap)
+		return NULL;
+
+	Bitmap_SetDimensions(bitmap, entry->width, entry->height);
+	bitmap->format = context->gdi->dstFormat;
+	bitmap->length = entry->width * entry->height * GetBytesPerPixel(bitmap->format);
+	bitmap->data = (BYTE*)_aligned_malloc(bitmap->length, 16);
+	bitmap->key64 = entry->key64;
+
+	if (!bitmap->data)
+		goto fail;
+
+	if (!freerdp_image_copy(bitmap->data, bitmap->format, 0, 0, 0, entry->width, entry->height,
+	                        entry->data, PIXEL_FORMAT_BGRA32, 0, 0, 0, NULL, FREERDP_FLIP_NONE))
+		goto fail;
+
+	if (!bitmap->New(context, bitmap))
+		goto fail;
+
+	return bitmap;
+fail:
+	Bitmap_Free(context, bitmap);
+	return NULL;
+}
+
+/**
+ * Fills the persistent cells with the bitmaps whose keys were sent in the Persistent Key List
+ * PDU. This runs on first use of the cache, the graphics callbacks are not registered yet when
+ * the cache is created.
+ */
+static BOOL bitmap_cache_load_persistent(rdpBitmapCache* bitmapCache)
+{
+	UINT32 numEntries[5] = { 0 };
+	UINT32 loaded = 0;
+	PERSISTENT_CACHE_ENTRY entry;
+	rdpPersistentCache* persistent;
+	rdpSettings* settings = bitmapCache->settings;
+	rdpContext* context = bitmapCache->context;
+
+	bitmapCache->persistentLoaded = TRUE;
+
+	if (!bitmap_cache_persistent_enabled(settings) || !context->gdi)
+		return TRUE;
+
+	persistent = persistent_cache_new();
+
+	if (!persistent)
+		return FALSE;
+
+	if (!persistent_cache_open(persistent, settings->BitmapCachePersistFile, FALSE))
+	{
+		persistent_cache_free(persistent);
+		return TRUE;
+	}
+
+	while (persistent_cache_read_entry(persistent, &entry, TRUE))
+	{
+		rdpBitmap* bitmap;
+		const UINT32 id = entry.cacheId;
+
+		if (!bitmap_cache_persistent_entry_usable(settings, &entry, numEntries))
+			continue;
+
+		/* Slots the server now expects to be filled stay empty if this fails */
+		bitmap = bitmap_cache_persistent_bitmap_new(context, &entry);
+
+		if ((id < bitmapCache->maxCells) && (numEntries[id] < bitmapCache->cells[id].number))
+		{
+			Bitmap_Free(context, bitmapCache->cells[id].entries[numEntries[id]]);
+			bitmapCache->cells[id].entries[numEntries[id]] = bitmap;
+
+			if (bitmap)
+				loaded++;
+		}
+		else
+			Bitmap_Free(context, bitmap);
+
+		numEntries[id]++;
+	}
+
+	WLog_DBG(TAG, "loaded %" PRIu32 " bitmaps from %s", loaded, settings->BitmapCachePersistFile);
+	persistent_cache_free(persistent);
+	return TRUE;
+}
+
+static BOOL bitmap_cache_save_persistent(rdpBitmapCache* bitmapCache)
+{
+	UINT32 i, j;
+	BOOL rc = FALSE;
+	BYTE* data = NULL;
+	size_t dataSize = 0;
+	rdpPersistentCache* persistent;
+	rdpSettings* settings = bitmapCache->settings;
+
+	/* Without a load the file still holds what the server was told about, keep it */
+	if (!bitmap_cache_persistent_enabled(settings) || !bitmapCache->persistentLoaded)
+		return TRUE;
+
+	persistent = persistent_cache_new();
+
+	if (!persistent || !persistent_cache_open(persistent, settings->BitmapCachePersistFile, TRUE))
+		goto fail;
+
+	for (i = 0; i < bitmapCache->maxCells; i++)
+	{
+		BITMAP_V2_CELL* cell = &bitmapCache->cells[i];
+
+		if ((i >= 5) || !settings->BitmapCacheV2CellInfo[i].persistent)
+			continue;
+
+		for (j = 0; j < cell->number; j++)
+		{
+			PERSISTENT_CACHE_ENTRY entry = { 0 };
+			rdpBitmap* bitmap = cell->entries[j];
+
+			if (!bitmap || !bitmap->key64 || !bitmap->data)
+				continue;
+
+			if ((bitmap->width > PERSISTENT_CACHE_MAX_DIMENSION) ||
+			    (bitmap->height > PERSISTENT_CACHE_MAX_DIMENSION))
+				continue;
+
+			entry.key64 = bitmap->key64;
+			entry.width = (UINT16)bitmap->width;
+			entry.height = (UINT16)bitmap->height;
+			entry.cacheId = (UINT16)i;
+			entry.cacheIndex = (UINT16)j;
+			entry.size = 4UL * bitmap->width * bitmap->height;
+
+			if (dataSize < entry.size)
+			{
+				BYTE* tmp = realloc(data, entry.size);
+
+				if (!tmp)
+					goto fail;
+
+				data = tmp;
+				dataSize = entry.size;
+			}
+
+			entry.data = data;
+
+			if (!freerdp_image_copy(entry.data, PIXEL_FORMAT_BGRA32, 0, 0, 0, bitmap->width,
+			                        bitmap->height, bitmap->data, bitmap->format, 0, 0, 0, NULL,
+			                        FREERDP_FLIP_NONE))
+				goto fail;
+
+			if (!persistent_cache_write_entry(persistent, &entry))
+				goto fail;
+		}
+	}
+
+	rc = persistent_cache_close(persistent);
+fail:
+	if (!rc)
+		WLog_WARN(TAG, "failed to save the persistent bitmap cache");
+
+	persistent_cache_free(persistent);
+	free(data);
+	return rc;
+}
+
 void bitmap_cache_register_callbacks(rdpUpdate* update)
 {
 	rdpCache* cache = update->context->cache;
@@ -312,6 +590,8 @@ void bitmap_cache_free(rdpBitmapCache* bitmapCache)
 	if (bitmapCache)
 	{
 		UINT32 i;
+		bitmap_cache_save_persistent(bitmapCache);
+
 		for (i = 0; i < bitmapCache->maxCells; i++)
 		{
 			UINT32 j;
@@ -38,4 +38,7 @@ FREERDP_LOCAL CACHE_BITMAP_V3_ORDER* copy_cache_bitmap_v3_order(rdpContext* cont
                                                                 const CACHE_BITMAP_V3_ORDER* order);
 FREERDP_LOCAL void free_cache_bitmap_v3_order(rdpContext* context, CACHE_BITMAP_V3_ORDER* order);
 
+FREERDP_LOCAL UINT64* bitmap_cache_persistent_keys(const rdpSettings* settings,
+                                                   UINT32 numEntries[5]);
+
 #endif /* FREERDP_LIB_CACHE_BITMAP_H */
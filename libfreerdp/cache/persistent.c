@@ -0,0 +1,373 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Persistent Bitmap Cache
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+
+#include <winpr/crt.h>
+#include <winpr/file.h>
+#include <winpr/path.h>
+#include <winpr/stream.h>
+
+#include <freerdp/log.h>
+#include <freerdp/cache/persistent.h>
+
+#define TAG FREERDP_TAG("cache.persistent")
+
+/**
+ * File layout, all values little endian:
+ *
+ * header (16 bytes):
+ *   signature  "FRDPBMC\0" (8 bytes)
+ *   version    (4 bytes)
+ *   count      number of entries (4 bytes)
+ *
+ * entry (24 bytes + size):
+ *   key64      (8 bytes)
+ *   width      (2 bytes)
+ *   height     (2 bytes)
+ *   cacheId    (2 bytes)
+ *   cacheIndex (2 bytes)
+ *   size       (4 bytes)
+ *   reserved   (4 bytes)
+ *   data       BGRA32 pixels (size bytes)
+ */
+
+#define PERSISTENT_CACHE_HEADER_LENGTH 16
+#define PERSISTENT_CACHE_ENTRY_LENGTH 24
+
+static const char PERSISTENT_CACHE_SIGNATURE[8] = "FRDPBMC";
+
+struct rdp_persistent_cache
+{
+	FILE* fp;
+	BOOL write;
+	UINT32 version;
+	UINT32 count;
+	UINT32 index;
+	char* filename;
+	char* tempname;
+	BYTE* data;
+	size_t dataSize;
+};
+
+static BOOL persistent_cache_read_header(rdpPersistentCache* persistent)
+{
+	wStream s;
+	char signature[8];
+	BYTE buffer[PERSISTENT_CACHE_HEADER_LENGTH];
+
+	if (fread(buffer, sizeof(buffer), 1, persistent->fp) != 1)
+		return FALSE;
+
+	Stream_StaticInit(&s, buffer, sizeof(buffer));
+	Stream_Read(&s, signature, sizeof(signature));
+	Stream_Read_UINT32(&s, persistent->version);
+	Stream_Read_UINT32(&s, persistent->count);
+
+	if (memcmp(signature, PERSISTENT_CACHE_SIGNATURE, sizeof(signature)) != 0)
+	{
+		WLog_WARN(TAG, "%s is not a bitmap cache file", persistent->filename);
+		return FALSE;
+	}
+
+	if (persistent->version != PERSISTENT_CACHE_VERSION)
+	{
+		WLog_WARN(TAG, "%s has unsupported version %" PRIu32 ", ignoring it",
+		          persistent->filename, persistent->version);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static BOOL persistent_cache_write_header(rdpPersistentCache* persistent)
+{
+	wStream s;
+	BYTE buffer[PERSISTENT_CACHE_HEADER_LENGTH];
+	Stream_StaticInit(&s, buffer, sizeof(buffer));
+	Stream_Write(&s, PERSISTENT_CACHE_SIGNATURE, sizeof(PERSISTENT_CACHE_SIGNATURE));
+	Stream_Write_UINT32(&s, persistent->version);
+	Stream_Write_UINT32(&s, persistent->count);
+	return fwrite(buffer, sizeof(buffer), 1, persistent->fp) == 1;
+}
+
+UINT32 persistent_cache_get_version(rdpPersistentCache* persistent)
+{
+	if (!persistent)
+		return 0;
+
+	return persistent->version;
+}
+
+UINT32 persistent_cache_get_count(rdpPersistentCache* persistent)
+{
+	if (!persistent)
+		return 0;
+
+	return persistent->count;
+}
+
+BOOL persistent_cache_read_entry(rdpPersistentCache* persistent, PERSISTENT_CACHE_ENTRY* entry,
+                                 BOOL withData)
+{
+	wStream s;
+	UINT32 reserved;
+	BYTE buffer[PERSISTENT_CACHE_ENTRY_LENGTH];
+
+	if (!persistent || !persistent->fp || persistent->write || !entry)
+		return FALSE;
+
+	if (persistent->index >= persistent->count)
+		return FALSE;
+
+	if (fread(buffer, sizeof(buffer), 1, persistent->fp) != 1)
+		return FALSE;
+
+	Stream_StaticInit(&s, buffer, sizeof(buffer));
+	Stream_Read_UINT64(&s, entry->key64);
+	Stream_Read_UINT16(&s, entry->width);
+	Stream_Read_UINT16(&s, entry->height);
+	Stream_Read_UINT16(&s, entry->cacheId);
+	Stream_Read_UINT16(&s, entry->cacheIndex);
+	Stream_Read_UINT32(&s, entry->size);
+	Stream_Read_UINT32(&s, reserved);
+	entry->data = NULL;
+
+	if ((entry->width == 0) || (entry->height == 0) ||
+	    (entry->width > PERSISTENT_CACHE_MAX_DIMENSION) ||
+	    (entry->height > PERSISTENT_CACHE_MAX_DIMENSION) ||
+	    (entry->size != 4UL * entry->width * entry->height))
+	{
+		WLog_ERR(TAG, "%s: invalid entry %" PRIu32 "", persistent->filename, persistent->index);
+		return FALSE;
+	}
+
+	if (withData)
+	{
+		if (persistent->dataSize < entry->size)
+		{
+			BYTE* data = realloc(persistent->data, entry->size);
+
+			if (!data)
+				return FALSE;
+
+			persistent->data = data;
+			persistent->dataSize = entry->size;
+		}
+
+		if (fread(persistent->data, entry->size, 1, persistent->fp) != 1)
+			return FALSE;
+
+		entry->data = persistent->data;
+	}
+	else if (fseek(persistent->fp, (long)entry->size, SEEK_CUR) != 0)
+		return FALSE;
+
+	persistent->index++;
+	return TRUE;
+}
+
+BOOL persistent_cache_write_entry(rdpPersistentCache* persistent,
+                                  const PERSISTENT_CACHE_ENTRY* entry)
+{
+	wStream s;
+	BYTE buffer[PERSISTENT_CACHE_ENTRY_LENGTH];
+
+	if (!persistent || !persistent->fp || !persistent->write || !entry || !entry->data)
+		return FALSE;
+
+	if ((entry->width == 0) || (entry->height == 0) ||
+	    (entry->width > PERSISTENT_CACHE_MAX_DIMENSION) ||
+	    (entry->height > PERSISTENT_CACHE_MAX_DIMENSION) ||
+	    (entry->size != 4UL * entry->width * entry->height))
+		return FALSE;
+
+	Stream_StaticInit(&s, buffer, sizeof(buffer));
+	Stream_Write_UINT64(&s, entry->key64);
+	Stream_Write_UINT16(&s, entry->width);
+	Stream_Write_UINT16(&s, entry->height);
+	Stream_Write_UINT16(&s, entry->cacheId);
+	Stream_Write_UINT16(&s, entry->cacheIndex);
+	Stream_Write_UINT32(&s, entry->size);
+	Stream_Write_UINT32(&s, 0); /* reserved */
+
+	if (fwrite(buffer, sizeof(buffer), 1, persistent->fp) != 1)
+		return FALSE;
+
+	if (fwrite(entry->data, entry->size, 1, persistent->fp) != 1)
+		return FALSE;
+
+	persistent->count++;
+	return TRUE;
+}
+
+static BOOL persistent_cache_make_directory(const char* filename)
+{
+	BOOL rc = TRUE;
+	char* separator;
+	char* directory = _strdup(filename);
+
+	if (!directory)
+		return FALSE;
+
+	separator = strrchr(directory, '/');
+#ifdef _WIN32
+	{
+		char* backslash = strrchr(directory, '\\');
+
+		if (backslash > separator)
+			separator = backslash;
+	}
+#endif
+
+	if (separator && (separator != directory))
+	{
+		*separator = '\0';
+
+		if (!winpr_PathFileExists(directory))
+			rc = winpr_PathMakePath(directory, NULL);
+	}
+
+	free(directory);
+	return rc;
+}
+
+BOOL persistent_cache_open(rdpPersistentCache* persistent, const char* filename, BOOL write)
+{
+	size_t length;
+
+	if (!persistent || !filename)
+		return FALSE;
+
+	persistent_cache_close(persistent);
+	persistent->filename = _strdup(filename);
+
+	if (!persistent->filename)
+		return FALSE;
+
+	persistent->write = write;
+	persistent->version = PERSISTENT_CACHE_VERSION;
+	persistent->count = 0;
+	persistent->index = 0;
+
+	if (!write)
+	{
+		persistent->fp = winpr_fopen(filename, "rb");
+
+		if (!persistent->fp)
+			goto fail;
+
+		if (!persistent_cache_read_header(persistent))
+			goto fail;
+
+		return TRUE;
+	}
+
+	/* Write into a temporary file first so an interrupted session never leaves a
+	 * truncated cache behind. */
+	length = strlen(filename) + 5;
+	persistent->tempname = calloc(length, sizeof(char));
+
+	if (!persistent->tempname)
+		goto fail;
+
+	sprintf_s(persistent->tempname, length, "%s.tmp", filename);
+
+	if (!persistent_cache_make_directory(filename))
+		goto fail;
+
+	persistent->fp = winpr_fopen(persistent->tempname, "wb");
+
+	if (!persistent->fp)
+	{
+		WLog_ERR(TAG, "failed to create %s", persistent->tempname);
+		goto fail;
+	}
+
+	if (!persistent_cache_write_header(persistent))
+		goto fail;
+
+	return TRUE;
+fail:
+	persistent->write = FALSE;
+	persistent_cache_close(persistent);
+	return FALSE;
+}
+
+BOOL persistent_cache_close(rdpPersistentCache* persistent)
+{
+	BOOL rc = TRUE;
+
+	if (!persistent)
+		return FALSE;
+
+	if (persistent->fp)
+	{
+		if (persistent->write)
+		{
+			/* Rewrite the header now that the entry count is known */
+			if (fseek(persistent->fp, 0, SEEK_SET) != 0)
+				rc = FALSE;
+			else if (!persistent_cache_write_header(persistent))
+				rc = FALSE;
+		}
+
+		if (fclose(persistent->fp) != 0)
+			rc = FALSE;
+
+		persistent->fp = NULL;
+
+		if (persistent->write)
+		{
+			if (rc)
+				rc = MoveFileExA(persistent->tempname, persistent->filename,
+				                 MOVEFILE_REPLACE_EXISTING);
+
+			if (!rc)
+			{
+				WLog_ERR(TAG, "failed to write %s", persistent->filename);
+				DeleteFileA(persistent->tempname);
+			}
+		}
+	}
+
+	free(persistent->filename);
+	free(persistent->tempname);
+	persistent->filename = NULL;
+	persistent->tempname = NULL;
+	persistent->write = FALSE;
+	return rc;
+}
+
+rdpPersistentCache* persistent_cache_new(void)
+{
+	return (rdpPersistentCache*)calloc(1, sizeof(rdpPersistentCache));
+}
+
+void persistent_cache_free(rdpPersistentCache* persistent)
+{
+	if (!persistent)
+		return;
+
+	persistent_cache_close(persistent);
+	free(persistent->data);
+	free(persistent);
+}
@@ -0,0 +1,185 @@
+
+#include <stdio.h>
+
+#include <winpr/crt.h>
+#include <winpr/file.h>
+#include <winpr/path.h>
+#include <winpr/sysinfo.h>
+
+#include <freerdp/cache/persistent.h>
+
+#define TEST_ENTRY_COUNT 3
+
+static BOOL test_fill_entry(PERSISTENT_CACHE_ENTRY* entry, UINT32 index)
+{
+	UINT32 x;
+
+	entry->key64 = 0x1122334455667788ULL + index;
+	entry->width = (UINT16)(16 + index * 8);
+	entry->height = (UINT16)(8 + index);
+	entry->cacheId = (UINT16)(index % 3);
+	entry->cacheIndex = (UINT16)index;
+	entry->size = 4UL * entry->width * entry->height;
+	entry->data = malloc(entry->size);
+
+	if (!entry->data)
+		return FALSE;
+
+	for (x = 0; x < entry->size; x++)
+		entry->data[x] = (BYTE)(x * 7 + index);
+
+	return TRUE;
+}
+
+static BOOL test_compare_entry(const PERSISTENT_CACHE_ENTRY* a, const PERSISTENT_CACHE_ENTRY* b,
+                               BOOL withData)
+{
+	if ((a->key64 != b->key64) || (a->width != b->width) || (a->height != b->height) ||
+	    (a->cacheId != b->cacheId) || (a->cacheIndex != b->cacheIndex) || (a->size != b->size))
+	{
+		fprintf(stderr, "entry header mismatch\n");
+		return FALSE;
+	}
+
+	if (withData && (memcmp(a->data, b->data, a->size) != 0))
+	{
+		fprintf(stderr, "entry data mismatch\n");
+		return FALSE;
+	}
+
+	if (!withData && b->data)
+	{
+		fprintf(stderr, "entry data returned when skipping pixels\n");
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static BOOL test_read_back(rdpPersistentCache* persistent, const char* filename,
+                           const PERSISTENT_CACHE_ENTRY* entries, BOOL withData)
+{
+	UINT32 x;
+	PERSISTENT_CACHE_ENTRY entry;
+
+	if (!persistent_cache_open(persistent, filename, FALSE))
+	{
+		fprintf(stderr, "failed to open %s for reading\n", filename);
+		return FALSE;
+	}
+
+	if ((persistent_cache_get_version(persistent) != PERSISTENT_CACHE_VERSION) ||
+	    (persistent_cache_get_count(persistent) != TEST_ENTRY_COUNT))
+	{
+		fprintf(stderr, "unexpected header in %s\n", filename);
+		return FALSE;
+	}
+
+	for (x = 0; x < TEST_ENTRY_COUNT; x++)
+	{
+		if (!persistent_cache_read_entry(persistent, &entry, withData))
+		{
+			fprintf(stderr, "failed to read entry %" PRIu32 "\n", x);
+			return FALSE;
+		}
+
+		if (!test_compare_entry(&entries[x], &entry, withData))
+			return FALSE;
+	}
+
+	if (persistent_cache_read_entry(persistent, &entry, withData))
+	{
+		fprintf(stderr, "read past the last entry\n");
+		return FALSE;
+	}
+
+	return persistent_cache_close(persistent);
+}
+
+static BOOL test_reject_invalid(rdpPersistentCache* persistent, const char* filename)
+{
+	static const BYTE garbage[16] = { 'F', 'R', 'D', 'P', 'B', 'M', 'C', 0, 2, 0, 0, 0 };
+	FILE* fp = winpr_fopen(filename, "wb");
+
+	if (!fp)
+		return FALSE;
+
+	fwrite(garbage, sizeof(garbage), 1, fp);
+	fclose(fp);
+
+	if (persistent_cache_open(persistent, filename, FALSE))
+	{
+		fprintf(stderr, "opened a cache file with a different version\n");
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+int TestPersistentCache(int argc, char* argv[])
+{
+	UINT32 x;
+	int rc = -1;
+	char sname[8192];
+	char* filename = NULL;
+	SYSTEMTIME systemTime;
+	rdpPersistentCache* persistent = NULL;
+	PERSISTENT_CACHE_ENTRY entries[TEST_ENTRY_COUNT] = { 0 };
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+	GetSystemTime(&systemTime);
+	sprintf_s(sname, sizeof(sname),
+	          "TestPersistentCache-%04" PRIu16 "%02" PRIu16 "%02" PRIu16 "%02" PRIu16 "%02" PRIu16
+	          "%02" PRIu16 "%04" PRIu16 ".bmc",
+	          systemTime.wYear, systemTime.wMonth, systemTime.wDay, systemTime.wHour,
+	          systemTime.wMinute, systemTime.wSecond, systemTime.wMilliseconds);
+	filename = GetKnownSubPath(KNOWN_PATH_TEMP, sname);
+	persistent = persistent_cache_new();
+
+	if (!filename || !persistent)
+		goto fail;
+
+	if (!persistent_cache_open(persistent, filename, TRUE))
+	{
+		fprintf(stderr, "failed to open %s for writing\n", filename);
+		goto fail;
+	}
+
+	for (x = 0; x < TEST_ENTRY_COUNT; x++)
+	{
+		if (!test_fill_entry(&entries[x], x))
+			goto fail;
+
+		if (!persistent_cache_write_entry(persistent, &entries[x]))
+		{
+			fprintf(stderr, "failed to write entry %" PRIu32 "\n", x);
+			goto fail;
+		}
+	}
+
+	if (!persistent_cache_close(persistent))
+		goto fail;
+
+	if (!test_read_back(persistent, filename, entries, FALSE))
+		goto fail;
+
+	if (!test_read_back(persistent, filename, entries, TRUE))
+		goto fail;
+
+	if (!test_reject_invalid(persistent, filename))
+		goto fail;
+
+	rc = 0;
+fail:
+	persistent_cache_free(persistent);
+
+	if (filename)
+		DeleteFileA(filename);
+
+	free(filename);
+
+	for (x = 0; x < TEST_ENTRY_COUNT; x++)
+		free(entries[x].data);
+
+	return rc;
+}
@@ -0,0 +1,184 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Bulk Compression Match Finder
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_LIB_CODEC_BULK_MATCH_H
+#define FREERDP_LIB_CODEC_BULK_MATCH_H
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <winpr/crt.h>
+#include <winpr/platform.h>
+
+#include <freerdp/codec/bulk.h>
+
+/* SSE2 is part of the AMD64 baseline, no runtime check or compiler flag needed */
+#if defined(WITH_SSE2) && defined(_M_AMD64)
+#include <emmintrin.h>
+#define BULK_MATCH_SSE2 1
+#endif
+
+/* positions searched in a long literal run, see SkipAfter */
+#define BULK_MATCH_SKIP_STEP 4
+
+/* MaxInsertLength and SkipAfter are used by MPPC, NCrush hashes the whole input up front */
+struct _BULK_MATCH_PARAMS
+{
+	UINT32 Depth;           /* hash chain entries visited per position, 0 for the legacy finder */
+	UINT32 NiceLength;      /* a match of at least this length ends the search */
+	BOOL Lazy;              /* emit a literal if the next position has a longer match */
+	UINT32 MaxInsertLength; /* positions inside longer matches are not hashed, 0 for all */
+	UINT32 SkipAfter;       /* literals in a row before positions are skipped, 0 never */
+};
+typedef struct _BULK_MATCH_PARAMS BULK_MATCH_PARAMS;
+
+static INLINE BOOL bulk_match_get_params(UINT32 level, BULK_MATCH_PARAMS* params)
+{
+	switch (level)
+	{
+		case BULK_MATCH_LEVEL_LEGACY:
+			params->Depth = 0;
+			params->NiceLength = 0;
+			params->Lazy = FALSE;
+			params->MaxInsertLength = 0;
+			params->SkipAfter = 0;
+			return TRUE;
+
+		case BULK_MATCH_LEVEL_FAST:
+			params->Depth = 1;
+			params->NiceLength = 16;
+			params->Lazy = FALSE;
+			params->MaxInsertLength = 1;
+			params->SkipAfter = 16;
+			return TRUE;
+
+		case BULK_MATCH_LEVEL_DEFAULT:
+			params->Depth = 16;
+			params->NiceLength = 64;
+			params->Lazy = TRUE;
+			params->MaxInsertLength = 0;
+			params->SkipAfter = 0;
+			return TRUE;
+
+		case BULK_MATCH_LEVEL_BEST:
+			params->Depth = 128;
+			params->NiceLength = 512;
+			params->Lazy = TRUE;
+			params->MaxInsertLength = 0;
+			params->SkipAfter = 0;
+			return TRUE;
+
+		default:
+			return FALSE;
+	}
+}
+
+/**
+ * Number of equal leading bytes of a and b, at most max. Blocks of 16 (SSE2) and 8 bytes
+ * are compared at once, the block with the first difference is then scanned byte-wise.
+ */
+static INLINE UINT32 bulk_match_length(const BYTE* a, const BYTE* b, UINT32 max)
+{
+	UINT32 length = 0;
+#if defined(BULK_MATCH_SSE2)
+
+	while (length + 16 <= max)
+	{
+		const __m128i va = _mm_loadu_si128((const __m128i*)&a[length]);
+		const __m128i vb = _mm_loadu_si128((const __m128i*)&b[length]);
+
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(va, vb)) != 0xFFFF)
+			break;
+
+		length += 16;
+	}
+
+#endif
+
+	while (length + 8 <= max)
+	{
+		UINT64 va, vb;
+		memcpy(&va, &a[length], sizeof(va));
+		memcpy(&vb, &b[length], sizeof(vb));
+
+		if (va != vb)
+			break;
+
+		length += 8;
+	}
+
+	while ((length < max) && (a[length] == b[length]))
+		length++;
+
+	return length;
+}
+
+/**
+ * Walks the hash chain starting at candidate and returns the longest match for position,
+ * at most maxLength bytes and maxDistance bytes back. chain[p] holds the previous position
+ * with the same hash as p, 0 ends the chain. Only positions before position are used,
+ * entries left over from an earlier pass over the history are rejected by the byte comparison.
+ */
+static INLINE UINT32 bulk_match_find(const BYTE* history, const UINT16* chain, UINT32 candidate,
+                                     UINT32 position, UINT32 maxLength, UINT32 maxDistance,
+                                     const BULK_MATCH_PARAMS* params, UINT32* pMatch)
+{
+	UINT32 depth;
+	UINT32 best = 0;
+	const UINT32 nice = MIN(params->NiceLength, maxLength);
+
+	for (depth = 0; (depth < params->Depth) && candidate && (candidate < position) &&
+	                (position - candidate <= maxDistance);
+	     depth++)
+	{
+		UINT32 next;
+
+		/* a longer match has to agree on the byte following the best one, any match on
+		 * the first two bytes */
+		if ((history[candidate + best] == history[position + best]) &&
+		    (history[candidate] == history[position]) &&
+		    (history[candidate + 1] == history[position + 1]))
+		{
+			const UINT32 length =
+			    bulk_match_length(&history[candidate], &history[position], maxLength);
+
+			if (length > best)
+			{
+				best = length;
+				*pMatch = candidate;
+
+				if (best >= nice)
+					break;
+			}
+		}
+
+		if (depth + 1 >= params->Depth)
+			break;
+
+		next = chain[candidate];
+
+		if (next >= candidate)
+			break;
+
+		candidate = next;
+	}
+
+	return best;
+}
+
+#endif /* FREERDP_LIB_CODEC_BULK_MATCH_H */
@@ -39,12 +39,16 @@
 
 #define CLEARCODEC_VBAR_SIZE 32768
 #define CLEARCODEC_VBAR_SHORT_SIZE 16384
+#define CLEARCODEC_GLYPH_SIZE 4000
+#define CLEARCODEC_GLYPH_MAX_PIXELS 1024
+#define CLEARCODEC_BAND_MAX_HEIGHT 52
 
 struct _CLEAR_GLYPH_ENTRY
 {
 	UINT32 size;
 	UINT32 count;
 	UINT32* pixels;
+	UINT32 hash;
 };
 typedef struct _CLEAR_GLYPH_ENTRY CLEAR_GLYPH_ENTRY;
 
@@ -53,6 +57,7 @@ struct _CLEAR_VBAR_ENTRY
 	UINT32 size;
 	UINT32 count;
 	BYTE* pixels;
+	UINT32 hash;
 };
 typedef struct _CLEAR_VBAR_ENTRY CLEAR_VBAR_ENTRY;
 
@@ -66,11 +71,21 @@ struct _CLEAR_CONTEXT
 	UINT32 nTempStep;
 	UINT32 TempFormat;
 	UINT32 format;
-	CLEAR_GLYPH_ENTRY GlyphCache[4000];
+	CLEAR_GLYPH_ENTRY GlyphCache[CLEARCODEC_GLYPH_SIZE];
 	UINT32 VBarStorageCursor;
 	CLEAR_VBAR_ENTRY VBarStorage[CLEARCODEC_VBAR_SIZE];
 	UINT32 ShortVBarStorageCursor;
 	CLEAR_VBAR_ENTRY ShortVBarStorage[CLEARCODEC_VBAR_SHORT_SIZE];
+
+	/* encoder state, only allocated for compressor contexts */
+	BOOL CacheReset;
+	UINT32 GlyphCursor;
+	UINT32* GlyphLookup;
+	UINT32* VBarLookup;
+	UINT32* ShortVBarLookup;
+	UINT32* EncodeBuffer;
+	UINT32 EncodeBufferSize;
+	wStream* EncodeStream;
 };
 
 static const UINT32 CLEAR_LOG2_FLOOR[256] = {
@@ -932,7 +947,7 @@ static BOOL clear_decompress_glyph_data(CLEAR_CONTEXT* clear, wStream* s, UINT32
 
 	Stream_Read_UINT16(s, glyphIndex);
 
-	if (glyphIndex >= 4000)
+	if (glyphIndex >= CLEARCODEC_GLYPH_SIZE)
 	{
 		WLog_ERR(TAG, "Invalid glyphIndex %" PRIu16 "", glyphIndex);
 		return FALSE;
@@ -1149,18 +1164,582 @@ fail:
 	return rc;
 }
 
-int clear_compress(CLEAR_CONTEXT* clear, const BYTE* pSrcData, UINT32 SrcSize, BYTE** ppDstData,
-                   UINT32* pDstSize)
+static INLINE UINT32 clear_encode_hash(const UINT32* pixels, UINT32 count)
+{
+	UINT32 i;
+	UINT32 hash = 2166136261u ^ count;
+
+	for (i = 0; i < count; i++)
+	{
+		hash ^= pixels[i];
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+static INLINE void clear_write_color(wStream* s, UINT32 color)
+{
+	Stream_Write_UINT8(s, color & 0xFF);         /* blue */
+	Stream_Write_UINT8(s, (color >> 8) & 0xFF);  /* green */
+	Stream_Write_UINT8(s, (color >> 16) & 0xFF); /* red */
+}
+
+static INLINE size_t clear_run_length_size(UINT32 runLength)
+{
+	if (runLength < 0xFF)
+		return 1;
+
+	if (runLength < 0xFFFF)
+		return 3;
+
+	return 7;
+}
+
+static INLINE void clear_write_run_length(wStream* s, UINT32 runLength)
+{
+	if (runLength < 0xFF)
+	{
+		Stream_Write_UINT8(s, runLength);
+		return;
+	}
+
+	Stream_Write_UINT8(s, 0xFF);
+
+	if (runLength < 0xFFFF)
+	{
+		Stream_Write_UINT16(s, runLength);
+		return;
+	}
+
+	Stream_Write_UINT16(s, 0xFFFF);
+	Stream_Write_UINT32(s, runLength);
+}
+
+static BOOL clear_encode_prepare_source(CLEAR_CONTEXT* clear, const BYTE* pSrcData,
+                                        UINT32 SrcFormat, UINT32 nSrcStep, UINT32 nWidth,
+                                        UINT32 nHeight)
+{
+	UINT32 i;
+	const UINT32 count = nWidth * nHeight;
+	BYTE* data;
+
+	if (count > clear->EncodeBufferSize)
+	{
+		UINT32* tmp = (UINT32*)realloc(clear->EncodeBuffer, count * sizeof(UINT32));
+
+		if (!tmp)
+		{
+			WLog_ERR(TAG, "clear->EncodeBuffer realloc failed for %" PRIu32 " pixels", count);
+			return FALSE;
+		}
+
+		clear->EncodeBuffer = tmp;
+		clear->EncodeBufferSize = count;
+	}
+
+	data = (BYTE*)clear->EncodeBuffer;
+
+	if (!freerdp_image_copy(data, PIXEL_FORMAT_BGRX32, nWidth * 4, 0, 0, nWidth, nHeight,
+	                        pSrcData, SrcFormat, nSrcStep, 0, 0, NULL, FREERDP_FLIP_NONE))
+		return FALSE;
+
+	/* Pack every pixel as 0x00RRGGBB so colors compare independent of alpha and byte order */
+	for (i = 0; i < count; i++)
+	{
+		const BYTE* p = &data[i * 4];
+		clear->EncodeBuffer[i] = ((UINT32)p[2] << 16) | ((UINT32)p[1] << 8) | p[0];
+	}
+
+	return TRUE;
+}
+
+static INLINE BOOL clear_encode_entry_equal(const CLEAR_VBAR_ENTRY* entry, const UINT32* pixels,
+                                            UINT32 count, UINT32 hash)
+{
+	if ((entry->count != count) || (entry->hash != hash))
+		return FALSE;
+
+	if (count == 0)
+		return TRUE;
+
+	return memcmp(entry->pixels, pixels, count * sizeof(UINT32)) == 0;
+}
+
+static INT32 clear_encode_vbar_find(const CLEAR_VBAR_ENTRY* storage, const UINT32* lookup,
+                                    UINT32 size, const UINT32* pixels, UINT32 count,
+                                    UINT32 hash)
+{
+	const UINT32 index = lookup[hash % size];
+
+	if (index == 0)
+		return -1;
+
+	if (!clear_encode_entry_equal(&storage[index - 1], pixels, count, hash))
+		return -1;
+
+	return (INT32)index - 1;
+}
+
+static BOOL clear_encode_vbar_store(CLEAR_CONTEXT* clear, CLEAR_VBAR_ENTRY* storage,
+                                    UINT32* lookup, UINT32 size, UINT32 index,
+                                    const UINT32* pixels, UINT32 count, UINT32 hash)
 {
-	WLog_ERR(TAG, "TODO: %s not implemented!", __FUNCTION__);
-	return 1;
+	CLEAR_VBAR_ENTRY* entry = &storage[index];
+	entry->count = count;
+
+	if (!resize_vbar_entry(clear, entry))
+		return FALSE;
+
+	if (count > 0)
+		memcpy(entry->pixels, pixels, count * sizeof(UINT32));
+
+	entry->hash = hash;
+	lookup[hash % size] = index + 1;
+	return TRUE;
+}
+
+static UINT32 clear_encode_band_background(const UINT32* pixels, UINT32 nWidth, UINT32 nHeight)
+{
+	UINT32 i;
+	UINT32 candidate = 0;
+	UINT32 votes = 0;
+	const UINT32 count = nWidth * nHeight;
+
+	/* Boyer-Moore majority vote, good enough to find the background behind text */
+	for (i = 0; i < count; i++)
+	{
+		if (votes == 0)
+		{
+			candidate = pixels[i];
+			votes = 1;
+		}
+		else if (pixels[i] == candidate)
+			votes++;
+		else
+			votes--;
+	}
+
+	return candidate;
 }
+
+/**
+ * Encodes one band covering the full width of rows [y, y + nHeight).
+ * If s is NULL only the encoded size is computed and the caches are left untouched.
+ */
+static BOOL clear_encode_band(CLEAR_CONTEXT* clear, wStream* s, const UINT32* pixels,
+                              UINT32 nWidth, UINT32 y, UINT32 nHeight, size_t* pSize)
+{
+	UINT32 x, i;
+	UINT32 vBar[CLEARCODEC_BAND_MAX_HEIGHT];
+	UINT32 seenColumns[256] = { 0 };
+	UINT32 seenHashes[256] = { 0 };
+	const UINT32* row = &pixels[y * nWidth];
+	const UINT32 colorBkg = clear_encode_band_background(row, nWidth, nHeight);
+	size_t size = 11;
+
+	if (s)
+	{
+		Stream_Write_UINT16(s, 0);               /* xStart */
+		Stream_Write_UINT16(s, nWidth - 1);      /* xEnd */
+		Stream_Write_UINT16(s, y);               /* yStart */
+		Stream_Write_UINT16(s, y + nHeight - 1); /* yEnd */
+		clear_write_color(s, colorBkg);
+	}
+
+	for (x = 0; x < nWidth; x++)
+	{
+		INT32 index;
+		UINT32 hash;
+		UINT32 shortHash;
+		UINT32 vBarYOn = 0;
+		UINT32 vBarYOff = 0;
+		UINT32 shortCount;
+
+		for (i = 0; i < nHeight; i++)
+			vBar[i] = row[i * nWidth + x];
+
+		hash = clear_encode_hash(vBar, nHeight);
+		index = clear_encode_vbar_find(clear->VBarStorage, clear->VBarLookup,
+		                               CLEARCODEC_VBAR_SIZE, vBar, nHeight, hash);
+
+		/* When estimating, columns repeated within this band will hit the cache as well */
+		if (!s && (index < 0))
+		{
+			const UINT32 seen = seenColumns[hash % ARRAYSIZE(seenColumns)];
+
+			if ((seen > 0) && (seenHashes[hash % ARRAYSIZE(seenHashes)] == hash))
+			{
+				for (i = 0; i < nHeight; i++)
+				{
+					if (row[i * nWidth + seen - 1] != vBar[i])
+						break;
+				}
+
+				if (i == nHeight)
+					index = 0;
+			}
+
+			seenColumns[hash % ARRAYSIZE(seenColumns)] = x + 1;
+			seenHashes[hash % ARRAYSIZE(seenHashes)] = hash;
+		}
+
+		if (index >= 0)
+		{
+			/* VBAR_CACHE_HIT */
+			size += 2;
+
+			if (s)
+				Stream_Write_UINT16(s, 0x8000 | (UINT16)index);
+
+			continue;
+		}
+
+		for (i = 0; i < nHeight; i++)
+		{
+			if (vBar[i] != colorBkg)
+			{
+				if (vBarYOff == 0)
+					vBarYOn = i;
+
+				vBarYOff = i + 1;
+			}
+		}
+
+		shortCount = vBarYOff - vBarYOn;
+		shortHash = clear_encode_hash(&vBar[vBarYOn], shortCount);
+		index = -1;
+
+		/* An empty short vbar miss is cheaper than a hit, so never look those up */
+		if (shortCount > 0)
+			index = clear_encode_vbar_find(clear->ShortVBarStorage, clear->ShortVBarLookup,
+			                               CLEARCODEC_VBAR_SHORT_SIZE, &vBar[vBarYOn], shortCount,
+			                               shortHash);
+
+		if (index >= 0)
+		{
+			/* SHORT_VBAR_CACHE_HIT */
+			size += 3;
+
+			if (s)
+			{
+				Stream_Write_UINT16(s, 0x4000 | (UINT16)index);
+				Stream_Write_UINT8(s, vBarYOn);
+			}
+		}
+		else
+		{
+			/* SHORT_VBAR_CACHE_MISS */
+			size += 2 + shortCount * 3;
+
+			if (s)
+			{
+				Stream_Write_UINT16(s, (vBarYOff << 8) | vBarYOn);
+
+				for (i = vBarYOn; i < vBarYOff; i++)
+					clear_write_color(s, vBar[i]);
+
+				if (!clear_encode_vbar_store(clear, clear->ShortVBarStorage,
+				                             clear->ShortVBarLookup, CLEARCODEC_VBAR_SHORT_SIZE,
+				                             clear->ShortVBarStorageCursor, &vBar[vBarYOn],
+				                             shortCount, shortHash))
+					return FALSE;
+
+				clear->ShortVBarStorageCursor =
+				    (clear->ShortVBarStorageCursor + 1) % CLEARCODEC_VBAR_SHORT_SIZE;
+			}
+		}
+
+		/* Both short vbar variants make the decoder store the full vbar */
+		if (s)
+		{
+			if (!clear_encode_vbar_store(clear, clear->VBarStorage, clear->VBarLookup,
+			                             CLEARCODEC_VBAR_SIZE, clear->VBarStorageCursor, vBar,
+			                             nHeight, hash))
+				return FALSE;
+
+			clear->VBarStorageCursor = (clear->VBarStorageCursor + 1) % CLEARCODEC_VBAR_SIZE;
+		}
+	}
+
+	if (pSize)
+		*pSize = size;
+
+	return TRUE;
+}
+
+static size_t clear_encode_residual_size(const UINT32* pixels, UINT32 count)
+{
+	UINT32 i;
+	size_t size = 0;
+	UINT32 runLength = 0;
+
+	for (i = 0; i < count; i++)
+	{
+		if ((runLength > 0) && (pixels[i] == pixels[i - 1]))
+		{
+			runLength++;
+			continue;
+		}
+
+		if (runLength > 0)
+			size += 3 + clear_run_length_size(runLength);
+
+		runLength = 1;
+	}
+
+	if (runLength > 0)
+		size += 3 + clear_run_length_size(runLength);
+
+	return size;
+}
+
+/**
+ * Writes the residual layer. Pixels of bands (useBands[band] set) are overwritten by the
+ * bands layer later on, so they just extend whatever run is currently open.
+ */
+static void clear_encode_residual(wStream* s, const UINT32* pixels, UINT32 nWidth,
+                                  UINT32 nHeight, const BYTE* useBands)
+{
+	UINT32 x, y;
+	UINT32 runColor = 0;
+	UINT32 runLength = 0;
+
+	for (y = 0; y < nHeight; y++)
+	{
+		const BOOL dontCare = useBands[y / CLEARCODEC_BAND_MAX_HEIGHT];
+		const UINT32* row = &pixels[y * nWidth];
+
+		for (x = 0; x < nWidth; x++)
+		{
+			if ((runLength > 0) && (dontCare || (row[x] == runColor)))
+			{
+				runLength++;
+				continue;
+			}
+
+			if (runLength > 0)
+			{
+				clear_write_color(s, runColor);
+				clear_write_run_length(s, runLength);
+			}
+
+			runColor = row[x];
+			runLength = 1;
+		}
+	}
+
+	if (runLength > 0)
+	{
+		clear_write_color(s, runColor);
+		clear_write_run_length(s, runLength);
+	}
+}
+
+static BOOL clear_encode_glyph(CLEAR_CONTEXT* clear, const UINT32* pixels, UINT32 count,
+                               UINT16* pGlyphIndex, BOOL* pHit)
+{
+	UINT32 index;
+	CLEAR_GLYPH_ENTRY* glyphEntry;
+	const UINT32 hash = clear_encode_hash(pixels, count);
+
+	index = clear->GlyphLookup[hash % CLEARCODEC_GLYPH_SIZE];
+
+	if (index > 0)
+	{
+		glyphEntry = &clear->GlyphCache[index - 1];
+
+		if ((glyphEntry->count == count) && (glyphEntry->hash == hash) &&
+		    (memcmp(glyphEntry->pixels, pixels, count * sizeof(UINT32)) == 0))
+		{
+			*pGlyphIndex = (UINT16)(index - 1);
+			*pHit = TRUE;
+			return TRUE;
+		}
+	}
+
+	index = clear->GlyphCursor;
+	clear->GlyphCursor = (clear->GlyphCursor + 1) % CLEARCODEC_GLYPH_SIZE;
+	glyphEntry = &clear->GlyphCache[index];
+
+	if (count > glyphEntry->size)
+	{
+		UINT32* tmp = (UINT32*)realloc(glyphEntry->pixels, count * sizeof(UINT32));
+
+		if (!tmp)
+		{
+			WLog_ERR(TAG, "glyphEntry->pixels realloc %" PRIu32 " failed!", count);
+			return FALSE;
+		}
+
+		glyphEntry->pixels = tmp;
+		glyphEntry->size = count;
+	}
+
+	memcpy(glyphEntry->pixels, pixels, count * sizeof(UINT32));
+	glyphEntry->count = count;
+	glyphEntry->hash = hash;
+	clear->GlyphLookup[hash % CLEARCODEC_GLYPH_SIZE] = index + 1;
+	*pGlyphIndex = (UINT16)index;
+	*pHit = FALSE;
+	return TRUE;
+}
+
+int clear_compress(CLEAR_CONTEXT* clear, const BYTE* pSrcData, UINT32 SrcFormat, UINT32 nSrcStep,
+                   UINT32 nWidth, UINT32 nHeight, BYTE** ppDstData, UINT32* pDstSize)
+{
+	UINT32 band;
+	UINT32 numBands;
+	UINT32 count;
+	BYTE glyphFlags = 0;
+	UINT16 glyphIndex = 0;
+	BOOL useResidual = FALSE;
+	BOOL useBands = FALSE;
+	BYTE* bandFlags = NULL;
+	size_t headerPos;
+	size_t residualPos;
+	size_t bandsPos;
+	size_t endPos;
+	size_t maxSize;
+	wStream* s;
+	int rc = -1;
+
+	if (!clear || !clear->Compressor || !pSrcData || !ppDstData || !pDstSize)
+		return -1;
+
+	if ((nWidth == 0) || (nHeight == 0) || (nWidth > 0xFFFF) || (nHeight > 0xFFFF))
+		return -1;
+
+	if (nSrcStep == 0)
+		nSrcStep = nWidth * GetBytesPerPixel(SrcFormat);
+
+	if (!clear_encode_prepare_source(clear, pSrcData, SrcFormat, nSrcStep, nWidth, nHeight))
+		return -1;
+
+	count = nWidth * nHeight;
+	numBands = (nHeight + CLEARCODEC_BAND_MAX_HEIGHT - 1) / CLEARCODEC_BAND_MAX_HEIGHT;
+	s = clear->EncodeStream;
+	Stream_SetPosition(s, 0);
+
+	/* Worst case: one residual run per pixel plus every band written as cache misses */
+	maxSize = 16 + 7ULL * count + numBands * (11 + nWidth * (2 + 3 * CLEARCODEC_BAND_MAX_HEIGHT));
+
+	if (!Stream_EnsureCapacity(s, maxSize))
+		return -1;
+
+	if (clear->CacheReset)
+	{
+		glyphFlags |= CLEARCODEC_FLAG_CACHE_RESET;
+		clear->CacheReset = FALSE;
+	}
+
+	if (count <= CLEARCODEC_GLYPH_MAX_PIXELS)
+	{
+		BOOL hit;
+
+		if (!clear_encode_glyph(clear, clear->EncodeBuffer, count, &glyphIndex, &hit))
+			return -1;
+
+		glyphFlags |= CLEARCODEC_FLAG_GLYPH_INDEX;
+
+		if (hit)
+			glyphFlags |= CLEARCODEC_FLAG_GLYPH_HIT;
+	}
+
+	Stream_Write_UINT8(s, glyphFlags);
+	Stream_Write_UINT8(s, clear->seqNumber);
+	clear->seqNumber = (clear->seqNumber + 1) % 256;
+
+	if (glyphFlags & CLEARCODEC_FLAG_GLYPH_INDEX)
+		Stream_Write_UINT16(s, glyphIndex);
+
+	if (glyphFlags & CLEARCODEC_FLAG_GLYPH_HIT)
+		goto finish;
+
+	bandFlags = (BYTE*)calloc(numBands, sizeof(BYTE));
+
+	if (!bandFlags)
+		return -1;
+
+	/* Pick the cheaper of the residual and the bands layer for every band sized strip */
+	for (band = 0; band < numBands; band++)
+	{
+		size_t bandSize;
+		const UINT32 y = band * CLEARCODEC_BAND_MAX_HEIGHT;
+		const UINT32 height = MIN(CLEARCODEC_BAND_MAX_HEIGHT, nHeight - y);
+		const size_t residualSize =
+		    clear_encode_residual_size(&clear->EncodeBuffer[y * nWidth], height * nWidth);
+
+		if (!clear_encode_band(clear, NULL, clear->EncodeBuffer, nWidth, y, height, &bandSize))
+			goto fail;
+
+		bandFlags[band] = (bandSize < residualSize) ? 1 : 0;
+
+		if (bandFlags[band])
+			useBands = TRUE;
+		else
+			useResidual = TRUE;
+	}
+
+	headerPos = Stream_GetPosition(s);
+	Stream_Seek(s, 12);
+	residualPos = Stream_GetPosition(s);
+
+	if (useResidual)
+		clear_encode_residual(s, clear->EncodeBuffer, nWidth, nHeight, bandFlags);
+
+	bandsPos = Stream_GetPosition(s);
+
+	if (useBands)
+	{
+		for (band = 0; band < numBands; band++)
+		{
+			const UINT32 y = band * CLEARCODEC_BAND_MAX_HEIGHT;
+			const UINT32 height = MIN(CLEARCODEC_BAND_MAX_HEIGHT, nHeight - y);
+
+			if (!bandFlags[band])
+				continue;
+
+			if (!clear_encode_band(clear, s, clear->EncodeBuffer, nWidth, y, height, NULL))
+				goto fail;
+		}
+	}
+
+	endPos = Stream_GetPosition(s);
+	Stream_SetPosition(s, headerPos);
+	Stream_Write_UINT32(s, (UINT32)(bandsPos - residualPos)); /* residualByteCount */
+	Stream_Write_UINT32(s, (UINT32)(endPos - bandsPos));      /* bandsByteCount */
+	Stream_Write_UINT32(s, 0);                                /* subcodecByteCount */
+	Stream_SetPosition(s, endPos);
+finish:
+	Stream_SealLength(s);
+	*ppDstData = Stream_Buffer(s);
+	*pDstSize = (UINT32)Stream_Length(s);
+	rc = 0;
+fail:
+	free(bandFlags);
+	return rc;
+}
+
 BOOL clear_context_reset(CLEAR_CONTEXT* clear)
 {
 	if (!clear)
 		return FALSE;
 
 	clear->seqNumber = 0;
+
+	if (clear->Compressor)
+	{
+		/* The peer restarts with empty caches, forget everything we assumed it holds */
+		clear->CacheReset = TRUE;
+		clear->VBarStorageCursor = 0;
+		clear->ShortVBarStorageCursor = 0;
+		clear->GlyphCursor = 0;
+		memset(clear->GlyphLookup, 0, CLEARCODEC_GLYPH_SIZE * sizeof(UINT32));
+		memset(clear->VBarLookup, 0, CLEARCODEC_VBAR_SIZE * sizeof(UINT32));
+		memset(clear->ShortVBarLookup, 0, CLEARCODEC_VBAR_SHORT_SIZE * sizeof(UINT32));
+	}
+
 	return TRUE;
 }
 CLEAR_CONTEXT* clear_context_new(BOOL Compressor)
@@ -1186,6 +1765,18 @@ CLEAR_CONTEXT* clear_context_new(BOOL Compressor)
 	if (!clear->TempBuffer)
 		goto error_nsc;
 
+	if (Compressor)
+	{
+		clear->GlyphLookup = (UINT32*)calloc(CLEARCODEC_GLYPH_SIZE, sizeof(UINT32));
+		clear->VBarLookup = (UINT32*)calloc(CLEARCODEC_VBAR_SIZE, sizeof(UINT32));
+		clear->ShortVBarLookup = (UINT32*)calloc(CLEARCODEC_VBAR_SHORT_SIZE, sizeof(UINT32));
+		clear->EncodeStream = Stream_New(NULL, 4096);
+
+		if (!clear->GlyphLookup || !clear->VBarLookup || !clear->ShortVBarLookup ||
+		    !clear->EncodeStream)
+			goto error_nsc;
+	}
+
 	if (!clear_context_reset(clear))
 		goto error_nsc;
 
@@ -1203,8 +1794,13 @@ void clear_context_free(CLEAR_CONTEXT* clear)
 
 	nsc_context_free(clear->nsc);
 	free(clear->TempBuffer);
+	free(clear->GlyphLookup);
+	free(clear->VBarLookup);
+	free(clear->ShortVBarLookup);
+	free(clear->EncodeBuffer);
+	Stream_Free(clear->EncodeStream, TRUE);
 
-	for (i = 0; i < 4000; i++)
+	for (i = 0; i < CLEARCODEC_GLYPH_SIZE; i++)
 		free(clear->GlyphCache[i].pixels);
 
 	for (i = 0; i < 32768; i++)
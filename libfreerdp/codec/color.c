@@ -694,32 +694,13 @@ BOOL freerdp_image_copy(BYTE* pDstData, DWORD DstFormat, UINT32 nDstStep, UINT32
 	}
 	else
 	{
-		UINT32 x, y;
+		/* The conversion for each format pair is picked by the primitives */
+		primitives_t* prims = primitives_get();
 
-		for (y = 0; y < nHeight; y++)
-		{
-			const BYTE* srcLine = &pSrcData[(y + nYSrc) * nSrcStep * srcVMultiplier + srcVOffset];
-			BYTE* dstLine = &pDstData[(y + nYDst) * nDstStep * dstVMultiplier + dstVOffset];
-
-			UINT32 color = ReadColor(&srcLine[nXSrc * srcByte], SrcFormat);
-			UINT32 oldColor = color;
-			UINT32 dstColor = FreeRDPConvertColor(color, SrcFormat, DstFormat, palette);
-			WriteColor(&dstLine[nXDst * dstByte], DstFormat, dstColor);
-			for (x = 1; x < nWidth; x++)
-			{
-				color = ReadColor(&srcLine[(x + nXSrc) * srcByte], SrcFormat);
-				if (color == oldColor)
-				{
-					WriteColor(&dstLine[(x + nXDst) * dstByte], DstFormat, dstColor);
-				}
-				else
-				{
-					oldColor = color;
-					dstColor = FreeRDPConvertColor(color, SrcFormat, DstFormat, palette);
-					WriteColor(&dstLine[(x + nXDst) * dstByte], DstFormat, dstColor);
-				}
-			}
-		}
+		if (prims->copy_no_overlap(pDstData, DstFormat, nDstStep, nXDst, nYDst, nWidth, nHeight,
+		                           pSrcData, SrcFormat, nSrcStep, nXSrc, nYSrc, palette,
+		                           flags) != PRIMITIVES_SUCCESS)
+			return FALSE;
 	}
 
 	return TRUE;
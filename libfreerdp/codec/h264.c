@@ -27,6 +27,8 @@
 #include <winpr/library.h>
 #include <winpr/bitstream.h>
 #include <winpr/synch.h>
+#include <winpr/sysinfo.h>
+#include <winpr/pool.h>
 
 #include <freerdp/primitives.h>
 #include <freerdp/codec/h264.h>
@@ -94,77 +96,325 @@ static BOOL check_rect(const H264_CONTEXT* h264, const RECTANGLE_16* rect, UINT3
 	return TRUE;
 }
 
-static BOOL avc_yuv_to_rgb(H264_CONTEXT* h264, const RECTANGLE_16* regionRects,
-                           UINT32 numRegionRects, UINT32 nDstWidth, UINT32 nDstHeight,
-                           UINT32 nDstStep, BYTE* pDstData, DWORD DstFormat, BOOL use444)
+/* Rows per band when a region is split for the worker threads.
+ * Even, so that the 4:2:0 chroma rows of a band start where the ones of the whole rect would. */
+#define H264_BAND_HEIGHT 64
+/* Regions with less pixels are not worth the thread handoff */
+#define H264_THREAD_MIN_PIXELS (256 * 256)
+
+struct _H264_CONVERT_WORK_PARAM
+{
+	H264_CONTEXT* h264;
+	UINT32 first;
+	UINT32 step;
+	BOOL success;
+};
+typedef struct _H264_CONVERT_WORK_PARAM H264_CONVERT_WORK_PARAM;
+
+struct _H264_CONTEXT_WORKERS
+{
+	UINT32 count;
+	PTP_POOL ThreadPool;
+	TP_CALLBACK_ENVIRON ThreadPoolEnv;
+	PTP_WORK* workObjects;
+	H264_CONVERT_WORK_PARAM* params;
+	UINT32 pending;
+
+	/* The conversion the work objects are running */
+	RECTANGLE_16* bands;
+	UINT32 numBands;
+	UINT32 maxBands;
+	BYTE* pDstData;
+	DWORD DstFormat;
+	UINT32 nDstStep;
+	BOOL use444;
+};
+
+static BOOL avc_yuv_to_rgb_rect(H264_CONTEXT* h264, const RECTANGLE_16* rect, UINT32 nDstStep,
+                                BYTE* pDstData, DWORD DstFormat, BOOL use444)
 {
-	UINT32 x;
 	BYTE* pDstPoint;
 	prim_size_t roi;
-	INT32 width, height;
 	const BYTE* pYUVPoint[3];
+	const UINT32* iStride;
+	BYTE** ppYUVData;
 	primitives_t* prims = primitives_get();
 
-	for (x = 0; x < numRegionRects; x++)
+	if (use444)
 	{
-		const RECTANGLE_16* rect = &(regionRects[x]);
-		const UINT32* iStride;
-		BYTE** ppYUVData;
+		iStride = h264->iYUV444Stride;
+		ppYUVData = h264->pYUV444Data;
+	}
+	else
+	{
+		iStride = h264->iStride;
+		ppYUVData = h264->pYUVData;
+	}
 
-		if (use444)
-		{
-			iStride = h264->iYUV444Stride;
-			ppYUVData = h264->pYUV444Data;
-		}
-		else
+	pDstPoint = pDstData + rect->top * nDstStep + rect->left * 4;
+	pYUVPoint[0] = ppYUVData[0] + rect->top * iStride[0] + rect->left;
+	pYUVPoint[1] = ppYUVData[1];
+	pYUVPoint[2] = ppYUVData[2];
+
+	if (use444)
+	{
+		pYUVPoint[1] += rect->top * iStride[1] + rect->left;
+		pYUVPoint[2] += rect->top * iStride[2] + rect->left;
+	}
+	else
+	{
+		pYUVPoint[1] += rect->top / 2 * iStride[1] + rect->left / 2;
+		pYUVPoint[2] += rect->top / 2 * iStride[2] + rect->left / 2;
+	}
+
+	roi.width = rect->right - rect->left;
+	roi.height = rect->bottom - rect->top;
+
+	if (use444)
+	{
+		if (prims->YUV444ToRGB_8u_P3AC4R(pYUVPoint, iStride, pDstPoint, nDstStep, DstFormat,
+		                                 &roi) != PRIMITIVES_SUCCESS)
+			return FALSE;
+	}
+	else
+	{
+		if (prims->YUV420ToRGB_8u_P3AC4R(pYUVPoint, iStride, pDstPoint, nDstStep, DstFormat,
+		                                 &roi) != PRIMITIVES_SUCCESS)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static void avc_yuv_to_rgb_bands(H264_CONVERT_WORK_PARAM* param)
+{
+	UINT32 x;
+	H264_CONTEXT_WORKERS* workers = param->h264->workers;
+	param->success = TRUE;
+
+	/* Bands are dealt round robin so that every worker gets a share of each rect */
+	for (x = param->first; x < workers->numBands; x += param->step)
+	{
+		if (!avc_yuv_to_rgb_rect(param->h264, &workers->bands[x], workers->nDstStep,
+		                         workers->pDstData, workers->DstFormat, workers->use444))
+			param->success = FALSE;
+	}
+}
+
+static void CALLBACK avc_yuv_to_rgb_work_callback(PTP_CALLBACK_INSTANCE instance, void* context,
+                                                  PTP_WORK work)
+{
+	WINPR_UNUSED(instance);
+	WINPR_UNUSED(work);
+	avc_yuv_to_rgb_bands((H264_CONVERT_WORK_PARAM*)context);
+}
+
+static void h264_workers_free(H264_CONTEXT_WORKERS* workers)
+{
+	if (!workers)
+		return;
+
+	if (workers->ThreadPool)
+	{
+		CloseThreadpool(workers->ThreadPool);
+		DestroyThreadpoolEnvironment(&workers->ThreadPoolEnv);
+	}
+
+	free(workers->bands);
+	free(workers->params);
+	free(workers->workObjects);
+	free(workers);
+}
+
+static H264_CONTEXT_WORKERS* h264_workers_new(H264_CONTEXT* h264)
+{
+	UINT32 x;
+	SYSTEM_INFO sysinfo;
+	H264_CONTEXT_WORKERS* workers =
+	    (H264_CONTEXT_WORKERS*)calloc(1, sizeof(H264_CONTEXT_WORKERS));
+
+	if (!workers)
+		return NULL;
+
+	GetNativeSystemInfo(&sysinfo);
+	workers->count = MAX(1, sysinfo.dwNumberOfProcessors);
+	workers->params =
+	    (H264_CONVERT_WORK_PARAM*)calloc(workers->count, sizeof(H264_CONVERT_WORK_PARAM));
+	workers->workObjects = (PTP_WORK*)calloc(workers->count, sizeof(PTP_WORK));
+
+	if (!workers->params || !workers->workObjects)
+		goto fail;
+
+	for (x = 0; x < workers->count; x++)
+		workers->params[x].h264 = h264;
+
+	if (workers->count > 1)
+	{
+		workers->ThreadPool = CreateThreadpool(NULL);
+
+		if (!workers->ThreadPool)
+			goto fail;
+
+		InitializeThreadpoolEnvironment(&workers->ThreadPoolEnv);
+		SetThreadpoolCallbackPool(&workers->ThreadPoolEnv, workers->ThreadPool);
+
+		if (!SetThreadpoolThreadMinimum(workers->ThreadPool, workers->count))
+			goto fail;
+	}
+
+	return workers;
+fail:
+	h264_workers_free(workers);
+	return NULL;
+}
+
+static BOOL h264_workers_add_band(H264_CONTEXT_WORKERS* workers, const RECTANGLE_16* band)
+{
+	if (workers->numBands >= workers->maxBands)
+	{
+		const UINT32 maxBands = MAX(64, workers->maxBands * 2);
+		RECTANGLE_16* bands =
+		    (RECTANGLE_16*)realloc(workers->bands, maxBands * sizeof(RECTANGLE_16));
+
+		if (!bands)
+			return FALSE;
+
+		workers->bands = bands;
+		workers->maxBands = maxBands;
+	}
+
+	workers->bands[workers->numBands++] = *band;
+	return TRUE;
+}
+
+/**
+ * Wait for the conversion started by avc_yuv_to_rgb_begin.
+ * Must be called before the YUV planes or the destination are touched again.
+ */
+static BOOL avc_yuv_to_rgb_end(H264_CONTEXT* h264)
+{
+	UINT32 x;
+	BOOL rc = TRUE;
+	H264_CONTEXT_WORKERS* workers = h264->workers;
+
+	if (!workers)
+		return TRUE;
+
+	for (x = 0; x < workers->pending; x++)
+	{
+		if (workers->workObjects[x])
 		{
-			iStride = h264->iStride;
-			ppYUVData = h264->pYUVData;
+			WaitForThreadpoolWorkCallbacks(workers->workObjects[x], FALSE);
+			CloseThreadpoolWork(workers->workObjects[x]);
+			workers->workObjects[x] = NULL;
 		}
 
+		rc &= workers->params[x].success;
+	}
+
+	workers->pending = 0;
+	return rc;
+}
+
+/**
+ * Convert the region to RGB. Large regions are split in bands and handed to the workers,
+ * which may still be running on return; avc_yuv_to_rgb_end waits for them.
+ */
+static BOOL avc_yuv_to_rgb_begin(H264_CONTEXT* h264, const RECTANGLE_16* regionRects,
+                                 UINT32 numRegionRects, UINT32 nDstWidth, UINT32 nDstHeight,
+                                 UINT32 nDstStep, BYTE* pDstData, DWORD DstFormat, BOOL use444)
+{
+	UINT32 x;
+	UINT32 numWorkers;
+	UINT64 pixels = 0;
+	H264_CONTEXT_WORKERS* workers;
+	primitives_t* prims = primitives_get();
+
+	for (x = 0; x < numRegionRects; x++)
+	{
+		const RECTANGLE_16* rect = &(regionRects[x]);
+
 		if (!check_rect(h264, rect, nDstWidth, nDstHeight))
 			return FALSE;
 
-		width = rect->right - rect->left;
-		height = rect->bottom - rect->top;
-		pDstPoint = pDstData + rect->top * nDstStep + rect->left * 4;
-		pYUVPoint[0] = ppYUVData[0] + rect->top * iStride[0] + rect->left;
-		pYUVPoint[1] = ppYUVData[1];
-		pYUVPoint[2] = ppYUVData[2];
+		pixels += 1ULL * (rect->right - rect->left) * (rect->bottom - rect->top);
+	}
 
-		if (use444)
-		{
-			pYUVPoint[1] += rect->top * iStride[1] + rect->left;
-			pYUVPoint[2] += rect->top * iStride[2] + rect->left;
-		}
-		else
-		{
-			pYUVPoint[1] += rect->top / 2 * iStride[1] + rect->left / 2;
-			pYUVPoint[2] += rect->top / 2 * iStride[2] + rect->left / 2;
-		}
+	if (!h264->UseThreads || (pixels < H264_THREAD_MIN_PIXELS) ||
+	    (primitives_flags(prims) & PRIM_FLAGS_HAVE_EXTGPU))
+		goto serial;
 
-		roi.width = width;
-		roi.height = height;
+	if (!h264->workers && !(h264->workers = h264_workers_new(h264)))
+		goto serial;
 
-		if (use444)
+	workers = h264->workers;
+
+	if (workers->count < 2)
+		goto serial;
+
+	workers->numBands = 0;
+
+	for (x = 0; x < numRegionRects; x++)
+	{
+		RECTANGLE_16 band = regionRects[x];
+
+		while (band.top < regionRects[x].bottom)
 		{
-			if (prims->YUV444ToRGB_8u_P3AC4R(pYUVPoint, iStride, pDstPoint, nDstStep, DstFormat,
-			                                 &roi) != PRIMITIVES_SUCCESS)
-			{
+			band.bottom = MIN(regionRects[x].bottom, band.top + H264_BAND_HEIGHT);
+
+			if (!h264_workers_add_band(workers, &band))
 				return FALSE;
-			}
+
+			band.top = band.bottom;
 		}
-		else
+	}
+
+	workers->pDstData = pDstData;
+	workers->DstFormat = DstFormat;
+	workers->nDstStep = nDstStep;
+	workers->use444 = use444;
+	numWorkers = MIN(workers->count, workers->numBands);
+
+	for (x = 0; x < numWorkers; x++)
+	{
+		H264_CONVERT_WORK_PARAM* param = &workers->params[x];
+		param->first = x;
+		param->step = numWorkers;
+		param->success = FALSE;
+
+		if (!(workers->workObjects[x] = CreateThreadpoolWork(
+		          avc_yuv_to_rgb_work_callback, (void*)param, &workers->ThreadPoolEnv)))
 		{
-			if (prims->YUV420ToRGB_8u_P3AC4R(pYUVPoint, iStride, pDstPoint, nDstStep, DstFormat,
-			                                 &roi) != PRIMITIVES_SUCCESS)
-				return FALSE;
+			WLog_Print(h264->log, WLOG_ERROR, "CreateThreadpoolWork failed.");
+			avc_yuv_to_rgb_bands(param);
+			continue;
 		}
+
+		SubmitThreadpoolWork(workers->workObjects[x]);
+	}
+
+	workers->pending = numWorkers;
+	return TRUE;
+
+serial:
+	for (x = 0; x < numRegionRects; x++)
+	{
+		if (!avc_yuv_to_rgb_rect(h264, &regionRects[x], nDstStep, pDstData, DstFormat, use444))
+			return FALSE;
 	}
 
 	return TRUE;
 }
 
+static BOOL avc_yuv_to_rgb(H264_CONTEXT* h264, const RECTANGLE_16* regionRects,
+                           UINT32 numRegionRects, UINT32 nDstWidth, UINT32 nDstHeight,
+                           UINT32 nDstStep, BYTE* pDstData, DWORD DstFormat, BOOL use444)
+{
+	const BOOL rc = avc_yuv_to_rgb_begin(h264, regionRects, numRegionRects, nDstWidth,
+	                                     nDstHeight, nDstStep, pDstData, DstFormat, use444);
+	return avc_yuv_to_rgb_end(h264) && rc;
+}
+
 INT32 avc420_decompress(H264_CONTEXT* h264, const BYTE* pSrcData, UINT32 SrcSize, BYTE* pDstData,
                         DWORD DstFormat, UINT32 nDstStep, UINT32 nDstWidth, UINT32 nDstHeight,
                         RECTANGLE_16* regionRects, UINT32 numRegionRects)
@@ -359,6 +609,11 @@ static BOOL avc444_process_rects(H264_CONTEXT* h264, const BYTE* pSrcData, UINT3
 	if (h264->subsystem->Decompress(h264, pSrcData, SrcSize) < 0)
 		return FALSE;
 
+	/* The conversion of the previous stream ran in parallel with the decode above,
+	 * it reads the YUV444 planes combined below. */
+	if (!avc_yuv_to_rgb_end(h264))
+		return FALSE;
+
 	if (!avc444_ensure_buffer(h264, nDstHeight))
 		return FALSE;
 
@@ -378,11 +633,8 @@ static BOOL avc444_process_rects(H264_CONTEXT* h264, const BYTE* pSrcData, UINT3
 			return FALSE;
 	}
 
-	if (!avc_yuv_to_rgb(h264, rects, nrRects, nDstWidth, nDstHeight, nDstStep, pDstData, DstFormat,
-	                    TRUE))
-		return FALSE;
-
-	return TRUE;
+	return avc_yuv_to_rgb_begin(h264, rects, nrRects, nDstWidth, nDstHeight, nDstStep, pDstData,
+	                            DstFormat, TRUE);
 }
 
 #if defined(AVC444_FRAME_STAT)
@@ -454,6 +706,9 @@ INT32 avc444_decompress(H264_CONTEXT* h264, BYTE op, RECTANGLE_16* regionRects,
 			break;
 	}
 
+	if (!avc_yuv_to_rgb_end(h264))
+		status = -1;
+
 #if defined(AVC444_FRAME_STAT)
 
 	switch (op)
@@ -573,7 +828,10 @@ H264_CONTEXT* h264_context_new(BOOL Compressor)
 
 	if (h264)
 	{
+		SYSTEM_INFO sysinfo;
+		GetNativeSystemInfo(&sysinfo);
 		h264->Compressor = Compressor;
+		h264->UseThreads = !Compressor && (sysinfo.dwNumberOfProcessors > 1);
 
 		if (Compressor)
 		{
@@ -596,6 +854,8 @@ void h264_context_free(H264_CONTEXT* h264)
 {
 	if (h264)
 	{
+		avc_yuv_to_rgb_end(h264);
+		h264_workers_free(h264->workers);
 		h264->subsystem->Uninit(h264);
 		_aligned_free(h264->pYUV444Data[0]);
 		_aligned_free(h264->pYUV444Data[1]);
@@ -29,6 +29,8 @@
 #include <freerdp/log.h>
 #include <freerdp/codec/mppc.h>
 
+#include "bulk_match.h"
+
 #define TAG FREERDP_TAG("codec.mppc")
 
 #define MPPC_MATCH_INDEX(_sym1, _sym2, _sym3)                             \
@@ -46,7 +48,9 @@ struct _MPPC_CONTEXT
 	UINT32 HistoryBufferSize;
 	BYTE HistoryBuffer[65536];
 	UINT16 MatchBuffer[32768];
+	UINT16 ChainBuffer[65536];
 	UINT32 CompressionLevel;
+	BULK_MATCH_PARAMS MatchParams;
 };
 
 static const UINT32 MPPC_MATCH_TABLE[256] = {
@@ -422,59 +426,199 @@ int mppc_decompress(MPPC_CONTEXT* mppc, BYTE* pSrcData, UINT32 SrcSize, BYTE** p
 	return 1;
 }
 
-int mppc_compress(MPPC_CONTEXT* mppc, BYTE* pSrcData, UINT32 SrcSize, BYTE** ppDstData,
-                  UINT32* pDstSize, UINT32* pFlags)
+static INLINE void mppc_write_literal(wBitStream* bs, UINT32 accumulator)
 {
-	BYTE* pSrcPtr;
-	BYTE* pSrcEnd;
-	BYTE* MatchPtr;
-	UINT32 DstSize;
-	BYTE* pDstData;
-	UINT32 MatchIndex;
-	UINT32 accumulator;
-	BOOL PacketFlushed;
-	BOOL PacketAtFront;
-	DWORD CopyOffset;
-	DWORD LengthOfMatch;
-	BYTE* HistoryBuffer;
-	BYTE* HistoryPtr;
-	UINT32 HistoryOffset;
-	UINT32 HistoryBufferSize;
-	BYTE Sym1, Sym2, Sym3;
-	UINT32 CompressionLevel;
-	wBitStream* bs = mppc->bs;
-	HistoryBuffer = mppc->HistoryBuffer;
-	HistoryBufferSize = mppc->HistoryBufferSize;
-	CompressionLevel = mppc->CompressionLevel;
-	HistoryOffset = mppc->HistoryOffset;
-	*pFlags = 0;
-	PacketFlushed = FALSE;
+#ifdef DEBUG_MPPC
+	WLog_DBG(TAG, "%" PRIu32 "", accumulator);
+#endif
 
-	if (((HistoryOffset + SrcSize) < (HistoryBufferSize - 3)) && HistoryOffset)
+	if (accumulator < 0x80)
 	{
-		PacketAtFront = FALSE;
+		/* 8 bits of literal are encoded as-is */
+		BitStream_Write_Bits(bs, accumulator, 8);
 	}
 	else
 	{
-		if (HistoryOffset == (HistoryBufferSize + 1))
-			PacketFlushed = TRUE;
+		/* bits 10 followed by lower 7 bits of literal */
+		accumulator = 0x100 | (accumulator & 0x7F);
+		BitStream_Write_Bits(bs, accumulator, 9);
+	}
+}
 
-		HistoryOffset = 0;
-		PacketAtFront = TRUE;
+static INLINE void mppc_write_match(wBitStream* bs, UINT32 CompressionLevel, DWORD CopyOffset,
+                                    DWORD LengthOfMatch)
+{
+	UINT32 accumulator;
+#ifdef DEBUG_MPPC
+	WLog_DBG(TAG, "<%" PRIu32 ",%" PRIu32 ">", CopyOffset, LengthOfMatch);
+#endif
+
+	/* Encode CopyOffset */
+
+	if (CompressionLevel) /* RDP5 */
+	{
+		if (CopyOffset < 64)
+		{
+			/* bits 11111 + lower 6 bits of CopyOffset */
+			accumulator = 0x07C0 | (CopyOffset & 0x003F);
+			BitStream_Write_Bits(bs, accumulator, 11);
+		}
+		else if ((CopyOffset >= 64) && (CopyOffset < 320))
+		{
+			/* bits 11110 + lower 8 bits of (CopyOffset - 64) */
+			accumulator = 0x1E00 | ((CopyOffset - 64) & 0x00FF);
+			BitStream_Write_Bits(bs, accumulator, 13);
+		}
+		else if ((CopyOffset >= 320) && (CopyOffset < 2368))
+		{
+			/* bits 1110 + lower 11 bits of (CopyOffset - 320) */
+			accumulator = 0x7000 | ((CopyOffset - 320) & 0x07FF);
+			BitStream_Write_Bits(bs, accumulator, 15);
+		}
+		else
+		{
+			/* bits 110 + lower 16 bits of (CopyOffset - 2368) */
+			accumulator = 0x060000 | ((CopyOffset - 2368) & 0xFFFF);
+			BitStream_Write_Bits(bs, accumulator, 19);
+		}
+	}
+	else /* RDP4 */
+	{
+		if (CopyOffset < 64)
+		{
+			/* bits 1111 + lower 6 bits of CopyOffset */
+			accumulator = 0x03C0 | (CopyOffset & 0x003F);
+			BitStream_Write_Bits(bs, accumulator, 10);
+		}
+		else if ((CopyOffset >= 64) && (CopyOffset < 320))
+		{
+			/* bits 1110 + lower 8 bits of (CopyOffset - 64) */
+			accumulator = 0x0E00 | ((CopyOffset - 64) & 0x00FF);
+			BitStream_Write_Bits(bs, accumulator, 12);
+		}
+		else if ((CopyOffset >= 320) && (CopyOffset < 8192))
+		{
+			/* bits 110 + lower 13 bits of (CopyOffset - 320) */
+			accumulator = 0xC000 | ((CopyOffset - 320) & 0x1FFF);
+			BitStream_Write_Bits(bs, accumulator, 16);
+		}
 	}
 
-	HistoryPtr = &(HistoryBuffer[HistoryOffset]);
-	pDstData = *ppDstData;
+	/* Encode LengthOfMatch */
 
-	if (!pDstData)
-		return -1;
+	if (LengthOfMatch == 3)
+	{
+		/* 0 + 0 lower bits of LengthOfMatch */
+		BitStream_Write_Bits(bs, 0, 1);
+	}
+	else if ((LengthOfMatch >= 4) && (LengthOfMatch < 8))
+	{
+		/* 10 + 2 lower bits of LengthOfMatch */
+		accumulator = 0x0008 | (LengthOfMatch & 0x0003);
+		BitStream_Write_Bits(bs, accumulator, 4);
+	}
+	else if ((LengthOfMatch >= 8) && (LengthOfMatch < 16))
+	{
+		/* 110 + 3 lower bits of LengthOfMatch */
+		accumulator = 0x0030 | (LengthOfMatch & 0x0007);
+		BitStream_Write_Bits(bs, accumulator, 6);
+	}
+	else if ((LengthOfMatch >= 16) && (LengthOfMatch < 32))
+	{
+		/* 1110 + 4 lower bits of LengthOfMatch */
+		accumulator = 0x00E0 | (LengthOfMatch & 0x000F);
+		BitStream_Write_Bits(bs, accumulator, 8);
+	}
+	else if ((LengthOfMatch >= 32) && (LengthOfMatch < 64))
+	{
+		/* 11110 + 5 lower bits of LengthOfMatch */
+		accumulator = 0x03C0 | (LengthOfMatch & 0x001F);
+		BitStream_Write_Bits(bs, accumulator, 10);
+	}
+	else if ((LengthOfMatch >= 64) && (LengthOfMatch < 128))
+	{
+		/* 111110 + 6 lower bits of LengthOfMatch */
+		accumulator = 0x0F80 | (LengthOfMatch & 0x003F);
+		BitStream_Write_Bits(bs, accumulator, 12);
+	}
+	else if ((LengthOfMatch >= 128) && (LengthOfMatch < 256))
+	{
+		/* 1111110 + 7 lower bits of LengthOfMatch */
+		accumulator = 0x3F00 | (LengthOfMatch & 0x007F);
+		BitStream_Write_Bits(bs, accumulator, 14);
+	}
+	else if ((LengthOfMatch >= 256) && (LengthOfMatch < 512))
+	{
+		/* 11111110 + 8 lower bits of LengthOfMatch */
+		accumulator = 0xFE00 | (LengthOfMatch & 0x00FF);
+		BitStream_Write_Bits(bs, accumulator, 16);
+	}
+	else if ((LengthOfMatch >= 512) && (LengthOfMatch < 1024))
+	{
+		/* 111111110 + 9 lower bits of LengthOfMatch */
+		accumulator = 0x3FC00 | (LengthOfMatch & 0x01FF);
+		BitStream_Write_Bits(bs, accumulator, 18);
+	}
+	else if ((LengthOfMatch >= 1024) && (LengthOfMatch < 2048))
+	{
+		/* 1111111110 + 10 lower bits of LengthOfMatch */
+		accumulator = 0xFF800 | (LengthOfMatch & 0x03FF);
+		BitStream_Write_Bits(bs, accumulator, 20);
+	}
+	else if ((LengthOfMatch >= 2048) && (LengthOfMatch < 4096))
+	{
+		/* 11111111110 + 11 lower bits of LengthOfMatch */
+		accumulator = 0x3FF000 | (LengthOfMatch & 0x07FF);
+		BitStream_Write_Bits(bs, accumulator, 22);
+	}
+	else if ((LengthOfMatch >= 4096) && (LengthOfMatch < 8192))
+	{
+		/* 111111111110 + 12 lower bits of LengthOfMatch */
+		accumulator = 0xFFE000 | (LengthOfMatch & 0x0FFF);
+		BitStream_Write_Bits(bs, accumulator, 24);
+	}
+	else if (((LengthOfMatch >= 8192) && (LengthOfMatch < 16384)) &&
+	         CompressionLevel) /* RDP5 */
+	{
+		/* 1111111111110 + 13 lower bits of LengthOfMatch */
+		accumulator = 0x3FFC000 | (LengthOfMatch & 0x1FFF);
+		BitStream_Write_Bits(bs, accumulator, 26);
+	}
+	else if (((LengthOfMatch >= 16384) && (LengthOfMatch < 32768)) &&
+	         CompressionLevel) /* RDP5 */
+	{
+		/* 11111111111110 + 14 lower bits of LengthOfMatch */
+		accumulator = 0xFFF8000 | (LengthOfMatch & 0x3FFF);
+		BitStream_Write_Bits(bs, accumulator, 28);
+	}
+	else if (((LengthOfMatch >= 32768) && (LengthOfMatch < 65536)) &&
+	         CompressionLevel) /* RDP5 */
+	{
+		/* 111111111111110 + 15 lower bits of LengthOfMatch */
+		accumulator = 0x3FFF0000 | (LengthOfMatch & 0x7FFF);
+		BitStream_Write_Bits(bs, accumulator, 30);
+	}
+}
 
-	if (*pDstSize > SrcSize)
-		DstSize = SrcSize;
-	else
-		DstSize = *pDstSize;
+/**
+ * Single slot match finder: the last position of every hash is kept and matches are
+ * extended as the input is copied to the history. This is the historic encoder output.
+ */
 
-	BitStream_Attach(bs, pDstData, DstSize);
+static BOOL mppc_compress_legacy(MPPC_CONTEXT* mppc, BYTE* pSrcData, UINT32 SrcSize,
+                                 UINT32 DstSize, BYTE** ppHistoryPtr)
+{
+	BYTE* pSrcPtr;
+	BYTE* pSrcEnd;
+	BYTE* MatchPtr;
+	UINT32 MatchIndex;
+	DWORD CopyOffset;
+	DWORD LengthOfMatch;
+	BYTE Sym1, Sym2, Sym3;
+	wBitStream* bs = mppc->bs;
+	BYTE* HistoryBuffer = mppc->HistoryBuffer;
+	BYTE* HistoryPtr = *ppHistoryPtr;
+	const UINT32 HistoryBufferSize = mppc->HistoryBufferSize;
 	pSrcPtr = pSrcData;
 	pSrcEnd = &(pSrcData[SrcSize - 1]);
 
@@ -498,31 +642,9 @@ int mppc_compress(MPPC_CONTEXT* mppc, BYTE* pSrcData, UINT32 SrcSize, BYTE** ppD
 		    (MatchPtr == (HistoryPtr - 1)) || (MatchPtr == HistoryPtr))
 		{
 			if (((bs->position / 8) + 2) > (DstSize - 1))
-			{
-				mppc_context_reset(mppc, TRUE);
-				*pFlags |= PACKET_FLUSHED;
-				*pFlags |= CompressionLevel;
-				*ppDstData = pSrcData;
-				*pDstSize = SrcSize;
-				return 1;
-			}
+				return FALSE;
 
-			accumulator = Sym1;
-#ifdef DEBUG_MPPC
-			WLog_DBG(TAG, "%" PRIu32 "", accumulator);
-#endif
-
-			if (accumulator < 0x80)
-			{
-				/* 8 bits of literal are encoded as-is */
-				BitStream_Write_Bits(bs, accumulator, 8);
-			}
-			else
-			{
-				/* bits 10 followed by lower 7 bits of literal */
-				accumulator = 0x100 | (accumulator & 0x7F);
-				BitStream_Write_Bits(bs, accumulator, 9);
-			}
+			mppc_write_literal(bs, Sym1);
 		}
 		else
 		{
@@ -540,165 +662,10 @@ int mppc_compress(MPPC_CONTEXT* mppc, BYTE* pSrcData, UINT32 SrcSize, BYTE** ppD
 				LengthOfMatch++;
 			}
 
-#ifdef DEBUG_MPPC
-			WLog_DBG(TAG, "<%" PRIu32 ",%" PRIu32 ">", CopyOffset, LengthOfMatch);
-#endif
-
-			/* Encode CopyOffset */
-
 			if (((bs->position / 8) + 7) > (DstSize - 1))
-			{
-				mppc_context_reset(mppc, TRUE);
-				*pFlags |= PACKET_FLUSHED;
-				*pFlags |= CompressionLevel;
-				*ppDstData = pSrcData;
-				*pDstSize = SrcSize;
-				return 1;
-			}
+				return FALSE;
 
-			if (CompressionLevel) /* RDP5 */
-			{
-				if (CopyOffset < 64)
-				{
-					/* bits 11111 + lower 6 bits of CopyOffset */
-					accumulator = 0x07C0 | (CopyOffset & 0x003F);
-					BitStream_Write_Bits(bs, accumulator, 11);
-				}
-				else if ((CopyOffset >= 64) && (CopyOffset < 320))
-				{
-					/* bits 11110 + lower 8 bits of (CopyOffset - 64) */
-					accumulator = 0x1E00 | ((CopyOffset - 64) & 0x00FF);
-					BitStream_Write_Bits(bs, accumulator, 13);
-				}
-				else if ((CopyOffset >= 320) && (CopyOffset < 2368))
-				{
-					/* bits 1110 + lower 11 bits of (CopyOffset - 320) */
-					accumulator = 0x7000 | ((CopyOffset - 320) & 0x07FF);
-					BitStream_Write_Bits(bs, accumulator, 15);
-				}
-				else
-				{
-					/* bits 110 + lower 16 bits of (CopyOffset - 2368) */
-					accumulator = 0x060000 | ((CopyOffset - 2368) & 0xFFFF);
-					BitStream_Write_Bits(bs, accumulator, 19);
-				}
-			}
-			else /* RDP4 */
-			{
-				if (CopyOffset < 64)
-				{
-					/* bits 1111 + lower 6 bits of CopyOffset */
-					accumulator = 0x03C0 | (CopyOffset & 0x003F);
-					BitStream_Write_Bits(bs, accumulator, 10);
-				}
-				else if ((CopyOffset >= 64) && (CopyOffset < 320))
-				{
-					/* bits 1110 + lower 8 bits of (CopyOffset - 64) */
-					accumulator = 0x0E00 | ((CopyOffset - 64) & 0x00FF);
-					BitStream_Write_Bits(bs, accumulator, 12);
-				}
-				else if ((CopyOffset >= 320) && (CopyOffset < 8192))
-				{
-					/* bits 110 + lower 13 bits of (CopyOffset - 320) */
-					accumulator = 0xC000 | ((CopyOffset - 320) & 0x1FFF);
-					BitStream_Write_Bits(bs, accumulator, 16);
-				}
-			}
-
-			/* Encode LengthOfMatch */
-
-			if (LengthOfMatch == 3)
-			{
-				/* 0 + 0 lower bits of LengthOfMatch */
-				BitStream_Write_Bits(bs, 0, 1);
-			}
-			else if ((LengthOfMatch >= 4) && (LengthOfMatch < 8))
-			{
-				/* 10 + 2 lower bits of LengthOfMatch */
-				accumulator = 0x0008 | (LengthOfMatch & 0x0003);
-				BitStream_Write_Bits(bs, accumulator, 4);
-			}
-			else if ((LengthOfMatch >= 8) && (LengthOfMatch < 16))
-			{
-				/* 110 + 3 lower bits of LengthOfMatch */
-				accumulator = 0x0030 | (LengthOfMatch & 0x0007);
-				BitStream_Write_Bits(bs, accumulator, 6);
-			}
-			else if ((LengthOfMatch >= 16) && (LengthOfMatch < 32))
-			{
-				/* 1110 + 4 lower bits of LengthOfMatch */
-				accumulator = 0x00E0 | (LengthOfMatch & 0x000F);
-				BitStream_Write_Bits(bs, accumulator, 8);
-			}
-			else if ((LengthOfMatch >= 32) && (LengthOfMatch < 64))
-			{
-				/* 11110 + 5 lower bits of LengthOfMatch */
-				accumulator = 0x03C0 | (LengthOfMatch & 0x001F);
-				BitStream_Write_Bits(bs, accumulator, 10);
-			}
-			else if ((LengthOfMatch >= 64) && (LengthOfMatch < 128))
-			{
-				/* 111110 + 6 lower bits of LengthOfMatch */
-				accumulator = 0x0F80 | (LengthOfMatch & 0x003F);
-				BitStream_Write_Bits(bs, accumulator, 12);
-			}
-			else if ((LengthOfMatch >= 128) && (LengthOfMatch < 256))
-			{
-				/* 1111110 + 7 lower bits of LengthOfMatch */
-				accumulator = 0x3F00 | (LengthOfMatch & 0x007F);
-				BitStream_Write_Bits(bs, accumulator, 14);
-			}
-			else if ((LengthOfMatch >= 256) && (LengthOfMatch < 512))
-			{
-				/* 11111110 + 8 lower bits of LengthOfMatch */
-				accumulator = 0xFE00 | (LengthOfMatch & 0x00FF);
-				BitStream_Write_Bits(bs, accumulator, 16);
-			}
-			else if ((LengthOfMatch >= 512) && (LengthOfMatch < 1024))
-			{
-				/* 111111110 + 9 lower bits of LengthOfMatch */
-				accumulator = 0x3FC00 | (LengthOfMatch & 0x01FF);
-				BitStream_Write_Bits(bs, accumulator, 18);
-			}
-			else if ((LengthOfMatch >= 1024) && (LengthOfMatch < 2048))
-			{
-				/* 1111111110 + 10 lower bits of LengthOfMatch */
-				accumulator = 0xFF800 | (LengthOfMatch & 0x03FF);
-				BitStream_Write_Bits(bs, accumulator, 20);
-			}
-			else if ((LengthOfMatch >= 2048) && (LengthOfMatch < 4096))
-			{
-				/* 11111111110 + 11 lower bits of LengthOfMatch */
-				accumulator = 0x3FF000 | (LengthOfMatch & 0x07FF);
-				BitStream_Write_Bits(bs, accumulator, 22);
-			}
-			else if ((LengthOfMatch >= 4096) && (LengthOfMatch < 8192))
-			{
-				/* 111111111110 + 12 lower bits of LengthOfMatch */
-				accumulator = 0xFFE000 | (LengthOfMatch & 0x0FFF);
-				BitStream_Write_Bits(bs, accumulator, 24);
-			}
-			else if (((LengthOfMatch >= 8192) && (LengthOfMatch < 16384)) &&
-			         CompressionLevel) /* RDP5 */
-			{
-				/* 1111111111110 + 13 lower bits of LengthOfMatch */
-				accumulator = 0x3FFC000 | (LengthOfMatch & 0x1FFF);
-				BitStream_Write_Bits(bs, accumulator, 26);
-			}
-			else if (((LengthOfMatch >= 16384) && (LengthOfMatch < 32768)) &&
-			         CompressionLevel) /* RDP5 */
-			{
-				/* 11111111111110 + 14 lower bits of LengthOfMatch */
-				accumulator = 0xFFF8000 | (LengthOfMatch & 0x3FFF);
-				BitStream_Write_Bits(bs, accumulator, 28);
-			}
-			else if (((LengthOfMatch >= 32768) && (LengthOfMatch < 65536)) &&
-			         CompressionLevel) /* RDP5 */
-			{
-				/* 111111111111110 + 15 lower bits of LengthOfMatch */
-				accumulator = 0x3FFF0000 | (LengthOfMatch & 0x7FFF);
-				BitStream_Write_Bits(bs, accumulator, 30);
-			}
+			mppc_write_match(bs, mppc->CompressionLevel, CopyOffset, LengthOfMatch);
 		}
 	}
 
@@ -707,33 +674,197 @@ int mppc_compress(MPPC_CONTEXT* mppc, BYTE* pSrcData, UINT32 SrcSize, BYTE** ppD
 	while (pSrcPtr <= pSrcEnd)
 	{
 		if (((bs->position / 8) + 2) > (DstSize - 1))
+			return FALSE;
+
+		mppc_write_literal(bs, *pSrcPtr);
+		*HistoryPtr++ = *pSrcPtr++;
+	}
+
+	*ppHistoryPtr = HistoryPtr;
+	return TRUE;
+}
+
+static INLINE void mppc_chain_insert(MPPC_CONTEXT* mppc, UINT32* pInserted, UINT32 upto,
+                                     UINT32 end)
+{
+	UINT32 pos;
+	const BYTE* HistoryBuffer = mppc->HistoryBuffer;
+
+	for (pos = *pInserted; (pos < upto) && (pos + 2 < end); pos++)
+	{
+		const UINT32 MatchIndex =
+		    MPPC_MATCH_INDEX(HistoryBuffer[pos], HistoryBuffer[pos + 1], HistoryBuffer[pos + 2]);
+		mppc->ChainBuffer[pos] = mppc->MatchBuffer[MatchIndex];
+		mppc->MatchBuffer[MatchIndex] = (UINT16)pos;
+	}
+
+	*pInserted = MAX(*pInserted, upto);
+}
+
+static INLINE UINT32 mppc_chain_find(MPPC_CONTEXT* mppc, UINT32 pos, UINT32 end, UINT32* pMatch)
+{
+	const BYTE* HistoryBuffer = mppc->HistoryBuffer;
+	const UINT32 MatchIndex =
+	    MPPC_MATCH_INDEX(HistoryBuffer[pos], HistoryBuffer[pos + 1], HistoryBuffer[pos + 2]);
+	/* RDP4 cannot encode matches of 8192 bytes or more */
+	const UINT32 maxLength = MIN(end - pos, mppc->CompressionLevel ? 65535 : 8191);
+	return bulk_match_find(HistoryBuffer, mppc->ChainBuffer, mppc->MatchBuffer[MatchIndex], pos,
+	                       maxLength, mppc->HistoryBufferSize - 1, &mppc->MatchParams, pMatch);
+}
+
+/**
+ * Hash chain match finder: MatchBuffer holds the most recent position of every hash and
+ * ChainBuffer links each position to the previous one with the same hash. The input is
+ * copied to the history first so matches can be measured against the whole input.
+ */
+
+static BOOL mppc_compress_chain(MPPC_CONTEXT* mppc, BYTE* pSrcData, UINT32 SrcSize,
+                                UINT32 DstSize, BYTE** ppHistoryPtr)
+{
+	UINT32 match = 0;
+	UINT32 literals = 0;
+	wBitStream* bs = mppc->bs;
+	BYTE* HistoryBuffer = mppc->HistoryBuffer;
+	UINT16* MatchBuffer = mppc->MatchBuffer;
+	UINT16* ChainBuffer = mppc->ChainBuffer;
+	/* a copy, the bit stream writes would otherwise force a reload after every byte */
+	const BULK_MATCH_PARAMS params = mppc->MatchParams;
+	const UINT32 maxDistance = mppc->HistoryBufferSize - 1;
+	UINT32 pos = (UINT32)(*ppHistoryPtr - HistoryBuffer);
+	UINT32 inserted = pos;
+	const UINT32 end = pos + SrcSize;
+	/* RDP4 cannot encode matches of 8192 bytes or more */
+	const UINT32 maxLength = mppc->CompressionLevel ? 65535 : 8191;
+	CopyMemory(&HistoryBuffer[pos], pSrcData, SrcSize);
+
+	while (pos < end)
+	{
+		UINT32 LengthOfMatch = 0;
+
+		/* long literal runs are searched at every BULK_MATCH_SKIP_STEP position only */
+		if (params.SkipAfter && (literals >= params.SkipAfter) &&
+		    (literals % BULK_MATCH_SKIP_STEP))
 		{
-			mppc_context_reset(mppc, TRUE);
-			*pFlags |= PACKET_FLUSHED;
-			*pFlags |= CompressionLevel;
-			*ppDstData = pSrcData;
-			*pDstSize = SrcSize;
-			return 1;
+			inserted = pos + 1;
 		}
+		else if (pos + 2 < end)
+		{
+			/* the position is hashed once, for the search and for the chain */
+			const UINT32 MatchIndex = MPPC_MATCH_INDEX(HistoryBuffer[pos], HistoryBuffer[pos + 1],
+			                                           HistoryBuffer[pos + 2]);
+			const UINT32 candidate = MatchBuffer[MatchIndex];
+
+			/* a single candidate is searched without following the chain */
+			if (params.Depth > 1)
+				ChainBuffer[pos] = (UINT16)candidate;
+
+			MatchBuffer[MatchIndex] = (UINT16)pos;
+			inserted = pos + 1;
+			LengthOfMatch =
+			    bulk_match_find(HistoryBuffer, ChainBuffer, candidate, pos,
+			                    MIN(end - pos, maxLength), maxDistance, &params, &match);
+
+			/* lazy matching: a longer match at the next position wins over this one */
+			if ((LengthOfMatch >= 3) && params.Lazy && (LengthOfMatch < params.NiceLength) &&
+			    (pos + 3 < end))
+			{
+				UINT32 next;
 
-		accumulator = *pSrcPtr;
-#ifdef DEBUG_MPPC
-		WLog_DBG(TAG, "%" PRIu32 "", accumulator);
-#endif
+				if (mppc_chain_find(mppc, pos + 1, end, &next) > LengthOfMatch)
+					LengthOfMatch = 0;
+			}
+		}
 
-		if (accumulator < 0x80)
+		if (LengthOfMatch < 3)
 		{
-			/* 8 bits of literal are encoded as-is */
-			BitStream_Write_Bits(bs, accumulator, 8);
+			if (((bs->position / 8) + 2) > (DstSize - 1))
+				return FALSE;
+
+			mppc_write_literal(bs, HistoryBuffer[pos]);
+			pos++;
+			literals++;
+			continue;
 		}
+
+		if (((bs->position / 8) + 7) > (DstSize - 1))
+			return FALSE;
+
+		mppc_write_match(bs, mppc->CompressionLevel, pos - match, LengthOfMatch);
+		pos += LengthOfMatch;
+		literals = 0;
+
+		/* the positions inside a long match are rarely the start of a better one */
+		if (params.MaxInsertLength && (LengthOfMatch > params.MaxInsertLength))
+			inserted = pos;
 		else
-		{
-			/* bits 10 followed by lower 7 bits of literal */
-			accumulator = 0x100 | (accumulator & 0x7F);
-			BitStream_Write_Bits(bs, accumulator, 9);
-		}
+			mppc_chain_insert(mppc, &inserted, pos, end);
+	}
 
-		*HistoryPtr++ = *pSrcPtr++;
+	*ppHistoryPtr = &HistoryBuffer[end];
+	return TRUE;
+}
+
+int mppc_compress(MPPC_CONTEXT* mppc, BYTE* pSrcData, UINT32 SrcSize, BYTE** ppDstData,
+                  UINT32* pDstSize, UINT32* pFlags)
+{
+	BOOL rc;
+	UINT32 DstSize;
+	BYTE* pDstData;
+	BOOL PacketFlushed;
+	BOOL PacketAtFront;
+	BYTE* HistoryBuffer;
+	BYTE* HistoryPtr;
+	UINT32 HistoryOffset;
+	UINT32 HistoryBufferSize;
+	UINT32 CompressionLevel;
+	wBitStream* bs = mppc->bs;
+	HistoryBuffer = mppc->HistoryBuffer;
+	HistoryBufferSize = mppc->HistoryBufferSize;
+	CompressionLevel = mppc->CompressionLevel;
+	HistoryOffset = mppc->HistoryOffset;
+	*pFlags = 0;
+	PacketFlushed = FALSE;
+
+	if (((HistoryOffset + SrcSize) < (HistoryBufferSize - 3)) && HistoryOffset)
+	{
+		PacketAtFront = FALSE;
+	}
+	else
+	{
+		if (HistoryOffset == (HistoryBufferSize + 1))
+			PacketFlushed = TRUE;
+
+		HistoryOffset = 0;
+		PacketAtFront = TRUE;
+	}
+
+	HistoryPtr = &(HistoryBuffer[HistoryOffset]);
+	pDstData = *ppDstData;
+
+	if (!pDstData)
+		return -1;
+
+	if (*pDstSize > SrcSize)
+		DstSize = SrcSize;
+	else
+		DstSize = *pDstSize;
+
+	BitStream_Attach(bs, pDstData, DstSize);
+
+	if (mppc->MatchParams.Depth > 0)
+		rc = mppc_compress_chain(mppc, pSrcData, SrcSize, DstSize, &HistoryPtr);
+	else
+		rc = mppc_compress_legacy(mppc, pSrcData, SrcSize, DstSize, &HistoryPtr);
+
+	if (!rc)
+	{
+		/* The output would not be smaller than the input, send the input as is */
+		mppc_context_reset(mppc, TRUE);
+		*pFlags |= PACKET_FLUSHED;
+		*pFlags |= CompressionLevel;
+		*ppDstData = pSrcData;
+		*pDstSize = SrcSize;
+		return 1;
 	}
 
 	BitStream_Flush(bs);
@@ -766,6 +897,16 @@ void mppc_set_compression_level(MPPC_CONTEXT* mppc, DWORD CompressionLevel)
 	}
 }
 
+BOOL mppc_set_match_level(MPPC_CONTEXT* mppc, UINT32 level)
+{
+	if (!mppc || !bulk_match_get_params(level, &mppc->MatchParams))
+		return FALSE;
+
+	/* the hash table layout differs between the legacy and the chained finder */
+	ZeroMemory(&(mppc->MatchBuffer), sizeof(mppc->MatchBuffer));
+	return TRUE;
+}
+
 void mppc_context_reset(MPPC_CONTEXT* mppc, BOOL flush)
 {
 	ZeroMemory(&(mppc->HistoryBuffer), sizeof(mppc->HistoryBuffer));
@@ -30,6 +30,8 @@
 #include <freerdp/log.h>
 #include <freerdp/codec/ncrush.h>
 
+#include "bulk_match.h"
+
 #define TAG FREERDP_TAG("codec")
 
 struct _NCRUSH_CONTEXT
@@ -46,6 +48,7 @@ struct _NCRUSH_CONTEXT
 	UINT16 MatchTable[65536];
 	BYTE HuffTableCopyOffset[1024];
 	BYTE HuffTableLOM[4096];
+	BULK_MATCH_PARAMS MatchParams;
 };
 
 static const UINT16 HuffTableLEC[8192] = {
@@ -2402,6 +2405,21 @@ static int ncrush_find_best_match(NCRUSH_CONTEXT* ncrush, UINT16 HistoryOffset,
 	return MatchLength;
 }
 
+/**
+ * MatchTable already links every position to the previous one with the same leading word,
+ * the chained finder walks it deeper than ncrush_find_best_match and measures every
+ * candidate over the whole input. The longest length encodable is 16385 (LOM index 28).
+ */
+static UINT32 ncrush_find_chain_match(NCRUSH_CONTEXT* ncrush, UINT32 HistoryOffset,
+                                      UINT32* pMatchOffset)
+{
+	const UINT32 EndOffset = (UINT32)(ncrush->HistoryPtr - ncrush->HistoryBuffer);
+	const UINT32 maxLength = MIN(EndOffset - HistoryOffset, 16385);
+	return bulk_match_find(ncrush->HistoryBuffer, ncrush->MatchTable,
+	                       ncrush->MatchTable[HistoryOffset], HistoryOffset, maxLength,
+	                       ncrush->HistoryBufferSize - 1, &ncrush->MatchParams, pMatchOffset);
+}
+
 static int ncrush_move_encoder_windows(NCRUSH_CONTEXT* ncrush, BYTE* HistoryPtr)
 {
 	int i, j;
@@ -2553,11 +2571,15 @@ int ncrush_compress(NCRUSH_CONTEXT* ncrush, BYTE* pSrcData, UINT32 SrcSize, BYTE
 			int rc;
 
 			MatchOffset = 0;
-			rc = ncrush_find_best_match(ncrush, HistoryOffset, &MatchOffset);
+
+			if (ncrush->MatchParams.Depth > 0)
+				rc = (int)ncrush_find_chain_match(ncrush, HistoryOffset, &MatchOffset);
+			else
+				rc = ncrush_find_best_match(ncrush, HistoryOffset, &MatchOffset);
 
 			if (rc < 0)
 				return -1005;
-			MatchLength = (UINT32)rc;
+			MatchLength = (rc < 2) ? 0 : (UINT32)rc;
 		}
 
 		if (MatchLength)
@@ -2566,6 +2588,17 @@ int ncrush_compress(NCRUSH_CONTEXT* ncrush, BYTE* pSrcData, UINT32 SrcSize, BYTE
 		if ((MatchLength == 2) && (CopyOffset >= 64))
 			MatchLength = 0;
 
+		/* lazy matching: a longer match at the next position wins over this one */
+		if (MatchLength && ncrush->MatchParams.Lazy &&
+		    (MatchLength < ncrush->MatchParams.NiceLength) && (SrcPtr + 1 < SrcEndPtr - 2) &&
+		    ncrush->MatchTable[HistoryOffset + 1])
+		{
+			UINT32 NextOffset;
+
+			if (ncrush_find_chain_match(ncrush, HistoryOffset + 1, &NextOffset) > MatchLength)
+				MatchLength = 0;
+		}
+
 		if (MatchLength == 0)
 		{
 			/* Literal */
@@ -2849,6 +2882,14 @@ static int ncrush_generate_tables(NCRUSH_CONTEXT* context)
 	return 1;
 }
 
+BOOL ncrush_set_match_level(NCRUSH_CONTEXT* ncrush, UINT32 level)
+{
+	if (!ncrush)
+		return FALSE;
+
+	return bulk_match_get_params(level, &ncrush->MatchParams);
+}
+
 void ncrush_context_reset(NCRUSH_CONTEXT* ncrush, BOOL flush)
 {
 	ZeroMemory(&(ncrush->HistoryBuffer), sizeof(ncrush->HistoryBuffer));
@@ -25,6 +25,8 @@
 
 #include <winpr/crt.h>
 #include <winpr/print.h>
+#include <winpr/pool.h>
+#include <winpr/sysinfo.h>
 
 #include <freerdp/primitives.h>
 #include <freerdp/log.h>
@@ -1477,6 +1479,267 @@ BYTE* freerdp_bitmap_compress_planar(BITMAP_PLANAR_CONTEXT* context, const BYTE*
 	return dstData;
 }
 
+struct _PLANAR_TILE_WORK_PARAM
+{
+	BITMAP_PLANAR_CONTEXT* planar;
+	BYTE* buffer;
+	UINT32 bufferSize;
+	const BYTE* data;
+	UINT32 format;
+	UINT32 scanline;
+	PLANAR_TILE* tiles;
+	UINT32 numTiles;
+	UINT32 first;
+	UINT32 step;
+	BOOL success;
+};
+typedef struct _PLANAR_TILE_WORK_PARAM PLANAR_TILE_WORK_PARAM;
+
+struct _BITMAP_PLANAR_WORKERS
+{
+	UINT32 count;
+	PTP_POOL ThreadPool;
+	TP_CALLBACK_ENVIRON ThreadPoolEnv;
+	PTP_WORK* workObjects;
+	PLANAR_TILE_WORK_PARAM* params;
+};
+
+static void planar_compress_tiles(PLANAR_TILE_WORK_PARAM* param)
+{
+	UINT32 x;
+	const UINT32 bpp = GetBytesPerPixel(param->format);
+	param->success = TRUE;
+
+	/* Tiles are dealt round robin so that every worker gets a similar share of a region */
+	for (x = param->first; x < param->numTiles; x += param->step)
+	{
+		PLANAR_TILE* tile = &param->tiles[x];
+		const BYTE* pSrcData = &param->data[tile->nYSrc * param->scanline + tile->nXSrc * bpp];
+		const UINT32 maxSize = tile->nWidth * tile->nHeight * 4 + 2;
+		BYTE* pDstData = (tile->DstSize >= maxSize) ? tile->pDstData : param->buffer;
+		UINT32 DstSize = 0;
+
+		if (!freerdp_bitmap_compress_planar(param->planar, pSrcData, param->format, tile->nWidth,
+		                                    tile->nHeight, param->scanline, pDstData, &DstSize) ||
+		    (DstSize > tile->DstSize))
+		{
+			tile->DstSize = 0;
+			param->success = FALSE;
+			continue;
+		}
+
+		if (pDstData != tile->pDstData)
+			CopyMemory(tile->pDstData, pDstData, DstSize);
+
+		tile->DstSize = DstSize;
+	}
+}
+
+static void CALLBACK planar_compress_tiles_work_callback(PTP_CALLBACK_INSTANCE instance,
+                                                         void* context, PTP_WORK work)
+{
+	WINPR_UNUSED(instance);
+	WINPR_UNUSED(work);
+	planar_compress_tiles((PLANAR_TILE_WORK_PARAM*)context);
+}
+
+static void planar_workers_free(BITMAP_PLANAR_WORKERS* workers)
+{
+	UINT32 x;
+
+	if (!workers)
+		return;
+
+	if (workers->ThreadPool)
+	{
+		CloseThreadpool(workers->ThreadPool);
+		DestroyThreadpoolEnvironment(&workers->ThreadPoolEnv);
+	}
+
+	if (workers->params)
+	{
+		for (x = 0; x < workers->count; x++)
+		{
+			freerdp_bitmap_planar_context_free(workers->params[x].planar);
+			free(workers->params[x].buffer);
+		}
+	}
+
+	free(workers->params);
+	free(workers->workObjects);
+	free(workers);
+}
+
+static BITMAP_PLANAR_WORKERS* planar_workers_new(void)
+{
+	SYSTEM_INFO sysinfo;
+	BITMAP_PLANAR_WORKERS* workers =
+	    (BITMAP_PLANAR_WORKERS*)calloc(1, sizeof(BITMAP_PLANAR_WORKERS));
+
+	if (!workers)
+		return NULL;
+
+	GetNativeSystemInfo(&sysinfo);
+	workers->count = MAX(1, sysinfo.dwNumberOfProcessors);
+	workers->params =
+	    (PLANAR_TILE_WORK_PARAM*)calloc(workers->count, sizeof(PLANAR_TILE_WORK_PARAM));
+	workers->workObjects = (PTP_WORK*)calloc(workers->count, sizeof(PTP_WORK));
+
+	if (!workers->params || !workers->workObjects)
+		goto fail;
+
+	if (workers->count > 1)
+	{
+		workers->ThreadPool = CreateThreadpool(NULL);
+
+		if (!workers->ThreadPool)
+			goto fail;
+
+		InitializeThreadpoolEnvironment(&workers->ThreadPoolEnv);
+		SetThreadpoolCallbackPool(&workers->ThreadPoolEnv, workers->ThreadPool);
+
+		if (!SetThreadpoolThreadMinimum(workers->ThreadPool, workers->count))
+			goto fail;
+	}
+
+	return workers;
+fail:
+	planar_workers_free(workers);
+	return NULL;
+}
+
+static BOOL setupWorkers(BITMAP_PLANAR_CONTEXT* context, UINT32 count, UINT32 maxWidth,
+                         UINT32 maxHeight)
+{
+	UINT32 x;
+	DWORD flags = context->ColorLossLevel;
+
+	if (!context->workers && !(context->workers = planar_workers_new()))
+		return FALSE;
+
+	if (context->AllowSkipAlpha)
+		flags |= PLANAR_FORMAT_HEADER_NA;
+
+	if (context->AllowRunLengthEncoding)
+		flags |= PLANAR_FORMAT_HEADER_RLE;
+
+	if (context->AllowColorSubsampling)
+		flags |= PLANAR_FORMAT_HEADER_CS;
+
+	/* Every worker compresses with a context of its own, the planes of this one are left alone */
+	for (x = 0; x < MIN(count, context->workers->count); x++)
+	{
+		PLANAR_TILE_WORK_PARAM* param = &context->workers->params[x];
+
+		if (!param->planar)
+		{
+			if (!(param->planar = freerdp_bitmap_planar_context_new(flags, maxWidth, maxHeight)))
+				return FALSE;
+		}
+		else if ((param->planar->maxWidth < maxWidth) || (param->planar->maxHeight < maxHeight))
+		{
+			if (!freerdp_bitmap_planar_context_reset(param->planar,
+			                                         MAX(param->planar->maxWidth, maxWidth),
+			                                         MAX(param->planar->maxHeight, maxHeight)))
+				return FALSE;
+		}
+
+		if (param->bufferSize < param->planar->maxPlaneSize * 4 + 2)
+		{
+			BYTE* buffer = (BYTE*)realloc(param->buffer, param->planar->maxPlaneSize * 4 + 2);
+
+			if (!buffer)
+				return FALSE;
+
+			param->buffer = buffer;
+			param->bufferSize = param->planar->maxPlaneSize * 4 + 2;
+		}
+
+		param->planar->bgr = context->bgr;
+	}
+
+	return TRUE;
+}
+
+BOOL freerdp_bitmap_planar_compress_tiles(BITMAP_PLANAR_CONTEXT* context, const BYTE* data,
+                                          UINT32 format, UINT32 scanline, PLANAR_TILE* tiles,
+                                          UINT32 numTiles)
+{
+	UINT32 x;
+	UINT32 numWorkers;
+	UINT32 maxWidth = 0;
+	UINT32 maxHeight = 0;
+	BOOL rc = TRUE;
+	BITMAP_PLANAR_WORKERS* workers;
+
+	if (!context || !data || (scanline == 0) || (!tiles && (numTiles > 0)))
+		return FALSE;
+
+	for (x = 0; x < numTiles; x++)
+	{
+		if (!tiles[x].pDstData || (tiles[x].nWidth == 0) || (tiles[x].nHeight == 0))
+			return FALSE;
+
+		maxWidth = MAX(maxWidth, tiles[x].nWidth);
+		maxHeight = MAX(maxHeight, tiles[x].nHeight);
+	}
+
+	if (numTiles == 0)
+		return TRUE;
+
+	if (!setupWorkers(context, numTiles, maxWidth, maxHeight))
+		return FALSE;
+
+	workers = context->workers;
+	numWorkers = MIN(workers->count, numTiles);
+
+	for (x = 0; x < numWorkers; x++)
+	{
+		PLANAR_TILE_WORK_PARAM* param = &workers->params[x];
+		param->data = data;
+		param->format = format;
+		param->scanline = scanline;
+		param->tiles = tiles;
+		param->numTiles = numTiles;
+		param->first = x;
+		param->step = numWorkers;
+	}
+
+	if (numWorkers == 1)
+	{
+		planar_compress_tiles(&workers->params[0]);
+		return workers->params[0].success;
+	}
+
+	for (x = 0; x < numWorkers; x++)
+	{
+		if (!(workers->workObjects[x] =
+		          CreateThreadpoolWork(planar_compress_tiles_work_callback,
+		                               (void*)&workers->params[x], &workers->ThreadPoolEnv)))
+		{
+			WLog_ERR(TAG, "CreateThreadpoolWork failed.");
+			planar_compress_tiles(&workers->params[x]);
+			continue;
+		}
+
+		SubmitThreadpoolWork(workers->workObjects[x]);
+	}
+
+	for (x = 0; x < numWorkers; x++)
+	{
+		if (workers->workObjects[x])
+		{
+			WaitForThreadpoolWorkCallbacks(workers->workObjects[x], FALSE);
+			CloseThreadpoolWork(workers->workObjects[x]);
+			workers->workObjects[x] = NULL;
+		}
+
+		rc &= workers->params[x].success;
+	}
+
+	return rc;
+}
+
 BOOL freerdp_bitmap_planar_context_reset(BITMAP_PLANAR_CONTEXT* context, UINT32 width,
                                          UINT32 height)
 {
@@ -1553,6 +1816,7 @@ void freerdp_bitmap_planar_context_free(BITMAP_PLANAR_CONTEXT* context)
 	free(context->planesBuffer);
 	free(context->deltaPlanesBuffer);
 	free(context->rlePlanesBuffer);
+	planar_workers_free(context->workers);
 	free(context);
 }
 
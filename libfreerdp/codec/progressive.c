@@ -37,6 +37,7 @@
 #include "rfx_differential.h"
 #include "rfx_quantization.h"
 #include "rfx_dwt.h"
+#include "rfx_encode.h"
 #include "rfx_rlgr.h"
 #include "rfx_types.h"
 #include "progressive.h"
@@ -2280,6 +2281,7 @@ INT32 progressive_decompress_ex(PROGRESSIVE_CONTEXT* progressive, const BYTE* pS
 	wStream *s, ss;
 	size_t start, end;
 	REGION16 clippingRects, updateRegion;
+	RECTANGLE_16* clippingRect;
 	PROGRESSIVE_BLOCK_REGION* region = &progressive->region;
 	PROGRESSIVE_SURFACE_CONTEXT* surface = progressive_get_surface_data(progressive, surfaceId);
 	union {
@@ -2392,18 +2394,32 @@ INT32 progressive_decompress_ex(PROGRESSIVE_CONTEXT* progressive, const BYTE* pS
 	}
 
 	region16_init(&clippingRects);
+	clippingRect = (RECTANGLE_16*)calloc(region->numRects + 1, sizeof(RECTANGLE_16));
+
+	if (!clippingRect)
+	{
+		rc = -1042;
+		goto fail;
+	}
 
 	for (i = 0; i < region->numRects; i++)
 	{
-		RECTANGLE_16 clippingRect;
 		const RFX_RECT* rect = &(region->rects[i]);
-		clippingRect.left = (UINT16)nXDst + rect->x;
-		clippingRect.top = (UINT16)nYDst + rect->y;
-		clippingRect.right = clippingRect.left + rect->width;
-		clippingRect.bottom = clippingRect.top + rect->height;
-		region16_union_rect(&clippingRects, &clippingRects, &clippingRect);
+		clippingRect[i].left = (UINT16)nXDst + rect->x;
+		clippingRect[i].top = (UINT16)nYDst + rect->y;
+		clippingRect[i].right = clippingRect[i].left + rect->width;
+		clippingRect[i].bottom = clippingRect[i].top + rect->height;
 	}
 
+	if (!region16_union_rects(&clippingRects, &clippingRects, clippingRect, region->numRects))
+	{
+		free(clippingRect);
+		rc = -1043;
+		goto fail;
+	}
+
+	free(clippingRect);
+
 	for (i = 0; i < surface->numUpdatedTiles; i++)
 	{
 		UINT32 nbUpdateRects, j;
@@ -2434,11 +2450,12 @@ INT32 progressive_decompress_ex(PROGRESSIVE_CONTEXT* progressive, const BYTE* pS
 				rc = -42;
 				break;
 			}
-
-			if (invalidRegion)
-				region16_union_rect(invalidRegion, invalidRegion, rect);
 		}
 
+		/* only the rectangles that were copied */
+		if (invalidRegion)
+			region16_union_rects(invalidRegion, invalidRegion, updateRects, j);
+
 		region16_uninit(&updateRegion);
 	}
 
@@ -2584,30 +2601,775 @@ static BOOL progressive_rfx_write_message_progressive_simple(RFX_CONTEXT* contex
 	return TRUE;
 }
 
-int progressive_compress(PROGRESSIVE_CONTEXT* progressive, const BYTE* pSrcData, UINT32 SrcSize,
-                         BYTE** ppDstData, UINT32* pDstSize)
+/*
+ * Progressive encoder
+ *
+ * The encoder keeps its per tile state in the same PROGRESSIVE_SURFACE_CONTEXT the decoder
+ * uses. For every tile RFX_PROGRESSIVE_TILE::current holds the full precision coefficients
+ * (reduce-extrapolate DWT layout), RFX_PROGRESSIVE_TILE::sign the coefficient values already
+ * known to the decoder and RFX_PROGRESSIVE_TILE::quality the last quality sent.
+ *
+ * Tiles intersecting the invalid region are sent as RFX_PROGRESSIVE_TILE_FIRST with the
+ * coarsest quality, every other tile not yet at full quality is refined by one
+ * RFX_PROGRESSIVE_TILE_UPGRADE pass per call.
+ */
+
+static const RFX_COMPONENT_CODEC_QUANT progressive_encode_quant = { 6, 6, 6, 6, 7, 7, 8, 8, 8, 9 };
+
+static const RFX_PROGRESSIVE_CODEC_QUANT progressive_encode_quant_prog[] = {
+	{ 25,
+	  { 2, 3, 3, 3, 4, 4, 4, 5, 5, 5 },
+	  { 3, 4, 4, 4, 5, 5, 5, 6, 6, 6 },
+	  { 3, 4, 4, 4, 5, 5, 5, 6, 6, 6 } },
+	{ 50,
+	  { 1, 2, 2, 2, 3, 3, 3, 3, 3, 3 },
+	  { 2, 3, 3, 3, 3, 3, 3, 4, 4, 4 },
+	  { 2, 3, 3, 3, 3, 3, 3, 4, 4, 4 } },
+	{ 75,
+	  { 0, 1, 1, 1, 1, 1, 1, 2, 2, 2 },
+	  { 1, 1, 1, 1, 2, 2, 2, 2, 2, 2 },
+	  { 1, 1, 1, 1, 2, 2, 2, 2, 2, 2 } }
+};
+
+static INLINE const RFX_PROGRESSIVE_CODEC_QUANT*
+progressive_encode_get_quant_prog(const PROGRESSIVE_CONTEXT* progressive, BYTE quality)
 {
-	return -1;
+	if (quality >= ARRAYSIZE(progressive_encode_quant_prog))
+		return &progressive->quantProgValFull;
+
+	return &progressive_encode_quant_prog[quality];
 }
 
-int progressive_compress_ex(PROGRESSIVE_CONTEXT* progressive, const BYTE* pSrcData, UINT32 SrcSize,
-                            UINT32 SrcFormat, UINT32 Width, UINT32 Height, UINT32 ScanLine,
-                            const REGION16* invalidRegion, BYTE** ppDstData, UINT32* pDstSize)
+static INLINE void progressive_rfx_quant_write(wStream* s, const RFX_COMPONENT_CODEC_QUANT* q)
 {
-	BOOL rc;
-	int res = -6;
-	wStream* s;
-	UINT32 i, numRects;
-	UINT32 x, y;
-	RFX_RECT* rects = NULL;
-	RFX_MESSAGE* message;
+	Stream_Write_UINT8(s, q->LL3 + (q->HL3 << 4)); /* LL3 (4-bit), HL3 (4-bit) */
+	Stream_Write_UINT8(s, q->LH3 + (q->HH3 << 4)); /* LH3 (4-bit), HH3 (4-bit) */
+	Stream_Write_UINT8(s, q->HL2 + (q->LH2 << 4)); /* HL2 (4-bit), LH2 (4-bit) */
+	Stream_Write_UINT8(s, q->HH2 + (q->HL1 << 4)); /* HH2 (4-bit), HL1 (4-bit) */
+	Stream_Write_UINT8(s, q->LH1 + (q->HH1 << 4)); /* LH1 (4-bit), HH1 (4-bit) */
+}
 
-	if (!progressive || !pSrcData || !ppDstData || !pDstSize)
+/* forward lifting step, the exact counterpart of progressive_rfx_idwt_x/progressive_rfx_idwt_y */
+static INLINE void progressive_rfx_dwt_1d_encode(const INT16* pX, size_t nXStep, INT16* pL,
+                                                 size_t nLStep, INT16* pH, size_t nHStep,
+                                                 size_t nLowCount, size_t nHighCount)
+{
+	size_t k;
+	INT32 H0, H1;
+
+	for (k = 0; k < nHighCount; k++)
+	{
+		const INT32 X0 = pX[(2 * k) * nXStep];
+		const INT32 X1 = pX[(2 * k + 1) * nXStep];
+		const INT32 X2 = pX[(2 * k + 2) * nXStep];
+		pH[k * nHStep] = (INT16)((X1 - ((X0 + X2) / 2)) / 2);
+	}
+
+	H0 = pH[0];
+	pL[0] = (INT16)(pX[0] + H0);
+
+	for (k = 1; k < nHighCount; k++)
+	{
+		H1 = pH[k * nHStep];
+		pL[k * nLStep] = (INT16)(pX[(2 * k) * nXStep] + ((H0 + H1) / 2));
+		H0 = H1;
+	}
+
+	if (nLowCount > (nHighCount + 1))
+	{
+		/* even length, the two trailing low band coefficients are extrapolated */
+		const INT32 X0 = pX[(2 * nHighCount) * nXStep];
+		const INT32 X1 = pX[(2 * nHighCount + 1) * nXStep];
+		pL[nHighCount * nLStep] = (INT16)(X0 + (H0 / 2));
+		pL[(nHighCount + 1) * nLStep] = (INT16)((2 * X1) - X0);
+	}
+	else
+	{
+		pL[nHighCount * nLStep] = (INT16)(pX[(2 * nHighCount) * nXStep] + H0);
+	}
+}
+
+static INLINE void progressive_rfx_dwt_2d_encode_block(const INT16* src, size_t nSrcStep,
+                                                       INT16* buffer, INT16* temp, size_t level)
+{
+	size_t i;
+	INT16 *HL, *LH;
+	INT16 *HH, *LL;
+	INT16 *L, *H;
+
+	const size_t nBandL = progressive_rfx_get_band_l_count(level);
+	const size_t nBandH = progressive_rfx_get_band_h_count(level);
+	const size_t nStep = nBandL + nBandH;
+	size_t offset = 0;
+
+	HL = &buffer[offset];
+	offset += (nBandH * nBandL);
+	LH = &buffer[offset];
+	offset += (nBandL * nBandH);
+	HH = &buffer[offset];
+	offset += (nBandH * nBandH);
+	LL = &buffer[offset];
+	L = &temp[0];
+	H = &temp[nBandL * nStep];
+
+	/* vertical (src -> L + H), src may overlap the destination bands */
+	for (i = 0; i < nStep; i++)
+		progressive_rfx_dwt_1d_encode(&src[i], nSrcStep, &L[i], nStep, &H[i], nStep, nBandL,
+		                              nBandH);
+
+	/* horizontal (L -> LL + HL) */
+	for (i = 0; i < nBandL; i++)
+		progressive_rfx_dwt_1d_encode(&L[i * nStep], 1, &LL[i * nBandL], 1, &HL[i * nBandH], 1,
+		                              nBandL, nBandH);
+
+	/* horizontal (H -> LH + HH) */
+	for (i = 0; i < nBandH; i++)
+		progressive_rfx_dwt_1d_encode(&H[i * nStep], 1, &LH[i * nBandL], 1, &HH[i * nBandH], 1,
+		                              nBandL, nBandH);
+}
+
+static INLINE int progressive_rfx_dwt_2d_encode(PROGRESSIVE_CONTEXT* progressive, INT16* buffer)
+{
+	INT16* temp = (INT16*)BufferPool_Take(progressive->bufferPool, -1); /* DWT buffer */
+
+	if (!temp)
+		return -2;
+
+	progressive_rfx_dwt_2d_encode_block(&buffer[0], 64, &buffer[0], temp, 1);
+	progressive_rfx_dwt_2d_encode_block(&buffer[3007], 33, &buffer[3007], temp, 2);
+	progressive_rfx_dwt_2d_encode_block(&buffer[3807], 17, &buffer[3807], temp, 3);
+	BufferPool_Return(progressive->bufferPool, temp);
+	return 1;
+}
+
+/**
+ * Add half a quantization step of the final pass so that truncating the
+ * coefficients during the passes rounds the full quality result.
+ */
+static INLINE void progressive_rfx_encode_bias_block(INT16* buffer, UINT32 length, UINT32 shift,
+                                                     BOOL nonLL)
+{
+	UINT32 index;
+	const INT32 half = 1 << (shift - 1);
+
+	for (index = 0; index < length; index++)
+	{
+		INT32 val = buffer[index];
+
+		if (!nonLL || (val > 0))
+			val += half;
+		else if (val < 0)
+			val -= half;
+
+		buffer[index] = (INT16)MAX(INT16_MIN, MIN(INT16_MAX, val));
+	}
+}
+
+static INLINE void progressive_rfx_encode_bias(INT16* buffer,
+                                               const RFX_COMPONENT_CODEC_QUANT* shift)
+{
+	progressive_rfx_encode_bias_block(&buffer[0], 1023, shift->HL1, TRUE);    /* HL1 */
+	progressive_rfx_encode_bias_block(&buffer[1023], 1023, shift->LH1, TRUE); /* LH1 */
+	progressive_rfx_encode_bias_block(&buffer[2046], 961, shift->HH1, TRUE);  /* HH1 */
+	progressive_rfx_encode_bias_block(&buffer[3007], 272, shift->HL2, TRUE);  /* HL2 */
+	progressive_rfx_encode_bias_block(&buffer[3279], 272, shift->LH2, TRUE);  /* LH2 */
+	progressive_rfx_encode_bias_block(&buffer[3551], 256, shift->HH2, TRUE);  /* HH2 */
+	progressive_rfx_encode_bias_block(&buffer[3807], 72, shift->HL3, TRUE);   /* HL3 */
+	progressive_rfx_encode_bias_block(&buffer[3879], 72, shift->LH3, TRUE);   /* LH3 */
+	progressive_rfx_encode_bias_block(&buffer[3951], 64, shift->HH3, TRUE);   /* HH3 */
+	progressive_rfx_encode_bias_block(&buffer[4015], 81, shift->LL3, FALSE);  /* LL3 */
+}
+
+/**
+ * Non LL bands are truncated in sign/magnitude representation (upgrades refine the magnitude),
+ * LL3 is truncated in two's complement (upgrades add unsigned raw bits).
+ */
+static INLINE void progressive_rfx_encode_quantize_block(const INT16* coeffs, INT16* buffer,
+                                                         UINT32 length, UINT32 shift, BOOL nonLL)
+{
+	UINT32 index;
+
+	for (index = 0; index < length; index++)
 	{
+		const INT32 val = coeffs[index];
+
+		if (nonLL && (val < 0))
+			buffer[index] = (INT16)(-((-val) >> shift));
+		else
+			buffer[index] = (INT16)(val >> shift);
+	}
+}
+
+static INLINE int progressive_rfx_encode_component(PROGRESSIVE_CONTEXT* progressive,
+                                                   const RFX_COMPONENT_CODEC_QUANT* shift,
+                                                   const INT16* current, INT16* sign, wStream* s,
+                                                   UINT16* length)
+{
+	int rc;
+	INT16* buffer;
+	const size_t maxLen = 8192;
+
+	if (!Stream_EnsureRemainingCapacity(s, maxLen))
 		return -1;
+
+	buffer = (INT16*)BufferPool_Take(progressive->bufferPool, -1);
+	if (!buffer)
+		return -1;
+
+	progressive_rfx_encode_quantize_block(&current[0], &buffer[0], 1023, shift->HL1,
+	                                      TRUE); /* HL1 */
+	progressive_rfx_encode_quantize_block(&current[1023], &buffer[1023], 1023, shift->LH1,
+	                                      TRUE); /* LH1 */
+	progressive_rfx_encode_quantize_block(&current[2046], &buffer[2046], 961, shift->HH1,
+	                                      TRUE); /* HH1 */
+	progressive_rfx_encode_quantize_block(&current[3007], &buffer[3007], 272, shift->HL2,
+	                                      TRUE); /* HL2 */
+	progressive_rfx_encode_quantize_block(&current[3279], &buffer[3279], 272, shift->LH2,
+	                                      TRUE); /* LH2 */
+	progressive_rfx_encode_quantize_block(&current[3551], &buffer[3551], 256, shift->HH2,
+	                                      TRUE); /* HH2 */
+	progressive_rfx_encode_quantize_block(&current[3807], &buffer[3807], 72, shift->HL3,
+	                                      TRUE); /* HL3 */
+	progressive_rfx_encode_quantize_block(&current[3879], &buffer[3879], 72, shift->LH3,
+	                                      TRUE); /* LH3 */
+	progressive_rfx_encode_quantize_block(&current[3951], &buffer[3951], 64, shift->HH3,
+	                                      TRUE); /* HH3 */
+	progressive_rfx_encode_quantize_block(&current[4015], &buffer[4015], 81, shift->LL3,
+	                                      FALSE); /* LL3 */
+
+	CopyMemory(sign, buffer, 4096 * 2);
+	rfx_differential_encode(&buffer[4015], 81); /* LL3 */
+
+	/* The RLGR encoder expects the destination to be initialized to zero */
+	ZeroMemory(Stream_Pointer(s), maxLen);
+	rc = progressive->rfx_context->rlgr_encode(RLGR1, buffer, 4096, Stream_Pointer(s), maxLen);
+	BufferPool_Return(progressive->bufferPool, buffer);
+
+	if ((rc < 0) || (rc > UINT16_MAX))
+		return -1;
+
+	Stream_Seek(s, (size_t)rc);
+	*length = (UINT16)rc;
+	return 1;
+}
+
+static BOOL progressive_rfx_write_tile_first(PROGRESSIVE_CONTEXT* progressive, wStream* s,
+                                             RFX_PROGRESSIVE_TILE* tile, const BYTE* pSrcData,
+                                             UINT32 SrcFormat, UINT32 nSrcStep, UINT32 width,
+                                             UINT32 height)
+{
+	int rc;
+	size_t start, end;
+	UINT16 yLen = 0, cbLen = 0, crLen = 0;
+	INT16* pSign[3];
+	INT16* pCurrent[3];
+	RFX_COMPONENT_CODEC_QUANT shiftY = { 0 };
+	RFX_COMPONENT_CODEC_QUANT shiftCb = { 0 };
+	RFX_COMPONENT_CODEC_QUANT shiftCr = { 0 };
+	const RFX_PROGRESSIVE_CODEC_QUANT* quantProg = progressive_encode_get_quant_prog(progressive, 0);
+	static const prim_size_t roi_64x64 = { 64, 64 };
+	const primitives_t* prims = primitives_get();
+
+	tile->quality = 0;
+	tile->pass = 1;
+	tile->flags = 0;
+	tile->yQuant = progressive_encode_quant;
+	tile->cbQuant = progressive_encode_quant;
+	tile->crQuant = progressive_encode_quant;
+	tile->yProgQuant = quantProg->yQuantValues;
+	tile->cbProgQuant = quantProg->cbQuantValues;
+	tile->crProgQuant = quantProg->crQuantValues;
+	progressive_rfx_quant_add(&tile->yQuant, &tile->yProgQuant, &tile->yBitPos);
+	progressive_rfx_quant_add(&tile->cbQuant, &tile->cbProgQuant, &tile->cbBitPos);
+	progressive_rfx_quant_add(&tile->crQuant, &tile->crProgQuant, &tile->crBitPos);
+
+	pSign[0] = (INT16*)((BYTE*)(&tile->sign[((8192 + 32) * 0) + 16])); /* Y/R buffer */
+	pSign[1] = (INT16*)((BYTE*)(&tile->sign[((8192 + 32) * 1) + 16])); /* Cb/G buffer */
+	pSign[2] = (INT16*)((BYTE*)(&tile->sign[((8192 + 32) * 2) + 16])); /* Cr/B buffer */
+
+	pCurrent[0] = (INT16*)((BYTE*)(&tile->current[((8192 + 32) * 0) + 16])); /* Y/R buffer */
+	pCurrent[1] = (INT16*)((BYTE*)(&tile->current[((8192 + 32) * 1) + 16])); /* Cb/G buffer */
+	pCurrent[2] = (INT16*)((BYTE*)(&tile->current[((8192 + 32) * 2) + 16])); /* Cr/B buffer */
+
+	rfx_encode_format_rgb(pSrcData, (int)width, (int)height, (int)nSrcStep, SrcFormat, NULL,
+	                      pCurrent[0], pCurrent[1], pCurrent[2]);
+	prims->RGBToYCbCr_16s16s_P3P3((const INT16**)pCurrent, 64 * sizeof(INT16), pCurrent,
+	                              64 * sizeof(INT16), &roi_64x64);
+
+	/* The final pass uses the plain quantization values, bias the coefficients for it */
+	shiftY = tile->yQuant;
+	progressive_rfx_quant_lsub(&shiftY, 1); /* -6 + 5 = -1 */
+	shiftCb = tile->cbQuant;
+	progressive_rfx_quant_lsub(&shiftCb, 1); /* -6 + 5 = -1 */
+	shiftCr = tile->crQuant;
+	progressive_rfx_quant_lsub(&shiftCr, 1); /* -6 + 5 = -1 */
+
+	if ((progressive_rfx_dwt_2d_encode(progressive, pCurrent[0]) < 0) ||
+	    (progressive_rfx_dwt_2d_encode(progressive, pCurrent[1]) < 0) ||
+	    (progressive_rfx_dwt_2d_encode(progressive, pCurrent[2]) < 0))
+		return FALSE;
+
+	progressive_rfx_encode_bias(pCurrent[0], &shiftY);
+	progressive_rfx_encode_bias(pCurrent[1], &shiftCb);
+	progressive_rfx_encode_bias(pCurrent[2], &shiftCr);
+
+	/* The first pass is quantized with the progressive quantization added */
+	progressive_rfx_quant_add(&tile->yQuant, &tile->yProgQuant, &shiftY);
+	progressive_rfx_quant_lsub(&shiftY, 1); /* -6 + 5 = -1 */
+	progressive_rfx_quant_add(&tile->cbQuant, &tile->cbProgQuant, &shiftCb);
+	progressive_rfx_quant_lsub(&shiftCb, 1); /* -6 + 5 = -1 */
+	progressive_rfx_quant_add(&tile->crQuant, &tile->crProgQuant, &shiftCr);
+	progressive_rfx_quant_lsub(&shiftCr, 1); /* -6 + 5 = -1 */
+
+	start = Stream_GetPosition(s);
+	if (!Stream_EnsureRemainingCapacity(s, 23))
+		return FALSE;
+	Stream_Seek(s, 23);
+
+	rc = progressive_rfx_encode_component(progressive, &shiftY, pCurrent[0], pSign[0], s, &yLen);
+	if (rc < 0)
+		return FALSE;
+	rc = progressive_rfx_encode_component(progressive, &shiftCb, pCurrent[1], pSign[1], s,
+	                                      &cbLen);
+	if (rc < 0)
+		return FALSE;
+	rc = progressive_rfx_encode_component(progressive, &shiftCr, pCurrent[2], pSign[2], s,
+	                                      &crLen);
+	if (rc < 0)
+		return FALSE;
+
+	/* RFX_PROGRESSIVE_TILE_FIRST */
+	end = Stream_GetPosition(s);
+	Stream_SetPosition(s, start);
+	Stream_Write_UINT16(s, PROGRESSIVE_WBT_TILE_FIRST); /* blockType (2 bytes) */
+	Stream_Write_UINT32(s, (UINT32)(end - start));      /* blockLen (4 bytes) */
+	Stream_Write_UINT8(s, 0);                           /* quantIdxY (1 byte) */
+	Stream_Write_UINT8(s, 0);                           /* quantIdxCb (1 byte) */
+	Stream_Write_UINT8(s, 0);                           /* quantIdxCr (1 byte) */
+	Stream_Write_UINT16(s, tile->xIdx);                 /* xIdx (2 bytes) */
+	Stream_Write_UINT16(s, tile->yIdx);                 /* yIdx (2 bytes) */
+	Stream_Write_UINT8(s, tile->flags);                 /* flags (1 byte) */
+	Stream_Write_UINT8(s, tile->quality);               /* quality (1 byte) */
+	Stream_Write_UINT16(s, yLen);                       /* yLen (2 bytes) */
+	Stream_Write_UINT16(s, cbLen);                      /* cbLen (2 bytes) */
+	Stream_Write_UINT16(s, crLen);                      /* crLen (2 bytes) */
+	Stream_Write_UINT16(s, 0);                          /* tailLen (2 bytes) */
+	Stream_SetPosition(s, end);
+	return TRUE;
+}
+
+struct _RFX_PROGRESSIVE_UPGRADE_ENCODE_STATE
+{
+	BOOL nonLL;
+	wBitStream* srl;
+	wBitStream* raw;
+
+	/* SRL symbols, run length coded once the component is complete */
+	INT16* srlValues;
+	BYTE* srlBits;
+	UINT32 srlCount;
+};
+typedef struct _RFX_PROGRESSIVE_UPGRADE_ENCODE_STATE RFX_PROGRESSIVE_UPGRADE_ENCODE_STATE;
+
+static INLINE void progressive_rfx_write_zero_bits(wBitStream* bs, UINT32 count)
+{
+	while (count > 0)
+	{
+		const UINT32 nbits = MIN(count, 16);
+		BitStream_Write_Bits(bs, 0, nbits);
+		count -= nbits;
+	}
+}
+
+/* the exact counterpart of progressive_rfx_srl_read */
+static INLINE void progressive_rfx_srl_write(RFX_PROGRESSIVE_UPGRADE_ENCODE_STATE* state)
+{
+	UINT32 kp = 8;
+	UINT32 index = 0;
+	wBitStream* bs = state->srl;
+
+	while (index < state->srlCount)
+	{
+		INT16 input;
+		UINT32 mag;
+		UINT32 numBits;
+		UINT32 run = 0;
+		const UINT32 k = kp / 8;
+
+		while (((index + run) < state->srlCount) && (state->srlValues[index + run] == 0) &&
+		       (run < (1u << k)))
+			run++;
+
+		if ((run == (1u << k)) || ((index + run) == state->srlCount))
+		{
+			/* '0' bit, a run of (1 << k) zeros (also used to terminate the stream) */
+			BitStream_Write_Bits(bs, 0, 1);
+			index += run;
+			kp += 4;
+
+			if (kp > 80)
+				kp = 80;
+
+			continue;
+		}
+
+		/* '1' bit, nz < (1 << k), nz = next k bits */
+		BitStream_Write_Bits(bs, 1, 1);
+
+		if (k)
+			BitStream_Write_Bits(bs, run, k);
+
+		index += run;
+		input = state->srlValues[index];
+		numBits = state->srlBits[index];
+		index++;
+
+		/* unary encoding */
+		BitStream_Write_Bits(bs, (input < 0) ? 1 : 0, 1);
+
+		if (kp < 6)
+			kp = 0;
+		else
+			kp -= 6;
+
+		if (numBits == 1)
+			continue;
+
+		mag = (UINT32)((input < 0) ? -input : input);
+		progressive_rfx_write_zero_bits(bs, mag - 1);
+
+		if (mag < ((1u << numBits) - 1))
+			BitStream_Write_Bits(bs, 1, 1);
 	}
+}
+
+static INLINE void progressive_rfx_upgrade_encode_block(RFX_PROGRESSIVE_UPGRADE_ENCODE_STATE* state,
+                                                        const INT16* current, INT16* sign,
+                                                        UINT32 length, UINT32 shift,
+                                                        UINT32 numBits)
+{
+	UINT32 index;
+	const UINT32 mask = (1u << numBits) - 1;
 
-	if (ScanLine == 0)
+	if (!numBits)
+		return;
+
+	if (!state->nonLL)
+	{
+		for (index = 0; index < length; index++)
+		{
+			const UINT32 bits = ((UINT32)(current[index] >> shift)) & mask;
+			BitStream_Write_Bits(state->raw, bits, numBits);
+		}
+
+		return;
+	}
+
+	for (index = 0; index < length; index++)
+	{
+		const INT32 val = current[index];
+		const UINT32 mag = ((UINT32)((val < 0) ? -val : val) >> shift) & mask;
+
+		if (sign[index] != 0)
+		{
+			/* sign already known, magnitude bits go to raw */
+			BitStream_Write_Bits(state->raw, mag, numBits);
+		}
+		else
+		{
+			/* sign == 0, value goes to srl */
+			const INT16 input = (INT16)((val < 0) ? -((INT32)mag) : (INT32)mag);
+			state->srlValues[state->srlCount] = input;
+			state->srlBits[state->srlCount] = (BYTE)numBits;
+			state->srlCount++;
+			sign[index] = input;
+		}
+	}
+}
+
+static INLINE int progressive_rfx_upgrade_encode_component(
+    PROGRESSIVE_CONTEXT* progressive, const RFX_COMPONENT_CODEC_QUANT* shift,
+    const RFX_COMPONENT_CODEC_QUANT* numBits, const INT16* current, INT16* sign, wStream* s,
+    UINT16* srlLen, UINT16* rawLen)
+{
+	int rc = -1;
+	size_t srlSize, rawSize;
+	wBitStream s_srl = { 0 };
+	wBitStream s_raw = { 0 };
+	RFX_PROGRESSIVE_UPGRADE_ENCODE_STATE state = { 0 };
+	const UINT32 capacity = (8192 + 32) * 3;
+	BYTE* pSrl = BufferPool_Take(progressive->bufferPool, -1);
+	BYTE* pRaw = BufferPool_Take(progressive->bufferPool, -1);
+	BYTE* pSymbols = BufferPool_Take(progressive->bufferPool, -1);
+
+	if (!pSrl || !pRaw || !pSymbols)
+		goto fail;
+
+	state.srl = &s_srl;
+	state.raw = &s_raw;
+	state.srlValues = (INT16*)pSymbols;
+	state.srlBits = &pSymbols[4096 * 2];
+	BitStream_Attach(state.srl, pSrl, capacity);
+	BitStream_Attach(state.raw, pRaw, capacity);
+
+	state.nonLL = TRUE;
+	progressive_rfx_upgrade_encode_block(&state, &current[0], &sign[0], 1023, shift->HL1,
+	                                     numBits->HL1); /* HL1 */
+	progressive_rfx_upgrade_encode_block(&state, &current[1023], &sign[1023], 1023, shift->LH1,
+	                                     numBits->LH1); /* LH1 */
+	progressive_rfx_upgrade_encode_block(&state, &current[2046], &sign[2046], 961, shift->HH1,
+	                                     numBits->HH1); /* HH1 */
+	progressive_rfx_upgrade_encode_block(&state, &current[3007], &sign[3007], 272, shift->HL2,
+	                                     numBits->HL2); /* HL2 */
+	progressive_rfx_upgrade_encode_block(&state, &current[3279], &sign[3279], 272, shift->LH2,
+	                                     numBits->LH2); /* LH2 */
+	progressive_rfx_upgrade_encode_block(&state, &current[3551], &sign[3551], 256, shift->HH2,
+	                                     numBits->HH2); /* HH2 */
+	progressive_rfx_upgrade_encode_block(&state, &current[3807], &sign[3807], 72, shift->HL3,
+	                                     numBits->HL3); /* HL3 */
+	progressive_rfx_upgrade_encode_block(&state, &current[3879], &sign[3879], 72, shift->LH3,
+	                                     numBits->LH3); /* LH3 */
+	progressive_rfx_upgrade_encode_block(&state, &current[3951], &sign[3951], 64, shift->HH3,
+	                                     numBits->HH3); /* HH3 */
+
+	state.nonLL = FALSE;
+	progressive_rfx_upgrade_encode_block(&state, &current[4015], &sign[4015], 81, shift->LL3,
+	                                     numBits->LL3); /* LL3 */
+
+	progressive_rfx_srl_write(&state);
+	BitStream_Flush(state.srl);
+	BitStream_Flush(state.raw);
+
+	srlSize = (state.srl->position + 7) / 8;
+	rawSize = (state.raw->position + 7) / 8;
+
+	if ((srlSize > capacity) || (rawSize > capacity))
+		goto fail;
+
+	if (!Stream_EnsureRemainingCapacity(s, srlSize + rawSize))
+		goto fail;
+
+	Stream_Write(s, pSrl, srlSize);
+	Stream_Write(s, pRaw, rawSize);
+	*srlLen = (UINT16)srlSize;
+	*rawLen = (UINT16)rawSize;
+	rc = 1;
+fail:
+	BufferPool_Return(progressive->bufferPool, pSrl);
+	BufferPool_Return(progressive->bufferPool, pRaw);
+	BufferPool_Return(progressive->bufferPool, pSymbols);
+	return rc;
+}
+
+static BOOL progressive_rfx_write_tile_upgrade(PROGRESSIVE_CONTEXT* progressive, wStream* s,
+                                               RFX_PROGRESSIVE_TILE* tile)
+{
+	int rc;
+	size_t start, end;
+	BYTE quality;
+	UINT16 ySrlLen = 0, yRawLen = 0;
+	UINT16 cbSrlLen = 0, cbRawLen = 0;
+	UINT16 crSrlLen = 0, crRawLen = 0;
+	INT16* pSign[3];
+	INT16* pCurrent[3];
+	RFX_COMPONENT_CODEC_QUANT shiftY = { 0 };
+	RFX_COMPONENT_CODEC_QUANT shiftCb = { 0 };
+	RFX_COMPONENT_CODEC_QUANT shiftCr = { 0 };
+	RFX_COMPONENT_CODEC_QUANT yBitPos = { 0 };
+	RFX_COMPONENT_CODEC_QUANT cbBitPos = { 0 };
+	RFX_COMPONENT_CODEC_QUANT crBitPos = { 0 };
+	RFX_COMPONENT_CODEC_QUANT yNumBits = { 0 };
+	RFX_COMPONENT_CODEC_QUANT cbNumBits = { 0 };
+	RFX_COMPONENT_CODEC_QUANT crNumBits = { 0 };
+	const RFX_PROGRESSIVE_CODEC_QUANT* quantProg;
+
+	quality = tile->quality + 1;
+	if (quality >= ARRAYSIZE(progressive_encode_quant_prog))
+		quality = 0xFF;
+
+	quantProg = progressive_encode_get_quant_prog(progressive, quality);
+
+	progressive_rfx_quant_add(&tile->yQuant, &quantProg->yQuantValues, &yBitPos);
+	progressive_rfx_quant_add(&tile->cbQuant, &quantProg->cbQuantValues, &cbBitPos);
+	progressive_rfx_quant_add(&tile->crQuant, &quantProg->crQuantValues, &crBitPos);
+	progressive_rfx_quant_sub(&tile->yBitPos, &yBitPos, &yNumBits);
+	progressive_rfx_quant_sub(&tile->cbBitPos, &cbBitPos, &cbNumBits);
+	progressive_rfx_quant_sub(&tile->crBitPos, &crBitPos, &crNumBits);
+	shiftY = yBitPos;
+	progressive_rfx_quant_lsub(&shiftY, 1); /* -6 + 5 = -1 */
+	shiftCb = cbBitPos;
+	progressive_rfx_quant_lsub(&shiftCb, 1); /* -6 + 5 = -1 */
+	shiftCr = crBitPos;
+	progressive_rfx_quant_lsub(&shiftCr, 1); /* -6 + 5 = -1 */
+
+	pSign[0] = (INT16*)((BYTE*)(&tile->sign[((8192 + 32) * 0) + 16])); /* Y/R buffer */
+	pSign[1] = (INT16*)((BYTE*)(&tile->sign[((8192 + 32) * 1) + 16])); /* Cb/G buffer */
+	pSign[2] = (INT16*)((BYTE*)(&tile->sign[((8192 + 32) * 2) + 16])); /* Cr/B buffer */
+
+	pCurrent[0] = (INT16*)((BYTE*)(&tile->current[((8192 + 32) * 0) + 16])); /* Y/R buffer */
+	pCurrent[1] = (INT16*)((BYTE*)(&tile->current[((8192 + 32) * 1) + 16])); /* Cb/G buffer */
+	pCurrent[2] = (INT16*)((BYTE*)(&tile->current[((8192 + 32) * 2) + 16])); /* Cr/B buffer */
+
+	start = Stream_GetPosition(s);
+	if (!Stream_EnsureRemainingCapacity(s, 26))
+		return FALSE;
+	Stream_Seek(s, 26);
+
+	rc = progressive_rfx_upgrade_encode_component(progressive, &shiftY, &yNumBits, pCurrent[0],
+	                                              pSign[0], s, &ySrlLen, &yRawLen); /* Y */
+	if (rc < 0)
+		return FALSE;
+	rc = progressive_rfx_upgrade_encode_component(progressive, &shiftCb, &cbNumBits, pCurrent[1],
+	                                              pSign[1], s, &cbSrlLen, &cbRawLen); /* Cb */
+	if (rc < 0)
+		return FALSE;
+	rc = progressive_rfx_upgrade_encode_component(progressive, &shiftCr, &crNumBits, pCurrent[2],
+	                                              pSign[2], s, &crSrlLen, &crRawLen); /* Cr */
+	if (rc < 0)
+		return FALSE;
+
+	tile->pass++;
+	tile->quality = quality;
+	tile->yBitPos = yBitPos;
+	tile->cbBitPos = cbBitPos;
+	tile->crBitPos = crBitPos;
+	tile->yProgQuant = quantProg->yQuantValues;
+	tile->cbProgQuant = quantProg->cbQuantValues;
+	tile->crProgQuant = quantProg->crQuantValues;
+
+	/* RFX_PROGRESSIVE_TILE_UPGRADE */
+	end = Stream_GetPosition(s);
+	Stream_SetPosition(s, start);
+	Stream_Write_UINT16(s, PROGRESSIVE_WBT_TILE_UPGRADE); /* blockType (2 bytes) */
+	Stream_Write_UINT32(s, (UINT32)(end - start));        /* blockLen (4 bytes) */
+	Stream_Write_UINT8(s, 0);                             /* quantIdxY (1 byte) */
+	Stream_Write_UINT8(s, 0);                             /* quantIdxCb (1 byte) */
+	Stream_Write_UINT8(s, 0);                             /* quantIdxCr (1 byte) */
+	Stream_Write_UINT16(s, tile->xIdx);                   /* xIdx (2 bytes) */
+	Stream_Write_UINT16(s, tile->yIdx);                   /* yIdx (2 bytes) */
+	Stream_Write_UINT8(s, tile->quality);                 /* quality (1 byte) */
+	Stream_Write_UINT16(s, ySrlLen);                      /* ySrlLen (2 bytes) */
+	Stream_Write_UINT16(s, yRawLen);                      /* yRawLen (2 bytes) */
+	Stream_Write_UINT16(s, cbSrlLen);                     /* cbSrlLen (2 bytes) */
+	Stream_Write_UINT16(s, cbRawLen);                     /* cbRawLen (2 bytes) */
+	Stream_Write_UINT16(s, crSrlLen);                     /* crSrlLen (2 bytes) */
+	Stream_Write_UINT16(s, crRawLen);                     /* crRawLen (2 bytes) */
+	Stream_SetPosition(s, end);
+	return TRUE;
+}
+
+static BOOL progressive_rfx_write_message_progressive(PROGRESSIVE_CONTEXT* progressive,
+                                                      wStream* s,
+                                                      PROGRESSIVE_SURFACE_CONTEXT* surface,
+                                                      const BYTE* pSrcData, UINT32 SrcFormat,
+                                                      UINT32 Width, UINT32 Height,
+                                                      UINT32 ScanLine)
+{
+	UINT32 i;
+	size_t start, end;
+	size_t tilesStart;
+	const UINT32 bpp = GetBytesPerPixel(SrcFormat);
+
+	/* RFX_PROGRESSIVE_SYNC */
+	if (!Stream_EnsureRemainingCapacity(s, 12 + 10 + 12 + 18))
+		return FALSE;
+	Stream_Write_UINT16(s, PROGRESSIVE_WBT_SYNC); /* blockType (2 bytes) */
+	Stream_Write_UINT32(s, 12);                   /* blockLen (4 bytes) */
+	Stream_Write_UINT32(s, 0xCACCACCA);           /* magic (4 bytes) */
+	Stream_Write_UINT16(s, 0x0100);               /* version (2 bytes) */
+
+	/* RFX_PROGRESSIVE_CONTEXT */
+	Stream_Write_UINT16(s, PROGRESSIVE_WBT_CONTEXT); /* blockType (2 bytes) */
+	Stream_Write_UINT32(s, 10);                      /* blockLen (4 bytes) */
+	Stream_Write_UINT8(s, 0);                        /* ctxId (1 byte) */
+	Stream_Write_UINT16(s, 64);                      /* tileSize (2 bytes) */
+	Stream_Write_UINT8(s, RFX_SUBBAND_DIFFING);      /* flags (1 byte) */
+
+	/* RFX_PROGRESSIVE_FRAME_BEGIN */
+	Stream_Write_UINT16(s, PROGRESSIVE_WBT_FRAME_BEGIN); /* blockType (2 bytes) */
+	Stream_Write_UINT32(s, 12);                          /* blockLen (4 bytes) */
+	Stream_Write_UINT32(s, surface->frameId++);          /* frameIndex (4 bytes) */
+	Stream_Write_UINT16(s, 1);                           /* regionCount (2 bytes) */
+
+	/* RFX_PROGRESSIVE_REGION, lengths are filled in once the tiles are written */
+	start = Stream_GetPosition(s);
+	Stream_Seek(s, 18);
+
+	if (!Stream_EnsureRemainingCapacity(s, surface->numUpdatedTiles * 8ull + 5 +
+	                                           ARRAYSIZE(progressive_encode_quant_prog) * 16))
+		return FALSE;
+
+	for (i = 0; i < surface->numUpdatedTiles; i++)
+	{
+		/* TS_RFX_RECT */
+		const RFX_PROGRESSIVE_TILE* tile = &surface->tiles[surface->updatedTileIndices[i]];
+		Stream_Write_UINT16(s, (UINT16)tile->x);                   /* x (2 bytes) */
+		Stream_Write_UINT16(s, (UINT16)tile->y);                   /* y (2 bytes) */
+		Stream_Write_UINT16(s, (UINT16)MIN(64, Width - tile->x));  /* width (2 bytes) */
+		Stream_Write_UINT16(s, (UINT16)MIN(64, Height - tile->y)); /* height (2 bytes) */
+	}
+
+	/* RFX_COMPONENT_CODEC_QUANT */
+	progressive_rfx_quant_write(s, &progressive_encode_quant);
+
+	for (i = 0; i < ARRAYSIZE(progressive_encode_quant_prog); i++)
+	{
+		/* RFX_PROGRESSIVE_CODEC_QUANT */
+		const RFX_PROGRESSIVE_CODEC_QUANT* quantProg = &progressive_encode_quant_prog[i];
+		Stream_Write_UINT8(s, quantProg->quality); /* quality (1 byte) */
+		progressive_rfx_quant_write(s, &quantProg->yQuantValues);
+		progressive_rfx_quant_write(s, &quantProg->cbQuantValues);
+		progressive_rfx_quant_write(s, &quantProg->crQuantValues);
+	}
+
+	tilesStart = Stream_GetPosition(s);
+
+	for (i = 0; i < surface->numUpdatedTiles; i++)
+	{
+		RFX_PROGRESSIVE_TILE* tile = &surface->tiles[surface->updatedTileIndices[i]];
+
+		if (tile->blockType == PROGRESSIVE_WBT_TILE_FIRST)
+		{
+			const BYTE* pTileData = &pSrcData[(tile->y * ScanLine) + (tile->x * bpp)];
+
+			if (!progressive_rfx_write_tile_first(progressive, s, tile, pTileData, SrcFormat,
+			                                      ScanLine, MIN(64, Width - tile->x),
+			                                      MIN(64, Height - tile->y)))
+				return FALSE;
+		}
+		else
+		{
+			if (!progressive_rfx_write_tile_upgrade(progressive, s, tile))
+				return FALSE;
+		}
+	}
+
+	end = Stream_GetPosition(s);
+	Stream_SetPosition(s, start);
+	Stream_Write_UINT16(s, PROGRESSIVE_WBT_REGION);           /* blockType (2 bytes) */
+	Stream_Write_UINT32(s, (UINT32)(end - start));            /* blockLen (4 bytes) */
+	Stream_Write_UINT8(s, 64);                                /* tileSize (1 byte) */
+	Stream_Write_UINT16(s, (UINT16)surface->numUpdatedTiles); /* numRects (2 bytes) */
+	Stream_Write_UINT8(s, 1);                                 /* numQuant (1 byte) */
+	Stream_Write_UINT8(s, ARRAYSIZE(progressive_encode_quant_prog)); /* numProgQuant (1 byte) */
+	Stream_Write_UINT8(s, RFX_DWT_REDUCE_EXTRAPOLATE);               /* flags (1 byte) */
+	Stream_Write_UINT16(s, (UINT16)surface->numUpdatedTiles);        /* numTiles (2 bytes) */
+	Stream_Write_UINT32(s, (UINT32)(end - tilesStart));              /* tilesDataSize (4 bytes) */
+	Stream_SetPosition(s, end);
+
+	/* RFX_PROGRESSIVE_FRAME_END */
+	if (!Stream_EnsureRemainingCapacity(s, 6))
+		return FALSE;
+	Stream_Write_UINT16(s, PROGRESSIVE_WBT_FRAME_END); /* blockType (2 bytes) */
+	Stream_Write_UINT32(s, 6);                         /* blockLen (4 bytes) */
+
+	return TRUE;
+}
+
+static int progressive_compress_check_input(UINT32 SrcFormat, UINT32 SrcSize, UINT32 Width,
+                                            UINT32 Height, UINT32* pScanLine)
+{
+	if (*pScanLine == 0)
 	{
 		switch (SrcFormat)
 		{
@@ -2619,16 +3381,134 @@ int progressive_compress_ex(PROGRESSIVE_CONTEXT* progressive, const BYTE* pSrcDa
 			case PIXEL_FORMAT_BGRX32:
 			case PIXEL_FORMAT_RGBA32:
 			case PIXEL_FORMAT_RGBX32:
-				ScanLine = Width * 4;
+				*pScanLine = Width * 4;
 				break;
 			default:
 				return -2;
 		}
 	}
-	if (ScanLine / Width != 4)
+	if (*pScanLine / Width != 4)
 		return -3;
-	if (SrcSize < Height * ScanLine)
+	if (SrcSize < Height * *pScanLine)
 		return -4;
+	return 0;
+}
+
+int progressive_compress_surface(PROGRESSIVE_CONTEXT* progressive, UINT16 surfaceId,
+                                 const BYTE* pSrcData, UINT32 SrcSize, UINT32 SrcFormat,
+                                 UINT32 Width, UINT32 Height, UINT32 ScanLine,
+                                 const REGION16* invalidRegion, BYTE** ppDstData, UINT32* pDstSize)
+{
+	int res;
+	wStream* s;
+	UINT32 xIdx, yIdx;
+	PROGRESSIVE_SURFACE_CONTEXT* surface;
+
+	if (!progressive || !progressive->Compressor || !pSrcData || !ppDstData || !pDstSize)
+		return -1;
+
+	res = progressive_compress_check_input(SrcFormat, SrcSize, Width, Height, &ScanLine);
+	if (res < 0)
+		return res;
+
+	surface = progressive_get_surface_data(progressive, surfaceId);
+	if (!surface)
+	{
+		WLog_Print(progressive->log, WLOG_ERROR, "no surface for %" PRIu16, surfaceId);
+		return -5;
+	}
+
+	if ((Width > surface->width) || (Height > surface->height))
+		return -5;
+
+	s = progressive->buffer;
+	Stream_SetPosition(s, 0);
+	*ppDstData = Stream_Buffer(s);
+	*pDstSize = 0;
+
+	/* Select the tiles for this frame, fresh content first, refinements of still tiles next */
+	surface->numUpdatedTiles = 0;
+
+	for (yIdx = 0; yIdx < (Height + 63) / 64; yIdx++)
+	{
+		for (xIdx = 0; xIdx < (Width + 63) / 64; xIdx++)
+		{
+			BOOL invalid = TRUE;
+			const UINT32 zIdx = (yIdx * surface->gridWidth) + xIdx;
+			RFX_PROGRESSIVE_TILE* tile = &surface->tiles[zIdx];
+
+			if (invalidRegion)
+			{
+				RECTANGLE_16 rect;
+				rect.left = (UINT16)(xIdx * 64);
+				rect.top = (UINT16)(yIdx * 64);
+				rect.right = (UINT16)MIN(Width, (xIdx + 1) * 64);
+				rect.bottom = (UINT16)MIN(Height, (yIdx + 1) * 64);
+				invalid = region16_intersects_rect(invalidRegion, &rect);
+			}
+
+			if (invalid)
+				tile->blockType = PROGRESSIVE_WBT_TILE_FIRST;
+			else if ((tile->pass > 0) && (tile->quality != 0xFF))
+				tile->blockType = PROGRESSIVE_WBT_TILE_UPGRADE;
+			else
+				continue;
+
+			tile->xIdx = (UINT16)xIdx;
+			tile->yIdx = (UINT16)yIdx;
+			tile->x = xIdx * 64;
+			tile->y = yIdx * 64;
+			surface->updatedTileIndices[surface->numUpdatedTiles++] = zIdx;
+		}
+	}
+
+	if (surface->numUpdatedTiles == 0)
+		return 0;
+
+	if (surface->numUpdatedTiles > UINT16_MAX)
+		return -5;
+
+	progressive->rfx_context->mode = RLGR1;
+
+	if (!progressive_rfx_write_message_progressive(progressive, s, surface, pSrcData, SrcFormat,
+	                                               Width, Height, ScanLine))
+	{
+		WLog_Print(progressive->log, WLOG_ERROR, "failed to encode progressive message");
+		return -6;
+	}
+
+	*pDstSize = (UINT32)Stream_GetPosition(s);
+	*ppDstData = Stream_Buffer(s);
+	return 0;
+}
+
+int progressive_compress(PROGRESSIVE_CONTEXT* progressive, const BYTE* pSrcData, UINT32 SrcSize,
+                         BYTE** ppDstData, UINT32* pDstSize)
+{
+	return -1;
+}
+
+int progressive_compress_ex(PROGRESSIVE_CONTEXT* progressive, const BYTE* pSrcData, UINT32 SrcSize,
+                            UINT32 SrcFormat, UINT32 Width, UINT32 Height, UINT32 ScanLine,
+                            const REGION16* invalidRegion, BYTE** ppDstData, UINT32* pDstSize)
+{
+	BOOL rc;
+	int res = -6;
+	wStream* s;
+	UINT32 i, numRects;
+	UINT32 x, y;
+	RFX_RECT* rects = NULL;
+	RFX_MESSAGE* message;
+
+	if (!progressive || !pSrcData || !ppDstData || !pDstSize)
+	{
+		return -1;
+	}
+
+	res = progressive_compress_check_input(SrcFormat, SrcSize, Width, Height, &ScanLine);
+	if (res < 0)
+		return res;
+	res = -6;
 
 	if (!invalidRegion)
 	{
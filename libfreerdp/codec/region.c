@@ -682,6 +682,224 @@ BOOL region16_union_rect(REGION16* dst, const REGION16* src, const RECTANGLE_16*
 	return region16_simplify_bands(dst);
 }
 
+static int region16_compare_rect_top(const void* a, const void* b)
+{
+	const RECTANGLE_16* r1 = (const RECTANGLE_16*)a;
+	const RECTANGLE_16* r2 = (const RECTANGLE_16*)b;
+
+	if (r1->top != r2->top)
+		return (r1->top < r2->top) ? -1 : 1;
+
+	return (int)r1->left - (int)r2->left;
+}
+
+static int region16_compare_y(const void* a, const void* b)
+{
+	return (int)*(const UINT16*)a - (int)*(const UINT16*)b;
+}
+
+BOOL region16_union_rects(REGION16* dst, const REGION16* src, const RECTANGLE_16* rects,
+                          UINT32 count)
+{
+	/** Instead of merging the rectangles one by one, which rebuilds the bands for each of
+	 * them, the region is swept once from top to bottom:
+	 *
+	 *  - all rectangles (the ones of src and the new ones) are sorted by top and the
+	 *    distinct top and bottom coordinates make up the band boundaries
+	 *  - the rectangles spanning the current band are kept sorted by left, so the items
+	 *    of a band are the merged horizontal spans of that list
+	 *  - a band with the same items as the band just above is merged with it
+	 *
+	 * Sorting costs O(n log n), every band then walks its active rectangles, so the sweep is
+	 * O(bands * active): linear for scattered damage, quadratic for many tall rectangles
+	 * that overlap the same bands.
+	 */
+	UINT32 x, nbSrcRects;
+	UINT32 nbInput = 0;
+	UINT32 nbEdges = 0;
+	UINT32 nbActive = 0;
+	UINT32 next = 0;
+	UINT32 usedRects = 0;
+	UINT32 maxRects;
+	UINT32 prevBand = 0;
+	UINT32 prevBandItems = 0;
+	BOOL rc = FALSE;
+	const RECTANGLE_16* srcRects;
+	RECTANGLE_16* input = NULL;
+	RECTANGLE_16* active = NULL;
+	RECTANGLE_16* output = NULL;
+	UINT16* edges = NULL;
+	REGION16_DATA* newItems;
+	RECTANGLE_16 extents;
+	assert(src);
+	assert(src->data);
+	assert(dst);
+
+	if (!rects && (count > 0))
+		return FALSE;
+
+	srcRects = region16_rects(src, &nbSrcRects);
+	input = (RECTANGLE_16*)calloc(nbSrcRects + count + 1, sizeof(RECTANGLE_16));
+
+	if (!input)
+		return FALSE;
+
+	CopyMemory(input, srcRects, nbSrcRects * sizeof(RECTANGLE_16));
+	nbInput = nbSrcRects;
+
+	for (x = 0; x < count; x++)
+	{
+		if ((rects[x].left < rects[x].right) && (rects[x].top < rects[x].bottom))
+			input[nbInput++] = rects[x];
+	}
+
+	if (nbInput == nbSrcRects)
+	{
+		free(input);
+		return region16_copy(dst, src);
+	}
+
+	maxRects = nbInput * 2;
+	active = (RECTANGLE_16*)calloc(nbInput, sizeof(RECTANGLE_16));
+	output = (RECTANGLE_16*)calloc(maxRects, sizeof(RECTANGLE_16));
+	edges = (UINT16*)calloc(nbInput * 2, sizeof(UINT16));
+
+	if (!active || !output || !edges)
+		goto out;
+
+	qsort(input, nbInput, sizeof(RECTANGLE_16), region16_compare_rect_top);
+
+	for (x = 0; x < nbInput; x++)
+	{
+		edges[nbEdges++] = input[x].top;
+		edges[nbEdges++] = input[x].bottom;
+	}
+
+	qsort(edges, nbEdges, sizeof(UINT16), region16_compare_y);
+
+	for (x = 0; x + 1 < nbEdges; x++)
+	{
+		UINT32 i, j;
+		UINT32 bandItems = 0;
+		RECTANGLE_16 span;
+		const UINT16 top = edges[x];
+		const UINT16 bottom = edges[x + 1];
+
+		if (top == bottom)
+			continue;
+
+		/* drop the rectangles that ended above this band */
+		for (i = 0, j = 0; i < nbActive; i++)
+		{
+			if (active[i].bottom > top)
+				active[j++] = active[i];
+		}
+
+		nbActive = j;
+
+		/* insert the ones starting here, sorted by left */
+		for (; (next < nbInput) && (input[next].top == top); next++)
+		{
+			i = nbActive++;
+
+			while ((i > 0) && (active[i - 1].left > input[next].left))
+			{
+				active[i] = active[i - 1];
+				i--;
+			}
+
+			active[i] = input[next];
+		}
+
+		if (nbActive == 0)
+			continue;
+
+		if (usedRects + nbActive > maxRects)
+		{
+			RECTANGLE_16* tmp;
+			maxRects = MAX(maxRects * 2, usedRects + nbActive);
+			tmp = (RECTANGLE_16*)realloc(output, maxRects * sizeof(RECTANGLE_16));
+
+			if (!tmp)
+				goto out;
+
+			output = tmp;
+		}
+
+		/* items of a band must not touch, so touching spans are merged as well */
+		span = active[0];
+
+		for (i = 1; i <= nbActive; i++)
+		{
+			if ((i < nbActive) && (active[i].left <= span.right))
+			{
+				span.right = MAX(span.right, active[i].right);
+				continue;
+			}
+
+			span.top = top;
+			span.bottom = bottom;
+			output[usedRects + bandItems++] = span;
+
+			if (i < nbActive)
+				span = active[i];
+		}
+
+		/* coalesce with the band above when it touches and has the same items */
+		if ((prevBandItems == bandItems) && (output[prevBand].bottom == top))
+		{
+			for (i = 0; i < bandItems; i++)
+			{
+				if ((output[prevBand + i].left != output[usedRects + i].left) ||
+				    (output[prevBand + i].right != output[usedRects + i].right))
+					break;
+			}
+
+			if (i == bandItems)
+			{
+				for (i = 0; i < bandItems; i++)
+					output[prevBand + i].bottom = bottom;
+
+				continue;
+			}
+		}
+
+		prevBand = usedRects;
+		prevBandItems = bandItems;
+		usedRects += bandItems;
+	}
+
+	newItems = allocateRegion(usedRects);
+
+	if (!newItems)
+		goto out;
+
+	CopyMemory(&newItems[1], output, usedRects * sizeof(RECTANGLE_16));
+	extents.top = output[0].top;
+	extents.bottom = output[usedRects - 1].bottom;
+	extents.left = output[0].left;
+	extents.right = output[0].right;
+
+	for (x = 1; x < usedRects; x++)
+	{
+		extents.left = MIN(extents.left, output[x].left);
+		extents.right = MAX(extents.right, output[x].right);
+	}
+
+	if (dst->data && (dst->data->size > 0) && (dst->data != &empty_region))
+		free(dst->data);
+
+	dst->data = newItems;
+	dst->extents = extents;
+	rc = TRUE;
+out:
+	free(input);
+	free(active);
+	free(output);
+	free(edges);
+	return rc;
+}
+
 BOOL region16_intersects_rect(const REGION16* src, const RECTANGLE_16* arg2)
 {
 	const RECTANGLE_16 *rect, *endPtr, *srcExtents;
@@ -50,6 +50,7 @@
 #include "rfx_dwt.h"
 #include "rfx_rlgr.h"
 
+#include "rfx_avx2.h"
 #include "rfx_sse2.h"
 #include "rfx_neon.h"
 
@@ -137,6 +138,20 @@ static void rfx_profiler_print(RFX_CONTEXT* context)
 	PROFILER_PRINT_FOOTER
 }
 
+static void rfx_init_generic(RFX_CONTEXT* context)
+{
+	PROFILER_RENAME(context->priv->prof_rfx_quantization_decode, "rfx_quantization_decode");
+	PROFILER_RENAME(context->priv->prof_rfx_quantization_encode, "rfx_quantization_encode");
+	PROFILER_RENAME(context->priv->prof_rfx_dwt_2d_decode, "rfx_dwt_2d_decode");
+	PROFILER_RENAME(context->priv->prof_rfx_dwt_2d_encode, "rfx_dwt_2d_encode");
+	context->quantization_decode = rfx_quantization_decode;
+	context->quantization_encode = rfx_quantization_encode;
+	context->dwt_2d_decode = rfx_dwt_2d_decode;
+	context->dwt_2d_encode = rfx_dwt_2d_encode;
+	context->rlgr_decode = rfx_rlgr_decode;
+	context->rlgr_encode = rfx_rlgr_encode;
+}
+
 static void rfx_tile_init(void* obj)
 {
 	RFX_TILE* tile = (RFX_TILE*)obj;
@@ -322,12 +337,7 @@ RFX_CONTEXT* rfx_context_new(BOOL encoder)
 	/* create profilers for default decoding routines */
 	rfx_profiler_create(context);
 	/* set up default routines */
-	context->quantization_decode = rfx_quantization_decode;
-	context->quantization_encode = rfx_quantization_encode;
-	context->dwt_2d_decode = rfx_dwt_2d_decode;
-	context->dwt_2d_encode = rfx_dwt_2d_encode;
-	context->rlgr_decode = rfx_rlgr_decode;
-	context->rlgr_encode = rfx_rlgr_encode;
+	rfx_init_generic(context);
 	RFX_INIT_SIMD(context);
 	context->state = RFX_STATE_SEND_HEADERS;
 	context->expectedDataBlockType = WBT_FRAME_BEGIN;
@@ -380,6 +390,74 @@ void rfx_context_free(RFX_CONTEXT* context)
 	free(context);
 }
 
+BOOL rfx_context_set_simd(RFX_CONTEXT* context, RFX_SIMD simd)
+{
+	if (!context || !context->priv)
+		return FALSE;
+
+	switch (simd)
+	{
+		case RFX_SIMD_GENERIC:
+			break;
+#if defined(WITH_SSE2)
+
+		case RFX_SIMD_SSE2:
+			if (!IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE))
+				return FALSE;
+
+			break;
+#endif
+#if defined(WITH_AVX2)
+
+		case RFX_SIMD_AVX2:
+			if (!IsProcessorFeaturePresentEx(PF_EX_AVX2))
+				return FALSE;
+
+			break;
+#endif
+#if defined(WITH_NEON)
+
+		case RFX_SIMD_NEON:
+			if (!IsProcessorFeaturePresent(PF_ARM_NEON_INSTRUCTIONS_AVAILABLE))
+				return FALSE;
+
+			break;
+#endif
+
+		default:
+			return FALSE;
+	}
+
+	rfx_init_generic(context);
+
+	switch (simd)
+	{
+#if defined(WITH_SSE2)
+
+		case RFX_SIMD_SSE2:
+			rfx_init_sse2(context);
+			break;
+#endif
+#if defined(WITH_AVX2)
+
+		case RFX_SIMD_AVX2:
+			rfx_init_avx2(context);
+			break;
+#endif
+#if defined(WITH_NEON)
+
+		case RFX_SIMD_NEON:
+			rfx_init_neon(context);
+			break;
+#endif
+
+		default:
+			break;
+	}
+
+	return TRUE;
+}
+
 static RFX_TILE* rfx_message_get_tile(RFX_MESSAGE* message, UINT32 index)
 {
 	return message->tiles[index];
@@ -1172,20 +1250,32 @@ BOOL rfx_process_message(RFX_CONTEXT* context, const BYTE* data, UINT32 length,
 		UINT32 i, j;
 		UINT32 nbUpdateRects;
 		REGION16 clippingRects;
+		RECTANGLE_16* clippingRect;
 		const RECTANGLE_16* updateRects;
 		const DWORD formatSize = GetBytesPerPixel(context->pixel_format);
 		const UINT32 dstWidth = dstStride / GetBytesPerPixel(dstFormat);
 		region16_init(&clippingRects);
+		clippingRect = (RECTANGLE_16*)calloc(message->numRects + 1, sizeof(RECTANGLE_16));
+
+		if (!clippingRect)
+			return FALSE;
 
 		for (i = 0; i < message->numRects; i++)
 		{
-			RECTANGLE_16 clippingRect;
 			const RFX_RECT* rect = &(message->rects[i]);
-			clippingRect.left = MIN(left + rect->x, dstWidth);
-			clippingRect.top = MIN(top + rect->y, dstHeight);
-			clippingRect.right = MIN(clippingRect.left + rect->width, dstWidth);
-			clippingRect.bottom = MIN(clippingRect.top + rect->height, dstHeight);
-			region16_union_rect(&clippingRects, &clippingRects, &clippingRect);
+			clippingRect[i].left = MIN(left + rect->x, dstWidth);
+			clippingRect[i].top = MIN(top + rect->y, dstHeight);
+			clippingRect[i].right = MIN(clippingRect[i].left + rect->width, dstWidth);
+			clippingRect[i].bottom = MIN(clippingRect[i].top + rect->height, dstHeight);
+		}
+
+		ok = region16_union_rects(&clippingRects, &clippingRects, clippingRect, message->numRects);
+		free(clippingRect);
+
+		if (!ok)
+		{
+			region16_uninit(&clippingRects);
+			return FALSE;
 		}
 
 		for (i = 0; i < message->numTiles; i++)
@@ -1215,16 +1305,17 @@ BOOL rfx_process_message(RFX_CONTEXT* context, const BYTE* data, UINT32 length,
 				                        NULL, FREERDP_FLIP_NONE))
 				{
 					region16_uninit(&updateRegion);
+					region16_uninit(&clippingRects);
 					WLog_ERR(TAG,
 					         "nbUpdateRectx[% " PRIu32 " (%" PRIu32 ")] freerdp_image_copy failed",
 					         j, nbUpdateRects);
 					return FALSE;
 				}
-
-				if (invalidRegion)
-					region16_union_rect(invalidRegion, invalidRegion, &updateRects[j]);
 			}
 
+			if (invalidRegion)
+				region16_union_rects(invalidRegion, invalidRegion, updateRects, nbUpdateRects);
+
 			region16_uninit(&updateRegion);
 		}
 
@@ -1399,21 +1490,32 @@ static BOOL computeRegion(const RFX_RECT* rects, int numRects, REGION16* region,
                           int height)
 {
 	int i;
-	const RFX_RECT* rect = rects;
+	BOOL rc;
+	RECTANGLE_16* rects16;
 	const RECTANGLE_16 mainRect = { 0, 0, width, height };
 
-	for (i = 0; i < numRects; i++, rect++)
-	{
-		RECTANGLE_16 rect16;
-		rect16.left = rect->x;
-		rect16.top = rect->y;
-		rect16.right = rect->x + rect->width;
-		rect16.bottom = rect->y + rect->height;
+	if (numRects < 0)
+		return FALSE;
 
-		if (!region16_union_rect(region, region, &rect16))
-			return FALSE;
+	rects16 = (RECTANGLE_16*)calloc(numRects + 1, sizeof(RECTANGLE_16));
+
+	if (!rects16)
+		return FALSE;
+
+	for (i = 0; i < numRects; i++)
+	{
+		rects16[i].left = rects[i].x;
+		rects16[i].top = rects[i].y;
+		rects16[i].right = rects[i].x + rects[i].width;
+		rects16[i].bottom = rects[i].y + rects[i].height;
 	}
 
+	rc = region16_union_rects(region, region, rects16, numRects);
+	free(rects16);
+
+	if (!rc)
+		return FALSE;
+
 	return region16_intersect_rect(region, region, &mainRect);
 }
 
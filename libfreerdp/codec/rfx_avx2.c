@@ -0,0 +1,297 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * RemoteFX Codec Library - AVX2 Optimizations
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <winpr/sysinfo.h>
+
+#include <immintrin.h>
+
+#include "rfx_types.h"
+#include "rfx_sse2.h"
+#include "rfx_avx2.h"
+
+#ifdef _MSC_VER
+#define __attribute__(...)
+#endif
+
+#ifndef __clang__
+#define ATTRIBUTES __gnu_inline__, __always_inline__, __artificial__
+#else
+#define ATTRIBUTES __gnu_inline__, __always_inline__
+#endif
+
+/* The encode kernels produce the same coefficients as the SSE2 ones: all arithmetic is done
+ * on 16 bit lanes, only the vector width differs. Buffers come from the RFX BufferPool, which
+ * only guarantees 16 byte alignment, so unaligned loads and stores are used throughout. */
+
+static __inline void __attribute__((ATTRIBUTES))
+rfx_quantization_encode_block_avx2(INT16* buffer, const int buffer_size, const UINT32 factor)
+{
+	__m256i a;
+	__m256i* ptr = (__m256i*)buffer;
+	__m256i* buf_end = (__m256i*)(buffer + buffer_size);
+	const __m256i half = _mm256_set1_epi16(factor ? 1 << (factor - 1) : 0);
+	const __m256i round = _mm256_set1_epi16(1 << 4);
+
+	/* The band quantization and the final >> 5 (undoing the << 5 scaling of the
+	 * RGB->YCbCr phase) are fused, so each coefficient is only loaded once. */
+	do
+	{
+		a = _mm256_loadu_si256(ptr);
+
+		if (factor)
+		{
+			a = _mm256_add_epi16(a, half);
+			a = _mm256_srai_epi16(a, factor);
+		}
+
+		a = _mm256_add_epi16(a, round);
+		a = _mm256_srai_epi16(a, 5);
+		_mm256_storeu_si256(ptr, a);
+		ptr++;
+	} while (ptr < buf_end);
+}
+
+static void rfx_quantization_encode_avx2(INT16* buffer, const UINT32* quantization_values)
+{
+	rfx_quantization_encode_block_avx2(buffer, 1024, quantization_values[8] - 6);        /* HL1 */
+	rfx_quantization_encode_block_avx2(buffer + 1024, 1024, quantization_values[7] - 6); /* LH1 */
+	rfx_quantization_encode_block_avx2(buffer + 2048, 1024, quantization_values[9] - 6); /* HH1 */
+	rfx_quantization_encode_block_avx2(buffer + 3072, 256, quantization_values[5] - 6);  /* HL2 */
+	rfx_quantization_encode_block_avx2(buffer + 3328, 256, quantization_values[4] - 6);  /* LH2 */
+	rfx_quantization_encode_block_avx2(buffer + 3584, 256, quantization_values[6] - 6);  /* HH2 */
+	rfx_quantization_encode_block_avx2(buffer + 3840, 64, quantization_values[2] - 6);   /* HL3 */
+	rfx_quantization_encode_block_avx2(buffer + 3904, 64, quantization_values[1] - 6);   /* LH3 */
+	rfx_quantization_encode_block_avx2(buffer + 3968, 64, quantization_values[3] - 6);   /* HH3 */
+	rfx_quantization_encode_block_avx2(buffer + 4032, 64, quantization_values[0] - 6);   /* LL3 */
+}
+
+static __inline void __attribute__((ATTRIBUTES))
+rfx_dwt_2d_encode_block_vert_avx2(const INT16* src, INT16* l, INT16* h, int subband_width)
+{
+	int x;
+	int n;
+	__m256i src_2n;
+	__m256i src_2n_1;
+	__m256i src_2n_2;
+	__m256i h_n;
+	__m256i h_n_m;
+	__m256i l_n;
+	const int total_width = subband_width << 1;
+
+	for (n = 0; n < subband_width; n++)
+	{
+		for (x = 0; x < total_width; x += 16)
+		{
+			src_2n = _mm256_loadu_si256((const __m256i*)src);
+			src_2n_1 = _mm256_loadu_si256((const __m256i*)(src + total_width));
+
+			if (n < subband_width - 1)
+				src_2n_2 = _mm256_loadu_si256((const __m256i*)(src + 2 * total_width));
+			else
+				src_2n_2 = src_2n;
+
+			/* h[n] = (src[2n + 1] - ((src[2n] + src[2n + 2]) >> 1)) >> 1 */
+			h_n = _mm256_add_epi16(src_2n, src_2n_2);
+			h_n = _mm256_srai_epi16(h_n, 1);
+			h_n = _mm256_sub_epi16(src_2n_1, h_n);
+			h_n = _mm256_srai_epi16(h_n, 1);
+			_mm256_storeu_si256((__m256i*)h, h_n);
+
+			if (n == 0)
+				h_n_m = h_n;
+			else
+				h_n_m = _mm256_loadu_si256((const __m256i*)(h - total_width));
+
+			/* l[n] = src[2n] + ((h[n - 1] + h[n]) >> 1) */
+			l_n = _mm256_add_epi16(h_n_m, h_n);
+			l_n = _mm256_srai_epi16(l_n, 1);
+			l_n = _mm256_add_epi16(l_n, src_2n);
+			_mm256_storeu_si256((__m256i*)l, l_n);
+			src += 16;
+			l += 16;
+			h += 16;
+		}
+
+		src += total_width;
+	}
+}
+
+static __inline void __attribute__((ATTRIBUTES))
+rfx_dwt_2d_encode_block_horiz_avx2(const INT16* src, INT16* l, INT16* h, int subband_width)
+{
+	int y;
+	int n;
+	__m256i a;
+	__m256i b;
+	__m256i src_2n;
+	__m256i src_2n_1;
+	__m256i src_2n_2;
+	__m256i h_n;
+	__m256i h_n_m;
+	__m256i h_prev;
+	__m256i l_n;
+	/* Per 128 bit lane: even samples to the low, odd samples to the high 64 bits */
+	const __m256i deinterleave =
+	    _mm256_setr_epi8(0, 1, 4, 5, 8, 9, 12, 13, 2, 3, 6, 7, 10, 11, 14, 15, 0, 1, 4, 5, 8, 9,
+	                     12, 13, 2, 3, 6, 7, 10, 11, 14, 15);
+
+	for (y = 0; y < subband_width; y++)
+	{
+		h_prev = _mm256_setzero_si256();
+
+		for (n = 0; n < subband_width; n += 16)
+		{
+			a = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)src), deinterleave);
+			b = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(src + 16)), deinterleave);
+			a = _mm256_permute4x64_epi64(a, 0xD8);
+			b = _mm256_permute4x64_epi64(b, 0xD8);
+			src_2n = _mm256_permute2x128_si256(a, b, 0x20);
+			src_2n_1 = _mm256_permute2x128_si256(a, b, 0x31);
+			/* src[2n + 2]: the even samples moved down by one, with the first even sample of
+			 * the next block (or the mirrored last one at the end of the row) appended. */
+			src_2n_2 = _mm256_alignr_epi8(_mm256_permute2x128_si256(src_2n, src_2n, 0x81), src_2n,
+			                              2);
+			src_2n_2 =
+			    _mm256_insert_epi16(src_2n_2, (n == subband_width - 16) ? src[30] : src[32], 15);
+			/* h[n] = (src[2n + 1] - ((src[2n] + src[2n + 2]) >> 1)) >> 1 */
+			h_n = _mm256_add_epi16(src_2n, src_2n_2);
+			h_n = _mm256_srai_epi16(h_n, 1);
+			h_n = _mm256_sub_epi16(src_2n_1, h_n);
+			h_n = _mm256_srai_epi16(h_n, 1);
+			_mm256_storeu_si256((__m256i*)h, h_n);
+
+			/* h[n - 1]: the last value of the previous block shifted in, h[0] for n == 0 */
+			if (n == 0)
+				h_prev = _mm256_broadcastw_epi16(_mm256_castsi256_si128(h_n));
+
+			h_n_m = _mm256_alignr_epi8(h_n, _mm256_permute2x128_si256(h_prev, h_n, 0x21), 14);
+			/* l[n] = src[2n] + ((h[n - 1] + h[n]) >> 1) */
+			l_n = _mm256_add_epi16(h_n_m, h_n);
+			l_n = _mm256_srai_epi16(l_n, 1);
+			l_n = _mm256_add_epi16(l_n, src_2n);
+			_mm256_storeu_si256((__m256i*)l, l_n);
+			h_prev = h_n;
+			src += 32;
+			l += 16;
+			h += 16;
+		}
+	}
+}
+
+static __inline void __attribute__((ATTRIBUTES))
+rfx_dwt_2d_encode_block_horiz_8_avx2(const INT16* src, INT16* l, INT16* h)
+{
+	int y;
+	__m256i a;
+	__m256i b;
+	__m256i src_2n;
+	__m256i src_2n_1;
+	__m256i src_2n_2;
+	__m256i h_n;
+	__m256i h_n_m;
+	__m256i l_n;
+	const __m256i deinterleave =
+	    _mm256_setr_epi8(0, 1, 4, 5, 8, 9, 12, 13, 2, 3, 6, 7, 10, 11, 14, 15, 0, 1, 4, 5, 8, 9,
+	                     12, 13, 2, 3, 6, 7, 10, 11, 14, 15);
+	const __m256i next = _mm256_setr_epi8(2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 14, 15,
+	                                      2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 14, 15);
+	const __m256i prev = _mm256_setr_epi8(0, 1, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 0,
+	                                      1, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13);
+
+	/* With 8 coefficients per row a register holds two rows, one per 128 bit lane, so the
+	 * row boundaries never cross a lane. */
+	for (y = 0; y < 8; y += 2)
+	{
+		a = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)src), deinterleave);
+		b = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(src + 16)), deinterleave);
+		a = _mm256_permute4x64_epi64(a, 0xD8);
+		b = _mm256_permute4x64_epi64(b, 0xD8);
+		src_2n = _mm256_permute2x128_si256(a, b, 0x20);
+		src_2n_1 = _mm256_permute2x128_si256(a, b, 0x31);
+		src_2n_2 = _mm256_shuffle_epi8(src_2n, next);
+		/* h[n] = (src[2n + 1] - ((src[2n] + src[2n + 2]) >> 1)) >> 1 */
+		h_n = _mm256_add_epi16(src_2n, src_2n_2);
+		h_n = _mm256_srai_epi16(h_n, 1);
+		h_n = _mm256_sub_epi16(src_2n_1, h_n);
+		h_n = _mm256_srai_epi16(h_n, 1);
+		_mm256_storeu_si256((__m256i*)h, h_n);
+		/* l[n] = src[2n] + ((h[n - 1] + h[n]) >> 1) */
+		h_n_m = _mm256_shuffle_epi8(h_n, prev);
+		l_n = _mm256_add_epi16(h_n_m, h_n);
+		l_n = _mm256_srai_epi16(l_n, 1);
+		l_n = _mm256_add_epi16(l_n, src_2n);
+		_mm256_storeu_si256((__m256i*)l, l_n);
+		src += 32;
+		l += 16;
+		h += 16;
+	}
+}
+
+static __inline void __attribute__((ATTRIBUTES))
+rfx_dwt_2d_encode_block_avx2(INT16* buffer, INT16* dwt, int subband_width)
+{
+	INT16 *hl, *lh, *hh, *ll;
+	INT16 *l_src, *h_src;
+	/* DWT in vertical direction, results in 2 sub-bands in L, H order in tmp buffer dwt. */
+	l_src = dwt;
+	h_src = dwt + subband_width * subband_width * 2;
+	rfx_dwt_2d_encode_block_vert_avx2(buffer, l_src, h_src, subband_width);
+	/* DWT in horizontal direction, results in 4 sub-bands in HL(0), LH(1), HH(2), LL(3) order,
+	 * stored in original buffer. */
+	/* The lower part L generates LL(3) and HL(0). */
+	/* The higher part H generates LH(1) and HH(2). */
+	ll = buffer + subband_width * subband_width * 3;
+	hl = buffer;
+	lh = buffer + subband_width * subband_width;
+	hh = buffer + subband_width * subband_width * 2;
+
+	if (subband_width == 8)
+	{
+		rfx_dwt_2d_encode_block_horiz_8_avx2(l_src, ll, hl);
+		rfx_dwt_2d_encode_block_horiz_8_avx2(h_src, lh, hh);
+	}
+	else
+	{
+		rfx_dwt_2d_encode_block_horiz_avx2(l_src, ll, hl, subband_width);
+		rfx_dwt_2d_encode_block_horiz_avx2(h_src, lh, hh, subband_width);
+	}
+}
+
+static void rfx_dwt_2d_encode_avx2(INT16* buffer, INT16* dwt_buffer)
+{
+	rfx_dwt_2d_encode_block_avx2(buffer, dwt_buffer, 32);
+	rfx_dwt_2d_encode_block_avx2(buffer + 3072, dwt_buffer, 16);
+	rfx_dwt_2d_encode_block_avx2(buffer + 3840, dwt_buffer, 8);
+}
+
+void rfx_init_avx2(RFX_CONTEXT* context)
+{
+	/* Decoding and anything not covered here stays with the SSE2 routines. */
+	rfx_init_sse2(context);
+
+	if (!IsProcessorFeaturePresentEx(PF_EX_AVX2))
+		return;
+
+	PROFILER_RENAME(context->priv->prof_rfx_quantization_encode, "rfx_quantization_encode_avx2");
+	PROFILER_RENAME(context->priv->prof_rfx_dwt_2d_encode, "rfx_dwt_2d_encode_avx2");
+	context->quantization_encode = rfx_quantization_encode_avx2;
+	context->dwt_2d_encode = rfx_dwt_2d_encode_avx2;
+}
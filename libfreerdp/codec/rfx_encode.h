@@ -23,6 +23,9 @@
 #include <freerdp/codec/rfx.h>
 #include <freerdp/api.h>
 
+FREERDP_LOCAL void rfx_encode_format_rgb(const BYTE* rgb_data, int width, int height,
+                                         int rowstride, UINT32 pixel_format, const BYTE* palette,
+                                         INT16* r_buf, INT16* g_buf, INT16* b_buf);
 FREERDP_LOCAL void rfx_encode_rgb(RFX_CONTEXT* context, RFX_TILE* tile);
 
 #endif /* FREERDP_LIB_CODEC_RFX_ENCODE_H */
@@ -67,6 +67,129 @@ fail:
 	return rc;
 }
 
+static void test_ClearFillImage(BYTE* data, UINT32 width, UINT32 height, UINT32 seed)
+{
+	UINT32 x, y;
+
+	for (y = 0; y < height; y++)
+	{
+		for (x = 0; x < width; x++)
+		{
+			UINT32 color = FreeRDPGetColor(PIXEL_FORMAT_XRGB32, 0xFF, 0xFF, 0xFF, 0xFF);
+
+			const UINT32 gx = (x + seed) % 9;
+			const UINT32 gy = y % 16;
+
+			/* Text like rows of repeated glyphs on a white background */
+			if ((gy < 10) && (gx < 6) && (((gx * 3 + gy * 5) % 7) < 3))
+				color = FreeRDPGetColor(PIXEL_FORMAT_XRGB32, 0x20, 0x20, 0x20, 0xFF);
+
+			/* A noisy area that favours the residual layer */
+			if ((y >= 64) && (y < 80) && (x < 40))
+				color = FreeRDPGetColor(PIXEL_FORMAT_XRGB32, x * 5, y, (x * y) & 0xFF, 0xFF);
+
+			WriteColor(&data[(y * width + x) * 4], PIXEL_FORMAT_XRGB32, color);
+		}
+	}
+}
+
+static BOOL test_ClearCompressRoundTrip(CLEAR_CONTEXT* encoder, CLEAR_CONTEXT* decoder,
+                                        const BYTE* pSrcData, UINT32 width, UINT32 height,
+                                        UINT32* pDstSize)
+{
+	BOOL rc = FALSE;
+	int status;
+	BYTE* pDstData = NULL;
+	UINT32 DstSize = 0;
+	BYTE* pOutData = calloc(width * height, 4);
+
+	if (!pOutData)
+		return FALSE;
+
+	status = clear_compress(encoder, pSrcData, PIXEL_FORMAT_XRGB32, width * 4, width, height,
+	                        &pDstData, &DstSize);
+
+	if (status < 0)
+	{
+		printf("clear_compress %" PRIu32 "x%" PRIu32 " failed: %d\n", width, height, status);
+		goto fail;
+	}
+
+	status = clear_decompress(decoder, pDstData, DstSize, width, height, pOutData,
+	                          PIXEL_FORMAT_XRGB32, width * 4, 0, 0, width, height, NULL);
+
+	if (status < 0)
+	{
+		printf("clear_decompress of encoded %" PRIu32 "x%" PRIu32 " failed: %d\n", width,
+		       height, status);
+		goto fail;
+	}
+
+	if (memcmp(pSrcData, pOutData, width * height * 4ULL) != 0)
+	{
+		printf("clear round trip %" PRIu32 "x%" PRIu32 " mismatch\n", width, height);
+		goto fail;
+	}
+
+	*pDstSize = DstSize;
+	rc = TRUE;
+fail:
+	free(pOutData);
+	return rc;
+}
+
+static BOOL test_ClearCompress(void)
+{
+	BOOL rc = FALSE;
+	UINT32 first, second, shifted, glyph, glyphHit;
+	const UINT32 width = 200;
+	const UINT32 height = 120;
+	BYTE* image = calloc(width * height, 4);
+	CLEAR_CONTEXT* encoder = clear_context_new(TRUE);
+	CLEAR_CONTEXT* decoder = clear_context_new(FALSE);
+
+	if (!image || !encoder || !decoder)
+		goto fail;
+
+	test_ClearFillImage(image, width, height, 0);
+
+	if (!test_ClearCompressRoundTrip(encoder, decoder, image, width, height, &first))
+		goto fail;
+
+	/* Identical content must be served from the VBar cache */
+	if (!test_ClearCompressRoundTrip(encoder, decoder, image, width, height, &second))
+		goto fail;
+
+	test_ClearFillImage(image, width, height, 3);
+
+	if (!test_ClearCompressRoundTrip(encoder, decoder, image, width, height, &shifted))
+		goto fail;
+
+	printf("clear_compress %" PRIu32 "x%" PRIu32 ": %" PRIu32 " bytes, repeated %" PRIu32
+	       ", shifted %" PRIu32 "\n",
+	       width, height, first, second, shifted);
+
+	if ((second >= first) || (shifted >= first) || (first >= width * height * 3))
+		goto fail;
+
+	/* Small bitmaps go through the glyph cache */
+	if (!test_ClearCompressRoundTrip(encoder, decoder, image, 16, 16, &glyph))
+		goto fail;
+
+	if (!test_ClearCompressRoundTrip(encoder, decoder, image, 16, 16, &glyphHit))
+		goto fail;
+
+	if (glyphHit != 4)
+		goto fail;
+
+	rc = TRUE;
+fail:
+	clear_context_free(encoder);
+	clear_context_free(decoder);
+	free(image);
+	return rc;
+}
+
 int TestFreeRDPCodecClear(int argc, char* argv[])
 {
 	WINPR_UNUSED(argc);
@@ -86,5 +209,8 @@ int TestFreeRDPCodecClear(int argc, char* argv[])
 	if (!test_ClearDecompressExample(4, 7, 15, TEST_CLEAR_EXAMPLE_4, sizeof(TEST_CLEAR_EXAMPLE_4)))
 		return -1;
 
+	if (!test_ClearCompress())
+		return -1;
+
 	return 0;
 }
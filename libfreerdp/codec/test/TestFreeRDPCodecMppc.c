@@ -1084,8 +1084,118 @@ fail:
 	return rc;
 }
 
+/* Mixed input for the round trip tests: text with small edits, runs and noise */
+static BYTE* test_MppcCreateStream(UINT32 size)
+{
+	UINT32 x;
+	UINT32 seed = 42;
+	BYTE* data = (BYTE*)malloc(size);
+
+	if (!data)
+		return NULL;
+
+	for (x = 0; x < size;)
+	{
+		UINT32 y, length;
+		seed = seed * 1103515245 + 12345;
+		length = MIN(size - x, 64 + (seed >> 16) % 2048);
+
+		switch ((seed >> 8) % 4)
+		{
+			case 0:
+				for (y = 0; y < length; y++)
+					data[x + y] = TEST_RDP5_UNCOMPRESSED_DATA[(x + y) % 1000];
+
+				break;
+
+			case 1:
+				memset(&data[x], (int)(seed >> 24), length);
+				break;
+
+			case 2:
+				for (y = 0; y < length; y++)
+				{
+					seed = seed * 1103515245 + 12345;
+					data[x + y] = (BYTE)(seed >> 16);
+				}
+
+				break;
+
+			default:
+				for (y = 0; y < length; y++)
+					data[x + y] = TEST_ISLAND_DATA[y % (sizeof(TEST_ISLAND_DATA) - 1)];
+
+				if (length > 16)
+					data[x + length / 2] ^= 0x5A;
+
+				break;
+		}
+
+		x += length;
+	}
+
+	return data;
+}
+
+static int test_MppcRoundTrip(UINT32 CompressionLevel, UINT32 MatchLevel)
+{
+	int rc = -1;
+	UINT32 offset;
+	UINT32 chunk = 0;
+	UINT64 total = 0;
+	const UINT32 size = 256 * 1024;
+	BYTE OutputBuffer[65536];
+	BYTE* data = test_MppcCreateStream(size);
+	MPPC_CONTEXT* mppcSend = mppc_context_new(CompressionLevel, TRUE);
+	MPPC_CONTEXT* mppcRecv = mppc_context_new(CompressionLevel, FALSE);
+
+	if (!data || !mppcSend || !mppcRecv || !mppc_set_match_level(mppcSend, MatchLevel))
+		goto fail;
+
+	for (offset = 0; offset < size; offset += chunk)
+	{
+		UINT32 Flags = 0;
+		BYTE* pDstData = OutputBuffer;
+		UINT32 DstSize = sizeof(OutputBuffer);
+		BYTE* pOutData = NULL;
+		UINT32 OutSize = 0;
+		BYTE* pSrcData = &data[offset];
+		/* chunks of varying size so that the history wraps at different offsets */
+		chunk = MIN(size - offset, 1000 + (offset * 7) % (CompressionLevel ? 15000 : 7000));
+
+		if (mppc_compress(mppcSend, pSrcData, chunk, &pDstData, &DstSize, &Flags) < 0)
+			goto fail;
+
+		total += DstSize;
+
+		if (mppc_decompress(mppcRecv, pDstData, DstSize, &pOutData, &OutSize, Flags) < 0)
+		{
+			printf("MppcRoundTrip: decompression failed at offset %" PRIu32 "\n", offset);
+			goto fail;
+		}
+
+		if ((OutSize != chunk) || (memcmp(pOutData, pSrcData, chunk) != 0))
+		{
+			printf("MppcRoundTrip: level %" PRIu32 "/%" PRIu32 " mismatch at offset %" PRIu32
+			       "\n",
+			       CompressionLevel, MatchLevel, offset);
+			goto fail;
+		}
+	}
+
+	printf("MppcRoundTrip: level %" PRIu32 "/%" PRIu32 ": %" PRIu32 " -> %" PRIu64 " bytes\n",
+	       CompressionLevel, MatchLevel, size, total);
+	rc = 0;
+fail:
+	mppc_context_free(mppcSend);
+	mppc_context_free(mppcRecv);
+	free(data);
+	return rc;
+}
+
 int TestFreeRDPCodecMppc(int argc, char* argv[])
 {
+	UINT32 level;
 	WINPR_UNUSED(argc);
 	WINPR_UNUSED(argv);
 
@@ -1110,5 +1220,14 @@ int TestFreeRDPCodecMppc(int argc, char* argv[])
 	if (test_MppcDecompressBufferRdp5() < 0)
 		return -1;
 
+	for (level = BULK_MATCH_LEVEL_LEGACY; level <= BULK_MATCH_LEVEL_BEST; level++)
+	{
+		if (test_MppcRoundTrip(0, level) < 0)
+			return -1;
+
+		if (test_MppcRoundTrip(1, level) < 0)
+			return -1;
+	}
+
 	return 0;
 }
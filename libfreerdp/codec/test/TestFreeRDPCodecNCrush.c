@@ -113,8 +113,88 @@ fail:
 	return rc;
 }
 
+static BOOL test_NCrushRoundTrip(UINT32 MatchLevel)
+{
+	BOOL rc = FALSE;
+	UINT32 x, offset;
+	UINT32 chunk = 0;
+	UINT64 total = 0;
+	UINT32 seed = 7;
+	const UINT32 size = 256 * 1024;
+	BYTE OutputBuffer[65536];
+	BYTE* data = (BYTE*)malloc(size);
+	NCRUSH_CONTEXT* ncrushSend = ncrush_context_new(TRUE);
+	NCRUSH_CONTEXT* ncrushRecv = ncrush_context_new(FALSE);
+
+	if (!data || !ncrushSend || !ncrushRecv || !ncrush_set_match_level(ncrushSend, MatchLevel))
+		goto fail;
+
+	/* repeated text with sparse edits, runs and noise */
+	for (x = 0; x < size; x++)
+	{
+		seed = seed * 1103515245 + 12345;
+
+		if ((x / 4096) % 3 == 2)
+			data[x] = (BYTE)(seed >> 16);
+		else if ((x / 1024) % 5 == 4)
+			data[x] = (BYTE)(x / 1024);
+		else
+			data[x] = TEST_BELLS_DATA[x % (sizeof(TEST_BELLS_DATA) - 1)] ^
+			          (((seed >> 16) % 97) ? 0 : 0x20);
+	}
+
+	for (offset = 0; offset < size; offset += chunk)
+	{
+		UINT32 Flags = 0;
+		BYTE* pDstData = OutputBuffer;
+		UINT32 DstSize = sizeof(OutputBuffer);
+		BYTE* pOutData = NULL;
+		UINT32 OutSize = 0;
+		BYTE* pSrcData = &data[offset];
+		/* chunks of varying size so that the encoder window moves at different offsets */
+		chunk = MIN(size - offset, 1000 + (offset * 7) % 15000);
+
+		if (ncrush_compress(ncrushSend, pSrcData, chunk, &pDstData, &DstSize, &Flags) < 0)
+			goto fail;
+
+		total += DstSize;
+
+		if (Flags & (PACKET_COMPRESSED | PACKET_AT_FRONT | PACKET_FLUSHED))
+		{
+			if (ncrush_decompress(ncrushRecv, pDstData, DstSize, &pOutData, &OutSize, Flags) < 0)
+			{
+				printf("NCrushRoundTrip: decompression failed at offset %" PRIu32 "\n", offset);
+				goto fail;
+			}
+		}
+
+		if (!(Flags & PACKET_COMPRESSED))
+		{
+			pOutData = pDstData;
+			OutSize = DstSize;
+		}
+
+		if ((OutSize != chunk) || (memcmp(pOutData, pSrcData, chunk) != 0))
+		{
+			printf("NCrushRoundTrip: level %" PRIu32 " mismatch at offset %" PRIu32 "\n",
+			       MatchLevel, offset);
+			goto fail;
+		}
+	}
+
+	printf("NCrushRoundTrip: level %" PRIu32 ": %" PRIu32 " -> %" PRIu64 " bytes\n", MatchLevel,
+	       size, total);
+	rc = TRUE;
+fail:
+	ncrush_context_free(ncrushSend);
+	ncrush_context_free(ncrushRecv);
+	free(data);
+	return rc;
+}
+
 int TestFreeRDPCodecNCrush(int argc, char* argv[])
 {
+	UINT32 level;
 	WINPR_UNUSED(argc);
 	WINPR_UNUSED(argv);
 
@@ -124,5 +204,11 @@ int TestFreeRDPCodecNCrush(int argc, char* argv[])
 	if (!test_NCrushDecompressBells())
 		return -1;
 
+	for (level = BULK_MATCH_LEVEL_LEGACY; level <= BULK_MATCH_LEVEL_BEST; level++)
+	{
+		if (!test_NCrushRoundTrip(level))
+			return -1;
+	}
+
 	return 0;
 }
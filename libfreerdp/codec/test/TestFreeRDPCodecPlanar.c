@@ -5763,6 +5763,88 @@ fail:
 	return rc;
 }
 
+static BOOL TestPlanarTiles(void)
+{
+	UINT32 x, y;
+	BOOL rc = FALSE;
+	const UINT32 width = 300;
+	const UINT32 height = 200;
+	const UINT32 step = width * 4;
+	const UINT32 tileSize = 64;
+	const UINT32 cols = (width + tileSize - 1) / tileSize;
+	const UINT32 rows = (height + tileSize - 1) / tileSize;
+	const DWORD planarFlags = PLANAR_FORMAT_HEADER_NA | PLANAR_FORMAT_HEADER_RLE;
+	BITMAP_PLANAR_CONTEXT* planar = freerdp_bitmap_planar_context_new(planarFlags, 64, 64);
+	BITMAP_PLANAR_CONTEXT* serial = freerdp_bitmap_planar_context_new(planarFlags, 64, 64);
+	BYTE* image = calloc(height, step);
+	BYTE* buffer = calloc(rows * cols, tileSize * tileSize * 4);
+	PLANAR_TILE* tiles = calloc(rows * cols, sizeof(PLANAR_TILE));
+	printf("%s: ", __FUNCTION__);
+	fflush(stdout);
+
+	if (!planar || !serial || !image || !buffer || !tiles)
+		goto fail;
+
+	/* Flat areas and noise, so that the tiles compress to different sizes */
+	for (y = 0; y < height; y++)
+	{
+		for (x = 0; x < width; x++)
+		{
+			const UINT32 color = ((x / 50) % 2)
+			                         ? prand(0xFFFFFF)
+			                         : FreeRDPGetColor(PIXEL_FORMAT_BGRX32, x, y, 0, 0xFF);
+			WriteColor(&image[y * step + x * 4], PIXEL_FORMAT_BGRX32, color);
+		}
+	}
+
+	for (x = 0; x < rows * cols; x++)
+	{
+		tiles[x].nXSrc = (x % cols) * tileSize;
+		tiles[x].nYSrc = (x / cols) * tileSize;
+		tiles[x].nWidth = MIN(tileSize, width - tiles[x].nXSrc);
+		tiles[x].nHeight = MIN(tileSize, height - tiles[x].nYSrc);
+		tiles[x].pDstData = &buffer[x * tileSize * tileSize * 4];
+		tiles[x].DstSize = tileSize * tileSize * 4;
+	}
+
+	if (!freerdp_bitmap_planar_compress_tiles(planar, image, PIXEL_FORMAT_BGRX32, step, tiles,
+	                                          rows * cols))
+		goto fail;
+
+	for (x = 0; x < rows * cols; x++)
+	{
+		BOOL equal;
+		UINT32 size = 0;
+		const BYTE* data = &image[tiles[x].nYSrc * step + tiles[x].nXSrc * 4];
+		BYTE* expected = freerdp_bitmap_compress_planar(serial, data, PIXEL_FORMAT_BGRX32,
+		                                                tiles[x].nWidth, tiles[x].nHeight, step,
+		                                                NULL, &size);
+
+		if (!expected)
+			goto fail;
+
+		equal = (size == tiles[x].DstSize) && (memcmp(expected, tiles[x].pDstData, size) == 0);
+		free(expected);
+
+		if (!equal)
+		{
+			printf("tile %" PRIu32 " differs from the serial encoding ", x);
+			goto fail;
+		}
+	}
+
+	rc = TRUE;
+fail:
+	printf("%s\n", rc ? "SUCCESS" : "FAIL");
+	fflush(stdout);
+	free(tiles);
+	free(buffer);
+	free(image);
+	freerdp_bitmap_planar_context_free(serial);
+	freerdp_bitmap_planar_context_free(planar);
+	return rc;
+}
+
 int TestFreeRDPCodecPlanar(int argc, char* argv[])
 {
 	UINT32 x;
@@ -5772,6 +5854,9 @@ int TestFreeRDPCodecPlanar(int argc, char* argv[])
 	if (!FuzzPlanar())
 		return -2;
 
+	if (!TestPlanarTiles())
+		return -3;
+
 	for (x = 0; x < colorFormatCount; x++)
 	{
 		if (!TestPlanar(colorFormatList[x]))
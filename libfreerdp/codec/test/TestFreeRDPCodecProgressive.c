@@ -1120,6 +1120,101 @@ fail:
 	return res;
 }
 
+static BOOL test_encode_decode_passes(const char* path)
+{
+	int x, y;
+	UINT32 pass;
+	BOOL res = FALSE;
+	int rc;
+	BYTE* resultData = NULL;
+	BYTE* dstData = NULL;
+	UINT32 dstSize = 0;
+	UINT32 firstSize = 0;
+	UINT32 ColorFormat = PIXEL_FORMAT_BGRX32;
+	REGION16 invalidRegion = { 0 };
+	wImage* image = winpr_image_new();
+	char* name = GetCombinedPath(path, "progressive.bmp");
+	PROGRESSIVE_CONTEXT* progressiveEnc = progressive_context_new(TRUE);
+	PROGRESSIVE_CONTEXT* progressiveDec = progressive_context_new(FALSE);
+
+	region16_init(&invalidRegion);
+	if (!image || !name || !progressiveEnc || !progressiveDec)
+		goto fail;
+
+	rc = winpr_image_read(image, name);
+	if (rc <= 0)
+		goto fail;
+
+	resultData = calloc(image->scanline, image->height);
+	if (!resultData)
+		goto fail;
+
+	rc = progressive_create_surface_context(progressiveEnc, 0, image->width, image->height);
+	if (rc <= 0)
+		goto fail;
+
+	rc = progressive_create_surface_context(progressiveDec, 0, image->width, image->height);
+	if (rc <= 0)
+		goto fail;
+
+	/* The first call sends the coarse pass, the following ones upgrade the still image */
+	for (pass = 0; pass < 8; pass++)
+	{
+		rc = progressive_compress_surface(progressiveEnc, 0, image->data,
+		                                  image->scanline * image->height, ColorFormat,
+		                                  image->width, image->height, image->scanline,
+		                                  (pass == 0) ? NULL : &invalidRegion, &dstData, &dstSize);
+		if (rc < 0)
+			goto fail;
+
+		if (dstSize == 0)
+			break;
+
+		if (pass == 0)
+			firstSize = dstSize;
+
+		rc = progressive_decompress_ex(progressiveDec, dstData, dstSize, resultData, ColorFormat,
+		                               image->scanline, 0, 0, NULL, 0, pass);
+		if (rc < 0)
+			goto fail;
+	}
+
+	/* coarse pass plus three upgrades */
+	if ((pass != 4) || (firstSize == 0))
+	{
+		printf("unexpected number of progressive passes %" PRIu32 "\n", pass);
+		goto fail;
+	}
+
+	for (y = 0; y < image->height; y++)
+	{
+		const BYTE* orig = &image->data[y * image->scanline];
+		const BYTE* dec = &resultData[y * image->scanline];
+		for (x = 0; x < image->width; x++)
+		{
+			const BYTE* po = &orig[x * 4];
+			const BYTE* pd = &dec[x * 4];
+
+			const DWORD a = ReadColor(po, ColorFormat);
+			const DWORD b = ReadColor(pd, ColorFormat);
+			if (!colordiff(ColorFormat, a, b))
+			{
+				printf("xxxxxxx [%u:%u] %08X != %08X\n", x, y, a, b);
+				goto fail;
+			}
+		}
+	}
+	res = TRUE;
+fail:
+	region16_uninit(&invalidRegion);
+	progressive_context_free(progressiveEnc);
+	progressive_context_free(progressiveDec);
+	winpr_image_free(image, TRUE);
+	free(resultData);
+	free(name);
+	return res;
+}
+
 int TestFreeRDPCodecProgressive(int argc, char* argv[])
 {
 	int rc = -1;
@@ -1151,6 +1246,8 @@ int TestFreeRDPCodecProgressive(int argc, char* argv[])
 		    */
 		if (!test_encode_decode(ms_sample_path))
 			goto fail;
+		if (!test_encode_decode_passes(ms_sample_path))
+			goto fail;
 		rc = 0;
 	}
 
@@ -843,6 +843,142 @@ static BOOL fuzzyCompareImage(const UINT32* refImage, const BYTE* img, size_t np
 	return TRUE;
 }
 
+#define SIMD_TILE_COUNT 64
+
+typedef struct
+{
+	RFX_SIMD simd;
+	const char* name;
+} RFX_SIMD_ENTRY;
+
+static const RFX_SIMD_ENTRY simdEntries[] = { { RFX_SIMD_GENERIC, "generic" },
+	                                          { RFX_SIMD_SSE2, "SSE2" },
+	                                          { RFX_SIMD_AVX2, "AVX2" },
+	                                          { RFX_SIMD_NEON, "NEON" } };
+
+/* Smooth gradients plus some noise, scaled like the output of the RGB->YCbCr step */
+static void fillSimdTiles(INT16* tiles)
+{
+	size_t t, y, x;
+	UINT32 seed = 0x12345678;
+
+	for (t = 0; t < SIMD_TILE_COUNT; t++)
+	{
+		INT16* tile = &tiles[t * 4096];
+
+		for (y = 0; y < 64; y++)
+		{
+			for (x = 0; x < 64; x++)
+			{
+				int v;
+				seed = seed * 1103515245 + 12345;
+				v = (int)((x * (t + 1) + y * 3) % 256) - 128 + (int)((seed >> 16) % 17) - 8;
+
+				if (v < -128)
+					v = -128;
+				else if (v > 127)
+					v = 127;
+
+				tile[y * 64 + x] = (INT16)(v << 5);
+			}
+		}
+	}
+}
+
+/**
+ * Runs the hooked encode kernels (DWT, quantization, RLGR) of the given instruction set over
+ * a set of tiles and checks the output against the reference.
+ */
+static BOOL test_rfx_encode_simd(const RFX_SIMD_ENTRY* entry, const INT16* tiles, INT16* coeffs,
+                                 BYTE* rlgr, const INT16* refCoeffs, const BYTE* refRlgr)
+{
+	BOOL rc = FALSE;
+	size_t t;
+	const UINT32 quantVals[] = { 6, 6, 6, 6, 7, 7, 8, 8, 8, 9 };
+	RFX_CONTEXT* context = rfx_context_new(TRUE);
+	INT16* dwt = _aligned_malloc(4096 * sizeof(INT16), 32);
+
+	if (!context || !dwt)
+		goto fail;
+
+	if (!rfx_context_set_simd(context, entry->simd))
+	{
+		printf("rfx encode %-8s: not available\n", entry->name);
+		rc = TRUE;
+		goto fail;
+	}
+
+	for (t = 0; t < SIMD_TILE_COUNT; t++)
+	{
+		BYTE* out = &rlgr[t * 8192];
+		INT16* data = &coeffs[t * 4096];
+		int size;
+
+		CopyMemory(data, &tiles[t * 4096], 4096 * sizeof(INT16));
+		context->dwt_2d_encode(data, dwt);
+		context->quantization_encode(data, quantVals);
+		size = context->rlgr_encode(RLGR3, data, 4096, out, 8192);
+
+		if (size <= 0)
+			goto fail;
+
+		if (refCoeffs && (memcmp(data, &refCoeffs[t * 4096], 4096 * sizeof(INT16)) != 0))
+		{
+			fprintf(stderr, "rfx encode %s: coefficient mismatch in tile %" PRIuz "\n",
+			        entry->name, t);
+			goto fail;
+		}
+
+		if (refRlgr && (memcmp(out, &refRlgr[t * 8192], (size_t)size) != 0))
+		{
+			fprintf(stderr, "rfx encode %s: RLGR mismatch in tile %" PRIuz "\n", entry->name,
+			        t);
+			goto fail;
+		}
+	}
+
+	rc = TRUE;
+fail:
+	_aligned_free(dwt);
+	rfx_context_free(context);
+	return rc;
+}
+
+static BOOL test_rfx_encode_simd_all(void)
+{
+	BOOL rc = FALSE;
+	size_t i;
+	INT16* tiles = calloc(SIMD_TILE_COUNT * 4096, sizeof(INT16));
+	INT16* refCoeffs = calloc(SIMD_TILE_COUNT * 4096, sizeof(INT16));
+	INT16* coeffs = calloc(SIMD_TILE_COUNT * 4096, sizeof(INT16));
+	BYTE* refRlgr = calloc(SIMD_TILE_COUNT, 8192);
+	BYTE* rlgr = calloc(SIMD_TILE_COUNT, 8192);
+
+	if (!tiles || !refCoeffs || !coeffs || !refRlgr || !rlgr)
+		goto fail;
+
+	fillSimdTiles(tiles);
+
+	/* The generic routines produce the reference output */
+	if (!test_rfx_encode_simd(&simdEntries[0], tiles, refCoeffs, refRlgr, NULL, NULL))
+		goto fail;
+
+	for (i = 1; i < ARRAYSIZE(simdEntries); i++)
+	{
+		if (!test_rfx_encode_simd(&simdEntries[i], tiles, coeffs, rlgr, refCoeffs, refRlgr))
+			goto fail;
+	}
+
+	rc = TRUE;
+fail:
+	free(tiles);
+	free(refCoeffs);
+	free(coeffs);
+	free(refRlgr);
+	free(rlgr);
+	return rc;
+}
+
 int TestFreeRDPCodecRemoteFX(int argc, char* argv[])
 {
 	int rc = -1;
@@ -851,6 +987,9 @@ int TestFreeRDPCodecRemoteFX(int argc, char* argv[])
 	BYTE* dest = NULL;
 	size_t stride = FORMAT_SIZE * IMG_WIDTH;
 
+	if (!test_rfx_encode_simd_all())
+		goto fail;
+
 	context = rfx_context_new(FALSE);
 	if (!context)
 		goto fail;
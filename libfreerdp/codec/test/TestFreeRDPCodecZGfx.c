@@ -252,6 +252,84 @@ fail:
 	return rc;
 }
 
+static void test_ZGfxFillPdu(BYTE* data, UINT32 size, UINT32 seed)
+{
+	UINT32 x;
+
+	/* A mix of repeated tiles, runs and noise, similar to graphics pipeline traffic */
+	for (x = 0; x < size; x++)
+	{
+		seed = seed * 1103515245 + 12345;
+
+		if ((x / 4096) % 3 == 0)
+			data[x] = (BYTE)((x % 64) ^ (x / 4096));
+		else if ((x / 4096) % 3 == 1)
+			data[x] = 0xFF;
+		else
+			data[x] = (BYTE)(seed >> 16);
+	}
+}
+
+static int test_ZGfxCompressHistory(void)
+{
+	int rc = -1;
+	UINT32 x;
+	UINT64 compressed = 0;
+	UINT64 uncompressed = 0;
+	BYTE* pSrcData = NULL;
+	ZGFX_CONTEXT* compressor = zgfx_context_new(TRUE);
+	ZGFX_CONTEXT* decompressor = zgfx_context_new(FALSE);
+	const UINT32 maxSize = 200000;
+
+	pSrcData = malloc(maxSize);
+
+	if (!compressor || !decompressor || !pSrcData)
+		goto fail;
+
+	/* Enough PDUs to slide the compressor window several times, the level changes
+	 * while the history is in use. */
+	for (x = 0; x < 64; x++)
+	{
+		int status;
+		UINT32 Flags = 0;
+		UINT32 DstSize = 0;
+		UINT32 OutSize = 0;
+		BYTE* pDstData = NULL;
+		BYTE* pOutData = NULL;
+		const UINT32 SrcSize = 1 + (x * 7919) % maxSize;
+
+		/* Every fourth PDU repeats an older one to produce far matches */
+		test_ZGfxFillPdu(pSrcData, SrcSize, (x % 4 == 3) ? x / 2 : x);
+		zgfx_context_set_compression_level(compressor, (x / 8) % 10);
+		status = zgfx_compress(compressor, pSrcData, SrcSize, &pDstData, &DstSize, &Flags);
+
+		if (status >= 0)
+			status = zgfx_decompress(decompressor, pDstData, DstSize, &pOutData, &OutSize, 0);
+
+		if ((status < 0) || (OutSize != SrcSize) || (memcmp(pOutData, pSrcData, SrcSize) != 0))
+		{
+			printf("test_ZGfxCompressHistory: round trip of PDU %" PRIu32 " failed\n", x);
+			free(pDstData);
+			free(pOutData);
+			goto fail;
+		}
+
+		compressed += DstSize;
+		uncompressed += SrcSize;
+		free(pDstData);
+		free(pOutData);
+	}
+
+	printf("test_ZGfxCompressHistory: %" PRIu64 " -> %" PRIu64 " bytes\n", uncompressed,
+	       compressed);
+	rc = 0;
+fail:
+	free(pSrcData);
+	zgfx_context_free(compressor);
+	zgfx_context_free(decompressor);
+	return rc;
+}
+
 int TestFreeRDPCodecZGfx(int argc, char* argv[])
 {
 	WINPR_UNUSED(argc);
@@ -269,5 +347,8 @@ int TestFreeRDPCodecZGfx(int argc, char* argv[])
 	if (test_ZGfxCompressConsistent() < 0)
 		return -1;
 
+	if (test_ZGfxCompressHistory() < 0)
+		return -1;
+
 	return 0;
 }
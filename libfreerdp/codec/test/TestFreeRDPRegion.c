@@ -814,6 +814,159 @@ out:
 	return retCode;
 }
 
+#define BATCH_SIZE 64
+
+static void regionCoverage(const REGION16* region, BYTE* map)
+{
+	UINT32 i, nbRects;
+	UINT16 x, y;
+	const RECTANGLE_16* rects = region16_rects(region, &nbRects);
+	ZeroMemory(map, BATCH_SIZE * BATCH_SIZE);
+
+	for (i = 0; i < nbRects; i++)
+	{
+		for (y = rects[i].top; y < rects[i].bottom; y++)
+			for (x = rects[i].left; x < rects[i].right; x++)
+				map[y * BATCH_SIZE + x]++;
+	}
+}
+
+static BOOL regionIsBanded(const REGION16* region)
+{
+	UINT32 i, nbRects;
+	const RECTANGLE_16* rects = region16_rects(region, &nbRects);
+
+	for (i = 1; i < nbRects; i++)
+	{
+		const RECTANGLE_16* prev = &rects[i - 1];
+		const RECTANGLE_16* cur = &rects[i];
+
+		if (cur->top == prev->top)
+		{
+			/* same band: same bottom, sorted and not touching */
+			if ((cur->bottom != prev->bottom) || (cur->left <= prev->right))
+				return FALSE;
+		}
+		else if (cur->top < prev->bottom)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static int test_union_rects(void)
+{
+	REGION16 region, batch;
+	int retCode = -1;
+	UINT32 i, round;
+	UINT32 seed = 1;
+	RECTANGLE_16 rects[40];
+	BYTE expected[BATCH_SIZE * BATCH_SIZE];
+	BYTE map[BATCH_SIZE * BATCH_SIZE];
+	RECTANGLE_16 r2_r1[] = { { 150, 301, 250, 401 }, { 0, 101, 200, 201 } };
+	RECTANGLE_16 r1_r2[] = { { 0, 101, 200, 201 }, { 150, 301, 250, 401 } };
+	RECTANGLE_16 touching[] = { { 10, 0, 20, 10 }, { 0, 0, 10, 10 }, { 0, 10, 20, 20 } };
+	RECTANGLE_16 touchingResult = { 0, 0, 20, 20 };
+	const RECTANGLE_16* result;
+	UINT32 nbRects;
+	region16_init(&region);
+	region16_init(&batch);
+
+	/* disjoint rectangles, given out of order */
+	if (!region16_union_rects(&batch, &batch, r2_r1, 2))
+		goto out;
+
+	result = region16_rects(&batch, &nbRects);
+
+	if ((nbRects != 2) || !compareRectangles(result, r1_r2, nbRects))
+		goto out;
+
+	/* touching rectangles end up as a single one */
+	if (!region16_union_rects(&batch, &region, touching, 3))
+		goto out;
+
+	result = region16_rects(&batch, &nbRects);
+
+	if ((nbRects != 1) || !compareRectangles(result, &touchingResult, 1) ||
+	    !compareRectangles(region16_extents(&batch), &touchingResult, 1))
+		goto out;
+
+	/* nothing to add */
+	if (!region16_union_rects(&region, &batch, NULL, 0))
+		goto out;
+
+	result = region16_rects(&region, &nbRects);
+
+	if ((nbRects != 1) || !compareRectangles(result, &touchingResult, 1))
+		goto out;
+
+	/* the same area as adding the rectangles one by one */
+	for (round = 0; round < 200; round++)
+	{
+		const UINT32 count = 1 + round % 40;
+		region16_clear(&region);
+		region16_clear(&batch);
+
+		for (i = 0; i < count; i++)
+		{
+			UINT16 v[4];
+			UINT32 j;
+
+			for (j = 0; j < 4; j++)
+			{
+				seed = seed * 1103515245 + 12345;
+				v[j] = (seed >> 16) % (BATCH_SIZE + 1);
+			}
+
+			rects[i].left = MIN(v[0], v[1]);
+			rects[i].right = MAX(v[0], v[1]);
+			rects[i].top = MIN(v[2], v[3]);
+			rects[i].bottom = MAX(v[2], v[3]);
+
+			/* region16_union_rect grows the extents even for empty rectangles */
+			if (rectangle_is_empty(&rects[i]))
+				continue;
+
+			if (!region16_union_rect(&region, &region, &rects[i]))
+				goto out;
+		}
+
+		/* half of the rectangles merged into a region that has the other half */
+		if (!region16_union_rects(&batch, &batch, rects, count / 2) ||
+		    !region16_union_rects(&batch, &batch, &rects[count / 2], count - count / 2))
+			goto out;
+
+		regionCoverage(&region, expected);
+		regionCoverage(&batch, map);
+
+		for (i = 0; i < BATCH_SIZE * BATCH_SIZE; i++)
+		{
+			if ((expected[i] > 0) != (map[i] > 0) || (map[i] > 1))
+			{
+				fprintf(stderr, "round %" PRIu32 ": coverage differs at %" PRIu32 "\n", round,
+				        i);
+				goto out;
+			}
+		}
+
+		if (!regionIsBanded(&batch))
+		{
+			fprintf(stderr, "round %" PRIu32 ": result is not banded\n", round);
+			goto out;
+		}
+
+		if (!region16_is_empty(&batch) &&
+		    !compareRectangles(region16_extents(&batch), region16_extents(&region), 1))
+			goto out;
+	}
+
+	retCode = 0;
+out:
+	region16_uninit(&batch);
+	region16_uninit(&region);
+	return retCode;
+}
+
 typedef int (*TestFunction)(void);
 struct UnitaryTest
 {
@@ -835,6 +988,7 @@ static struct UnitaryTest tests[] = { { "Basic trivial tests", test_basic },
 	                                  { "norbert's case", test_norbert_case },
 	                                  { "norbert's case 2", test_norbert2_case },
 	                                  { "empty rectangle case", test_empty_rectangle },
+	                                  { "batched union", test_union_rects },
 
 	                                  { NULL, NULL } };
 
@@ -52,6 +52,39 @@ struct _ZGFX_TOKEN
 };
 typedef struct _ZGFX_TOKEN ZGFX_TOKEN;
 
+#define ZGFX_MIN_MATCH 3
+#define ZGFX_MAX_DISTANCE (2500000 - 1)
+
+/* Bytes added to the compressor window before it slides back to ZGFX_MAX_DISTANCE */
+#define ZGFX_WINDOW_SLACK (1 << 20)
+#define ZGFX_WINDOW_SIZE (ZGFX_MAX_DISTANCE + ZGFX_WINDOW_SLACK)
+
+#define ZGFX_HASH_BITS 16
+#define ZGFX_HASH_SIZE (1 << ZGFX_HASH_BITS)
+
+#define ZGFX_DEFAULT_COMPRESSION_LEVEL 4
+
+struct _ZGFX_LEVEL
+{
+	UINT32 maxChain;
+	UINT32 niceLength;
+	BOOL lazy;
+};
+typedef struct _ZGFX_LEVEL ZGFX_LEVEL;
+
+static const ZGFX_LEVEL ZGFX_LEVELS[] = {
+	{ 0, 0, FALSE },        /* 0: store */
+	{ 4, 16, FALSE },       /* 1 */
+	{ 8, 32, FALSE },       /* 2 */
+	{ 16, 64, FALSE },      /* 3 */
+	{ 32, 128, TRUE },      /* 4 */
+	{ 64, 256, TRUE },      /* 5 */
+	{ 128, 512, TRUE },     /* 6 */
+	{ 256, 1024, TRUE },    /* 7 */
+	{ 1024, 4096, TRUE },   /* 8 */
+	{ 4096, 65535, TRUE },  /* 9 */
+};
+
 struct _ZGFX_CONTEXT
 {
 	BOOL Compressor;
@@ -70,8 +103,30 @@ struct _ZGFX_CONTEXT
 	BYTE HistoryBuffer[2500000];
 	UINT32 HistoryIndex;
 	UINT32 HistoryBufferSize;
+
+	/* Compressor state, allocated on first use. Positions in HashHead and HashPrev are
+	 * stored plus one so zero marks an empty chain. */
+	UINT32 CompressionLevel;
+	BYTE* Window;
+	UINT32 WindowEnd;
+	UINT32 WindowHashed;
+	UINT32* HashHead;
+	UINT32* HashPrev;
+	UINT32 LiteralCode[256];
+	UINT32 LiteralBits[256];
 };
 
+struct _ZGFX_BIT_WRITER
+{
+	BYTE* data;
+	size_t length;
+	size_t capacity;
+	UINT64 accumulator;
+	UINT32 count;
+	BOOL overflow;
+};
+typedef struct _ZGFX_BIT_WRITER ZGFX_BIT_WRITER;
+
 static const ZGFX_TOKEN ZGFX_TOKEN_TABLE[] = {
 	// len code vbits type  vbase
 	{ 1, 0, 8, 0, 0 },           // 0
@@ -463,10 +518,305 @@ fail:
 	return status;
 }
 
+static INLINE void zgfx_write_bits(ZGFX_BIT_WRITER* writer, UINT32 value, UINT32 nbits)
+{
+	writer->accumulator = (writer->accumulator << nbits) | (value & ((1ULL << nbits) - 1));
+	writer->count += nbits;
+
+	while (writer->count >= 8)
+	{
+		writer->count -= 8;
+
+		if (writer->length >= writer->capacity)
+		{
+			writer->overflow = TRUE;
+			return;
+		}
+
+		writer->data[writer->length++] = (BYTE)(writer->accumulator >> writer->count);
+	}
+}
+
+static void zgfx_write_literal(ZGFX_CONTEXT* zgfx, ZGFX_BIT_WRITER* writer, BYTE c)
+{
+	zgfx_write_bits(writer, zgfx->LiteralCode[c], zgfx->LiteralBits[c]);
+}
+
+static const ZGFX_TOKEN* zgfx_distance_token(UINT32 distance)
+{
+	const ZGFX_TOKEN* token;
+	const ZGFX_TOKEN* found = NULL;
+
+	for (token = ZGFX_TOKEN_TABLE; token->prefixLength != 0; token++)
+	{
+		if ((token->tokenType == 1) && (token->valueBase <= distance) &&
+		    (distance - token->valueBase < (1UL << token->valueBits)))
+		{
+			found = token;
+			break;
+		}
+	}
+
+	return found;
+}
+
+static UINT32 zgfx_count_bits(UINT32 count)
+{
+	UINT32 extra = 2;
+
+	if (count == 3)
+		return 1;
+
+	while ((count >> (extra + 1)) != 0)
+		extra++;
+
+	return extra + extra;
+}
+
+static UINT32 zgfx_match_bits(UINT32 distance, UINT32 count)
+{
+	const ZGFX_TOKEN* token = zgfx_distance_token(distance);
+	return token->prefixLength + token->valueBits + zgfx_count_bits(count);
+}
+
+static void zgfx_write_match(ZGFX_BIT_WRITER* writer, UINT32 distance, UINT32 count)
+{
+	const ZGFX_TOKEN* token = zgfx_distance_token(distance);
+	zgfx_write_bits(writer, token->prefixCode, token->prefixLength);
+	zgfx_write_bits(writer, distance - token->valueBase, token->valueBits);
+
+	if (count == 3)
+		zgfx_write_bits(writer, 0, 1);
+	else
+	{
+		/* count = 2^extra + value, announced by (extra - 1) one bits and a zero bit */
+		UINT32 extra = 2;
+
+		while ((count >> (extra + 1)) != 0)
+			extra++;
+
+		zgfx_write_bits(writer, (1UL << (extra - 1)) - 1, extra - 1);
+		zgfx_write_bits(writer, 0, 1);
+		zgfx_write_bits(writer, count - (1UL << extra), extra);
+	}
+}
+
+static BOOL zgfx_compressor_init(ZGFX_CONTEXT* zgfx)
+{
+	size_t x;
+	const ZGFX_TOKEN* token;
+
+	if (zgfx->Window)
+		return TRUE;
+
+	zgfx->Window = (BYTE*)malloc(ZGFX_WINDOW_SIZE);
+	zgfx->HashHead = (UINT32*)calloc(ZGFX_HASH_SIZE, sizeof(UINT32));
+	zgfx->HashPrev = (UINT32*)calloc(ZGFX_WINDOW_SIZE, sizeof(UINT32));
+
+	if (!zgfx->Window || !zgfx->HashHead || !zgfx->HashPrev)
+	{
+		free(zgfx->Window);
+		free(zgfx->HashHead);
+		free(zgfx->HashPrev);
+		zgfx->Window = NULL;
+		zgfx->HashHead = NULL;
+		zgfx->HashPrev = NULL;
+		return FALSE;
+	}
+
+	/* The generic literal token is a '0' prefix followed by the byte, some bytes have
+	 * shorter dedicated tokens. */
+	for (x = 0; x < 256; x++)
+	{
+		zgfx->LiteralCode[x] = (UINT32)x;
+		zgfx->LiteralBits[x] = 9;
+	}
+
+	for (token = ZGFX_TOKEN_TABLE; token->prefixLength != 0; token++)
+	{
+		if ((token->tokenType == 0) && (token->valueBits == 0) &&
+		    (token->prefixLength < zgfx->LiteralBits[token->valueBase]))
+		{
+			zgfx->LiteralCode[token->valueBase] = token->prefixCode;
+			zgfx->LiteralBits[token->valueBase] = token->prefixLength;
+		}
+	}
+
+	zgfx->WindowEnd = 0;
+	zgfx->WindowHashed = 0;
+	return TRUE;
+}
+
+static void zgfx_compressor_reset(ZGFX_CONTEXT* zgfx)
+{
+	zgfx->WindowEnd = 0;
+	zgfx->WindowHashed = 0;
+
+	if (zgfx->HashHead)
+		ZeroMemory(zgfx->HashHead, ZGFX_HASH_SIZE * sizeof(UINT32));
+}
+
+static INLINE UINT32 zgfx_hash(const BYTE* p)
+{
+	const UINT32 v = ((UINT32)p[0] << 16) | ((UINT32)p[1] << 8) | p[2];
+	return (UINT32)(v * 2654435761U) >> (32 - ZGFX_HASH_BITS);
+}
+
+static INLINE UINT32 zgfx_slide_position(UINT32 position, UINT32 shift)
+{
+	return (position > shift) ? position - shift : 0;
+}
+
+/* Drops everything older than the maximum match distance to make room for the next segment */
+static void zgfx_window_slide(ZGFX_CONTEXT* zgfx)
+{
+	size_t x;
+	const UINT32 keep = MIN(zgfx->WindowEnd, ZGFX_MAX_DISTANCE);
+	const UINT32 shift = zgfx->WindowEnd - keep;
+
+	MoveMemory(zgfx->Window, &zgfx->Window[shift], keep);
+	MoveMemory(zgfx->HashPrev, &zgfx->HashPrev[shift], keep * sizeof(UINT32));
+
+	for (x = 0; x < keep; x++)
+		zgfx->HashPrev[x] = zgfx_slide_position(zgfx->HashPrev[x], shift);
+
+	for (x = 0; x < ZGFX_HASH_SIZE; x++)
+		zgfx->HashHead[x] = zgfx_slide_position(zgfx->HashHead[x], shift);
+
+	zgfx->WindowEnd = keep;
+	zgfx->WindowHashed -= shift;
+}
+
+/* Adds the positions before end to the hash chains, as far as three bytes are available */
+static INLINE void zgfx_window_hash(ZGFX_CONTEXT* zgfx, UINT32 end)
+{
+	UINT32 position;
+
+	for (position = zgfx->WindowHashed;
+	     (position < end) && (position + ZGFX_MIN_MATCH <= zgfx->WindowEnd); position++)
+	{
+		const UINT32 hash = zgfx_hash(&zgfx->Window[position]);
+		zgfx->HashPrev[position] = zgfx->HashHead[hash];
+		zgfx->HashHead[hash] = position + 1;
+	}
+
+	zgfx->WindowHashed = position;
+}
+
+static UINT32 zgfx_find_match(ZGFX_CONTEXT* zgfx, UINT32 position, UINT32 end,
+                              UINT32* pDistance)
+{
+	const ZGFX_LEVEL* level = &ZGFX_LEVELS[zgfx->CompressionLevel];
+	const BYTE* current = &zgfx->Window[position];
+	const UINT32 maxLength = end - position;
+	UINT32 chain = level->maxChain;
+	UINT32 bestLength = 0;
+	UINT32 candidate;
+
+	if (maxLength < ZGFX_MIN_MATCH)
+		return 0;
+
+	zgfx_window_hash(zgfx, position);
+	candidate = zgfx->HashHead[zgfx_hash(current)];
+
+	while ((candidate != 0) && (chain-- > 0))
+	{
+		const UINT32 match = candidate - 1;
+		const UINT32 distance = position - match;
+		const BYTE* previous = &zgfx->Window[match];
+		UINT32 length = 0;
+
+		if (distance > ZGFX_MAX_DISTANCE)
+			break;
+
+		if ((previous[bestLength] == current[bestLength]) && (previous[0] == current[0]))
+		{
+			while ((length < maxLength) && (previous[length] == current[length]))
+				length++;
+
+			if (length > bestLength)
+			{
+				bestLength = length;
+				*pDistance = distance;
+
+				if ((length >= level->niceLength) || (length == maxLength))
+					break;
+			}
+		}
+
+		candidate = zgfx->HashPrev[match];
+	}
+
+	if (bestLength < ZGFX_MIN_MATCH)
+		return 0;
+
+	return bestLength;
+}
+
+/* A match is only used if its token is shorter than the literals it replaces */
+static BOOL zgfx_match_worthwhile(ZGFX_CONTEXT* zgfx, UINT32 position, UINT32 distance,
+                                  UINT32 length)
+{
+	UINT32 x;
+	UINT32 literalBits = 0;
+
+	/* Even the shortest literal tokens make eight bytes more expensive than any match */
+	if (length >= 8)
+		return TRUE;
+
+	for (x = 0; x < length; x++)
+		literalBits += zgfx->LiteralBits[zgfx->Window[position + x]];
+
+	return zgfx_match_bits(distance, length) < literalBits;
+}
+
+static BOOL zgfx_compress_window(ZGFX_CONTEXT* zgfx, ZGFX_BIT_WRITER* writer, UINT32 start,
+                                 UINT32 end)
+{
+	UINT32 position = start;
+	const BOOL lazy = ZGFX_LEVELS[zgfx->CompressionLevel].lazy;
+
+	while ((position < end) && !writer->overflow)
+	{
+		UINT32 distance = 0;
+		UINT32 length = zgfx_find_match(zgfx, position, end, &distance);
+
+		if ((length > 0) && !zgfx_match_worthwhile(zgfx, position, distance, length))
+			length = 0;
+
+		/* Emit a literal if the match starting at the next byte is longer */
+		if ((length > 0) && lazy && (position + 1 < end))
+		{
+			UINT32 nextDistance = 0;
+			const UINT32 nextLength = zgfx_find_match(zgfx, position + 1, end, &nextDistance);
+
+			if ((nextLength > length) &&
+			    zgfx_match_worthwhile(zgfx, position + 1, nextDistance, nextLength))
+				length = 0;
+		}
+
+		if (length == 0)
+		{
+			zgfx_write_literal(zgfx, writer, zgfx->Window[position]);
+			position++;
+		}
+		else
+		{
+			zgfx_write_match(writer, distance, length);
+			position += length;
+		}
+	}
+
+	return !writer->overflow;
+}
+
 static BOOL zgfx_compress_segment(ZGFX_CONTEXT* zgfx, wStream* s, const BYTE* pSrcData,
                                   UINT32 SrcSize, UINT32* pFlags)
 {
-	/* FIXME: Currently compression not implemented. Just copy the raw source */
+	UINT32 start;
+	size_t position;
+	ZGFX_BIT_WRITER writer = { 0 };
+
 	if (!Stream_EnsureRemainingCapacity(s, SrcSize + 1))
 	{
 		WLog_ERR(TAG, "Stream_EnsureRemainingCapacity failed!");
@@ -474,7 +824,47 @@ static BOOL zgfx_compress_segment(ZGFX_CONTEXT* zgfx, wStream* s, const BYTE* pS
 	}
 
 	(*pFlags) |= ZGFX_PACKET_COMPR_TYPE_RDP8; /* RDP 8.0 compression format */
-	Stream_Write_UINT8(s, (*pFlags));         /* header (1 byte) */
+	position = Stream_GetPosition(s);
+
+	/* Matches must not reach back across segments the compressor did not see */
+	if ((zgfx->CompressionLevel == 0) && (zgfx->WindowEnd > 0))
+		zgfx_compressor_reset(zgfx);
+
+	if ((zgfx->CompressionLevel > 0) && (SrcSize > 0) && zgfx_compressor_init(zgfx))
+	{
+		/* Every segment enters the decoder history, compressed or not */
+		if (zgfx->WindowEnd + SrcSize > ZGFX_WINDOW_SIZE)
+			zgfx_window_slide(zgfx);
+
+		start = zgfx->WindowEnd;
+		CopyMemory(&zgfx->Window[start], pSrcData, SrcSize);
+		zgfx->WindowEnd += SrcSize;
+
+		/* The compressed segment must stay smaller than the raw one, including the
+		 * trailing padding byte. */
+		writer.data = Stream_Pointer(s) + 1;
+		writer.capacity = SrcSize - 1;
+
+		if (zgfx_compress_window(zgfx, &writer, start, zgfx->WindowEnd))
+		{
+			const UINT32 padding = (8 - writer.count) % 8;
+
+			if (padding)
+				zgfx_write_bits(&writer, 0, padding);
+
+			if (!writer.overflow && (writer.length < writer.capacity))
+			{
+				writer.data[writer.length++] = (BYTE)padding;
+				Stream_Write_UINT8(s, (*pFlags) | PACKET_COMPRESSED); /* header (1 byte) */
+				Stream_Seek(s, writer.length);
+				return TRUE;
+			}
+		}
+
+		Stream_SetPosition(s, position);
+	}
+
+	Stream_Write_UINT8(s, (*pFlags)); /* header (1 byte) */
 	Stream_Write(s, pSrcData, SrcSize);
 	return TRUE;
 }
@@ -576,6 +966,16 @@ int zgfx_compress(ZGFX_CONTEXT* zgfx, const BYTE* pSrcData, UINT32 SrcSize, BYTE
 void zgfx_context_reset(ZGFX_CONTEXT* zgfx, BOOL flush)
 {
 	zgfx->HistoryIndex = 0;
+	zgfx_compressor_reset(zgfx);
+}
+
+BOOL zgfx_context_set_compression_level(ZGFX_CONTEXT* zgfx, UINT32 level)
+{
+	if (!zgfx || (level >= ARRAYSIZE(ZGFX_LEVELS)))
+		return FALSE;
+
+	zgfx->CompressionLevel = level;
+	return TRUE;
 }
 
 ZGFX_CONTEXT* zgfx_context_new(BOOL Compressor)
@@ -586,6 +986,7 @@ ZGFX_CONTEXT* zgfx_context_new(BOOL Compressor)
 	if (zgfx)
 	{
 		zgfx->Compressor = Compressor;
+		zgfx->CompressionLevel = ZGFX_DEFAULT_COMPRESSION_LEVEL;
 		zgfx->HistoryBufferSize = sizeof(zgfx->HistoryBuffer);
 		zgfx_context_reset(zgfx, FALSE);
 	}
@@ -595,5 +996,11 @@ ZGFX_CONTEXT* zgfx_context_new(BOOL Compressor)
 
 void zgfx_context_free(ZGFX_CONTEXT* zgfx)
 {
+	if (!zgfx)
+		return;
+
+	free(zgfx->Window);
+	free(zgfx->HashHead);
+	free(zgfx->HashPrev);
 	free(zgfx);
 }
@@ -33,6 +33,9 @@ BOOL freerdp_settings_get_bool(const rdpSettings* settings, size_t id)
 		case FreeRDP_AsyncInput:
 			return settings->AsyncInput;
 
+		case FreeRDP_AsyncTransport:
+			return settings->AsyncTransport;
+
 		case FreeRDP_AsyncUpdate:
 			return settings->AsyncUpdate;
 
@@ -545,6 +548,10 @@ BOOL freerdp_settings_set_bool(rdpSettings* settings, size_t id, BOOL val)
 			settings->AsyncInput = val;
 			break;
 
+		case FreeRDP_AsyncTransport:
+			settings->AsyncTransport = val;
+			break;
+
 		case FreeRDP_AsyncUpdate:
 			settings->AsyncUpdate = val;
 			break;
@@ -2183,6 +2190,9 @@ const char* freerdp_settings_get_string(const rdpSettings* settings, size_t id)
 		case FreeRDP_AuthenticationServiceClass:
 			return settings->AuthenticationServiceClass;
 
+		case FreeRDP_BitmapCachePersistFile:
+			return settings->BitmapCachePersistFile;
+
 		case FreeRDP_CertificateAcceptedFingerprints:
 			return settings->CertificateAcceptedFingerprints;
 
@@ -2228,6 +2238,9 @@ const char* freerdp_settings_get_string(const rdpSettings* settings, size_t id)
 		case FreeRDP_DumpRemoteFxFile:
 			return settings->DumpRemoteFxFile;
 
+		case FreeRDP_DumpSessionFile:
+			return settings->DumpSessionFile;
+
 		case FreeRDP_DynamicDSTTimeZoneKeyName:
 			return settings->DynamicDSTTimeZoneKeyName;
 
@@ -2249,6 +2262,9 @@ const char* freerdp_settings_get_string(const rdpSettings* settings, size_t id)
 		case FreeRDP_GatewayUsername:
 			return settings->GatewayUsername;
 
+		case FreeRDP_GfxCachePersistFile:
+			return settings->GfxCachePersistFile;
+
 		case FreeRDP_HomePath:
 			return settings->HomePath;
 
@@ -2412,6 +2428,12 @@ BOOL freerdp_settings_set_string_(rdpSettings* settings, size_t id, const char*
 			settings->AuthenticationServiceClass = (val ? _strdup(val) : NULL);
 			return (!val || settings->AuthenticationServiceClass != NULL);
 
+		case FreeRDP_BitmapCachePersistFile:
+			if (cleanup)
+				free(settings->BitmapCachePersistFile);
+			settings->BitmapCachePersistFile = (val ? _strdup(val) : NULL);
+			return (!val || settings->BitmapCachePersistFile != NULL);
+
 		case FreeRDP_CertificateAcceptedFingerprints:
 			if (cleanup)
 				free(settings->CertificateAcceptedFingerprints);
@@ -2502,6 +2524,12 @@ BOOL freerdp_settings_set_string_(rdpSettings* settings, size_t id, const char*
 			settings->DumpRemoteFxFile = (val ? _strdup(val) : NULL);
 			return (!val || settings->DumpRemoteFxFile != NULL);
 
+		case FreeRDP_DumpSessionFile:
+			if (cleanup)
+				free(settings->DumpSessionFile);
+			settings->DumpSessionFile = (val ? _strdup(val) : NULL);
+			return (!val || settings->DumpSessionFile != NULL);
+
 		case FreeRDP_DynamicDSTTimeZoneKeyName:
 			if (cleanup)
 				free(settings->DynamicDSTTimeZoneKeyName);
@@ -2544,6 +2572,12 @@ BOOL freerdp_settings_set_string_(rdpSettings* settings, size_t id, const char*
 			settings->GatewayUsername = (val ? _strdup(val) : NULL);
 			return (!val || settings->GatewayUsername != NULL);
 
+		case FreeRDP_GfxCachePersistFile:
+			if (cleanup)
+				free(settings->GfxCachePersistFile);
+			settings->GfxCachePersistFile = (val ? _strdup(val) : NULL);
+			return (!val || settings->GfxCachePersistFile != NULL);
+
 		case FreeRDP_HomePath:
 			if (cleanup)
 				free(settings->HomePath);
@@ -21,6 +21,7 @@ static const struct settings_str_entry settings_map[] = {
 	{ FreeRDP_AltSecFrameMarkerSupport, 0, "FreeRDP_AltSecFrameMarkerSupport" },
 	{ FreeRDP_AsyncChannels, 0, "FreeRDP_AsyncChannels" },
 	{ FreeRDP_AsyncInput, 0, "FreeRDP_AsyncInput" },
+	{ FreeRDP_AsyncTransport, 0, "FreeRDP_AsyncTransport" },
 	{ FreeRDP_AsyncUpdate, 0, "FreeRDP_AsyncUpdate" },
 	{ FreeRDP_AudioCapture, 0, "FreeRDP_AudioCapture" },
 	{ FreeRDP_AudioPlayback, 0, "FreeRDP_AudioPlayback" },
@@ -300,6 +301,7 @@ static const struct settings_str_entry settings_map[] = {
 	{ FreeRDP_AlternateShell, 7, "FreeRDP_AlternateShell" },
 	{ FreeRDP_AssistanceFile, 7, "FreeRDP_AssistanceFile" },
 	{ FreeRDP_AuthenticationServiceClass, 7, "FreeRDP_AuthenticationServiceClass" },
+	{ FreeRDP_BitmapCachePersistFile, 7, "FreeRDP_BitmapCachePersistFile" },
 	{ FreeRDP_CertificateAcceptedFingerprints, 7, "FreeRDP_CertificateAcceptedFingerprints" },
 	{ FreeRDP_CertificateContent, 7, "FreeRDP_CertificateContent" },
 	{ FreeRDP_CertificateFile, 7, "FreeRDP_CertificateFile" },
@@ -315,6 +317,7 @@ static const struct settings_str_entry settings_map[] = {
 	{ FreeRDP_Domain, 7, "FreeRDP_Domain" },
 	{ FreeRDP_DrivesToRedirect, 7, "FreeRDP_DrivesToRedirect" },
 	{ FreeRDP_DumpRemoteFxFile, 7, "FreeRDP_DumpRemoteFxFile" },
+	{ FreeRDP_DumpSessionFile, 7, "FreeRDP_DumpSessionFile" },
 	{ FreeRDP_DynamicDSTTimeZoneKeyName, 7, "FreeRDP_DynamicDSTTimeZoneKeyName" },
 	{ FreeRDP_GatewayAcceptedCert, 7, "FreeRDP_GatewayAcceptedCert" },
 	{ FreeRDP_GatewayAccessToken, 7, "FreeRDP_GatewayAccessToken" },
@@ -322,6 +325,7 @@ static const struct settings_str_entry settings_map[] = {
 	{ FreeRDP_GatewayHostname, 7, "FreeRDP_GatewayHostname" },
 	{ FreeRDP_GatewayPassword, 7, "FreeRDP_GatewayPassword" },
 	{ FreeRDP_GatewayUsername, 7, "FreeRDP_GatewayUsername" },
+	{ FreeRDP_GfxCachePersistFile, 7, "FreeRDP_GfxCachePersistFile" },
 	{ FreeRDP_HomePath, 7, "FreeRDP_HomePath" },
 	{ FreeRDP_ImeFileName, 7, "FreeRDP_ImeFileName" },
 	{ FreeRDP_KerberosKdc, 7, "FreeRDP_KerberosKdc" },
@@ -24,6 +24,8 @@
 #include "activation.h"
 #include "display.h"
 
+#include "../cache/bitmap.h"
+
 #define TAG FREERDP_TAG("core.activation")
 
 /*
@@ -207,38 +209,103 @@ static BOOL rdp_write_persistent_list_entry(wStream* s, UINT32 key1, UINT32 key2
 	return TRUE;
 }
 
-static BOOL rdp_write_client_persistent_key_list_pdu(wStream* s, const rdpSettings* settings)
+/* [MS-RDPBCGR] 2.2.1.17.1: at most 169 keys may be sent in a single PDU */
+#define PERSIST_MAX_ENTRIES_PER_PDU 169
+
+static BOOL rdp_write_client_persistent_key_list_pdu(wStream* s, const UINT32 numEntries[5],
+                                                     const UINT32 totalEntries[5], BYTE flags,
+                                                     const UINT64* keys, size_t count)
 {
+	size_t x;
+
 	if (Stream_GetRemainingCapacity(s) < 24)
 		return FALSE;
-	Stream_Write_UINT16(s, 0);                                   /* numEntriesCache0 (2 bytes) */
-	Stream_Write_UINT16(s, 0);                                   /* numEntriesCache1 (2 bytes) */
-	Stream_Write_UINT16(s, 0);                                   /* numEntriesCache2 (2 bytes) */
-	Stream_Write_UINT16(s, 0);                                   /* numEntriesCache3 (2 bytes) */
-	Stream_Write_UINT16(s, 0);                                   /* numEntriesCache4 (2 bytes) */
-	Stream_Write_UINT16(s, 0);                                   /* totalEntriesCache0 (2 bytes) */
-	Stream_Write_UINT16(s, 0);                                   /* totalEntriesCache1 (2 bytes) */
-	Stream_Write_UINT16(s, 0);                                   /* totalEntriesCache2 (2 bytes) */
-	Stream_Write_UINT16(s, 0);                                   /* totalEntriesCache3 (2 bytes) */
-	Stream_Write_UINT16(s, 0);                                   /* totalEntriesCache4 (2 bytes) */
-	Stream_Write_UINT8(s, PERSIST_FIRST_PDU | PERSIST_LAST_PDU); /* bBitMask (1 byte) */
-	Stream_Write_UINT8(s, 0);                                    /* pad1 (1 byte) */
-	Stream_Write_UINT16(s, 0);                                   /* pad3 (2 bytes) */
-	                                                             /* entries */
+
+	for (x = 0; x < 5; x++)
+		Stream_Write_UINT16(s, (UINT16)numEntries[x]); /* numEntriesCacheX (2 bytes) */
+
+	for (x = 0; x < 5; x++)
+		Stream_Write_UINT16(s, (UINT16)totalEntries[x]); /* totalEntriesCacheX (2 bytes) */
+
+	Stream_Write_UINT8(s, flags); /* bBitMask (1 byte) */
+	Stream_Write_UINT8(s, 0);     /* pad1 (1 byte) */
+	Stream_Write_UINT16(s, 0);    /* pad3 (2 bytes) */
+
+	/* entries */
+	for (x = 0; x < count; x++)
+	{
+		if (!rdp_write_persistent_list_entry(s, keys[x] & 0xFFFFFFFF, keys[x] >> 32))
+			return FALSE;
+	}
+
 	return TRUE;
 }
 
 BOOL rdp_send_client_persistent_key_list_pdu(rdpRdp* rdp)
 {
-	wStream* s = rdp_data_pdu_init(rdp);
-	if (!s)
-		return FALSE;
-	if (!rdp_write_client_persistent_key_list_pdu(s, rdp->settings))
+	BOOL rc = FALSE;
+	BYTE flags = PERSIST_FIRST_PDU;
+	size_t offset = 0;
+	size_t total = 0;
+	UINT32 cell = 0;
+	UINT32 cellOffset = 0;
+	UINT32 totalEntries[5] = { 0 };
+	UINT64* keys = bitmap_cache_persistent_keys(rdp->settings, totalEntries);
+
+	for (cell = 0; cell < 5; cell++)
+		total += totalEntries[cell];
+
+	/* Keys are grouped by cell, so each PDU covers a contiguous range of the key list */
+	cell = 0;
+
+	do
 	{
-		Stream_Free(s, TRUE);
-		return FALSE;
-	}
-	return rdp_send_data_pdu(rdp, s, DATA_PDU_TYPE_BITMAP_CACHE_PERSISTENT_LIST, rdp->mcs->userId);
+		wStream* s;
+		UINT32 numEntries[5] = { 0 };
+		const size_t count = MIN(total - offset, PERSIST_MAX_ENTRIES_PER_PDU);
+		size_t left = count;
+
+		while (left > 0)
+		{
+			const UINT32 n = (UINT32)MIN(left, totalEntries[cell] - cellOffset);
+			numEntries[cell] += n;
+			cellOffset += n;
+			left -= n;
+
+			if (cellOffset == totalEntries[cell])
+			{
+				cell++;
+				cellOffset = 0;
+			}
+		}
+
+		if (offset + count == total)
+			flags |= PERSIST_LAST_PDU;
+
+		s = rdp_data_pdu_init(rdp);
+
+		if (!s)
+			goto fail;
+
+		if (!rdp_write_client_persistent_key_list_pdu(s, numEntries, totalEntries, flags,
+		                                              &keys[offset], count))
+		{
+			Stream_Free(s, TRUE);
+			goto fail;
+		}
+
+		if (!rdp_send_data_pdu(rdp, s, DATA_PDU_TYPE_BITMAP_CACHE_PERSISTENT_LIST,
+		                       rdp->mcs->userId))
+			goto fail;
+
+		offset += count;
+		flags &= ~PERSIST_FIRST_PDU;
+	} while (offset < total);
+
+	rc = TRUE;
+fail:
+	free(keys);
+	return rc;
 }
 
 BOOL rdp_recv_client_font_list_pdu(wStream* s)
@@ -315,6 +315,10 @@ rdpBulk* bulk_new(rdpContext* context)
 		bulk->xcrushRecv = xcrush_context_new(FALSE);
 		bulk->xcrushSend = xcrush_context_new(TRUE);
 		bulk->CompressionLevel = context->settings->CompressionLevel;
+		/* the MPPC chains cost several times the CPU of the legacy finder, the NCrush ones
+		 * are faster than its legacy finder */
+		mppc_set_match_level(bulk->mppcSend, BULK_MATCH_LEVEL_LEGACY);
+		ncrush_set_match_level(bulk->ncrushSend, BULK_MATCH_LEVEL_DEFAULT);
 	}
 
 	return bulk;
@@ -1199,6 +1199,7 @@ int rdp_client_transition_to_state(rdpRdp* rdp, int state)
 
 		case CONNECTION_STATE_ACTIVE:
 			rdp->state = CONNECTION_STATE_ACTIVE;
+			rdp_session_dump_desktop(rdp);
 			{
 				ActivatedEventArgs activatedEvent;
 				rdpContext* context = rdp->context;
@@ -217,6 +217,15 @@ BOOL freerdp_connect(freerdp* instance)
 			instance->update->dump_rfx = TRUE;
 	}
 
+	if (instance->settings->DumpSessionFile)
+	{
+		rdp->sessionDump = session_dump_open(instance->settings->DumpSessionFile, TRUE);
+
+		if (!rdp->sessionDump || !rdp_session_dump_desktop(rdp))
+			WLog_WARN(TAG, "failed to record the session to %s",
+			          instance->settings->DumpSessionFile);
+	}
+
 	if (status)
 	{
 		pointer_cache_register_callbacks(instance->context->update);
@@ -533,6 +542,9 @@ BOOL freerdp_disconnect(freerdp* instance)
 	}
 
 	freerdp_channels_close(instance->context->channels, instance);
+	/* After the channels so that no channel thread still records into it */
+	session_dump_close(rdp->sessionDump);
+	rdp->sessionDump = NULL;
 	return rc;
 }
 
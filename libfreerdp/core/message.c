@@ -45,24 +45,290 @@
 
 #define TAG FREERDP_TAG("core.message")
 
+/**
+ * Frames
+ *
+ * Messages posted between BeginPaint and EndPaint by the thread that called BeginPaint are
+ * recorded into a frame and posted to the queue as a single message at EndPaint. The frame
+ * owns a bump allocator that backs the order copies, the proxy thread replays the frame in
+ * order and hands it back for reuse, so a frame costs neither a malloc per order nor a queue
+ * lock round trip per message.
+ */
+
+#define UPDATE_MESSAGE_BLOCK_SIZE (64 * 1024)
+#define UPDATE_MESSAGE_FREE_FRAMES 4
+
+typedef struct _UPDATE_MESSAGE_BLOCK UPDATE_MESSAGE_BLOCK;
+typedef struct _UPDATE_MESSAGE_RECORD UPDATE_MESSAGE_RECORD;
+
+struct _UPDATE_MESSAGE_BLOCK
+{
+	UPDATE_MESSAGE_BLOCK* next;
+	size_t size;
+	size_t used;
+	BYTE* data;
+};
+
+struct _UPDATE_MESSAGE_RECORD
+{
+	UPDATE_MESSAGE_RECORD* next;
+	wMessage message;
+};
+
+struct _UPDATE_MESSAGE_FRAME
+{
+	UPDATE_MESSAGE_FRAME* next;
+	rdpUpdateProxy* proxy;
+	UPDATE_MESSAGE_BLOCK* blocks;
+	UPDATE_MESSAGE_BLOCK* last;
+	UPDATE_MESSAGE_BLOCK* current;
+	UPDATE_MESSAGE_RECORD* head;
+	UPDATE_MESSAGE_RECORD* tail;
+};
+
+static BOOL update_message_free_class(wMessage* msg, int msgClass, int msgType);
+
+static void* update_message_frame_alloc(UPDATE_MESSAGE_FRAME* frame, size_t size)
+{
+	BYTE* ptr;
+	UPDATE_MESSAGE_BLOCK* block = frame->current;
+	size = (size + 15) & ~((size_t)15);
+
+	/* Blocks kept from earlier frames are reused before new ones are added */
+	while (block && (block->used + size > block->size))
+		block = block->next;
+
+	if (!block)
+	{
+		block = (UPDATE_MESSAGE_BLOCK*)calloc(1, sizeof(UPDATE_MESSAGE_BLOCK));
+
+		if (!block)
+			return NULL;
+
+		block->size = MAX(size, UPDATE_MESSAGE_BLOCK_SIZE);
+		block->data = (BYTE*)_aligned_malloc(block->size, 16);
+
+		if (!block->data)
+		{
+			free(block);
+			return NULL;
+		}
+
+		if (frame->last)
+			frame->last->next = block;
+		else
+			frame->blocks = block;
+
+		frame->last = block;
+	}
+
+	ptr = &block->data[block->used];
+	block->used += size;
+	frame->current = block;
+	return ptr;
+}
+
+static BOOL update_message_frame_record(UPDATE_MESSAGE_FRAME* frame, void* context, UINT32 id,
+                                        void* wParam, void* lParam)
+{
+	UPDATE_MESSAGE_RECORD* record =
+	    (UPDATE_MESSAGE_RECORD*)update_message_frame_alloc(frame, sizeof(UPDATE_MESSAGE_RECORD));
+
+	if (!record)
+		return FALSE;
+
+	record->next = NULL;
+	record->message.id = id;
+	record->message.context = context;
+	record->message.wParam = wParam;
+	record->message.lParam = lParam;
+	record->message.time = GetTickCount64();
+	record->message.Free = NULL;
+
+	if (frame->tail)
+		frame->tail->next = record;
+	else
+		frame->head = record;
+
+	frame->tail = record;
+	return TRUE;
+}
+
+/* Messages whose parameters are allocated with update_message_alloc */
+static BOOL update_message_frame_owns(UINT32 id)
+{
+	if (GetMessageClass(id) == PrimaryUpdate_Class)
+		return TRUE;
+
+	return (id == MakeMessageId(Update, SetBounds)) ||
+	       (id == MakeMessageId(Update, SurfaceFrameMarker));
+}
+
+static void update_message_frame_free(UPDATE_MESSAGE_FRAME* frame)
+{
+	UPDATE_MESSAGE_BLOCK* block;
+
+	if (!frame)
+		return;
+
+	block = frame->blocks;
+
+	while (block)
+	{
+		UPDATE_MESSAGE_BLOCK* next = block->next;
+		_aligned_free(block->data);
+		free(block);
+		block = next;
+	}
+
+	free(frame);
+}
+
+static UPDATE_MESSAGE_FRAME* update_message_frame_acquire(rdpUpdateProxy* proxy)
+{
+	UPDATE_MESSAGE_FRAME* frame;
+	EnterCriticalSection(&proxy->lock);
+	frame = proxy->freeFrames;
+
+	if (frame)
+	{
+		proxy->freeFrames = frame->next;
+		proxy->freeFrameCount--;
+	}
+
+	LeaveCriticalSection(&proxy->lock);
+
+	if (!frame)
+	{
+		frame = (UPDATE_MESSAGE_FRAME*)calloc(1, sizeof(UPDATE_MESSAGE_FRAME));
+
+		if (!frame)
+			return NULL;
+
+		frame->proxy = proxy;
+	}
+
+	frame->next = NULL;
+	return frame;
+}
+
+static void update_message_frame_release(UPDATE_MESSAGE_FRAME* frame)
+{
+	UPDATE_MESSAGE_BLOCK* block;
+	UPDATE_MESSAGE_RECORD* record;
+	rdpUpdateProxy* proxy;
+
+	if (!frame)
+		return;
+
+	proxy = frame->proxy;
+
+	/* Parameters not backed by the frame are freed like those of single messages */
+	for (record = frame->head; record; record = record->next)
+	{
+		wMessage* msg = &record->message;
+
+		if (!update_message_frame_owns(msg->id))
+			update_message_free_class(msg, GetMessageClass(msg->id), GetMessageType(msg->id));
+	}
+
+	for (block = frame->blocks; block; block = block->next)
+		block->used = 0;
+
+	frame->current = frame->blocks;
+	frame->head = NULL;
+	frame->tail = NULL;
+	EnterCriticalSection(&proxy->lock);
+
+	if (proxy->freeFrameCount < UPDATE_MESSAGE_FREE_FRAMES)
+	{
+		frame->next = proxy->freeFrames;
+		proxy->freeFrames = frame;
+		proxy->freeFrameCount++;
+		frame = NULL;
+	}
+
+	LeaveCriticalSection(&proxy->lock);
+	update_message_frame_free(frame);
+}
+
+/* The frame messages of the calling thread are recorded into, NULL to post them directly */
+static UPDATE_MESSAGE_FRAME* update_message_get_frame(rdpContext* context)
+{
+	rdpUpdateProxy* proxy = context->update->proxy;
+
+	if (!proxy || (proxy->frameThreadId != GetCurrentThreadId()))
+		return NULL;
+
+	return proxy->frame;
+}
+
+static void* update_message_alloc(rdpContext* context, size_t size)
+{
+	UPDATE_MESSAGE_FRAME* frame = update_message_get_frame(context);
+
+	if (frame)
+		return update_message_frame_alloc(frame, size);
+
+	return malloc(size);
+}
+
+static BOOL update_message_post(rdpContext* context, UINT32 id, void* wParam, void* lParam)
+{
+	UPDATE_MESSAGE_FRAME* frame = update_message_get_frame(context);
+
+	if (frame)
+		return update_message_frame_record(frame, (void*)context, id, wParam, lParam);
+
+	return MessageQueue_Post(context->update->queue, (void*)context, id, wParam, lParam);
+}
+
 /* Update */
 
 static BOOL update_message_BeginPaint(rdpContext* context)
 {
+	rdpUpdateProxy* proxy;
+
 	if (!context || !context->update)
 		return FALSE;
 
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(Update, BeginPaint), NULL, NULL);
+	proxy = context->update->proxy;
+
+	/* Without a frame the messages are posted one by one */
+	if (proxy && !proxy->frame)
+	{
+		proxy->frameThreadId = GetCurrentThreadId();
+		proxy->frame = update_message_frame_acquire(proxy);
+	}
+
+	return update_message_post(context, MakeMessageId(Update, BeginPaint), NULL, NULL);
 }
 
 static BOOL update_message_EndPaint(rdpContext* context)
 {
+	UPDATE_MESSAGE_FRAME* frame;
+
 	if (!context || !context->update)
 		return FALSE;
 
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(Update, EndPaint), NULL, NULL);
+	if (!update_message_post(context, MakeMessageId(Update, EndPaint), NULL, NULL))
+		return FALSE;
+
+	frame = update_message_get_frame(context);
+
+	if (!frame)
+		return TRUE;
+
+	context->update->proxy->frame = NULL;
+
+	if (!MessageQueue_Post(context->update->queue, (void*)context, MakeMessageId(Update, Frame),
+	                       (void*)frame, NULL))
+	{
+		update_message_frame_release(frame);
+		return FALSE;
+	}
+
+	return TRUE;
 }
 
 static BOOL update_message_SetBounds(rdpContext* context, const rdpBounds* bounds)
@@ -74,7 +340,7 @@ static BOOL update_message_SetBounds(rdpContext* context, const rdpBounds* bound
 
 	if (bounds)
 	{
-		wParam = (rdpBounds*)malloc(sizeof(rdpBounds));
+		wParam = (rdpBounds*)update_message_alloc(context, sizeof(rdpBounds));
 
 		if (!wParam)
 			return FALSE;
@@ -82,8 +348,7 @@ static BOOL update_message_SetBounds(rdpContext* context, const rdpBounds* bound
 		CopyMemory(wParam, bounds, sizeof(rdpBounds));
 	}
 
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(Update, SetBounds), (void*)wParam, NULL);
+	return update_message_post(context, MakeMessageId(Update, SetBounds), (void*)wParam, NULL);
 }
 
 static BOOL update_message_Synchronize(rdpContext* context)
@@ -91,8 +356,7 @@ static BOOL update_message_Synchronize(rdpContext* context)
 	if (!context || !context->update)
 		return FALSE;
 
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(Update, Synchronize), NULL, NULL);
+	return update_message_post(context, MakeMessageId(Update, Synchronize), NULL, NULL);
 }
 
 static BOOL update_message_DesktopResize(rdpContext* context)
@@ -100,8 +364,7 @@ static BOOL update_message_DesktopResize(rdpContext* context)
 	if (!context || !context->update)
 		return FALSE;
 
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(Update, DesktopResize), NULL, NULL);
+	return update_message_post(context, MakeMessageId(Update, DesktopResize), NULL, NULL);
 }
 
 static BOOL update_message_BitmapUpdate(rdpContext* context, const BITMAP_UPDATE* bitmap)
@@ -116,8 +379,7 @@ static BOOL update_message_BitmapUpdate(rdpContext* context, const BITMAP_UPDATE
 	if (!wParam)
 		return FALSE;
 
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(Update, BitmapUpdate), (void*)wParam, NULL);
+	return update_message_post(context, MakeMessageId(Update, BitmapUpdate), (void*)wParam, NULL);
 }
 
 static BOOL update_message_Palette(rdpContext* context, const PALETTE_UPDATE* palette)
@@ -132,8 +394,7 @@ static BOOL update_message_Palette(rdpContext* context, const PALETTE_UPDATE* pa
 	if (!wParam)
 		return FALSE;
 
-	return MessageQueue_Post(context->update->queue, (void*)context, MakeMessageId(Update, Palette),
-	                         (void*)wParam, NULL);
+	return update_message_post(context, MakeMessageId(Update, Palette), (void*)wParam, NULL);
 }
 
 static BOOL update_message_PlaySound(rdpContext* context, const PLAY_SOUND_UPDATE* playSound)
@@ -149,8 +410,7 @@ static BOOL update_message_PlaySound(rdpContext* context, const PLAY_SOUND_UPDAT
 		return FALSE;
 
 	CopyMemory(wParam, playSound, sizeof(PLAY_SOUND_UPDATE));
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(Update, PlaySound), (void*)wParam, NULL);
+	return update_message_post(context, MakeMessageId(Update, PlaySound), (void*)wParam, NULL);
 }
 
 static BOOL update_message_SetKeyboardIndicators(rdpContext* context, UINT16 led_flags)
@@ -158,9 +418,8 @@ static BOOL update_message_SetKeyboardIndicators(rdpContext* context, UINT16 led
 	if (!context || !context->update)
 		return FALSE;
 
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(Update, SetKeyboardIndicators), (void*)(size_t)led_flags,
-	                         NULL);
+	return update_message_post(context, MakeMessageId(Update, SetKeyboardIndicators),
+	                           (void*)(size_t)led_flags, NULL);
 }
 
 static BOOL update_message_SetKeyboardImeStatus(rdpContext* context, UINT16 imeId, UINT32 imeState,
@@ -169,9 +428,9 @@ static BOOL update_message_SetKeyboardImeStatus(rdpContext* context, UINT16 imeI
 	if (!context || !context->update)
 		return FALSE;
 
-	return MessageQueue_Post(
-	    context->update->queue, (void*)context, MakeMessageId(Update, SetKeyboardImeStatus),
-	    (void*)(size_t)((imeId << 16UL) | imeState), (void*)(size_t)imeConvMode);
+	return update_message_post(context, MakeMessageId(Update, SetKeyboardImeStatus),
+	                           (void*)(size_t)((imeId << 16UL) | imeState),
+	                           (void*)(size_t)imeConvMode);
 }
 
 static BOOL update_message_RefreshRect(rdpContext* context, BYTE count, const RECTANGLE_16* areas)
@@ -187,9 +446,8 @@ static BOOL update_message_RefreshRect(rdpContext* context, BYTE count, const RE
 		return FALSE;
 
 	CopyMemory(lParam, areas, sizeof(RECTANGLE_16) * count);
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(Update, RefreshRect), (void*)(size_t)count,
-	                         (void*)lParam);
+	return update_message_post(context, MakeMessageId(Update, RefreshRect), (void*)(size_t)count,
+	                           (void*)lParam);
 }
 
 static BOOL update_message_SuppressOutput(rdpContext* context, BYTE allow, const RECTANGLE_16* area)
@@ -209,9 +467,8 @@ static BOOL update_message_SuppressOutput(rdpContext* context, BYTE allow, const
 		CopyMemory(lParam, area, sizeof(RECTANGLE_16));
 	}
 
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(Update, SuppressOutput), (void*)(size_t)allow,
-	                         (void*)lParam);
+	return update_message_post(context, MakeMessageId(Update, SuppressOutput), (void*)(size_t)allow,
+	                           (void*)lParam);
 }
 
 static BOOL update_message_SurfaceCommand(rdpContext* context, wStream* s)
@@ -228,8 +485,7 @@ static BOOL update_message_SurfaceCommand(rdpContext* context, wStream* s)
 
 	Stream_Copy(s, wParam, Stream_GetRemainingLength(s));
 	Stream_SetPosition(wParam, 0);
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(Update, SurfaceCommand), (void*)wParam, NULL);
+	return update_message_post(context, MakeMessageId(Update, SurfaceCommand), (void*)wParam, NULL);
 }
 
 static BOOL update_message_SurfaceBits(rdpContext* context,
@@ -245,8 +501,7 @@ static BOOL update_message_SurfaceBits(rdpContext* context,
 	if (!wParam)
 		return FALSE;
 
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(Update, SurfaceBits), (void*)wParam, NULL);
+	return update_message_post(context, MakeMessageId(Update, SurfaceBits), (void*)wParam, NULL);
 }
 
 static BOOL update_message_SurfaceFrameMarker(rdpContext* context,
@@ -257,14 +512,14 @@ static BOOL update_message_SurfaceFrameMarker(rdpContext* context,
 	if (!context || !context->update || !surfaceFrameMarker)
 		return FALSE;
 
-	wParam = (SURFACE_FRAME_MARKER*)malloc(sizeof(SURFACE_FRAME_MARKER));
+	wParam = (SURFACE_FRAME_MARKER*)update_message_alloc(context, sizeof(SURFACE_FRAME_MARKER));
 
 	if (!wParam)
 		return FALSE;
 
 	CopyMemory(wParam, surfaceFrameMarker, sizeof(SURFACE_FRAME_MARKER));
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(Update, SurfaceFrameMarker), (void*)wParam, NULL);
+	return update_message_post(context, MakeMessageId(Update, SurfaceFrameMarker), (void*)wParam,
+	                           NULL);
 }
 
 static BOOL update_message_SurfaceFrameAcknowledge(rdpContext* context, UINT32 frameId)
@@ -272,9 +527,8 @@ static BOOL update_message_SurfaceFrameAcknowledge(rdpContext* context, UINT32 f
 	if (!context || !context->update)
 		return FALSE;
 
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(Update, SurfaceFrameAcknowledge), (void*)(size_t)frameId,
-	                         NULL);
+	return update_message_post(context, MakeMessageId(Update, SurfaceFrameAcknowledge),
+	                           (void*)(size_t)frameId, NULL);
 }
 
 /* Primary Update */
@@ -286,14 +540,13 @@ static BOOL update_message_DstBlt(rdpContext* context, const DSTBLT_ORDER* dstBl
 	if (!context || !context->update || !dstBlt)
 		return FALSE;
 
-	wParam = (DSTBLT_ORDER*)malloc(sizeof(DSTBLT_ORDER));
+	wParam = (DSTBLT_ORDER*)update_message_alloc(context, sizeof(DSTBLT_ORDER));
 
 	if (!wParam)
 		return FALSE;
 
 	CopyMemory(wParam, dstBlt, sizeof(DSTBLT_ORDER));
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(PrimaryUpdate, DstBlt), (void*)wParam, NULL);
+	return update_message_post(context, MakeMessageId(PrimaryUpdate, DstBlt), (void*)wParam, NULL);
 }
 
 static BOOL update_message_PatBlt(rdpContext* context, PATBLT_ORDER* patBlt)
@@ -303,15 +556,14 @@ static BOOL update_message_PatBlt(rdpContext* context, PATBLT_ORDER* patBlt)
 	if (!context || !context->update || !patBlt)
 		return FALSE;
 
-	wParam = (PATBLT_ORDER*)malloc(sizeof(PATBLT_ORDER));
+	wParam = (PATBLT_ORDER*)update_message_alloc(context, sizeof(PATBLT_ORDER));
 
 	if (!wParam)
 		return FALSE;
 
 	CopyMemory(wParam, patBlt, sizeof(PATBLT_ORDER));
 	wParam->brush.data = (BYTE*)wParam->brush.p8x8;
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(PrimaryUpdate, PatBlt), (void*)wParam, NULL);
+	return update_message_post(context, MakeMessageId(PrimaryUpdate, PatBlt), (void*)wParam, NULL);
 }
 
 static BOOL update_message_ScrBlt(rdpContext* context, const SCRBLT_ORDER* scrBlt)
@@ -321,14 +573,13 @@ static BOOL update_message_ScrBlt(rdpContext* context, const SCRBLT_ORDER* scrBl
 	if (!context || !context->update || !scrBlt)
 		return FALSE;
 
-	wParam = (SCRBLT_ORDER*)malloc(sizeof(SCRBLT_ORDER));
+	wParam = (SCRBLT_ORDER*)update_message_alloc(context, sizeof(SCRBLT_ORDER));
 
 	if (!wParam)
 		return FALSE;
 
 	CopyMemory(wParam, scrBlt, sizeof(SCRBLT_ORDER));
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(PrimaryUpdate, ScrBlt), (void*)wParam, NULL);
+	return update_message_post(context, MakeMessageId(PrimaryUpdate, ScrBlt), (void*)wParam, NULL);
 }
 
 static BOOL update_message_OpaqueRect(rdpContext* context, const OPAQUE_RECT_ORDER* opaqueRect)
@@ -338,14 +589,14 @@ static BOOL update_message_OpaqueRect(rdpContext* context, const OPAQUE_RECT_ORD
 	if (!context || !context->update || !opaqueRect)
 		return FALSE;
 
-	wParam = (OPAQUE_RECT_ORDER*)malloc(sizeof(OPAQUE_RECT_ORDER));
+	wParam = (OPAQUE_RECT_ORDER*)update_message_alloc(context, sizeof(OPAQUE_RECT_ORDER));
 
 	if (!wParam)
 		return FALSE;
 
 	CopyMemory(wParam, opaqueRect, sizeof(OPAQUE_RECT_ORDER));
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(PrimaryUpdate, OpaqueRect), (void*)wParam, NULL);
+	return update_message_post(context, MakeMessageId(PrimaryUpdate, OpaqueRect), (void*)wParam,
+	                           NULL);
 }
 
 static BOOL update_message_DrawNineGrid(rdpContext* context,
@@ -356,14 +607,14 @@ static BOOL update_message_DrawNineGrid(rdpContext* context,
 	if (!context || !context->update || !drawNineGrid)
 		return FALSE;
 
-	wParam = (DRAW_NINE_GRID_ORDER*)malloc(sizeof(DRAW_NINE_GRID_ORDER));
+	wParam = (DRAW_NINE_GRID_ORDER*)update_message_alloc(context, sizeof(DRAW_NINE_GRID_ORDER));
 
 	if (!wParam)
 		return FALSE;
 
 	CopyMemory(wParam, drawNineGrid, sizeof(DRAW_NINE_GRID_ORDER));
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(PrimaryUpdate, DrawNineGrid), (void*)wParam, NULL);
+	return update_message_post(context, MakeMessageId(PrimaryUpdate, DrawNineGrid), (void*)wParam,
+	                           NULL);
 }
 
 static BOOL update_message_MultiDstBlt(rdpContext* context, const MULTI_DSTBLT_ORDER* multiDstBlt)
@@ -373,14 +624,14 @@ static BOOL update_message_MultiDstBlt(rdpContext* context, const MULTI_DSTBLT_O
 	if (!context || !context->update || !multiDstBlt)
 		return FALSE;
 
-	wParam = (MULTI_DSTBLT_ORDER*)malloc(sizeof(MULTI_DSTBLT_ORDER));
+	wParam = (MULTI_DSTBLT_ORDER*)update_message_alloc(context, sizeof(MULTI_DSTBLT_ORDER));
 
 	if (!wParam)
 		return FALSE;
 
 	CopyMemory(wParam, multiDstBlt, sizeof(MULTI_DSTBLT_ORDER));
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(PrimaryUpdate, MultiDstBlt), (void*)wParam, NULL);
+	return update_message_post(context, MakeMessageId(PrimaryUpdate, MultiDstBlt), (void*)wParam,
+	                           NULL);
 }
 
 static BOOL update_message_MultiPatBlt(rdpContext* context, const MULTI_PATBLT_ORDER* multiPatBlt)
@@ -390,15 +641,15 @@ static BOOL update_message_MultiPatBlt(rdpContext* context, const MULTI_PATBLT_O
 	if (!context || !context->update || !multiPatBlt)
 		return FALSE;
 
-	wParam = (MULTI_PATBLT_ORDER*)malloc(sizeof(MULTI_PATBLT_ORDER));
+	wParam = (MULTI_PATBLT_ORDER*)update_message_alloc(context, sizeof(MULTI_PATBLT_ORDER));
 
 	if (!wParam)
 		return FALSE;
 
 	CopyMemory(wParam, multiPatBlt, sizeof(MULTI_PATBLT_ORDER));
 	wParam->brush.data = (BYTE*)wParam->brush.p8x8;
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(PrimaryUpdate, MultiPatBlt), (void*)wParam, NULL);
+	return update_message_post(context, MakeMessageId(PrimaryUpdate, MultiPatBlt), (void*)wParam,
+	                           NULL);
 }
 
 static BOOL update_message_MultiScrBlt(rdpContext* context, const MULTI_SCRBLT_ORDER* multiScrBlt)
@@ -408,14 +659,14 @@ static BOOL update_message_MultiScrBlt(rdpContext* context, const MULTI_SCRBLT_O
 	if (!context || !context->update || !multiScrBlt)
 		return FALSE;
 
-	wParam = (MULTI_SCRBLT_ORDER*)malloc(sizeof(MULTI_SCRBLT_ORDER));
+	wParam = (MULTI_SCRBLT_ORDER*)update_message_alloc(context, sizeof(MULTI_SCRBLT_ORDER));
 
 	if (!wParam)
 		return FALSE;
 
 	CopyMemory(wParam, multiScrBlt, sizeof(MULTI_SCRBLT_ORDER));
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(PrimaryUpdate, MultiScrBlt), (void*)wParam, NULL);
+	return update_message_post(context, MakeMessageId(PrimaryUpdate, MultiScrBlt), (void*)wParam,
+	                           NULL);
 }
 
 static BOOL update_message_MultiOpaqueRect(rdpContext* context,
@@ -426,14 +677,15 @@ static BOOL update_message_MultiOpaqueRect(rdpContext* context,
 	if (!context || !context->update || !multiOpaqueRect)
 		return FALSE;
 
-	wParam = (MULTI_OPAQUE_RECT_ORDER*)malloc(sizeof(MULTI_OPAQUE_RECT_ORDER));
+	wParam =
+	    (MULTI_OPAQUE_RECT_ORDER*)update_message_alloc(context, sizeof(MULTI_OPAQUE_RECT_ORDER));
 
 	if (!wParam)
 		return FALSE;
 
 	CopyMemory(wParam, multiOpaqueRect, sizeof(MULTI_OPAQUE_RECT_ORDER));
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(PrimaryUpdate, MultiOpaqueRect), (void*)wParam, NULL);
+	return update_message_post(context, MakeMessageId(PrimaryUpdate, MultiOpaqueRect),
+	                           (void*)wParam, NULL);
 }
 
 static BOOL update_message_MultiDrawNineGrid(rdpContext* context,
@@ -444,15 +696,16 @@ static BOOL update_message_MultiDrawNineGrid(rdpContext* context,
 	if (!context || !context->update || !multiDrawNineGrid)
 		return FALSE;
 
-	wParam = (MULTI_DRAW_NINE_GRID_ORDER*)malloc(sizeof(MULTI_DRAW_NINE_GRID_ORDER));
+	wParam = (MULTI_DRAW_NINE_GRID_ORDER*)update_message_alloc(
+	    context, sizeof(MULTI_DRAW_NINE_GRID_ORDER));
 
 	if (!wParam)
 		return FALSE;
 
 	CopyMemory(wParam, multiDrawNineGrid, sizeof(MULTI_DRAW_NINE_GRID_ORDER));
 	/* TODO: complete copy */
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(PrimaryUpdate, MultiDrawNineGrid), (void*)wParam, NULL);
+	return update_message_post(context, MakeMessageId(PrimaryUpdate, MultiDrawNineGrid),
+	                           (void*)wParam, NULL);
 }
 
 static BOOL update_message_LineTo(rdpContext* context, const LINE_TO_ORDER* lineTo)
@@ -462,14 +715,13 @@ static BOOL update_message_LineTo(rdpContext* context, const LINE_TO_ORDER* line
 	if (!context || !context->update || !lineTo)
 		return FALSE;
 
-	wParam = (LINE_TO_ORDER*)malloc(sizeof(LINE_TO_ORDER));
+	wParam = (LINE_TO_ORDER*)update_message_alloc(context, sizeof(LINE_TO_ORDER));
 
 	if (!wParam)
 		return FALSE;
 
 	CopyMemory(wParam, lineTo, sizeof(LINE_TO_ORDER));
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(PrimaryUpdate, LineTo), (void*)wParam, NULL);
+	return update_message_post(context, MakeMessageId(PrimaryUpdate, LineTo), (void*)wParam, NULL);
 }
 
 static BOOL update_message_Polyline(rdpContext* context, const POLYLINE_ORDER* polyline)
@@ -479,23 +731,18 @@ static BOOL update_message_Polyline(rdpContext* context, const POLYLINE_ORDER* p
 	if (!context || !context->update || !polyline)
 		return FALSE;
 
-	wParam = (POLYLINE_ORDER*)malloc(sizeof(POLYLINE_ORDER));
+	/* The points are stored behind the order */
+	wParam = (POLYLINE_ORDER*)update_message_alloc(
+	    context, sizeof(POLYLINE_ORDER) + sizeof(DELTA_POINT) * polyline->numDeltaEntries);
 
 	if (!wParam)
 		return FALSE;
 
 	CopyMemory(wParam, polyline, sizeof(POLYLINE_ORDER));
-	wParam->points = (DELTA_POINT*)calloc(wParam->numDeltaEntries, sizeof(DELTA_POINT));
-
-	if (!wParam->points)
-	{
-		free(wParam);
-		return FALSE;
-	}
-
+	wParam->points = (DELTA_POINT*)&wParam[1];
 	CopyMemory(wParam->points, polyline->points, sizeof(DELTA_POINT) * wParam->numDeltaEntries);
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(PrimaryUpdate, Polyline), (void*)wParam, NULL);
+	return update_message_post(context, MakeMessageId(PrimaryUpdate, Polyline), (void*)wParam,
+	                           NULL);
 }
 
 static BOOL update_message_MemBlt(rdpContext* context, MEMBLT_ORDER* memBlt)
@@ -505,14 +752,13 @@ static BOOL update_message_MemBlt(rdpContext* context, MEMBLT_ORDER* memBlt)
 	if (!context || !context->update || !memBlt)
 		return FALSE;
 
-	wParam = (MEMBLT_ORDER*)malloc(sizeof(MEMBLT_ORDER));
+	wParam = (MEMBLT_ORDER*)update_message_alloc(context, sizeof(MEMBLT_ORDER));
 
 	if (!wParam)
 		return FALSE;
 
 	CopyMemory(wParam, memBlt, sizeof(MEMBLT_ORDER));
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(PrimaryUpdate, MemBlt), (void*)wParam, NULL);
+	return update_message_post(context, MakeMessageId(PrimaryUpdate, MemBlt), (void*)wParam, NULL);
 }
 
 static BOOL update_message_Mem3Blt(rdpContext* context, MEM3BLT_ORDER* mem3Blt)
@@ -522,15 +768,14 @@ static BOOL update_message_Mem3Blt(rdpContext* context, MEM3BLT_ORDER* mem3Blt)
 	if (!context || !context->update || !mem3Blt)
 		return FALSE;
 
-	wParam = (MEM3BLT_ORDER*)malloc(sizeof(MEM3BLT_ORDER));
+	wParam = (MEM3BLT_ORDER*)update_message_alloc(context, sizeof(MEM3BLT_ORDER));
 
 	if (!wParam)
 		return FALSE;
 
 	CopyMemory(wParam, mem3Blt, sizeof(MEM3BLT_ORDER));
 	wParam->brush.data = (BYTE*)wParam->brush.p8x8;
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(PrimaryUpdate, Mem3Blt), (void*)wParam, NULL);
+	return update_message_post(context, MakeMessageId(PrimaryUpdate, Mem3Blt), (void*)wParam, NULL);
 }
 
 static BOOL update_message_SaveBitmap(rdpContext* context, const SAVE_BITMAP_ORDER* saveBitmap)
@@ -540,14 +785,14 @@ static BOOL update_message_SaveBitmap(rdpContext* context, const SAVE_BITMAP_ORD
 	if (!context || !context->update || !saveBitmap)
 		return FALSE;
 
-	wParam = (SAVE_BITMAP_ORDER*)malloc(sizeof(SAVE_BITMAP_ORDER));
+	wParam = (SAVE_BITMAP_ORDER*)update_message_alloc(context, sizeof(SAVE_BITMAP_ORDER));
 
 	if (!wParam)
 		return FALSE;
 
 	CopyMemory(wParam, saveBitmap, sizeof(SAVE_BITMAP_ORDER));
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(PrimaryUpdate, SaveBitmap), (void*)wParam, NULL);
+	return update_message_post(context, MakeMessageId(PrimaryUpdate, SaveBitmap), (void*)wParam,
+	                           NULL);
 }
 
 static BOOL update_message_GlyphIndex(rdpContext* context, GLYPH_INDEX_ORDER* glyphIndex)
@@ -557,15 +802,15 @@ static BOOL update_message_GlyphIndex(rdpContext* context, GLYPH_INDEX_ORDER* gl
 	if (!context || !context->update || !glyphIndex)
 		return FALSE;
 
-	wParam = (GLYPH_INDEX_ORDER*)malloc(sizeof(GLYPH_INDEX_ORDER));
+	wParam = (GLYPH_INDEX_ORDER*)update_message_alloc(context, sizeof(GLYPH_INDEX_ORDER));
 
 	if (!wParam)
 		return FALSE;
 
 	CopyMemory(wParam, glyphIndex, sizeof(GLYPH_INDEX_ORDER));
 	wParam->brush.data = (BYTE*)wParam->brush.p8x8;
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(PrimaryUpdate, GlyphIndex), (void*)wParam, NULL);
+	return update_message_post(context, MakeMessageId(PrimaryUpdate, GlyphIndex), (void*)wParam,
+	                           NULL);
 }
 
 static BOOL update_message_FastIndex(rdpContext* context, const FAST_INDEX_ORDER* fastIndex)
@@ -575,24 +820,29 @@ static BOOL update_message_FastIndex(rdpContext* context, const FAST_INDEX_ORDER
 	if (!context || !context->update || !fastIndex)
 		return FALSE;
 
-	wParam = (FAST_INDEX_ORDER*)malloc(sizeof(FAST_INDEX_ORDER));
+	wParam = (FAST_INDEX_ORDER*)update_message_alloc(context, sizeof(FAST_INDEX_ORDER));
 
 	if (!wParam)
 		return FALSE;
 
 	CopyMemory(wParam, fastIndex, sizeof(FAST_INDEX_ORDER));
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(PrimaryUpdate, FastIndex), (void*)wParam, NULL);
+	return update_message_post(context, MakeMessageId(PrimaryUpdate, FastIndex), (void*)wParam,
+	                           NULL);
 }
 
 static BOOL update_message_FastGlyph(rdpContext* context, const FAST_GLYPH_ORDER* fastGlyph)
 {
 	FAST_GLYPH_ORDER* wParam;
+	size_t size = sizeof(FAST_GLYPH_ORDER);
 
 	if (!context || !context->update || !fastGlyph)
 		return FALSE;
 
-	wParam = (FAST_GLYPH_ORDER*)malloc(sizeof(FAST_GLYPH_ORDER));
+	/* The glyph bitmap is stored behind the order */
+	if (fastGlyph->cbData > 1)
+		size += fastGlyph->glyphData.cb;
+
+	wParam = (FAST_GLYPH_ORDER*)update_message_alloc(context, size);
 
 	if (!wParam)
 		return FALSE;
@@ -601,14 +851,7 @@ static BOOL update_message_FastGlyph(rdpContext* context, const FAST_GLYPH_ORDER
 
 	if (wParam->cbData > 1)
 	{
-		wParam->glyphData.aj = (BYTE*)malloc(fastGlyph->glyphData.cb);
-
-		if (!wParam->glyphData.aj)
-		{
-			free(wParam);
-			return FALSE;
-		}
-
+		wParam->glyphData.aj = (BYTE*)&wParam[1];
 		CopyMemory(wParam->glyphData.aj, fastGlyph->glyphData.aj, fastGlyph->glyphData.cb);
 	}
 	else
@@ -616,8 +859,8 @@ static BOOL update_message_FastGlyph(rdpContext* context, const FAST_GLYPH_ORDER
 		wParam->glyphData.aj = NULL;
 	}
 
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(PrimaryUpdate, FastGlyph), (void*)wParam, NULL);
+	return update_message_post(context, MakeMessageId(PrimaryUpdate, FastGlyph), (void*)wParam,
+	                           NULL);
 }
 
 static BOOL update_message_PolygonSC(rdpContext* context, const POLYGON_SC_ORDER* polygonSC)
@@ -627,23 +870,18 @@ static BOOL update_message_PolygonSC(rdpContext* context, const POLYGON_SC_ORDER
 	if (!context || !context->update || !polygonSC)
 		return FALSE;
 
-	wParam = (POLYGON_SC_ORDER*)malloc(sizeof(POLYGON_SC_ORDER));
+	/* The points are stored behind the order */
+	wParam = (POLYGON_SC_ORDER*)update_message_alloc(
+	    context, sizeof(POLYGON_SC_ORDER) + sizeof(DELTA_POINT) * polygonSC->numPoints);
 
 	if (!wParam)
 		return FALSE;
 
 	CopyMemory(wParam, polygonSC, sizeof(POLYGON_SC_ORDER));
-	wParam->points = (DELTA_POINT*)calloc(wParam->numPoints, sizeof(DELTA_POINT));
-
-	if (!wParam->points)
-	{
-		free(wParam);
-		return FALSE;
-	}
-
-	CopyMemory(wParam->points, polygonSC, sizeof(DELTA_POINT) * wParam->numPoints);
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(PrimaryUpdate, PolygonSC), (void*)wParam, NULL);
+	wParam->points = (DELTA_POINT*)&wParam[1];
+	CopyMemory(wParam->points, polygonSC->points, sizeof(DELTA_POINT) * wParam->numPoints);
+	return update_message_post(context, MakeMessageId(PrimaryUpdate, PolygonSC), (void*)wParam,
+	                           NULL);
 }
 
 static BOOL update_message_PolygonCB(rdpContext* context, POLYGON_CB_ORDER* polygonCB)
@@ -653,24 +891,19 @@ static BOOL update_message_PolygonCB(rdpContext* context, POLYGON_CB_ORDER* poly
 	if (!context || !context->update || !polygonCB)
 		return FALSE;
 
-	wParam = (POLYGON_CB_ORDER*)malloc(sizeof(POLYGON_CB_ORDER));
+	/* The points are stored behind the order */
+	wParam = (POLYGON_CB_ORDER*)update_message_alloc(
+	    context, sizeof(POLYGON_CB_ORDER) + sizeof(DELTA_POINT) * polygonCB->numPoints);
 
 	if (!wParam)
 		return FALSE;
 
 	CopyMemory(wParam, polygonCB, sizeof(POLYGON_CB_ORDER));
-	wParam->points = (DELTA_POINT*)calloc(wParam->numPoints, sizeof(DELTA_POINT));
-
-	if (!wParam->points)
-	{
-		free(wParam);
-		return FALSE;
-	}
-
-	CopyMemory(wParam->points, polygonCB, sizeof(DELTA_POINT) * wParam->numPoints);
+	wParam->points = (DELTA_POINT*)&wParam[1];
+	CopyMemory(wParam->points, polygonCB->points, sizeof(DELTA_POINT) * wParam->numPoints);
 	wParam->brush.data = (BYTE*)wParam->brush.p8x8;
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(PrimaryUpdate, PolygonCB), (void*)wParam, NULL);
+	return update_message_post(context, MakeMessageId(PrimaryUpdate, PolygonCB), (void*)wParam,
+	                           NULL);
 }
 
 static BOOL update_message_EllipseSC(rdpContext* context, const ELLIPSE_SC_ORDER* ellipseSC)
@@ -680,14 +913,14 @@ static BOOL update_message_EllipseSC(rdpContext* context, const ELLIPSE_SC_ORDER
 	if (!context || !context->update || !ellipseSC)
 		return FALSE;
 
-	wParam = (ELLIPSE_SC_ORDER*)malloc(sizeof(ELLIPSE_SC_ORDER));
+	wParam = (ELLIPSE_SC_ORDER*)update_message_alloc(context, sizeof(ELLIPSE_SC_ORDER));
 
 	if (!wParam)
 		return FALSE;
 
 	CopyMemory(wParam, ellipseSC, sizeof(ELLIPSE_SC_ORDER));
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(PrimaryUpdate, EllipseSC), (void*)wParam, NULL);
+	return update_message_post(context, MakeMessageId(PrimaryUpdate, EllipseSC), (void*)wParam,
+	                           NULL);
 }
 
 static BOOL update_message_EllipseCB(rdpContext* context, const ELLIPSE_CB_ORDER* ellipseCB)
@@ -697,15 +930,15 @@ static BOOL update_message_EllipseCB(rdpContext* context, const ELLIPSE_CB_ORDER
 	if (!context || !context->update || !ellipseCB)
 		return FALSE;
 
-	wParam = (ELLIPSE_CB_ORDER*)malloc(sizeof(ELLIPSE_CB_ORDER));
+	wParam = (ELLIPSE_CB_ORDER*)update_message_alloc(context, sizeof(ELLIPSE_CB_ORDER));
 
 	if (!wParam)
 		return FALSE;
 
 	CopyMemory(wParam, ellipseCB, sizeof(ELLIPSE_CB_ORDER));
 	wParam->brush.data = (BYTE*)wParam->brush.p8x8;
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(PrimaryUpdate, EllipseCB), (void*)wParam, NULL);
+	return update_message_post(context, MakeMessageId(PrimaryUpdate, EllipseCB), (void*)wParam,
+	                           NULL);
 }
 
 /* Secondary Update */
@@ -723,8 +956,8 @@ static BOOL update_message_CacheBitmap(rdpContext* context,
 	if (!wParam)
 		return FALSE;
 
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(SecondaryUpdate, CacheBitmap), (void*)wParam, NULL);
+	return update_message_post(context, MakeMessageId(SecondaryUpdate, CacheBitmap), (void*)wParam,
+	                           NULL);
 }
 
 static BOOL update_message_CacheBitmapV2(rdpContext* context,
@@ -740,8 +973,8 @@ static BOOL update_message_CacheBitmapV2(rdpContext* context,
 	if (!wParam)
 		return FALSE;
 
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(SecondaryUpdate, CacheBitmapV2), (void*)wParam, NULL);
+	return update_message_post(context, MakeMessageId(SecondaryUpdate, CacheBitmapV2),
+	                           (void*)wParam, NULL);
 }
 
 static BOOL update_message_CacheBitmapV3(rdpContext* context,
@@ -757,8 +990,8 @@ static BOOL update_message_CacheBitmapV3(rdpContext* context,
 	if (!wParam)
 		return FALSE;
 
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(SecondaryUpdate, CacheBitmapV3), (void*)wParam, NULL);
+	return update_message_post(context, MakeMessageId(SecondaryUpdate, CacheBitmapV3),
+	                           (void*)wParam, NULL);
 }
 
 static BOOL update_message_CacheColorTable(rdpContext* context,
@@ -774,8 +1007,8 @@ static BOOL update_message_CacheColorTable(rdpContext* context,
 	if (!wParam)
 		return FALSE;
 
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(SecondaryUpdate, CacheColorTable), (void*)wParam, NULL);
+	return update_message_post(context, MakeMessageId(SecondaryUpdate, CacheColorTable),
+	                           (void*)wParam, NULL);
 }
 
 static BOOL update_message_CacheGlyph(rdpContext* context, const CACHE_GLYPH_ORDER* cacheGlyphOrder)
@@ -790,8 +1023,8 @@ static BOOL update_message_CacheGlyph(rdpContext* context, const CACHE_GLYPH_ORD
 	if (!wParam)
 		return FALSE;
 
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(SecondaryUpdate, CacheGlyph), (void*)wParam, NULL);
+	return update_message_post(context, MakeMessageId(SecondaryUpdate, CacheGlyph), (void*)wParam,
+	                           NULL);
 }
 
 static BOOL update_message_CacheGlyphV2(rdpContext* context,
@@ -807,8 +1040,8 @@ static BOOL update_message_CacheGlyphV2(rdpContext* context,
 	if (!wParam)
 		return FALSE;
 
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(SecondaryUpdate, CacheGlyphV2), (void*)wParam, NULL);
+	return update_message_post(context, MakeMessageId(SecondaryUpdate, CacheGlyphV2), (void*)wParam,
+	                           NULL);
 }
 
 static BOOL update_message_CacheBrush(rdpContext* context, const CACHE_BRUSH_ORDER* cacheBrushOrder)
@@ -823,8 +1056,8 @@ static BOOL update_message_CacheBrush(rdpContext* context, const CACHE_BRUSH_ORD
 	if (!wParam)
 		return FALSE;
 
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(SecondaryUpdate, CacheBrush), (void*)wParam, NULL);
+	return update_message_post(context, MakeMessageId(SecondaryUpdate, CacheBrush), (void*)wParam,
+	                           NULL);
 }
 
 /* Alternate Secondary Update */
@@ -856,9 +1089,8 @@ update_message_CreateOffscreenBitmap(rdpContext* context,
 
 	CopyMemory(wParam->deleteList.indices, createOffscreenBitmap->deleteList.indices,
 	           wParam->deleteList.cIndices);
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(AltSecUpdate, CreateOffscreenBitmap), (void*)wParam,
-	                         NULL);
+	return update_message_post(context, MakeMessageId(AltSecUpdate, CreateOffscreenBitmap),
+	                           (void*)wParam, NULL);
 }
 
 static BOOL update_message_SwitchSurface(rdpContext* context,
@@ -875,8 +1107,8 @@ static BOOL update_message_SwitchSurface(rdpContext* context,
 		return FALSE;
 
 	CopyMemory(wParam, switchSurface, sizeof(SWITCH_SURFACE_ORDER));
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(AltSecUpdate, SwitchSurface), (void*)wParam, NULL);
+	return update_message_post(context, MakeMessageId(AltSecUpdate, SwitchSurface), (void*)wParam,
+	                           NULL);
 }
 
 static BOOL
@@ -894,9 +1126,8 @@ update_message_CreateNineGridBitmap(rdpContext* context,
 		return FALSE;
 
 	CopyMemory(wParam, createNineGridBitmap, sizeof(CREATE_NINE_GRID_BITMAP_ORDER));
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(AltSecUpdate, CreateNineGridBitmap), (void*)wParam,
-	                         NULL);
+	return update_message_post(context, MakeMessageId(AltSecUpdate, CreateNineGridBitmap),
+	                           (void*)wParam, NULL);
 }
 
 static BOOL update_message_FrameMarker(rdpContext* context, const FRAME_MARKER_ORDER* frameMarker)
@@ -912,8 +1143,8 @@ static BOOL update_message_FrameMarker(rdpContext* context, const FRAME_MARKER_O
 		return FALSE;
 
 	CopyMemory(wParam, frameMarker, sizeof(FRAME_MARKER_ORDER));
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(AltSecUpdate, FrameMarker), (void*)wParam, NULL);
+	return update_message_post(context, MakeMessageId(AltSecUpdate, FrameMarker), (void*)wParam,
+	                           NULL);
 }
 
 static BOOL update_message_StreamBitmapFirst(rdpContext* context,
@@ -931,8 +1162,8 @@ static BOOL update_message_StreamBitmapFirst(rdpContext* context,
 
 	CopyMemory(wParam, streamBitmapFirst, sizeof(STREAM_BITMAP_FIRST_ORDER));
 	/* TODO: complete copy */
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(AltSecUpdate, StreamBitmapFirst), (void*)wParam, NULL);
+	return update_message_post(context, MakeMessageId(AltSecUpdate, StreamBitmapFirst),
+	                           (void*)wParam, NULL);
 }
 
 static BOOL update_message_StreamBitmapNext(rdpContext* context,
@@ -950,8 +1181,8 @@ static BOOL update_message_StreamBitmapNext(rdpContext* context,
 
 	CopyMemory(wParam, streamBitmapNext, sizeof(STREAM_BITMAP_NEXT_ORDER));
 	/* TODO: complete copy */
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(AltSecUpdate, StreamBitmapNext), (void*)wParam, NULL);
+	return update_message_post(context, MakeMessageId(AltSecUpdate, StreamBitmapNext),
+	                           (void*)wParam, NULL);
 }
 
 static BOOL update_message_DrawGdiPlusFirst(rdpContext* context,
@@ -969,8 +1200,8 @@ static BOOL update_message_DrawGdiPlusFirst(rdpContext* context,
 
 	CopyMemory(wParam, drawGdiPlusFirst, sizeof(DRAW_GDIPLUS_FIRST_ORDER));
 	/* TODO: complete copy */
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(AltSecUpdate, DrawGdiPlusFirst), (void*)wParam, NULL);
+	return update_message_post(context, MakeMessageId(AltSecUpdate, DrawGdiPlusFirst),
+	                           (void*)wParam, NULL);
 }
 
 static BOOL update_message_DrawGdiPlusNext(rdpContext* context,
@@ -988,8 +1219,8 @@ static BOOL update_message_DrawGdiPlusNext(rdpContext* context,
 
 	CopyMemory(wParam, drawGdiPlusNext, sizeof(DRAW_GDIPLUS_NEXT_ORDER));
 	/* TODO: complete copy */
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(AltSecUpdate, DrawGdiPlusNext), (void*)wParam, NULL);
+	return update_message_post(context, MakeMessageId(AltSecUpdate, DrawGdiPlusNext), (void*)wParam,
+	                           NULL);
 }
 
 static BOOL update_message_DrawGdiPlusEnd(rdpContext* context,
@@ -1007,8 +1238,8 @@ static BOOL update_message_DrawGdiPlusEnd(rdpContext* context,
 
 	CopyMemory(wParam, drawGdiPlusEnd, sizeof(DRAW_GDIPLUS_END_ORDER));
 	/* TODO: complete copy */
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(AltSecUpdate, DrawGdiPlusEnd), (void*)wParam, NULL);
+	return update_message_post(context, MakeMessageId(AltSecUpdate, DrawGdiPlusEnd), (void*)wParam,
+	                           NULL);
 }
 
 static BOOL
@@ -1027,9 +1258,8 @@ update_message_DrawGdiPlusCacheFirst(rdpContext* context,
 
 	CopyMemory(wParam, drawGdiPlusCacheFirst, sizeof(DRAW_GDIPLUS_CACHE_FIRST_ORDER));
 	/* TODO: complete copy */
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(AltSecUpdate, DrawGdiPlusCacheFirst), (void*)wParam,
-	                         NULL);
+	return update_message_post(context, MakeMessageId(AltSecUpdate, DrawGdiPlusCacheFirst),
+	                           (void*)wParam, NULL);
 }
 
 static BOOL
@@ -1048,9 +1278,8 @@ update_message_DrawGdiPlusCacheNext(rdpContext* context,
 
 	CopyMemory(wParam, drawGdiPlusCacheNext, sizeof(DRAW_GDIPLUS_CACHE_NEXT_ORDER));
 	/* TODO: complete copy */
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(AltSecUpdate, DrawGdiPlusCacheNext), (void*)wParam,
-	                         NULL);
+	return update_message_post(context, MakeMessageId(AltSecUpdate, DrawGdiPlusCacheNext),
+	                           (void*)wParam, NULL);
 }
 
 static BOOL
@@ -1069,8 +1298,8 @@ update_message_DrawGdiPlusCacheEnd(rdpContext* context,
 
 	CopyMemory(wParam, drawGdiPlusCacheEnd, sizeof(DRAW_GDIPLUS_CACHE_END_ORDER));
 	/* TODO: complete copy */
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(AltSecUpdate, DrawGdiPlusCacheEnd), (void*)wParam, NULL);
+	return update_message_post(context, MakeMessageId(AltSecUpdate, DrawGdiPlusCacheEnd),
+	                           (void*)wParam, NULL);
 }
 
 /* Window Update */
@@ -1099,9 +1328,8 @@ static BOOL update_message_WindowCreate(rdpContext* context, const WINDOW_ORDER_
 	}
 
 	CopyMemory(lParam, windowState, sizeof(WINDOW_STATE_ORDER));
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(WindowUpdate, WindowCreate), (void*)wParam,
-	                         (void*)lParam);
+	return update_message_post(context, MakeMessageId(WindowUpdate, WindowCreate), (void*)wParam,
+	                           (void*)lParam);
 }
 
 static BOOL update_message_WindowUpdate(rdpContext* context, const WINDOW_ORDER_INFO* orderInfo,
@@ -1128,9 +1356,8 @@ static BOOL update_message_WindowUpdate(rdpContext* context, const WINDOW_ORDER_
 	}
 
 	CopyMemory(lParam, windowState, sizeof(WINDOW_STATE_ORDER));
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(WindowUpdate, WindowUpdate), (void*)wParam,
-	                         (void*)lParam);
+	return update_message_post(context, MakeMessageId(WindowUpdate, WindowUpdate), (void*)wParam,
+	                           (void*)lParam);
 }
 
 static BOOL update_message_WindowIcon(rdpContext* context, const WINDOW_ORDER_INFO* orderInfo,
@@ -1194,8 +1421,8 @@ static BOOL update_message_WindowIcon(rdpContext* context, const WINDOW_ORDER_IN
 		           windowIcon->iconInfo->cbColorTable);
 	}
 
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(WindowUpdate, WindowIcon), (void*)wParam, (void*)lParam);
+	return update_message_post(context, MakeMessageId(WindowUpdate, WindowIcon), (void*)wParam,
+	                           (void*)lParam);
 out_fail:
 
 	if (lParam && lParam->iconInfo)
@@ -1235,9 +1462,8 @@ static BOOL update_message_WindowCachedIcon(rdpContext* context, const WINDOW_OR
 	}
 
 	CopyMemory(lParam, windowCachedIcon, sizeof(WINDOW_CACHED_ICON_ORDER));
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(WindowUpdate, WindowCachedIcon), (void*)wParam,
-	                         (void*)lParam);
+	return update_message_post(context, MakeMessageId(WindowUpdate, WindowCachedIcon),
+	                           (void*)wParam, (void*)lParam);
 }
 
 static BOOL update_message_WindowDelete(rdpContext* context, const WINDOW_ORDER_INFO* orderInfo)
@@ -1253,8 +1479,8 @@ static BOOL update_message_WindowDelete(rdpContext* context, const WINDOW_ORDER_
 		return FALSE;
 
 	CopyMemory(wParam, orderInfo, sizeof(WINDOW_ORDER_INFO));
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(WindowUpdate, WindowDelete), (void*)wParam, NULL);
+	return update_message_post(context, MakeMessageId(WindowUpdate, WindowDelete), (void*)wParam,
+	                           NULL);
 }
 
 static BOOL update_message_NotifyIconCreate(rdpContext* context, const WINDOW_ORDER_INFO* orderInfo,
@@ -1281,9 +1507,8 @@ static BOOL update_message_NotifyIconCreate(rdpContext* context, const WINDOW_OR
 	}
 
 	CopyMemory(lParam, notifyIconState, sizeof(NOTIFY_ICON_STATE_ORDER));
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(WindowUpdate, NotifyIconCreate), (void*)wParam,
-	                         (void*)lParam);
+	return update_message_post(context, MakeMessageId(WindowUpdate, NotifyIconCreate),
+	                           (void*)wParam, (void*)lParam);
 }
 
 static BOOL update_message_NotifyIconUpdate(rdpContext* context, const WINDOW_ORDER_INFO* orderInfo,
@@ -1310,9 +1535,8 @@ static BOOL update_message_NotifyIconUpdate(rdpContext* context, const WINDOW_OR
 	}
 
 	CopyMemory(lParam, notifyIconState, sizeof(NOTIFY_ICON_STATE_ORDER));
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(WindowUpdate, NotifyIconUpdate), (void*)wParam,
-	                         (void*)lParam);
+	return update_message_post(context, MakeMessageId(WindowUpdate, NotifyIconUpdate),
+	                           (void*)wParam, (void*)lParam);
 }
 
 static BOOL update_message_NotifyIconDelete(rdpContext* context, const WINDOW_ORDER_INFO* orderInfo)
@@ -1328,8 +1552,8 @@ static BOOL update_message_NotifyIconDelete(rdpContext* context, const WINDOW_OR
 		return FALSE;
 
 	CopyMemory(wParam, orderInfo, sizeof(WINDOW_ORDER_INFO));
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(WindowUpdate, NotifyIconDelete), (void*)wParam, NULL);
+	return update_message_post(context, MakeMessageId(WindowUpdate, NotifyIconDelete),
+	                           (void*)wParam, NULL);
 }
 
 static BOOL update_message_MonitoredDesktop(rdpContext* context, const WINDOW_ORDER_INFO* orderInfo,
@@ -1364,9 +1588,8 @@ static BOOL update_message_MonitoredDesktop(rdpContext* context, const WINDOW_OR
 		CopyMemory(lParam->windowIds, monitoredDesktop->windowIds, lParam->numWindowIds);
 	}
 
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(WindowUpdate, MonitoredDesktop), (void*)wParam,
-	                         (void*)lParam);
+	return update_message_post(context, MakeMessageId(WindowUpdate, MonitoredDesktop),
+	                           (void*)wParam, (void*)lParam);
 }
 
 static BOOL update_message_NonMonitoredDesktop(rdpContext* context,
@@ -1383,8 +1606,8 @@ static BOOL update_message_NonMonitoredDesktop(rdpContext* context,
 		return FALSE;
 
 	CopyMemory(wParam, orderInfo, sizeof(WINDOW_ORDER_INFO));
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(WindowUpdate, NonMonitoredDesktop), (void*)wParam, NULL);
+	return update_message_post(context, MakeMessageId(WindowUpdate, NonMonitoredDesktop),
+	                           (void*)wParam, NULL);
 }
 
 /* Pointer Update */
@@ -1402,8 +1625,8 @@ static BOOL update_message_PointerPosition(rdpContext* context,
 	if (!wParam)
 		return FALSE;
 
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(PointerUpdate, PointerPosition), (void*)wParam, NULL);
+	return update_message_post(context, MakeMessageId(PointerUpdate, PointerPosition),
+	                           (void*)wParam, NULL);
 }
 
 static BOOL update_message_PointerSystem(rdpContext* context,
@@ -1419,8 +1642,8 @@ static BOOL update_message_PointerSystem(rdpContext* context,
 	if (!wParam)
 		return FALSE;
 
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(PointerUpdate, PointerSystem), (void*)wParam, NULL);
+	return update_message_post(context, MakeMessageId(PointerUpdate, PointerSystem), (void*)wParam,
+	                           NULL);
 }
 
 static BOOL update_message_PointerColor(rdpContext* context,
@@ -1436,8 +1659,8 @@ static BOOL update_message_PointerColor(rdpContext* context,
 	if (!wParam)
 		return FALSE;
 
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(PointerUpdate, PointerColor), (void*)wParam, NULL);
+	return update_message_post(context, MakeMessageId(PointerUpdate, PointerColor), (void*)wParam,
+	                           NULL);
 }
 
 static BOOL update_message_PointerLarge(rdpContext* context, const POINTER_LARGE_UPDATE* pointer)
@@ -1452,8 +1675,8 @@ static BOOL update_message_PointerLarge(rdpContext* context, const POINTER_LARGE
 	if (!wParam)
 		return FALSE;
 
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(PointerUpdate, PointerLarge), (void*)wParam, NULL);
+	return update_message_post(context, MakeMessageId(PointerUpdate, PointerLarge), (void*)wParam,
+	                           NULL);
 }
 
 static BOOL update_message_PointerNew(rdpContext* context, const POINTER_NEW_UPDATE* pointerNew)
@@ -1468,8 +1691,8 @@ static BOOL update_message_PointerNew(rdpContext* context, const POINTER_NEW_UPD
 	if (!wParam)
 		return FALSE;
 
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(PointerUpdate, PointerNew), (void*)wParam, NULL);
+	return update_message_post(context, MakeMessageId(PointerUpdate, PointerNew), (void*)wParam,
+	                           NULL);
 }
 
 static BOOL update_message_PointerCached(rdpContext* context,
@@ -1485,8 +1708,8 @@ static BOOL update_message_PointerCached(rdpContext* context,
 	if (!wParam)
 		return FALSE;
 
-	return MessageQueue_Post(context->update->queue, (void*)context,
-	                         MakeMessageId(PointerUpdate, PointerCached), (void*)wParam, NULL);
+	return update_message_post(context, MakeMessageId(PointerUpdate, PointerCached), (void*)wParam,
+	                           NULL);
 }
 
 /* Message Queue */
@@ -1718,12 +1941,8 @@ static BOOL update_message_free_primary_update_class(wMessage* msg, int type)
 			break;
 
 		case PrimaryUpdate_Polyline:
-		{
-			POLYLINE_ORDER* wParam = (POLYLINE_ORDER*)msg->wParam;
-			free(wParam->points);
-			free(wParam);
-		}
-		break;
+			free(msg->wParam);
+			break;
 
 		case PrimaryUpdate_MemBlt:
 			free(msg->wParam);
@@ -1746,28 +1965,16 @@ static BOOL update_message_free_primary_update_class(wMessage* msg, int type)
 			break;
 
 		case PrimaryUpdate_FastGlyph:
-		{
-			FAST_GLYPH_ORDER* wParam = (FAST_GLYPH_ORDER*)msg->wParam;
-			free(wParam->glyphData.aj);
-			free(wParam);
-		}
-		break;
+			free(msg->wParam);
+			break;
 
 		case PrimaryUpdate_PolygonSC:
-		{
-			POLYGON_SC_ORDER* wParam = (POLYGON_SC_ORDER*)msg->wParam;
-			free(wParam->points);
-			free(wParam);
-		}
-		break;
+			free(msg->wParam);
+			break;
 
 		case PrimaryUpdate_PolygonCB:
-		{
-			POLYGON_CB_ORDER* wParam = (POLYGON_CB_ORDER*)msg->wParam;
-			free(wParam->points);
-			free(wParam);
-		}
-		break;
+			free(msg->wParam);
+			break;
 
 		case PrimaryUpdate_EllipseSC:
 			free(msg->wParam);
@@ -2430,6 +2637,24 @@ static int update_message_process_class(rdpUpdateProxy* proxy, wMessage* msg, in
 	return 0;
 }
 
+static int update_message_process_frame(rdpUpdate* update, UPDATE_MESSAGE_FRAME* frame)
+{
+	int status = 1;
+	UPDATE_MESSAGE_RECORD* record;
+
+	for (record = frame->head; record; record = record->next)
+	{
+		wMessage* msg = &record->message;
+
+		if (update_message_process_class(update->proxy, msg, GetMessageClass(msg->id),
+		                                 GetMessageType(msg->id)) < 0)
+			status = -1;
+	}
+
+	update_message_frame_release(frame);
+	return status;
+}
+
 int update_message_queue_process_message(rdpUpdate* update, wMessage* message)
 {
 	int status;
@@ -2442,6 +2667,9 @@ int update_message_queue_process_message(rdpUpdate* update, wMessage* message)
 	if (message->id == WMQ_QUIT)
 		return 0;
 
+	if (message->id == MakeMessageId(Update, Frame))
+		return update_message_process_frame(update, (UPDATE_MESSAGE_FRAME*)message->wParam);
+
 	msgClass = GetMessageClass(message->id);
 	msgType = GetMessageType(message->id);
 	status = update_message_process_class(update->proxy, message, msgClass, msgType);
@@ -2464,6 +2692,12 @@ int update_message_queue_free_message(wMessage* message)
 	if (message->id == WMQ_QUIT)
 		return 0;
 
+	if (message->id == MakeMessageId(Update, Frame))
+	{
+		update_message_frame_release((UPDATE_MESSAGE_FRAME*)message->wParam);
+		return 1;
+	}
+
 	msgClass = GetMessageClass(message->id);
 	msgType = GetMessageType(message->id);
 	return update_message_free_class(message, msgClass, msgType);
@@ -2706,11 +2940,19 @@ rdpUpdateProxy* update_message_proxy_new(rdpUpdate* update)
 		return NULL;
 
 	message->update = update;
+
+	if (!InitializeCriticalSectionAndSpinCount(&message->lock, 4000))
+	{
+		free(message);
+		return NULL;
+	}
+
 	update_message_register_interface(message, update);
 
 	if (!(message->thread = CreateThread(NULL, 0, update_message_proxy_thread, update, 0, NULL)))
 	{
 		WLog_ERR(TAG, "Failed to create proxy thread");
+		DeleteCriticalSection(&message->lock);
 		free(message);
 		return NULL;
 	}
@@ -2726,6 +2968,19 @@ void update_message_proxy_free(rdpUpdateProxy* message)
 			WaitForSingleObject(message->thread, INFINITE);
 
 		CloseHandle(message->thread);
+
+		/* Frames left in the queue are returned to this proxy, drop them before it goes away */
+		MessageQueue_Clear(message->update->queue);
+		update_message_frame_release(message->frame);
+
+		while (message->freeFrames)
+		{
+			UPDATE_MESSAGE_FRAME* frame = message->freeFrames;
+			message->freeFrames = frame->next;
+			update_message_frame_free(frame);
+		}
+
+		DeleteCriticalSection(&message->lock);
 		free(message);
 	}
 }
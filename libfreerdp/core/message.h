@@ -28,6 +28,11 @@
  * Update Message Queue
  */
 
+/* Messages recorded between BeginPaint and EndPaint, posted as a single message */
+#define Update_Frame 0x80
+
+typedef struct _UPDATE_MESSAGE_FRAME UPDATE_MESSAGE_FRAME;
+
 /* Update Proxy Interface */
 
 struct rdp_update_proxy
@@ -126,6 +131,15 @@ struct rdp_update_proxy
 	pPointerLarge PointerLarge;
 
 	HANDLE thread;
+
+	/* Frame being recorded by the thread that called BeginPaint */
+	UPDATE_MESSAGE_FRAME* frame;
+	DWORD frameThreadId;
+
+	/* Frames handed back by the proxy thread for reuse */
+	CRITICAL_SECTION lock;
+	UPDATE_MESSAGE_FRAME* freeFrames;
+	UINT32 freeFrameCount;
 };
 
 FREERDP_LOCAL int update_message_queue_process_message(rdpUpdate* update, wMessage* message);
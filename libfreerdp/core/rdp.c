@@ -1480,6 +1480,10 @@ static int rdp_recv_fastpath_pdu(rdpRdp* rdp, wStream* s)
 		}
 	}
 
+	if (rdp->sessionDump)
+		session_dump_write(rdp->sessionDump, SESSION_DUMP_FASTPATH, Stream_Pointer(s),
+		                   Stream_GetRemainingLength(s));
+
 	return fastpath_recv_updates(rdp->fastpath, s);
 }
 
@@ -1564,6 +1568,9 @@ int rdp_recv_callback(rdpTransport* transport, wStream* s, void* extra)
 				nla_free(rdp->nla);
 				rdp->nla = NULL;
 
+				if (!transport_start_async_io(rdp->transport))
+					return -1;
+
 				if (!mcs_client_begin(rdp->mcs))
 				{
 					WLog_ERR(TAG, "%s: %s - mcs_client_begin() fail", __FUNCTION__,
@@ -1752,6 +1759,31 @@ BOOL freerdp_get_stats(rdpRdp* rdp, UINT64* inBytes, UINT64* outBytes, UINT64* i
 	return TRUE;
 }
 
+BOOL freerdp_session_dump(rdpContext* context, BYTE type, const BYTE* data, size_t length)
+{
+	if (!context || !context->rdp || !context->rdp->sessionDump)
+		return TRUE;
+
+	return session_dump_write(context->rdp->sessionDump, type, data, length);
+}
+
+BOOL rdp_session_dump_desktop(rdpRdp* rdp)
+{
+	if (!rdp || !rdp->sessionDump)
+		return TRUE;
+
+	return session_dump_write_desktop(rdp->sessionDump, rdp->settings->DesktopWidth,
+	                                  rdp->settings->DesktopHeight, rdp->settings->ColorDepth);
+}
+
+int freerdp_session_replay_fastpath(rdpContext* context, wStream* s)
+{
+	if (!context || !context->rdp)
+		return -1;
+
+	return fastpath_recv_updates(context->rdp->fastpath, s);
+}
+
 /**
  * Instantiate new RDP module.
  * @return new RDP module
@@ -1942,6 +1974,7 @@ void rdp_free(rdpRdp* rdp)
 	if (rdp)
 	{
 		DeleteCriticalSection(&rdp->critical);
+		session_dump_close(rdp->sessionDump);
 		winpr_RC4_Free(rdp->rc4_decrypt_key);
 		winpr_RC4_Free(rdp->rc4_encrypt_key);
 		winpr_Cipher_Free(rdp->fips_encrypt);
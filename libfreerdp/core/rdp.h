@@ -50,6 +50,7 @@
 #include <freerdp/settings.h>
 #include <freerdp/log.h>
 #include <freerdp/api.h>
+#include <freerdp/utils/session_dump.h>
 
 #include <winpr/stream.h>
 #include <winpr/crypto.h>
@@ -180,6 +181,7 @@ struct rdp_rdp
 	UINT64 outBytes;
 	UINT64 outPackets;
 	CRITICAL_SECTION critical;
+	rdpSessionDump* sessionDump;
 };
 
 FREERDP_LOCAL BOOL rdp_read_security_header(wStream* s, UINT16* flags, UINT16* length);
@@ -220,6 +222,8 @@ FREERDP_LOCAL int rdp_recv_callback(rdpTransport* transport, wStream* s, void* e
 
 FREERDP_LOCAL int rdp_check_fds(rdpRdp* rdp);
 
+FREERDP_LOCAL BOOL rdp_session_dump_desktop(rdpRdp* rdp);
+
 FREERDP_LOCAL rdpRdp* rdp_new(rdpContext* context);
 FREERDP_LOCAL void rdp_reset(rdpRdp* rdp);
 FREERDP_LOCAL void rdp_free(rdpRdp* rdp);
@@ -82,6 +82,8 @@
 #include <freerdp/log.h>
 
 #include <winpr/stream.h>
+#include <winpr/sysinfo.h>
+#include <winpr/thread.h>
 
 #include "tcp.h"
 #include "../crypto/opensslcompat.h"
@@ -659,6 +661,479 @@ BIO_METHOD* BIO_s_buffered_socket(void)
 	return bio_methods;
 }
 
+/* Asynchronous I/O BIO
+ *
+ * Sits on top of an established (TLS) BIO chain and moves the record layer work
+ * onto a dedicated worker thread: the worker is the only one touching the chain
+ * below, decrypting incoming records into recvBuffer and encrypting whatever the
+ * session thread queued in xmitBuffer. The session thread only copies plaintext
+ * in and out of the ring buffers and is woken up through hReadEvent.
+ */
+
+#define ASYNC_IO_CHUNK_SIZE 0x4000
+#define ASYNC_IO_RECV_LIMIT 0x400000
+#define ASYNC_IO_XMIT_LIMIT 0x400000
+#define ASYNC_IO_FLUSH_TIMEOUT 1000
+
+struct _WINPR_BIO_ASYNC_IO
+{
+	BIO* nextBio;
+	HANDLE thread;
+	HANDLE hStopEvent;
+	HANDLE hWakeEvent;
+	HANDLE hReadEvent;
+	HANDLE hDrainEvent;
+	CRITICAL_SECTION lock;
+	RingBuffer recvBuffer;
+	RingBuffer xmitBuffer;
+	BOOL recvFull;
+	BOOL failed;
+	BYTE recvChunk[ASYNC_IO_CHUNK_SIZE];
+	BYTE xmitChunk[ASYNC_IO_CHUNK_SIZE];
+};
+typedef struct _WINPR_BIO_ASYNC_IO WINPR_BIO_ASYNC_IO;
+
+static BOOL transport_bio_async_recv(WINPR_BIO_ASYNC_IO* ptr)
+{
+	int status;
+
+	for (;;)
+	{
+		BOOL full;
+		EnterCriticalSection(&ptr->lock);
+		full = ptr->recvFull = (ringbuffer_used(&ptr->recvBuffer) >= ASYNC_IO_RECV_LIMIT);
+		LeaveCriticalSection(&ptr->lock);
+
+		if (full)
+			return TRUE;
+
+		status = BIO_read(ptr->nextBio, ptr->recvChunk, sizeof(ptr->recvChunk));
+
+		if (status <= 0)
+			return BIO_should_retry(ptr->nextBio) ? TRUE : FALSE;
+
+		EnterCriticalSection(&ptr->lock);
+
+		if (!ringbuffer_write(&ptr->recvBuffer, ptr->recvChunk, (size_t)status))
+		{
+			LeaveCriticalSection(&ptr->lock);
+			WLog_ERR(TAG, "unable to queue %d received bytes", status);
+			return FALSE;
+		}
+
+		SetEvent(ptr->hReadEvent);
+		LeaveCriticalSection(&ptr->lock);
+	}
+}
+
+static BOOL transport_bio_async_xmit(WINPR_BIO_ASYNC_IO* ptr, BOOL* pending)
+{
+	int i;
+	int nchunks;
+	int status;
+	size_t length;
+	DataChunk chunks[2];
+
+	for (;;)
+	{
+		/* The ring buffer may be reallocated by the session thread as soon as the
+		 * lock is released, so copy the next chunk out before encrypting it. */
+		EnterCriticalSection(&ptr->lock);
+		length = ringbuffer_used(&ptr->xmitBuffer);
+
+		if (length > sizeof(ptr->xmitChunk))
+			length = sizeof(ptr->xmitChunk);
+
+		nchunks = ringbuffer_peek(&ptr->xmitBuffer, chunks, length);
+		length = 0;
+
+		for (i = 0; i < nchunks; i++)
+		{
+			CopyMemory(&ptr->xmitChunk[length], chunks[i].data, chunks[i].size);
+			length += chunks[i].size;
+		}
+
+		LeaveCriticalSection(&ptr->lock);
+
+		if (!length)
+			break;
+
+		status = BIO_write(ptr->nextBio, ptr->xmitChunk, (int)length);
+
+		if (status <= 0)
+		{
+			if (!BIO_should_retry(ptr->nextBio))
+				return FALSE;
+
+			break;
+		}
+
+		EnterCriticalSection(&ptr->lock);
+		ringbuffer_commit_read_bytes(&ptr->xmitBuffer, (size_t)status);
+
+		if (ringbuffer_used(&ptr->xmitBuffer) <= ASYNC_IO_XMIT_LIMIT)
+			SetEvent(ptr->hDrainEvent);
+
+		LeaveCriticalSection(&ptr->lock);
+	}
+
+	if (BIO_write_blocked(ptr->nextBio))
+	{
+		if (BIO_flush(ptr->nextBio) < 0)
+			return FALSE;
+	}
+
+	EnterCriticalSection(&ptr->lock);
+	*pending = (ringbuffer_used(&ptr->xmitBuffer) > 0) || BIO_write_blocked(ptr->nextBio);
+	LeaveCriticalSection(&ptr->lock);
+	return TRUE;
+}
+
+static DWORD WINAPI transport_bio_async_thread(LPVOID arg)
+{
+	DWORD status;
+	DWORD nCount;
+	HANDLE events[3];
+	HANDLE hSocketEvent = NULL;
+	BOOL pending = FALSE;
+	WINPR_BIO_ASYNC_IO* ptr = (WINPR_BIO_ASYNC_IO*)arg;
+
+	BIO_get_event(ptr->nextBio, &hSocketEvent);
+
+	for (;;)
+	{
+		/* Drain before waiting: the handshake may already have pulled application
+		 * data into the TLS layer, which will not show up on the socket event. */
+		if (!transport_bio_async_recv(ptr))
+			goto fail;
+
+		if (!transport_bio_async_xmit(ptr, &pending))
+			goto fail;
+
+		nCount = 0;
+		events[nCount++] = ptr->hStopEvent;
+		events[nCount++] = ptr->hWakeEvent;
+
+		if (!ptr->recvFull && hSocketEvent)
+			events[nCount++] = hSocketEvent;
+
+		status = WaitForMultipleObjects(nCount, events, FALSE, pending ? 10 : INFINITE);
+
+		if (status == WAIT_FAILED)
+		{
+			WLog_ERR(TAG, "WaitForMultipleObjects failed with %" PRIu32 "", GetLastError());
+			goto fail;
+		}
+
+		if (WaitForSingleObject(ptr->hStopEvent, 0) == WAIT_OBJECT_0)
+			break;
+
+		/* anything queued after this point signals the event again */
+		ResetEvent(ptr->hWakeEvent);
+	}
+
+	/* Push out whatever the session queued before it closed the connection. */
+	{
+		const UINT64 deadline = GetTickCount64() + ASYNC_IO_FLUSH_TIMEOUT;
+
+		while (transport_bio_async_xmit(ptr, &pending) && pending)
+		{
+			if (GetTickCount64() > deadline)
+				break;
+
+			BIO_wait_write(ptr->nextBio, 10);
+		}
+	}
+
+	ExitThread(0);
+	return 0;
+fail:
+	EnterCriticalSection(&ptr->lock);
+	ptr->failed = TRUE;
+	SetEvent(ptr->hReadEvent);
+	SetEvent(ptr->hDrainEvent);
+	LeaveCriticalSection(&ptr->lock);
+	ExitThread(1);
+	return 1;
+}
+
+static int transport_bio_async_start(BIO* bio, BIO* next_bio)
+{
+	WINPR_BIO_ASYNC_IO* ptr = (WINPR_BIO_ASYNC_IO*)BIO_get_data(bio);
+
+	if (!ptr || !next_bio || ptr->thread)
+		return -1;
+
+	ptr->nextBio = next_bio;
+	BIO_set_nonblock(next_bio, TRUE);
+
+	if (!(ptr->thread = CreateThread(NULL, 0, transport_bio_async_thread, ptr, 0, NULL)))
+	{
+		WLog_ERR(TAG, "unable to create async I/O thread");
+		ptr->nextBio = NULL;
+		return -1;
+	}
+
+	return 1;
+}
+
+static void transport_bio_async_stop(WINPR_BIO_ASYNC_IO* ptr)
+{
+	if (!ptr->thread)
+		return;
+
+	SetEvent(ptr->hStopEvent);
+	WaitForSingleObject(ptr->thread, INFINITE);
+	CloseHandle(ptr->thread);
+	ptr->thread = NULL;
+}
+
+static int transport_bio_async_write(BIO* bio, const char* buf, int num)
+{
+	int status = num;
+	WINPR_BIO_ASYNC_IO* ptr = (WINPR_BIO_ASYNC_IO*)BIO_get_data(bio);
+	BIO_clear_flags(bio, BIO_FLAGS_WRITE | BIO_FLAGS_SHOULD_RETRY);
+
+	if (!buf || (num <= 0))
+		return 0;
+
+	EnterCriticalSection(&ptr->lock);
+
+	if (ptr->failed)
+		status = -1;
+	else if (!ringbuffer_write(&ptr->xmitBuffer, (const BYTE*)buf, (size_t)num))
+	{
+		WLog_ERR(TAG, "an error occurred when writing (num: %d)", num);
+		status = -1;
+	}
+	else
+	{
+		/* Writes are never refused, the session thread backs off through
+		 * BIO_write_blocked / BIO_wait_write instead. */
+		if (ringbuffer_used(&ptr->xmitBuffer) > ASYNC_IO_XMIT_LIMIT)
+			ResetEvent(ptr->hDrainEvent);
+
+		SetEvent(ptr->hWakeEvent);
+	}
+
+	LeaveCriticalSection(&ptr->lock);
+	return status;
+}
+
+static int transport_bio_async_read(BIO* bio, char* buf, int size)
+{
+	int i;
+	int nchunks;
+	int status = 0;
+	DataChunk chunks[2];
+	BOOL wakeup = FALSE;
+	WINPR_BIO_ASYNC_IO* ptr = (WINPR_BIO_ASYNC_IO*)BIO_get_data(bio);
+	BIO_clear_flags(bio, BIO_FLAGS_READ | BIO_FLAGS_SHOULD_RETRY);
+
+	if (!buf || (size <= 0))
+		return 0;
+
+	EnterCriticalSection(&ptr->lock);
+	nchunks = ringbuffer_peek(&ptr->recvBuffer, chunks, (size_t)size);
+
+	for (i = 0; i < nchunks; i++)
+	{
+		CopyMemory(&buf[status], chunks[i].data, chunks[i].size);
+		status += (int)chunks[i].size;
+	}
+
+	ringbuffer_commit_read_bytes(&ptr->recvBuffer, (size_t)status);
+
+	if (ringbuffer_used(&ptr->recvBuffer) == 0)
+	{
+		if (!ptr->failed)
+			ResetEvent(ptr->hReadEvent);
+
+		if (status == 0)
+		{
+			if (!ptr->failed)
+				BIO_set_flags(bio, BIO_FLAGS_READ | BIO_FLAGS_SHOULD_RETRY);
+
+			status = -1;
+		}
+	}
+
+	wakeup = ptr->recvFull && (ringbuffer_used(&ptr->recvBuffer) < ASYNC_IO_RECV_LIMIT);
+	LeaveCriticalSection(&ptr->lock);
+
+	if (wakeup)
+		SetEvent(ptr->hWakeEvent);
+
+	return status;
+}
+
+static int transport_bio_async_puts(BIO* bio, const char* str)
+{
+	return 1;
+}
+
+static int transport_bio_async_gets(BIO* bio, char* str, int size)
+{
+	return 1;
+}
+
+static long transport_bio_async_ctrl(BIO* bio, int cmd, long arg1, void* arg2)
+{
+	long status = -1;
+	WINPR_BIO_ASYNC_IO* ptr = (WINPR_BIO_ASYNC_IO*)BIO_get_data(bio);
+
+	switch (cmd)
+	{
+		case BIO_C_START_ASYNC_IO:
+			status = transport_bio_async_start(bio, (BIO*)arg2);
+			break;
+
+		case BIO_C_GET_ASYNC_NEXT:
+			if (!arg2)
+				return 0;
+
+			*((BIO**)arg2) = ptr->nextBio;
+			status = 1;
+			break;
+
+		case BIO_C_GET_EVENT:
+			if (!arg2)
+				return 0;
+
+			*((HANDLE*)arg2) = ptr->hReadEvent;
+			status = 1;
+			break;
+
+		case BIO_C_SET_NONBLOCK:
+			/* reads never block and writes are always queued */
+			status = 1;
+			break;
+
+		case BIO_C_READ_BLOCKED:
+			EnterCriticalSection(&ptr->lock);
+			status = (ringbuffer_used(&ptr->recvBuffer) == 0) && !ptr->failed;
+			LeaveCriticalSection(&ptr->lock);
+			break;
+
+		case BIO_C_WRITE_BLOCKED:
+			EnterCriticalSection(&ptr->lock);
+			status = (ringbuffer_used(&ptr->xmitBuffer) > ASYNC_IO_XMIT_LIMIT) && !ptr->failed;
+			LeaveCriticalSection(&ptr->lock);
+			break;
+
+		case BIO_C_WAIT_READ:
+			status = (WaitForSingleObject(ptr->hReadEvent, (DWORD)arg1) == WAIT_OBJECT_0) ? 1 : 0;
+			break;
+
+		case BIO_C_WAIT_WRITE:
+			status = (WaitForSingleObject(ptr->hDrainEvent, (DWORD)arg1) == WAIT_OBJECT_0) ? 1 : 0;
+			break;
+
+		case BIO_CTRL_FLUSH:
+			EnterCriticalSection(&ptr->lock);
+			status = ptr->failed ? -1 : 1;
+			LeaveCriticalSection(&ptr->lock);
+			break;
+
+		case BIO_CTRL_PENDING:
+			EnterCriticalSection(&ptr->lock);
+			status = (long)ringbuffer_used(&ptr->recvBuffer);
+			LeaveCriticalSection(&ptr->lock);
+			break;
+
+		case BIO_CTRL_WPENDING:
+			EnterCriticalSection(&ptr->lock);
+			status = (long)ringbuffer_used(&ptr->xmitBuffer);
+			LeaveCriticalSection(&ptr->lock);
+			break;
+
+		case BIO_C_GET_SOCKET:
+		case BIO_C_GET_FD:
+			status = ptr->nextBio ? BIO_ctrl(ptr->nextBio, cmd, arg1, arg2) : -1;
+			break;
+
+		default:
+			status = 0;
+			break;
+	}
+
+	return status;
+}
+
+static int transport_bio_async_new(BIO* bio)
+{
+	WINPR_BIO_ASYNC_IO* ptr;
+	BIO_set_init(bio, 1);
+	BIO_set_flags(bio, BIO_FLAGS_SHOULD_RETRY);
+	ptr = (WINPR_BIO_ASYNC_IO*)calloc(1, sizeof(WINPR_BIO_ASYNC_IO));
+
+	if (!ptr)
+		return -1;
+
+	BIO_set_data(bio, (void*)ptr);
+
+	if (!InitializeCriticalSectionAndSpinCount(&ptr->lock, 4000))
+		return -1;
+
+	if (!ringbuffer_init(&ptr->recvBuffer, 0x10000) ||
+	    !ringbuffer_init(&ptr->xmitBuffer, 0x10000))
+		return -1;
+
+	ptr->hStopEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+	ptr->hWakeEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+	ptr->hReadEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+	ptr->hDrainEvent = CreateEvent(NULL, TRUE, TRUE, NULL);
+
+	if (!ptr->hStopEvent || !ptr->hWakeEvent || !ptr->hReadEvent || !ptr->hDrainEvent)
+		return -1;
+
+	return 1;
+}
+
+/* Free the async BIO, stopping its worker thread.
+ * The BIO chain handed to BIO_start_async_io is not owned
+ * by this BIO and must be released by the caller. */
+static int transport_bio_async_free(BIO* bio)
+{
+	WINPR_BIO_ASYNC_IO* ptr = (WINPR_BIO_ASYNC_IO*)BIO_get_data(bio);
+
+	if (!ptr)
+		return 0;
+
+	transport_bio_async_stop(ptr);
+	CloseHandle(ptr->hStopEvent);
+	CloseHandle(ptr->hWakeEvent);
+	CloseHandle(ptr->hReadEvent);
+	CloseHandle(ptr->hDrainEvent);
+	ringbuffer_destroy(&ptr->recvBuffer);
+	ringbuffer_destroy(&ptr->xmitBuffer);
+	DeleteCriticalSection(&ptr->lock);
+	free(ptr);
+	BIO_set_data(bio, NULL);
+	return 1;
+}
+
+BIO_METHOD* BIO_s_async_io(void)
+{
+	static BIO_METHOD* bio_methods = NULL;
+
+	if (bio_methods == NULL)
+	{
+		if (!(bio_methods = BIO_meth_new(BIO_TYPE_ASYNC, "AsyncIO")))
+			return NULL;
+
+		BIO_meth_set_write(bio_methods, transport_bio_async_write);
+		BIO_meth_set_read(bio_methods, transport_bio_async_read);
+		BIO_meth_set_puts(bio_methods, transport_bio_async_puts);
+		BIO_meth_set_gets(bio_methods, transport_bio_async_gets);
+		BIO_meth_set_ctrl(bio_methods, transport_bio_async_ctrl);
+		BIO_meth_set_create(bio_methods, transport_bio_async_new);
+		BIO_meth_set_destroy(bio_methods, transport_bio_async_free);
+	}
+
+	return bio_methods;
+}
+
 char* freerdp_tcp_address_to_string(const struct sockaddr_storage* addr, BOOL* pIPv6)
 {
 	char ipAddress[INET6_ADDRSTRLEN + 1] = { 0 };
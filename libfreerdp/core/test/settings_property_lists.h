@@ -10,6 +10,7 @@ static const size_t bool_list_indices[] = {
 	FreeRDP_AltSecFrameMarkerSupport,
 	FreeRDP_AsyncChannels,
 	FreeRDP_AsyncInput,
+	FreeRDP_AsyncTransport,
 	FreeRDP_AsyncUpdate,
 	FreeRDP_AudioCapture,
 	FreeRDP_AudioPlayback,
@@ -309,6 +310,7 @@ static const size_t string_list_indices[] = {
 	FreeRDP_AlternateShell,
 	FreeRDP_AssistanceFile,
 	FreeRDP_AuthenticationServiceClass,
+	FreeRDP_BitmapCachePersistFile,
 	FreeRDP_CertificateAcceptedFingerprints,
 	FreeRDP_CertificateContent,
 	FreeRDP_CertificateFile,
@@ -324,6 +326,7 @@ static const size_t string_list_indices[] = {
 	FreeRDP_Domain,
 	FreeRDP_DrivesToRedirect,
 	FreeRDP_DumpRemoteFxFile,
+	FreeRDP_DumpSessionFile,
 	FreeRDP_DynamicDSTTimeZoneKeyName,
 	FreeRDP_GatewayAcceptedCert,
 	FreeRDP_GatewayAccessToken,
@@ -331,6 +334,7 @@ static const size_t string_list_indices[] = {
 	FreeRDP_GatewayHostname,
 	FreeRDP_GatewayPassword,
 	FreeRDP_GatewayUsername,
+	FreeRDP_GfxCachePersistFile,
 	FreeRDP_HomePath,
 	FreeRDP_ImeFileName,
 	FreeRDP_KerberosKdc,
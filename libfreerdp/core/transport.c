@@ -57,6 +57,8 @@
 #define TAG FREERDP_TAG("core.transport")
 
 #define BUFFER_SIZE 16384
+#define TRANSPORT_BATCH_MAX_SIZE 65536
+#define TRANSPORT_BATCH_MAX_DELAY 5 /* milliseconds */
 
 #ifdef WITH_GSSAPI
 
@@ -259,7 +261,37 @@ BOOL transport_connect_rdp(rdpTransport* transport)
 	return TRUE;
 }
 
-BOOL transport_connect_tls(rdpTransport* transport)
+/**
+ * Puts the async I/O BIO in front of the established TLS chain. Called once the connection
+ * no longer needs synchronous reads and writes, that is after TLS or NLA completed.
+ */
+
+BOOL transport_start_async_io(rdpTransport* transport)
+{
+	BIO* asyncBio;
+
+	if (!transport->settings->AsyncTransport || transport->GatewayEnabled)
+		return TRUE;
+
+	/* the chain is driven by a single worker, never wrap it twice */
+	if (!transport->frontBio || (BIO_method_type(transport->frontBio) == BIO_TYPE_ASYNC))
+		return TRUE;
+
+	if (!(asyncBio = BIO_new(BIO_s_async_io())))
+		return FALSE;
+
+	if (BIO_start_async_io(asyncBio, transport->frontBio) != 1)
+	{
+		WLog_Print(transport->log, WLOG_ERROR, "unable to start the async transport thread");
+		BIO_free(asyncBio);
+		return FALSE;
+	}
+
+	transport->frontBio = asyncBio;
+	return TRUE;
+}
+
+static BOOL transport_connect_tls_int(rdpTransport* transport)
 {
 	int tlsStatus;
 	rdpTls* tls = NULL;
@@ -312,6 +344,14 @@ BOOL transport_connect_tls(rdpTransport* transport)
 	return TRUE;
 }
 
+BOOL transport_connect_tls(rdpTransport* transport)
+{
+	if (!transport_connect_tls_int(transport))
+		return FALSE;
+
+	return transport_start_async_io(transport);
+}
+
 BOOL transport_connect_nla(rdpTransport* transport)
 {
 	rdpContext* context = transport->context;
@@ -319,11 +359,12 @@ BOOL transport_connect_nla(rdpTransport* transport)
 	freerdp* instance = context->instance;
 	rdpRdp* rdp = context->rdp;
 
-	if (!transport_connect_tls(transport))
+	/* NLA needs synchronous I/O, async I/O is started once it completed */
+	if (!transport_connect_tls_int(transport))
 		return FALSE;
 
 	if (!settings->Authentication)
-		return TRUE;
+		return transport_start_async_io(transport);
 
 	nla_free(rdp->nla);
 	rdp->nla = nla_new(instance, transport, settings);
@@ -461,7 +502,7 @@ BOOL transport_accept_tls(rdpTransport* transport)
 		return FALSE;
 
 	transport->frontBio = transport->tls->bio;
-	return TRUE;
+	return transport_start_async_io(transport);
 }
 
 BOOL transport_accept_nla(rdpTransport* transport)
@@ -482,7 +523,7 @@ BOOL transport_accept_nla(rdpTransport* transport)
 	/* Network Level Authentication */
 
 	if (!settings->Authentication)
-		return TRUE;
+		return transport_start_async_io(transport);
 
 	if (!transport->nla)
 	{
@@ -504,7 +545,7 @@ BOOL transport_accept_nla(rdpTransport* transport)
 
 	/* don't free nla module yet, we need to copy the credentials from it first */
 	transport_set_nla_mode(transport, FALSE);
-	return TRUE;
+	return transport_start_async_io(transport);
 }
 
 #define WLog_ERR_BIO(transport, biofunc, bio) \
@@ -792,40 +833,17 @@ int transport_read_pdu(rdpTransport* transport, wStream* s)
 	return Stream_Length(s);
 }
 
-int transport_write(rdpTransport* transport, wStream* s)
+/**
+ * Writes data to the front BIO, the caller must hold WriteLock.
+ */
+static int transport_write_layer(rdpTransport* transport, const BYTE* data, size_t length)
 {
-	size_t length;
 	int status = -1;
-	int writtenlength = 0;
-	rdpRdp* rdp = transport->context->rdp;
-
-	if (!s)
-		return -1;
-
-	if (!transport)
-		goto fail;
-
-	if (!transport->frontBio)
-	{
-		transport->layer = TRANSPORT_LAYER_CLOSED;
-		freerdp_set_last_error_if_not(transport->context, FREERDP_ERROR_CONNECT_TRANSPORT_FAILED);
-		goto fail;
-	}
-
-	EnterCriticalSection(&(transport->WriteLock));
-	length = Stream_GetPosition(s);
-	writtenlength = length;
-	Stream_SetPosition(s, 0);
-
-	if (length > 0)
-	{
-		rdp->outBytes += length;
-		WLog_Packet(transport->log, WLOG_TRACE, Stream_Buffer(s), length, WLOG_PACKET_OUTBOUND);
-	}
+	const size_t writtenlength = length;
 
 	while (length > 0)
 	{
-		status = BIO_write(transport->frontBio, Stream_Pointer(s), length);
+		status = BIO_write(transport->frontBio, data, length);
 
 		if (status <= 0)
 		{
@@ -877,7 +895,7 @@ int transport_write(rdpTransport* transport, wStream* s)
 		}
 
 		length -= status;
-		Stream_Seek(s, status);
+		data += status;
 	}
 
 	transport->written += writtenlength;
@@ -890,12 +908,183 @@ out_cleanup:
 		freerdp_set_last_error_if_not(transport->context, FREERDP_ERROR_CONNECT_TRANSPORT_FAILED);
 	}
 
+	return status;
+}
+
+/**
+ * Sends everything queued in the batch buffer, the caller must hold WriteLock.
+ */
+static int transport_batch_flush(rdpTransport* transport)
+{
+	int status = 0;
+	size_t length;
+
+	if (!transport->BatchBuffer)
+		return 0;
+
+	length = Stream_GetPosition(transport->BatchBuffer);
+
+	if (length > 0)
+		status = transport_write_layer(transport, Stream_Buffer(transport->BatchBuffer), length);
+
+	Stream_SetPosition(transport->BatchBuffer, 0);
+	return status;
+}
+
+/**
+ * Queues data in the batch buffer, the caller must hold WriteLock.
+ * The buffer is sent once it is full or its oldest byte is older than
+ * TRANSPORT_BATCH_MAX_DELAY milliseconds.
+ */
+static int transport_batch_append(rdpTransport* transport, const BYTE* data, size_t length)
+{
+	wStream* s = transport->BatchBuffer;
+	const UINT64 now = GetTickCount64();
+
+	if (Stream_GetPosition(s) + length > Stream_Capacity(s))
+	{
+		if (transport_batch_flush(transport) < 0)
+			return -1;
+	}
+
+	/* Too large to be worth a copy, the batch is empty now anyway */
+	if (length > Stream_Capacity(s))
+		return transport_write_layer(transport, data, length);
+
+	if (Stream_GetPosition(s) == 0)
+		transport->BatchDeadline = now + TRANSPORT_BATCH_MAX_DELAY;
+
+	Stream_Write(s, data, length);
+
+	if (now >= transport->BatchDeadline)
+	{
+		if (transport_batch_flush(transport) < 0)
+			return -1;
+	}
+
+	return (int)length;
+}
+
+int transport_write(rdpTransport* transport, wStream* s)
+{
+	size_t length;
+	int status = -1;
+	rdpRdp* rdp = transport->context->rdp;
+
+	if (!s)
+		return -1;
+
+	if (!transport)
+		goto fail;
+
+	if (!transport->frontBio)
+	{
+		transport->layer = TRANSPORT_LAYER_CLOSED;
+		freerdp_set_last_error_if_not(transport->context, FREERDP_ERROR_CONNECT_TRANSPORT_FAILED);
+		goto fail;
+	}
+
+	EnterCriticalSection(&(transport->WriteLock));
+	length = Stream_GetPosition(s);
+	Stream_SetPosition(s, 0);
+
+	if (length > 0)
+	{
+		rdp->outBytes += length;
+		WLog_Packet(transport->log, WLOG_TRACE, Stream_Buffer(s), length, WLOG_PACKET_OUTBOUND);
+	}
+
+	if (transport->BatchDepth > 0)
+		status = transport_batch_append(transport, Stream_Buffer(s), length);
+	else
+		status = transport_write_layer(transport, Stream_Buffer(s), length);
+
 	LeaveCriticalSection(&(transport->WriteLock));
 fail:
 	Stream_Release(s);
 	return status;
 }
 
+/**
+ * Writes several PDUs with as few writes to the front BIO (and TLS records) as possible.
+ * Like transport_write the streams are released, even on failure.
+ */
+int transport_writev(rdpTransport* transport, wStream** streams, size_t count)
+{
+	size_t index;
+	int status = 0;
+	int length = 0;
+
+	if (!transport || !streams)
+		return -1;
+
+	if (!transport_begin_batch(transport))
+		return -1;
+
+	for (index = 0; index < count; index++)
+	{
+		if (status < 0)
+		{
+			Stream_Release(streams[index]);
+			continue;
+		}
+
+		status = transport_write(transport, streams[index]);
+
+		if (status >= 0)
+			length += status;
+	}
+
+	if (transport_end_batch(transport) < 0)
+		status = -1;
+
+	return (status < 0) ? -1 : length;
+}
+
+/**
+ * Starts queueing writes instead of sending each one on its own.
+ * Batches nest, data is sent when the outermost batch ends.
+ */
+BOOL transport_begin_batch(rdpTransport* transport)
+{
+	if (!transport)
+		return FALSE;
+
+	EnterCriticalSection(&(transport->WriteLock));
+
+	if (!transport->BatchBuffer)
+		transport->BatchBuffer = Stream_New(NULL, TRANSPORT_BATCH_MAX_SIZE);
+
+	if (!transport->BatchBuffer)
+	{
+		LeaveCriticalSection(&(transport->WriteLock));
+		return FALSE;
+	}
+
+	transport->BatchDepth++;
+	LeaveCriticalSection(&(transport->WriteLock));
+	return TRUE;
+}
+
+int transport_end_batch(rdpTransport* transport)
+{
+	int status = 0;
+
+	if (!transport)
+		return -1;
+
+	EnterCriticalSection(&(transport->WriteLock));
+
+	if (transport->BatchDepth > 0)
+		transport->BatchDepth--;
+
+	if ((transport->BatchDepth == 0) && transport->frontBio)
+		status = transport_batch_flush(transport);
+
+	LeaveCriticalSection(&(transport->WriteLock));
+	return status;
+}
+
 DWORD transport_get_event_handles(rdpTransport* transport, HANDLE* events, DWORD count)
 {
 	DWORD nCount = 1; /* always the reread Event */
@@ -1017,6 +1206,20 @@ int transport_check_fds(rdpTransport* transport)
 
 	dueDate = now + transport->settings->MaxTimeInCheckLoop;
 
+	/* Do not let queued writes wait longer than the batch deadline.
+	 * Writers fill the batch under WriteLock, so check it under the lock too. */
+	EnterCriticalSection(&(transport->WriteLock));
+
+	if (transport->BatchBuffer && (Stream_GetPosition(transport->BatchBuffer) > 0) &&
+	    (now >= transport->BatchDeadline) && transport->frontBio &&
+	    (transport_batch_flush(transport) < 0))
+	{
+		LeaveCriticalSection(&(transport->WriteLock));
+		return -1;
+	}
+
+	LeaveCriticalSection(&(transport->WriteLock));
+
 	if (transport->haveMoreBytesToRead)
 	{
 		transport->haveMoreBytesToRead = FALSE;
@@ -1116,6 +1319,15 @@ BOOL transport_disconnect(rdpTransport* transport)
 
 	if (transport->tls)
 	{
+		/* stop the async I/O threads before tearing down the TLS chain they drive */
+		while (transport->frontBio && (BIO_method_type(transport->frontBio) == BIO_TYPE_ASYNC))
+		{
+			BIO* next = NULL;
+			BIO_get_async_next(transport->frontBio, &next);
+			BIO_free(transport->frontBio);
+			transport->frontBio = next;
+		}
+
 		tls_free(transport->tls);
 		transport->tls = NULL;
 	}
@@ -1139,6 +1351,13 @@ BOOL transport_disconnect(rdpTransport* transport)
 
 	transport->frontBio = NULL;
 	transport->layer = TRANSPORT_LAYER_TCP;
+
+	EnterCriticalSection(&(transport->WriteLock));
+
+	if (transport->BatchBuffer)
+		Stream_SetPosition(transport->BatchBuffer, 0);
+
+	LeaveCriticalSection(&(transport->WriteLock));
 	return status;
 }
 
@@ -1157,7 +1376,8 @@ rdpTransport* transport_new(rdpContext* context)
 
 	transport->context = context;
 	transport->settings = context->settings;
-	transport->ReceivePool = StreamPool_New(TRUE, BUFFER_SIZE);
+	transport->ReceivePool =
+	    StreamPool_NewEx(STREAMPOOL_SYNCHRONIZED | STREAMPOOL_SIZE_CLASSES, BUFFER_SIZE);
 
 	if (!transport->ReceivePool)
 		goto out_free_transport;
@@ -1216,6 +1436,7 @@ void transport_free(rdpTransport* transport)
 		Stream_Release(transport->ReceiveBuffer);
 
 	nla_free(transport->nla);
+	Stream_Free(transport->BatchBuffer, TRUE);
 	StreamPool_Free(transport->ReceivePool);
 	CloseHandle(transport->connectedEvent);
 	CloseHandle(transport->rereadEvent);
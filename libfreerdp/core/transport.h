@@ -77,6 +77,9 @@ struct rdp_transport
 	HANDLE rereadEvent;
 	BOOL haveMoreBytesToRead;
 	wLog* log;
+	wStream* BatchBuffer;
+	UINT32 BatchDepth;
+	UINT64 BatchDeadline;
 };
 
 FREERDP_LOCAL wStream* transport_send_stream_init(rdpTransport* transport, int size);
@@ -86,6 +89,7 @@ FREERDP_LOCAL BOOL transport_attach(rdpTransport* transport, int sockfd);
 FREERDP_LOCAL BOOL transport_disconnect(rdpTransport* transport);
 FREERDP_LOCAL BOOL transport_connect_rdp(rdpTransport* transport);
 FREERDP_LOCAL BOOL transport_connect_tls(rdpTransport* transport);
+FREERDP_LOCAL BOOL transport_start_async_io(rdpTransport* transport);
 FREERDP_LOCAL BOOL transport_connect_nla(rdpTransport* transport);
 FREERDP_LOCAL BOOL transport_accept_rdp(rdpTransport* transport);
 FREERDP_LOCAL BOOL transport_accept_tls(rdpTransport* transport);
@@ -93,6 +97,9 @@ FREERDP_LOCAL BOOL transport_accept_nla(rdpTransport* transport);
 
 FREERDP_LOCAL int transport_read_pdu(rdpTransport* transport, wStream* s);
 FREERDP_LOCAL int transport_write(rdpTransport* transport, wStream* s);
+FREERDP_LOCAL int transport_writev(rdpTransport* transport, wStream** streams, size_t count);
+FREERDP_LOCAL BOOL transport_begin_batch(rdpTransport* transport);
+FREERDP_LOCAL int transport_end_batch(rdpTransport* transport);
 
 FREERDP_LOCAL void transport_get_fds(rdpTransport* transport, void** rfds, int* rcount);
 FREERDP_LOCAL int transport_check_fds(rdpTransport* transport);
@@ -930,6 +930,13 @@ static BOOL _update_begin_paint(rdpContext* context)
 	if (!s)
 		return FALSE;
 
+	/* Everything sent until EndPaint is coalesced into as few writes as possible */
+	if (!transport_begin_batch(context->rdp->transport))
+	{
+		Stream_Free(s, TRUE);
+		return FALSE;
+	}
+
 	Stream_SealLength(s);
 	Stream_GetLength(s, update->offsetOrders);
 	Stream_Seek(s, 2); /* numberOrders (2 bytes) */
@@ -964,7 +971,7 @@ static BOOL _update_end_paint(rdpContext* context)
 	update->offsetOrders = 0;
 	update->us = NULL;
 	Stream_Free(s, TRUE);
-	return TRUE;
+	return transport_end_batch(context->rdp->transport) >= 0;
 }
 
 static void update_flush(rdpContext* context)
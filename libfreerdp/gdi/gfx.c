@@ -321,7 +321,7 @@ static UINT gdi_SurfaceCommand_RemoteFX(rdpGdi* gdi, RdpgfxClientContext* contex
 	gdiGfxSurface* surface;
 	REGION16 invalidRegion;
 	const RECTANGLE_16* rects;
-	UINT32 nrRects, x;
+	UINT32 nrRects;
 	surface = (gdiGfxSurface*)context->GetSurfaceData(context, cmd->surfaceId);
 
 	if (!surface)
@@ -349,8 +349,7 @@ static UINT gdi_SurfaceCommand_RemoteFX(rdpGdi* gdi, RdpgfxClientContext* contex
 	if (status != CHANNEL_RC_OK)
 		goto fail;
 
-	for (x = 0; x < nrRects; x++)
-		region16_union_rect(&surface->invalidRegion, &surface->invalidRegion, &rects[x]);
+	region16_union_rects(&surface->invalidRegion, &surface->invalidRegion, rects, nrRects);
 
 	if (!gdi->inGfxFrame)
 	{
@@ -525,11 +524,8 @@ static UINT gdi_SurfaceCommand_AVC420(rdpGdi* gdi, RdpgfxClientContext* context,
 		return CHANNEL_RC_OK;
 	}
 
-	for (i = 0; i < meta->numRegionRects; i++)
-	{
-		region16_union_rect(&(surface->invalidRegion), &(surface->invalidRegion),
-		                    (RECTANGLE_16*)&(meta->regionRects[i]));
-	}
+	region16_union_rects(&(surface->invalidRegion), &(surface->invalidRegion), meta->regionRects,
+	                     meta->numRegionRects);
 
 	status = IFCALLRESULT(CHANNEL_RC_OK, context->UpdateSurfaceArea, context, surface->surfaceId,
 	                      meta->numRegionRects, meta->regionRects);
@@ -614,11 +610,8 @@ static UINT gdi_SurfaceCommand_AVC444(rdpGdi* gdi, RdpgfxClientContext* context,
 		return CHANNEL_RC_OK;
 	}
 
-	for (i = 0; i < meta1->numRegionRects; i++)
-	{
-		region16_union_rect(&(surface->invalidRegion), &(surface->invalidRegion),
-		                    &(meta1->regionRects[i]));
-	}
+	region16_union_rects(&(surface->invalidRegion), &(surface->invalidRegion), meta1->regionRects,
+	                     meta1->numRegionRects);
 
 	status = IFCALLRESULT(CHANNEL_RC_OK, context->UpdateSurfaceArea, context, surface->surfaceId,
 	                      meta1->numRegionRects, meta1->regionRects);
@@ -626,11 +619,8 @@ static UINT gdi_SurfaceCommand_AVC444(rdpGdi* gdi, RdpgfxClientContext* context,
 	if (status != CHANNEL_RC_OK)
 		goto fail;
 
-	for (i = 0; i < meta2->numRegionRects; i++)
-	{
-		region16_union_rect(&(surface->invalidRegion), &(surface->invalidRegion),
-		                    &(meta2->regionRects[i]));
-	}
+	region16_union_rects(&(surface->invalidRegion), &(surface->invalidRegion), meta2->regionRects,
+	                     meta2->numRegionRects);
 
 	status = IFCALLRESULT(CHANNEL_RC_OK, context->UpdateSurfaceArea, context, surface->surfaceId,
 	                      meta2->numRegionRects, meta2->regionRects);
@@ -830,7 +820,7 @@ static UINT gdi_SurfaceCommand_Progressive(rdpGdi* gdi, RdpgfxClientContext* con
 	gdiGfxSurface* surface;
 	REGION16 invalidRegion;
 	const RECTANGLE_16* rects;
-	UINT32 nrRects, x;
+	UINT32 nrRects;
 	/**
 	 * Note: Since this comes via a Wire-To-Surface-2 PDU the
 	 * cmd's top/left/right/bottom/width/height members are always zero!
@@ -876,9 +866,7 @@ static UINT gdi_SurfaceCommand_Progressive(rdpGdi* gdi, RdpgfxClientContext* con
 	if (status != CHANNEL_RC_OK)
 		goto fail;
 
-	for (x = 0; x < nrRects; x++)
-		region16_union_rect(&surface->invalidRegion, &surface->invalidRegion, &rects[x]);
-
+	region16_union_rects(&surface->invalidRegion, &surface->invalidRegion, rects, nrRects);
 	region16_uninit(&invalidRegion);
 
 	if (!gdi->inGfxFrame)
@@ -1250,6 +1238,7 @@ static UINT gdi_SurfaceToCache(RdpgfxClientContext* context,
 	if (!cacheEntry)
 		goto fail;
 
+	cacheEntry->cacheKey = surfaceToCache->cacheKey;
 	cacheEntry->width = (UINT32)(rect->right - rect->left);
 	cacheEntry->height = (UINT32)(rect->bottom - rect->top);
 	cacheEntry->format = surface->format;
@@ -1349,7 +1338,129 @@ fail:
 static UINT gdi_CacheImportReply(RdpgfxClientContext* context,
                                  const RDPGFX_CACHE_IMPORT_REPLY_PDU* cacheImportReply)
 {
-	return CHANNEL_RC_OK;
+	UINT16 index;
+	UINT error = CHANNEL_RC_OK;
+	EnterCriticalSection(&context->mux);
+
+	/* The server now assumes these slots are filled. A slot the persistent cache could not
+	 * provide would render nothing on CacheToSurface, so the import fails instead. */
+	for (index = 0; index < cacheImportReply->importedEntriesCount; index++)
+	{
+		const UINT16 cacheSlot = cacheImportReply->cacheSlots[index];
+
+		if (cacheSlot == 0)
+			continue;
+
+		if (!context->GetCacheSlotData(context, cacheSlot))
+		{
+			WLog_ERR(TAG, "%s: cache slot %" PRIu16 " was not imported", __FUNCTION__,
+			         cacheSlot);
+			error = ERROR_NOT_FOUND;
+			break;
+		}
+	}
+
+	LeaveCriticalSection(&context->mux);
+	return error;
+}
+
+/**
+ * Function description
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT gdi_ImportCacheEntry(RdpgfxClientContext* context, UINT16 cacheSlot,
+                                 const PERSISTENT_CACHE_ENTRY* importCacheEntry)
+{
+	gdiGfxCacheEntry* cacheEntry;
+	gdiGfxCacheEntry* prevEntry;
+	rdpGdi* gdi = (rdpGdi*)context->custom;
+	UINT rc = ERROR_INTERNAL_ERROR;
+	cacheEntry = (gdiGfxCacheEntry*)calloc(1, sizeof(gdiGfxCacheEntry));
+
+	if (!cacheEntry)
+		return CHANNEL_RC_NO_MEMORY;
+
+	cacheEntry->cacheKey = importCacheEntry->key64;
+	cacheEntry->width = importCacheEntry->width;
+	cacheEntry->height = importCacheEntry->height;
+	cacheEntry->format = gdi->dstFormat;
+	cacheEntry->scanline = gfx_align_scanline(cacheEntry->width * 4, 16);
+	cacheEntry->data = (BYTE*)calloc(cacheEntry->height, cacheEntry->scanline);
+
+	if (!cacheEntry->data)
+		goto fail;
+
+	if (!freerdp_image_copy(cacheEntry->data, cacheEntry->format, cacheEntry->scanline, 0, 0,
+	                        cacheEntry->width, cacheEntry->height, importCacheEntry->data,
+	                        PIXEL_FORMAT_BGRA32, 0, 0, 0, NULL, FREERDP_FLIP_NONE))
+		goto fail;
+
+	EnterCriticalSection(&context->mux);
+	prevEntry = (gdiGfxCacheEntry*)context->GetCacheSlotData(context, cacheSlot);
+	rc = context->SetCacheSlotData(context, cacheSlot, (void*)cacheEntry);
+
+	if ((rc == CHANNEL_RC_OK) && prevEntry)
+	{
+		free(prevEntry->data);
+		free(prevEntry);
+	}
+
+	LeaveCriticalSection(&context->mux);
+
+	if (rc == CHANNEL_RC_OK)
+		return rc;
+
+fail:
+	free(cacheEntry->data);
+	free(cacheEntry);
+	return rc;
+}
+
+/**
+ * Function description
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT gdi_ExportCacheEntry(RdpgfxClientContext* context, UINT16 cacheSlot,
+                                 PERSISTENT_CACHE_ENTRY* exportCacheEntry)
+{
+	gdiGfxCacheEntry* cacheEntry;
+	UINT rc = ERROR_NOT_FOUND;
+	EnterCriticalSection(&context->mux);
+	cacheEntry = (gdiGfxCacheEntry*)context->GetCacheSlotData(context, cacheSlot);
+
+	/* Entries without a key are not saved */
+	if (!cacheEntry || !cacheEntry->data || (cacheEntry->cacheKey == 0) ||
+	    (cacheEntry->width > PERSISTENT_CACHE_MAX_DIMENSION) ||
+	    (cacheEntry->height > PERSISTENT_CACHE_MAX_DIMENSION))
+		goto fail;
+
+	exportCacheEntry->key64 = cacheEntry->cacheKey;
+	exportCacheEntry->width = (UINT16)cacheEntry->width;
+	exportCacheEntry->height = (UINT16)cacheEntry->height;
+	exportCacheEntry->size = 4UL * cacheEntry->width * cacheEntry->height;
+	exportCacheEntry->data = (BYTE*)malloc(exportCacheEntry->size);
+	rc = CHANNEL_RC_NO_MEMORY;
+
+	if (!exportCacheEntry->data)
+		goto fail;
+
+	if (!freerdp_image_copy(exportCacheEntry->data, PIXEL_FORMAT_BGRA32, 0, 0, 0,
+	                        cacheEntry->width, cacheEntry->height, cacheEntry->data,
+	                        cacheEntry->format, cacheEntry->scanline, 0, 0, NULL,
+	                        FREERDP_FLIP_NONE))
+	{
+		free(exportCacheEntry->data);
+		exportCacheEntry->data = NULL;
+		rc = ERROR_INTERNAL_ERROR;
+		goto fail;
+	}
+
+	rc = CHANNEL_RC_OK;
+fail:
+	LeaveCriticalSection(&context->mux);
+	return rc;
 }
 
 /**
@@ -1524,6 +1635,8 @@ BOOL gdi_graphics_pipeline_init_ex(rdpGdi* gdi, RdpgfxClientContext* gfx,
 	gfx->CacheToSurface = gdi_CacheToSurface;
 	gfx->CacheImportReply = gdi_CacheImportReply;
 	gfx->EvictCacheEntry = gdi_EvictCacheEntry;
+	gfx->ImportCacheEntry = gdi_ImportCacheEntry;
+	gfx->ExportCacheEntry = gdi_ExportCacheEntry;
 	gfx->MapSurfaceToOutput = gdi_MapSurfaceToOutput;
 	gfx->MapSurfaceToWindow = gdi_MapSurfaceToWindow;
 	gfx->MapSurfaceToScaledOutput = gdi_MapSurfaceToScaledOutput;
@@ -111,7 +111,7 @@ static pstatus_t general_ChromaFilter(BYTE* pDst[3], const UINT32 dstStep[3],
 		BYTE* pU = pDst[1] + dstStep[1] * val2y;
 		BYTE* pV = pDst[2] + dstStep[2] * val2y;
 
-		if (val2y1 > nHeight)
+		if (val2y1 >= nHeight)
 			continue;
 
 		for (x = roi->left; x < halfWidth + roi->left; x++)
@@ -123,7 +123,8 @@ static pstatus_t general_ChromaFilter(BYTE* pDst[3], const UINT32 dstStep[3],
 			INT32 u2020;
 			INT32 v2020;
 
-			if (val2x1 > nWidth)
+			/* an odd last column has no pair inside the frame and is not filtered */
+			if (val2x1 >= nWidth)
 				continue;
 
 			u2020 = up - pU[val2x1] - pU1[val2x] - pU1[val2x1];
@@ -147,7 +148,8 @@ static pstatus_t general_ChromaV1ToYUV444(const BYTE* const pSrcRaw[3], const UI
 	const UINT32 nWidth = roi->right - roi->left;
 	const UINT32 nHeight = roi->bottom - roi->top;
 	const UINT32 halfWidth = (nWidth) / 2;
-	const UINT32 halfHeight = (nHeight) / 2;
+	/* an odd last row still has its B6 and B7 samples */
+	const UINT32 halfHeight = (nHeight + 1) / 2;
 	const UINT32 oddY = 1;
 	const UINT32 evenY = 0;
 	const UINT32 oddX = 1;
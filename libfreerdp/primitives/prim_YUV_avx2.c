@@ -0,0 +1,853 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Optimized YUV/RGB conversion operations - AVX2
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <winpr/sysinfo.h>
+#include <winpr/crt.h>
+#include <freerdp/types.h>
+#include <freerdp/primitives.h>
+
+#include "prim_internal.h"
+
+#include <immintrin.h>
+
+#if !defined(WITH_AVX2)
+#error "This file needs WITH_AVX2 enabled!"
+#endif
+
+/* The AVX2 routines compute exactly what the SSSE3 ones do, twice the pixels at a time.
+ * Most AVX2 integer instructions work on two independent 128 bit lanes, the permutes
+ * below restore the pixel order afterwards.
+ * Frames the AVX2 code does not handle go to the routines registered before. */
+static primitives_t* generic = NULL;
+static primitives_t fallback = { 0 };
+
+/****************************************************************************/
+/* AVX2 YUV -> RGB conversion                                               */
+/****************************************************************************/
+
+/* Convert 16 pixels to BGRX, Y, D = U - 128 and E = V - 128 are 16 bit values in pixel order.
+ * The alpha bytes of the destination are preserved. */
+static INLINE void avx2_YUV444Pixel(BYTE* dst, __m256i Y, __m256i D, __m256i E)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i max = _mm256_set1_epi16(255);
+	const __m256i alphaMask = _mm256_set1_epi32((int)0xFF000000);
+	/* madd factors, low word applies to the first value of each pair */
+	const __m256i cR = _mm256_set1_epi32((403 << 16) | 256);
+	const __m256i cB = _mm256_set1_epi32((475 << 16) | 256);
+	const __m256i cG = _mm256_set1_epi32((int)(((UINT32)(-120 & 0xFFFF) << 16) | (-48 & 0xFFFF)));
+	__m256i R, G, B;
+	{
+		const __m256i lo = _mm256_madd_epi16(_mm256_unpacklo_epi16(Y, E), cR);
+		const __m256i hi = _mm256_madd_epi16(_mm256_unpackhi_epi16(Y, E), cR);
+		R = _mm256_packs_epi32(_mm256_srai_epi32(lo, 8), _mm256_srai_epi32(hi, 8));
+	}
+	{
+		const __m256i ylo = _mm256_slli_epi32(_mm256_unpacklo_epi16(Y, zero), 8);
+		const __m256i yhi = _mm256_slli_epi32(_mm256_unpackhi_epi16(Y, zero), 8);
+		const __m256i dlo = _mm256_madd_epi16(_mm256_unpacklo_epi16(D, E), cG);
+		const __m256i dhi = _mm256_madd_epi16(_mm256_unpackhi_epi16(D, E), cG);
+		const __m256i lo = _mm256_add_epi32(ylo, dlo);
+		const __m256i hi = _mm256_add_epi32(yhi, dhi);
+		G = _mm256_packs_epi32(_mm256_srai_epi32(lo, 8), _mm256_srai_epi32(hi, 8));
+	}
+	{
+		const __m256i lo = _mm256_madd_epi16(_mm256_unpacklo_epi16(Y, D), cB);
+		const __m256i hi = _mm256_madd_epi16(_mm256_unpackhi_epi16(Y, D), cB);
+		B = _mm256_packs_epi32(_mm256_srai_epi32(lo, 8), _mm256_srai_epi32(hi, 8));
+	}
+	/* unpack and pack undid each others lane interleave, clip to [0, 255] */
+	R = _mm256_max_epi16(_mm256_min_epi16(R, max), zero);
+	G = _mm256_max_epi16(_mm256_min_epi16(G, max), zero);
+	B = _mm256_max_epi16(_mm256_min_epi16(B, max), zero);
+	{
+		const __m256i BG = _mm256_or_si256(B, _mm256_slli_epi16(G, 8));
+		const __m256i lo = _mm256_unpacklo_epi16(BG, R); /* pixels 0-3 and 8-11 */
+		const __m256i hi = _mm256_unpackhi_epi16(BG, R); /* pixels 4-7 and 12-15 */
+		__m256i* out = (__m256i*)dst;
+		const __m256i a0 = _mm256_and_si256(_mm256_loadu_si256(&out[0]), alphaMask);
+		const __m256i a1 = _mm256_and_si256(_mm256_loadu_si256(&out[1]), alphaMask);
+		_mm256_storeu_si256(&out[0], _mm256_or_si256(a0, _mm256_permute2x128_si256(lo, hi, 0x20)));
+		_mm256_storeu_si256(&out[1], _mm256_or_si256(a1, _mm256_permute2x128_si256(lo, hi, 0x31)));
+	}
+}
+
+static INLINE __m256i avx2_load_chroma(const BYTE* src, BOOL subsampled)
+{
+	const __m128i c = subsampled ? _mm_loadl_epi64((const __m128i*)src)
+	                             : _mm_loadu_si128((const __m128i*)src);
+	const __m128i dup = subsampled ? _mm_unpacklo_epi8(c, c) : c;
+	return _mm256_sub_epi16(_mm256_cvtepu8_epi16(dup), _mm256_set1_epi16(128));
+}
+
+static pstatus_t avx2_YUVToRGB_BGRX(const BYTE* const* pSrc, const UINT32* srcStep, BYTE* pDst,
+                                    UINT32 dstStep, const prim_size_t* roi, BOOL subsampled)
+{
+	const UINT32 nWidth = roi->width;
+	const UINT32 nHeight = roi->height;
+	const UINT32 pad = roi->width % 16;
+	UINT32 y;
+
+	for (y = 0; y < nHeight; y++)
+	{
+		UINT32 x;
+		BYTE* dst = pDst + dstStep * y;
+		const UINT32 cy = subsampled ? y / 2 : y;
+		const BYTE* YData = pSrc[0] + y * srcStep[0];
+		const BYTE* UData = pSrc[1] + cy * srcStep[1];
+		const BYTE* VData = pSrc[2] + cy * srcStep[2];
+
+		for (x = 0; x < nWidth - pad; x += 16)
+		{
+			const __m256i Y = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)&YData[x]));
+			const UINT32 cx = subsampled ? x / 2 : x;
+			const __m256i D = avx2_load_chroma(&UData[cx], subsampled);
+			const __m256i E = avx2_load_chroma(&VData[cx], subsampled);
+			avx2_YUV444Pixel(dst, Y, D, E);
+			dst += 64;
+		}
+
+		for (; x < nWidth; x++)
+		{
+			const UINT32 cx = subsampled ? x / 2 : x;
+			const BYTE Y = YData[x];
+			const BYTE U = UData[cx];
+			const BYTE V = VData[cx];
+			const BYTE r = YUV2R(Y, U, V);
+			const BYTE g = YUV2G(Y, U, V);
+			const BYTE b = YUV2B(Y, U, V);
+			dst = writePixelBGRX(dst, 4, PIXEL_FORMAT_BGRX32, r, g, b, 0);
+		}
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+static pstatus_t avx2_YUV420ToRGB(const BYTE* const* pSrc, const UINT32* srcStep, BYTE* pDst,
+                                  UINT32 dstStep, UINT32 DstFormat, const prim_size_t* roi)
+{
+	switch (DstFormat)
+	{
+		case PIXEL_FORMAT_BGRX32:
+		case PIXEL_FORMAT_BGRA32:
+			return avx2_YUVToRGB_BGRX(pSrc, srcStep, pDst, dstStep, roi, TRUE);
+
+		default:
+			return generic->YUV420ToRGB_8u_P3AC4R(pSrc, srcStep, pDst, dstStep, DstFormat, roi);
+	}
+}
+
+static pstatus_t avx2_YUV444ToRGB_8u_P3AC4R(const BYTE* const* pSrc, const UINT32* srcStep,
+                                            BYTE* pDst, UINT32 dstStep, UINT32 DstFormat,
+                                            const prim_size_t* roi)
+{
+	switch (DstFormat)
+	{
+		case PIXEL_FORMAT_BGRX32:
+		case PIXEL_FORMAT_BGRA32:
+			return avx2_YUVToRGB_BGRX(pSrc, srcStep, pDst, dstStep, roi, FALSE);
+
+		default:
+			return generic->YUV444ToRGB_8u_P3AC4R(pSrc, srcStep, pDst, dstStep, DstFormat, roi);
+	}
+}
+
+/****************************************************************************/
+/* AVX2 RGB -> YUV420 conversion                                            */
+/****************************************************************************/
+
+/* Same factors as the SSSE3 code, see the note in prim_YUV_ssse3.c */
+#define BGRX_Y_FACTORS          \
+	_mm256_broadcastsi128_si256( \
+	    _mm_set_epi8(0, 27, 92, 9, 0, 27, 92, 9, 0, 27, 92, 9, 0, 27, 92, 9))
+#define BGRX_U_FACTORS                                                                       \
+	_mm256_broadcastsi128_si256(                                                             \
+	    _mm_set_epi8(0, -29, -99, 127, 0, -29, -99, 127, 0, -29, -99, 127, 0, -29, -99, 127))
+#define BGRX_V_FACTORS                                                                       \
+	_mm256_broadcastsi128_si256(                                                             \
+	    _mm_set_epi8(0, 127, -116, -12, 0, 127, -116, -12, 0, 127, -116, -12, 0, 127, -116, -12))
+#define CONST128_FACTORS _mm256_set1_epi8(-128)
+
+#define Y_SHIFT 7
+#define U_SHIFT 8
+#define V_SHIFT 8
+
+/* After hadd and pack the 32 results of four registers are ordered by dword as
+ * 0-3, 8-11, 16-19, 24-27 | 4-7, 12-15, 20-23, 28-31 */
+#define PACKED_ORDER _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7)
+
+static INLINE __m256i avx2_RGBToYUV_Y(__m256i x0, __m256i x1, __m256i x2, __m256i x3)
+{
+	const __m256i y_factors = BGRX_Y_FACTORS;
+	const __m256i y0 = _mm256_srli_epi16(
+	    _mm256_hadd_epi16(_mm256_maddubs_epi16(x0, y_factors), _mm256_maddubs_epi16(x1, y_factors)),
+	    Y_SHIFT);
+	const __m256i y1 = _mm256_srli_epi16(
+	    _mm256_hadd_epi16(_mm256_maddubs_epi16(x2, y_factors), _mm256_maddubs_epi16(x3, y_factors)),
+	    Y_SHIFT);
+	return _mm256_permutevar8x32_epi32(_mm256_packus_epi16(y0, y1), PACKED_ORDER);
+}
+
+static INLINE __m256i avx2_RGBToYUV_Chroma(__m256i x0, __m256i x1, __m256i x2, __m256i x3,
+                                           __m256i factors, int shift)
+{
+	const __m256i c0 = _mm256_srai_epi16(
+	    _mm256_hadd_epi16(_mm256_maddubs_epi16(x0, factors), _mm256_maddubs_epi16(x1, factors)),
+	    shift);
+	const __m256i c1 = _mm256_srai_epi16(
+	    _mm256_hadd_epi16(_mm256_maddubs_epi16(x2, factors), _mm256_maddubs_epi16(x3, factors)),
+	    shift);
+	const __m256i c = _mm256_sub_epi8(_mm256_packs_epi16(c0, c1), CONST128_FACTORS);
+	return _mm256_permutevar8x32_epi32(c, PACKED_ORDER);
+}
+
+static INLINE void avx2_RGBToYUV420_BGRX_Y(const BYTE* src, BYTE* dst, UINT32 width)
+{
+	UINT32 x;
+	const __m256i* argb = (const __m256i*)src;
+	__m256i* ydst = (__m256i*)dst;
+
+	for (x = 0; x < width; x += 32)
+	{
+		const __m256i x0 = _mm256_loadu_si256(argb++);
+		const __m256i x1 = _mm256_loadu_si256(argb++);
+		const __m256i x2 = _mm256_loadu_si256(argb++);
+		const __m256i x3 = _mm256_loadu_si256(argb++);
+		_mm256_storeu_si256(ydst++, avx2_RGBToYUV_Y(x0, x1, x2, x3));
+	}
+}
+
+static INLINE void avx2_RGBToYUV420_BGRX_UV(const BYTE* src1, const BYTE* src2, BYTE* dst1,
+                                            BYTE* dst2, UINT32 width)
+{
+	UINT32 x;
+	const __m256i u_factors = BGRX_U_FACTORS;
+	const __m256i v_factors = BGRX_V_FACTORS;
+	const __m256i vector128 = CONST128_FACTORS;
+	const __m256i* rgb1 = (const __m256i*)src1;
+	const __m256i* rgb2 = (const __m256i*)src2;
+	__m128i* udst = (__m128i*)dst1;
+	__m128i* vdst = (__m128i*)dst2;
+
+	for (x = 0; x < width; x += 32)
+	{
+		__m256i x0, x1, x2, x3, u, v, uv;
+		/* subsample 32x2 pixels into 32x1 pixels */
+		x0 = _mm256_avg_epu8(_mm256_loadu_si256(rgb1++), _mm256_loadu_si256(rgb2++));
+		x1 = _mm256_avg_epu8(_mm256_loadu_si256(rgb1++), _mm256_loadu_si256(rgb2++));
+		x2 = _mm256_avg_epu8(_mm256_loadu_si256(rgb1++), _mm256_loadu_si256(rgb2++));
+		x3 = _mm256_avg_epu8(_mm256_loadu_si256(rgb1++), _mm256_loadu_si256(rgb2++));
+		/* subsample these 32x1 pixels into 16x1 pixels, pairs end up ordered
+		 * 0, 1, 4, 5 | 2, 3, 6, 7 and 8, 9, 12, 13 | 10, 11, 14, 15 */
+		{
+			const __m256 f0 = _mm256_castsi256_ps(x0);
+			const __m256 f1 = _mm256_castsi256_ps(x1);
+			const __m256 f2 = _mm256_castsi256_ps(x2);
+			const __m256 f3 = _mm256_castsi256_ps(x3);
+			x0 = _mm256_avg_epu8(_mm256_castps_si256(_mm256_shuffle_ps(f0, f1, 0x88)),
+			                     _mm256_castps_si256(_mm256_shuffle_ps(f0, f1, 0xdd)));
+			x1 = _mm256_avg_epu8(_mm256_castps_si256(_mm256_shuffle_ps(f2, f3, 0x88)),
+			                     _mm256_castps_si256(_mm256_shuffle_ps(f2, f3, 0xdd)));
+		}
+		/* multiplications, subtotals and the total sums */
+		u = _mm256_hadd_epi16(_mm256_maddubs_epi16(x0, u_factors),
+		                      _mm256_maddubs_epi16(x1, u_factors));
+		v = _mm256_hadd_epi16(_mm256_maddubs_epi16(x0, v_factors),
+		                      _mm256_maddubs_epi16(x1, v_factors));
+		u = _mm256_srai_epi16(u, U_SHIFT);
+		v = _mm256_srai_epi16(v, V_SHIFT);
+		/* pack and add 128, each lane now holds 8 u followed by 8 v values */
+		uv = _mm256_sub_epi8(_mm256_packs_epi16(u, v), vector128);
+		{
+			const __m128i lo = _mm256_castsi256_si128(uv);
+			const __m128i hi = _mm256_extracti128_si256(uv, 1);
+			/* the lanes hold alternating pairs of output values */
+			_mm_storeu_si128(udst++, _mm_unpacklo_epi16(lo, hi));
+			_mm_storeu_si128(vdst++, _mm_unpackhi_epi16(lo, hi));
+		}
+	}
+}
+
+static pstatus_t avx2_RGBToYUV420_BGRX(const BYTE* pSrc, UINT32 srcFormat, UINT32 srcStep,
+                                       BYTE* pDst[3], UINT32 dstStep[3], const prim_size_t* roi)
+{
+	UINT32 y;
+	const BYTE* argb = pSrc;
+	BYTE* ydst = pDst[0];
+	BYTE* udst = pDst[1];
+	BYTE* vdst = pDst[2];
+
+	if (roi->height < 1 || roi->width < 1)
+		return !PRIMITIVES_SUCCESS;
+
+	if (roi->width % 32)
+		return fallback.RGBToYUV420_8u_P3AC4R(pSrc, srcFormat, srcStep, pDst, dstStep, roi);
+
+	for (y = 0; y < roi->height - 1; y += 2)
+	{
+		const BYTE* line1 = argb;
+		const BYTE* line2 = argb + srcStep;
+		avx2_RGBToYUV420_BGRX_UV(line1, line2, udst, vdst, roi->width);
+		avx2_RGBToYUV420_BGRX_Y(line1, ydst, roi->width);
+		avx2_RGBToYUV420_BGRX_Y(line2, ydst + dstStep[0], roi->width);
+		argb += 2 * srcStep;
+		ydst += 2 * dstStep[0];
+		udst += 1 * dstStep[1];
+		vdst += 1 * dstStep[2];
+	}
+
+	if (roi->height & 1)
+	{
+		/* pass the same last line of an odd height twice for UV */
+		avx2_RGBToYUV420_BGRX_UV(argb, argb, udst, vdst, roi->width);
+		avx2_RGBToYUV420_BGRX_Y(argb, ydst, roi->width);
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+static pstatus_t avx2_RGBToYUV420(const BYTE* pSrc, UINT32 srcFormat, UINT32 srcStep,
+                                  BYTE* pDst[3], UINT32 dstStep[3], const prim_size_t* roi)
+{
+	switch (srcFormat)
+	{
+		case PIXEL_FORMAT_BGRX32:
+		case PIXEL_FORMAT_BGRA32:
+			return avx2_RGBToYUV420_BGRX(pSrc, srcFormat, srcStep, pDst, dstStep, roi);
+
+		default:
+			return fallback.RGBToYUV420_8u_P3AC4R(pSrc, srcFormat, srcStep, pDst, dstStep, roi);
+	}
+}
+
+/****************************************************************************/
+/* AVX2 RGB -> AVC444-YUV conversion                                        */
+/****************************************************************************/
+
+/* Selects the even (odd) bytes of each lane into the lower 8 bytes of the lane */
+#define EVEN_BYTES                                                                            \
+	_mm256_broadcastsi128_si256(_mm_set_epi8((char)0x80, (char)0x80, (char)0x80, (char)0x80, \
+	                                         (char)0x80, (char)0x80, (char)0x80, (char)0x80, 14, \
+	                                         12, 10, 8, 6, 4, 2, 0))
+#define ODD_BYTES                                                                             \
+	_mm256_broadcastsi128_si256(_mm_set_epi8((char)0x80, (char)0x80, (char)0x80, (char)0x80, \
+	                                         (char)0x80, (char)0x80, (char)0x80, (char)0x80, 15, \
+	                                         13, 11, 9, 7, 5, 3, 1))
+
+/* The lower quadword of both lanes as 16 consecutive bytes */
+static INLINE void avx2_store_low_quadwords(BYTE* dst, __m256i v)
+{
+	_mm_storeu_si128((__m128i*)dst,
+	                 _mm256_castsi256_si128(_mm256_permute4x64_epi64(v, 0x08)));
+}
+
+/* Split 32 even and odd row chroma values according to
+ * 3.3.8.3.2 YUV420p Stream Combination for YUV444 mode:
+ * 2x   2y    -> main (average of the 2x2 block when there is an odd row)
+ * x    2y+1  -> aux1
+ * 2x+1 2y    -> aux2 */
+static INLINE void avx2_RGBToAVC444YUV_SplitChroma(__m256i even, const __m256i* odd, BYTE* main,
+                                                   BYTE* aux1, BYTE* aux2)
+{
+	if (odd)
+	{
+		const __m256i ones = _mm256_set1_epi8(1);
+		const __m256i sum = _mm256_add_epi16(_mm256_maddubs_epi16(even, ones),
+		                                     _mm256_maddubs_epi16(*odd, ones));
+		const __m256i avg16 = _mm256_srai_epi16(sum, 2);
+		avx2_store_low_quadwords(main, _mm256_packus_epi16(avg16, avg16));
+		_mm256_storeu_si256((__m256i*)aux1, *odd);
+	}
+	else
+		avx2_store_low_quadwords(main, _mm256_shuffle_epi8(even, EVEN_BYTES));
+
+	avx2_store_low_quadwords(aux2, _mm256_shuffle_epi8(even, ODD_BYTES));
+}
+
+static INLINE void avx2_RGBToAVC444YUV_BGRX_DOUBLE_ROW(const BYTE* srcEven, const BYTE* srcOdd,
+                                                       BYTE* b1Even, BYTE* b1Odd, BYTE* b2,
+                                                       BYTE* b3, BYTE* b4, BYTE* b5, BYTE* b6,
+                                                       BYTE* b7, UINT32 width)
+{
+	UINT32 x;
+	const __m256i* argbEven = (const __m256i*)srcEven;
+	const __m256i* argbOdd = (const __m256i*)srcOdd;
+	const __m256i u_factors = BGRX_U_FACTORS;
+	const __m256i v_factors = BGRX_V_FACTORS;
+
+	for (x = 0; x < width; x += 32)
+	{
+		const __m256i xe1 = _mm256_loadu_si256(argbEven++);
+		const __m256i xe2 = _mm256_loadu_si256(argbEven++);
+		const __m256i xe3 = _mm256_loadu_si256(argbEven++);
+		const __m256i xe4 = _mm256_loadu_si256(argbEven++);
+		const __m256i xo1 = _mm256_loadu_si256(argbOdd++);
+		const __m256i xo2 = _mm256_loadu_si256(argbOdd++);
+		const __m256i xo3 = _mm256_loadu_si256(argbOdd++);
+		const __m256i xo4 = _mm256_loadu_si256(argbOdd++);
+		/* store y [b1] */
+		_mm256_storeu_si256((__m256i*)b1Even, avx2_RGBToYUV_Y(xe1, xe2, xe3, xe4));
+		b1Even += 32;
+
+		if (b1Odd)
+		{
+			_mm256_storeu_si256((__m256i*)b1Odd, avx2_RGBToYUV_Y(xo1, xo2, xo3, xo4));
+			b1Odd += 32;
+		}
+
+		{
+			/* u [b2, b4, b6] */
+			const __m256i ue = avx2_RGBToYUV_Chroma(xe1, xe2, xe3, xe4, u_factors, U_SHIFT);
+
+			if (b1Odd)
+			{
+				const __m256i uo = avx2_RGBToYUV_Chroma(xo1, xo2, xo3, xo4, u_factors, U_SHIFT);
+				avx2_RGBToAVC444YUV_SplitChroma(ue, &uo, b2, b4, b6);
+				b4 += 32;
+			}
+			else
+				avx2_RGBToAVC444YUV_SplitChroma(ue, NULL, b2, b4, b6);
+
+			b2 += 16;
+			b6 += 16;
+		}
+		{
+			/* v [b3, b5, b7] */
+			const __m256i ve = avx2_RGBToYUV_Chroma(xe1, xe2, xe3, xe4, v_factors, V_SHIFT);
+
+			if (b1Odd)
+			{
+				const __m256i vo = avx2_RGBToYUV_Chroma(xo1, xo2, xo3, xo4, v_factors, V_SHIFT);
+				avx2_RGBToAVC444YUV_SplitChroma(ve, &vo, b3, b5, b7);
+				b5 += 32;
+			}
+			else
+				avx2_RGBToAVC444YUV_SplitChroma(ve, NULL, b3, b5, b7);
+
+			b3 += 16;
+			b7 += 16;
+		}
+	}
+}
+
+static pstatus_t avx2_RGBToAVC444YUV_BGRX(const BYTE* pSrc, UINT32 srcFormat, UINT32 srcStep,
+                                          BYTE* pDst1[3], const UINT32 dst1Step[3], BYTE* pDst2[3],
+                                          const UINT32 dst2Step[3], const prim_size_t* roi)
+{
+	UINT32 y;
+	const BYTE* pMaxSrc = pSrc + (roi->height - 1) * srcStep;
+
+	if (roi->height < 1 || roi->width < 1)
+		return !PRIMITIVES_SUCCESS;
+
+	if (roi->width % 32)
+		return fallback.RGBToAVC444YUV(pSrc, srcFormat, srcStep, pDst1, dst1Step, pDst2,
+		                               dst2Step, roi);
+
+	for (y = 0; y < roi->height; y += 2)
+	{
+		const BOOL last = (y >= (roi->height - 1));
+		const BYTE* srcEven = y < roi->height ? pSrc + y * srcStep : pMaxSrc;
+		const BYTE* srcOdd = !last ? pSrc + (y + 1) * srcStep : pMaxSrc;
+		const UINT32 i = y >> 1;
+		const UINT32 n = (i & ~7) + i;
+		BYTE* b1Even = pDst1[0] + y * dst1Step[0];
+		BYTE* b1Odd = !last ? (b1Even + dst1Step[0]) : NULL;
+		BYTE* b2 = pDst1[1] + (y / 2) * dst1Step[1];
+		BYTE* b3 = pDst1[2] + (y / 2) * dst1Step[2];
+		BYTE* b4 = pDst2[0] + dst2Step[0] * n;
+		BYTE* b5 = b4 + 8 * dst2Step[0];
+		BYTE* b6 = pDst2[1] + (y / 2) * dst2Step[1];
+		BYTE* b7 = pDst2[2] + (y / 2) * dst2Step[2];
+		avx2_RGBToAVC444YUV_BGRX_DOUBLE_ROW(srcEven, srcOdd, b1Even, b1Odd, b2, b3, b4, b5, b6, b7,
+		                                    roi->width);
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+static pstatus_t avx2_RGBToAVC444YUV(const BYTE* pSrc, UINT32 srcFormat, UINT32 srcStep,
+                                     BYTE* pDst1[3], const UINT32 dst1Step[3], BYTE* pDst2[3],
+                                     const UINT32 dst2Step[3], const prim_size_t* roi)
+{
+	switch (srcFormat)
+	{
+		case PIXEL_FORMAT_BGRX32:
+		case PIXEL_FORMAT_BGRA32:
+			return avx2_RGBToAVC444YUV_BGRX(pSrc, srcFormat, srcStep, pDst1, dst1Step, pDst2,
+			                                dst2Step, roi);
+
+		default:
+			return fallback.RGBToAVC444YUV(pSrc, srcFormat, srcStep, pDst1, dst1Step, pDst2,
+			                               dst2Step, roi);
+	}
+}
+
+/****************************************************************************/
+/* AVX2 YUV420 -> YUV444 combination                                        */
+/****************************************************************************/
+
+/* Duplicate 32 bytes into 64 consecutive bytes */
+static INLINE void avx2_store_doubled(BYTE* dst, __m256i v)
+{
+	const __m256i lo = _mm256_unpacklo_epi8(v, v); /* bytes 0-7 and 16-23 */
+	const __m256i hi = _mm256_unpackhi_epi8(v, v); /* bytes 8-15 and 24-31 */
+	_mm256_storeu_si256((__m256i*)dst, _mm256_permute2x128_si256(lo, hi, 0x20));
+	_mm256_storeu_si256((__m256i*)&dst[32], _mm256_permute2x128_si256(lo, hi, 0x31));
+}
+
+/* Replace the bytes of dst selected by mask */
+static INLINE void avx2_blend_store(__m256i* dst, __m256i v, __m256i mask)
+{
+	_mm256_storeu_si256(dst, _mm256_blendv_epi8(_mm256_loadu_si256(dst), v, mask));
+}
+
+/* Write 32 bytes to the odd bytes of dst[0..63], the even bytes are kept */
+static INLINE void avx2_store_odd(BYTE* dst, __m256i v)
+{
+	const __m256i odd = _mm256_set1_epi16((short)0xFF00);
+	const __m256i lo = _mm256_unpacklo_epi8(v, v);
+	const __m256i hi = _mm256_unpackhi_epi8(v, v);
+	__m256i* out = (__m256i*)dst;
+	avx2_blend_store(&out[0], _mm256_permute2x128_si256(lo, hi, 0x20), odd);
+	avx2_blend_store(&out[1], _mm256_permute2x128_si256(lo, hi, 0x31), odd);
+}
+
+static pstatus_t avx2_LumaToYUV444(const BYTE* const pSrcRaw[3], const UINT32 srcStep[3],
+                                   BYTE* pDstRaw[3], const UINT32 dstStep[3],
+                                   const RECTANGLE_16* roi)
+{
+	UINT32 x, y;
+	const UINT32 nWidth = roi->right - roi->left;
+	const UINT32 nHeight = roi->bottom - roi->top;
+	const UINT32 halfWidth = (nWidth + 1) / 2;
+	const UINT32 halfPad = halfWidth % 32;
+	const UINT32 halfHeight = (nHeight + 1) / 2;
+	const BYTE* pSrc[3] = { pSrcRaw[0] + roi->top * srcStep[0] + roi->left,
+		                    pSrcRaw[1] + roi->top / 2 * srcStep[1] + roi->left / 2,
+		                    pSrcRaw[2] + roi->top / 2 * srcStep[2] + roi->left / 2 };
+	BYTE* pDst[3] = { pDstRaw[0] + roi->top * dstStep[0] + roi->left,
+		              pDstRaw[1] + roi->top * dstStep[1] + roi->left,
+		              pDstRaw[2] + roi->top * dstStep[2] + roi->left };
+
+	/* B1 */
+	for (y = 0; y < nHeight; y++)
+	{
+		const BYTE* Ym = pSrc[0] + srcStep[0] * y;
+		BYTE* pY = pDst[0] + dstStep[0] * y;
+		memcpy(pY, Ym, nWidth);
+	}
+
+	/* B2 and B3 */
+	for (y = 0; y < halfHeight; y++)
+	{
+		const UINT32 val2y = 2 * y;
+		const BYTE* Um = pSrc[1] + srcStep[1] * y;
+		const BYTE* Vm = pSrc[2] + srcStep[2] * y;
+		BYTE* pU = pDst[1] + dstStep[1] * val2y;
+		BYTE* pV = pDst[2] + dstStep[2] * val2y;
+		BYTE* pU1 = pDst[1] + dstStep[1] * (val2y + 1);
+		BYTE* pV1 = pDst[2] + dstStep[2] * (val2y + 1);
+
+		for (x = 0; x < halfWidth - halfPad; x += 32)
+		{
+			const __m256i u = _mm256_loadu_si256((const __m256i*)&Um[x]);
+			const __m256i v = _mm256_loadu_si256((const __m256i*)&Vm[x]);
+			avx2_store_doubled(&pU[2 * x], u);
+			avx2_store_doubled(&pU1[2 * x], u);
+			avx2_store_doubled(&pV[2 * x], v);
+			avx2_store_doubled(&pV1[2 * x], v);
+		}
+
+		for (; x < halfWidth; x++)
+		{
+			pU[2 * x] = pU[2 * x + 1] = pU1[2 * x] = pU1[2 * x + 1] = Um[x];
+			pV[2 * x] = pV[2 * x + 1] = pV1[2 * x] = pV1[2 * x + 1] = Vm[x];
+		}
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+/* Filter 16 pairs: the even byte becomes 4 * even - odd - next row even - next row odd */
+static INLINE void avx2_filter(BYTE* pSrcDst, const BYTE* pSrc2)
+{
+	const __m256i even = _mm256_set1_epi16(0x00FF);
+	const __m256i u = _mm256_loadu_si256((const __m256i*)pSrcDst);
+	const __m256i u1 = _mm256_loadu_si256((const __m256i*)pSrc2);
+	const __m256i uEven = _mm256_and_si256(u, even);
+	const __m256i uOdd = _mm256_srli_epi16(u, 8);
+	const __m256i u1Even = _mm256_and_si256(u1, even);
+	const __m256i u1Odd = _mm256_srli_epi16(u1, 8);
+	const __m256i sum = _mm256_add_epi16(_mm256_add_epi16(uOdd, u1Even), u1Odd);
+	const __m256i result = _mm256_sub_epi16(_mm256_slli_epi16(uEven, 2), sum);
+	/* clip to [0, 255] and put the odd bytes back */
+	const __m256i clipped =
+	    _mm256_max_epi16(_mm256_min_epi16(result, _mm256_set1_epi16(255)), _mm256_setzero_si256());
+	_mm256_storeu_si256((__m256i*)pSrcDst, _mm256_or_si256(clipped, _mm256_andnot_si256(even, u)));
+}
+
+static pstatus_t avx2_ChromaFilter(BYTE* pDst[3], const UINT32 dstStep[3], const RECTANGLE_16* roi)
+{
+	const UINT32 nWidth = roi->right - roi->left;
+	const UINT32 nHeight = roi->bottom - roi->top;
+	const UINT32 halfHeight = (nHeight + 1) / 2;
+	const UINT32 halfWidth = (nWidth + 1) / 2;
+	/* an odd last column has no pair inside the frame and is not filtered */
+	const UINT32 halfPad = (nWidth / 2) % 16;
+	UINT32 x, y;
+
+	for (y = roi->top; y < halfHeight + roi->top; y++)
+	{
+		const UINT32 val2y = y * 2;
+		const UINT32 val2y1 = val2y + 1;
+		BYTE* pU1 = pDst[1] + dstStep[1] * val2y1;
+		BYTE* pV1 = pDst[2] + dstStep[2] * val2y1;
+		BYTE* pU = pDst[1] + dstStep[1] * val2y;
+		BYTE* pV = pDst[2] + dstStep[2] * val2y;
+
+		if (val2y1 >= nHeight)
+			continue;
+
+		for (x = roi->left; x < nWidth / 2 + roi->left - halfPad; x += 16)
+		{
+			avx2_filter(&pU[2 * x], &pU1[2 * x]);
+			avx2_filter(&pV[2 * x], &pV1[2 * x]);
+		}
+
+		for (; x < halfWidth + roi->left; x++)
+		{
+			const UINT32 val2x = (x * 2);
+			const UINT32 val2x1 = val2x + 1;
+			const INT32 up = pU[val2x] * 4;
+			const INT32 vp = pV[val2x] * 4;
+			INT32 u2020;
+			INT32 v2020;
+
+			if (val2x1 >= nWidth)
+				continue;
+
+			u2020 = up - pU[val2x1] - pU1[val2x] - pU1[val2x1];
+			v2020 = vp - pV[val2x1] - pV1[val2x] - pV1[val2x1];
+			pU[val2x] = CLIP(u2020);
+			pV[val2x] = CLIP(v2020);
+		}
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+static pstatus_t avx2_ChromaV1ToYUV444(const BYTE* const pSrcRaw[3], const UINT32 srcStep[3],
+                                       BYTE* pDstRaw[3], const UINT32 dstStep[3],
+                                       const RECTANGLE_16* roi)
+{
+	const UINT32 mod = 16;
+	UINT32 uY = 0;
+	UINT32 vY = 0;
+	UINT32 x, y;
+	const UINT32 nWidth = roi->right - roi->left;
+	const UINT32 nHeight = roi->bottom - roi->top;
+	const UINT32 halfWidth = (nWidth + 1) / 2;
+	const UINT32 halfPad = halfWidth % 32;
+	const UINT32 halfHeight = (nHeight + 1) / 2;
+	/* The auxilary frame is aligned to multiples of 16x16.
+	 * We need the padded height for B4 and B5 conversion. */
+	const UINT32 padHeigth = nHeight + 16 - nHeight % 16;
+	const BYTE* pSrc[3] = { pSrcRaw[0] + roi->top * srcStep[0] + roi->left,
+		                    pSrcRaw[1] + roi->top / 2 * srcStep[1] + roi->left / 2,
+		                    pSrcRaw[2] + roi->top / 2 * srcStep[2] + roi->left / 2 };
+	BYTE* pDst[3] = { pDstRaw[0] + roi->top * dstStep[0] + roi->left,
+		              pDstRaw[1] + roi->top * dstStep[1] + roi->left,
+		              pDstRaw[2] + roi->top * dstStep[2] + roi->left };
+
+	/* B4 and B5 */
+	for (y = 0; y < padHeigth; y++)
+	{
+		const BYTE* Ya = pSrc[0] + srcStep[0] * y;
+		BYTE* pX;
+
+		if ((y) % mod < (mod + 1) / 2)
+		{
+			const UINT32 pos = (2 * uY++ + 1);
+
+			if (pos >= nHeight)
+				continue;
+
+			pX = pDst[1] + dstStep[1] * pos;
+		}
+		else
+		{
+			const UINT32 pos = (2 * vY++ + 1);
+
+			if (pos >= nHeight)
+				continue;
+
+			pX = pDst[2] + dstStep[2] * pos;
+		}
+
+		memcpy(pX, Ya, nWidth);
+	}
+
+	/* B6 and B7 */
+	for (y = 0; y < halfHeight; y++)
+	{
+		const UINT32 val2y = y * 2;
+		const BYTE* Ua = pSrc[1] + srcStep[1] * y;
+		const BYTE* Va = pSrc[2] + srcStep[2] * y;
+		BYTE* pU = pDst[1] + dstStep[1] * val2y;
+		BYTE* pV = pDst[2] + dstStep[2] * val2y;
+
+		for (x = 0; x < halfWidth - halfPad; x += 32)
+		{
+			avx2_store_odd(&pU[2 * x], _mm256_loadu_si256((const __m256i*)&Ua[x]));
+			avx2_store_odd(&pV[2 * x], _mm256_loadu_si256((const __m256i*)&Va[x]));
+		}
+
+		for (; x < halfWidth; x++)
+		{
+			pU[2 * x + 1] = Ua[x];
+			pV[2 * x + 1] = Va[x];
+		}
+	}
+
+	return avx2_ChromaFilter(pDst, dstStep, roi);
+}
+
+static pstatus_t avx2_ChromaV2ToYUV444(const BYTE* const pSrc[3], const UINT32 srcStep[3],
+                                       UINT32 nTotalWidth, UINT32 nTotalHeight, BYTE* pDst[3],
+                                       const UINT32 dstStep[3], const RECTANGLE_16* roi)
+{
+	UINT32 x, y;
+	const UINT32 nWidth = roi->right - roi->left;
+	const UINT32 nHeight = roi->bottom - roi->top;
+	const UINT32 halfWidth = (nWidth + 1) / 2;
+	const UINT32 halfPad = halfWidth % 32;
+	const UINT32 halfHeight = (nHeight + 1) / 2;
+	const UINT32 quaterWidth = (nWidth + 3) / 4;
+	const UINT32 quaterPad = quaterWidth % 16;
+	/* bytes 0 and 2 of every dword */
+	const __m256i mask = _mm256_set1_epi32(0x00FF00FF);
+	WINPR_UNUSED(nTotalHeight);
+
+	/* B4 and B5: odd UV values for width/2, height */
+	for (y = 0; y < nHeight; y++)
+	{
+		const UINT32 yTop = y + roi->top;
+		const BYTE* pYaU = pSrc[0] + srcStep[0] * yTop + roi->left / 2;
+		const BYTE* pYaV = pYaU + nTotalWidth / 2;
+		BYTE* pU = pDst[1] + dstStep[1] * yTop + roi->left;
+		BYTE* pV = pDst[2] + dstStep[2] * yTop + roi->left;
+
+		for (x = 0; x < halfWidth - halfPad; x += 32)
+		{
+			avx2_store_odd(&pU[2 * x], _mm256_loadu_si256((const __m256i*)&pYaU[x]));
+			avx2_store_odd(&pV[2 * x], _mm256_loadu_si256((const __m256i*)&pYaV[x]));
+		}
+
+		for (; x < halfWidth; x++)
+		{
+			const UINT32 odd = 2 * x + 1;
+			pU[odd] = pYaU[x];
+			pV[odd] = pYaV[x];
+		}
+	}
+
+	/* B6 - B9 */
+	for (y = 0; y < halfHeight; y++)
+	{
+		const BYTE* pUaU = pSrc[1] + srcStep[1] * (y + roi->top / 2) + roi->left / 4;
+		const BYTE* pUaV = pUaU + nTotalWidth / 4;
+		const BYTE* pVaU = pSrc[2] + srcStep[2] * (y + roi->top / 2) + roi->left / 4;
+		const BYTE* pVaV = pVaU + nTotalWidth / 4;
+		BYTE* pU = pDst[1] + dstStep[1] * (2 * y + 1 + roi->top) + roi->left;
+		BYTE* pV = pDst[2] + dstStep[2] * (2 * y + 1 + roi->top) + roi->left;
+
+		for (x = 0; x < quaterWidth - quaterPad; x += 16)
+		{
+			/* dword n is pUaU[n] | pVaU[n] << 16, for U as for V */
+			const __m256i uU = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)&pUaU[x]));
+			const __m256i uV = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)&pVaU[x]));
+			const __m256i vU = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)&pUaV[x]));
+			const __m256i vV = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)&pVaV[x]));
+			const __m256i uLo = _mm256_unpacklo_epi16(uU, uV);
+			const __m256i uHi = _mm256_unpackhi_epi16(uU, uV);
+			const __m256i vLo = _mm256_unpacklo_epi16(vU, vV);
+			const __m256i vHi = _mm256_unpackhi_epi16(vU, vV);
+			__m256i* u = (__m256i*)&pU[4 * x];
+			__m256i* v = (__m256i*)&pV[4 * x];
+			avx2_blend_store(&u[0], _mm256_permute2x128_si256(uLo, uHi, 0x20), mask);
+			avx2_blend_store(&u[1], _mm256_permute2x128_si256(uLo, uHi, 0x31), mask);
+			avx2_blend_store(&v[0], _mm256_permute2x128_si256(vLo, vHi, 0x20), mask);
+			avx2_blend_store(&v[1], _mm256_permute2x128_si256(vLo, vHi, 0x31), mask);
+		}
+
+		for (; x < quaterWidth; x++)
+		{
+			pU[4 * x + 0] = pUaU[x];
+			pV[4 * x + 0] = pUaV[x];
+			pU[4 * x + 2] = pVaU[x];
+			pV[4 * x + 2] = pVaV[x];
+		}
+	}
+
+	return avx2_ChromaFilter(pDst, dstStep, roi);
+}
+
+static pstatus_t avx2_YUV420CombineToYUV444(avc444_frame_type type, const BYTE* const pSrc[3],
+                                            const UINT32 srcStep[3], UINT32 nWidth, UINT32 nHeight,
+                                            BYTE* pDst[3], const UINT32 dstStep[3],
+                                            const RECTANGLE_16* roi)
+{
+	if (!pSrc || !pSrc[0] || !pSrc[1] || !pSrc[2])
+		return -1;
+
+	if (!pDst || !pDst[0] || !pDst[1] || !pDst[2])
+		return -1;
+
+	if (!roi)
+		return -1;
+
+	switch (type)
+	{
+		case AVC444_LUMA:
+			return avx2_LumaToYUV444(pSrc, srcStep, pDst, dstStep, roi);
+
+		case AVC444_CHROMAv1:
+			return avx2_ChromaV1ToYUV444(pSrc, srcStep, pDst, dstStep, roi);
+
+		case AVC444_CHROMAv2:
+			return avx2_ChromaV2ToYUV444(pSrc, srcStep, nWidth, nHeight, pDst, dstStep, roi);
+
+		default:
+			return -1;
+	}
+}
+
+void primitives_init_YUV_avx2(primitives_t* prims)
+{
+	generic = primitives_get_generic();
+	fallback = *prims;
+	prims->RGBToYUV420_8u_P3AC4R = avx2_RGBToYUV420;
+	prims->RGBToAVC444YUV = avx2_RGBToAVC444YUV;
+	prims->YUV420ToRGB_8u_P3AC4R = avx2_YUV420ToRGB;
+	prims->YUV444ToRGB_8u_P3AC4R = avx2_YUV444ToRGB_8u_P3AC4R;
+	prims->YUV420CombineToYUV444 = avx2_YUV420CombineToYUV444;
+}
@@ -465,7 +465,8 @@ static pstatus_t neon_ChromaFilter(BYTE* pDst[3], const UINT32 dstStep[3], const
 	const UINT32 nHeight = roi->bottom - roi->top;
 	const UINT32 halfHeight = (nHeight + 1) / 2;
 	const UINT32 halfWidth = (nWidth + 1) / 2;
-	const UINT32 halfPad = halfWidth % 16;
+	/* an odd last column has no pair inside the frame and is not filtered */
+	const UINT32 halfPad = (nWidth / 2) % 16;
 	UINT32 x, y;
 
 	/* Filter */
@@ -478,10 +479,10 @@ static pstatus_t neon_ChromaFilter(BYTE* pDst[3], const UINT32 dstStep[3], const
 		BYTE* pU = pDst[1] + dstStep[1] * val2y;
 		BYTE* pV = pDst[2] + dstStep[2] * val2y;
 
-		if (val2y1 > nHeight)
+		if (val2y1 >= nHeight)
 			continue;
 
-		for (x = roi->left / 2; x < halfWidth + roi->left / 2 - halfPad; x += 16)
+		for (x = roi->left / 2; x < nWidth / 2 + roi->left / 2 - halfPad; x += 16)
 		{
 			{
 				/* U = (U2x,2y << 2) - U2x1,2y - U2x,2y1 - U2x1,2y1 */
@@ -522,7 +523,7 @@ static pstatus_t neon_ChromaFilter(BYTE* pDst[3], const UINT32 dstStep[3], const
 			INT32 u2020;
 			INT32 v2020;
 
-			if (val2x1 > nWidth)
+			if (val2x1 >= nWidth)
 				continue;
 
 			u2020 = up - pU[val2x1] - pU1[val2x] - pU1[val2x1];
@@ -1167,7 +1167,8 @@ static pstatus_t ssse3_ChromaFilter(BYTE* pDst[3], const UINT32 dstStep[3], cons
 	const UINT32 nHeight = roi->bottom - roi->top;
 	const UINT32 halfHeight = (nHeight + 1) / 2;
 	const UINT32 halfWidth = (nWidth + 1) / 2;
-	const UINT32 halfPad = halfWidth % 16;
+	/* an odd last column has no pair inside the frame and is not filtered */
+	const UINT32 halfPad = (nWidth / 2) % 16;
 	UINT32 x, y;
 
 	/* Filter */
@@ -1180,13 +1181,16 @@ static pstatus_t ssse3_ChromaFilter(BYTE* pDst[3], const UINT32 dstStep[3], cons
 		BYTE* pU = pDst[1] + dstStep[1] * val2y;
 		BYTE* pV = pDst[2] + dstStep[2] * val2y;
 
-		if (val2y1 > nHeight)
+		if (val2y1 >= nHeight)
 			continue;
 
-		for (x = roi->left; x < halfWidth + roi->left - halfPad; x += 16)
+		for (x = roi->left; x < nWidth / 2 + roi->left - halfPad; x += 16)
 		{
+			/* ssse3_filter covers 8 pairs per call */
 			ssse3_filter(&pU[2 * x], &pU1[2 * x]);
+			ssse3_filter(&pU[2 * x + 16], &pU1[2 * x + 16]);
 			ssse3_filter(&pV[2 * x], &pV1[2 * x]);
+			ssse3_filter(&pV[2 * x + 16], &pV1[2 * x + 16]);
 		}
 
 		for (; x < halfWidth + roi->left; x++)
@@ -1198,7 +1202,7 @@ static pstatus_t ssse3_ChromaFilter(BYTE* pDst[3], const UINT32 dstStep[3], cons
 			INT32 u2020;
 			INT32 v2020;
 
-			if (val2x1 > nWidth)
+			if (val2x1 >= nWidth)
 				continue;
 
 			u2020 = up - pU[val2x1] - pU1[val2x] - pU1[val2x1];
@@ -1237,8 +1241,9 @@ static pstatus_t ssse3_ChromaV1ToYUV444(const BYTE* const pSrcRaw[3], const UINT
 		              pDstRaw[1] + roi->top * dstStep[1] + roi->left,
 		              pDstRaw[2] + roi->top * dstStep[2] + roi->left };
 	const __m128i zero = _mm_setzero_si128();
+	/* B6 and B7 go to the odd bytes, see the scalar loop */
 	const __m128i mask =
-	    _mm_set_epi8(0, 0x80, 0, 0x80, 0, 0x80, 0, 0x80, 0, 0x80, 0, 0x80, 0, 0x80, 0, 0x80);
+	    _mm_set_epi8(0x80, 0, 0x80, 0, 0x80, 0, 0x80, 0, 0x80, 0, 0x80, 0, 0x80, 0, 0x80, 0);
 
 	/* The second half of U and V is a bit more tricky... */
 	/* B4 and B5 */
@@ -1282,15 +1287,15 @@ static pstatus_t ssse3_ChromaV1ToYUV444(const BYTE* const pSrcRaw[3], const UINT
 		{
 			{
 				const __m128i u = _mm_loadu_si128((__m128i*)&Ua[x]);
-				const __m128i u2 = _mm_unpackhi_epi8(u, zero);
-				const __m128i u1 = _mm_unpacklo_epi8(u, zero);
+				const __m128i u2 = _mm_unpackhi_epi8(zero, u);
+				const __m128i u1 = _mm_unpacklo_epi8(zero, u);
 				_mm_maskmoveu_si128(u1, mask, (char*)&pU[2 * x]);
 				_mm_maskmoveu_si128(u2, mask, (char*)&pU[2 * x + 16]);
 			}
 			{
 				const __m128i u = _mm_loadu_si128((__m128i*)&Va[x]);
-				const __m128i u2 = _mm_unpackhi_epi8(u, zero);
-				const __m128i u1 = _mm_unpacklo_epi8(u, zero);
+				const __m128i u2 = _mm_unpackhi_epi8(zero, u);
+				const __m128i u1 = _mm_unpacklo_epi8(zero, u);
 				_mm_maskmoveu_si128(u1, mask, (char*)&pV[2 * x]);
 				_mm_maskmoveu_si128(u2, mask, (char*)&pV[2 * x + 16]);
 			}
@@ -0,0 +1,106 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Optimized color conversion operations - AVX2
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <freerdp/types.h>
+#include <freerdp/primitives.h>
+
+#include "prim_internal.h"
+
+#include <immintrin.h>
+
+#if !defined(WITH_AVX2)
+#error "This file needs WITH_AVX2 enabled!"
+#endif
+
+/* The AVX2 routines compute exactly what the SSE2 ones do, 16 values at a time.
+ * Regions the AVX2 code does not handle go to the routines registered before. */
+static primitives_t fallback = { 0 };
+
+/* The encoded YCbCr coefficients are 11.5 fixed-point numbers, see the general code.
+ * The RemoteFX encoder converts its 64x64 tiles in place. */
+static pstatus_t avx2_RGBToYCbCr_16s16s_P3P3(const INT16* const pSrc[3], INT32 srcStep,
+                                             INT16* pDst[3], INT32 dstStep,
+                                             const prim_size_t* roi) /* region of interest */
+{
+	const __m256i min = _mm256_set1_epi16(-128 * 32);
+	const __m256i max = _mm256_set1_epi16(127 * 32);
+	const __m256i y_r = _mm256_set1_epi16(9798);    /*  0.299000 << 15 */
+	const __m256i y_g = _mm256_set1_epi16(19235);   /*  0.587000 << 15 */
+	const __m256i y_b = _mm256_set1_epi16(3735);    /*  0.114000 << 15 */
+	const __m256i cb_r = _mm256_set1_epi16(-5535);  /* -0.168935 << 15 */
+	const __m256i cb_g = _mm256_set1_epi16(-10868); /* -0.331665 << 15 */
+	const __m256i cb_b = _mm256_set1_epi16(16403);  /*  0.500590 << 15 */
+	const __m256i cr_r = _mm256_set1_epi16(16377);  /*  0.499813 << 15 */
+	const __m256i cr_g = _mm256_set1_epi16(-13714); /* -0.418531 << 15 */
+	const __m256i cr_b = _mm256_set1_epi16(-2663);  /* -0.081282 << 15 */
+	UINT32 y;
+
+	if (roi->width & 0x0F)
+		return fallback.RGBToYCbCr_16s16s_P3P3(pSrc, srcStep, pDst, dstStep, roi);
+
+	for (y = 0; y < roi->height; y++)
+	{
+		UINT32 x;
+		const BYTE* rLine = (const BYTE*)pSrc[0] + 1ULL * y * srcStep;
+		const BYTE* gLine = (const BYTE*)pSrc[1] + 1ULL * y * srcStep;
+		const BYTE* bLine = (const BYTE*)pSrc[2] + 1ULL * y * srcStep;
+		BYTE* yLine = (BYTE*)pDst[0] + 1ULL * y * dstStep;
+		BYTE* cbLine = (BYTE*)pDst[1] + 1ULL * y * dstStep;
+		BYTE* crLine = (BYTE*)pDst[2] + 1ULL * y * dstStep;
+
+		for (x = 0; x < roi->width * sizeof(INT16); x += sizeof(__m256i))
+		{
+			/* r << 6 followed by the high word of the product with a factor << 15 is the
+			 * product >> 10, as in the SSE2 code. */
+			const __m256i r =
+			    _mm256_slli_epi16(_mm256_loadu_si256((const __m256i*)&rLine[x]), 6);
+			const __m256i g =
+			    _mm256_slli_epi16(_mm256_loadu_si256((const __m256i*)&gLine[x]), 6);
+			const __m256i b =
+			    _mm256_slli_epi16(_mm256_loadu_si256((const __m256i*)&bLine[x]), 6);
+			__m256i yv, cb, cr;
+			yv = _mm256_mulhi_epi16(r, y_r);
+			yv = _mm256_add_epi16(yv, _mm256_mulhi_epi16(g, y_g));
+			yv = _mm256_add_epi16(yv, _mm256_mulhi_epi16(b, y_b));
+			yv = _mm256_add_epi16(yv, min);
+			yv = _mm256_min_epi16(max, _mm256_max_epi16(yv, min));
+			cb = _mm256_mulhi_epi16(r, cb_r);
+			cb = _mm256_add_epi16(cb, _mm256_mulhi_epi16(g, cb_g));
+			cb = _mm256_add_epi16(cb, _mm256_mulhi_epi16(b, cb_b));
+			cb = _mm256_min_epi16(max, _mm256_max_epi16(cb, min));
+			cr = _mm256_mulhi_epi16(r, cr_r);
+			cr = _mm256_add_epi16(cr, _mm256_mulhi_epi16(g, cr_g));
+			cr = _mm256_add_epi16(cr, _mm256_mulhi_epi16(b, cr_b));
+			cr = _mm256_min_epi16(max, _mm256_max_epi16(cr, min));
+			_mm256_storeu_si256((__m256i*)&yLine[x], yv);
+			_mm256_storeu_si256((__m256i*)&cbLine[x], cb);
+			_mm256_storeu_si256((__m256i*)&crLine[x], cr);
+		}
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+void primitives_init_colors_avx2(primitives_t* prims)
+{
+	fallback = *prims;
+	prims->RGBToYCbCr_16s16s_P3P3 = avx2_RGBToYCbCr_16s16s_P3P3;
+}
@@ -18,6 +18,8 @@
 #endif
 
 #include <string.h>
+#include <winpr/synch.h>
+#include <winpr/sysinfo.h>
 #include <freerdp/types.h>
 #include <freerdp/primitives.h>
 #ifdef WITH_IPP
@@ -25,9 +27,119 @@
 #include <ippi.h>
 #endif /* WITH_IPP */
 #include "prim_internal.h"
+#include "prim_copy.h"
 
 static primitives_t* generic = NULL;
 
+/* Byte offsets of the color channels of the formats with a vectorized
+ * conversion. 16 bpp formats describe the expanded 32 bit lane, see prim_copy.h */
+typedef struct
+{
+	DWORD format;
+	UINT32 bytes;
+	INT32 r;
+	INT32 g;
+	INT32 b;
+	INT32 a; /* -1 if the pixel has no alpha (or padding) byte */
+} prim_copy_layout;
+
+static const prim_copy_layout copy_layouts[] = {
+	{ PIXEL_FORMAT_ARGB32, 4, 1, 2, 3, 0 },  { PIXEL_FORMAT_XRGB32, 4, 1, 2, 3, 0 },
+	{ PIXEL_FORMAT_ABGR32, 4, 3, 2, 1, 0 },  { PIXEL_FORMAT_XBGR32, 4, 3, 2, 1, 0 },
+	{ PIXEL_FORMAT_RGBA32, 4, 0, 1, 2, 3 },  { PIXEL_FORMAT_RGBX32, 4, 0, 1, 2, 3 },
+	{ PIXEL_FORMAT_BGRA32, 4, 2, 1, 0, 3 },  { PIXEL_FORMAT_BGRX32, 4, 2, 1, 0, 3 },
+	{ PIXEL_FORMAT_RGB24, 3, 0, 1, 2, -1 },  { PIXEL_FORMAT_BGR24, 3, 2, 1, 0, -1 },
+	{ PIXEL_FORMAT_RGB16, 2, 2, 1, 0, -1 },  { PIXEL_FORMAT_BGR16, 2, 0, 1, 2, -1 }
+};
+
+#define COPY_LAYOUT_COUNT ARRAYSIZE(copy_layouts)
+
+static prim_copy_conversion copy_conversions[COPY_LAYOUT_COUNT][COPY_LAYOUT_COUNT];
+static INIT_ONCE copy_conversions_InitOnce = INIT_ONCE_STATIC_INIT;
+
+/* ------------------------------------------------------------------------- */
+static INT32 copy_layout_index(DWORD format)
+{
+	size_t x;
+
+	for (x = 0; x < COPY_LAYOUT_COUNT; x++)
+	{
+		if (copy_layouts[x].format == format)
+			return (INT32)x;
+	}
+
+	return -1;
+}
+
+/* ------------------------------------------------------------------------- */
+static void copy_conversion_init(prim_copy_conversion* conv, const prim_copy_layout* src,
+                                 const prim_copy_layout* dst)
+{
+	UINT32 x;
+	/* 16 bpp pixels are shuffled in their expanded form */
+	const UINT32 srcStride = (src->bytes == 3) ? 3 : 4;
+	const UINT32 dstStride = (dst->bytes == 3) ? 3 : 4;
+
+	conv->srcBytes = src->bytes;
+	conv->dstBytes = dst->bytes;
+	memset(conv->shuffle, 0x80, sizeof(conv->shuffle));
+	memset(conv->alpha, 0, sizeof(conv->alpha));
+
+	for (x = 0; x < 4; x++)
+	{
+		BYTE* shuffle = &conv->shuffle[x * dstStride];
+		BYTE* alpha = &conv->alpha[x * dstStride];
+		const UINT32 base = x * srcStride;
+
+		shuffle[dst->r] = (BYTE)(base + src->r);
+		shuffle[dst->g] = (BYTE)(base + src->g);
+		shuffle[dst->b] = (BYTE)(base + src->b);
+
+		if ((dst->a < 0) || (dst->bytes != 4))
+			continue;
+
+		/* Match FreeRDPConvertColor: formats without alpha read as opaque,
+		 * XRGB32 and XBGR32 always write a zero padding byte. */
+		if ((dst->format == PIXEL_FORMAT_XRGB32) || (dst->format == PIXEL_FORMAT_XBGR32))
+			continue;
+
+		if (ColorHasAlpha(src->format) && (src->a >= 0))
+			shuffle[dst->a] = (BYTE)(base + src->a);
+		else
+			alpha[dst->a] = 0xFF;
+	}
+}
+
+static BOOL CALLBACK copy_conversions_init_cb(PINIT_ONCE once, PVOID param, PVOID* context)
+{
+	size_t x, y;
+	WINPR_UNUSED(once);
+	WINPR_UNUSED(param);
+	WINPR_UNUSED(context);
+
+	for (x = 0; x < COPY_LAYOUT_COUNT; x++)
+	{
+		for (y = 0; y < COPY_LAYOUT_COUNT; y++)
+			copy_conversion_init(&copy_conversions[x][y], &copy_layouts[x], &copy_layouts[y]);
+	}
+
+	return TRUE;
+}
+
+const prim_copy_conversion* prim_copy_get_conversion(DWORD SrcFormat, DWORD DstFormat)
+{
+	const INT32 src = copy_layout_index(SrcFormat);
+	const INT32 dst = copy_layout_index(DstFormat);
+
+	if ((src < 0) || (dst < 0))
+		return NULL;
+
+	if (!InitOnceExecuteOnce(&copy_conversions_InitOnce, copy_conversions_init_cb, NULL, NULL))
+		return NULL;
+
+	return &copy_conversions[src][dst];
+}
+
 /* ------------------------------------------------------------------------- */
 /*static inline BOOL memory_regions_overlap_1d(*/
 static BOOL memory_regions_overlap_1d(const BYTE* p1, const BYTE* p2, size_t bytes)
@@ -134,6 +246,58 @@ static pstatus_t general_copy_8u_AC4r(const BYTE* pSrc, INT32 srcStep, BYTE* pDs
 	return PRIMITIVES_SUCCESS;
 }
 
+/* ------------------------------------------------------------------------- */
+static pstatus_t generic_image_copy_no_overlap(BYTE* pDstData, DWORD DstFormat, UINT32 nDstStep,
+                                               UINT32 nXDst, UINT32 nYDst, UINT32 nWidth,
+                                               UINT32 nHeight, const BYTE* pSrcData,
+                                               DWORD SrcFormat, UINT32 nSrcStep, UINT32 nXSrc,
+                                               UINT32 nYSrc, const gdiPalette* palette,
+                                               UINT32 flags)
+{
+	UINT32 x, y;
+	const UINT32 dstByte = GetBytesPerPixel(DstFormat);
+	const UINT32 srcByte = GetBytesPerPixel(SrcFormat);
+	const BOOL vSrcVFlip = flags & FREERDP_FLIP_VERTICAL;
+	UINT32 srcVOffset = 0;
+	INT32 srcVMultiplier = 1;
+
+	if (nWidth == 0)
+		return PRIMITIVES_SUCCESS;
+
+	if (vSrcVFlip)
+	{
+		srcVOffset = (nHeight - 1) * nSrcStep;
+		srcVMultiplier = -1;
+	}
+
+	for (y = 0; y < nHeight; y++)
+	{
+		const BYTE* srcLine = &pSrcData[(y + nYSrc) * nSrcStep * srcVMultiplier + srcVOffset];
+		BYTE* dstLine = &pDstData[(y + nYDst) * nDstStep];
+
+		UINT32 color = ReadColor(&srcLine[nXSrc * srcByte], SrcFormat);
+		UINT32 oldColor = color;
+		UINT32 dstColor = FreeRDPConvertColor(color, SrcFormat, DstFormat, palette);
+		WriteColor(&dstLine[nXDst * dstByte], DstFormat, dstColor);
+		for (x = 1; x < nWidth; x++)
+		{
+			color = ReadColor(&srcLine[(x + nXSrc) * srcByte], SrcFormat);
+			if (color == oldColor)
+			{
+				WriteColor(&dstLine[(x + nXDst) * dstByte], DstFormat, dstColor);
+			}
+			else
+			{
+				oldColor = color;
+				dstColor = FreeRDPConvertColor(color, SrcFormat, DstFormat, palette);
+				WriteColor(&dstLine[(x + nXDst) * dstByte], DstFormat, dstColor);
+			}
+		}
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
 #ifdef WITH_IPP
 /* ------------------------------------------------------------------------- */
 /* This is just ippiCopy_8u_AC4R without the IppiSize structure parameter.   */
@@ -153,6 +317,7 @@ void primitives_init_copy(primitives_t* prims)
 	/* Start with the default. */
 	prims->copy_8u = general_copy_8u;
 	prims->copy_8u_AC4r = general_copy_8u_AC4r;
+	prims->copy_no_overlap = generic_image_copy_no_overlap;
 	/* This is just an alias with void* parameters */
 	prims->copy = (__copy_t)(prims->copy_8u);
 }
@@ -173,6 +338,16 @@ void primitives_init_copy_opt(primitives_t* prims)
 	 * Hence, no SSE version is used here unless once can be written that
 	 * is consistently faster than memcpy.
 	 */
+	/* Format conversions are plain byte shuffles, which do pay off. */
+#if defined(WITH_SSE2)
+	if (IsProcessorFeaturePresentEx(PF_EX_SSSE3) &&
+	    IsProcessorFeaturePresent(PF_SSE3_INSTRUCTIONS_AVAILABLE))
+		primitives_init_copy_ssse3(prims);
+#endif
+#if defined(WITH_AVX2)
+	if (IsProcessorFeaturePresentEx(PF_EX_AVX2))
+		primitives_init_copy_avx2(prims);
+#endif
 	/* This is just an alias with void* parameters */
 	prims->copy = (__copy_t)(prims->copy_8u);
 }
@@ -0,0 +1,79 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Pixel format conversion for the copy primitives
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_LIB_PRIM_COPY_H
+#define FREERDP_LIB_PRIM_COPY_H
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <freerdp/api.h>
+#include <freerdp/primitives.h>
+#include <freerdp/codec/color.h>
+
+/**
+ * A conversion between two of the 32, 24 or 16 bpp formats, expressed as a
+ * byte shuffle of four pixels followed by an OR with constant alpha bytes.
+ *
+ * 24 bpp pixels are loaded and stored packed (12 bytes for four pixels).
+ * 16 bpp pixels are expanded to 32 bit lanes before the shuffle, holding the
+ * low, middle and high color field scaled to 8 bit in bytes 0 to 2, and are
+ * packed from the same layout after it.
+ */
+typedef struct
+{
+	UINT32 srcBytes;  /* bytes per source pixel in memory */
+	UINT32 dstBytes;  /* bytes per destination pixel in memory */
+	BYTE shuffle[16]; /* pshufb mask, 0x80 clears the destination byte */
+	BYTE alpha[16];   /* ORed into the shuffled pixels */
+} prim_copy_conversion;
+
+/**
+ * The table is built once for all format pairs.
+ *
+ * @return the conversion from SrcFormat to DstFormat or NULL if the pair
+ *         has no vectorized conversion.
+ */
+FREERDP_LOCAL const prim_copy_conversion* prim_copy_get_conversion(DWORD SrcFormat,
+                                                                   DWORD DstFormat);
+
+#if defined(WITH_SSE2)
+FREERDP_LOCAL void primitives_init_copy_ssse3(primitives_t* prims);
+#endif
+#if defined(WITH_AVX2)
+FREERDP_LOCAL void primitives_init_copy_avx2(primitives_t* prims);
+#endif
+
+/* Scalar conversion of the pixels left over by the vector loops. */
+static INLINE void prim_copy_convert_pixels(BYTE* pDst, DWORD DstFormat, const BYTE* pSrc,
+                                            DWORD SrcFormat, UINT32 count,
+                                            const gdiPalette* palette)
+{
+	UINT32 x;
+	const UINT32 srcByte = GetBytesPerPixel(SrcFormat);
+	const UINT32 dstByte = GetBytesPerPixel(DstFormat);
+
+	for (x = 0; x < count; x++)
+	{
+		const UINT32 color = ReadColor(&pSrc[x * srcByte], SrcFormat);
+		const UINT32 dstColor = FreeRDPConvertColor(color, SrcFormat, DstFormat, palette);
+		WriteColor(&pDst[x * dstByte], DstFormat, dstColor);
+	}
+}
+
+#endif /* FREERDP_LIB_PRIM_COPY_H */
@@ -0,0 +1,166 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Optimized pixel format conversion - AVX2
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include <freerdp/types.h>
+#include <freerdp/primitives.h>
+
+#include "prim_internal.h"
+#include "prim_copy.h"
+
+#ifdef WITH_AVX2
+
+#include <immintrin.h>
+
+static primitives_t* generic = NULL;
+
+/* The shuffle masks of prim_copy_conversion describe four pixels, so every 128 bit lane
+ * holds four pixels and the mask is broadcast. 24 bpp pixels are loaded and stored per
+ * lane, 16 bpp pixels are widened across both lanes. */
+
+static INLINE __m128i avx2_load_rgb24(const BYTE* src)
+{
+	INT32 tail;
+	memcpy(&tail, &src[8], sizeof(tail));
+	return _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)src), _mm_cvtsi32_si128(tail));
+}
+
+static INLINE void avx2_store_rgb24(BYTE* dst, __m128i v)
+{
+	const INT32 tail = _mm_cvtsi128_si32(_mm_srli_si128(v, 8));
+	_mm_storel_epi64((__m128i*)dst, v);
+	memcpy(&dst[8], &tail, sizeof(tail));
+}
+
+static INLINE __m256i avx2_load_pixels(const BYTE* src, UINT32 bytes)
+{
+	switch (bytes)
+	{
+		case 4:
+			return _mm256_loadu_si256((const __m256i*)src);
+
+		case 3:
+			return _mm256_inserti128_si256(_mm256_castsi128_si256(avx2_load_rgb24(src)),
+			                               avx2_load_rgb24(&src[12]), 1);
+
+		default:
+		{
+			const __m256i v = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)src));
+			const __m256i mask5 = _mm256_set1_epi32(0x1F);
+			__m256i lo = _mm256_and_si256(v, mask5);
+			__m256i mid = _mm256_and_si256(_mm256_srli_epi32(v, 5), _mm256_set1_epi32(0x3F));
+			__m256i hi = _mm256_srli_epi32(v, 11);
+			lo = _mm256_or_si256(_mm256_slli_epi32(lo, 3), _mm256_srli_epi32(lo, 2));
+			hi = _mm256_or_si256(_mm256_slli_epi32(hi, 3), _mm256_srli_epi32(hi, 2));
+			mid = _mm256_add_epi32(_mm256_slli_epi32(mid, 2), _mm256_srli_epi32(mid, 3));
+			mid = _mm256_min_epi32(mid, _mm256_set1_epi32(0xFF));
+			return _mm256_or_si256(_mm256_or_si256(lo, _mm256_slli_epi32(mid, 8)),
+			                       _mm256_slli_epi32(hi, 16));
+		}
+	}
+}
+
+static INLINE void avx2_store_pixels(BYTE* dst, UINT32 bytes, __m256i v)
+{
+	switch (bytes)
+	{
+		case 4:
+			_mm256_storeu_si256((__m256i*)dst, v);
+			break;
+
+		case 3:
+			avx2_store_rgb24(dst, _mm256_castsi256_si128(v));
+			avx2_store_rgb24(&dst[12], _mm256_extracti128_si256(v, 1));
+			break;
+
+		default:
+		{
+			const __m256i pack = _mm256_setr_epi8(
+			    0, 1, 4, 5, 8, 9, 12, 13, -128, -128, -128, -128, -128, -128, -128, -128, 0, 1, 4,
+			    5, 8, 9, 12, 13, -128, -128, -128, -128, -128, -128, -128, -128);
+			const __m256i lo = _mm256_and_si256(_mm256_srli_epi32(v, 3), _mm256_set1_epi32(0x001F));
+			const __m256i mid =
+			    _mm256_and_si256(_mm256_srli_epi32(v, 5), _mm256_set1_epi32(0x07E0));
+			const __m256i hi = _mm256_and_si256(_mm256_srli_epi32(v, 8), _mm256_set1_epi32(0xF800));
+			__m256i packed = _mm256_or_si256(_mm256_or_si256(lo, mid), hi);
+			packed = _mm256_shuffle_epi8(packed, pack);
+			/* Gather the low quadword of both lanes */
+			packed = _mm256_permute4x64_epi64(packed, 0x08);
+			_mm_storeu_si128((__m128i*)dst, _mm256_castsi256_si128(packed));
+		}
+		break;
+	}
+}
+
+static pstatus_t avx2_image_copy_no_overlap(BYTE* pDstData, DWORD DstFormat, UINT32 nDstStep,
+                                            UINT32 nXDst, UINT32 nYDst, UINT32 nWidth,
+                                            UINT32 nHeight, const BYTE* pSrcData, DWORD SrcFormat,
+                                            UINT32 nSrcStep, UINT32 nXSrc, UINT32 nYSrc,
+                                            const gdiPalette* palette, UINT32 flags)
+{
+	UINT32 x, y;
+	__m256i shuffle, alpha;
+	UINT32 srcVOffset = 0;
+	INT32 srcVMultiplier = 1;
+	const prim_copy_conversion* conv = prim_copy_get_conversion(SrcFormat, DstFormat);
+
+	if (!conv)
+		return generic->copy_no_overlap(pDstData, DstFormat, nDstStep, nXDst, nYDst, nWidth,
+		                                nHeight, pSrcData, SrcFormat, nSrcStep, nXSrc, nYSrc,
+		                                palette, flags);
+
+	if (flags & FREERDP_FLIP_VERTICAL)
+	{
+		srcVOffset = (nHeight - 1) * nSrcStep;
+		srcVMultiplier = -1;
+	}
+
+	shuffle = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)conv->shuffle));
+	alpha = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)conv->alpha));
+
+	for (y = 0; y < nHeight; y++)
+	{
+		const BYTE* srcLine = &pSrcData[(y + nYSrc) * nSrcStep * srcVMultiplier + srcVOffset +
+		                                nXSrc * conv->srcBytes];
+		BYTE* dstLine = &pDstData[(y + nYDst) * nDstStep + nXDst * conv->dstBytes];
+
+		for (x = 0; x + 8 <= nWidth; x += 8)
+		{
+			__m256i v = avx2_load_pixels(&srcLine[x * conv->srcBytes], conv->srcBytes);
+			v = _mm256_or_si256(_mm256_shuffle_epi8(v, shuffle), alpha);
+			avx2_store_pixels(&dstLine[x * conv->dstBytes], conv->dstBytes, v);
+		}
+
+		prim_copy_convert_pixels(&dstLine[x * conv->dstBytes], DstFormat,
+		                         &srcLine[x * conv->srcBytes], SrcFormat, nWidth - x, palette);
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+void primitives_init_copy_avx2(primitives_t* prims)
+{
+	generic = primitives_get_generic();
+	prims->copy_no_overlap = avx2_image_copy_no_overlap;
+}
+
+#endif /* WITH_AVX2 */
@@ -0,0 +1,158 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Optimized pixel format conversion
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include <freerdp/types.h>
+#include <freerdp/primitives.h>
+
+#include "prim_internal.h"
+#include "prim_copy.h"
+
+#ifdef WITH_SSE2
+
+#include <emmintrin.h>
+#include <tmmintrin.h>
+
+static primitives_t* generic = NULL;
+
+/* Expand four 16 bpp pixels to 32 bit lanes as described in prim_copy.h */
+static INLINE __m128i ssse3_expand_565(__m128i v)
+{
+	const __m128i mask5 = _mm_set1_epi16(0x1F);
+	const __m128i mask6 = _mm_set1_epi16(0x3F);
+	__m128i lo = _mm_and_si128(v, mask5);
+	__m128i mid = _mm_and_si128(_mm_srli_epi16(v, 5), mask6);
+	__m128i hi = _mm_srli_epi16(v, 11);
+	lo = _mm_or_si128(_mm_slli_epi16(lo, 3), _mm_srli_epi16(lo, 2));
+	hi = _mm_or_si128(_mm_slli_epi16(hi, 3), _mm_srli_epi16(hi, 2));
+	/* SplitColor rounds the 6 bit field with an add that may exceed 255 */
+	mid = _mm_add_epi16(_mm_slli_epi16(mid, 2), _mm_srli_epi16(mid, 3));
+	mid = _mm_min_epi16(mid, _mm_set1_epi16(0xFF));
+	return _mm_unpacklo_epi16(_mm_or_si128(lo, _mm_slli_epi16(mid, 8)), hi);
+}
+
+/* Pack four expanded 32 bit lanes to 16 bpp, result in the lower 8 bytes */
+static INLINE __m128i ssse3_pack_565(__m128i v)
+{
+	const __m128i pack = _mm_setr_epi8(0, 1, 4, 5, 8, 9, 12, 13, -128, -128, -128, -128, -128,
+	                                   -128, -128, -128);
+	const __m128i lo = _mm_and_si128(_mm_srli_epi32(v, 3), _mm_set1_epi32(0x001F));
+	const __m128i mid = _mm_and_si128(_mm_srli_epi32(v, 5), _mm_set1_epi32(0x07E0));
+	const __m128i hi = _mm_and_si128(_mm_srli_epi32(v, 8), _mm_set1_epi32(0xF800));
+	return _mm_shuffle_epi8(_mm_or_si128(_mm_or_si128(lo, mid), hi), pack);
+}
+
+static INLINE __m128i ssse3_load_pixels(const BYTE* src, UINT32 bytes)
+{
+	switch (bytes)
+	{
+		case 4:
+			return _mm_loadu_si128((const __m128i*)src);
+
+		case 3:
+		{
+			INT32 tail;
+			memcpy(&tail, &src[8], sizeof(tail));
+			return _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)src),
+			                          _mm_cvtsi32_si128(tail));
+		}
+
+		default:
+			return ssse3_expand_565(_mm_loadl_epi64((const __m128i*)src));
+	}
+}
+
+static INLINE void ssse3_store_pixels(BYTE* dst, UINT32 bytes, __m128i v)
+{
+	switch (bytes)
+	{
+		case 4:
+			_mm_storeu_si128((__m128i*)dst, v);
+			break;
+
+		case 3:
+		{
+			const INT32 tail = _mm_cvtsi128_si32(_mm_srli_si128(v, 8));
+			_mm_storel_epi64((__m128i*)dst, v);
+			memcpy(&dst[8], &tail, sizeof(tail));
+		}
+		break;
+
+		default:
+			_mm_storel_epi64((__m128i*)dst, ssse3_pack_565(v));
+			break;
+	}
+}
+
+static pstatus_t ssse3_image_copy_no_overlap(BYTE* pDstData, DWORD DstFormat, UINT32 nDstStep,
+                                             UINT32 nXDst, UINT32 nYDst, UINT32 nWidth,
+                                             UINT32 nHeight, const BYTE* pSrcData, DWORD SrcFormat,
+                                             UINT32 nSrcStep, UINT32 nXSrc, UINT32 nYSrc,
+                                             const gdiPalette* palette, UINT32 flags)
+{
+	UINT32 x, y;
+	__m128i shuffle, alpha;
+	UINT32 srcVOffset = 0;
+	INT32 srcVMultiplier = 1;
+	const prim_copy_conversion* conv = prim_copy_get_conversion(SrcFormat, DstFormat);
+
+	if (!conv)
+		return generic->copy_no_overlap(pDstData, DstFormat, nDstStep, nXDst, nYDst, nWidth,
+		                                nHeight, pSrcData, SrcFormat, nSrcStep, nXSrc, nYSrc,
+		                                palette, flags);
+
+	if (flags & FREERDP_FLIP_VERTICAL)
+	{
+		srcVOffset = (nHeight - 1) * nSrcStep;
+		srcVMultiplier = -1;
+	}
+
+	shuffle = _mm_loadu_si128((const __m128i*)conv->shuffle);
+	alpha = _mm_loadu_si128((const __m128i*)conv->alpha);
+
+	for (y = 0; y < nHeight; y++)
+	{
+		const BYTE* srcLine = &pSrcData[(y + nYSrc) * nSrcStep * srcVMultiplier + srcVOffset +
+		                                nXSrc * conv->srcBytes];
+		BYTE* dstLine = &pDstData[(y + nYDst) * nDstStep + nXDst * conv->dstBytes];
+
+		for (x = 0; x + 4 <= nWidth; x += 4)
+		{
+			__m128i v = ssse3_load_pixels(&srcLine[x * conv->srcBytes], conv->srcBytes);
+			v = _mm_or_si128(_mm_shuffle_epi8(v, shuffle), alpha);
+			ssse3_store_pixels(&dstLine[x * conv->dstBytes], conv->dstBytes, v);
+		}
+
+		prim_copy_convert_pixels(&dstLine[x * conv->dstBytes], DstFormat,
+		                         &srcLine[x * conv->srcBytes], SrcFormat, nWidth - x, palette);
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+void primitives_init_copy_ssse3(primitives_t* prims)
+{
+	generic = primitives_get_generic();
+	prims->copy_no_overlap = ssse3_image_copy_no_overlap;
+}
+
+#endif /* WITH_SSE2 */
@@ -277,10 +277,18 @@ FREERDP_LOCAL void primitives_init_YCoCg_opt(primitives_t* prims);
 FREERDP_LOCAL void primitives_init_YUV_opt(primitives_t* prims);
 #endif
 
+#if defined(WITH_AVX2)
+FREERDP_LOCAL void primitives_init_colors_avx2(primitives_t* prims);
+FREERDP_LOCAL void primitives_init_YUV_avx2(primitives_t* prims);
+#endif
+
 #if defined(WITH_OPENCL)
 FREERDP_LOCAL BOOL primitives_init_opencl(primitives_t* prims);
 #endif
 
+/* CPU optimized routines without the AVX2 conversions, for the autodetection and tests */
+#define PRIMITIVES_ONLY_CPU_SSE 0x100
+
 FREERDP_LOCAL primitives_t* primitives_get_by_type(DWORD type);
 
 #endif /* FREERDP_LIB_PRIM_INTERNAL_H */
@@ -54,6 +54,11 @@ static INIT_ONCE generic_primitives_InitOnce = INIT_ONCE_STATIC_INIT;
 static primitives_t pPrimitivesCpu = { 0 };
 static INIT_ONCE cpu_primitives_InitOnce = INIT_ONCE_STATIC_INIT;
 
+#endif
+#if defined(WITH_AVX2)
+static primitives_t pPrimitivesCpuSse = { 0 };
+static INIT_ONCE cpu_sse_primitives_InitOnce = INIT_ONCE_STATIC_INIT;
+
 #endif
 #if defined(WITH_OPENCL)
 static primitives_t pPrimitivesGpu = { 0 };
@@ -90,7 +95,7 @@ static BOOL CALLBACK primitives_init_generic_cb(PINIT_ONCE once, PVOID param, PV
 	return primitives_init_generic(&pPrimitivesGeneric);
 }
 
-static BOOL primitives_init_optimized(primitives_t* prims)
+static BOOL primitives_init_optimized_sse(primitives_t* prims)
 {
 	primitives_init_generic(prims);
 
@@ -110,6 +115,22 @@ static BOOL primitives_init_optimized(primitives_t* prims)
 	return TRUE;
 }
 
+static BOOL primitives_init_optimized(primitives_t* prims)
+{
+	if (!primitives_init_optimized_sse(prims))
+		return FALSE;
+
+#if defined(WITH_AVX2)
+	/* Wider is not faster on every CPU, the autodetection benchmarks both variants. */
+	if (IsProcessorFeaturePresentEx(PF_EX_AVX2))
+	{
+		primitives_init_colors_avx2(prims);
+		primitives_init_YUV_avx2(prims);
+	}
+#endif
+	return TRUE;
+}
+
 typedef struct
 {
 	BYTE* channels[3];
@@ -220,6 +241,9 @@ static BOOL primitives_autodetect_best(primitives_t* prims)
 #if defined(HAVE_CPU_OPTIMIZED_PRIMITIVES)
 		{ "optimized", NULL, PRIMITIVES_ONLY_CPU, 0 },
 #endif
+#if defined(WITH_AVX2)
+		{ "optimized-sse", NULL, PRIMITIVES_ONLY_CPU_SSE, 0 },
+#endif
 #if defined(WITH_OPENCL)
 		{ "opencl", NULL, PRIMITIVES_ONLY_GPU, 0 },
 #endif
@@ -234,6 +258,8 @@ static BOOL primitives_autodetect_best(primitives_t* prims)
 	WLog_DBG(TAG, "primitives benchmark result:");
 	for (x = 0; x < ARRAYSIZE(testcases); x++)
 	{
+		size_t y;
+		BOOL duplicate = FALSE;
 		struct prim_benchmark* cur = &testcases[x];
 		cur->prims = primitives_get_by_type(cur->flags);
 		if (!cur->prims)
@@ -241,6 +267,18 @@ static BOOL primitives_autodetect_best(primitives_t* prims)
 			WLog_WARN(TAG, "Failed to initialize %s primitives", cur->name);
 			continue;
 		}
+
+		/* Sets that run the same conversion would only add noise to the result */
+		for (y = 0; y < x; y++)
+		{
+			const struct prim_benchmark* prev = &testcases[y];
+			if (prev->prims &&
+			    (prev->prims->YUV420ToRGB_8u_P3AC4R == cur->prims->YUV420ToRGB_8u_P3AC4R))
+				duplicate = TRUE;
+		}
+		if (duplicate)
+			continue;
+
 		if (!primitives_YUV_benchmark_run(yuvBench, cur->prims, benchDuration, &cur->count))
 		{
 			WLog_WARN(TAG, "error running %s YUV bench", cur->name);
@@ -297,6 +335,20 @@ static BOOL CALLBACK primitives_init_cpu_cb(PINIT_ONCE once, PVOID param, PVOID*
 }
 #endif
 
+#if defined(WITH_AVX2)
+static BOOL CALLBACK primitives_init_cpu_sse_cb(PINIT_ONCE once, PVOID param, PVOID* context)
+{
+	WINPR_UNUSED(once);
+	WINPR_UNUSED(param);
+	WINPR_UNUSED(context);
+
+	if (!primitives_init_optimized_sse(&pPrimitivesCpuSse))
+		return FALSE;
+
+	return TRUE;
+}
+#endif
+
 static BOOL CALLBACK primitives_auto_init_cb(PINIT_ONCE once, PVOID param, PVOID* context)
 {
 	WINPR_UNUSED(once);
@@ -326,6 +378,18 @@ BOOL primitives_init(primitives_t* p, primitive_hints hints)
 			return TRUE;
 #endif
 		default:
+			/* internal, lets the tests compare the SSE routines with the AVX2 ones */
+			if (hints == PRIMITIVES_ONLY_CPU_SSE)
+			{
+				primitives_t* sse = primitives_get_by_type(PRIMITIVES_ONLY_CPU_SSE);
+
+				if (!sse)
+					return FALSE;
+
+				*p = *sse;
+				return TRUE;
+			}
+
 			WLog_ERR(TAG, "unknown hint %d", hints);
 			return FALSE;
 	}
@@ -340,6 +404,10 @@ void primitives_uninit(void)
 #if defined(HAVE_CPU_OPTIMIZED_PRIMITIVES)
 	if (pPrimitivesCpu.uninit)
 		pPrimitivesCpu.uninit();
+#endif
+#if defined(WITH_AVX2)
+	if (pPrimitivesCpuSse.uninit)
+		pPrimitivesCpuSse.uninit();
 #endif
 	if (pPrimitivesGeneric.uninit)
 		pPrimitivesGeneric.uninit();
@@ -376,6 +444,15 @@ primitives_t* primitives_get_by_type(DWORD type)
 
 	switch (type)
 	{
+		case PRIMITIVES_ONLY_CPU_SSE:
+#if defined(WITH_AVX2)
+			if (!InitOnceExecuteOnce(&cpu_sse_primitives_InitOnce, primitives_init_cpu_sse_cb,
+			                         NULL, NULL))
+				return NULL;
+			return &pPrimitivesCpuSse;
+#else
+			return primitives_get_by_type(PRIMITIVES_ONLY_CPU);
+#endif
 		case PRIMITIVES_ONLY_GPU:
 #if defined(WITH_OPENCL)
 			if (!InitOnceExecuteOnce(&gpu_primitives_InitOnce, primitives_init_gpu_cb, NULL, NULL))
@@ -20,6 +20,7 @@
 #include <freerdp/utils/profiler.h>
 
 #include "prim_test.h"
+#include "../prim_internal.h"
 
 /* ------------------------------------------------------------------------- */
 static BOOL test_RGBToRGB_16s8u_P3AC4R_func(prim_size_t roi, DWORD DstFormat)
@@ -257,6 +258,85 @@ static int test_yCbCrToRGB_16s16s_P3P3_speed(void)
 	return TRUE;
 }
 
+/* ========================================================================= */
+/* The RemoteFX encoder converts in place, so do the SSE2 routines */
+static BOOL test_RGBToYCbCr_16s16s_P3P3_parity(const primitives_t* sse, const primitives_t* cpu,
+                                               UINT32 width)
+{
+	pstatus_t status;
+	INT16 ALIGN(r1[4096]), ALIGN(g1[4096]), ALIGN(b1[4096]);
+	INT16 ALIGN(r2[4096]), ALIGN(g2[4096]), ALIGN(b2[4096]);
+	int i;
+	INT16* buf1[3];
+	INT16* buf2[3];
+	prim_size_t roi = { 64, 64 };
+	roi.width = width;
+	winpr_RAND((BYTE*)r1, sizeof(r1));
+	winpr_RAND((BYTE*)g1, sizeof(g1));
+	winpr_RAND((BYTE*)b1, sizeof(b1));
+
+	/* Colors are 8 bit values scaled by << 5 */
+	for (i = 0; i < 4096; ++i)
+	{
+		r1[i] &= 0x1FE0U;
+		g1[i] &= 0x1FE0U;
+		b1[i] &= 0x1FE0U;
+	}
+
+	memcpy(r2, r1, sizeof(r1));
+	memcpy(g2, g1, sizeof(g1));
+	memcpy(b2, b1, sizeof(b1));
+	buf1[0] = r1;
+	buf1[1] = g1;
+	buf1[2] = b1;
+	buf2[0] = r2;
+	buf2[1] = g2;
+	buf2[2] = b2;
+	status = sse->RGBToYCbCr_16s16s_P3P3((const INT16**)buf1, 64 * 2, buf1, 64 * 2, &roi);
+
+	if (status != PRIMITIVES_SUCCESS)
+		return FALSE;
+
+	status = cpu->RGBToYCbCr_16s16s_P3P3((const INT16**)buf2, 64 * 2, buf2, 64 * 2, &roi);
+
+	if (status != PRIMITIVES_SUCCESS)
+		return FALSE;
+
+	for (i = 0; i < 4096; ++i)
+	{
+		if ((r1[i] != r2[i]) || (g1[i] != g2[i]) || (b1[i] != b2[i]))
+		{
+			printf("RGBToYCbCr width %" PRIu32 " FAIL[%d]: %" PRId16 ",%" PRId16 ",%" PRId16
+			       " vs %" PRId16 ",%" PRId16 ",%" PRId16 "\n",
+			       width, i, r1[i], g1[i], b1[i], r2[i], g2[i], b2[i]);
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+static BOOL test_RGBToYCbCr_16s16s_P3P3_func(void)
+{
+	size_t x;
+	primitives_t sse = { 0 };
+	primitives_t cpu = { 0 };
+	const UINT32 widths[] = { 64, 48, 40 };
+
+	/* with AVX2 the CPU set differs from the SSE one */
+	if (!primitives_init(&sse, PRIMITIVES_ONLY_CPU_SSE) ||
+	    !primitives_init(&cpu, PRIMITIVES_ONLY_CPU))
+		return FALSE;
+
+	for (x = 0; x < ARRAYSIZE(widths); x++)
+	{
+		if (!test_RGBToYCbCr_16s16s_P3P3_parity(&sse, &cpu, widths[x]))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
 int TestPrimitivesColors(int argc, char* argv[])
 {
 	const DWORD formats[] = { PIXEL_FORMAT_ARGB32, PIXEL_FORMAT_XRGB32, PIXEL_FORMAT_ABGR32,
@@ -268,6 +348,9 @@ int TestPrimitivesColors(int argc, char* argv[])
 	WINPR_UNUSED(argv);
 	prim_test_setup(FALSE);
 
+	if (!test_RGBToYCbCr_16s16s_P3P3_func())
+		return 1;
+
 	for (x = 0; x < sizeof(formats) / sizeof(formats[0]); x++)
 	{
 		if (!test_RGBToRGB_16s8u_P3AC4R_func(roi, formats[x]))
@@ -62,6 +62,70 @@ static BOOL test_copy8u_func(void)
 	return TRUE;
 }
 
+/* ------------------------------------------------------------------------- */
+static BOOL test_copy_no_overlap_func(void)
+{
+	const UINT32 formats[] = { PIXEL_FORMAT_ARGB32, PIXEL_FORMAT_XRGB32, PIXEL_FORMAT_ABGR32,
+		                       PIXEL_FORMAT_XBGR32, PIXEL_FORMAT_RGBA32, PIXEL_FORMAT_RGBX32,
+		                       PIXEL_FORMAT_BGRA32, PIXEL_FORMAT_BGRX32, PIXEL_FORMAT_RGB24,
+		                       PIXEL_FORMAT_BGR24,  PIXEL_FORMAT_RGB16,  PIXEL_FORMAT_BGR16,
+		                       PIXEL_FORMAT_RGB15 };
+	const UINT32 widths[] = { 1, 3, 4, 7, 8, 9, 15, 16, 33, 69 };
+	const UINT32 height = 5;
+	const UINT32 step = 4 * (69 + 3);
+	BYTE* src = calloc(height, step);
+	BYTE* dstGeneric = calloc(height, step);
+	BYTE* dstOptimized = calloc(height, step);
+	BOOL rc = FALSE;
+	size_t s, d, w;
+
+	if (!src || !dstGeneric || !dstOptimized)
+		goto fail;
+
+	winpr_RAND(src, height * step);
+
+	for (s = 0; s < ARRAYSIZE(formats); s++)
+	{
+		for (d = 0; d < ARRAYSIZE(formats); d++)
+		{
+			for (w = 0; w < ARRAYSIZE(widths); w++)
+			{
+				UINT32 flags;
+
+				for (flags = FREERDP_FLIP_NONE; flags <= FREERDP_FLIP_VERTICAL; flags++)
+				{
+					memset(dstGeneric, 0, height * step);
+					memset(dstOptimized, 0, height * step);
+
+					if ((generic->copy_no_overlap(dstGeneric, formats[d], step, 2, 0, widths[w],
+					                              height, src, formats[s], step, 1, 0, NULL,
+					                              flags) != PRIMITIVES_SUCCESS) ||
+					    (optimized->copy_no_overlap(dstOptimized, formats[d], step, 2, 0,
+					                                widths[w], height, src, formats[s], step, 1,
+					                                0, NULL, flags) != PRIMITIVES_SUCCESS))
+						goto fail;
+
+					if (memcmp(dstGeneric, dstOptimized, height * step) != 0)
+					{
+						printf("copy_no_overlap FAIL: %s -> %s width=%" PRIu32 " flags=%" PRIu32
+						       "\n",
+						       FreeRDPGetColorFormatName(formats[s]),
+						       FreeRDPGetColorFormatName(formats[d]), widths[w], flags);
+						goto fail;
+					}
+				}
+			}
+		}
+	}
+
+	rc = TRUE;
+fail:
+	free(src);
+	free(dstGeneric);
+	free(dstOptimized);
+	return rc;
+}
+
 /* ------------------------------------------------------------------------- */
 static BOOL test_copy8u_speed(void)
 {
@@ -88,6 +152,9 @@ int TestPrimitivesCopy(int argc, char* argv[])
 	if (!test_copy8u_func())
 		return 1;
 
+	if (!test_copy_no_overlap_func())
+		return 1;
+
 	if (g_TestPrimitivesPerformance)
 	{
 		if (!test_copy8u_speed())
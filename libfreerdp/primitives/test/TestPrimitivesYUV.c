@@ -6,6 +6,7 @@
 #include <math.h>
 
 #include "prim_test.h"
+#include "../prim_internal.h"
 
 #include <winpr/wlog.h>
 #include <winpr/crypto.h>
@@ -855,6 +856,114 @@ fail:
 	return rc;
 }
 
+/**
+ * Combines a main and an auxiliary frame of random data, every optimized variant has to
+ * produce exactly the output of the generic code. Odd sizes leave partial SIMD steps at the
+ * right and bottom edges of the chroma planes.
+ */
+static BOOL TestPrimitiveYUVCombineParity(primitives_t* prims, const char* name, UINT32 width,
+                                          UINT32 height, avc444_frame_type type)
+{
+	UINT32 x, y;
+	BOOL rc = FALSE;
+	RECTANGLE_16 rect;
+	BYTE* main[3] = { 0 };
+	BYTE* aux[3] = { 0 };
+	BYTE* expected[3] = { 0 };
+	BYTE* actual[3] = { 0 };
+	const UINT32 stride = width + 128 - width % 64;
+	const UINT32 lines = height + 32 - height % 16;
+	const UINT32 strides[3] = { stride, stride, stride };
+	const size_t size = 1ULL * stride * lines;
+	rect.left = 0;
+	rect.top = 0;
+	rect.right = (UINT16)width;
+	rect.bottom = (UINT16)height;
+
+	if (!prims->YUV420CombineToYUV444)
+		return TRUE;
+
+	for (x = 0; x < 3; x++)
+	{
+		if (!(main[x] = calloc(size, 1)) || !(aux[x] = calloc(size, 1)) ||
+		    !(expected[x] = calloc(size, 1)) || !(actual[x] = calloc(size, 1)))
+			goto fail;
+
+		winpr_RAND(main[x], size);
+		winpr_RAND(aux[x], size);
+	}
+
+	if ((generic->YUV420CombineToYUV444(AVC444_LUMA, (const BYTE**)main, strides, width, height,
+	                                    expected, strides, &rect) != PRIMITIVES_SUCCESS) ||
+	    (generic->YUV420CombineToYUV444(type, (const BYTE**)aux, strides, width, height,
+	                                    expected, strides, &rect) != PRIMITIVES_SUCCESS))
+		goto fail;
+
+	if ((prims->YUV420CombineToYUV444(AVC444_LUMA, (const BYTE**)main, strides, width, height,
+	                                  actual, strides, &rect) != PRIMITIVES_SUCCESS) ||
+	    (prims->YUV420CombineToYUV444(type, (const BYTE**)aux, strides, width, height, actual,
+	                                  strides, &rect) != PRIMITIVES_SUCCESS))
+		goto fail;
+
+	for (x = 0; x < 3; x++)
+	{
+		for (y = 0; y < height; y++)
+		{
+			if (memcmp(&expected[x][y * stride], &actual[x][y * stride], width) != 0)
+			{
+				fprintf(stderr,
+				        "%s %s %" PRIu32 "x%" PRIu32 ": plane %" PRIu32 " line %" PRIu32
+				        " differs from generic\n",
+				        name, (type == AVC444_CHROMAv1) ? "v1" : "v2", width, height, x, y);
+				goto fail;
+			}
+		}
+	}
+
+	rc = TRUE;
+fail:
+
+	for (x = 0; x < 3; x++)
+	{
+		free(main[x]);
+		free(aux[x]);
+		free(expected[x]);
+		free(actual[x]);
+	}
+
+	return rc;
+}
+
+static BOOL TestPrimitiveYUVCombineVariants(void)
+{
+	size_t x, y;
+	primitives_t sse = { 0 };
+	primitives_t cpu = { 0 };
+	const UINT32 sizes[][2] = { { 1, 1 },   { 3, 5 },     { 17, 9 },   { 33, 17 },
+		                        { 63, 31 }, { 65, 33 },   { 127, 63 }, { 255, 15 },
+		                        { 64, 64 }, { 1001, 77 } };
+	const avc444_frame_type types[] = { AVC444_CHROMAv1, AVC444_CHROMAv2 };
+
+	/* with AVX2 the CPU set differs from the SSE one */
+	if (!primitives_init(&sse, PRIMITIVES_ONLY_CPU_SSE) ||
+	    !primitives_init(&cpu, PRIMITIVES_ONLY_CPU))
+		return FALSE;
+
+	for (x = 0; x < ARRAYSIZE(sizes); x++)
+	{
+		for (y = 0; y < ARRAYSIZE(types); y++)
+		{
+			if (!TestPrimitiveYUVCombineParity(&sse, "sse", sizes[x][0], sizes[x][1],
+			                                   types[y]) ||
+			    !TestPrimitiveYUVCombineParity(&cpu, "cpu", sizes[x][0], sizes[x][1],
+			                                   types[y]))
+				return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
 int TestPrimitivesYUV(int argc, char* argv[])
 {
 	BOOL large = (argc > 1);
@@ -863,6 +972,12 @@ int TestPrimitivesYUV(int argc, char* argv[])
 	prim_test_setup(FALSE);
 	primitives_t* prims = primitives_get();
 
+	if (!TestPrimitiveYUVCombineVariants())
+	{
+		printf("TestPrimitiveYUVCombineVariants failed.\n");
+		goto end;
+	}
+
 	for (x = 0; x < 10; x++)
 	{
 		prim_size_t roi;
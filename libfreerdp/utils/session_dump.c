@@ -0,0 +1,194 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Session Dump Utils
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+
+#include <winpr/crt.h>
+#include <winpr/file.h>
+#include <winpr/synch.h>
+#include <winpr/sysinfo.h>
+
+#include <freerdp/log.h>
+#include <freerdp/utils/pcap.h>
+#include <freerdp/utils/session_dump.h>
+
+#define TAG FREERDP_TAG("utils.session_dump")
+
+#define SESSION_DUMP_PCAP_MAGIC 0xA1B2C3D4
+#define SESSION_DUMP_MAX_RECORD (64 * 1024 * 1024)
+
+struct rdp_session_dump
+{
+	FILE* fp;
+	BOOL write;
+	CRITICAL_SECTION lock;
+};
+
+static UINT64 session_dump_now(void)
+{
+	FILETIME ft;
+	ULARGE_INTEGER value;
+	GetSystemTimeAsFileTime(&ft);
+	value.u.LowPart = ft.dwLowDateTime;
+	value.u.HighPart = ft.dwHighDateTime;
+	/* FILETIME counts 100ns intervals since 1601, pcap wants the unix epoch */
+	return (value.QuadPart - 116444736000000000ULL) / 10ULL;
+}
+
+rdpSessionDump* session_dump_open(const char* filename, BOOL write)
+{
+	pcap_header header = { 0 };
+	rdpSessionDump* dump;
+
+	if (!filename)
+		return NULL;
+
+	dump = (rdpSessionDump*)calloc(1, sizeof(rdpSessionDump));
+
+	if (!dump)
+		return NULL;
+
+	if (!InitializeCriticalSectionAndSpinCount(&dump->lock, 4000))
+	{
+		free(dump);
+		return NULL;
+	}
+
+	dump->write = write;
+	dump->fp = winpr_fopen(filename, write ? "wb" : "rb");
+
+	if (!dump->fp)
+	{
+		WLog_ERR(TAG, "failed to open %s", filename);
+		goto fail;
+	}
+
+	if (write)
+	{
+		header.magic_number = SESSION_DUMP_PCAP_MAGIC;
+		header.version_major = 2;
+		header.version_minor = 4;
+		header.snaplen = 0xFFFFFFFF;
+
+		if (fwrite(&header, sizeof(header), 1, dump->fp) != 1)
+			goto fail;
+	}
+	else
+	{
+		if ((fread(&header, sizeof(header), 1, dump->fp) != 1) ||
+		    (header.magic_number != SESSION_DUMP_PCAP_MAGIC))
+		{
+			WLog_ERR(TAG, "%s is not a session dump", filename);
+			goto fail;
+		}
+	}
+
+	return dump;
+fail:
+	session_dump_close(dump);
+	return NULL;
+}
+
+void session_dump_close(rdpSessionDump* dump)
+{
+	if (!dump)
+		return;
+
+	if (dump->fp)
+		fclose(dump->fp);
+
+	DeleteCriticalSection(&dump->lock);
+	free(dump);
+}
+
+BOOL session_dump_write(rdpSessionDump* dump, BYTE type, const BYTE* data, size_t length)
+{
+	BOOL rc;
+	UINT64 now;
+	pcap_record_header header;
+
+	if (!dump || !dump->write || (!data && (length > 0)) || (length >= SESSION_DUMP_MAX_RECORD))
+		return FALSE;
+
+	now = session_dump_now();
+	header.ts_sec = (UINT32)(now / 1000000ULL);
+	header.ts_usec = (UINT32)(now % 1000000ULL);
+	header.incl_len = header.orig_len = (UINT32)length + 1;
+
+	/* Fastpath and channel data arrive on different threads */
+	EnterCriticalSection(&dump->lock);
+	rc = (fwrite(&header, sizeof(header), 1, dump->fp) == 1) &&
+	     (fwrite(&type, sizeof(type), 1, dump->fp) == 1) &&
+	     ((length == 0) || (fwrite(data, length, 1, dump->fp) == 1));
+	LeaveCriticalSection(&dump->lock);
+
+	if (!rc)
+		WLog_ERR(TAG, "failed to write session dump record");
+
+	return rc;
+}
+
+BOOL session_dump_write_desktop(rdpSessionDump* dump, UINT32 width, UINT32 height,
+                                UINT32 colorDepth)
+{
+	wStream s;
+	BYTE buffer[12];
+	Stream_StaticInit(&s, buffer, sizeof(buffer));
+	Stream_Write_UINT32(&s, width);
+	Stream_Write_UINT32(&s, height);
+	Stream_Write_UINT32(&s, colorDepth);
+	return session_dump_write(dump, SESSION_DUMP_DESKTOP, buffer, sizeof(buffer));
+}
+
+BOOL session_dump_read(rdpSessionDump* dump, BYTE* type, wStream* s, UINT64* timestamp)
+{
+	pcap_record_header header;
+
+	if (!dump || dump->write || !type || !s)
+		return FALSE;
+
+	if (fread(&header, sizeof(header), 1, dump->fp) != 1)
+		return FALSE;
+
+	if ((header.incl_len == 0) || (header.incl_len > SESSION_DUMP_MAX_RECORD))
+	{
+		WLog_ERR(TAG, "invalid session dump record length %" PRIu32 "", header.incl_len);
+		return FALSE;
+	}
+
+	if (fread(type, sizeof(BYTE), 1, dump->fp) != 1)
+		return FALSE;
+
+	Stream_SetPosition(s, 0);
+
+	if (!Stream_EnsureCapacity(s, header.incl_len - 1))
+		return FALSE;
+
+	if ((header.incl_len > 1) && (fread(Stream_Buffer(s), header.incl_len - 1, 1, dump->fp) != 1))
+		return FALSE;
+
+	Stream_SetLength(s, header.incl_len - 1);
+
+	if (timestamp)
+		*timestamp = header.ts_sec * 1000000ULL + header.ts_usec;
+
+	return TRUE;
+}
@@ -19,12 +19,22 @@
 
 #include <stdio.h>
 #include <string.h>
-#include <winpr/image.h>
 #include <winpr/sysinfo.h>
 #include <winpr/path.h>
 #include <winpr/file.h>
+#include <winpr/stream.h>
+#include <winpr/thread.h>
+#include <winpr/collections.h>
+#include <winpr/interlocked.h>
+
+#include <freerdp/codec/color.h>
+#include <freerdp/codec/planar.h>
+#include <freerdp/codec/region.h>
 
 #include "pf_capture.h"
+#include "pf_log.h"
+
+#define TAG PROXY_TAG("capture")
 
 static BOOL pf_capture_create_dir_if_not_exists(const char* path)
 {
@@ -134,35 +144,533 @@ BOOL pf_capture_create_session_directory(pClientContext* pc)
 	return TRUE;
 }
 
-/* saves a captured frame in a BMP format. */
-BOOL pf_capture_save_frame(pClientContext* pc, const BYTE* frame)
+/* Session capture container
+ *
+ * All frames of a session are appended to a single file, FRAMES_FILE_NAME in the session
+ * directory. Only the 64x64 tiles touched by the damaged region of a frame are stored, every
+ * CAPTURE_KEYFRAME_INTERVAL frames (and after a resize or a dropped frame) a keyframe holding
+ * all tiles is written. Tiles are planar (RLE, no alpha) compressed, or stored raw if that does
+ * not pay off. All values are little endian:
+ *
+ * header:  "FRDPCAP1", UINT32 version, UINT32 tileSize, UINT32 keyframeInterval,
+ *          UINT32 reserved, UINT64 indexOffset (0 until the capture was closed cleanly)
+ * frame:   UINT32 'FRAM', UINT32 flags, UINT64 timestamp (ms), UINT16 width, UINT16 height,
+ *          UINT32 tileCount, UINT32 payloadSize, tileCount * tile
+ * tile:    UINT16 x, UINT16 y, UINT16 width, UINT16 height, UINT32 codec, UINT32 size, data
+ *          codec 0 is top down BGRX32, codec 1 a bottom up planar bitmap
+ * index:   UINT32 'INDX', UINT32 count, count * (UINT64 frame, UINT64 timestamp, UINT64 offset)
+ *          of every keyframe
+ *
+ * Compression and file I/O run on a writer thread. The session thread only copies the damaged
+ * tiles; if the writer falls more than CAPTURE_MAX_PENDING_BYTES behind, frames are dropped and
+ * the next one is turned into a keyframe.
+ */
+
+#define FRAMES_FILE_NAME "frames.rdpcap"
+#define CAPTURE_FILE_MAGIC "FRDPCAP1"
+#define CAPTURE_FILE_VERSION 1
+#define CAPTURE_FRAME_MAGIC 0x4D415246 /* FRAM */
+#define CAPTURE_INDEX_MAGIC 0x58444E49 /* INDX */
+#define CAPTURE_FRAME_FLAG_KEYFRAME 0x00000001
+#define CAPTURE_TILE_CODEC_RAW 0
+#define CAPTURE_TILE_CODEC_PLANAR 1
+#define CAPTURE_TILE_SIZE 64
+#define CAPTURE_KEYFRAME_INTERVAL 300
+#define CAPTURE_MAX_PENDING_BYTES (64 * 1024 * 1024)
+
+typedef struct
+{
+	UINT64 timestamp;
+	BOOL keyframe;
+	UINT16 width;
+	UINT16 height;
+	UINT32 tileCount;
+	RECTANGLE_16* tiles;
+	BYTE* data; /* tile pixels, PIXEL_FORMAT_BGRX32, each packed with a stride of width * 4 */
+	size_t size;
+} proxyCaptureFrame;
+
+typedef struct
+{
+	UINT64 frame;
+	UINT64 timestamp;
+	UINT64 offset;
+} proxyCaptureIndexEntry;
+
+struct proxy_capture
+{
+	/* session thread */
+	UINT64 startTime;
+	UINT32 width;
+	UINT32 height;
+	UINT32 framesSinceKeyframe;
+	BOOL forceKeyframe;
+	UINT64 dropped;
+
+	/* shared */
+	wMessageQueue* queue;
+	HANDLE thread;
+	LONG pendingBytes;
+
+	/* writer thread */
+	FILE* fp;
+	UINT64 offset;
+	UINT64 frameCount;
+	wStream* s;
+	BITMAP_PLANAR_CONTEXT* planar;
+	BYTE* tileBuffer;
+	proxyCaptureIndexEntry* index;
+	size_t indexCount;
+	size_t indexSize;
+	BOOL failed;
+};
+
+static BOOL pf_capture_write(proxyCapture* capture, const void* data, size_t size)
+{
+	if (capture->failed)
+		return FALSE;
+
+	if (fwrite(data, 1, size, capture->fp) != size)
+	{
+		WLog_ERR(TAG, "failed to write %" PRIuz " bytes to the capture file", size);
+		capture->failed = TRUE;
+		return FALSE;
+	}
+
+	capture->offset += size;
+	return TRUE;
+}
+
+static BOOL pf_capture_write_stream(proxyCapture* capture)
+{
+	const size_t size = Stream_GetPosition(capture->s);
+	Stream_SetPosition(capture->s, 0);
+	return pf_capture_write(capture, Stream_Buffer(capture->s), size);
+}
+
+static BOOL pf_capture_write_header(proxyCapture* capture, UINT64 indexOffset)
+{
+	Stream_SetPosition(capture->s, 0);
+	Stream_Write(capture->s, CAPTURE_FILE_MAGIC, 8);
+	Stream_Write_UINT32(capture->s, CAPTURE_FILE_VERSION);
+	Stream_Write_UINT32(capture->s, CAPTURE_TILE_SIZE);
+	Stream_Write_UINT32(capture->s, CAPTURE_KEYFRAME_INTERVAL);
+	Stream_Write_UINT32(capture->s, 0); /* reserved */
+	Stream_Write_UINT64(capture->s, indexOffset);
+	return pf_capture_write_stream(capture);
+}
+
+static BOOL pf_capture_add_index(proxyCapture* capture, const proxyCaptureFrame* frame)
+{
+	proxyCaptureIndexEntry* entry;
+
+	if (capture->indexCount == capture->indexSize)
+	{
+		size_t size = capture->indexSize ? capture->indexSize * 2 : 64;
+		proxyCaptureIndexEntry* index = (proxyCaptureIndexEntry*)realloc(
+		    capture->index, size * sizeof(proxyCaptureIndexEntry));
+
+		if (!index)
+			return FALSE;
+
+		capture->index = index;
+		capture->indexSize = size;
+	}
+
+	entry = &capture->index[capture->indexCount++];
+	entry->frame = capture->frameCount;
+	entry->timestamp = frame->timestamp;
+	entry->offset = capture->offset;
+	return TRUE;
+}
+
+static BOOL pf_capture_write_frame(proxyCapture* capture, const proxyCaptureFrame* frame)
+{
+	UINT32 i;
+	size_t payloadPos;
+	const BYTE* data = frame->data;
+
+	if (frame->keyframe && !pf_capture_add_index(capture, frame))
+		return FALSE;
+
+	/* the frame is assembled in memory first so its header can carry the payload size */
+	Stream_SetPosition(capture->s, 0);
+
+	if (!Stream_EnsureRemainingCapacity(capture->s, 28))
+		return FALSE;
+
+	Stream_Write_UINT32(capture->s, CAPTURE_FRAME_MAGIC);
+	Stream_Write_UINT32(capture->s, frame->keyframe ? CAPTURE_FRAME_FLAG_KEYFRAME : 0);
+	Stream_Write_UINT64(capture->s, frame->timestamp);
+	Stream_Write_UINT16(capture->s, frame->width);
+	Stream_Write_UINT16(capture->s, frame->height);
+	Stream_Write_UINT32(capture->s, frame->tileCount);
+	Stream_Seek_UINT32(capture->s); /* payloadSize */
+	payloadPos = Stream_GetPosition(capture->s);
+
+	for (i = 0; i < frame->tileCount; i++)
+	{
+		const RECTANGLE_16* tile = &frame->tiles[i];
+		const UINT32 width = tile->right - tile->left;
+		const UINT32 height = tile->bottom - tile->top;
+		const UINT32 rawSize = width * height * 4;
+		UINT32 codec = CAPTURE_TILE_CODEC_PLANAR;
+		UINT32 size = 0;
+		const BYTE* tileData = capture->tileBuffer;
+
+		if (!freerdp_bitmap_compress_planar(capture->planar, data, PIXEL_FORMAT_BGRX32, width,
+		                                    height, width * 4, capture->tileBuffer, &size) ||
+		    (size >= rawSize))
+		{
+			codec = CAPTURE_TILE_CODEC_RAW;
+			size = rawSize;
+			tileData = data;
+		}
+
+		if (!Stream_EnsureRemainingCapacity(capture->s, 16 + size))
+			return FALSE;
+
+		Stream_Write_UINT16(capture->s, tile->left);
+		Stream_Write_UINT16(capture->s, tile->top);
+		Stream_Write_UINT16(capture->s, (UINT16)width);
+		Stream_Write_UINT16(capture->s, (UINT16)height);
+		Stream_Write_UINT32(capture->s, codec);
+		Stream_Write_UINT32(capture->s, size);
+		Stream_Write(capture->s, tileData, size);
+		data += rawSize;
+	}
+
+	{
+		const size_t end = Stream_GetPosition(capture->s);
+		Stream_SetPosition(capture->s, payloadPos - 4);
+		Stream_Write_UINT32(capture->s, (UINT32)(end - payloadPos));
+		Stream_SetPosition(capture->s, end);
+	}
+
+	capture->frameCount++;
+	return pf_capture_write_stream(capture);
+}
+
+static BOOL pf_capture_write_index(proxyCapture* capture)
+{
+	size_t i;
+	const UINT64 indexOffset = capture->offset;
+
+	Stream_SetPosition(capture->s, 0);
+
+	if (!Stream_EnsureRemainingCapacity(capture->s, 8 + capture->indexCount * 24))
+		return FALSE;
+
+	Stream_Write_UINT32(capture->s, CAPTURE_INDEX_MAGIC);
+	Stream_Write_UINT32(capture->s, (UINT32)capture->indexCount);
+
+	for (i = 0; i < capture->indexCount; i++)
+	{
+		Stream_Write_UINT64(capture->s, capture->index[i].frame);
+		Stream_Write_UINT64(capture->s, capture->index[i].timestamp);
+		Stream_Write_UINT64(capture->s, capture->index[i].offset);
+	}
+
+	if (!pf_capture_write_stream(capture))
+		return FALSE;
+
+	/* patch the index offset into the file header */
+	if (fseek(capture->fp, 0, SEEK_SET) != 0)
+		return FALSE;
+
+	return pf_capture_write_header(capture, indexOffset);
+}
+
+static DWORD WINAPI pf_capture_writer_thread(LPVOID arg)
+{
+	wMessage message;
+	proxyCapture* capture = (proxyCapture*)arg;
+
+	while (MessageQueue_Wait(capture->queue))
+	{
+		proxyCaptureFrame* frame;
+
+		if (!MessageQueue_Peek(capture->queue, &message, TRUE))
+			continue;
+
+		if (message.id == WMQ_QUIT)
+			break;
+
+		frame = (proxyCaptureFrame*)message.wParam;
+
+		if (!capture->failed && !pf_capture_write_frame(capture, frame))
+			capture->failed = TRUE;
+
+		InterlockedExchangeAdd(&capture->pendingBytes, -(LONG)frame->size);
+		free(frame);
+	}
+
+	if (!capture->failed && !pf_capture_write_index(capture))
+		WLog_ERR(TAG, "failed to write the capture index");
+
+	ExitThread(0);
+	return 0;
+}
+
+static void pf_capture_free(proxyCapture* capture)
+{
+	if (!capture)
+		return;
+
+	if (capture->thread)
+	{
+		MessageQueue_PostQuit(capture->queue, 0);
+		WaitForSingleObject(capture->thread, INFINITE);
+		CloseHandle(capture->thread);
+	}
+
+	if (capture->queue)
+	{
+		wMessage message;
+
+		while (MessageQueue_Peek(capture->queue, &message, TRUE))
+		{
+			if (message.id != WMQ_QUIT)
+				free(message.wParam);
+		}
+
+		MessageQueue_Free(capture->queue);
+	}
+
+	if (capture->fp)
+		fclose(capture->fp);
+
+	Stream_Free(capture->s, TRUE);
+	freerdp_bitmap_planar_context_free(capture->planar);
+	free(capture->tileBuffer);
+	free(capture->index);
+	free(capture);
+}
+
+/* opens the capture file in the session directory and starts the writer thread. */
+BOOL pf_capture_start(pClientContext* pc)
 {
-	rdpSettings* settings = pc->context.settings;
 	int rc;
-	const char* fmt = "%s/%" PRIu64 ".bmp";
 	char* file_path = NULL;
-	size_t size;
+	proxyCapture* capture;
 
 	if (!pc->frames_dir)
 		return FALSE;
 
-	rc = _snprintf(NULL, 0, fmt, pc->frames_dir, pc->frames_count++);
-	if (rc < 0)
+	capture = (proxyCapture*)calloc(1, sizeof(proxyCapture));
+
+	if (!capture)
 		return FALSE;
 
-	size = (size_t)rc;
-	file_path = malloc(size + 1);
-	if (!file_path)
+	rc = _snprintf(NULL, 0, "%s/%s", pc->frames_dir, FRAMES_FILE_NAME);
+
+	if ((rc < 0) || !(file_path = malloc((size_t)rc + 1)))
+		goto fail;
+
+	sprintf(file_path, "%s/%s", pc->frames_dir, FRAMES_FILE_NAME);
+	capture->fp = winpr_fopen(file_path, "wb");
+
+	if (!capture->fp)
+	{
+		WLog_ERR(TAG, "failed to create capture file %s", file_path);
+		goto fail;
+	}
+
+	setvbuf(capture->fp, NULL, _IOFBF, 1024 * 1024);
+	capture->planar = freerdp_bitmap_planar_context_new(
+	    PLANAR_FORMAT_HEADER_NA | PLANAR_FORMAT_HEADER_RLE, CAPTURE_TILE_SIZE, CAPTURE_TILE_SIZE);
+	capture->tileBuffer = (BYTE*)malloc(CAPTURE_TILE_SIZE * CAPTURE_TILE_SIZE * 4 * 2);
+	capture->s = Stream_New(NULL, 0x10000);
+	capture->queue = MessageQueue_New(NULL);
+
+	if (!capture->planar || !capture->tileBuffer || !capture->s || !capture->queue)
+		goto fail;
+
+	if (!pf_capture_write_header(capture, 0))
+		goto fail;
+
+	capture->startTime = GetTickCount64();
+	capture->forceKeyframe = TRUE;
+
+	if (!(capture->thread = CreateThread(NULL, 0, pf_capture_writer_thread, capture, 0, NULL)))
+		goto fail;
+
+	free(file_path);
+	pc->capture = capture;
+	return TRUE;
+fail:
+	free(file_path);
+	pf_capture_free(capture);
+	return FALSE;
+}
+
+/* flushes pending frames, writes the index and closes the capture file. */
+void pf_capture_stop(pClientContext* pc)
+{
+	if (!pc->capture)
+		return;
+
+	if (pc->capture->dropped > 0)
+		WLog_WARN(TAG, "%" PRIu64 " captured frames were dropped", pc->capture->dropped);
+
+	pf_capture_free(pc->capture);
+	pc->capture = NULL;
+}
+
+static UINT32 pf_capture_tile_count(const RECTANGLE_16* rect)
+{
+	const UINT32 nx = (rect->right - rect->left + CAPTURE_TILE_SIZE - 1) / CAPTURE_TILE_SIZE;
+	const UINT32 ny = (rect->bottom - rect->top + CAPTURE_TILE_SIZE - 1) / CAPTURE_TILE_SIZE;
+	return nx * ny;
+}
+
+/* queues the damaged area of the current frame for the writer thread. */
+BOOL pf_capture_frame(pClientContext* pc, const rdpGdi* gdi)
+{
+	INT32 i;
+	UINT32 j, k;
+	UINT32 nrects;
+	UINT32 tileCount = 0;
+	size_t size = 0;
+	BOOL rc = FALSE;
+	BOOL keyframe;
+	REGION16 region;
+	RECTANGLE_16 rect;
+	const RECTANGLE_16* rects;
+	proxyCaptureFrame* frame;
+	proxyCapture* capture = pc->capture;
+	const HGDI_WND hwnd = gdi->primary->hdc->hwnd;
+
+	if (!capture)
 		return FALSE;
 
-	rc = sprintf(file_path, fmt, pc->frames_dir, pc->frames_count++);
-	if (rc < 0 || (size_t)rc != size)
+	if ((capture->width != gdi->width) || (capture->height != gdi->height))
+	{
+		capture->width = gdi->width;
+		capture->height = gdi->height;
+		capture->forceKeyframe = TRUE;
+	}
+
+	keyframe = capture->forceKeyframe || (capture->framesSinceKeyframe >= CAPTURE_KEYFRAME_INTERVAL);
+	region16_init(&region);
+
+	/* align the damage to the tile grid, the union keeps the tiles disjoint */
+	for (i = 0; i < (keyframe ? 1 : hwnd->ninvalid); i++)
+	{
+		INT32 left = 0;
+		INT32 top = 0;
+		INT32 right = (INT32)capture->width;
+		INT32 bottom = (INT32)capture->height;
+
+		if (!keyframe)
+		{
+			const GDI_RGN* invalid = &hwnd->cinvalid[i];
+			left = MAX(invalid->x, 0) / CAPTURE_TILE_SIZE * CAPTURE_TILE_SIZE;
+			top = MAX(invalid->y, 0) / CAPTURE_TILE_SIZE * CAPTURE_TILE_SIZE;
+			right = MIN(invalid->x + invalid->w, right);
+			bottom = MIN(invalid->y + invalid->h, bottom);
+			right = MIN((right + CAPTURE_TILE_SIZE - 1) / CAPTURE_TILE_SIZE * CAPTURE_TILE_SIZE,
+			            (INT32)capture->width);
+			bottom = MIN((bottom + CAPTURE_TILE_SIZE - 1) / CAPTURE_TILE_SIZE * CAPTURE_TILE_SIZE,
+			             (INT32)capture->height);
+		}
+
+		if ((left >= right) || (top >= bottom))
+			continue;
+
+		rect.left = (UINT16)left;
+		rect.top = (UINT16)top;
+		rect.right = (UINT16)right;
+		rect.bottom = (UINT16)bottom;
+
+		if (!region16_union_rect(&region, &region, &rect))
+			goto out;
+	}
+
+	rects = region16_rects(&region, &nrects);
+
+	for (j = 0; j < nrects; j++)
+	{
+		tileCount += pf_capture_tile_count(&rects[j]);
+		size += 4ull * (rects[j].right - rects[j].left) * (rects[j].bottom - rects[j].top);
+	}
+
+	if (tileCount == 0)
+	{
+		rc = TRUE;
+		goto out;
+	}
+
+	if ((size_t)capture->pendingBytes + size > CAPTURE_MAX_PENDING_BYTES)
+	{
+		/* the writer can not keep up, resynchronize with a keyframe later on */
+		capture->forceKeyframe = TRUE;
+		capture->dropped++;
+		rc = TRUE;
+		goto out;
+	}
+
+	frame = (proxyCaptureFrame*)malloc(sizeof(proxyCaptureFrame) +
+	                                   tileCount * sizeof(RECTANGLE_16) + size);
+
+	if (!frame)
 		goto out;
 
-	rc = winpr_bitmap_write(file_path, frame, settings->DesktopWidth, settings->DesktopHeight,
-	                        settings->ColorDepth);
+	frame->timestamp = GetTickCount64() - capture->startTime;
+	frame->keyframe = keyframe;
+	frame->width = (UINT16)capture->width;
+	frame->height = (UINT16)capture->height;
+	frame->tileCount = tileCount;
+	frame->tiles = (RECTANGLE_16*)&frame[1];
+	frame->data = (BYTE*)&frame->tiles[tileCount];
+	frame->size = size;
+
+	{
+		RECTANGLE_16* tile = frame->tiles;
+		BYTE* dst = frame->data;
+
+		for (j = 0; j < nrects; j++)
+		{
+			UINT16 x, y;
+
+			for (y = rects[j].top; y < rects[j].bottom; y += CAPTURE_TILE_SIZE)
+			{
+				for (x = rects[j].left; x < rects[j].right; x += CAPTURE_TILE_SIZE)
+				{
+					const UINT32 width = MIN(CAPTURE_TILE_SIZE, rects[j].right - x);
+					const UINT32 height = MIN(CAPTURE_TILE_SIZE, rects[j].bottom - y);
+					const BYTE* src = &gdi->primary_buffer[y * gdi->stride + x * 4];
+
+					tile->left = x;
+					tile->top = y;
+					tile->right = (UINT16)(x + width);
+					tile->bottom = (UINT16)(y + height);
+					tile++;
+
+					for (k = 0; k < height; k++)
+					{
+						CopyMemory(dst, src, width * 4);
+						dst += width * 4;
+						src += gdi->stride;
+					}
+				}
+			}
+		}
+	}
+
+	InterlockedExchangeAdd(&capture->pendingBytes, (LONG)size);
+
+	if (!MessageQueue_Post(capture->queue, NULL, 0, frame, NULL))
+	{
+		InterlockedExchangeAdd(&capture->pendingBytes, -(LONG)size);
+		free(frame);
+		goto out;
+	}
 
+	capture->framesSinceKeyframe = keyframe ? 1 : capture->framesSinceKeyframe + 1;
+	capture->forceKeyframe = FALSE;
+	rc = TRUE;
 out:
-	free(file_path);
+	region16_uninit(&region);
 	return rc;
 }
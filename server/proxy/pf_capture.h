@@ -20,9 +20,14 @@
 #ifndef FREERDP_SERVER_PROXY_CAPTURE_H
 #define FREERDP_SERVER_PROXY_CAPTURE_H
 
+#include <freerdp/gdi/gdi.h>
+
 #include "pf_context.h"
 
 BOOL pf_capture_create_session_directory(pClientContext* context);
-BOOL pf_capture_save_frame(pClientContext* pc, const BYTE* frame);
+
+BOOL pf_capture_start(pClientContext* pc);
+void pf_capture_stop(pClientContext* pc);
+BOOL pf_capture_frame(pClientContext* pc, const rdpGdi* gdi);
 
 #endif /* FREERDP_SERVER_PROXY_CAPTURE_H */
@@ -201,6 +201,7 @@ static BOOL pf_client_pre_connect(freerdp* instance)
 	settings->DynamicResolutionUpdate = config->DisplayControl;
 
 	settings->AutoReconnectionEnabled = TRUE;
+	settings->AsyncTransport = config->AsyncTransport;
 
 	/**
 	 * Register the channel listeners.
@@ -323,6 +324,12 @@ static BOOL pf_client_post_connect(freerdp* instance)
 		}
 
 		LOG_ERR(TAG, pc, "frames dir created: %s", pc->frames_dir);
+
+		if (!pf_capture_start(pc))
+		{
+			LOG_ERR(TAG, pc, "pf_capture_start failed!");
+			return FALSE;
+		}
 	}
 
 	if (!gdi_init(instance, PIXEL_FORMAT_BGRA32))
@@ -396,6 +403,7 @@ static void pf_client_post_disconnect(freerdp* instance)
 	PubSub_UnsubscribeChannelDisconnected(instance->context->pubSub,
 	                                      pf_channels_on_client_channel_disconnect);
 	PubSub_UnsubscribeErrorInfo(instance->context->pubSub, pf_client_on_error_info);
+	pf_capture_stop(context);
 	gdi_free(instance);
 
 	/* Only close the connection if NLA fallback process is done */
@@ -631,6 +639,7 @@ static void pf_client_context_free(freerdp* instance, rdpContext* context)
 	if (!pc)
 		return;
 
+	pf_capture_stop(pc);
 	free(pc->frames_dir);
 	pc->frames_dir = NULL;
 
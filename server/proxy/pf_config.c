@@ -124,6 +124,11 @@ static BOOL pf_config_load_server(wIniFile* ini, proxyConfig* config)
 	if (!config->Host)
 		return FALSE;
 
+	config->AsyncTransport = pf_config_get_bool(ini, "Server", "AsyncTransport");
+
+	if (!pf_config_get_uint32(ini, "Server", "Workers", &config->Workers))
+		return FALSE;
+
 	return TRUE;
 }
 
@@ -316,6 +321,8 @@ void pf_server_config_print(proxyConfig* config)
 	CONFIG_PRINT_SECTION("Server");
 	CONFIG_PRINT_STR(config, Host);
 	CONFIG_PRINT_UINT16(config, Port);
+	CONFIG_PRINT_BOOL(config, AsyncTransport);
+	CONFIG_PRINT_UINT32(config, Workers);
 	CONFIG_PRINT_BOOL(config, SessionCapture);
 
 	if (!config->UseLoadBalanceInfo)
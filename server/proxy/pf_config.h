@@ -32,6 +32,8 @@ struct proxy_config
 	/* server */
 	char* Host;
 	UINT16 Port;
+	BOOL AsyncTransport;
+	UINT32 Workers;
 
 	/* target */
 	BOOL UseLoadBalanceInfo;
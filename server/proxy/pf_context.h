@@ -38,6 +38,7 @@
 #include "pf_server.h"
 
 typedef struct proxy_data proxyData;
+typedef struct proxy_capture proxyCapture;
 
 /**
  * Wraps rdpContext and holds the state for the proxy's server.
@@ -91,7 +92,7 @@ struct p_client_context
 
 	/* session capture */
 	char* frames_dir;
-	UINT64 frames_count;
+	proxyCapture* capture;
 
 	wHashTable* vc_ids; /* channel_name -> channel_id map */
 };
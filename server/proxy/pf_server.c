@@ -25,8 +25,13 @@
 #include <winpr/string.h>
 #include <winpr/winsock.h>
 #include <winpr/thread.h>
+#include <winpr/interlocked.h>
 #include <errno.h>
 
+#if !defined(_WIN32)
+#include <poll.h>
+#endif
+
 #include <freerdp/freerdp.h>
 #include <freerdp/channels/wtsvc.h>
 #include <freerdp/channels/channels.h>
@@ -281,6 +286,7 @@ static BOOL pf_server_initialize_peer_connection(freerdp_peer* peer)
 	settings->RdpSecurity = config->ServerRdpSecurity;
 	settings->TlsSecurity = config->ServerTlsSecurity;
 	settings->NlaSecurity = FALSE; /* currently NLA is not supported in proxy server */
+	settings->AsyncTransport = config->AsyncTransport;
 	settings->EncryptionLevel = ENCRYPTION_LEVEL_CLIENT_COMPATIBLE;
 	settings->ColorDepth = 32;
 	settings->SuppressOutput = TRUE;
@@ -299,59 +305,170 @@ static BOOL pf_server_initialize_peer_connection(freerdp_peer* peer)
 	if (ArrayList_Add(server->clients, pdata) < 0)
 		return FALSE;
 
-	CountdownEvent_AddCount(server->waitGroup, 1);
 	return TRUE;
 }
 
+static BOOL pf_server_peer_start(freerdp_peer* client)
+{
+	pServerContext* ps;
+
+	if (!pf_context_init_server_context(client))
+		return FALSE;
+
+	if (!pf_server_initialize_peer_connection(client))
+	{
+		freerdp_peer_context_free(client);
+		return FALSE;
+	}
+
+	ps = (pServerContext*)client->context;
+	client->Initialize(client);
+	LOG_INFO(TAG, ps, "peer connected: %s", client->hostname);
+	return TRUE;
+}
+
+static DWORD pf_server_peer_get_event_handles(freerdp_peer* client, HANDLE* events, DWORD count)
+{
+	DWORD nCount;
+	pServerContext* ps = (pServerContext*)client->context;
+
+	if (count < 3)
+		return 0;
+
+	nCount = client->GetEventHandles(client, events, count - 2);
+
+	if (nCount == 0)
+	{
+		WLog_ERR(TAG, "Failed to get FreeRDP transport event handles");
+		return 0;
+	}
+
+	events[nCount++] = WTSVirtualChannelManagerGetEventHandle(ps->vcm);
+	events[nCount++] = ps->pdata->abort_event;
+	return nCount;
+}
+
+/**
+ * Processes pending events of a peer. Returns FALSE once the session has to be
+ * torn down.
+ */
+static BOOL pf_server_peer_check(freerdp_peer* client)
+{
+	pServerContext* ps = (pServerContext*)client->context;
+	proxyData* pdata = ps->pdata;
+	HANDLE ChannelEvent = WTSVirtualChannelManagerGetEventHandle(ps->vcm);
+
+	if (client->CheckFileDescriptor(client) != TRUE)
+		return FALSE;
+
+	if (WaitForSingleObject(ChannelEvent, 0) == WAIT_OBJECT_0)
+	{
+		if (!WTSVirtualChannelManagerCheckFileDescriptor(ps->vcm))
+		{
+			WLog_ERR(TAG, "WTSVirtualChannelManagerCheckFileDescriptor failure");
+			return FALSE;
+		}
+	}
+
+	/* only disconnect after checking client's and vcm's file descriptors  */
+	if (proxy_data_shall_disconnect(pdata))
+	{
+		WLog_INFO(TAG, "abort event is set, closing connection with peer %s", client->hostname);
+		return FALSE;
+	}
+
+	switch (WTSVirtualChannelManagerGetDrdynvcState(ps->vcm))
+	{
+		/* Dynamic channel status may have been changed after processing */
+		case DRDYNVC_STATE_NONE:
+
+			/* Initialize drdynvc channel */
+			if (!WTSVirtualChannelManagerCheckFileDescriptor(ps->vcm))
+			{
+				WLog_ERR(TAG, "Failed to initialize drdynvc channel");
+				return FALSE;
+			}
+
+			break;
+
+		case DRDYNVC_STATE_READY:
+			if (WaitForSingleObject(ps->dynvcReady, 0) == WAIT_TIMEOUT)
+			{
+				SetEvent(ps->dynvcReady);
+			}
+
+			break;
+
+		default:
+			break;
+	}
+
+	return TRUE;
+}
+
+static void pf_server_peer_stop(freerdp_peer* client)
+{
+	pServerContext* ps = (pServerContext*)client->context;
+	proxyData* pdata = ps->pdata;
+	proxyServer* server = (proxyServer*)client->ContextExtra;
+	rdpContext* pc = (rdpContext*)pdata->pc;
+
+	LOG_INFO(TAG, ps, "starting shutdown of connection");
+	LOG_INFO(TAG, ps, "stopping proxy's client");
+	freerdp_client_stop(pc);
+	LOG_INFO(TAG, ps, "freeing server's channels");
+	pf_server_channels_free(ps);
+	LOG_INFO(TAG, ps, "freeing proxy data");
+	ArrayList_Remove(server->clients, pdata);
+	proxy_data_free(pdata);
+	freerdp_client_context_free(pc);
+	client->Close(client);
+	client->Disconnect(client);
+	freerdp_peer_context_free(client);
+}
+
+static void pf_server_peer_free(freerdp_peer* client)
+{
+	proxyServer* server = (proxyServer*)client->ContextExtra;
+
+	freerdp_peer_free(client);
+	CountdownEvent_Signal(server->waitGroup, 1);
+}
+
+#if !defined(_WIN32)
+static BOOL pf_server_worker_enqueue(proxyServer* server, freerdp_peer* client);
+#endif
+
 /**
  * Handles an incoming client connection, to be run in it's own thread.
  *
  * arg is a pointer to a freerdp_peer representing the client.
+ *
+ * With event loop workers, the thread only runs the blocking TLS/NLA accept and connection
+ * sequence, so a slow handshake never stalls the sessions sharing a worker. The activated
+ * peer is then handed to a worker and stays on this thread only if that fails.
  */
 static DWORD WINAPI pf_server_handle_peer(LPVOID arg)
 {
 	HANDLE eventHandles[32];
-	HANDLE ChannelEvent;
 	DWORD eventCount;
-	DWORD tmp;
 	DWORD status;
-	pServerContext* ps;
-	rdpContext* pc;
-	proxyData* pdata;
 	freerdp_peer* client = (freerdp_peer*)arg;
+#if !defined(_WIN32)
 	proxyServer* server = (proxyServer*)client->ContextExtra;
+#endif
 
-	if (!pf_context_init_server_context(client))
-		goto out_free_peer;
-
-	if (!pf_server_initialize_peer_connection(client))
+	if (!pf_server_peer_start(client))
 		goto out_free_peer;
 
-	ps = (pServerContext*)client->context;
-	pdata = ps->pdata;
-
-	client->Initialize(client);
-	LOG_INFO(TAG, ps, "peer connected: %s", client->hostname);
 	/* Main client event handling loop */
-	ChannelEvent = WTSVirtualChannelManagerGetEventHandle(ps->vcm);
-
 	while (1)
 	{
-		eventCount = 0;
-		{
-			tmp = client->GetEventHandles(client, &eventHandles[eventCount], 32 - eventCount);
+		eventCount = pf_server_peer_get_event_handles(client, eventHandles, 32);
 
-			if (tmp == 0)
-			{
-				WLog_ERR(TAG, "Failed to get FreeRDP transport event handles");
-				break;
-			}
+		if (eventCount == 0)
+			break;
 
-			eventCount += tmp;
-		}
-		eventHandles[eventCount++] = ChannelEvent;
-		eventHandles[eventCount++] = pdata->abort_event;
-		eventHandles[eventCount++] = WTSVirtualChannelManagerGetEventHandle(ps->vcm);
 		status = WaitForMultipleObjects(eventCount, eventHandles, FALSE, INFINITE);
 
 		if (status == WAIT_FAILED)
@@ -360,81 +477,318 @@ static DWORD WINAPI pf_server_handle_peer(LPVOID arg)
 			break;
 		}
 
-		if (client->CheckFileDescriptor(client) != TRUE)
+		if (!pf_server_peer_check(client))
 			break;
 
-		if (WaitForSingleObject(ChannelEvent, 0) == WAIT_OBJECT_0)
+#if !defined(_WIN32)
+		/* the worker now owns the peer and its wait group count */
+		if (client->activated && (server->workerCount > 0) &&
+		    pf_server_worker_enqueue(server, client))
 		{
-			if (!WTSVirtualChannelManagerCheckFileDescriptor(ps->vcm))
+			ExitThread(0);
+			return 0;
+		}
+#endif
+	}
+
+	pf_server_peer_stop(client);
+out_free_peer:
+	pf_server_peer_free(client);
+	ExitThread(0);
+	return 0;
+}
+
+#if !defined(_WIN32)
+/**
+ * Event loop worker, multiplexing the server side of many activated sessions on a
+ * single thread. The winpr handles of all sessions are mapped to their file descriptors
+ * and waited on with a single poll() call, as WaitForMultipleObjects is limited
+ * to MAXIMUM_WAIT_OBJECTS handles.
+ */
+struct proxy_server_worker
+{
+	proxyServer* server;
+	HANDLE thread;
+	HANDLE wakeEvent;
+	wQueue* pending; /* peers handed over by the listener thread */
+	LONG sessionCount;
+
+	/* owned by the worker thread */
+	freerdp_peer** sessions;
+	size_t nsessions;
+	size_t maxSessions;
+	struct pollfd* pollfds;
+	size_t* pollOwners;
+	size_t maxPollfds;
+};
+
+static BOOL pf_server_worker_add_session(proxyServerWorker* worker, freerdp_peer* client)
+{
+	if (worker->nsessions == worker->maxSessions)
+	{
+		size_t maxSessions = worker->maxSessions ? worker->maxSessions * 2 : 32;
+		freerdp_peer** sessions =
+		    (freerdp_peer**)realloc(worker->sessions, maxSessions * sizeof(freerdp_peer*));
+
+		if (!sessions)
+			return FALSE;
+
+		worker->sessions = sessions;
+		worker->maxSessions = maxSessions;
+	}
+
+	worker->sessions[worker->nsessions++] = client;
+	return TRUE;
+}
+
+static BOOL pf_server_worker_add_fd(proxyServerWorker* worker, size_t* count, HANDLE handle,
+                                    size_t owner)
+{
+	const int fd = GetEventFileDescriptor(handle);
+
+	if (fd < 0)
+	{
+		WLog_ERR(TAG, "handle without file descriptor, unable to poll it");
+		return FALSE;
+	}
+
+	if (*count == worker->maxPollfds)
+	{
+		size_t maxPollfds = worker->maxPollfds ? worker->maxPollfds * 2 : 128;
+		struct pollfd* pollfds =
+		    (struct pollfd*)realloc(worker->pollfds, maxPollfds * sizeof(struct pollfd));
+		size_t* owners;
+
+		if (!pollfds)
+			return FALSE;
+
+		worker->pollfds = pollfds;
+		owners = (size_t*)realloc(worker->pollOwners, maxPollfds * sizeof(size_t));
+
+		if (!owners)
+			return FALSE;
+
+		worker->pollOwners = owners;
+		worker->maxPollfds = maxPollfds;
+	}
+
+	worker->pollfds[*count].fd = fd;
+	worker->pollfds[*count].events = POLLIN;
+	worker->pollfds[*count].revents = 0;
+	worker->pollOwners[*count] = owner;
+	(*count)++;
+	return TRUE;
+}
+
+static void pf_server_worker_remove_session(proxyServerWorker* worker, size_t index, BOOL stop)
+{
+	freerdp_peer* client = worker->sessions[index];
+
+	if (stop)
+		pf_server_peer_stop(client);
+
+	pf_server_peer_free(client);
+	worker->sessions[index] = NULL;
+	InterlockedDecrement(&worker->sessionCount);
+}
+
+static void pf_server_worker_accept_pending(proxyServerWorker* worker)
+{
+	freerdp_peer* client;
+
+	/* reset first, so a peer queued while draining signals the event again */
+	ResetEvent(worker->wakeEvent);
+
+	while ((client = (freerdp_peer*)Queue_Dequeue(worker->pending)))
+	{
+		if (!pf_server_worker_add_session(worker, client))
+		{
+			pf_server_peer_stop(client);
+			pf_server_peer_free(client);
+			InterlockedDecrement(&worker->sessionCount);
+		}
+	}
+}
+
+static DWORD WINAPI pf_server_worker_thread(LPVOID arg)
+{
+	size_t i, j;
+	size_t count;
+	DWORD nevents;
+	HANDLE events[32];
+	proxyServerWorker* worker = (proxyServerWorker*)arg;
+	proxyServer* server = worker->server;
+
+	while (WaitForSingleObject(server->stopEvent, 0) != WAIT_OBJECT_0)
+	{
+		pf_server_worker_accept_pending(worker);
+		count = 0;
+
+		if (!pf_server_worker_add_fd(worker, &count, worker->wakeEvent, SIZE_MAX) ||
+		    !pf_server_worker_add_fd(worker, &count, server->stopEvent, SIZE_MAX))
+			break;
+
+		/* transport handles change during the connection sequence, so they are
+		 * gathered again on every iteration */
+		for (i = 0; i < worker->nsessions; i++)
+		{
+			nevents = pf_server_peer_get_event_handles(worker->sessions[i], events, 32);
+
+			for (j = 0; j < nevents; j++)
 			{
-				WLog_ERR(TAG, "WTSVirtualChannelManagerCheckFileDescriptor failure");
-				goto fail;
+				if (!pf_server_worker_add_fd(worker, &count, events[j], i))
+					break;
 			}
+
+			if ((nevents == 0) || (j < nevents))
+				pf_server_worker_remove_session(worker, i, TRUE);
 		}
 
-		/* only disconnect after checking client's and vcm's file descriptors  */
-		if (proxy_data_shall_disconnect(pdata))
+		if (poll(worker->pollfds, count, -1) < 0)
 		{
-			WLog_INFO(TAG, "abort event is set, closing connection with peer %s", client->hostname);
+			if (errno == EINTR)
+				continue;
+
+			WLog_ERR(TAG, "poll failed (errno: %d)", errno);
 			break;
 		}
 
-		switch (WTSVirtualChannelManagerGetDrdynvcState(ps->vcm))
+		for (i = 0; i < count; i++)
 		{
-			/* Dynamic channel status may have been changed after processing */
-			case DRDYNVC_STATE_NONE:
-
-				/* Initialize drdynvc channel */
-				if (!WTSVirtualChannelManagerCheckFileDescriptor(ps->vcm))
-				{
-					WLog_ERR(TAG, "Failed to initialize drdynvc channel");
-					goto fail;
-				}
+			const size_t owner = worker->pollOwners[i];
 
-				break;
+			if (!worker->pollfds[i].revents || (owner == SIZE_MAX) || !worker->sessions[owner])
+				continue;
 
-			case DRDYNVC_STATE_READY:
-				if (WaitForSingleObject(ps->dynvcReady, 0) == WAIT_TIMEOUT)
-				{
-					SetEvent(ps->dynvcReady);
-				}
+			/* a session is checked once, even if several of its handles fired */
+			if ((i + 1 < count) && (worker->pollOwners[i + 1] == owner))
+			{
+				worker->pollfds[i + 1].revents |= worker->pollfds[i].revents;
+				continue;
+			}
 
-				break;
+			if (!pf_server_peer_check(worker->sessions[owner]))
+				pf_server_worker_remove_session(worker, owner, TRUE);
+		}
 
-			default:
-				break;
+		/* compact the session list */
+		for (i = j = 0; i < worker->nsessions; i++)
+		{
+			if (worker->sessions[i])
+				worker->sessions[j++] = worker->sessions[i];
 		}
+
+		worker->nsessions = j;
 	}
 
-fail:
+	for (i = 0; i < worker->nsessions; i++)
+	{
+		if (worker->sessions[i])
+			pf_server_worker_remove_session(worker, i, TRUE);
+	}
 
-	pc = (rdpContext*)pdata->pc;
-	LOG_INFO(TAG, ps, "starting shutdown of connection");
-	LOG_INFO(TAG, ps, "stopping proxy's client");
-	freerdp_client_stop(pc);
-	LOG_INFO(TAG, ps, "freeing server's channels");
-	pf_server_channels_free(ps);
-	LOG_INFO(TAG, ps, "freeing proxy data");
-	ArrayList_Remove(server->clients, pdata);
-	proxy_data_free(pdata);
-	freerdp_client_context_free(pc);
-	client->Close(client);
-	client->Disconnect(client);
-out_free_peer:
-	freerdp_peer_context_free(client);
-	freerdp_peer_free(client);
-	CountdownEvent_Signal(server->waitGroup, 1);
+	worker->nsessions = 0;
 	ExitThread(0);
 	return 0;
 }
 
+static void pf_server_worker_free(proxyServerWorker* worker)
+{
+	freerdp_peer* client;
+
+	if (!worker)
+		return;
+
+	if (worker->thread)
+	{
+		WaitForSingleObject(worker->thread, INFINITE);
+		CloseHandle(worker->thread);
+	}
+
+	if (worker->pending)
+	{
+		/* peers handed over after the worker stopped */
+		while ((client = (freerdp_peer*)Queue_Dequeue(worker->pending)))
+		{
+			pf_server_peer_stop(client);
+			pf_server_peer_free(client);
+		}
+
+		Queue_Free(worker->pending);
+	}
+
+	if (worker->wakeEvent)
+		CloseHandle(worker->wakeEvent);
+
+	free(worker->sessions);
+	free(worker->pollfds);
+	free(worker->pollOwners);
+	free(worker);
+}
+
+static proxyServerWorker* pf_server_worker_new(proxyServer* server)
+{
+	proxyServerWorker* worker = (proxyServerWorker*)calloc(1, sizeof(proxyServerWorker));
+
+	if (!worker)
+		return NULL;
+
+	worker->server = server;
+
+	if (!(worker->wakeEvent = CreateEvent(NULL, TRUE, FALSE, NULL)))
+		goto fail;
+
+	if (!(worker->pending = Queue_New(TRUE, -1, -1)))
+		goto fail;
+
+	if (!(worker->thread = CreateThread(NULL, 0, pf_server_worker_thread, worker, 0, NULL)))
+		goto fail;
+
+	return worker;
+fail:
+	pf_server_worker_free(worker);
+	return NULL;
+}
+
+/* hands an activated peer to the least loaded worker, which then owns it */
+static BOOL pf_server_worker_enqueue(proxyServer* server, freerdp_peer* client)
+{
+	size_t i;
+	proxyServerWorker* worker = server->workers[0];
+
+	/* sessions are long lived, pick the least loaded worker */
+	for (i = 1; i < server->workerCount; i++)
+	{
+		if (server->workers[i]->sessionCount < worker->sessionCount)
+			worker = server->workers[i];
+	}
+
+	InterlockedIncrement(&worker->sessionCount);
+
+	if (!Queue_Enqueue(worker->pending, client))
+	{
+		InterlockedDecrement(&worker->sessionCount);
+		return FALSE;
+	}
+
+	SetEvent(worker->wakeEvent);
+	return TRUE;
+}
+#endif
+
 static BOOL pf_server_peer_accepted(freerdp_listener* listener, freerdp_peer* client)
 {
 	HANDLE hThread;
+	proxyServer* server = (proxyServer*)listener->info;
 	client->ContextExtra = listener->info;
 
+	CountdownEvent_AddCount(server->waitGroup, 1);
+
 	if (!(hThread = CreateThread(NULL, 0, pf_server_handle_peer, (void*)client, 0, NULL)))
+	{
+		CountdownEvent_Signal(server->waitGroup, 1);
 		return FALSE;
+	}
 
 	CloseHandle(hThread);
 	return TRUE;
@@ -509,6 +863,29 @@ BOOL pf_server_start(proxyServer* server)
 		goto error;
 	}
 
+#if !defined(_WIN32)
+	if (server->config->Workers > 0)
+	{
+		server->workers =
+		    (proxyServerWorker**)calloc(server->config->Workers, sizeof(proxyServerWorker*));
+
+		if (!server->workers)
+			goto error;
+
+		for (server->workerCount = 0; server->workerCount < server->config->Workers;
+		     server->workerCount++)
+		{
+			server->workers[server->workerCount] = pf_server_worker_new(server);
+
+			if (!server->workers[server->workerCount])
+				goto error;
+		}
+	}
+#else
+	if (server->config->Workers > 0)
+		WLog_WARN(TAG, "event loop workers are not supported on this platform, ignoring");
+#endif
+
 	server->thread = CreateThread(NULL, 0, pf_server_mainloop, (void*)server, 0, NULL);
 	if (!server->thread)
 		goto error;
@@ -591,6 +968,21 @@ void pf_server_free(proxyServer* server)
 	if (!server)
 		return;
 
+#if !defined(_WIN32)
+	if (server->workers)
+	{
+		size_t i;
+
+		/* workers exit once the stop event is set */
+		SetEvent(server->stopEvent);
+
+		for (i = 0; i < server->workerCount; i++)
+			pf_server_worker_free(server->workers[i]);
+
+		free(server->workers);
+	}
+#endif
+
 	freerdp_listener_free(server->listener);
 	ArrayList_Free(server->clients);
 	CountdownEvent_Free(server->waitGroup);
@@ -27,15 +27,19 @@
 
 #include "pf_config.h"
 
+typedef struct proxy_server_worker proxyServerWorker;
+
 typedef struct proxy_server
 {
 	proxyConfig* config;
 
 	freerdp_listener* listener;
-	wArrayList* clients;        /* maintain a list of active sessions, for stats */
-	wCountdownEvent* waitGroup; /* wait group used for gracefull shutdown */
-	HANDLE thread;              /* main server thread - freerdp listener thread */
-	HANDLE stopEvent;           /* an event used to signal the main thread to stop */
+	wArrayList* clients;         /* maintain a list of active sessions, for stats */
+	wCountdownEvent* waitGroup;  /* wait group used for gracefull shutdown */
+	HANDLE thread;               /* main server thread - freerdp listener thread */
+	HANDLE stopEvent;            /* an event used to signal the main thread to stop */
+	proxyServerWorker** workers; /* event loop workers, if sessions are multiplexed */
+	size_t workerCount;
 } proxyServer;
 
 proxyServer* pf_server_new(proxyConfig* config);
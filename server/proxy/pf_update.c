@@ -87,7 +87,7 @@ static BOOL pf_client_end_paint(rdpContext* context)
 	if (gdi->primary->hdc->hwnd->ninvalid < 1)
 		return TRUE;
 
-	if (!pf_capture_save_frame(pc, gdi->primary_buffer))
+	if (!pf_capture_frame(pc, gdi))
 		WLog_ERR(TAG, "failed to save captured frame!");
 
 	gdi->primary->hdc->hwnd->invalid->null = TRUE;
@@ -1,36 +1,172 @@
-import os
 import argparse
+import struct
 import time
 import cv2
-from os.path import join, getmtime
+import numpy as np
+from os.path import join, isdir
 
-def get_image_size(path):
-    img = cv2.imread(path)
-    height, width, _ = img.shape
-    return (width, height)
+FILE_MAGIC = b'FRDPCAP1'
+FRAME_MAGIC = 0x4D415246  # FRAM
+INDEX_MAGIC = 0x58444E49  # INDX
+FRAME_FLAG_KEYFRAME = 0x00000001
+TILE_CODEC_RAW = 0
+TILE_CODEC_PLANAR = 1
 
-def generate_video(output, frames, size, fps):
-    out = cv2.VideoWriter(
-        args.output, cv2.VideoWriter_fourcc(*'DIVX'), args.fps, size)
+HEADER = struct.Struct('<8sIIIIQ')
+FRAME_HEADER = struct.Struct('<IIQHHII')
+TILE_HEADER = struct.Struct('<HHHHII')
 
-    for frame in frames:
-        img = cv2.imread(frame)
-        out.write(img)
 
-    out.release()
+def decode_rle_plane(data, offset, width, height):
+    plane = np.zeros((height, width), dtype=np.uint8)
+    prev = None
+
+    for y in range(height):
+        line = plane[y]
+        x = 0
+        pixel = 0
+
+        while x < width:
+            control = data[offset]
+            offset += 1
+            run = control & 0x0F
+            raw = control >> 4
+
+            if run == 1:
+                run = raw + 16
+                raw = 0
+            elif run == 2:
+                run = raw + 32
+                raw = 0
+
+            for _ in range(raw):
+                value = data[offset]
+                offset += 1
+
+                if prev is not None:
+                    value = -((value >> 1) + 1) if value & 1 else value >> 1
+
+                pixel = value
+                line[x] = pixel if prev is None else (int(prev[x]) + pixel) & 0xFF
+                x += 1
+
+            for _ in range(run):
+                line[x] = pixel if prev is None else (int(prev[x]) + pixel) & 0xFF
+                x += 1
+
+        prev = line
+
+    return plane, offset
+
+
+def decode_planar(data, width, height):
+    # The proxy always writes RLE planes without alpha: R, G, B, scanlines are bottom up
+    offset = 1
+    planes = []
+
+    for _ in range(3):
+        plane, offset = decode_rle_plane(data, offset, width, height)
+        planes.append(plane)
+
+    red, green, blue = planes
+    return np.dstack((blue, green, red))[::-1]
+
+
+def decode_tile(codec, data, width, height):
+    if codec == TILE_CODEC_PLANAR:
+        return decode_planar(data, width, height)
+
+    if codec == TILE_CODEC_RAW:
+        pixels = np.frombuffer(data, dtype=np.uint8).reshape((height, width, 4))
+        return pixels[:, :, :3]
+
+    raise ValueError(f'unknown tile codec {codec}')
+
+
+def read_frames(path):
+    with open(path, 'rb') as f:
+        magic, version, _, _, _, _ = HEADER.unpack(f.read(HEADER.size))
+
+        if magic != FILE_MAGIC or version != 1:
+            raise ValueError(f'{path} is not a session capture file')
+
+        canvas = None
+
+        while True:
+            header = f.read(FRAME_HEADER.size)
+
+            if len(header) < FRAME_HEADER.size:
+                break
+
+            magic, flags, timestamp, width, height, count, size = FRAME_HEADER.unpack(header)
+
+            if magic == INDEX_MAGIC:
+                break
+
+            if magic != FRAME_MAGIC:
+                raise ValueError('corrupted capture file')
+
+            payload = f.read(size)
+
+            if len(payload) < size:
+                # the proxy did not close the capture, drop the truncated frame
+                break
+
+            if canvas is None or canvas.shape[:2] != (height, width):
+                if not flags & FRAME_FLAG_KEYFRAME:
+                    continue
+
+                canvas = np.zeros((height, width, 3), dtype=np.uint8)
+
+            offset = 0
+
+            for _ in range(count):
+                x, y, w, h, codec, length = TILE_HEADER.unpack_from(payload, offset)
+                offset += TILE_HEADER.size
+                tile = decode_tile(codec, payload[offset:offset + length], w, h)
+                canvas[y:y + h, x:x + w] = tile
+                offset += length
+
+            yield timestamp, canvas
+
+
+def generate_video(path, output, fps):
+    out = None
+    written = 0
+    interval = 1000.0 / fps
+
+    for timestamp, canvas in read_frames(path):
+        height, width, _ = canvas.shape
+
+        if out is None:
+            size = (width, height)
+            out = cv2.VideoWriter(output, cv2.VideoWriter_fourcc(*'DIVX'), fps, size)
+        elif (width, height) != size:
+            canvas = cv2.resize(canvas, size)
+
+        # repeat the current frame until the video caught up with its timestamp
+        while written * interval <= timestamp:
+            out.write(canvas)
+            written += 1
+
+    if out is not None:
+        out.release()
+
+    return written
+
 
 def main(args):
-    # Load input frames, sorted by creation time.
-    files = [join(args.input, f) for f in os.listdir(
-        args.input) if os.path.isfile(join(args.input, f))]
-    files.sort(key=lambda x: getmtime(x))
+    path = args.input
+
+    if isdir(path):
+        path = join(path, 'frames.rdpcap')
 
     print('Generating video...')
-    print(f'Frame count: {len(files)}')
 
     start = time.time()
-    generate_video(args.output, files, get_image_size(files[0]), args.fps)
+    count = generate_video(path, args.output, args.fps)
 
+    print(f'Frame count: {count}')
     print(
         f'Output file {args.output} generated in {time.time() - start} seconds.')
 
@@ -38,7 +174,7 @@ def main(args):
 if __name__ == "__main__":
     parser = argparse.ArgumentParser()
     parser.add_argument(
-        "-i", "--input", help="path to a directory containing all frames")
+        "-i", "--input", help="session capture directory or frames.rdpcap file")
     parser.add_argument(
         "-o", "--output", help="avi output file path", default="video.avi")
     parser.add_argument("-f", "--fps", type=int, help="frames per second", default=8)
@@ -43,6 +43,7 @@
 #include <freerdp/codec/region.h>
 
 #include "x11_shadow.h"
+#include "../shadow_capture.h"
 
 #define TAG SERVER_TAG("shadow.x11")
 
@@ -582,7 +583,7 @@ static void x11_shadow_validate_region(x11ShadowSubsystem* subsystem, int x, int
 	region.y = y;
 	region.width = width;
 	region.height = height;
-#ifdef WITH_XFIXES
+#if defined(WITH_XFIXES) && defined(WITH_XDAMAGE)
 	XLockDisplay(subsystem->display);
 	XFixesSetRegion(subsystem->display, subsystem->xdamage_region, &region, 1);
 	XDamageSubtract(subsystem->display, subsystem->xdamage, subsystem->xdamage_region, None);
@@ -744,9 +745,8 @@ static int x11_shadow_screen_grab(x11ShadowSubsystem* subsystem)
 	XImage* image;
 	rdpShadowServer* server;
 	rdpShadowSurface* surface;
-	RECTANGLE_16 invalidRect;
+	REGION16 invalidRegion;
 	RECTANGLE_16 surfaceRect;
-	const RECTANGLE_16* extents;
 	server = subsystem->common.server;
 	surface = server->surface;
 	count = ArrayList_Count(server->clients);
@@ -754,6 +754,8 @@ static int x11_shadow_screen_grab(x11ShadowSubsystem* subsystem)
 	if (count < 1)
 		return 1;
 
+	region16_init(&invalidRegion);
+
 	EnterCriticalSection(&surface->lock);
 	surfaceRect.left = 0;
 	surfaceRect.top = 0;
@@ -775,9 +777,8 @@ static int x11_shadow_screen_grab(x11ShadowSubsystem* subsystem)
 		          subsystem->xshm_gc, 0, 0, subsystem->width, subsystem->height, 0, 0);
 
 		EnterCriticalSection(&surface->lock);
-		status = shadow_capture_compare(surface->data, surface->scanline, surface->width,
-		                                surface->height, (BYTE*)&(image->data[surface->width * 4]),
-		                                image->bytes_per_line, &invalidRect);
+		status = server->capture->CompareTiles(surface, (BYTE*)image->data,
+		                                       image->bytes_per_line, &invalidRegion);
 		LeaveCriticalSection(&surface->lock);
 	}
 	else
@@ -788,9 +789,8 @@ static int x11_shadow_screen_grab(x11ShadowSubsystem* subsystem)
 
 		if (image)
 		{
-			status = shadow_capture_compare(surface->data, surface->scanline, surface->width,
-			                                surface->height, (BYTE*)image->data,
-			                                image->bytes_per_line, &invalidRect);
+			status = server->capture->CompareTiles(surface, (BYTE*)image->data,
+			                                       image->bytes_per_line, &invalidRegion);
 		}
 		LeaveCriticalSection(&surface->lock);
 		if (!image)
@@ -803,32 +803,49 @@ static int x11_shadow_screen_grab(x11ShadowSubsystem* subsystem)
 		}
 	}
 
+	if (status < 0)
+		goto fail_capture;
+
 	/* Restore the default error handler */
 	XSetErrorHandler(NULL);
 	XSync(subsystem->display, False);
 	XUnlockDisplay(subsystem->display);
 
-	if (status)
+	if (status > 0)
 	{
 		BOOL empty;
+		UINT32 index;
+		UINT32 numRects = 0;
+		const RECTANGLE_16* rects;
 		EnterCriticalSection(&surface->lock);
-		region16_union_rect(&(surface->invalidRegion), &(surface->invalidRegion), &invalidRect);
-		region16_intersect_rect(&(surface->invalidRegion), &(surface->invalidRegion), &surfaceRect);
+		region16_intersect_rect(&invalidRegion, &invalidRegion, &surfaceRect);
+		rects = region16_rects(&invalidRegion, &numRects);
+
+		for (index = 0; index < numRects; index++)
+			region16_union_rect(&(surface->invalidRegion), &(surface->invalidRegion),
+			                    &rects[index]);
+
 		empty = region16_is_empty(&(surface->invalidRegion));
 		LeaveCriticalSection(&surface->lock);
 
 		if (!empty)
 		{
-			BOOL success;
+			BOOL success = TRUE;
 			EnterCriticalSection(&surface->lock);
-			extents = region16_extents(&(surface->invalidRegion));
-			x = extents->left;
-			y = extents->top;
-			width = extents->right - extents->left;
-			height = extents->bottom - extents->top;
-			success = freerdp_image_copy(surface->data, surface->format, surface->scanline, x, y,
-			                             width, height, (BYTE*)image->data, PIXEL_FORMAT_BGRX32,
-			                             image->bytes_per_line, x, y, NULL, FREERDP_FLIP_NONE);
+
+			/* only the changed tiles are copied, not their bounding box */
+			for (index = 0; success && (index < numRects); index++)
+			{
+				x = rects[index].left;
+				y = rects[index].top;
+				width = rects[index].right - rects[index].left;
+				height = rects[index].bottom - rects[index].top;
+				success = freerdp_image_copy(surface->data, surface->format, surface->scanline, x,
+				                             y, width, height, (BYTE*)image->data,
+				                             PIXEL_FORMAT_BGRX32, image->bytes_per_line, x, y, NULL,
+				                             FREERDP_FLIP_NONE);
+			}
+
 			LeaveCriticalSection(&surface->lock);
 			if (!success)
 				goto fail_capture;
@@ -865,6 +882,7 @@ fail_capture:
 		XUnlockDisplay(subsystem->display);
 	}
 
+	region16_uninit(&invalidRegion);
 	return rc;
 }
 
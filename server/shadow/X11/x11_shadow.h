@@ -89,9 +89,9 @@ struct x11_shadow_subsystem
 	UINT32 cursorMaxWidth;
 	UINT32 cursorMaxHeight;
 	rdpShadowClient* lastMouseClient;
+	GC xshm_gc;
 
 #ifdef WITH_XDAMAGE
-	GC xshm_gc;
 	Damage xdamage;
 	int xdamage_notify_event;
 	XserverRegion xdamage_region;
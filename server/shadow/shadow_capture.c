@@ -31,6 +31,17 @@
 
 #define TAG SERVER_TAG("shadow")
 
+/* tile hash grid of the last frame captured for surface */
+struct shadow_capture_tiles
+{
+	const rdpShadowSurface* surface;
+	UINT32 width;
+	UINT32 height;
+	UINT32 columns;
+	UINT32 rows;
+	UINT64* hashes;
+};
+
 int shadow_capture_align_clip_rect(RECTANGLE_16* rect, RECTANGLE_16* clip)
 {
 	int dx, dy;
@@ -218,6 +229,252 @@ int shadow_capture_compare(BYTE* pData1, UINT32 nStep1, UINT32 nWidth, UINT32 nH
 	return 1;
 }
 
+/**
+ * Tile hashing
+ *
+ * The surface keeps a 64-bit hash for each SHADOW_CAPTURE_TILE_SIZE square tile of the last
+ * captured frame, so a new frame only has to be read once to find the tiles that changed
+ * instead of being compared against a second frame buffer.
+ *
+ * The hash has the structure of XXH3: 64 byte stripes are accumulated into eight 64-bit lanes
+ * with a 32x32->64 multiply (this loop is vectorized by the compiler), the key depends on the
+ * position of the stripe in the row and the lanes are scrambled after every row.
+ */
+
+#define SHADOW_CAPTURE_TILE_SIZE 64
+#define SHADOW_HASH_STRIPE_SIZE 64
+
+#define SHADOW_HASH_PRIME32_1 0x9E3779B1U
+#define SHADOW_HASH_PRIME64_1 0x9E3779B185EBCA87ULL
+#define SHADOW_HASH_PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define SHADOW_HASH_PRIME64_3 0x165667B19E3779F9ULL
+
+static const BYTE shadow_hash_secret[] = {
+	0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+	0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+	0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+	0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+	0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+	0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+	0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+	0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64
+};
+
+static INLINE UINT64 shadow_hash_read64(const BYTE* data)
+{
+	UINT64 value;
+	CopyMemory(&value, data, sizeof(value));
+	return value;
+}
+
+static INLINE void shadow_hash_accumulate(UINT64* acc, const BYTE* data, const BYTE* secret)
+{
+	size_t i;
+
+	for (i = 0; i < 8; i++)
+	{
+		const UINT64 value = shadow_hash_read64(&data[i * 8]);
+		const UINT64 key = value ^ shadow_hash_read64(&secret[i * 8]);
+		acc[i ^ 1] += value;
+		acc[i] += (key & 0xFFFFFFFF) * (key >> 32);
+	}
+}
+
+static INLINE void shadow_hash_scramble(UINT64* acc, const BYTE* secret)
+{
+	size_t i;
+
+	for (i = 0; i < 8; i++)
+	{
+		UINT64 value = acc[i];
+		value ^= value >> 47;
+		value ^= shadow_hash_read64(&secret[i * 8]);
+		acc[i] = value * SHADOW_HASH_PRIME32_1;
+	}
+}
+
+static INLINE void shadow_hash_init(UINT64* acc)
+{
+	acc[0] = SHADOW_HASH_PRIME32_1;
+	acc[1] = SHADOW_HASH_PRIME64_1;
+	acc[2] = SHADOW_HASH_PRIME64_2;
+	acc[3] = SHADOW_HASH_PRIME64_3;
+	acc[4] = SHADOW_HASH_PRIME64_2;
+	acc[5] = SHADOW_HASH_PRIME32_1;
+	acc[6] = SHADOW_HASH_PRIME64_3;
+	acc[7] = SHADOW_HASH_PRIME64_1;
+}
+
+static INLINE void shadow_hash_update_row(UINT64* acc, const BYTE* row, UINT32 rowSize)
+{
+	UINT32 x;
+	const UINT32 stripes = rowSize / SHADOW_HASH_STRIPE_SIZE;
+	const UINT32 tail = rowSize % SHADOW_HASH_STRIPE_SIZE;
+
+	for (x = 0; x < stripes; x++)
+		shadow_hash_accumulate(acc, &row[x * SHADOW_HASH_STRIPE_SIZE], &shadow_hash_secret[x * 8]);
+
+	/* tiles at the right edge may end within a stripe */
+	if (tail)
+	{
+		BYTE stripe[SHADOW_HASH_STRIPE_SIZE] = { 0 };
+		CopyMemory(stripe, &row[stripes * SHADOW_HASH_STRIPE_SIZE], tail);
+		shadow_hash_accumulate(acc, stripe, &shadow_hash_secret[stripes * 8]);
+	}
+
+	shadow_hash_scramble(acc, &shadow_hash_secret[sizeof(shadow_hash_secret) - 64]);
+}
+
+static INLINE UINT64 shadow_hash_final(const UINT64* acc, UINT32 nWidth, UINT32 nHeight)
+{
+	size_t i;
+	UINT64 hash = (UINT64)nWidth * nHeight * SHADOW_HASH_PRIME64_1;
+
+	for (i = 0; i < 8; i++)
+		hash = (hash ^ acc[i]) * SHADOW_HASH_PRIME64_1;
+
+	hash ^= hash >> 33;
+	hash *= SHADOW_HASH_PRIME64_2;
+	hash ^= hash >> 29;
+	hash *= SHADOW_HASH_PRIME64_3;
+	hash ^= hash >> 32;
+	return hash;
+}
+
+/**
+ * Compares a new frame against the tile hash grid of the surface and adds the tiles that
+ * changed to region. The grid is updated to the new frame. The first call after the surface
+ * was created or resized reports every tile.
+ *
+ * A tile with an unchanged hash is taken as unchanged, so an idle frame is read once and
+ * never compared byte by byte. The caller must hold the surface lock.
+ *
+ * @return the number of changed tiles, -1 on failure
+ */
+int shadow_capture_compare_tiles(rdpShadowSurface* surface, const BYTE* pData, UINT32 nStep,
+                                 REGION16* region)
+{
+	UINT32 x, y;
+	UINT32 tx, ty;
+	UINT32 nrow, ncol;
+	UINT64* acc;
+	RECTANGLE_16* rects;
+	SHADOW_CAPTURE_TILES* tiles;
+	UINT32 nbRects = 0;
+	BOOL reset = FALSE;
+	int count = 0;
+
+	if (!surface || !pData || !region || (surface->width <= 0) || (surface->height <= 0) ||
+	    !surface->server || !surface->server->capture)
+		return -1;
+
+	ncol = ((UINT32)surface->width + SHADOW_CAPTURE_TILE_SIZE - 1) / SHADOW_CAPTURE_TILE_SIZE;
+	nrow = ((UINT32)surface->height + SHADOW_CAPTURE_TILE_SIZE - 1) / SHADOW_CAPTURE_TILE_SIZE;
+
+	if (!(tiles = surface->server->capture->tiles))
+	{
+		if (!(tiles = (SHADOW_CAPTURE_TILES*)calloc(1, sizeof(SHADOW_CAPTURE_TILES))))
+			return -1;
+
+		surface->server->capture->tiles = tiles;
+	}
+
+	if ((tiles->surface != surface) || (tiles->width != (UINT32)surface->width) ||
+	    (tiles->height != (UINT32)surface->height))
+	{
+		UINT64* hashes = (UINT64*)realloc(tiles->hashes, sizeof(UINT64) * ncol * nrow);
+
+		if (!hashes)
+			return -1;
+
+		tiles->surface = surface;
+		tiles->width = (UINT32)surface->width;
+		tiles->height = (UINT32)surface->height;
+		tiles->columns = ncol;
+		tiles->rows = nrow;
+		tiles->hashes = hashes;
+		reset = TRUE;
+	}
+
+	/* one hash state per tile of a tile row */
+	acc = (UINT64*)calloc(ncol, sizeof(UINT64) * 8);
+	/* the changed runs are collected and merged into the region at once */
+	rects = (RECTANGLE_16*)calloc(ncol * nrow, sizeof(RECTANGLE_16));
+
+	if (!acc || !rects)
+		goto fail;
+
+	for (ty = 0; ty < nrow; ty++)
+	{
+		RECTANGLE_16 rect = { 0 };
+		BOOL dirty = FALSE;
+		const UINT32 top = ty * SHADOW_CAPTURE_TILE_SIZE;
+		const UINT32 th = MIN(SHADOW_CAPTURE_TILE_SIZE, (UINT32)surface->height - top);
+
+		for (tx = 0; tx < ncol; tx++)
+			shadow_hash_init(&acc[tx * 8]);
+
+		/* hash the tiles of a tile row scanline by scanline to read the frame sequentially */
+		for (y = top; y < top + th; y++)
+		{
+			const BYTE* row = &pData[y * nStep];
+
+			for (tx = 0; tx < ncol; tx++)
+			{
+				x = tx * SHADOW_CAPTURE_TILE_SIZE;
+				shadow_hash_update_row(
+				    &acc[tx * 8], &row[x * 4],
+				    MIN(SHADOW_CAPTURE_TILE_SIZE, (UINT32)surface->width - x) * 4);
+			}
+		}
+
+		for (tx = 0; tx < ncol; tx++)
+		{
+			const UINT32 left = tx * SHADOW_CAPTURE_TILE_SIZE;
+			const UINT32 tw = MIN(SHADOW_CAPTURE_TILE_SIZE, (UINT32)surface->width - left);
+			const UINT64 hash = shadow_hash_final(&acc[tx * 8], tw, th);
+			UINT64* tileHash = &tiles->hashes[ty * ncol + tx];
+
+			if (!reset && (*tileHash == hash))
+			{
+				if (dirty)
+					rects[nbRects++] = rect;
+
+				dirty = FALSE;
+				continue;
+			}
+
+			*tileHash = hash;
+			count++;
+
+			/* runs of changed tiles in a row are added as a single rectangle */
+			if (!dirty)
+			{
+				rect.left = (UINT16)left;
+				rect.top = (UINT16)top;
+				rect.bottom = (UINT16)(top + th);
+				dirty = TRUE;
+			}
+
+			rect.right = (UINT16)(left + tw);
+		}
+
+		if (dirty)
+			rects[nbRects++] = rect;
+	}
+
+	if (!region16_union_rects(region, region, rects, nbRects))
+		goto fail;
+
+	free(acc);
+	free(rects);
+	return count;
+fail:
+	free(acc);
+	free(rects);
+	return -1;
+}
+
 rdpShadowCapture* shadow_capture_new(rdpShadowServer* server)
 {
 	rdpShadowCapture* capture;
@@ -227,6 +484,7 @@ rdpShadowCapture* shadow_capture_new(rdpShadowServer* server)
 		return NULL;
 
 	capture->server = server;
+	capture->CompareTiles = shadow_capture_compare_tiles;
 
 	if (!InitializeCriticalSectionAndSpinCount(&(capture->lock), 4000))
 	{
@@ -242,6 +500,10 @@ void shadow_capture_free(rdpShadowCapture* capture)
 	if (!capture)
 		return;
 
+	if (capture->tiles)
+		free(capture->tiles->hashes);
+
+	free(capture->tiles);
 	DeleteCriticalSection(&(capture->lock));
 	free(capture);
 }
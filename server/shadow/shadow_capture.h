@@ -24,6 +24,11 @@
 #include <winpr/crt.h>
 #include <winpr/synch.h>
 
+typedef struct shadow_capture_tiles SHADOW_CAPTURE_TILES;
+
+typedef int (*pfnShadowCaptureCompareTiles)(rdpShadowSurface* surface, const BYTE* pData,
+                                            UINT32 nStep, REGION16* region);
+
 struct rdp_shadow_capture
 {
 	rdpShadowServer* server;
@@ -32,6 +37,10 @@ struct rdp_shadow_capture
 	int height;
 
 	CRITICAL_SECTION lock;
+	SHADOW_CAPTURE_TILES* tiles; /* see shadow_capture_compare_tiles */
+
+	/* shadow_capture_compare_tiles, for the subsystems built as a separate library */
+	pfnShadowCaptureCompareTiles CompareTiles;
 };
 
 #ifdef __cplusplus
@@ -42,6 +51,9 @@ extern "C"
 	rdpShadowCapture* shadow_capture_new(rdpShadowServer* server);
 	void shadow_capture_free(rdpShadowCapture* capture);
 
+	FREERDP_LOCAL int shadow_capture_compare_tiles(rdpShadowSurface* surface, const BYTE* pData,
+	                                               UINT32 nStep, REGION16* region);
+
 #ifdef __cplusplus
 }
 #endif
@@ -148,6 +148,7 @@ static BOOL shadow_client_context_new(freerdp_peer* peer, rdpShadowClient* clien
 	settings->DrawAllowColorSubsampling = TRUE;
 	settings->DrawAllowDynamicColorFidelity = TRUE;
 	settings->CompressionLevel = PACKET_COMPR_TYPE_RDP6;
+	settings->AsyncTransport = server->asyncTransport;
 
 	if (!(settings->CertificateFile = _strdup(server->CertificateFile)))
 		goto fail_cert_file;
@@ -234,7 +235,6 @@ static void shadow_client_context_free(freerdp_peer* peer, rdpShadowClient* clie
 static INLINE void shadow_client_mark_invalid(rdpShadowClient* client, int numRects,
                                               const RECTANGLE_16* rects)
 {
-	int index;
 	RECTANGLE_16 screenRegion;
 	rdpSettings* settings = ((rdpContext*)client)->settings;
 	EnterCriticalSection(&(client->lock));
@@ -242,10 +242,8 @@ static INLINE void shadow_client_mark_invalid(rdpShadowClient* client, int numRe
 	/* Mark client invalid region. No rectangle means full screen */
 	if (numRects > 0)
 	{
-		for (index = 0; index < numRects; index++)
-		{
-			region16_union_rect(&(client->invalidRegion), &(client->invalidRegion), &rects[index]);
-		}
+		region16_union_rects(&(client->invalidRegion), &(client->invalidRegion), rects,
+		                     (UINT32)numRects);
 	}
 	else
 	{
@@ -924,10 +922,157 @@ static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, const BYTE*
 			return FALSE;
 		}
 	}
+	else if (client->server->gfxClearCodec)
+	{
+		BYTE* pDstData = NULL;
+		UINT32 DstSize = 0;
+		const BYTE* pSrc = &pSrcData[(nYSrc * nSrcStep) + (nXSrc * 4)];
+
+		if (shadow_encoder_prepare(encoder, FREERDP_CODEC_CLEARCODEC) < 0)
+		{
+			WLog_ERR(TAG, "Failed to prepare encoder FREERDP_CODEC_CLEARCODEC");
+			return FALSE;
+		}
+
+		if (clear_compress(encoder->clear, pSrc, cmd.format, nSrcStep, nWidth, nHeight, &pDstData,
+		                   &DstSize) < 0)
+		{
+			WLog_ERR(TAG, "clear_compress failed");
+			return FALSE;
+		}
+
+		cmd.codecId = RDPGFX_CODECID_CLEARCODEC;
+		cmd.data = pDstData;
+		cmd.length = DstSize;
+		IFCALLRET(client->rdpgfx->SurfaceFrameCommand, error, client->rdpgfx, &cmd, &cmdstart,
+		          &cmdend);
+
+		if (error)
+		{
+			WLog_ERR(TAG, "SurfaceFrameCommand failed with error %" PRIu32 "", error);
+			return FALSE;
+		}
+	}
 
 	return TRUE;
 }
 
+/**
+ * Function description
+ *
+ * @return the frame cache shared with other clients, NULL if the client encodes on its own
+ */
+static INLINE rdpShadowFrameCache* shadow_client_frame_cache(rdpShadowClient* client)
+{
+	/* Only the primary surface is published through the subsystem update event */
+	if (client->inLobby)
+		return NULL;
+
+	return client->server->frameCache;
+}
+
+static void shadow_client_init_frame_key(rdpShadowClient* client, SHADOW_FRAME_KEY* key,
+                                         UINT32 codecId, int nXSrc, int nYSrc, int nWidth,
+                                         int nHeight)
+{
+	rdpSettings* settings = client->context.settings;
+	ZeroMemory(key, sizeof(SHADOW_FRAME_KEY));
+	key->codecId = codecId;
+	key->width = settings->DesktopWidth;
+	key->height = settings->DesktopHeight;
+	key->rect.left = (UINT16)nXSrc;
+	key->rect.top = (UINT16)nYSrc;
+	key->rect.right = (UINT16)(nXSrc + nWidth);
+	key->rect.bottom = (UINT16)(nYSrc + nHeight);
+}
+
+static SHADOW_ENCODED_FRAME* shadow_client_encode_rfx(rdpShadowClient* client,
+                                                      const SHADOW_FRAME_KEY* key, BYTE* pSrcData,
+                                                      int nSrcStep)
+{
+	size_t i;
+	size_t numMessages;
+	RFX_RECT rect;
+	RFX_MESSAGE* messages;
+	RFX_RECT* messageRects = NULL;
+	SHADOW_ENCODED_FRAME* frame;
+	rdpShadowEncoder* encoder = client->encoder;
+	wStream* s = encoder->bs;
+	rect.x = key->rect.left;
+	rect.y = key->rect.top;
+	rect.width = key->rect.right - key->rect.left;
+	rect.height = key->rect.bottom - key->rect.top;
+
+	if (!(messages = rfx_encode_messages_ex(encoder->rfx, &rect, 1, pSrcData, key->width,
+	                                        key->height, nSrcStep, &numMessages,
+	                                        key->maxRequestSize)))
+	{
+		WLog_ERR(TAG, "rfx_encode_messages_ex failed");
+		return NULL;
+	}
+
+	if (numMessages > 0)
+		messageRects = messages[0].rects;
+
+	frame = shadow_encoded_frame_new(key, numMessages);
+
+	for (i = 0; i < numMessages; i++)
+	{
+		Stream_SetPosition(s, 0);
+
+		if (frame && !rfx_write_message(encoder->rfx, s, &messages[i]))
+		{
+			WLog_ERR(TAG, "rfx_write_message failed");
+			shadow_encoded_frame_release(frame);
+			frame = NULL;
+		}
+
+		if (frame &&
+		    !shadow_encoded_frame_set_part(frame, i, Stream_Buffer(s), Stream_GetPosition(s)))
+		{
+			shadow_encoded_frame_release(frame);
+			frame = NULL;
+		}
+
+		rfx_message_free(encoder->rfx, &messages[i]);
+	}
+
+	free(messageRects);
+	free(messages);
+	return frame;
+}
+
+static SHADOW_ENCODED_FRAME* shadow_client_encode_nsc(rdpShadowClient* client,
+                                                      const SHADOW_FRAME_KEY* key, BYTE* pSrcData,
+                                                      int nSrcStep)
+{
+	rdpShadowEncoder* encoder = client->encoder;
+	wStream* s = encoder->bs;
+	SHADOW_ENCODED_FRAME* frame = shadow_encoded_frame_new(key, 1);
+
+	if (!frame)
+		return NULL;
+
+	Stream_SetPosition(s, 0);
+	pSrcData = &pSrcData[(key->rect.top * nSrcStep) + (key->rect.left * 4)];
+
+	if (!nsc_compose_message(encoder->nsc, s, pSrcData, key->rect.right - key->rect.left,
+	                         key->rect.bottom - key->rect.top, nSrcStep))
+	{
+		WLog_ERR(TAG, "nsc_compose_message failed");
+		shadow_encoded_frame_release(frame);
+		return NULL;
+	}
+
+	if (!shadow_encoded_frame_set_part(frame, 0, Stream_Buffer(s), Stream_GetPosition(s)))
+	{
+		shadow_encoded_frame_release(frame);
+		return NULL;
+	}
+
+	return frame;
+}
+
 /**
  * Function description
  *
@@ -940,13 +1085,14 @@ static BOOL shadow_client_send_surface_bits(rdpShadowClient* client, BYTE* pSrcD
 	size_t i;
 	BOOL first;
 	BOOL last;
-	wStream* s;
-	size_t numMessages;
 	UINT32 frameId = 0;
 	rdpUpdate* update;
 	rdpContext* context = (rdpContext*)client;
 	rdpSettings* settings;
 	rdpShadowEncoder* encoder;
+	rdpShadowFrameCache* cache = NULL;
+	SHADOW_FRAME_KEY key;
+	SHADOW_ENCODED_FRAME* frame;
 	SURFACE_BITS_COMMAND cmd = { 0 };
 
 	if (!context || !pSrcData)
@@ -964,29 +1110,20 @@ static BOOL shadow_client_send_surface_bits(rdpShadowClient* client, BYTE* pSrcD
 
 	if (settings->RemoteFxCodec)
 	{
-		RFX_RECT rect;
-		RFX_MESSAGE* messages;
-		RFX_RECT* messageRects = NULL;
-
 		if (shadow_encoder_prepare(encoder, FREERDP_CODEC_REMOTEFX) < 0)
 		{
 			WLog_ERR(TAG, "Failed to prepare encoder FREERDP_CODEC_REMOTEFX");
 			return FALSE;
 		}
 
-		s = encoder->bs;
-		rect.x = nXSrc;
-		rect.y = nYSrc;
-		rect.width = nWidth;
-		rect.height = nHeight;
+		shadow_client_init_frame_key(client, &key, FREERDP_CODEC_REMOTEFX, nXSrc, nYSrc, nWidth,
+		                             nHeight);
+		key.maxRequestSize = settings->MultifragMaxRequestSize;
+		key.params[0] = encoder->rfx->mode;
 
-		if (!(messages = rfx_encode_messages_ex(
-		          encoder->rfx, &rect, 1, pSrcData, settings->DesktopWidth, settings->DesktopHeight,
-		          nSrcStep, &numMessages, settings->MultifragMaxRequestSize)))
-		{
-			WLog_ERR(TAG, "rfx_encode_messages_ex failed");
-			return FALSE;
-		}
+		/* The first message to a client carries the codec headers and can't be shared */
+		if (encoder->rfx->state == RFX_STATE_SEND_FRAME_DATA)
+			cache = shadow_client_frame_cache(client);
 
 		cmd.cmdType = CMDTYPE_STREAM_SURFACE_BITS;
 		cmd.bmp.codecID = settings->RemoteFxCodecId;
@@ -999,47 +1136,6 @@ static BOOL shadow_client_send_surface_bits(rdpShadowClient* client, BYTE* pSrcD
 		cmd.bmp.width = settings->DesktopWidth;
 		cmd.bmp.height = settings->DesktopHeight;
 		cmd.skipCompression = TRUE;
-
-		if (numMessages > 0)
-			messageRects = messages[0].rects;
-
-		for (i = 0; i < numMessages; i++)
-		{
-			Stream_SetPosition(s, 0);
-
-			if (!rfx_write_message(encoder->rfx, s, &messages[i]))
-			{
-				while (i < numMessages)
-				{
-					rfx_message_free(encoder->rfx, &messages[i++]);
-				}
-
-				WLog_ERR(TAG, "rfx_write_message failed");
-				ret = FALSE;
-				break;
-			}
-
-			rfx_message_free(encoder->rfx, &messages[i]);
-			cmd.bmp.bitmapDataLength = Stream_GetPosition(s);
-			cmd.bmp.bitmapData = Stream_Buffer(s);
-			first = (i == 0) ? TRUE : FALSE;
-			last = ((i + 1) == numMessages) ? TRUE : FALSE;
-
-			if (!encoder->frameAck)
-				IFCALLRET(update->SurfaceBits, ret, update->context, &cmd);
-			else
-				IFCALLRET(update->SurfaceFrameBits, ret, update->context, &cmd, first, last,
-				          frameId);
-
-			if (!ret)
-			{
-				WLog_ERR(TAG, "Send surface bits(RemoteFxCodec) failed");
-				break;
-			}
-		}
-
-		free(messageRects);
-		free(messages);
 	}
 	else if (settings->NSCodec)
 	{
@@ -1049,10 +1145,12 @@ static BOOL shadow_client_send_surface_bits(rdpShadowClient* client, BYTE* pSrcD
 			return FALSE;
 		}
 
-		s = encoder->bs;
-		Stream_SetPosition(s, 0);
-		pSrcData = &pSrcData[(nYSrc * nSrcStep) + (nXSrc * 4)];
-		nsc_compose_message(encoder->nsc, s, pSrcData, nWidth, nHeight, nSrcStep);
+		shadow_client_init_frame_key(client, &key, FREERDP_CODEC_NSCODEC, nXSrc, nYSrc, nWidth,
+		                             nHeight);
+		key.params[0] = settings->NSCodecColorLossLevel;
+		key.params[1] = settings->NSCodecAllowSubsampling;
+		key.params[2] = settings->NSCodecAllowDynamicColorFidelity;
+		cache = shadow_client_frame_cache(client);
 		cmd.cmdType = CMDTYPE_SET_SURFACE_BITS;
 		cmd.bmp.bpp = 32;
 		cmd.bmp.codecID = settings->NSCodecId;
@@ -1062,10 +1160,32 @@ static BOOL shadow_client_send_surface_bits(rdpShadowClient* client, BYTE* pSrcD
 		cmd.destBottom = cmd.destTop + nHeight;
 		cmd.bmp.width = nWidth;
 		cmd.bmp.height = nHeight;
-		cmd.bmp.bitmapDataLength = Stream_GetPosition(s);
-		cmd.bmp.bitmapData = Stream_Buffer(s);
-		first = TRUE;
-		last = TRUE;
+	}
+	else
+		return TRUE;
+
+	frame = shadow_frame_cache_lookup(cache, &key);
+
+	if (!frame)
+	{
+		if (settings->RemoteFxCodec)
+			frame = shadow_client_encode_rfx(client, &key, pSrcData, nSrcStep);
+		else
+			frame = shadow_client_encode_nsc(client, &key, pSrcData, nSrcStep);
+
+		if (!frame)
+			return FALSE;
+
+		if (cache)
+			shadow_frame_cache_insert(cache, frame);
+	}
+
+	for (i = 0; i < frame->numParts; i++)
+	{
+		cmd.bmp.bitmapDataLength = frame->parts[i].length;
+		cmd.bmp.bitmapData = frame->parts[i].data;
+		first = (i == 0) ? TRUE : FALSE;
+		last = ((i + 1) == frame->numParts) ? TRUE : FALSE;
 
 		if (!encoder->frameAck)
 			IFCALLRET(update->SurfaceBits, ret, update->context, &cmd);
@@ -1074,23 +1194,20 @@ static BOOL shadow_client_send_surface_bits(rdpShadowClient* client, BYTE* pSrcD
 
 		if (!ret)
 		{
-			WLog_ERR(TAG, "Send surface bits(NSCodec) failed");
+			WLog_ERR(TAG, "Send surface bits(%s) failed",
+			         settings->RemoteFxCodec ? "RemoteFxCodec" : "NSCodec");
+			break;
 		}
 	}
 
+	shadow_encoded_frame_release(frame);
 	return ret;
 }
 
-/**
- * Function description
- *
- * @return TRUE on success
- */
-static BOOL shadow_client_send_bitmap_update(rdpShadowClient* client, BYTE* pSrcData, int nSrcStep,
-                                             int nXSrc, int nYSrc, int nWidth, int nHeight)
+static SHADOW_ENCODED_FRAME* shadow_client_encode_bitmap(rdpShadowClient* client,
+                                                         const SHADOW_FRAME_KEY* key,
+                                                         BYTE* pSrcData, int nSrcStep)
 {
-	BOOL ret = TRUE;
-	BYTE* data;
 	BYTE* buffer;
 	size_t k;
 	int yIdx, xIdx;
@@ -1098,45 +1215,13 @@ static BOOL shadow_client_send_bitmap_update(rdpShadowClient* client, BYTE* pSrc
 	UINT32 DstSize;
 	UINT32 SrcFormat;
 	BITMAP_DATA* bitmap;
-	rdpUpdate* update;
-	rdpContext* context = (rdpContext*)client;
-	rdpSettings* settings;
-	UINT32 maxUpdateSize;
-	UINT32 totalBitmapSize;
-	UINT32 updateSizeEstimate;
-	BITMAP_DATA* bitmapData;
-	BITMAP_UPDATE bitmapUpdate;
-	rdpShadowEncoder* encoder;
-
-	if (!context || !pSrcData)
-		return FALSE;
-
-	update = context->update;
-	settings = context->settings;
-	encoder = client->encoder;
-
-	if (!update || !settings || !encoder)
-		return FALSE;
-
-	maxUpdateSize = settings->MultifragMaxRequestSize;
-
-	if (settings->ColorDepth < 32)
-	{
-		if (shadow_encoder_prepare(encoder, FREERDP_CODEC_INTERLEAVED) < 0)
-		{
-			WLog_ERR(TAG, "Failed to prepare encoder FREERDP_CODEC_INTERLEAVED");
-			return FALSE;
-		}
-	}
-	else
-	{
-		if (shadow_encoder_prepare(encoder, FREERDP_CODEC_PLANAR) < 0)
-		{
-			WLog_ERR(TAG, "Failed to prepare encoder FREERDP_CODEC_PLANAR");
-			return FALSE;
-		}
-	}
-
+	SHADOW_ENCODED_FRAME* frame;
+	PLANAR_TILE* tiles = NULL;
+	rdpShadowEncoder* encoder = client->encoder;
+	int nXSrc = key->rect.left;
+	int nYSrc = key->rect.top;
+	int nWidth = key->rect.right - key->rect.left;
+	int nHeight = key->rect.bottom - key->rect.top;
 	SrcFormat = PIXEL_FORMAT_BGRX32;
 
 	if ((nXSrc % 4) != 0)
@@ -1154,13 +1239,14 @@ static BOOL shadow_client_send_bitmap_update(rdpShadowClient* client, BYTE* pSrc
 	rows = (nHeight / 64) + ((nHeight % 64) ? 1 : 0);
 	cols = (nWidth / 64) + ((nWidth % 64) ? 1 : 0);
 	k = 0;
-	totalBitmapSize = 0;
-	bitmapUpdate.count = bitmapUpdate.number = rows * cols;
 
-	if (!(bitmapData = (BITMAP_DATA*)calloc(bitmapUpdate.number, sizeof(BITMAP_DATA))))
-		return FALSE;
+	if (!(frame = shadow_encoded_frame_new(key, rows * cols)))
+		return NULL;
 
-	bitmapUpdate.rectangles = bitmapData;
+	/* Planar tiles are compressed together below, spread over the codec workers */
+	if ((key->codecId == FREERDP_CODEC_PLANAR) &&
+	    !(tiles = (PLANAR_TILE*)calloc(rows * cols, sizeof(PLANAR_TILE))))
+		goto fail;
 
 	if ((nWidth % 4) != 0)
 	{
@@ -1176,7 +1262,7 @@ static BOOL shadow_client_send_bitmap_update(rdpShadowClient* client, BYTE* pSrc
 	{
 		for (xIdx = 0; xIdx < cols; xIdx++)
 		{
-			bitmap = &bitmapData[k];
+			bitmap = &frame->parts[k].bitmap;
 			bitmap->width = 64;
 			bitmap->height = 64;
 			bitmap->destLeft = nXSrc + (xIdx * 64);
@@ -1195,43 +1281,161 @@ static BOOL shadow_client_send_bitmap_update(rdpShadowClient* client, BYTE* pSrc
 			if ((bitmap->width < 4) || (bitmap->height < 4))
 				continue;
 
-			if (settings->ColorDepth < 32)
+			if (key->codecId == FREERDP_CODEC_INTERLEAVED)
 			{
-				int bitsPerPixel = settings->ColorDepth;
+				int bitsPerPixel = (int)key->params[0];
 				int bytesPerPixel = (bitsPerPixel + 7) / 8;
 				DstSize = 64 * 64 * 4;
 				buffer = encoder->grid[k];
 				interleaved_compress(encoder->interleaved, buffer, &DstSize, bitmap->width,
 				                     bitmap->height, pSrcData, SrcFormat, nSrcStep,
 				                     bitmap->destLeft, bitmap->destTop, NULL, bitsPerPixel);
-				bitmap->bitmapDataStream = buffer;
-				bitmap->bitmapLength = DstSize;
 				bitmap->bitsPerPixel = bitsPerPixel;
 				bitmap->cbScanWidth = bitmap->width * bytesPerPixel;
 				bitmap->cbUncompressedSize = bitmap->width * bitmap->height * bytesPerPixel;
+
+				if (!shadow_encoded_frame_set_part(frame, k, buffer, DstSize))
+					goto fail;
+
+				bitmap->cbCompFirstRowSize = 0;
+				bitmap->cbCompMainBodySize = bitmap->bitmapLength;
 			}
 			else
 			{
-				UINT32 dstSize;
-				buffer = encoder->grid[k];
-				data = &pSrcData[(bitmap->destTop * nSrcStep) + (bitmap->destLeft * 4)];
-				buffer =
-				    freerdp_bitmap_compress_planar(encoder->planar, data, SrcFormat, bitmap->width,
-				                                   bitmap->height, nSrcStep, buffer, &dstSize);
-				bitmap->bitmapDataStream = buffer;
-				bitmap->bitmapLength = dstSize;
+				tiles[k].nXSrc = bitmap->destLeft;
+				tiles[k].nYSrc = bitmap->destTop;
+				tiles[k].nWidth = bitmap->width;
+				tiles[k].nHeight = bitmap->height;
+				tiles[k].pDstData = encoder->grid[k];
+				tiles[k].DstSize = 64 * 64 * 4;
 				bitmap->bitsPerPixel = 32;
 				bitmap->cbScanWidth = bitmap->width * 4;
 				bitmap->cbUncompressedSize = bitmap->width * bitmap->height * 4;
 			}
 
+			k++;
+		}
+	}
+
+	frame->numParts = k;
+
+	if (tiles)
+	{
+		if (!freerdp_bitmap_planar_compress_tiles(encoder->planar, pSrcData, SrcFormat,
+		                                          (UINT32)nSrcStep, tiles, (UINT32)k))
+			goto fail;
+
+		for (k = 0; k < frame->numParts; k++)
+		{
+			bitmap = &frame->parts[k].bitmap;
+
+			if (!shadow_encoded_frame_set_part(frame, k, tiles[k].pDstData, tiles[k].DstSize))
+				goto fail;
+
 			bitmap->cbCompFirstRowSize = 0;
 			bitmap->cbCompMainBodySize = bitmap->bitmapLength;
-			totalBitmapSize += bitmap->bitmapLength;
-			k++;
 		}
+
+		free(tiles);
 	}
 
+	return frame;
+fail:
+	free(tiles);
+	shadow_encoded_frame_release(frame);
+	return NULL;
+}
+
+/**
+ * Function description
+ *
+ * @return TRUE on success
+ */
+static BOOL shadow_client_send_bitmap_update(rdpShadowClient* client, BYTE* pSrcData, int nSrcStep,
+                                             int nXSrc, int nYSrc, int nWidth, int nHeight)
+{
+	BOOL ret = TRUE;
+	size_t k;
+	rdpUpdate* update;
+	rdpContext* context = (rdpContext*)client;
+	rdpSettings* settings;
+	UINT32 maxUpdateSize;
+	UINT32 totalBitmapSize;
+	UINT32 updateSizeEstimate;
+	BITMAP_DATA* bitmapData;
+	BITMAP_UPDATE bitmapUpdate;
+	rdpShadowEncoder* encoder;
+	rdpShadowFrameCache* cache;
+	SHADOW_FRAME_KEY key;
+	SHADOW_ENCODED_FRAME* frame;
+
+	if (!context || !pSrcData)
+		return FALSE;
+
+	update = context->update;
+	settings = context->settings;
+	encoder = client->encoder;
+
+	if (!update || !settings || !encoder)
+		return FALSE;
+
+	maxUpdateSize = settings->MultifragMaxRequestSize;
+
+	if (settings->ColorDepth < 32)
+	{
+		if (shadow_encoder_prepare(encoder, FREERDP_CODEC_INTERLEAVED) < 0)
+		{
+			WLog_ERR(TAG, "Failed to prepare encoder FREERDP_CODEC_INTERLEAVED");
+			return FALSE;
+		}
+
+		shadow_client_init_frame_key(client, &key, FREERDP_CODEC_INTERLEAVED, nXSrc, nYSrc,
+		                             nWidth, nHeight);
+		key.params[0] = settings->ColorDepth;
+	}
+	else
+	{
+		if (shadow_encoder_prepare(encoder, FREERDP_CODEC_PLANAR) < 0)
+		{
+			WLog_ERR(TAG, "Failed to prepare encoder FREERDP_CODEC_PLANAR");
+			return FALSE;
+		}
+
+		shadow_client_init_frame_key(client, &key, FREERDP_CODEC_PLANAR, nXSrc, nYSrc, nWidth,
+		                             nHeight);
+		key.params[0] = settings->DrawAllowSkipAlpha;
+	}
+
+	cache = shadow_client_frame_cache(client);
+	frame = shadow_frame_cache_lookup(cache, &key);
+
+	if (!frame)
+	{
+		if (!(frame = shadow_client_encode_bitmap(client, &key, pSrcData, nSrcStep)))
+			return FALSE;
+
+		if (cache)
+			shadow_frame_cache_insert(cache, frame);
+	}
+
+	if (frame->numParts == 0)
+		goto out_frame;
+
+	if (!(bitmapData = (BITMAP_DATA*)calloc(frame->numParts, sizeof(BITMAP_DATA))))
+	{
+		ret = FALSE;
+		goto out_frame;
+	}
+
+	totalBitmapSize = 0;
+
+	for (k = 0; k < frame->numParts; k++)
+	{
+		bitmapData[k] = frame->parts[k].bitmap;
+		totalBitmapSize += bitmapData[k].bitmapLength;
+	}
+
+	bitmapUpdate.rectangles = bitmapData;
 	bitmapUpdate.count = bitmapUpdate.number = k;
 	updateSizeEstimate = totalBitmapSize + (k * bitmapUpdate.count) + 16;
 
@@ -1296,6 +1500,8 @@ static BOOL shadow_client_send_bitmap_update(rdpShadowClient* client, BYTE* pSrc
 
 out:
 	free(bitmapData);
+out_frame:
+	shadow_encoded_frame_release(frame);
 	return ret;
 }
 
@@ -1318,7 +1524,6 @@ static BOOL shadow_client_send_surface_update(rdpShadowClient* client, SHADOW_GF
 	const RECTANGLE_16* extents;
 	BYTE* pSrcData;
 	int nSrcStep;
-	UINT32 index;
 	UINT32 numRects = 0;
 	const RECTANGLE_16* rects;
 
@@ -1344,9 +1549,7 @@ static BOOL shadow_client_send_surface_update(rdpShadowClient* client, SHADOW_GF
 
 	EnterCriticalSection(&surface->lock);
 	rects = region16_rects(&(surface->invalidRegion), &numRects);
-
-	for (index = 0; index < numRects; index++)
-		region16_union_rect(&invalidRegion, &invalidRegion, &rects[index]);
+	region16_union_rects(&invalidRegion, &invalidRegion, rects, numRects);
 
 	surfaceRect.left = 0;
 	surfaceRect.top = 0;
@@ -1387,26 +1590,37 @@ static BOOL shadow_client_send_surface_update(rdpShadowClient* client, SHADOW_GF
 	// WLog_INFO(TAG, "shadow_client_send_surface_update: x: %d y: %d width: %d height: %d right: %d
 	// bottom: %d", 	nXSrc, nYSrc, nWidth, nHeight, nXSrc + nWidth, nYSrc + nHeight);
 
-	if (settings->SupportGraphicsPipeline && settings->GfxH264 && pStatus->gfxOpened)
+	if (settings->SupportGraphicsPipeline && pStatus->gfxOpened &&
+	    (settings->GfxH264 || server->gfxClearCodec))
 	{
 		/* GFX/h264 always full screen encoded */
-		nWidth = settings->DesktopWidth;
-		nHeight = settings->DesktopHeight;
+		if (settings->GfxH264)
+		{
+			nXSrc = 0;
+			nYSrc = 0;
+			nWidth = settings->DesktopWidth;
+			nHeight = settings->DesktopHeight;
+		}
 
 		/* Create primary surface if have not */
 		if (!pStatus->gfxSurfaceCreated)
 		{
-			/* Only init surface when we have h264 supported */
+			/* Only init surface when we have h264 or ClearCodec supported */
 			if (!(ret = shadow_client_rdpgfx_reset_graphic(client)))
 				goto out;
 
 			if (!(ret = shadow_client_rdpgfx_new_surface(client)))
 				goto out;
 
+			/* The client resets its codecs on ResetGraphics, so must we */
+			if (client->encoder->clear)
+				clear_context_reset(client->encoder->clear);
+
 			pStatus->gfxSurfaceCreated = TRUE;
 		}
 
-		ret = shadow_client_send_surface_gfx(client, pSrcData, nSrcStep, 0, 0, nWidth, nHeight);
+		ret = shadow_client_send_surface_gfx(client, pSrcData, nSrcStep, nXSrc, nYSrc, nWidth,
+		                                     nHeight);
 	}
 	else if (settings->RemoteFxCodec || settings->NSCodec)
 	{
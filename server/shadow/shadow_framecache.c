@@ -0,0 +1,228 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <winpr/interlocked.h>
+
+#include <freerdp/log.h>
+
+#include "shadow.h"
+
+#define TAG SERVER_TAG("shadow.framecache")
+
+struct rdp_shadow_frame_cache
+{
+	CRITICAL_SECTION lock;
+	size_t count;
+	size_t next;
+	SHADOW_ENCODED_FRAME* entries[SHADOW_FRAME_CACHE_MAX_ENTRIES];
+};
+
+static BOOL shadow_frame_key_equal(const SHADOW_FRAME_KEY* a, const SHADOW_FRAME_KEY* b)
+{
+	size_t x;
+
+	if ((a->codecId != b->codecId) || (a->width != b->width) || (a->height != b->height) ||
+	    (a->maxRequestSize != b->maxRequestSize))
+		return FALSE;
+
+	for (x = 0; x < ARRAYSIZE(a->params); x++)
+	{
+		if (a->params[x] != b->params[x])
+			return FALSE;
+	}
+
+	return (a->rect.left == b->rect.left) && (a->rect.top == b->rect.top) &&
+	       (a->rect.right == b->rect.right) && (a->rect.bottom == b->rect.bottom);
+}
+
+SHADOW_ENCODED_FRAME* shadow_encoded_frame_new(const SHADOW_FRAME_KEY* key, size_t numParts)
+{
+	SHADOW_ENCODED_FRAME* frame;
+
+	if (!key)
+		return NULL;
+
+	frame = (SHADOW_ENCODED_FRAME*)calloc(1, sizeof(SHADOW_ENCODED_FRAME));
+
+	if (!frame)
+		return NULL;
+
+	frame->refCount = 1;
+	frame->key = *key;
+	frame->numParts = numParts;
+
+	if (numParts > 0)
+	{
+		frame->parts = (SHADOW_ENCODED_PART*)calloc(numParts, sizeof(SHADOW_ENCODED_PART));
+
+		if (!frame->parts)
+		{
+			free(frame);
+			return NULL;
+		}
+	}
+
+	return frame;
+}
+
+BOOL shadow_encoded_frame_set_part(SHADOW_ENCODED_FRAME* frame, size_t index, const BYTE* data,
+                                   UINT32 length)
+{
+	SHADOW_ENCODED_PART* part;
+
+	if (!frame || (index >= frame->numParts) || (!data && (length > 0)))
+		return FALSE;
+
+	part = &frame->parts[index];
+	free(part->data);
+	part->data = NULL;
+	part->length = 0;
+
+	if (length > 0)
+	{
+		part->data = (BYTE*)malloc(length);
+
+		if (!part->data)
+			return FALSE;
+
+		CopyMemory(part->data, data, length);
+	}
+
+	part->length = length;
+	part->bitmap.bitmapDataStream = part->data;
+	part->bitmap.bitmapLength = length;
+	return TRUE;
+}
+
+void shadow_encoded_frame_release(SHADOW_ENCODED_FRAME* frame)
+{
+	size_t x;
+
+	if (!frame)
+		return;
+
+	if (InterlockedDecrement(&frame->refCount) > 0)
+		return;
+
+	for (x = 0; x < frame->numParts; x++)
+		free(frame->parts[x].data);
+
+	free(frame->parts);
+	free(frame);
+}
+
+SHADOW_ENCODED_FRAME* shadow_frame_cache_lookup(rdpShadowFrameCache* cache,
+                                                const SHADOW_FRAME_KEY* key)
+{
+	size_t x;
+	SHADOW_ENCODED_FRAME* frame = NULL;
+
+	if (!cache || !key)
+		return NULL;
+
+	EnterCriticalSection(&cache->lock);
+
+	for (x = 0; x < cache->count; x++)
+	{
+		if (shadow_frame_key_equal(&cache->entries[x]->key, key))
+		{
+			frame = cache->entries[x];
+			InterlockedIncrement(&frame->refCount);
+			break;
+		}
+	}
+
+	LeaveCriticalSection(&cache->lock);
+	return frame;
+}
+
+BOOL shadow_frame_cache_insert(rdpShadowFrameCache* cache, SHADOW_ENCODED_FRAME* frame)
+{
+	size_t index;
+
+	if (!cache || !frame)
+		return FALSE;
+
+	EnterCriticalSection(&cache->lock);
+
+	/* Clients asking for the same region in the same frame hit the entry
+	 * before encoding, so a full cache only happens with many distinct
+	 * configurations. Replace the oldest entry in that case. */
+	if (cache->count < SHADOW_FRAME_CACHE_MAX_ENTRIES)
+		index = cache->count++;
+	else
+	{
+		index = cache->next;
+		cache->next = (cache->next + 1) % SHADOW_FRAME_CACHE_MAX_ENTRIES;
+		shadow_encoded_frame_release(cache->entries[index]);
+	}
+
+	InterlockedIncrement(&frame->refCount);
+	cache->entries[index] = frame;
+	LeaveCriticalSection(&cache->lock);
+	return TRUE;
+}
+
+void shadow_frame_cache_clear(rdpShadowFrameCache* cache)
+{
+	size_t x;
+
+	if (!cache)
+		return;
+
+	EnterCriticalSection(&cache->lock);
+
+	for (x = 0; x < cache->count; x++)
+	{
+		shadow_encoded_frame_release(cache->entries[x]);
+		cache->entries[x] = NULL;
+	}
+
+	cache->count = 0;
+	cache->next = 0;
+	LeaveCriticalSection(&cache->lock);
+}
+
+rdpShadowFrameCache* shadow_frame_cache_new(void)
+{
+	rdpShadowFrameCache* cache = (rdpShadowFrameCache*)calloc(1, sizeof(rdpShadowFrameCache));
+
+	if (!cache)
+		return NULL;
+
+	if (!InitializeCriticalSectionAndSpinCount(&cache->lock, 4000))
+	{
+		WLog_ERR(TAG, "InitializeCriticalSectionAndSpinCount failed");
+		free(cache);
+		return NULL;
+	}
+
+	return cache;
+}
+
+void shadow_frame_cache_free(rdpShadowFrameCache* cache)
+{
+	if (!cache)
+		return;
+
+	shadow_frame_cache_clear(cache);
+	DeleteCriticalSection(&cache->lock);
+	free(cache);
+}
@@ -0,0 +1,82 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_SERVER_SHADOW_FRAMECACHE_H
+#define FREERDP_SERVER_SHADOW_FRAMECACHE_H
+
+#include <freerdp/server/shadow.h>
+
+#include <winpr/crt.h>
+#include <winpr/synch.h>
+
+/*
+ * Encoded output of the frame currently being published. Clients that share
+ * a codec configuration look up the encoding of their dirty region here
+ * before encoding it themselves, so a frame is encoded once per distinct
+ * configuration instead of once per client. The cache is emptied whenever the
+ * subsystem publishes a new frame.
+ */
+
+#define SHADOW_FRAME_CACHE_MAX_ENTRIES 8
+
+typedef struct
+{
+	UINT32 codecId; /* FREERDP_CODEC_* */
+	UINT32 width;   /* desktop size */
+	UINT32 height;
+	UINT32 maxRequestSize;
+	UINT32 params[4]; /* codec specific encoder parameters */
+	RECTANGLE_16 rect;
+} SHADOW_FRAME_KEY;
+
+typedef struct
+{
+	BYTE* data;
+	UINT32 length;
+	BITMAP_DATA bitmap; /* tile placement, bitmap updates only */
+} SHADOW_ENCODED_PART;
+
+typedef struct
+{
+	volatile LONG refCount;
+	SHADOW_FRAME_KEY key;
+	size_t numParts;
+	SHADOW_ENCODED_PART* parts;
+} SHADOW_ENCODED_FRAME;
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+	SHADOW_ENCODED_FRAME* shadow_encoded_frame_new(const SHADOW_FRAME_KEY* key, size_t numParts);
+	BOOL shadow_encoded_frame_set_part(SHADOW_ENCODED_FRAME* frame, size_t index,
+	                                   const BYTE* data, UINT32 length);
+	void shadow_encoded_frame_release(SHADOW_ENCODED_FRAME* frame);
+
+	SHADOW_ENCODED_FRAME* shadow_frame_cache_lookup(rdpShadowFrameCache* cache,
+	                                                const SHADOW_FRAME_KEY* key);
+	BOOL shadow_frame_cache_insert(rdpShadowFrameCache* cache, SHADOW_ENCODED_FRAME* frame);
+	void shadow_frame_cache_clear(rdpShadowFrameCache* cache);
+
+	rdpShadowFrameCache* shadow_frame_cache_new(void);
+	void shadow_frame_cache_free(rdpShadowFrameCache* cache);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FREERDP_SERVER_SHADOW_FRAMECACHE_H */
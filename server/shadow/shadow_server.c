@@ -75,6 +75,10 @@ static const COMMAND_LINE_ARGUMENT_A shadow_args[] = {
 	  "nla protocol security" },
 	{ "sec-ext", COMMAND_LINE_VALUE_BOOL, NULL, BoolValueFalse, NULL, -1, NULL,
 	  "nla extended protocol security" },
+	{ "gfx-clearcodec", COMMAND_LINE_VALUE_BOOL, NULL, BoolValueFalse, NULL, -1, NULL,
+	  "Use ClearCodec for graphics pipeline updates when H.264 is not negotiated" },
+	{ "async-transport", COMMAND_LINE_VALUE_BOOL, NULL, BoolValueFalse, NULL, -1, NULL,
+	  "Handle TLS records of each connection on a separate thread" },
 	{ "sam-file", COMMAND_LINE_VALUE_REQUIRED, "<file>", NULL, NULL, -1, NULL,
 	  "NTLM SAM file for NLA authentication" },
 	{ "version", COMMAND_LINE_VALUE_FLAG | COMMAND_LINE_PRINT_VERSION, NULL, NULL, NULL, -1, NULL,
@@ -259,6 +263,14 @@ int shadow_server_parse_command_line(rdpShadowServer* server, int argc, char** a
 		{
 			server->mayInteract = arg->Value ? TRUE : FALSE;
 		}
+		CommandLineSwitchCase(arg, "gfx-clearcodec")
+		{
+			server->gfxClearCodec = arg->Value ? TRUE : FALSE;
+		}
+		CommandLineSwitchCase(arg, "async-transport")
+		{
+			server->asyncTransport = arg->Value ? TRUE : FALSE;
+		}
 		CommandLineSwitchCase(arg, "rect")
 		{
 			char* p;
@@ -564,6 +576,14 @@ int shadow_server_start(rdpShadowServer* server)
 		return -1;
 	}
 
+	server->frameCache = shadow_frame_cache_new();
+
+	if (!server->frameCache)
+	{
+		WLog_ERR(TAG, "frame_cache_new failed");
+		return -1;
+	}
+
 	server->capture = shadow_capture_new(server);
 
 	if (!server->capture)
@@ -651,6 +671,12 @@ int shadow_server_stop(rdpShadowServer* server)
 		server->screen = NULL;
 	}
 
+	if (server->frameCache)
+	{
+		shadow_frame_cache_free(server->frameCache);
+		server->frameCache = NULL;
+	}
+
 	if (server->capture)
 	{
 		shadow_capture_free(server->capture);
@@ -275,5 +275,10 @@ int shadow_subsystem_pointer_convert_alpha_pointer_data(
 
 void shadow_subsystem_frame_update(rdpShadowSubsystem* subsystem)
 {
+	rdpShadowFrameCache* cache = subsystem->server ? subsystem->server->frameCache : NULL;
+
+	/* Encoded data is only valid for the frame it was produced from */
+	shadow_frame_cache_clear(cache);
 	shadow_multiclient_publish_and_wait(subsystem->updateEvent);
+	shadow_frame_cache_clear(cache);
 }
@@ -0,0 +1,1757 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Codec Benchmark
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <errno.h>
+
+#include <winpr/crt.h>
+#include <winpr/cmdline.h>
+#include <winpr/file.h>
+#include <winpr/image.h>
+#include <winpr/stream.h>
+
+#include <freerdp/codec/color.h>
+#include <freerdp/codec/region.h>
+#include <freerdp/codec/rfx.h>
+#include <freerdp/codec/progressive.h>
+#include <freerdp/codec/planar.h>
+#include <freerdp/codec/interleaved.h>
+#include <freerdp/codec/nsc.h>
+#include <freerdp/codec/clear.h>
+#include <freerdp/codec/h264.h>
+#include <freerdp/codec/bulk.h>
+#include <freerdp/codec/mppc.h>
+#include <freerdp/codec/ncrush.h>
+#include <freerdp/codec/xcrush.h>
+#include <freerdp/codec/zgfx.h>
+#include <freerdp/channels/rdpgfx.h>
+#include <freerdp/utils/stopwatch.h>
+
+#define BENCH_FORMAT PIXEL_FORMAT_BGRX32
+#define BENCH_TILE_SIZE 64
+#define BENCH_BULK_BUFFER_SIZE 65536
+#define BENCH_BULK_MAX_CHUNK 16383
+#define BENCH_SYNTHETIC_WIDTH 1920
+#define BENCH_SYNTHETIC_HEIGHT 1080
+
+enum _BENCH_INPUT_TYPE
+{
+	BENCH_INPUT_IMAGE,
+	BENCH_INPUT_STREAM
+};
+typedef enum _BENCH_INPUT_TYPE BENCH_INPUT_TYPE;
+
+enum _BENCH_OUTPUT_FORMAT
+{
+	BENCH_OUTPUT_TEXT,
+	BENCH_OUTPUT_CSV,
+	BENCH_OUTPUT_JSON
+};
+typedef enum _BENCH_OUTPUT_FORMAT BENCH_OUTPUT_FORMAT;
+
+struct _BENCH_INPUT
+{
+	char* name;
+	BENCH_INPUT_TYPE type;
+	UINT32 width; /* images only, BENCH_FORMAT */
+	UINT32 height;
+	UINT32 stride;
+	BYTE* data;
+	size_t size;
+};
+typedef struct _BENCH_INPUT BENCH_INPUT;
+
+struct _BENCH_RESULT
+{
+	UINT64* encodeTimes; /* microseconds per frame */
+	UINT64* decodeTimes;
+	size_t count;
+	size_t capacity;
+	UINT64 rawBytes;
+	UINT64 encodedBytes;
+	UINT32 errors;
+};
+typedef struct _BENCH_RESULT BENCH_RESULT;
+
+/* Codec contexts and scratch buffers of the codec being measured */
+struct _BENCH_STATE
+{
+	STOPWATCH* sw;
+	wStream* s;
+	BYTE* output;
+	BYTE* buffer;
+	UINT32 frameId;
+
+	RFX_CONTEXT* rfxEnc;
+	RFX_CONTEXT* rfxDec;
+	PROGRESSIVE_CONTEXT* progressiveEnc;
+	PROGRESSIVE_CONTEXT* progressiveDec;
+	BITMAP_PLANAR_CONTEXT* planarEnc;
+	BITMAP_PLANAR_CONTEXT* planarDec;
+	BITMAP_INTERLEAVED_CONTEXT* interleavedEnc;
+	BITMAP_INTERLEAVED_CONTEXT* interleavedDec;
+	NSC_CONTEXT* nscEnc;
+	NSC_CONTEXT* nscDec;
+	CLEAR_CONTEXT* clearEnc;
+	CLEAR_CONTEXT* clearDec;
+	H264_CONTEXT* h264Enc;
+	H264_CONTEXT* h264Dec;
+	MPPC_CONTEXT* mppcEnc;
+	MPPC_CONTEXT* mppcDec;
+	NCRUSH_CONTEXT* ncrushEnc;
+	NCRUSH_CONTEXT* ncrushDec;
+	XCRUSH_CONTEXT* xcrushEnc;
+	XCRUSH_CONTEXT* xcrushDec;
+	ZGFX_CONTEXT* zgfxEnc;
+	ZGFX_CONTEXT* zgfxDec;
+};
+typedef struct _BENCH_STATE BENCH_STATE;
+
+typedef BOOL (*pfnBenchCodecNew)(BENCH_STATE* state, const BENCH_INPUT* input);
+typedef BOOL (*pfnBenchCodecFrame)(BENCH_STATE* state, const BENCH_INPUT* input,
+                                   BENCH_RESULT* result);
+
+struct _BENCH_CODEC
+{
+	const char* name;
+	BENCH_INPUT_TYPE input;
+	pfnBenchCodecNew New;
+	pfnBenchCodecFrame Frame;
+};
+typedef struct _BENCH_CODEC BENCH_CODEC;
+
+static UINT64 bench_elapsed(const STOPWATCH* sw)
+{
+	return sw->end - sw->start;
+}
+
+static BOOL bench_record(BENCH_RESULT* result, UINT64 encodeTime, UINT64 decodeTime,
+                         size_t rawBytes, size_t encodedBytes)
+{
+	if (result->count == result->capacity)
+	{
+		size_t capacity = result->capacity ? result->capacity * 2 : 64;
+		UINT64* encodeTimes = realloc(result->encodeTimes, capacity * sizeof(UINT64));
+		UINT64* decodeTimes;
+
+		if (!encodeTimes)
+			return FALSE;
+
+		result->encodeTimes = encodeTimes;
+		decodeTimes = realloc(result->decodeTimes, capacity * sizeof(UINT64));
+
+		if (!decodeTimes)
+			return FALSE;
+
+		result->decodeTimes = decodeTimes;
+		result->capacity = capacity;
+	}
+
+	result->encodeTimes[result->count] = encodeTime;
+	result->decodeTimes[result->count] = decodeTime;
+	result->count++;
+	result->rawBytes += rawBytes;
+	result->encodedBytes += encodedBytes;
+	return TRUE;
+}
+
+static BOOL bench_alloc_output(BENCH_STATE* state, const BENCH_INPUT* input)
+{
+	state->output = _aligned_malloc(1ULL * input->stride * input->height, 16);
+	return state->output != NULL;
+}
+
+/* RemoteFX */
+
+static BOOL bench_rfx_new(BENCH_STATE* state, const BENCH_INPUT* input)
+{
+	state->rfxEnc = rfx_context_new(TRUE);
+	state->rfxDec = rfx_context_new(FALSE);
+	state->s = Stream_New(NULL, 1024);
+
+	if (!state->rfxEnc || !state->rfxDec || !state->s || !bench_alloc_output(state, input))
+		return FALSE;
+
+	if (!rfx_context_reset(state->rfxEnc, input->width, input->height) ||
+	    !rfx_context_reset(state->rfxDec, input->width, input->height))
+		return FALSE;
+
+	rfx_context_set_pixel_format(state->rfxEnc, BENCH_FORMAT);
+	rfx_context_set_pixel_format(state->rfxDec, BENCH_FORMAT);
+	return TRUE;
+}
+
+static BOOL bench_rfx_frame(BENCH_STATE* state, const BENCH_INPUT* input, BENCH_RESULT* result)
+{
+	BOOL rc;
+	UINT64 encodeTime;
+	REGION16 region;
+	RFX_MESSAGE* message;
+	RFX_RECT rect = { 0, 0, (UINT16)input->width, (UINT16)input->height };
+	Stream_SetPosition(state->s, 0);
+	stopwatch_start(state->sw);
+	message = rfx_encode_message(state->rfxEnc, &rect, 1, input->data, input->width,
+	                             input->height, input->stride);
+	rc = message && rfx_write_message(state->rfxEnc, state->s, message);
+	rfx_message_free(state->rfxEnc, message);
+	stopwatch_stop(state->sw);
+
+	if (!rc)
+		return FALSE;
+
+	encodeTime = bench_elapsed(state->sw);
+	region16_init(&region);
+	stopwatch_start(state->sw);
+	rc = rfx_process_message(state->rfxDec, Stream_Buffer(state->s),
+	                         (UINT32)Stream_GetPosition(state->s), 0, 0, state->output,
+	                         BENCH_FORMAT, input->stride, input->height, &region);
+	stopwatch_stop(state->sw);
+	region16_uninit(&region);
+
+	if (!rc)
+		return FALSE;
+
+	return bench_record(result, encodeTime, bench_elapsed(state->sw), input->size,
+	                    Stream_GetPosition(state->s));
+}
+
+/* RemoteFX tile kernels: the DWT, quantization and RLGR stages of every instruction set */
+
+struct _BENCH_RFX_SIMD
+{
+	RFX_SIMD simd;
+	const char* name;
+};
+typedef struct _BENCH_RFX_SIMD BENCH_RFX_SIMD;
+
+static const BENCH_RFX_SIMD BENCH_RFX_SIMDS[] = { { RFX_SIMD_GENERIC, "generic" },
+	                                              { RFX_SIMD_SSE2, "sse2" },
+	                                              { RFX_SIMD_AVX2, "avx2" },
+	                                              { RFX_SIMD_NEON, "neon" } };
+
+/* the encoder's default quantization values */
+static const UINT32 bench_rfx_quant[] = { 6, 6, 6, 6, 7, 7, 8, 8, 8, 9 };
+
+/* The luma of every complete 64x64 tile, in the 11.5 fixed-point format of the encoder */
+static INT16* bench_rfx_tiles(const BENCH_INPUT* input, size_t* pCount)
+{
+	size_t t = 0;
+	UINT32 x, y, tx, ty;
+	const UINT32 tilesX = input->width / BENCH_TILE_SIZE;
+	const UINT32 tilesY = input->height / BENCH_TILE_SIZE;
+	INT16* tiles;
+
+	*pCount = 1ULL * tilesX * tilesY;
+
+	if (*pCount == 0)
+		return NULL;
+
+	tiles = _aligned_malloc(*pCount * 4096 * sizeof(INT16), 32);
+
+	if (!tiles)
+		return NULL;
+
+	for (ty = 0; ty < tilesY; ty++)
+	{
+		for (tx = 0; tx < tilesX; tx++, t++)
+		{
+			for (y = 0; y < BENCH_TILE_SIZE; y++)
+			{
+				const BYTE* line = &input->data[(ty * BENCH_TILE_SIZE + y) * input->stride +
+				                                tx * BENCH_TILE_SIZE * 4];
+
+				for (x = 0; x < BENCH_TILE_SIZE; x++)
+				{
+					const INT32 luma =
+					    (19 * line[x * 4] + 183 * line[x * 4 + 1] + 54 * line[x * 4 + 2]) >> 8;
+					tiles[t * 4096 + y * BENCH_TILE_SIZE + x] = (INT16)((luma - 128) << 5);
+				}
+			}
+		}
+	}
+
+	return tiles;
+}
+
+/* Runs frames passes over all tiles, each stage over all tiles at once */
+static BOOL bench_rfx_simd_run(RFX_CONTEXT* context, const INT16* tiles, INT16* data,
+                               INT16* dwt, BYTE* rlgr, size_t count, UINT32 frames,
+                               STOPWATCH* sw[3])
+{
+	size_t t;
+	UINT32 frame;
+
+	for (frame = 0; frame < frames; frame++)
+	{
+		CopyMemory(data, tiles, count * 4096 * sizeof(INT16));
+		stopwatch_start(sw[0]);
+
+		for (t = 0; t < count; t++)
+			context->dwt_2d_encode(&data[t * 4096], dwt);
+
+		stopwatch_stop(sw[0]);
+		stopwatch_start(sw[1]);
+
+		for (t = 0; t < count; t++)
+			context->quantization_encode(&data[t * 4096], bench_rfx_quant);
+
+		stopwatch_stop(sw[1]);
+		stopwatch_start(sw[2]);
+
+		for (t = 0; t < count; t++)
+		{
+			if (context->rlgr_encode(RLGR3, &data[t * 4096], 4096, rlgr, 8192) <= 0)
+				return FALSE;
+		}
+
+		stopwatch_stop(sw[2]);
+	}
+
+	return TRUE;
+}
+
+/* RemoteFX progressive */
+
+static BOOL bench_progressive_new(BENCH_STATE* state, const BENCH_INPUT* input)
+{
+	state->progressiveEnc = progressive_context_new(TRUE);
+	state->progressiveDec = progressive_context_new(FALSE);
+
+	if (!state->progressiveEnc || !state->progressiveDec || !bench_alloc_output(state, input))
+		return FALSE;
+
+	return progressive_create_surface_context(state->progressiveDec, 0, input->width,
+	                                          input->height) >= 0;
+}
+
+static BOOL bench_progressive_frame(BENCH_STATE* state, const BENCH_INPUT* input,
+                                    BENCH_RESULT* result)
+{
+	int status;
+	UINT64 encodeTime;
+	REGION16 region;
+	BYTE* pDstData = NULL;
+	UINT32 DstSize = 0;
+	stopwatch_start(state->sw);
+	status = progressive_compress_ex(state->progressiveEnc, input->data, (UINT32)input->size,
+	                                 BENCH_FORMAT, input->width, input->height, input->stride,
+	                                 NULL, &pDstData, &DstSize);
+	stopwatch_stop(state->sw);
+
+	if (status < 0)
+		return FALSE;
+
+	encodeTime = bench_elapsed(state->sw);
+	region16_init(&region);
+	stopwatch_start(state->sw);
+	status = progressive_decompress_ex(state->progressiveDec, pDstData, DstSize, state->output,
+	                                   BENCH_FORMAT, input->stride, 0, 0, &region, 0,
+	                                   state->frameId++);
+	stopwatch_stop(state->sw);
+	region16_uninit(&region);
+
+	if (status < 0)
+		return FALSE;
+
+	return bench_record(result, encodeTime, bench_elapsed(state->sw), input->size, DstSize);
+}
+
+/* Planar and interleaved bitmaps, encoded in 64x64 tiles like bitmap updates */
+
+static BOOL bench_tiles_new(BENCH_STATE* state, const BENCH_INPUT* input)
+{
+	state->buffer = malloc(BENCH_TILE_SIZE * BENCH_TILE_SIZE * 4 * 2);
+	return state->buffer && bench_alloc_output(state, input);
+}
+
+static BOOL bench_planar_new(BENCH_STATE* state, const BENCH_INPUT* input)
+{
+	const DWORD flags = PLANAR_FORMAT_HEADER_RLE | PLANAR_FORMAT_HEADER_NA;
+	state->planarEnc = freerdp_bitmap_planar_context_new(flags, BENCH_TILE_SIZE, BENCH_TILE_SIZE);
+	state->planarDec = freerdp_bitmap_planar_context_new(0, BENCH_TILE_SIZE, BENCH_TILE_SIZE);
+	return state->planarEnc && state->planarDec && bench_tiles_new(state, input);
+}
+
+static BOOL bench_interleaved_new(BENCH_STATE* state, const BENCH_INPUT* input)
+{
+	state->interleavedEnc = bitmap_interleaved_context_new(TRUE);
+	state->interleavedDec = bitmap_interleaved_context_new(FALSE);
+	return state->interleavedEnc && state->interleavedDec && bench_tiles_new(state, input);
+}
+
+static BOOL bench_tiles_frame(BENCH_STATE* state, const BENCH_INPUT* input, BENCH_RESULT* result,
+                              BOOL planar)
+{
+	UINT32 x, y;
+	UINT64 encodeTime = 0;
+	UINT64 decodeTime = 0;
+	size_t encodedBytes = 0;
+
+	for (y = 0; y < input->height; y += BENCH_TILE_SIZE)
+	{
+		for (x = 0; x < input->width; x += BENCH_TILE_SIZE)
+		{
+			BOOL rc;
+			BYTE* pDstData = state->buffer;
+			UINT32 DstSize = BENCH_TILE_SIZE * BENCH_TILE_SIZE * 4 * 2;
+			const UINT32 width = MIN(BENCH_TILE_SIZE, input->width - x);
+			const UINT32 height = MIN(BENCH_TILE_SIZE, input->height - y);
+			const BYTE* pSrcData = &input->data[y * input->stride + x * 4];
+			stopwatch_start(state->sw);
+
+			if (planar)
+			{
+				pDstData = freerdp_bitmap_compress_planar(state->planarEnc, pSrcData, BENCH_FORMAT,
+				                                          width, height, input->stride, pDstData,
+				                                          &DstSize);
+				rc = pDstData != NULL;
+			}
+			else
+				rc = interleaved_compress(state->interleavedEnc, pDstData, &DstSize, width,
+				                          height, input->data, BENCH_FORMAT, input->stride, x, y,
+				                          NULL, 24);
+
+			stopwatch_stop(state->sw);
+
+			if (!rc)
+				return FALSE;
+
+			encodeTime += bench_elapsed(state->sw);
+			encodedBytes += DstSize;
+			stopwatch_start(state->sw);
+
+			if (planar)
+				rc = planar_decompress(state->planarDec, pDstData, DstSize, width, height,
+				                       state->output, BENCH_FORMAT, input->stride, x, y, width,
+				                       height, FALSE);
+			else
+				rc = interleaved_decompress(state->interleavedDec, pDstData, DstSize, width,
+				                            height, 24, state->output, BENCH_FORMAT, input->stride,
+				                            x, y, width, height, NULL);
+
+			stopwatch_stop(state->sw);
+
+			if (!rc)
+				return FALSE;
+
+			decodeTime += bench_elapsed(state->sw);
+		}
+	}
+
+	return bench_record(result, encodeTime, decodeTime, input->size, encodedBytes);
+}
+
+static BOOL bench_planar_frame(BENCH_STATE* state, const BENCH_INPUT* input, BENCH_RESULT* result)
+{
+	return bench_tiles_frame(state, input, result, TRUE);
+}
+
+static BOOL bench_interleaved_frame(BENCH_STATE* state, const BENCH_INPUT* input,
+                                    BENCH_RESULT* result)
+{
+	return bench_tiles_frame(state, input, result, FALSE);
+}
+
+/* NSCodec */
+
+static BOOL bench_nsc_new(BENCH_STATE* state, const BENCH_INPUT* input)
+{
+	state->nscEnc = nsc_context_new();
+	state->nscDec = nsc_context_new();
+	state->s = Stream_New(NULL, 1024);
+
+	if (!state->nscEnc || !state->nscDec || !state->s || !bench_alloc_output(state, input))
+		return FALSE;
+
+	if (!nsc_context_reset(state->nscEnc, input->width, input->height) ||
+	    !nsc_context_reset(state->nscDec, input->width, input->height))
+		return FALSE;
+
+	return nsc_context_set_parameters(state->nscEnc, NSC_COLOR_FORMAT, BENCH_FORMAT);
+}
+
+static BOOL bench_nsc_frame(BENCH_STATE* state, const BENCH_INPUT* input, BENCH_RESULT* result)
+{
+	BOOL rc;
+	UINT64 encodeTime;
+	Stream_SetPosition(state->s, 0);
+	stopwatch_start(state->sw);
+	rc = nsc_compose_message(state->nscEnc, state->s, input->data, input->width, input->height,
+	                         input->stride);
+	stopwatch_stop(state->sw);
+
+	if (!rc)
+		return FALSE;
+
+	encodeTime = bench_elapsed(state->sw);
+	stopwatch_start(state->sw);
+	rc = nsc_process_message(state->nscDec, 32, input->width, input->height,
+	                         Stream_Buffer(state->s), (UINT32)Stream_GetPosition(state->s),
+	                         state->output, BENCH_FORMAT, input->stride, 0, 0, input->width,
+	                         input->height, FREERDP_FLIP_NONE);
+	stopwatch_stop(state->sw);
+
+	if (!rc)
+		return FALSE;
+
+	return bench_record(result, encodeTime, bench_elapsed(state->sw), input->size,
+	                    Stream_GetPosition(state->s));
+}
+
+/* ClearCodec */
+
+static BOOL bench_clear_new(BENCH_STATE* state, const BENCH_INPUT* input)
+{
+	state->clearEnc = clear_context_new(TRUE);
+	state->clearDec = clear_context_new(FALSE);
+	return state->clearEnc && state->clearDec && bench_alloc_output(state, input);
+}
+
+static BOOL bench_clear_frame(BENCH_STATE* state, const BENCH_INPUT* input, BENCH_RESULT* result)
+{
+	int status;
+	UINT64 encodeTime;
+	BYTE* pDstData = NULL;
+	UINT32 DstSize = 0;
+	stopwatch_start(state->sw);
+	status = clear_compress(state->clearEnc, input->data, BENCH_FORMAT, input->stride,
+	                        input->width, input->height, &pDstData, &DstSize);
+	stopwatch_stop(state->sw);
+
+	if (status < 0)
+		return FALSE;
+
+	encodeTime = bench_elapsed(state->sw);
+	stopwatch_start(state->sw);
+	status = clear_decompress(state->clearDec, pDstData, DstSize, input->width, input->height,
+	                          state->output, BENCH_FORMAT, input->stride, 0, 0, input->width,
+	                          input->height, NULL);
+	stopwatch_stop(state->sw);
+
+	if (status < 0)
+		return FALSE;
+
+	return bench_record(result, encodeTime, bench_elapsed(state->sw), input->size, DstSize);
+}
+
+/* H.264 AVC420 and AVC444, available when FreeRDP was built with an H.264 encoder */
+
+static BOOL bench_h264_new(BENCH_STATE* state, const BENCH_INPUT* input)
+{
+	state->h264Enc = h264_context_new(TRUE);
+	state->h264Dec = h264_context_new(FALSE);
+
+	if (!state->h264Enc || !state->h264Dec || !bench_alloc_output(state, input))
+		return FALSE;
+
+	state->h264Enc->RateControlMode = H264_RATECONTROL_VBR;
+	state->h264Enc->BitRate = 10000000;
+	state->h264Enc->FrameRate = 30;
+	return h264_context_reset(state->h264Enc, input->width, input->height) &&
+	       h264_context_reset(state->h264Dec, input->width, input->height);
+}
+
+static BOOL bench_avc420_frame(BENCH_STATE* state, const BENCH_INPUT* input, BENCH_RESULT* result)
+{
+	INT32 status;
+	UINT64 encodeTime;
+	BYTE* pDstData = NULL;
+	UINT32 DstSize = 0;
+	RECTANGLE_16 rect = { 0, 0, (UINT16)input->width, (UINT16)input->height };
+	stopwatch_start(state->sw);
+	status = avc420_compress(state->h264Enc, input->data, BENCH_FORMAT, input->stride,
+	                         input->width, input->height, &pDstData, &DstSize);
+	stopwatch_stop(state->sw);
+
+	if (status < 0)
+		return FALSE;
+
+	encodeTime = bench_elapsed(state->sw);
+	stopwatch_start(state->sw);
+	status = avc420_decompress(state->h264Dec, pDstData, DstSize, state->output, BENCH_FORMAT,
+	                           input->stride, input->width, input->height, &rect, 1);
+	stopwatch_stop(state->sw);
+
+	if (status < 0)
+		return FALSE;
+
+	return bench_record(result, encodeTime, bench_elapsed(state->sw), input->size, DstSize);
+}
+
+static BOOL bench_avc444_frame(BENCH_STATE* state, const BENCH_INPUT* input, BENCH_RESULT* result)
+{
+	INT32 status;
+	BYTE op = 0;
+	UINT64 encodeTime;
+	BYTE* pDstData = NULL;
+	UINT32 DstSize = 0;
+	BYTE* pAuxDstData = NULL;
+	UINT32 AuxDstSize = 0;
+	RECTANGLE_16 rect = { 0, 0, (UINT16)input->width, (UINT16)input->height };
+	stopwatch_start(state->sw);
+	status = avc444_compress(state->h264Enc, input->data, BENCH_FORMAT, input->stride,
+	                         input->width, input->height, 2, &op, &pDstData, &DstSize,
+	                         &pAuxDstData, &AuxDstSize);
+	stopwatch_stop(state->sw);
+
+	if (status < 0)
+		return FALSE;
+
+	encodeTime = bench_elapsed(state->sw);
+	stopwatch_start(state->sw);
+	status = avc444_decompress(state->h264Dec, op, &rect, 1, pDstData, DstSize, &rect, 1,
+	                           pAuxDstData, AuxDstSize, state->output, BENCH_FORMAT,
+	                           input->stride, input->width, input->height,
+	                           RDPGFX_CODECID_AVC444v2);
+	stopwatch_stop(state->sw);
+
+	if (status < 0)
+		return FALSE;
+
+	return bench_record(result, encodeTime, bench_elapsed(state->sw), input->size,
+	                    DstSize + AuxDstSize);
+}
+
+/* Bulk compressors, fed with the stream in PDU sized chunks */
+
+static size_t bench_chunk_size = 16000;
+static unsigned long bench_match_level = BULK_MATCH_LEVEL_LEGACY;
+
+static BOOL bench_bulk_new(BENCH_STATE* state)
+{
+	state->buffer = malloc(BENCH_BULK_BUFFER_SIZE);
+	return state->buffer != NULL;
+}
+
+static BOOL bench_mppc_new(BENCH_STATE* state, const BENCH_INPUT* input)
+{
+	WINPR_UNUSED(input);
+	state->mppcEnc = mppc_context_new(1, TRUE);
+	mppc_set_match_level(state->mppcEnc, (UINT32)bench_match_level);
+	state->mppcDec = mppc_context_new(1, FALSE);
+	return state->mppcEnc && state->mppcDec && bench_bulk_new(state);
+}
+
+static BOOL bench_ncrush_new(BENCH_STATE* state, const BENCH_INPUT* input)
+{
+	WINPR_UNUSED(input);
+	state->ncrushEnc = ncrush_context_new(TRUE);
+	ncrush_set_match_level(state->ncrushEnc, (UINT32)bench_match_level);
+	state->ncrushDec = ncrush_context_new(FALSE);
+	return state->ncrushEnc && state->ncrushDec && bench_bulk_new(state);
+}
+
+static BOOL bench_xcrush_new(BENCH_STATE* state, const BENCH_INPUT* input)
+{
+	WINPR_UNUSED(input);
+	state->xcrushEnc = xcrush_context_new(TRUE);
+	state->xcrushDec = xcrush_context_new(FALSE);
+	return state->xcrushEnc && state->xcrushDec && bench_bulk_new(state);
+}
+
+static BOOL bench_zgfx_new(BENCH_STATE* state, const BENCH_INPUT* input)
+{
+	WINPR_UNUSED(input);
+	state->zgfxEnc = zgfx_context_new(TRUE);
+	state->zgfxDec = zgfx_context_new(FALSE);
+	return state->zgfxEnc && state->zgfxDec;
+}
+
+static int bench_bulk_compress(BENCH_STATE* state, BYTE* pSrcData, UINT32 SrcSize,
+                               BYTE** ppDstData, UINT32* pDstSize, UINT32* pFlags)
+{
+	*ppDstData = state->buffer;
+	*pDstSize = BENCH_BULK_BUFFER_SIZE;
+
+	if (state->mppcEnc)
+		return mppc_compress(state->mppcEnc, pSrcData, SrcSize, ppDstData, pDstSize, pFlags);
+	else if (state->ncrushEnc)
+		return ncrush_compress(state->ncrushEnc, pSrcData, SrcSize, ppDstData, pDstSize, pFlags);
+	else
+		return xcrush_compress(state->xcrushEnc, pSrcData, SrcSize, ppDstData, pDstSize, pFlags);
+}
+
+static int bench_bulk_decompress(BENCH_STATE* state, BYTE* pSrcData, UINT32 SrcSize,
+                                 BYTE** ppDstData, UINT32* pDstSize, UINT32 flags)
+{
+	if (state->mppcDec)
+		return mppc_decompress(state->mppcDec, pSrcData, SrcSize, ppDstData, pDstSize, flags);
+	else if (state->ncrushDec)
+		return ncrush_decompress(state->ncrushDec, pSrcData, SrcSize, ppDstData, pDstSize, flags);
+	else
+		return xcrush_decompress(state->xcrushDec, pSrcData, SrcSize, ppDstData, pDstSize, flags);
+}
+
+static BOOL bench_bulk_frame(BENCH_STATE* state, const BENCH_INPUT* input, BENCH_RESULT* result)
+{
+	size_t offset;
+
+	for (offset = 0; offset < input->size; offset += bench_chunk_size)
+	{
+		int status;
+		UINT64 encodeTime;
+		UINT64 decodeTime = 0;
+		UINT32 flags = 0;
+		BYTE* pDstData = NULL;
+		UINT32 DstSize = 0;
+		BYTE* pOutData = NULL;
+		UINT32 OutSize = 0;
+		BYTE* pSrcData = &input->data[offset];
+		const UINT32 SrcSize = (UINT32)MIN(bench_chunk_size, input->size - offset);
+		stopwatch_start(state->sw);
+		status = bench_bulk_compress(state, pSrcData, SrcSize, &pDstData, &DstSize, &flags);
+		stopwatch_stop(state->sw);
+
+		if (status < 0)
+			return FALSE;
+
+		encodeTime = bench_elapsed(state->sw);
+
+		/* Same rules as the bulk layer: without any flag the chunk is sent as is */
+		if (flags & 0xE0)
+		{
+			stopwatch_start(state->sw);
+			status = bench_bulk_decompress(state, pDstData, DstSize, &pOutData, &OutSize, flags);
+			stopwatch_stop(state->sw);
+
+			if (status < 0)
+				return FALSE;
+
+			decodeTime = bench_elapsed(state->sw);
+		}
+		else
+		{
+			pOutData = pDstData;
+			OutSize = DstSize;
+		}
+
+		if ((OutSize != SrcSize) || (memcmp(pOutData, pSrcData, SrcSize) != 0))
+		{
+			fprintf(stderr, "%s: chunk at offset %" PRIuz " does not round trip\n", input->name,
+			        offset);
+			result->errors++;
+		}
+
+		if (!bench_record(result, encodeTime, decodeTime, SrcSize,
+		                  (flags & PACKET_COMPRESSED) ? DstSize : SrcSize))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static BOOL bench_zgfx_frame(BENCH_STATE* state, const BENCH_INPUT* input, BENCH_RESULT* result)
+{
+	size_t offset;
+
+	for (offset = 0; offset < input->size; offset += bench_chunk_size)
+	{
+		int status;
+		UINT64 encodeTime;
+		UINT32 flags = 0;
+		BYTE* pDstData = NULL;
+		UINT32 DstSize = 0;
+		BYTE* pOutData = NULL;
+		UINT32 OutSize = 0;
+		const BYTE* pSrcData = &input->data[offset];
+		const UINT32 SrcSize = (UINT32)MIN(bench_chunk_size, input->size - offset);
+		stopwatch_start(state->sw);
+		status = zgfx_compress(state->zgfxEnc, pSrcData, SrcSize, &pDstData, &DstSize, &flags);
+		stopwatch_stop(state->sw);
+
+		if (status < 0)
+			return FALSE;
+
+		encodeTime = bench_elapsed(state->sw);
+		stopwatch_start(state->sw);
+		status = zgfx_decompress(state->zgfxDec, pDstData, DstSize, &pOutData, &OutSize, 0);
+		stopwatch_stop(state->sw);
+
+		if ((status < 0) || (OutSize != SrcSize) || (memcmp(pOutData, pSrcData, SrcSize) != 0))
+		{
+			fprintf(stderr, "%s: chunk at offset %" PRIuz " does not round trip\n", input->name,
+			        offset);
+			result->errors++;
+		}
+
+		free(pOutData);
+		free(pDstData);
+
+		if (!bench_record(result, encodeTime, bench_elapsed(state->sw), SrcSize, DstSize))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static const BENCH_CODEC BENCH_CODECS[] = {
+	{ "rfx", BENCH_INPUT_IMAGE, bench_rfx_new, bench_rfx_frame },
+	{ "progressive", BENCH_INPUT_IMAGE, bench_progressive_new, bench_progressive_frame },
+	{ "planar", BENCH_INPUT_IMAGE, bench_planar_new, bench_planar_frame },
+	{ "interleaved", BENCH_INPUT_IMAGE, bench_interleaved_new, bench_interleaved_frame },
+	{ "nsc", BENCH_INPUT_IMAGE, bench_nsc_new, bench_nsc_frame },
+	{ "clear", BENCH_INPUT_IMAGE, bench_clear_new, bench_clear_frame },
+	{ "avc420", BENCH_INPUT_IMAGE, bench_h264_new, bench_avc420_frame },
+	{ "avc444", BENCH_INPUT_IMAGE, bench_h264_new, bench_avc444_frame },
+	{ "mppc", BENCH_INPUT_STREAM, bench_mppc_new, bench_bulk_frame },
+	{ "ncrush", BENCH_INPUT_STREAM, bench_ncrush_new, bench_bulk_frame },
+	{ "xcrush", BENCH_INPUT_STREAM, bench_xcrush_new, bench_bulk_frame },
+	{ "zgfx", BENCH_INPUT_STREAM, bench_zgfx_new, bench_zgfx_frame },
+};
+
+static void bench_state_free(BENCH_STATE* state)
+{
+	rfx_context_free(state->rfxEnc);
+	rfx_context_free(state->rfxDec);
+	progressive_context_free(state->progressiveEnc);
+	progressive_context_free(state->progressiveDec);
+	freerdp_bitmap_planar_context_free(state->planarEnc);
+	freerdp_bitmap_planar_context_free(state->planarDec);
+	bitmap_interleaved_context_free(state->interleavedEnc);
+	bitmap_interleaved_context_free(state->interleavedDec);
+	nsc_context_free(state->nscEnc);
+	nsc_context_free(state->nscDec);
+	clear_context_free(state->clearEnc);
+	clear_context_free(state->clearDec);
+	h264_context_free(state->h264Enc);
+	h264_context_free(state->h264Dec);
+	mppc_context_free(state->mppcEnc);
+	mppc_context_free(state->mppcDec);
+	ncrush_context_free(state->ncrushEnc);
+	ncrush_context_free(state->ncrushDec);
+	xcrush_context_free(state->xcrushEnc);
+	xcrush_context_free(state->xcrushDec);
+	zgfx_context_free(state->zgfxEnc);
+	zgfx_context_free(state->zgfxDec);
+	Stream_Free(state->s, TRUE);
+	_aligned_free(state->output);
+	free(state->buffer);
+	stopwatch_free(state->sw);
+	ZeroMemory(state, sizeof(BENCH_STATE));
+}
+
+/* Inputs */
+
+static BOOL bench_input_set_image(BENCH_INPUT* input, UINT32 width, UINT32 height)
+{
+	input->type = BENCH_INPUT_IMAGE;
+	input->width = width;
+	input->height = height;
+	input->stride = width * 4;
+	input->size = 1ULL * input->stride * height;
+	input->data = _aligned_malloc(input->size, 16);
+	return input->data != NULL;
+}
+
+static BOOL bench_input_load_image(BENCH_INPUT* input, const char* filename)
+{
+	BOOL rc = FALSE;
+	UINT32 format;
+	wImage* image = winpr_image_new();
+
+	if (!image)
+		return FALSE;
+
+	if (winpr_image_read(image, filename) <= 0)
+	{
+		fprintf(stderr, "failed to read image %s\n", filename);
+		goto fail;
+	}
+
+	format = (image->bitsPerPixel == 24) ? PIXEL_FORMAT_BGR24 : PIXEL_FORMAT_BGRX32;
+
+	if ((image->width <= 0) || (image->height <= 0) || (image->width > UINT16_MAX) ||
+	    (image->height > UINT16_MAX))
+		goto fail;
+
+	if (!bench_input_set_image(input, (UINT32)image->width, (UINT32)image->height))
+		goto fail;
+
+	rc = freerdp_image_copy(input->data, BENCH_FORMAT, input->stride, 0, 0, input->width,
+	                        input->height, image->data, format, (UINT32)image->scanline, 0, 0,
+	                        NULL, FREERDP_FLIP_NONE);
+fail:
+	winpr_image_free(image, TRUE);
+	return rc;
+}
+
+static BOOL bench_input_load_stream(BENCH_INPUT* input, const char* filename)
+{
+	BOOL rc = FALSE;
+	INT64 size;
+	FILE* fp = winpr_fopen(filename, "rb");
+
+	if (!fp)
+	{
+		fprintf(stderr, "failed to open %s\n", filename);
+		return FALSE;
+	}
+
+	if ((_fseeki64(fp, 0, SEEK_END) != 0) || ((size = _ftelli64(fp)) <= 0) ||
+	    (_fseeki64(fp, 0, SEEK_SET) != 0))
+		goto fail;
+
+	input->type = BENCH_INPUT_STREAM;
+	input->size = (size_t)size;
+	input->data = _aligned_malloc(input->size, 16);
+
+	if (!input->data)
+		goto fail;
+
+	rc = fread(input->data, input->size, 1, fp) == 1;
+fail:
+	fclose(fp);
+	return rc;
+}
+
+static BOOL bench_input_load(BENCH_INPUT* input, const char* filename)
+{
+	const char* ext = strrchr(filename, '.');
+	input->name = _strdup(filename);
+
+	if (!input->name)
+		return FALSE;
+
+	if (ext && ((_stricmp(ext, ".bmp") == 0) || (_stricmp(ext, ".png") == 0)))
+		return bench_input_load_image(input, filename);
+
+	return bench_input_load_stream(input, filename);
+}
+
+/**
+ * A desktop like frame: gradient background, flat windows, text like
+ * detail and a noisy picture, so that every codec path gets exercised.
+ */
+static BOOL bench_input_synthetic(BENCH_INPUT* image, BENCH_INPUT* stream)
+{
+	UINT32 x, y;
+	UINT32 seed = 0x12345678;
+
+	if (!bench_input_set_image(image, BENCH_SYNTHETIC_WIDTH, BENCH_SYNTHETIC_HEIGHT))
+		return FALSE;
+
+	image->name = _strdup("synthetic-image");
+
+	for (y = 0; y < image->height; y++)
+	{
+		BYTE* line = &image->data[y * image->stride];
+
+		for (x = 0; x < image->width; x++)
+		{
+			BYTE r = (BYTE)(x * 255 / image->width);
+			BYTE g = (BYTE)(y * 255 / image->height);
+			BYTE b = 0x80;
+
+			if ((x >= 200) && (x < 1100) && (y >= 150) && (y < 750))
+			{
+				r = g = b = 0xF0;
+
+				/* Glyph like strokes on the window body */
+				if ((y >= 200) && (((x / 3) ^ (y / 2)) % 7 == 0) && ((y % 20) < 14))
+					r = g = b = 0x10;
+			}
+			else if ((x >= 1200) && (x < 1800) && (y >= 300) && (y < 900))
+			{
+				seed = seed * 1103515245 + 12345;
+				r = (BYTE)((x + (seed >> 16)) & 0xFF);
+				g = (BYTE)((y + (seed >> 8)) & 0xFF);
+				b = (BYTE)(seed >> 24);
+			}
+
+			line[x * 4 + 0] = b;
+			line[x * 4 + 1] = g;
+			line[x * 4 + 2] = r;
+			line[x * 4 + 3] = 0xFF;
+		}
+	}
+
+	/* The uncompressed pixels are a typical bulk compression payload */
+	stream->name = _strdup("synthetic-stream");
+	stream->type = BENCH_INPUT_STREAM;
+	stream->size = image->size;
+	stream->data = _aligned_malloc(stream->size, 16);
+
+	if (!image->name || !stream->name || !stream->data)
+		return FALSE;
+
+	CopyMemory(stream->data, image->data, stream->size);
+	return TRUE;
+}
+
+static void bench_input_free(BENCH_INPUT* input)
+{
+	free(input->name);
+	_aligned_free(input->data);
+	ZeroMemory(input, sizeof(BENCH_INPUT));
+}
+
+/* Reporting */
+
+static int bench_compare_times(const void* a, const void* b)
+{
+	const UINT64 va = *(const UINT64*)a;
+	const UINT64 vb = *(const UINT64*)b;
+	return (va > vb) - (va < vb);
+}
+
+static UINT64 bench_percentile(UINT64* times, size_t count, UINT32 percentile)
+{
+	size_t rank;
+
+	if (count == 0)
+		return 0;
+
+	qsort(times, count, sizeof(UINT64), bench_compare_times);
+	rank = (count * percentile + 99) / 100;
+	return times[(rank > 0) ? rank - 1 : 0];
+}
+
+static UINT64 bench_total(const UINT64* times, size_t count)
+{
+	size_t x;
+	UINT64 total = 0;
+
+	for (x = 0; x < count; x++)
+		total += times[x];
+
+	return total;
+}
+
+static double bench_throughput(UINT64 bytes, UINT64 usecs)
+{
+	/* bytes per microsecond equals MB/s */
+	return usecs ? (double)bytes / (double)usecs : 0.0;
+}
+
+static void bench_report_header(FILE* fp, BENCH_OUTPUT_FORMAT format)
+{
+	switch (format)
+	{
+		case BENCH_OUTPUT_CSV:
+			fprintf(fp, "codec,input,status,frames,raw_bytes,encoded_bytes,ratio,encode_mbps,"
+			            "decode_mbps,encode_p50_us,encode_p90_us,encode_p99_us,decode_p50_us,"
+			            "decode_p90_us,decode_p99_us,errors\n");
+			break;
+
+		case BENCH_OUTPUT_JSON:
+			fprintf(fp, "[");
+			break;
+
+		default:
+			fprintf(fp, "%-12s %-24s %7s %8s %10s %10s %22s %22s %6s\n", "codec", "input", "frames",
+			        "ratio", "enc MB/s", "dec MB/s", "enc p50/p90/p99 (us)",
+			        "dec p50/p90/p99 (us)", "errors");
+			break;
+	}
+}
+
+static void bench_report_footer(FILE* fp, BENCH_OUTPUT_FORMAT format)
+{
+	if (format == BENCH_OUTPUT_JSON)
+		fprintf(fp, "\n]\n");
+}
+
+static void bench_report(FILE* fp, BENCH_OUTPUT_FORMAT format, size_t index,
+                         const BENCH_CODEC* codec, const BENCH_INPUT* input, const char* status,
+                         BENCH_RESULT* result)
+{
+	UINT64 enc[3];
+	UINT64 dec[3];
+	const char* name = input->name;
+	const UINT32 percentiles[3] = { 50, 90, 99 };
+	const double ratio =
+	    result->encodedBytes ? (double)result->rawBytes / (double)result->encodedBytes : 0.0;
+	const double encodeRate =
+	    bench_throughput(result->rawBytes, bench_total(result->encodeTimes, result->count));
+	const double decodeRate =
+	    bench_throughput(result->rawBytes, bench_total(result->decodeTimes, result->count));
+	size_t x;
+
+	for (x = 0; x < ARRAYSIZE(percentiles); x++)
+	{
+		enc[x] = bench_percentile(result->encodeTimes, result->count, percentiles[x]);
+		dec[x] = bench_percentile(result->decodeTimes, result->count, percentiles[x]);
+	}
+
+	switch (format)
+	{
+		case BENCH_OUTPUT_CSV:
+			fprintf(fp,
+			        "%s,%s,%s,%" PRIuz ",%" PRIu64 ",%" PRIu64 ",%.3f,%.2f,%.2f,%" PRIu64
+			        ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu32 "\n",
+			        codec->name, input->name, status, result->count, result->rawBytes,
+			        result->encodedBytes, ratio, encodeRate, decodeRate, enc[0], enc[1], enc[2],
+			        dec[0], dec[1], dec[2], result->errors);
+			break;
+
+		case BENCH_OUTPUT_JSON:
+			fprintf(fp,
+			        "%s\n  {\"codec\": \"%s\", \"input\": \"%s\", \"status\": \"%s\", "
+			        "\"frames\": %" PRIuz ", \"raw_bytes\": %" PRIu64 ", \"encoded_bytes\": %" PRIu64
+			        ", \"ratio\": %.3f, \"encode_mbps\": %.2f, \"decode_mbps\": %.2f, "
+			        "\"encode_us\": {\"p50\": %" PRIu64 ", \"p90\": %" PRIu64 ", \"p99\": %" PRIu64
+			        "}, \"decode_us\": {\"p50\": %" PRIu64 ", \"p90\": %" PRIu64
+			        ", \"p99\": %" PRIu64 "}, \"errors\": %" PRIu32 "}",
+			        (index > 0) ? "," : "", codec->name, input->name, status, result->count,
+			        result->rawBytes, result->encodedBytes, ratio, encodeRate, decodeRate, enc[0],
+			        enc[1], enc[2], dec[0], dec[1], dec[2], result->errors);
+			break;
+
+		default:
+			/* Keep the end of long paths, it is the part that tells inputs apart */
+			if (strlen(name) > 24)
+				name += strlen(name) - 24;
+
+			if (strcmp(status, "ok") != 0)
+			{
+				fprintf(fp, "%-12s %-24s %s\n", codec->name, name, status);
+				break;
+			}
+
+			fprintf(fp,
+			        "%-12s %-24s %7" PRIuz " %8.2f %10.2f %10.2f %6" PRIu64 "/%6" PRIu64
+			        "/%6" PRIu64 " %6" PRIu64 "/%6" PRIu64 "/%6" PRIu64 " %6" PRIu32 "\n",
+			        codec->name, name, result->count, ratio, encodeRate, decodeRate, enc[0], enc[1],
+			        enc[2], dec[0], dec[1], dec[2], result->errors);
+			break;
+	}
+}
+
+static const char* bench_run(const BENCH_CODEC* codec, const BENCH_INPUT* input, UINT32 frames,
+                             BENCH_RESULT* result)
+{
+	UINT32 x;
+	const char* status = "ok";
+	BENCH_STATE state = { 0 };
+	BENCH_RESULT warmup = { 0 };
+	state.sw = stopwatch_create();
+
+	if (!state.sw || !codec->New(&state, input))
+	{
+		status = "unavailable";
+		goto out;
+	}
+
+	/* The first frame fills caches and sends codec headers, keep it out of the numbers */
+	if (!codec->Frame(&state, input, &warmup))
+	{
+		status = "failed";
+		goto out;
+	}
+
+	for (x = 0; x < frames; x++)
+	{
+		if (!codec->Frame(&state, input, result))
+		{
+			status = "failed";
+			break;
+		}
+	}
+
+	result->errors += warmup.errors;
+out:
+	free(warmup.encodeTimes);
+	free(warmup.decodeTimes);
+	bench_state_free(&state);
+	return status;
+}
+
+/* RemoteFX tile kernel mode */
+
+static void bench_rfx_simd_header(FILE* fp, BENCH_OUTPUT_FORMAT format)
+{
+	switch (format)
+	{
+		case BENCH_OUTPUT_CSV:
+			fprintf(fp, "simd,input,status,tiles,dwt_us,quant_us,rlgr_us,total_us\n");
+			break;
+
+		case BENCH_OUTPUT_JSON:
+			fprintf(fp, "[");
+			break;
+
+		default:
+			fprintf(fp, "%-8s %-24s %8s %10s %10s %10s %10s\n", "simd", "input", "tiles",
+			        "dwt us", "quant us", "rlgr us", "total us");
+			break;
+	}
+}
+
+static void bench_rfx_simd_report(FILE* fp, BENCH_OUTPUT_FORMAT format, size_t index,
+                                  const BENCH_RFX_SIMD* simd, const BENCH_INPUT* input,
+                                  const char* status, UINT64 tiles, STOPWATCH* sw[3])
+{
+	size_t x;
+	double us[4] = { 0 };
+	const char* name = input->name;
+
+	/* microseconds per tile of every stage and their sum */
+	for (x = 0; tiles && (x < 3); x++)
+	{
+		us[x] = (double)sw[x]->elapsed / (double)tiles;
+		us[3] += us[x];
+	}
+
+	switch (format)
+	{
+		case BENCH_OUTPUT_CSV:
+			fprintf(fp, "%s,%s,%s,%" PRIu64 ",%.3f,%.3f,%.3f,%.3f\n", simd->name, input->name,
+			        status, tiles, us[0], us[1], us[2], us[3]);
+			break;
+
+		case BENCH_OUTPUT_JSON:
+			fprintf(fp,
+			        "%s\n  {\"simd\": \"%s\", \"input\": \"%s\", \"status\": \"%s\", "
+			        "\"tiles\": %" PRIu64 ", \"dwt_us\": %.3f, \"quant_us\": %.3f, "
+			        "\"rlgr_us\": %.3f, \"total_us\": %.3f}",
+			        (index > 0) ? "," : "", simd->name, input->name, status, tiles, us[0], us[1],
+			        us[2], us[3]);
+			break;
+
+		default:
+			if (strlen(name) > 24)
+				name += strlen(name) - 24;
+
+			if (strcmp(status, "ok") != 0)
+			{
+				fprintf(fp, "%-8s %-24s %s\n", simd->name, name, status);
+				break;
+			}
+
+			fprintf(fp, "%-8s %-24s %8" PRIu64 " %10.2f %10.2f %10.2f %10.2f\n", simd->name, name,
+			        tiles, us[0], us[1], us[2], us[3]);
+			break;
+	}
+}
+
+/**
+ * Times the DWT, quantization and RLGR kernels that rfx_context_set_simd selects, for every
+ * instruction set, on the luma of the 64x64 tiles of an image. Returns the exit status.
+ */
+static int bench_rfx_simd(FILE* fp, BENCH_OUTPUT_FORMAT format, const BENCH_INPUT* input,
+                          UINT32 frames, size_t* reported)
+{
+	int rc = 0;
+	size_t x, y, count = 0;
+	STOPWATCH* sw[3] = { 0 };
+	INT16* tiles = bench_rfx_tiles(input, &count);
+	INT16* data = _aligned_malloc(count * 4096 * sizeof(INT16), 32);
+	INT16* dwt = _aligned_malloc(4096 * sizeof(INT16), 32);
+	BYTE* rlgr = malloc(8192);
+
+	for (x = 0; x < ARRAYSIZE(sw); x++)
+		sw[x] = stopwatch_create();
+
+	if (!tiles || !data || !dwt || !rlgr || !sw[0] || !sw[1] || !sw[2])
+	{
+		fprintf(stderr, "%s: no 64x64 tiles or out of memory\n", input->name);
+		rc = 1;
+		goto out;
+	}
+
+	for (x = 0; x < ARRAYSIZE(BENCH_RFX_SIMDS); x++)
+	{
+		const char* status = "ok";
+		RFX_CONTEXT* context = rfx_context_new(TRUE);
+
+		if (!context || !rfx_context_set_simd(context, BENCH_RFX_SIMDS[x].simd))
+			status = "unavailable";
+		else
+		{
+			/* the first pass warms up the caches and is not counted */
+			BOOL success = bench_rfx_simd_run(context, tiles, data, dwt, rlgr, count, 1, sw);
+
+			for (y = 0; y < ARRAYSIZE(sw); y++)
+				stopwatch_reset(sw[y]);
+
+			if (!success ||
+			    !bench_rfx_simd_run(context, tiles, data, dwt, rlgr, count, frames, sw))
+			{
+				status = "failed";
+				rc = 2;
+			}
+		}
+
+		bench_rfx_simd_report(fp, format, (*reported)++, &BENCH_RFX_SIMDS[x], input, status,
+		                      strcmp(status, "ok") ? 0 : 1ULL * count * frames, sw);
+		fflush(fp);
+		rfx_context_free(context);
+	}
+
+out:
+	for (x = 0; x < ARRAYSIZE(sw); x++)
+		stopwatch_free(sw[x]);
+
+	_aligned_free(tiles);
+	_aligned_free(data);
+	_aligned_free(dwt);
+	free(rlgr);
+	return rc;
+}
+
+/* Damage region mode */
+
+struct _BENCH_REGION_PATTERN
+{
+	const char* name;
+	UINT32 maxWidth;
+	UINT32 maxHeight; /* 0 for the frame height */
+};
+typedef struct _BENCH_REGION_PATTERN BENCH_REGION_PATTERN;
+
+/* Small scattered damage is the common case, tall overlapping columns the worst one */
+static const BENCH_REGION_PATTERN BENCH_REGION_PATTERNS[] = { { "scattered", 128, 128 },
+	                                                          { "tall", 64, 0 } };
+
+static void bench_region_rects(RECTANGLE_16* rects, UINT32 count, const BENCH_INPUT* input,
+                               const BENCH_REGION_PATTERN* pattern, UINT32 seed)
+{
+	UINT32 x, y;
+	const UINT32 maxHeight = pattern->maxHeight ? pattern->maxHeight : input->height;
+
+	for (x = 0; x < count; x++)
+	{
+		UINT32 v[4];
+
+		for (y = 0; y < 4; y++)
+		{
+			seed = seed * 1103515245 + 12345;
+			v[y] = seed >> 8;
+		}
+
+		rects[x].left = (UINT16)(v[0] % input->width);
+		rects[x].top = (UINT16)(v[1] % input->height);
+		rects[x].right = (UINT16)MIN(input->width, rects[x].left + 1 + v[2] % pattern->maxWidth);
+		rects[x].bottom = (UINT16)MIN(input->height, rects[x].top + 1 + v[3] % maxHeight);
+	}
+}
+
+static UINT64 bench_region_area(const REGION16* region)
+{
+	UINT32 x, nbRects;
+	UINT64 area = 0;
+	const RECTANGLE_16* rects = region16_rects(region, &nbRects);
+
+	for (x = 0; x < nbRects; x++)
+		area += 1ULL * (rects[x].right - rects[x].left) * (rects[x].bottom - rects[x].top);
+
+	return area;
+}
+
+/* Merges the rectangles one by one and as a batch, returns FALSE on allocation failures */
+static BOOL bench_region_frame(STOPWATCH* sequentialSw, STOPWATCH* batchSw,
+                               const RECTANGLE_16* rects, UINT32 count, BOOL* pEqual)
+{
+	BOOL rc = TRUE;
+	UINT32 x;
+	REGION16 sequential, batch;
+	region16_init(&sequential);
+	region16_init(&batch);
+	stopwatch_start(sequentialSw);
+
+	for (x = 0; rc && (x < count); x++)
+		rc = region16_union_rect(&sequential, &sequential, &rects[x]);
+
+	stopwatch_stop(sequentialSw);
+	stopwatch_start(batchSw);
+	rc = rc && region16_union_rects(&batch, &batch, rects, count);
+	stopwatch_stop(batchSw);
+	*pEqual = bench_region_area(&sequential) == bench_region_area(&batch);
+	region16_uninit(&sequential);
+	region16_uninit(&batch);
+	return rc;
+}
+
+static void bench_region_header(FILE* fp, BENCH_OUTPUT_FORMAT format)
+{
+	switch (format)
+	{
+		case BENCH_OUTPUT_CSV:
+			fprintf(fp, "pattern,input,status,frames,rects,sequential_us,batched_us,speedup,"
+			            "errors\n");
+			break;
+
+		case BENCH_OUTPUT_JSON:
+			fprintf(fp, "[");
+			break;
+
+		default:
+			fprintf(fp, "%-10s %-24s %7s %7s %14s %14s %8s %6s\n", "pattern", "input", "frames",
+			        "rects", "sequential us", "batched us", "speedup", "errors");
+			break;
+	}
+}
+
+static void bench_region_report(FILE* fp, BENCH_OUTPUT_FORMAT format, size_t index,
+                                const BENCH_REGION_PATTERN* pattern, const BENCH_INPUT* input,
+                                const char* status, UINT32 frames, UINT32 count,
+                                STOPWATCH* sequentialSw, STOPWATCH* batchSw, UINT32 errors)
+{
+	const char* name = input->name;
+	/* microseconds per frame */
+	const double sequential = frames ? (double)sequentialSw->elapsed / frames : 0.0;
+	const double batched = frames ? (double)batchSw->elapsed / frames : 0.0;
+	const double speedup = (batched > 0.0) ? sequential / batched : 0.0;
+
+	switch (format)
+	{
+		case BENCH_OUTPUT_CSV:
+			fprintf(fp, "%s,%s,%s,%" PRIu32 ",%" PRIu32 ",%.2f,%.2f,%.2f,%" PRIu32 "\n",
+			        pattern->name, input->name, status, frames, count, sequential, batched,
+			        speedup, errors);
+			break;
+
+		case BENCH_OUTPUT_JSON:
+			fprintf(fp,
+			        "%s\n  {\"pattern\": \"%s\", \"input\": \"%s\", \"status\": \"%s\", "
+			        "\"frames\": %" PRIu32 ", \"rects\": %" PRIu32 ", \"sequential_us\": %.2f, "
+			        "\"batched_us\": %.2f, \"speedup\": %.2f, \"errors\": %" PRIu32 "}",
+			        (index > 0) ? "," : "", pattern->name, input->name, status, frames, count,
+			        sequential, batched, speedup, errors);
+			break;
+
+		default:
+			if (strlen(name) > 24)
+				name += strlen(name) - 24;
+
+			if (strcmp(status, "ok") != 0)
+			{
+				fprintf(fp, "%-10s %-24s %s\n", pattern->name, name, status);
+				break;
+			}
+
+			fprintf(fp, "%-10s %-24s %7" PRIu32 " %7" PRIu32 " %14.2f %14.2f %8.2f %6" PRIu32 "\n",
+			        pattern->name, name, frames, count, sequential, batched, speedup, errors);
+			break;
+	}
+}
+
+/**
+ * Compares merging pseudo random damage rectangles, one per 64x64 tile of an image, one by
+ * one with region16_union_rect and as a batch with region16_union_rects. The rectangles
+ * change on every frame. Returns the exit status.
+ */
+static int bench_region(FILE* fp, BENCH_OUTPUT_FORMAT format, const BENCH_INPUT* input,
+                        UINT32 frames, size_t* reported)
+{
+	int rc = 0;
+	size_t x;
+	const UINT32 count =
+	    MAX(1, (input->width / BENCH_TILE_SIZE) * (input->height / BENCH_TILE_SIZE));
+	RECTANGLE_16* rects = calloc(count, sizeof(RECTANGLE_16));
+	STOPWATCH* sequentialSw = stopwatch_create();
+	STOPWATCH* batchSw = stopwatch_create();
+
+	if (!rects || !sequentialSw || !batchSw)
+	{
+		rc = 1;
+		goto out;
+	}
+
+	for (x = 0; x < ARRAYSIZE(BENCH_REGION_PATTERNS); x++)
+	{
+		UINT32 frame;
+		UINT32 errors = 0;
+		BOOL equal = TRUE;
+		const char* status = "ok";
+		const BENCH_REGION_PATTERN* pattern = &BENCH_REGION_PATTERNS[x];
+
+		/* frame 0 warms up the caches and is not counted */
+		for (frame = 0; frame <= frames; frame++)
+		{
+			if (frame == 1)
+			{
+				stopwatch_reset(sequentialSw);
+				stopwatch_reset(batchSw);
+			}
+
+			bench_region_rects(rects, count, input, pattern, frame + 1);
+
+			if (!bench_region_frame(sequentialSw, batchSw, rects, count, &equal))
+			{
+				status = "failed";
+				rc = 2;
+				break;
+			}
+
+			if (!equal)
+			{
+				fprintf(stderr, "%s: batched %s region differs on frame %" PRIu32 "\n",
+				        input->name, pattern->name, frame);
+				errors++;
+				rc = 2;
+			}
+		}
+
+		bench_region_report(fp, format, (*reported)++, pattern, input, status, frames, count,
+		                    sequentialSw, batchSw, errors);
+		fflush(fp);
+	}
+
+out:
+	stopwatch_free(sequentialSw);
+	stopwatch_free(batchSw);
+	free(rects);
+	return rc;
+}
+
+static const BENCH_CODEC* bench_find_codec(const char* name)
+{
+	size_t x;
+
+	for (x = 0; x < ARRAYSIZE(BENCH_CODECS); x++)
+	{
+		if (_stricmp(BENCH_CODECS[x].name, name) == 0)
+			return &BENCH_CODECS[x];
+	}
+
+	return NULL;
+}
+
+static void usage_and_exit(int code)
+{
+	size_t x;
+	printf("freerdp-codec-bench: FreeRDP codec benchmark\n");
+	printf("Usage: freerdp-codec-bench [-c <codec>[,<codec>...]] [-n <frames>] [-s <chunk size>] "
+	       "[-m <match level>] [-t] [-r] [-f <_text_,csv,json>] [-o <file>] [file...]\n");
+	printf("Images (.bmp, .png) are used by image codecs, any other file by bulk compressors.\n");
+	printf("Without files a synthetic desktop frame is used.\n");
+	printf("-t times the RemoteFX tile kernels of every instruction set instead of the codecs.\n");
+	printf("-r compares sequential and batched damage region merging instead of the codecs.\n");
+	printf("Codecs:");
+
+	for (x = 0; x < ARRAYSIZE(BENCH_CODECS); x++)
+		printf(" %s", BENCH_CODECS[x].name);
+
+	printf("\n");
+	exit(code);
+}
+
+int main(int argc, char* argv[])
+{
+	int index;
+	int rc = 1;
+	size_t x, y;
+	size_t reported = 0;
+	unsigned long frames = 20;
+	FILE* fp = stdout;
+	const char* output = NULL;
+	const char* codecList = NULL;
+	BENCH_OUTPUT_FORMAT format = BENCH_OUTPUT_TEXT;
+	BOOL selected[ARRAYSIZE(BENCH_CODECS)] = { 0 };
+	BOOL rfxSimd = FALSE;
+	BOOL regions = FALSE;
+	BENCH_INPUT* inputs = NULL;
+	size_t numInputs = 0;
+	errno = 0;
+	inputs = calloc((size_t)argc + 2, sizeof(BENCH_INPUT));
+
+	if (!inputs)
+		return 1;
+
+	for (index = 1; index < argc; index++)
+	{
+		const char* arg = argv[index];
+
+		if ((strcmp("-c", arg) == 0) || (strcmp("-n", arg) == 0) || (strcmp("-s", arg) == 0) ||
+		    (strcmp("-m", arg) == 0) || (strcmp("-f", arg) == 0) || (strcmp("-o", arg) == 0))
+		{
+			if (++index == argc)
+			{
+				printf("missing value for %s\n\n", arg);
+				usage_and_exit(1);
+			}
+
+			if (strcmp("-c", arg) == 0)
+				codecList = argv[index];
+			else if (strcmp("-o", arg) == 0)
+				output = argv[index];
+			else if (strcmp("-n", arg) == 0)
+			{
+				frames = strtoul(argv[index], NULL, 0);
+
+				if ((frames == 0) || (errno != 0))
+					usage_and_exit(1);
+			}
+			else if (strcmp("-s", arg) == 0)
+			{
+				bench_chunk_size = strtoul(argv[index], NULL, 0);
+
+				if ((bench_chunk_size == 0) || (bench_chunk_size > BENCH_BULK_MAX_CHUNK) ||
+				    (errno != 0))
+				{
+					printf("chunk size must be between 1 and %d\n\n", BENCH_BULK_MAX_CHUNK);
+					usage_and_exit(1);
+				}
+			}
+			else if (strcmp("-m", arg) == 0)
+			{
+				bench_match_level = strtoul(argv[index], NULL, 0);
+
+				if ((bench_match_level > BULK_MATCH_LEVEL_BEST) || (errno != 0))
+				{
+					printf("match level must be between %d and %d\n\n", BULK_MATCH_LEVEL_LEGACY,
+					       BULK_MATCH_LEVEL_BEST);
+					usage_and_exit(1);
+				}
+			}
+			else if (strcmp("csv", argv[index]) == 0)
+				format = BENCH_OUTPUT_CSV;
+			else if (strcmp("json", argv[index]) == 0)
+				format = BENCH_OUTPUT_JSON;
+			else if (strcmp("text", argv[index]) == 0)
+				format = BENCH_OUTPUT_TEXT;
+			else
+				usage_and_exit(1);
+		}
+		else if (strcmp("-t", arg) == 0)
+			rfxSimd = TRUE;
+		else if (strcmp("-r", arg) == 0)
+			regions = TRUE;
+		else if ((strcmp("-h", arg) == 0) || (strcmp("--help", arg) == 0))
+			usage_and_exit(0);
+		else if (arg[0] == '-')
+		{
+			printf("unknown option %s\n\n", arg);
+			usage_and_exit(1);
+		}
+		else if (!bench_input_load(&inputs[numInputs++], arg))
+			goto fail;
+	}
+
+	if (numInputs == 0)
+	{
+		if (!bench_input_synthetic(&inputs[0], &inputs[1]))
+			goto fail;
+
+		numInputs = 2;
+	}
+
+	if (codecList)
+	{
+		size_t count = 0;
+		char** list = CommandLineParseCommaSeparatedValues(codecList, &count);
+
+		for (x = 0; x < count; x++)
+		{
+			const BENCH_CODEC* codec = bench_find_codec(list[x]);
+
+			if (!codec)
+			{
+				printf("unknown codec %s\n\n", list[x]);
+				free(list);
+				usage_and_exit(1);
+			}
+
+			selected[codec - BENCH_CODECS] = TRUE;
+		}
+
+		free(list);
+	}
+	else
+	{
+		for (x = 0; x < ARRAYSIZE(BENCH_CODECS); x++)
+			selected[x] = TRUE;
+	}
+
+	if (output && !(fp = winpr_fopen(output, "w")))
+	{
+		fprintf(stderr, "failed to create %s\n", output);
+		goto fail;
+	}
+
+	rc = 0;
+
+	if (rfxSimd)
+	{
+		bench_rfx_simd_header(fp, format);
+
+		for (y = 0; y < numInputs; y++)
+		{
+			int status;
+
+			if (inputs[y].type != BENCH_INPUT_IMAGE)
+				continue;
+
+			status = bench_rfx_simd(fp, format, &inputs[y], (UINT32)frames, &reported);
+			rc = MAX(rc, status);
+		}
+	}
+	else if (regions)
+	{
+		bench_region_header(fp, format);
+
+		for (y = 0; y < numInputs; y++)
+		{
+			int status;
+
+			if (inputs[y].type != BENCH_INPUT_IMAGE)
+				continue;
+
+			status = bench_region(fp, format, &inputs[y], (UINT32)frames, &reported);
+			rc = MAX(rc, status);
+		}
+	}
+	else
+	{
+		bench_report_header(fp, format);
+
+		for (x = 0; x < ARRAYSIZE(BENCH_CODECS); x++)
+		{
+			const BENCH_CODEC* codec = &BENCH_CODECS[x];
+
+			if (!selected[x])
+				continue;
+
+			for (y = 0; y < numInputs; y++)
+			{
+				const char* status;
+				BENCH_RESULT result = { 0 };
+
+				if (inputs[y].type != codec->input)
+					continue;
+
+				status = bench_run(codec, &inputs[y], (UINT32)frames, &result);
+				bench_report(fp, format, reported++, codec, &inputs[y], status, &result);
+				fflush(fp);
+
+				/* A missing optional backend such as H.264 is not a failure */
+				if ((strcmp(status, "failed") == 0) || (result.errors > 0))
+					rc = 2;
+
+				free(result.encodeTimes);
+				free(result.decodeTimes);
+			}
+		}
+	}
+
+	bench_report_footer(fp, format);
+
+	if (fp != stdout)
+		fclose(fp);
+
+fail:
+	for (x = 0; x < numInputs; x++)
+		bench_input_free(&inputs[x]);
+
+	free(inputs);
+	return rc;
+}
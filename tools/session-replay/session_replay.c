@@ -0,0 +1,879 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Headless Session Replay
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include <winpr/crt.h>
+#include <winpr/file.h>
+#include <winpr/stream.h>
+#include <winpr/wlog.h>
+
+#include <freerdp/freerdp.h>
+#include <freerdp/addin.h>
+#include <freerdp/client.h>
+#include <freerdp/codecs.h>
+#include <freerdp/dvc.h>
+#include <freerdp/graphics.h>
+#include <freerdp/gdi/gdi.h>
+#include <freerdp/gdi/gfx.h>
+#include <freerdp/cache/pointer.h>
+#include <freerdp/codec/color.h>
+#include <freerdp/codec/zgfx.h>
+#include <freerdp/channels/rdpgfx.h>
+#include <freerdp/utils/stopwatch.h>
+#include <freerdp/utils/session_dump.h>
+
+#define REPLAY_FORMAT PIXEL_FORMAT_BGRX32
+#define REPLAY_RDPGFX_HEADER_LENGTH 8
+
+enum _REPLAY_OUTPUT_FORMAT
+{
+	REPLAY_OUTPUT_TEXT,
+	REPLAY_OUTPUT_CSV,
+	REPLAY_OUTPUT_JSON
+};
+typedef enum _REPLAY_OUTPUT_FORMAT REPLAY_OUTPUT_FORMAT;
+
+struct _REPLAY_STAT
+{
+	char name[64];
+	UINT64 count;
+	UINT64 bytes;
+	UINT64 totalTime; /* microseconds */
+	UINT64 maxTime;
+	UINT64 errors;
+};
+typedef struct _REPLAY_STAT REPLAY_STAT;
+
+/* Stands in for drdynvc: the rdpgfx plugin only needs a listener and a
+ * channel to write its acknowledgements to, which are dropped. */
+struct _REPLAY_DVC
+{
+	IDRDYNVC_ENTRY_POINTS entryPoints;
+	IWTSVirtualChannelManager manager;
+	IWTSVirtualChannel channel;
+	IWTSListener listener;
+	IWTSListenerCallback* listenerCallback;
+	IWTSVirtualChannelCallback* channelCallback;
+	IWTSPlugin* plugin;
+	rdpSettings* settings;
+	ZGFX_CONTEXT* zgfx;
+};
+typedef struct _REPLAY_DVC REPLAY_DVC;
+
+struct _REPLAY_CONTEXT
+{
+	rdpClientContext common;
+
+	BOOL painted;
+	UINT64 frames;
+	REPLAY_DVC* dvc;
+	STOPWATCH* sw;
+	REPLAY_STAT* stats;
+	size_t numStats;
+	size_t maxStats;
+};
+typedef struct _REPLAY_CONTEXT replayContext;
+
+static const char* const FASTPATH_UPDATE_NAMES[] = {
+	"orders",    "bitmap",  "palette", "synchronize",   "surfcmds", "ptr_null",     "ptr_default",
+	"unknown_7", "ptr_pos", "color",   "cached_cursor", "pointer",  "large_pointer"
+};
+
+static const char* const RDPGFX_CMD_NAMES[] = { "unused_0000",
+	                                            "wiretosurface1",
+	                                            "wiretosurface2",
+	                                            "deleteencodingcontext",
+	                                            "solidfill",
+	                                            "surfacetosurface",
+	                                            "surfacetocache",
+	                                            "cachetosurface",
+	                                            "evictcacheentry",
+	                                            "createsurface",
+	                                            "deletesurface",
+	                                            "startframe",
+	                                            "endframe",
+	                                            "frameacknowledge",
+	                                            "resetgraphics",
+	                                            "mapsurfacetooutput",
+	                                            "cacheimportoffer",
+	                                            "cacheimportreply",
+	                                            "capsadvertise",
+	                                            "capsconfirm",
+	                                            "unused_0014",
+	                                            "mapsurfacetowindow",
+	                                            "qoeframeacknowledge",
+	                                            "mapsurfacetoscaledoutput",
+	                                            "mapsurfacetoscaledwindow" };
+
+static const char* replay_codec_name(UINT16 codecId)
+{
+	switch (codecId)
+	{
+		case RDPGFX_CODECID_UNCOMPRESSED:
+			return "uncompressed";
+		case RDPGFX_CODECID_CAVIDEO:
+			return "remotefx";
+		case RDPGFX_CODECID_CLEARCODEC:
+			return "clear";
+		case RDPGFX_CODECID_CAPROGRESSIVE:
+			return "progressive";
+		case RDPGFX_CODECID_PLANAR:
+			return "planar";
+		case RDPGFX_CODECID_AVC420:
+			return "avc420";
+		case RDPGFX_CODECID_ALPHA:
+			return "alpha";
+		case RDPGFX_CODECID_CAPROGRESSIVE_V2:
+			return "progressive_v2";
+		case RDPGFX_CODECID_AVC444:
+			return "avc444";
+		case RDPGFX_CODECID_AVC444v2:
+			return "avc444v2";
+		default:
+			return "unknown";
+	}
+}
+
+static UINT64 replay_elapsed(const STOPWATCH* sw)
+{
+	return sw->end - sw->start;
+}
+
+static BOOL replay_record(replayContext* replay, const char* name, size_t bytes, UINT64 time,
+                          BOOL success)
+{
+	size_t x;
+	REPLAY_STAT* stat = NULL;
+
+	for (x = 0; x < replay->numStats; x++)
+	{
+		if (strcmp(replay->stats[x].name, name) == 0)
+		{
+			stat = &replay->stats[x];
+			break;
+		}
+	}
+
+	if (!stat)
+	{
+		if (replay->numStats == replay->maxStats)
+		{
+			size_t maxStats = replay->maxStats ? replay->maxStats * 2 : 32;
+			REPLAY_STAT* stats = realloc(replay->stats, maxStats * sizeof(REPLAY_STAT));
+
+			if (!stats)
+				return FALSE;
+
+			replay->stats = stats;
+			replay->maxStats = maxStats;
+		}
+
+		stat = &replay->stats[replay->numStats++];
+		ZeroMemory(stat, sizeof(REPLAY_STAT));
+		sprintf_s(stat->name, sizeof(stat->name), "%s", name);
+	}
+
+	stat->count++;
+	stat->bytes += bytes;
+	stat->totalTime += time;
+	stat->maxTime = MAX(stat->maxTime, time);
+
+	if (!success)
+		stat->errors++;
+
+	return TRUE;
+}
+
+/* Update callbacks */
+
+static BOOL replay_begin_paint(rdpContext* context)
+{
+	rdpGdi* gdi = context->gdi;
+	gdi->primary->hdc->hwnd->invalid->null = TRUE;
+	return TRUE;
+}
+
+static BOOL replay_end_paint(rdpContext* context)
+{
+	rdpGdi* gdi = context->gdi;
+	replayContext* replay = (replayContext*)context;
+
+	if (!gdi->primary->hdc->hwnd->invalid->null)
+		replay->painted = TRUE;
+
+	return TRUE;
+}
+
+static BOOL replay_desktop_resize(rdpContext* context)
+{
+	rdpSettings* settings = context->settings;
+
+	if (!gdi_resize(context->gdi, settings->DesktopWidth, settings->DesktopHeight))
+		return FALSE;
+
+	return freerdp_client_codecs_reset(context->codecs, FREERDP_CODEC_ALL, settings->DesktopWidth,
+	                                   settings->DesktopHeight);
+}
+
+/* Converts the cursor like a windowed client does, without a window to show it in */
+static BOOL replay_pointer_new(rdpContext* context, rdpPointer* pointer)
+{
+	BOOL rc;
+	BYTE* data;
+
+	if ((pointer->width == 0) || (pointer->height == 0))
+		return TRUE;
+
+	data = (BYTE*)_aligned_malloc(pointer->width * pointer->height * 4ULL, 16);
+
+	if (!data)
+		return FALSE;
+
+	rc = freerdp_image_copy_from_pointer_data(
+	    data, PIXEL_FORMAT_BGRA32, 0, 0, 0, pointer->width, pointer->height, pointer->xorMaskData,
+	    pointer->lengthXorMask, pointer->andMaskData, pointer->lengthAndMask, pointer->xorBpp,
+	    &context->gdi->palette);
+	_aligned_free(data);
+	return rc;
+}
+
+static BOOL replay_setup(replayContext* replay, wStream* s)
+{
+	UINT32 width, height, colorDepth;
+	rdpPointer pointer = { 0 };
+	rdpContext* context = &replay->common.context;
+	freerdp* instance = context->instance;
+	rdpSettings* settings = context->settings;
+
+	if (Stream_GetRemainingLength(s) < 12)
+		return FALSE;
+
+	Stream_Read_UINT32(s, width);
+	Stream_Read_UINT32(s, height);
+	Stream_Read_UINT32(s, colorDepth);
+
+	if (context->gdi)
+	{
+		settings->DesktopWidth = width;
+		settings->DesktopHeight = height;
+		return replay_desktop_resize(context);
+	}
+
+	if (!freerdp_settings_set_uint32(settings, FreeRDP_DesktopWidth, width) ||
+	    !freerdp_settings_set_uint32(settings, FreeRDP_DesktopHeight, height) ||
+	    !freerdp_settings_set_uint32(settings, FreeRDP_ColorDepth, colorDepth) ||
+	    !freerdp_settings_set_bool(settings, FreeRDP_SoftwareGdi, TRUE))
+		return FALSE;
+
+	/* Created by the connection sequence otherwise */
+	if (!(context->codecs = codecs_new(context)))
+		return FALSE;
+
+	if (!gdi_init(instance, REPLAY_FORMAT))
+		return FALSE;
+
+	if (!freerdp_client_codecs_prepare(context->codecs, FREERDP_CODEC_ALL, width, height))
+		return FALSE;
+
+	pointer.size = sizeof(rdpPointer);
+	pointer.New = replay_pointer_new;
+	graphics_register_pointer(context->graphics, &pointer);
+	pointer_cache_register_callbacks(instance->update);
+	instance->update->BeginPaint = replay_begin_paint;
+	instance->update->EndPaint = replay_end_paint;
+	instance->update->DesktopResize = replay_desktop_resize;
+	return TRUE;
+}
+
+/* Fastpath */
+
+static BOOL replay_fastpath(replayContext* replay, wStream* s)
+{
+	BOOL rc = TRUE;
+	rdpContext* context = &replay->common.context;
+
+	/* Every update is replayed on its own to time it, fragments and the
+	 * bulk decompressor history are carried over by the fastpath state. */
+	while (Stream_GetRemainingLength(s) >= 3)
+	{
+		BYTE header;
+		UINT16 size;
+		BOOL success;
+		wStream update;
+		char name[64];
+		const BYTE* start = Stream_Pointer(s);
+		Stream_Read_UINT8(s, header);
+
+		if (((header >> 6) & 0x03) == 0x02) /* FASTPATH_OUTPUT_COMPRESSION_USED */
+			Stream_Seek_UINT8(s);
+
+		if (Stream_GetRemainingLength(s) < 2)
+			return FALSE;
+
+		Stream_Read_UINT16(s, size);
+
+		if (Stream_GetRemainingLength(s) < size)
+			return FALSE;
+
+		Stream_Seek(s, size);
+		Stream_StaticInit(&update, (BYTE*)start, (size_t)(Stream_Pointer(s) - start));
+		stopwatch_start(replay->sw);
+		success = freerdp_session_replay_fastpath(context, &update) >= 0;
+		stopwatch_stop(replay->sw);
+		sprintf_s(name, sizeof(name), "fastpath/%s",
+		          ((header & 0x0F) < ARRAYSIZE(FASTPATH_UPDATE_NAMES))
+		              ? FASTPATH_UPDATE_NAMES[header & 0x0F]
+		              : "unknown");
+
+		if (!replay_record(replay, name, Stream_Length(&update), replay_elapsed(replay->sw),
+		                   success))
+			return FALSE;
+
+		rc &= success;
+	}
+
+	return rc;
+}
+
+/* Graphics pipeline */
+
+static UINT replay_dvc_register_plugin(IDRDYNVC_ENTRY_POINTS* pEntryPoints, const char* name,
+                                       IWTSPlugin* pPlugin)
+{
+	REPLAY_DVC* dvc = (REPLAY_DVC*)pEntryPoints;
+	WINPR_UNUSED(name);
+	dvc->plugin = pPlugin;
+	return CHANNEL_RC_OK;
+}
+
+static IWTSPlugin* replay_dvc_get_plugin(IDRDYNVC_ENTRY_POINTS* pEntryPoints, const char* name)
+{
+	REPLAY_DVC* dvc = (REPLAY_DVC*)pEntryPoints;
+	WINPR_UNUSED(name);
+	return dvc->plugin;
+}
+
+static ADDIN_ARGV* replay_dvc_get_plugin_data(IDRDYNVC_ENTRY_POINTS* pEntryPoints)
+{
+	WINPR_UNUSED(pEntryPoints);
+	return NULL;
+}
+
+static void* replay_dvc_get_rdp_settings(IDRDYNVC_ENTRY_POINTS* pEntryPoints)
+{
+	REPLAY_DVC* dvc = (REPLAY_DVC*)pEntryPoints;
+	return dvc->settings;
+}
+
+static UINT replay_dvc_create_listener(IWTSVirtualChannelManager* pChannelMgr,
+                                       const char* pszChannelName, ULONG ulFlags,
+                                       IWTSListenerCallback* pListenerCallback,
+                                       IWTSListener** ppListener)
+{
+	REPLAY_DVC* dvc = (REPLAY_DVC*)((BYTE*)pChannelMgr - offsetof(REPLAY_DVC, manager));
+	WINPR_UNUSED(pszChannelName);
+	WINPR_UNUSED(ulFlags);
+	dvc->listenerCallback = pListenerCallback;
+	*ppListener = &dvc->listener;
+	return CHANNEL_RC_OK;
+}
+
+static UINT replay_dvc_destroy_listener(IWTSVirtualChannelManager* pChannelMgr,
+                                        IWTSListener* pListener)
+{
+	WINPR_UNUSED(pChannelMgr);
+	WINPR_UNUSED(pListener);
+	return CHANNEL_RC_OK;
+}
+
+static UINT replay_dvc_write(IWTSVirtualChannel* pChannel, ULONG cbSize, const BYTE* pBuffer,
+                             void* pReserved)
+{
+	WINPR_UNUSED(pChannel);
+	WINPR_UNUSED(cbSize);
+	WINPR_UNUSED(pBuffer);
+	WINPR_UNUSED(pReserved);
+	return CHANNEL_RC_OK;
+}
+
+static void replay_dvc_free(replayContext* replay)
+{
+	REPLAY_DVC* dvc = replay->dvc;
+
+	if (!dvc)
+		return;
+
+	if (dvc->channelCallback)
+		dvc->channelCallback->OnClose(dvc->channelCallback);
+
+	if (dvc->plugin)
+	{
+		gdi_graphics_pipeline_uninit(replay->common.context.gdi,
+		                             (RdpgfxClientContext*)dvc->plugin->pInterface);
+		dvc->plugin->Terminated(dvc->plugin);
+	}
+
+	zgfx_context_free(dvc->zgfx);
+	free(dvc);
+	replay->dvc = NULL;
+}
+
+static BOOL replay_dvc_new(replayContext* replay)
+{
+	UINT error;
+	BOOL accept = TRUE;
+	PDVC_PLUGIN_ENTRY entry;
+	REPLAY_DVC* dvc;
+	rdpContext* context = &replay->common.context;
+	dvc = (REPLAY_DVC*)calloc(1, sizeof(REPLAY_DVC));
+
+	if (!dvc)
+		return FALSE;
+
+	replay->dvc = dvc;
+	dvc->settings = context->settings;
+	dvc->entryPoints.RegisterPlugin = replay_dvc_register_plugin;
+	dvc->entryPoints.GetPlugin = replay_dvc_get_plugin;
+	dvc->entryPoints.GetPluginData = replay_dvc_get_plugin_data;
+	dvc->entryPoints.GetRdpSettings = replay_dvc_get_rdp_settings;
+	dvc->manager.CreateListener = replay_dvc_create_listener;
+	dvc->manager.DestroyListener = replay_dvc_destroy_listener;
+	dvc->channel.Write = replay_dvc_write;
+	dvc->zgfx = zgfx_context_new(FALSE);
+
+	if (!dvc->zgfx)
+		return FALSE;
+
+	entry = (PDVC_PLUGIN_ENTRY)freerdp_load_channel_addin_entry("rdpgfx", NULL, NULL,
+	                                                            FREERDP_ADDIN_CHANNEL_DYNAMIC);
+
+	if (!entry)
+	{
+		fprintf(stderr, "the rdpgfx channel is not available\n");
+		return FALSE;
+	}
+
+	if ((entry(&dvc->entryPoints) != CHANNEL_RC_OK) || !dvc->plugin)
+		return FALSE;
+
+	if (dvc->plugin->Initialize(dvc->plugin, &dvc->manager) != CHANNEL_RC_OK)
+		return FALSE;
+
+	if (!gdi_graphics_pipeline_init(context->gdi, (RdpgfxClientContext*)dvc->plugin->pInterface))
+		return FALSE;
+
+	error = dvc->listenerCallback->OnNewChannelConnection(
+	    dvc->listenerCallback, &dvc->channel, NULL, &accept, &dvc->channelCallback);
+
+	if ((error != CHANNEL_RC_OK) || !accept || !dvc->channelCallback)
+		return FALSE;
+
+	return dvc->channelCallback->OnOpen(dvc->channelCallback) == CHANNEL_RC_OK;
+}
+
+/* Wraps a single decompressed RDPGFX PDU into uncompressed zgfx segments so
+ * that it takes the regular channel receive path. */
+static BOOL replay_gfx_wrap(wStream* s, const BYTE* data, size_t length)
+{
+	size_t offset;
+	const size_t segments = (length + ZGFX_SEGMENTED_MAXSIZE - 1) / ZGFX_SEGMENTED_MAXSIZE;
+
+	Stream_SetPosition(s, 0);
+
+	if (!Stream_EnsureCapacity(s, length + 7 + segments * 5))
+		return FALSE;
+
+	if (segments <= 1)
+	{
+		Stream_Write_UINT8(s, ZGFX_SEGMENTED_SINGLE);
+		Stream_Write_UINT8(s, ZGFX_PACKET_COMPR_TYPE_RDP8);
+		Stream_Write(s, data, length);
+	}
+	else
+	{
+		Stream_Write_UINT8(s, ZGFX_SEGMENTED_MULTIPART);
+		Stream_Write_UINT16(s, (UINT16)segments);
+		Stream_Write_UINT32(s, (UINT32)length);
+
+		for (offset = 0; offset < length; offset += ZGFX_SEGMENTED_MAXSIZE)
+		{
+			const size_t size = MIN(ZGFX_SEGMENTED_MAXSIZE, length - offset);
+			Stream_Write_UINT32(s, (UINT32)size + 1);
+			Stream_Write_UINT8(s, ZGFX_PACKET_COMPR_TYPE_RDP8);
+			Stream_Write(s, &data[offset], size);
+		}
+	}
+
+	Stream_SealLength(s);
+	Stream_SetPosition(s, 0);
+	return TRUE;
+}
+
+static BOOL replay_gfx(replayContext* replay, wStream* s, wStream* pdu)
+{
+	int status;
+	size_t offset;
+	BYTE* pDstData = NULL;
+	UINT32 DstSize = 0;
+	BOOL rc = FALSE;
+
+	if (!replay->dvc && !replay_dvc_new(replay))
+		return FALSE;
+
+	/* The channel data is decompressed up front and each PDU is then replayed
+	 * on its own, so that decode time is attributed per command and codec. */
+	stopwatch_start(replay->sw);
+	status = zgfx_decompress(replay->dvc->zgfx, Stream_Pointer(s),
+	                         (UINT32)Stream_GetRemainingLength(s), &pDstData, &DstSize, 0);
+	stopwatch_stop(replay->sw);
+
+	if (!replay_record(replay, "gfx/zgfx", Stream_GetRemainingLength(s),
+	                   replay_elapsed(replay->sw), status >= 0) ||
+	    (status < 0))
+		goto fail;
+
+	for (offset = 0; offset + REPLAY_RDPGFX_HEADER_LENGTH <= DstSize;)
+	{
+		UINT error;
+		UINT16 cmdId;
+		UINT32 pduLength;
+		char name[64];
+		wStream header;
+		Stream_StaticInit(&header, &pDstData[offset], DstSize - offset);
+		Stream_Read_UINT16(&header, cmdId);
+		Stream_Seek_UINT16(&header); /* flags */
+		Stream_Read_UINT32(&header, pduLength);
+
+		if ((pduLength < REPLAY_RDPGFX_HEADER_LENGTH) || (pduLength > DstSize - offset))
+			goto fail;
+
+		if (!replay_gfx_wrap(pdu, &pDstData[offset], pduLength))
+			goto fail;
+
+		if (((cmdId == RDPGFX_CMDID_WIRETOSURFACE_1) || (cmdId == RDPGFX_CMDID_WIRETOSURFACE_2)) &&
+		    (pduLength >= REPLAY_RDPGFX_HEADER_LENGTH + 4))
+		{
+			UINT16 codecId;
+			Stream_Seek_UINT16(&header); /* surfaceId */
+			Stream_Read_UINT16(&header, codecId);
+			sprintf_s(name, sizeof(name), "gfx/%s/%s", RDPGFX_CMD_NAMES[cmdId],
+			          replay_codec_name(codecId));
+		}
+		else
+			sprintf_s(name, sizeof(name), "gfx/%s",
+			          (cmdId < ARRAYSIZE(RDPGFX_CMD_NAMES)) ? RDPGFX_CMD_NAMES[cmdId] : "unknown");
+
+		stopwatch_start(replay->sw);
+		error = replay->dvc->channelCallback->OnDataReceived(replay->dvc->channelCallback, pdu);
+		stopwatch_stop(replay->sw);
+
+		if (!replay_record(replay, name, pduLength, replay_elapsed(replay->sw),
+		                   error == CHANNEL_RC_OK))
+			goto fail;
+
+		offset += pduLength;
+	}
+
+	rc = TRUE;
+fail:
+	free(pDstData);
+	return rc;
+}
+
+/* Report */
+
+static void replay_report(FILE* fp, REPLAY_OUTPUT_FORMAT format, const replayContext* replay,
+                          UINT64 duration)
+{
+	size_t x;
+	UINT64 decodeTime = 0;
+	double fps;
+
+	for (x = 0; x < replay->numStats; x++)
+	{
+		/* zgfx is timed separately from the PDUs it carries */
+		decodeTime += replay->stats[x].totalTime;
+	}
+
+	fps = decodeTime ? replay->frames * 1000000.0 / decodeTime : 0.0;
+
+	switch (format)
+	{
+		case REPLAY_OUTPUT_CSV:
+			fprintf(fp, "type,count,bytes,total_us,avg_us,max_us,errors\n");
+			break;
+
+		case REPLAY_OUTPUT_JSON:
+			fprintf(fp, "{\n  \"types\": [");
+			break;
+
+		default:
+			fprintf(fp, "%-40s %8s %12s %12s %10s %10s %6s\n", "type", "count", "bytes",
+			        "total us", "avg us", "max us", "errors");
+			break;
+	}
+
+	for (x = 0; x < replay->numStats; x++)
+	{
+		const REPLAY_STAT* stat = &replay->stats[x];
+		const double avg = stat->count ? (double)stat->totalTime / stat->count : 0.0;
+
+		switch (format)
+		{
+			case REPLAY_OUTPUT_CSV:
+				fprintf(fp,
+				        "%s,%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%.1f,%" PRIu64 ",%" PRIu64 "\n",
+				        stat->name, stat->count, stat->bytes, stat->totalTime, avg, stat->maxTime,
+				        stat->errors);
+				break;
+
+			case REPLAY_OUTPUT_JSON:
+				fprintf(fp,
+				        "%s\n    { \"type\": \"%s\", \"count\": %" PRIu64 ", \"bytes\": %" PRIu64
+				        ", \"total_us\": %" PRIu64 ", \"avg_us\": %.1f, \"max_us\": %" PRIu64
+				        ", \"errors\": %" PRIu64 " }",
+				        (x > 0) ? "," : "", stat->name, stat->count, stat->bytes,
+				        stat->totalTime, avg, stat->maxTime, stat->errors);
+				break;
+
+			default:
+				fprintf(fp,
+				        "%-40s %8" PRIu64 " %12" PRIu64 " %12" PRIu64 " %10.1f %10" PRIu64
+				        " %6" PRIu64 "\n",
+				        stat->name, stat->count, stat->bytes, stat->totalTime, avg, stat->maxTime,
+				        stat->errors);
+				break;
+		}
+	}
+
+	switch (format)
+	{
+		case REPLAY_OUTPUT_CSV:
+			fprintf(fp, "frames,%" PRIu64 "\ndecode_us,%" PRIu64 "\nfps,%.1f\ncapture_us,%" PRIu64
+			            "\n",
+			        replay->frames, decodeTime, fps, duration);
+			break;
+
+		case REPLAY_OUTPUT_JSON:
+			fprintf(fp,
+			        "\n  ],\n  \"frames\": %" PRIu64 ",\n  \"decode_us\": %" PRIu64
+			        ",\n  \"fps\": %.1f,\n  \"capture_us\": %" PRIu64 "\n}\n",
+			        replay->frames, decodeTime, fps, duration);
+			break;
+
+		default:
+			fprintf(fp,
+			        "\n%" PRIu64 " frames decoded in %.3f s (%.1f fps sustained), capture %.3f s\n",
+			        replay->frames, decodeTime / 1000000.0, fps, duration / 1000000.0);
+			break;
+	}
+}
+
+static BOOL replay_run(replayContext* replay, rdpSessionDump* dump, UINT64* duration)
+{
+	BYTE type;
+	BOOL rc = FALSE;
+	UINT64 timestamp;
+	UINT64 first = 0;
+	size_t records = 0;
+	wStream* s = Stream_New(NULL, 4096);
+	wStream* pdu = Stream_New(NULL, 4096);
+
+	if (!s || !pdu)
+		goto fail;
+
+	while (session_dump_read(dump, &type, s, &timestamp))
+	{
+		BOOL success;
+
+		if (records++ == 0)
+		{
+			first = timestamp;
+
+			if (type != SESSION_DUMP_DESKTOP)
+			{
+				fprintf(stderr, "session dump does not start with the desktop size\n");
+				goto fail;
+			}
+		}
+
+		*duration = timestamp - first;
+		replay->painted = FALSE;
+
+		switch (type)
+		{
+			case SESSION_DUMP_DESKTOP:
+				success = replay_setup(replay, s);
+				break;
+
+			case SESSION_DUMP_FASTPATH:
+				success = replay_fastpath(replay, s);
+				break;
+
+			case SESSION_DUMP_GFX:
+				success = replay_gfx(replay, s, pdu);
+				break;
+
+			default:
+				/* Newer record types are skipped */
+				success = TRUE;
+				break;
+		}
+
+		if (!success)
+		{
+			fprintf(stderr, "failed to replay record %" PRIuz " (type %" PRIu8 ")\n", records,
+			        type);
+
+			/* Without a desktop there is nothing to decode to */
+			if (type == SESSION_DUMP_DESKTOP)
+				goto fail;
+		}
+
+		if (replay->painted)
+			replay->frames++;
+	}
+
+	rc = records > 0;
+fail:
+	Stream_Free(pdu, TRUE);
+	Stream_Free(s, TRUE);
+	return rc;
+}
+
+static void usage_and_exit(int code)
+{
+	printf("freerdp-session-replay: FreeRDP headless session replay\n");
+	printf("Usage: freerdp-session-replay [-f <_text_,csv,json>] [-o <file>] <session dump>\n");
+	printf("Session dumps are recorded with the /dump-session:<file> client option.\n");
+	exit(code);
+}
+
+int main(int argc, char* argv[])
+{
+	int index;
+	int rc = 1;
+	UINT64 duration = 0;
+	FILE* fp = stdout;
+	const char* output = NULL;
+	const char* input = NULL;
+	REPLAY_OUTPUT_FORMAT format = REPLAY_OUTPUT_TEXT;
+	RDP_CLIENT_ENTRY_POINTS clientEntryPoints = { 0 };
+	rdpSessionDump* dump = NULL;
+	rdpContext* context = NULL;
+	replayContext* replay;
+
+	for (index = 1; index < argc; index++)
+	{
+		const char* arg = argv[index];
+
+		if ((strcmp("-f", arg) == 0) || (strcmp("-o", arg) == 0))
+		{
+			if (++index == argc)
+			{
+				printf("missing value for %s\n\n", arg);
+				usage_and_exit(1);
+			}
+
+			if (strcmp("-o", arg) == 0)
+				output = argv[index];
+			else if (strcmp("csv", argv[index]) == 0)
+				format = REPLAY_OUTPUT_CSV;
+			else if (strcmp("json", argv[index]) == 0)
+				format = REPLAY_OUTPUT_JSON;
+			else if (strcmp("text", argv[index]) == 0)
+				format = REPLAY_OUTPUT_TEXT;
+			else
+				usage_and_exit(1);
+		}
+		else if (strcmp("-h", arg) == 0)
+			usage_and_exit(0);
+		else if (!input)
+			input = arg;
+		else
+			usage_and_exit(1);
+	}
+
+	if (!input)
+		usage_and_exit(1);
+
+	/* Informational logging goes to stdout and would be part of the timings */
+	if (!getenv("WLOG_LEVEL"))
+		WLog_SetLogLevel(WLog_GetRoot(), WLOG_WARN);
+
+	if (!(dump = session_dump_open(input, FALSE)))
+		return 1;
+
+	clientEntryPoints.Size = sizeof(RDP_CLIENT_ENTRY_POINTS);
+	clientEntryPoints.Version = RDP_CLIENT_INTERFACE_VERSION;
+	clientEntryPoints.ContextSize = sizeof(replayContext);
+	context = freerdp_client_context_new(&clientEntryPoints);
+
+	if (!context)
+		goto fail;
+
+	replay = (replayContext*)context;
+
+	if (!(replay->sw = stopwatch_create()))
+		goto fail;
+
+	rc = 2;
+
+	if (!replay_run(replay, dump, &duration))
+		goto fail;
+
+	if (output && !(fp = winpr_fopen(output, "w")))
+	{
+		fprintf(stderr, "failed to create %s\n", output);
+		rc = 1;
+		goto fail;
+	}
+
+	replay_report(fp, format, replay, duration);
+	rc = 0;
+
+	for (index = 0; index < (int)replay->numStats; index++)
+	{
+		if (replay->stats[index].errors > 0)
+			rc = 2;
+	}
+
+	if (fp != stdout)
+		fclose(fp);
+
+fail:
+	if (context)
+	{
+		replay = (replayContext*)context;
+		replay_dvc_free(replay);
+		gdi_free(context->instance);
+		codecs_free(context->codecs);
+		context->codecs = NULL;
+		stopwatch_free(replay->sw);
+		free(replay->stats);
+		freerdp_client_context_free(context);
+	}
+
+	session_dump_close(dump);
+	return rc;
+}
@@ -412,6 +412,12 @@ extern "C"
 
 	/* StreamPool */
 
+	/* StreamPool_NewEx flags */
+#define STREAMPOOL_SYNCHRONIZED 0x00000001 /* lock the pool, like StreamPool_New(TRUE, ...) */
+#define STREAMPOOL_SIZE_CLASSES 0x00000002 /* power of two size classes, lock free, thread safe */
+
+	typedef struct _wStreamPoolSizeClasses wStreamPoolSizeClasses;
+
 	struct _wStreamPool
 	{
 		int aSize;
@@ -425,6 +431,9 @@ extern "C"
 		CRITICAL_SECTION lock;
 		BOOL synchronized;
 		size_t defaultSize;
+
+		DWORD flags;
+		wStreamPoolSizeClasses* sizeClasses;
 	};
 
 	WINPR_API wStream* StreamPool_Take(wStreamPool* pool, size_t size);
@@ -440,6 +449,7 @@ extern "C"
 	WINPR_API void StreamPool_Clear(wStreamPool* pool);
 
 	WINPR_API wStreamPool* StreamPool_New(BOOL synchronized, size_t defaultSize);
+	WINPR_API wStreamPool* StreamPool_NewEx(DWORD flags, size_t defaultSize);
 	WINPR_API void StreamPool_Free(wStreamPool* pool);
 
 #ifdef __cplusplus
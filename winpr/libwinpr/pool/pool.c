@@ -51,111 +51,358 @@ static BOOL CALLBACK init_module(PINIT_ONCE once, PVOID param, PVOID* context)
 #endif
 
 static TP_POOL DEFAULT_POOL = {
-	0,    /* DWORD Minimum */
-	500,  /* DWORD Maximum */
-	NULL, /* wArrayList* Threads */
-	NULL, /* wQueue* PendingQueue */
-	NULL, /* HANDLE TerminateEvent */
-	NULL, /* wCountdownEvent* WorkComplete */
+	0,   /* DWORD Minimum */
+	500, /* DWORD Maximum */
 };
 
+/**
+ * Every worker owns a deque of submitted work. Submissions are spread round robin, a worker
+ * runs its own deque from the front and steals from the back of the others once it is empty.
+ * Idle workers sleep on their own event and are only signalled when work arrives for them,
+ * so busy pools submit and complete callbacks without any system call.
+ * Only the first ActiveCount workers take submissions and steal. Workers beyond it after the
+ * maximum was lowered finish their own deque and park until they are needed again.
+ */
+
+struct _TP_WORKER
+{
+	PTP_POOL Pool;
+	HANDLE Thread;
+	HANDLE WakeEvent;
+	LONG volatile Idle;
+	CRITICAL_SECTION Lock; /* protects the deque */
+	PTP_WORK* Deque;
+	UINT32 Capacity; /* power of two */
+	UINT32 Head;
+	UINT32 volatile Count;
+	TP_CALLBACK_INSTANCE Instance; /* reused for every callback run by this worker */
+};
+
+static BOOL thread_pool_worker_push(TP_WORKER* worker, PTP_WORK work)
+{
+	BOOL rc = FALSE;
+
+	EnterCriticalSection(&worker->Lock);
+
+	if (worker->Count == worker->Capacity)
+	{
+		UINT32 index;
+		const UINT32 capacity = worker->Capacity * 2;
+		PTP_WORK* deque = (PTP_WORK*)calloc(capacity, sizeof(PTP_WORK));
+
+		if (!deque)
+			goto out;
+
+		for (index = 0; index < worker->Count; index++)
+			deque[index] = worker->Deque[(worker->Head + index) & (worker->Capacity - 1)];
+
+		free(worker->Deque);
+		worker->Deque = deque;
+		worker->Capacity = capacity;
+		worker->Head = 0;
+	}
+
+	worker->Deque[(worker->Head + worker->Count) & (worker->Capacity - 1)] = work;
+	worker->Count++;
+	rc = TRUE;
+out:
+	LeaveCriticalSection(&worker->Lock);
+	return rc;
+}
+
+static PTP_WORK thread_pool_worker_pop(TP_WORKER* worker, BOOL steal)
+{
+	PTP_WORK work = NULL;
+
+	/* unlocked peek, thread_pool_work_func checks again after announcing it is idle */
+	if (worker->Count == 0)
+		return NULL;
+
+	EnterCriticalSection(&worker->Lock);
+
+	if (worker->Count > 0)
+	{
+		worker->Count--;
+
+		if (steal)
+			work = worker->Deque[(worker->Head + worker->Count) & (worker->Capacity - 1)];
+		else
+		{
+			work = worker->Deque[worker->Head];
+			worker->Head = (worker->Head + 1) & (worker->Capacity - 1);
+		}
+	}
+
+	LeaveCriticalSection(&worker->Lock);
+	return work;
+}
+
+static PTP_WORK thread_pool_worker_next(TP_WORKER* worker, LONG index)
+{
+	LONG x;
+	PTP_WORK work;
+	PTP_POOL pool = worker->Pool;
+	const LONG count = InterlockedCompareExchange(&pool->ActiveCount, 0, 0);
+
+	if ((work = thread_pool_worker_pop(worker, FALSE)))
+		return work;
+
+	for (x = 1; x < count; x++)
+	{
+		if ((work = thread_pool_worker_pop(pool->Workers[(index + x) % count], TRUE)))
+			return work;
+	}
+
+	return NULL;
+}
+
+static void thread_pool_worker_set_busy(TP_WORKER* worker)
+{
+	/* a submitter may have claimed the idle flag already, it then adjusts IdleCount */
+	if (InterlockedExchange(&worker->Idle, 0))
+		InterlockedDecrement(&worker->Pool->IdleCount);
+}
+
 static DWORD WINAPI thread_pool_work_func(LPVOID arg)
 {
+	LONG index;
 	DWORD status;
-	PTP_POOL pool;
 	PTP_WORK work;
 	HANDLE events[2];
-	PTP_CALLBACK_INSTANCE callbackInstance;
-
-	pool = (PTP_POOL)arg;
+	TP_WORKER* worker = (TP_WORKER*)arg;
+	PTP_POOL pool = worker->Pool;
 
 	events[0] = pool->TerminateEvent;
-	events[1] = Queue_Event(pool->PendingQueue);
+	events[1] = worker->WakeEvent;
 
-	while (1)
-	{
-		status = WaitForMultipleObjects(2, events, FALSE, INFINITE);
+	for (index = 0; pool->Workers[index] != worker; index++)
+		;
 
-		if (status == WAIT_OBJECT_0)
-			break;
+	while (!pool->Terminate)
+	{
+		if (index >= InterlockedCompareExchange(&pool->ActiveCount, 0, 0))
+		{
+			thread_pool_worker_set_busy(worker);
 
-		if (status != (WAIT_OBJECT_0 + 1))
-			break;
+			/* PostThreadpoolWork signals a surplus worker it raced with */
+			if (!(work = thread_pool_worker_pop(worker, FALSE)))
+			{
+				status = WaitForMultipleObjects(2, events, FALSE, INFINITE);
 
-		callbackInstance = (PTP_CALLBACK_INSTANCE)Queue_Dequeue(pool->PendingQueue);
+				if (status != (WAIT_OBJECT_0 + 1))
+					break;
 
-		if (callbackInstance)
+				ResetEvent(worker->WakeEvent);
+				continue;
+			}
+		}
+		else if (!(work = thread_pool_worker_next(worker, index)))
 		{
-			work = callbackInstance->Work;
-			work->WorkCallback(callbackInstance, work->CallbackParameter, work);
-			CountdownEvent_Signal(pool->WorkComplete, 1);
-			free(callbackInstance);
+			InterlockedExchange(&worker->Idle, 1);
+			InterlockedIncrement(&pool->IdleCount);
+
+			/* work submitted before IdleCount was raised did not wake anyone */
+			work = thread_pool_worker_next(worker, index);
+
+			if (!work)
+			{
+				status = WaitForMultipleObjects(2, events, FALSE, INFINITE);
+
+				if (status != (WAIT_OBJECT_0 + 1))
+					break;
+
+				ResetEvent(worker->WakeEvent);
+			}
+
+			thread_pool_worker_set_busy(worker);
+
+			if (!work)
+				continue;
 		}
+
+		worker->Instance.Work = work;
+		work->WorkCallback(&worker->Instance, work->CallbackParameter, work);
+		CompleteThreadpoolWork(work);
 	}
 
 	ExitThread(0);
 	return 0;
 }
 
-static void threads_close(void* thread)
+BOOL PostThreadpoolWork(PTP_POOL pool, PTP_WORK work)
 {
-	WaitForSingleObject(thread, INFINITE);
-	CloseHandle(thread);
+	LONG x;
+	LONG index;
+	const LONG count = InterlockedCompareExchange(&pool->ActiveCount, 0, 0);
+
+	if (pool->Terminate || (count <= 0))
+		return FALSE;
+
+	index = (LONG)((ULONG)InterlockedIncrement(&pool->NextWorker) % (ULONG)count);
+
+	if (!thread_pool_worker_push(pool->Workers[index], work))
+		return FALSE;
+
+	/* the maximum was lowered meanwhile, the worker runs its deque before parking */
+	if (index >= InterlockedCompareExchange(&pool->ActiveCount, 0, 0))
+	{
+		SetEvent(pool->Workers[index]->WakeEvent);
+		return TRUE;
+	}
+
+	/* full barrier, pairs with the idle announcement in thread_pool_work_func */
+	if (InterlockedCompareExchange(&pool->IdleCount, 0, 0) == 0)
+		return TRUE;
+
+	for (x = 0; x < count; x++)
+	{
+		TP_WORKER* worker = pool->Workers[(index + x) % count];
+
+		if (InterlockedCompareExchange(&worker->Idle, 0, 1) == 1)
+		{
+			InterlockedDecrement(&pool->IdleCount);
+			SetEvent(worker->WakeEvent);
+			break;
+		}
+	}
+
+	return TRUE;
+}
+
+static void thread_pool_worker_free(TP_WORKER* worker)
+{
+	PTP_WORK work;
+
+	if (!worker)
+		return;
+
+	if (worker->Thread)
+	{
+		WaitForSingleObject(worker->Thread, INFINITE);
+		CloseHandle(worker->Thread);
+	}
+
+	/* dropped at shutdown, still completed so waiters and CloseThreadpoolWork return */
+	while ((work = thread_pool_worker_pop(worker, FALSE)))
+		CompleteThreadpoolWork(work);
+
+	CloseHandle(worker->WakeEvent);
+	DeleteCriticalSection(&worker->Lock);
+	free(worker->Deque);
+	free(worker);
+}
+
+static BOOL thread_pool_add_worker(PTP_POOL pool)
+{
+	TP_WORKER* worker;
+
+	if (pool->WorkerCount >= TP_POOL_MAX_WORKERS)
+		return TRUE;
+
+	if (!(worker = (TP_WORKER*)calloc(1, sizeof(TP_WORKER))))
+		return FALSE;
+
+	worker->Pool = pool;
+	worker->Capacity = 64;
+	InitializeCriticalSectionAndSpinCount(&worker->Lock, 4000);
+
+	if (!(worker->Deque = (PTP_WORK*)calloc(worker->Capacity, sizeof(PTP_WORK))))
+		goto fail;
+
+	if (!(worker->WakeEvent = CreateEvent(NULL, TRUE, FALSE, NULL)))
+		goto fail;
+
+	/* published before the thread starts, it looks itself up by index */
+	pool->Workers[pool->WorkerCount] = worker;
+
+	if (!(worker->Thread = CreateThread(NULL, 0, thread_pool_work_func, (void*)worker, 0, NULL)))
+	{
+		pool->Workers[pool->WorkerCount] = NULL;
+		goto fail;
+	}
+
+	InterlockedIncrement(&pool->WorkerCount);
+	return TRUE;
+fail:
+	thread_pool_worker_free(worker);
+	return FALSE;
+}
+
+/* called with pool->Lock held after WorkerCount or Maximum changed */
+static void thread_pool_update_active(PTP_POOL pool)
+{
+	LONG index;
+	const LONG previous = pool->ActiveCount;
+	LONG count = pool->WorkerCount;
+
+	/* a maximum of 0 still keeps one worker running */
+	if ((pool->Maximum > 0) && (pool->Maximum < (DWORD)count))
+		count = (LONG)pool->Maximum;
+	else if ((pool->Maximum == 0) && (count > 1))
+		count = 1;
+
+	InterlockedExchange(&pool->ActiveCount, count);
+
+	/* workers changing between surplus and active reevaluate their state */
+	for (index = previous; index < count; index++)
+		SetEvent(pool->Workers[index]->WakeEvent);
+
+	for (index = count; index < previous; index++)
+		SetEvent(pool->Workers[index]->WakeEvent);
+}
+
+static void thread_pool_free_workers(PTP_POOL pool)
+{
+	LONG index;
+
+	InterlockedExchange(&pool->ActiveCount, 0);
+	InterlockedExchange(&pool->Terminate, 1);
+	SetEvent(pool->TerminateEvent);
+
+	/* all threads have to be gone before the deques are drained, they steal from each other */
+	for (index = 0; index < pool->WorkerCount; index++)
+		WaitForSingleObject(pool->Workers[index]->Thread, INFINITE);
+
+	for (index = 0; index < pool->WorkerCount; index++)
+	{
+		thread_pool_worker_free(pool->Workers[index]);
+		pool->Workers[index] = NULL;
+	}
+
+	pool->WorkerCount = 0;
 }
 
 static BOOL InitializeThreadpool(PTP_POOL pool)
 {
 	int index;
-	HANDLE thread;
 
-	if (pool->Threads)
+	if (pool->TerminateEvent)
 		return TRUE;
 
 	pool->Minimum = 0;
 	pool->Maximum = 500;
-
-	if (!(pool->PendingQueue = Queue_New(TRUE, -1, -1)))
-		goto fail_queue_new;
-
-	if (!(pool->WorkComplete = CountdownEvent_New(0)))
-		goto fail_countdown_event;
+	pool->ActiveCount = 0;
+	pool->Terminate = 0;
 
 	if (!(pool->TerminateEvent = CreateEvent(NULL, TRUE, FALSE, NULL)))
-		goto fail_terminate_event;
-
-	if (!(pool->Threads = ArrayList_New(TRUE)))
-		goto fail_thread_array;
+		return FALSE;
 
-	pool->Threads->object.fnObjectFree = threads_close;
+	InitializeCriticalSectionAndSpinCount(&pool->Lock, 4000);
 
 	for (index = 0; index < 4; index++)
 	{
-		if (!(thread = CreateThread(NULL, 0, thread_pool_work_func, (void*)pool, 0, NULL)))
-		{
-			goto fail_create_threads;
-		}
-
-		if (ArrayList_Add(pool->Threads, thread) < 0)
+		if (!thread_pool_add_worker(pool))
 			goto fail_create_threads;
 	}
 
+	thread_pool_update_active(pool);
 	return TRUE;
 
 fail_create_threads:
-	SetEvent(pool->TerminateEvent);
-	ArrayList_Free(pool->Threads);
-	pool->Threads = NULL;
-fail_thread_array:
+	thread_pool_free_workers(pool);
+	DeleteCriticalSection(&pool->Lock);
 	CloseHandle(pool->TerminateEvent);
 	pool->TerminateEvent = NULL;
-fail_terminate_event:
-	CountdownEvent_Free(pool->WorkComplete);
-	pool->WorkComplete = NULL;
-fail_countdown_event:
-	Queue_Free(pool->PendingQueue);
-	pool->WorkComplete = NULL;
-fail_queue_new:
-
 	return FALSE;
 }
 
@@ -203,18 +450,12 @@ VOID winpr_CloseThreadpool(PTP_POOL ptpp)
 		return;
 	}
 #endif
-	SetEvent(ptpp->TerminateEvent);
-
-	ArrayList_Free(ptpp->Threads);
-	Queue_Free(ptpp->PendingQueue);
-	CountdownEvent_Free(ptpp->WorkComplete);
+	thread_pool_free_workers(ptpp);
+	DeleteCriticalSection(&ptpp->Lock);
 	CloseHandle(ptpp->TerminateEvent);
 
 	if (ptpp == &DEFAULT_POOL)
 	{
-		ptpp->Threads = NULL;
-		ptpp->PendingQueue = NULL;
-		ptpp->WorkComplete = NULL;
 		ptpp->TerminateEvent = NULL;
 	}
 	else
@@ -225,26 +466,27 @@ VOID winpr_CloseThreadpool(PTP_POOL ptpp)
 
 BOOL winpr_SetThreadpoolThreadMinimum(PTP_POOL ptpp, DWORD cthrdMic)
 {
-	HANDLE thread;
+	BOOL rc = TRUE;
 #ifdef _WIN32
 	InitOnceExecuteOnce(&init_once_module, init_module, NULL, NULL);
 	if (pSetThreadpoolThreadMinimum)
 		return pSetThreadpoolThreadMinimum(ptpp, cthrdMic);
 #endif
+	EnterCriticalSection(&ptpp->Lock);
 	ptpp->Minimum = cthrdMic;
 
-	while (ArrayList_Count(ptpp->Threads) < (INT64)ptpp->Minimum)
-	{
-		if (!(thread = CreateThread(NULL, 0, thread_pool_work_func, (void*)ptpp, 0, NULL)))
-		{
-			return FALSE;
-		}
+	/* like on windows a minimum above the maximum raises the maximum */
+	if (ptpp->Maximum < ptpp->Minimum)
+		ptpp->Maximum = ptpp->Minimum;
 
-		if (ArrayList_Add(ptpp->Threads, thread) < 0)
-			return FALSE;
-	}
+	/* thread_pool_add_worker stops at TP_POOL_MAX_WORKERS */
+	while (rc && (ptpp->WorkerCount < TP_POOL_MAX_WORKERS) &&
+	       ((DWORD)ptpp->WorkerCount < ptpp->Minimum))
+		rc = thread_pool_add_worker(ptpp);
 
-	return TRUE;
+	thread_pool_update_active(ptpp);
+	LeaveCriticalSection(&ptpp->Lock);
+	return rc;
 }
 
 VOID winpr_SetThreadpoolThreadMaximum(PTP_POOL ptpp, DWORD cthrdMost)
@@ -257,7 +499,15 @@ VOID winpr_SetThreadpoolThreadMaximum(PTP_POOL ptpp, DWORD cthrdMost)
 		return;
 	}
 #endif
+	EnterCriticalSection(&ptpp->Lock);
 	ptpp->Maximum = cthrdMost;
+
+	/* and a maximum below the minimum lowers the minimum */
+	if (ptpp->Minimum > ptpp->Maximum)
+		ptpp->Minimum = ptpp->Maximum;
+
+	thread_pool_update_active(ptpp);
+	LeaveCriticalSection(&ptpp->Lock);
 }
 
 #endif /* WINPR_THREAD_POOL defined */
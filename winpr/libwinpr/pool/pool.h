@@ -23,21 +23,38 @@
 #include <winpr/pool.h>
 #include <winpr/synch.h>
 #include <winpr/thread.h>
+#include <winpr/interlocked.h>
 #include <winpr/collections.h>
 
+#define TP_POOL_MAX_WORKERS 256
+
 struct _TP_CALLBACK_INSTANCE
 {
 	PTP_WORK Work;
 };
 
+typedef struct _TP_WORKER TP_WORKER;
+typedef struct _TP_WORK_WAITER TP_WORK_WAITER;
+
+/* on the stack of a thread in WaitForThreadpoolWorkCallbacks */
+struct _TP_WORK_WAITER
+{
+	HANDLE Event;
+	TP_WORK_WAITER* Next;
+};
+
 struct _TP_POOL
 {
 	DWORD Minimum;
 	DWORD Maximum;
-	wArrayList* Threads;
-	wQueue* PendingQueue;
+	CRITICAL_SECTION Lock; /* serializes adding workers and changing the limits */
+	TP_WORKER* Workers[TP_POOL_MAX_WORKERS];
+	LONG volatile WorkerCount;
+	LONG volatile ActiveCount; /* workers taking submissions, at most Maximum */
+	LONG volatile NextWorker;
+	LONG volatile IdleCount;
+	LONG volatile Terminate;
 	HANDLE TerminateEvent;
-	wCountdownEvent* WorkComplete;
 };
 
 struct _TP_WORK
@@ -45,6 +62,9 @@ struct _TP_WORK
 	PVOID CallbackParameter;
 	PTP_WORK_CALLBACK WorkCallback;
 	PTP_CALLBACK_ENVIRON CallbackEnvironment;
+	LONG volatile Pending;
+	CRITICAL_SECTION Lock; /* orders the last completion with the waiters */
+	TP_WORK_WAITER* Waiters;
 };
 
 struct _TP_TIMER
@@ -73,5 +93,7 @@ struct _TP_CLEANUP_GROUP
 };
 
 PTP_POOL GetDefaultThreadpool(void);
+BOOL PostThreadpoolWork(PTP_POOL pool, PTP_WORK work);
+void CompleteThreadpoolWork(PTP_WORK work);
 
 #endif /* WINPR_POOL_PRIVATE_H */
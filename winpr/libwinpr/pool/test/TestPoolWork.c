@@ -1,8 +1,13 @@
 
 #include <winpr/crt.h>
 #include <winpr/pool.h>
+#include <winpr/synch.h>
+#include <winpr/sysinfo.h>
 #include <winpr/interlocked.h>
 
+#define TILE_COUNT 1024
+#define TILE_FRAMES 50
+
 static LONG count = 0;
 
 static void CALLBACK test_WorkCallback(PTP_CALLBACK_INSTANCE instance, void* context, PTP_WORK work)
@@ -123,6 +128,254 @@ fail:
 	return rc;
 }
 
+static void CALLBACK test_BlockingCallback(PTP_CALLBACK_INSTANCE instance, void* context,
+                                           PTP_WORK work)
+{
+	WaitForSingleObject((HANDLE)context, INFINITE);
+}
+
+static void CALLBACK test_TileCallback(PTP_CALLBACK_INSTANCE instance, void* context,
+                                       PTP_WORK work)
+{
+	size_t index;
+	UINT32* tile = (UINT32*)context;
+
+	for (index = 1; index < 64; index++)
+		tile[index] = tile[index - 1] * 3 + 1;
+}
+
+static BOOL test3(void)
+{
+	size_t frame, index;
+	UINT64 begin, end;
+	BOOL rc = FALSE;
+	PTP_POOL pool;
+	HANDLE event = NULL;
+	PTP_WORK blocked = NULL;
+	PTP_WORK work[TILE_COUNT] = { 0 };
+	UINT32(*tiles)[64] = NULL;
+	TP_CALLBACK_ENVIRON environment;
+	printf("Per work completion\n");
+
+	if (!(pool = CreateThreadpool(NULL)))
+		return FALSE;
+
+	if (!SetThreadpoolThreadMinimum(pool, 4))
+		goto fail;
+
+	InitializeThreadpoolEnvironment(&environment);
+	SetThreadpoolCallbackPool(&environment, pool);
+
+	if (!(tiles = calloc(TILE_COUNT, sizeof(*tiles))))
+		goto fail;
+
+	/* waiting for a work object must not wait for unrelated work */
+	if (!(event = CreateEvent(NULL, TRUE, FALSE, NULL)))
+		goto fail;
+
+	if (!(blocked = CreateThreadpoolWork(test_BlockingCallback, event, &environment)))
+		goto fail;
+
+	SubmitThreadpoolWork(blocked);
+	begin = GetTickCount64();
+
+	for (frame = 0; frame < TILE_FRAMES; frame++)
+	{
+		for (index = 0; index < TILE_COUNT; index++)
+		{
+			tiles[index][0] = (UINT32)(frame + index);
+
+			if (!(work[index] = CreateThreadpoolWork(test_TileCallback, tiles[index],
+			                                         &environment)))
+				goto fail;
+
+			SubmitThreadpoolWork(work[index]);
+		}
+
+		for (index = 0; index < TILE_COUNT; index++)
+		{
+			WaitForThreadpoolWorkCallbacks(work[index], FALSE);
+			CloseThreadpoolWork(work[index]);
+			work[index] = NULL;
+
+			if (tiles[index][63] != tiles[index][62] * 3 + 1)
+				goto fail;
+		}
+	}
+
+	end = GetTickCount64();
+	printf("%d frames of %d tiles: %" PRIu64 " ms\n", TILE_FRAMES, TILE_COUNT, end - begin);
+	rc = TRUE;
+fail:
+
+	for (index = 0; index < TILE_COUNT; index++)
+	{
+		if (work[index])
+		{
+			WaitForThreadpoolWorkCallbacks(work[index], FALSE);
+			CloseThreadpoolWork(work[index]);
+		}
+	}
+
+	if (blocked)
+	{
+		SetEvent(event);
+		WaitForThreadpoolWorkCallbacks(blocked, FALSE);
+		CloseThreadpoolWork(blocked);
+	}
+
+	if (event)
+		CloseHandle(event);
+
+	free(tiles);
+	CloseThreadpool(pool);
+	return rc;
+}
+
+static LONG running = 0;
+static LONG peak = 0;
+
+static void CALLBACK test_ConcurrencyCallback(PTP_CALLBACK_INSTANCE instance, void* context,
+                                              PTP_WORK work)
+{
+	LONG current = InterlockedIncrement(&running);
+	LONG previous = peak;
+
+	while ((current > previous) &&
+	       (InterlockedCompareExchange(&peak, current, previous) != previous))
+		previous = peak;
+
+	Sleep(1);
+	InterlockedDecrement(&running);
+}
+
+static DWORD WINAPI test_WaiterThread(LPVOID arg)
+{
+	WaitForThreadpoolWorkCallbacks((PTP_WORK)arg, FALSE);
+	return 0;
+}
+
+static DWORD WINAPI test_ReleaseThread(LPVOID arg)
+{
+	Sleep(50);
+	SetEvent((HANDLE)arg);
+	return 0;
+}
+
+static BOOL test4(void)
+{
+	size_t index;
+	BOOL rc = FALSE;
+	PTP_POOL pool;
+	HANDLE event = NULL;
+	HANDLE releaser = NULL;
+	HANDLE waiters[4] = { 0 };
+	PTP_WORK work = NULL;
+	PTP_WORK blocked = NULL;
+	TP_CALLBACK_ENVIRON environment;
+	printf("Waiters, maximum and shutdown\n");
+
+	if (!(pool = CreateThreadpool(NULL)))
+		return FALSE;
+
+	if (!SetThreadpoolThreadMinimum(pool, 4))
+		goto fail;
+
+	SetThreadpoolThreadMaximum(pool, 1);
+	InitializeThreadpoolEnvironment(&environment);
+	SetThreadpoolCallbackPool(&environment, pool);
+
+	if (!(work = CreateThreadpoolWork(test_ConcurrencyCallback, NULL, &environment)))
+		goto fail;
+
+	for (index = 0; index < 32; index++)
+		SubmitThreadpoolWork(work);
+
+	/* any number of threads may wait for the same work, and close it once they returned */
+	for (index = 0; index < ARRAYSIZE(waiters); index++)
+	{
+		if (!(waiters[index] = CreateThread(NULL, 0, test_WaiterThread, work, 0, NULL)))
+			goto fail;
+	}
+
+	WaitForThreadpoolWorkCallbacks(work, FALSE);
+
+	for (index = 0; index < ARRAYSIZE(waiters); index++)
+	{
+		WaitForSingleObject(waiters[index], INFINITE);
+		CloseHandle(waiters[index]);
+		waiters[index] = NULL;
+	}
+
+	CloseThreadpoolWork(work);
+	work = NULL;
+
+	if (peak != 1)
+	{
+		printf("%" PRId32 " callbacks ran concurrently with a maximum of 1\n", peak);
+		goto fail;
+	}
+
+	/* work still queued when the pool is closed is dropped but completed */
+	if (!(event = CreateEvent(NULL, TRUE, FALSE, NULL)))
+		goto fail;
+
+	if (!(blocked = CreateThreadpoolWork(test_BlockingCallback, event, &environment)))
+		goto fail;
+
+	if (!(work = CreateThreadpoolWork(test_ConcurrencyCallback, NULL, &environment)))
+		goto fail;
+
+	SubmitThreadpoolWork(blocked);
+
+	for (index = 0; index < 32; index++)
+		SubmitThreadpoolWork(work);
+
+	if (!(releaser = CreateThread(NULL, 0, test_ReleaseThread, event, 0, NULL)))
+		goto fail;
+
+	CloseThreadpool(pool);
+	pool = NULL;
+	CloseThreadpoolWork(work);
+	CloseThreadpoolWork(blocked);
+	work = NULL;
+	blocked = NULL;
+	rc = TRUE;
+fail:
+
+	for (index = 0; index < ARRAYSIZE(waiters); index++)
+	{
+		if (waiters[index])
+		{
+			WaitForSingleObject(waiters[index], INFINITE);
+			CloseHandle(waiters[index]);
+		}
+	}
+
+	if (event)
+		SetEvent(event);
+
+	if (work)
+		CloseThreadpoolWork(work);
+
+	if (blocked)
+		CloseThreadpoolWork(blocked);
+
+	if (releaser)
+	{
+		WaitForSingleObject(releaser, INFINITE);
+		CloseHandle(releaser);
+	}
+
+	if (event)
+		CloseHandle(event);
+
+	if (pool)
+		CloseThreadpool(pool);
+
+	return rc;
+}
+
 int TestPoolWork(int argc, char* argv[])
 {
 	if (!test1())
@@ -131,5 +384,11 @@ int TestPoolWork(int argc, char* argv[])
 	if (!test2())
 		return -1;
 
+	if (!test3())
+		return -1;
+
+	if (!test4())
+		return -1;
+
 	return 0;
 }
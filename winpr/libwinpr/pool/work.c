@@ -85,6 +85,8 @@ PTP_WORK winpr_CreateThreadpoolWork(PTP_WORK_CALLBACK pfnwk, PVOID pv, PTP_CALLB
 
 	if (work)
 	{
+		InitializeCriticalSectionAndSpinCount(&work->Lock, 4000);
+
 		if (!pcbe)
 		{
 			pcbe = &DEFAULT_CALLBACK_ENVIRONMENT;
@@ -122,13 +124,15 @@ VOID winpr_CloseThreadpoolWork(PTP_WORK pwk)
 		ArrayList_Remove(pwk->CallbackEnvironment->CleanupGroup->groups, pwk);
 
 #endif
+	/* workers still reference pwk until its pending callbacks completed */
+	winpr_WaitForThreadpoolWorkCallbacks(pwk, FALSE);
+	DeleteCriticalSection(&pwk->Lock);
 	free(pwk);
 }
 
 VOID winpr_SubmitThreadpoolWork(PTP_WORK pwk)
 {
 	PTP_POOL pool;
-	PTP_CALLBACK_INSTANCE callbackInstance;
 #ifdef _WIN32
 	InitOnceExecuteOnce(&init_once_module, init_module, NULL, NULL);
 
@@ -140,13 +144,39 @@ VOID winpr_SubmitThreadpoolWork(PTP_WORK pwk)
 
 #endif
 	pool = pwk->CallbackEnvironment->Pool;
-	callbackInstance = (PTP_CALLBACK_INSTANCE)calloc(1, sizeof(TP_CALLBACK_INSTANCE));
+	InterlockedIncrement(&pwk->Pending);
+
+	if (!PostThreadpoolWork(pool, pwk))
+	{
+		WLog_ERR(TAG, "failed to post work to the thread pool");
+		CompleteThreadpoolWork(pwk);
+	}
+}
+
+/**
+ * Called once per submission after its callback ran or was dropped. The waiters are detached
+ * under the lock and signalled after leaving it: a waiter may free pwk as soon as it returns.
+ */
+void CompleteThreadpoolWork(PTP_WORK work)
+{
+	TP_WORK_WAITER* next;
+	TP_WORK_WAITER* waiter = NULL;
+
+	EnterCriticalSection(&work->Lock);
+
+	if (InterlockedDecrement(&work->Pending) == 0)
+	{
+		waiter = work->Waiters;
+		work->Waiters = NULL;
+	}
 
-	if (callbackInstance)
+	LeaveCriticalSection(&work->Lock);
+
+	while (waiter)
 	{
-		callbackInstance->Work = pwk;
-		CountdownEvent_AddCount(pool->WorkComplete, 1);
-		Queue_Enqueue(pool->PendingQueue, callbackInstance);
+		next = waiter->Next;
+		SetEvent(waiter->Event);
+		waiter = next;
 	}
 }
 
@@ -166,8 +196,7 @@ BOOL winpr_TrySubmitThreadpoolCallback(PTP_SIMPLE_CALLBACK pfns, PVOID pv,
 
 VOID winpr_WaitForThreadpoolWorkCallbacks(PTP_WORK pwk, BOOL fCancelPendingCallbacks)
 {
-	HANDLE event;
-	PTP_POOL pool;
+	TP_WORK_WAITER waiter;
 #ifdef _WIN32
 	InitOnceExecuteOnce(&init_once_module, init_module, NULL, NULL);
 
@@ -178,11 +207,31 @@ VOID winpr_WaitForThreadpoolWorkCallbacks(PTP_WORK pwk, BOOL fCancelPendingCallb
 	}
 
 #endif
-	pool = pwk->CallbackEnvironment->Pool;
-	event = CountdownEvent_WaitHandle(pool->WorkComplete);
+	/* the lock is taken even without anything pending, the last completion may still hold it */
+	EnterCriticalSection(&pwk->Lock);
+
+	if (pwk->Pending == 0)
+	{
+		LeaveCriticalSection(&pwk->Lock);
+		return;
+	}
 
-	if (WaitForSingleObject(event, INFINITE) != WAIT_OBJECT_0)
+	if (!(waiter.Event = CreateEvent(NULL, TRUE, FALSE, NULL)))
+	{
+		LeaveCriticalSection(&pwk->Lock);
+		WLog_ERR(TAG, "failed to create work completion event");
+		return;
+	}
+
+	waiter.Next = pwk->Waiters;
+	pwk->Waiters = &waiter;
+	LeaveCriticalSection(&pwk->Lock);
+
+	/* pwk is not touched after registering, the waiter is removed by CompleteThreadpoolWork */
+	if (WaitForSingleObject(waiter.Event, INFINITE) != WAIT_OBJECT_0)
 		WLog_ERR(TAG, "error waiting on work completion");
+
+	CloseHandle(waiter.Event);
 }
 
 #endif /* WINPR_THREAD_POOL defined */
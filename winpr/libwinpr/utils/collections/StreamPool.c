@@ -22,6 +22,8 @@
 #endif
 
 #include <winpr/crt.h>
+#include <winpr/thread.h>
+#include <winpr/interlocked.h>
 
 #include <winpr/collections.h>
 
@@ -139,6 +141,315 @@ static void StreamPool_ShiftAvailable(wStreamPool* pool, int index, int count)
 	}
 }
 
+/**
+ * Size class mode (STREAMPOOL_SIZE_CLASSES)
+ *
+ * Available streams are kept on lock free stacks, one set per power of two size class.
+ * Each class is split into a few stripes selected by the calling thread, threads mostly
+ * stay on their own stripe and only look at the others when it is empty. Streams live in
+ * entries that are never freed before the pool, which makes the index based stacks safe.
+ */
+
+#define STREAMPOOL_MIN_CLASS_SHIFT 8
+#define STREAMPOOL_MAX_CLASS_SHIFT 24
+#define STREAMPOOL_CLASS_COUNT (STREAMPOOL_MAX_CLASS_SHIFT - STREAMPOOL_MIN_CLASS_SHIFT + 1)
+#define STREAMPOOL_SPARE_CLASS STREAMPOOL_CLASS_COUNT /* entries without a buffer */
+#define STREAMPOOL_STRIPES 4
+#define STREAMPOOL_CHUNK_SHIFT 8
+#define STREAMPOOL_CHUNK_SIZE (1 << STREAMPOOL_CHUNK_SHIFT)
+#define STREAMPOOL_MAX_CHUNKS 1024
+
+typedef struct
+{
+	wStream s; /* first member, the pool hands out &entry->s */
+	UINT32 index;
+	volatile UINT32 next; /* index + 1 of the next available entry, 0 ends the stack */
+} wStreamPoolEntry;
+
+typedef struct
+{
+	volatile LONGLONG head; /* (tag << 32) | (index + 1), the tag changes on every update */
+	BYTE padding[64 - sizeof(LONGLONG)];
+} wStreamPoolStack;
+
+struct _wStreamPoolSizeClasses
+{
+	wStreamPoolStack stacks[STREAMPOOL_CLASS_COUNT + 1][STREAMPOOL_STRIPES];
+	wStreamPoolEntry* chunks[STREAMPOOL_MAX_CHUNKS];
+	UINT32 count; /* registered entries, protected by the pool lock */
+};
+
+static INLINE BOOL StreamPool_HasSizeClasses(wStreamPool* pool)
+{
+	return (pool->flags & STREAMPOOL_SIZE_CLASSES) ? TRUE : FALSE;
+}
+
+static INLINE wStreamPoolEntry* StreamPool_GetEntry(wStreamPoolSizeClasses* sc, UINT32 index)
+{
+	return &sc->chunks[index >> STREAMPOOL_CHUNK_SHIFT][index & (STREAMPOOL_CHUNK_SIZE - 1)];
+}
+
+static INLINE UINT32 StreamPool_GetStripe(void)
+{
+	const DWORD id = GetCurrentThreadId();
+	/* pthread ids are aligned addresses, mix in the higher bits */
+	return (id ^ (id >> 12) ^ (id >> 20)) % STREAMPOOL_STRIPES;
+}
+
+/**
+ * Smallest class holding size bytes, STREAMPOOL_CLASS_COUNT if there is none.
+ */
+
+static UINT32 StreamPool_SizeToClass(size_t size)
+{
+	UINT32 sizeClass = 0;
+
+	while ((sizeClass < STREAMPOOL_CLASS_COUNT) &&
+	       (((size_t)1 << (sizeClass + STREAMPOOL_MIN_CLASS_SHIFT)) < size))
+		sizeClass++;
+
+	return sizeClass;
+}
+
+/**
+ * Largest class fully backed by capacity bytes, STREAMPOOL_CLASS_COUNT if there is none.
+ * Streams may have grown or been given a different buffer while in use.
+ */
+
+static UINT32 StreamPool_CapacityToClass(size_t capacity)
+{
+	UINT32 sizeClass = 0;
+
+	if ((capacity < ((size_t)1 << STREAMPOOL_MIN_CLASS_SHIFT)) ||
+	    (capacity >= ((size_t)1 << (STREAMPOOL_MAX_CLASS_SHIFT + 1))))
+		return STREAMPOOL_CLASS_COUNT;
+
+	while ((sizeClass + 1 < STREAMPOOL_CLASS_COUNT) &&
+	       (((size_t)1 << (sizeClass + 1 + STREAMPOOL_MIN_CLASS_SHIFT)) <= capacity))
+		sizeClass++;
+
+	return sizeClass;
+}
+
+static void StreamPool_Push(wStreamPoolStack* stack, wStreamPoolEntry* entry)
+{
+	LONGLONG head;
+	LONGLONG update;
+
+	do
+	{
+		head = stack->head;
+		entry->next = (UINT32)(head & 0xFFFFFFFF);
+		update = (LONGLONG)(((((ULONGLONG)head >> 32) + 1) << 32) | (entry->index + 1));
+	} while (InterlockedCompareExchange64(&stack->head, update, head) != head);
+}
+
+static wStreamPoolEntry* StreamPool_Pop(wStreamPoolSizeClasses* sc, wStreamPoolStack* stack)
+{
+	UINT32 top;
+	LONGLONG head;
+	LONGLONG update;
+	wStreamPoolEntry* entry;
+
+	do
+	{
+		head = stack->head;
+		top = (UINT32)(head & 0xFFFFFFFF);
+
+		if (top == 0)
+			return NULL;
+
+		/* next may be stale if another thread got the entry first, the tag catches that */
+		entry = StreamPool_GetEntry(sc, top - 1);
+		update = (LONGLONG)(((((ULONGLONG)head >> 32) + 1) << 32) | entry->next);
+	} while (InterlockedCompareExchange64(&stack->head, update, head) != head);
+
+	return entry;
+}
+
+static wStreamPoolEntry* StreamPool_PopClass(wStreamPoolSizeClasses* sc, UINT32 sizeClass)
+{
+	UINT32 index;
+	wStreamPoolEntry* entry;
+	const UINT32 stripe = StreamPool_GetStripe();
+
+	for (index = 0; index < STREAMPOOL_STRIPES; index++)
+	{
+		entry = StreamPool_Pop(sc, &sc->stacks[sizeClass][(stripe + index) % STREAMPOOL_STRIPES]);
+
+		if (entry)
+			return entry;
+	}
+
+	return NULL;
+}
+
+static void StreamPool_PushClass(wStreamPoolSizeClasses* sc, UINT32 sizeClass,
+                                 wStreamPoolEntry* entry)
+{
+	StreamPool_Push(&sc->stacks[sizeClass][StreamPool_GetStripe()], entry);
+}
+
+static wStreamPoolEntry* StreamPool_NewEntry(wStreamPool* pool)
+{
+	UINT32 index;
+	wStreamPoolEntry* entry = NULL;
+	wStreamPoolSizeClasses* sc = pool->sizeClasses;
+
+	EnterCriticalSection(&pool->lock);
+	index = sc->count;
+
+	if ((index & (STREAMPOOL_CHUNK_SIZE - 1)) == 0)
+	{
+		const UINT32 chunk = index >> STREAMPOOL_CHUNK_SHIFT;
+
+		if (chunk >= STREAMPOOL_MAX_CHUNKS)
+			goto out;
+
+		sc->chunks[chunk] = (wStreamPoolEntry*)calloc(STREAMPOOL_CHUNK_SIZE,
+		                                              sizeof(wStreamPoolEntry));
+
+		if (!sc->chunks[chunk])
+			goto out;
+	}
+
+	entry = StreamPool_GetEntry(sc, index);
+	entry->index = index;
+	entry->s.pool = pool;
+	sc->count++;
+out:
+	LeaveCriticalSection(&pool->lock);
+	return entry;
+}
+
+static wStream* StreamPool_TakeSizeClass(wStreamPool* pool, size_t size)
+{
+	BYTE* buffer;
+	size_t capacity;
+	wStreamPoolEntry* entry;
+	wStreamPoolSizeClasses* sc = pool->sizeClasses;
+	const UINT32 sizeClass = StreamPool_SizeToClass(size);
+
+	if (sizeClass < STREAMPOOL_CLASS_COUNT)
+	{
+		entry = StreamPool_PopClass(sc, sizeClass);
+
+		if (entry)
+			goto out;
+
+		capacity = (size_t)1 << (sizeClass + STREAMPOOL_MIN_CLASS_SHIFT);
+	}
+	else
+		capacity = size;
+
+	buffer = (BYTE*)malloc(capacity);
+
+	if (!buffer)
+		return NULL;
+
+	entry = StreamPool_PopClass(sc, STREAMPOOL_SPARE_CLASS);
+
+	if (!entry)
+		entry = StreamPool_NewEntry(pool);
+
+	if (!entry)
+	{
+		free(buffer);
+		return NULL;
+	}
+
+	entry->s.buffer = buffer;
+	entry->s.capacity = capacity;
+	entry->s.isOwner = TRUE;
+	entry->s.isAllocatedStream = FALSE;
+out:
+	Stream_SetPosition(&entry->s, 0);
+	Stream_SetLength(&entry->s, Stream_Capacity(&entry->s));
+	entry->s.count = 1;
+	return &entry->s;
+}
+
+static void StreamPool_ReturnSizeClass(wStreamPool* pool, wStream* s)
+{
+	wStreamPoolEntry* entry = (wStreamPoolEntry*)s;
+	const UINT32 sizeClass = StreamPool_CapacityToClass(Stream_Capacity(s));
+
+	s->count = 0;
+
+	if (sizeClass < STREAMPOOL_CLASS_COUNT)
+	{
+		StreamPool_PushClass(pool->sizeClasses, sizeClass, entry);
+		return;
+	}
+
+	if (s->isOwner)
+		free(s->buffer);
+
+	s->buffer = s->pointer = NULL;
+	s->capacity = s->length = 0;
+	StreamPool_PushClass(pool->sizeClasses, STREAMPOOL_SPARE_CLASS, entry);
+}
+
+static wStream* StreamPool_FindSizeClass(wStreamPool* pool, BYTE* ptr)
+{
+	UINT32 index;
+	wStreamPoolSizeClasses* sc = pool->sizeClasses;
+
+	EnterCriticalSection(&pool->lock);
+
+	for (index = 0; index < sc->count; index++)
+	{
+		wStream* s = &StreamPool_GetEntry(sc, index)->s;
+
+		if ((s->count > 0) && (ptr >= Stream_Buffer(s)) &&
+		    (ptr < (Stream_Buffer(s) + Stream_Capacity(s))))
+		{
+			LeaveCriticalSection(&pool->lock);
+			return s;
+		}
+	}
+
+	LeaveCriticalSection(&pool->lock);
+	return NULL;
+}
+
+static void StreamPool_ClearSizeClass(wStreamPool* pool)
+{
+	UINT32 sizeClass;
+	wStreamPoolEntry* entry;
+	wStreamPoolSizeClasses* sc = pool->sizeClasses;
+
+	for (sizeClass = 0; sizeClass < STREAMPOOL_CLASS_COUNT; sizeClass++)
+	{
+		while ((entry = StreamPool_PopClass(sc, sizeClass)) != NULL)
+		{
+			if (entry->s.isOwner)
+				free(entry->s.buffer);
+
+			entry->s.buffer = entry->s.pointer = NULL;
+			entry->s.capacity = entry->s.length = 0;
+			StreamPool_PushClass(sc, STREAMPOOL_SPARE_CLASS, entry);
+		}
+	}
+}
+
+static void StreamPool_FreeSizeClass(wStreamPool* pool)
+{
+	UINT32 chunk;
+	wStreamPoolSizeClasses* sc = pool->sizeClasses;
+
+	if (!sc)
+		return;
+
+	StreamPool_ClearSizeClass(pool);
+
+	/* streams still in use are lost along with their entries, as with the array mode */
+	for (chunk = 0; chunk < STREAMPOOL_MAX_CHUNKS; chunk++)
+		free(sc->chunks[chunk]);
+
+	free(sc);
+}
+
 /**
  * Gets a stream from the pool.
  */
@@ -149,12 +460,15 @@ wStream* StreamPool_Take(wStreamPool* pool, size_t size)
 	int foundIndex;
 	wStream* s = NULL;
 
-	if (pool->synchronized)
-		EnterCriticalSection(&pool->lock);
-
 	if (size == 0)
 		size = pool->defaultSize;
 
+	if (StreamPool_HasSizeClasses(pool))
+		return StreamPool_TakeSizeClass(pool, size);
+
+	if (pool->synchronized)
+		EnterCriticalSection(&pool->lock);
+
 	foundIndex = -1;
 
 	for (index = 0; index < pool->aSize; index++)
@@ -204,6 +518,12 @@ void StreamPool_Return(wStreamPool* pool, wStream* s)
 	if (!s)
 		return;
 
+	if (StreamPool_HasSizeClasses(pool))
+	{
+		StreamPool_ReturnSizeClass(pool, s);
+		return;
+	}
+
 	if (pool->synchronized)
 		EnterCriticalSection(&pool->lock);
 
@@ -266,6 +586,12 @@ void Stream_AddRef(wStream* s)
 {
 	if (s->pool)
 	{
+		if (StreamPool_HasSizeClasses(s->pool))
+		{
+			InterlockedIncrement((LONG volatile*)&s->count);
+			return;
+		}
+
 		StreamPool_Lock(s->pool);
 		s->count++;
 		StreamPool_Unlock(s->pool);
@@ -282,9 +608,14 @@ void Stream_Release(wStream* s)
 
 	if (s->pool)
 	{
-		StreamPool_Lock(s->pool);
-		count = --(s->count);
-		StreamPool_Unlock(s->pool);
+		if (StreamPool_HasSizeClasses(s->pool))
+			count = (DWORD)InterlockedDecrement((LONG volatile*)&s->count);
+		else
+		{
+			StreamPool_Lock(s->pool);
+			count = --(s->count);
+			StreamPool_Unlock(s->pool);
+		}
 
 		if (count == 0)
 			StreamPool_Return(s->pool, s);
@@ -301,6 +632,9 @@ wStream* StreamPool_Find(wStreamPool* pool, BYTE* ptr)
 	wStream* s = NULL;
 	BOOL found = FALSE;
 
+	if (StreamPool_HasSizeClasses(pool))
+		return StreamPool_FindSizeClass(pool, ptr);
+
 	EnterCriticalSection(&pool->lock);
 
 	for (index = 0; index < pool->uSize; index++)
@@ -353,6 +687,12 @@ void StreamPool_Release(wStreamPool* pool, BYTE* ptr)
 
 void StreamPool_Clear(wStreamPool* pool)
 {
+	if (StreamPool_HasSizeClasses(pool))
+	{
+		StreamPool_ClearSizeClass(pool);
+		return;
+	}
+
 	if (pool->synchronized)
 		EnterCriticalSection(&pool->lock);
 
@@ -371,6 +711,11 @@ void StreamPool_Clear(wStreamPool* pool)
  */
 
 wStreamPool* StreamPool_New(BOOL synchronized, size_t defaultSize)
+{
+	return StreamPool_NewEx(synchronized ? STREAMPOOL_SYNCHRONIZED : 0, defaultSize);
+}
+
+wStreamPool* StreamPool_NewEx(DWORD flags, size_t defaultSize)
 {
 	wStreamPool* pool = NULL;
 
@@ -378,15 +723,29 @@ wStreamPool* StreamPool_New(BOOL synchronized, size_t defaultSize)
 
 	if (pool)
 	{
-		pool->synchronized = synchronized;
+		pool->flags = flags;
+		pool->synchronized = (flags & STREAMPOOL_SYNCHRONIZED) ? TRUE : FALSE;
 		pool->defaultSize = defaultSize;
 
+		if (flags & STREAMPOOL_SIZE_CLASSES)
+		{
+			pool->sizeClasses =
+			    (wStreamPoolSizeClasses*)calloc(1, sizeof(wStreamPoolSizeClasses));
+
+			if (!pool->sizeClasses)
+			{
+				free(pool);
+				return NULL;
+			}
+		}
+
 		pool->aSize = 0;
 		pool->aCapacity = 32;
 		pool->aArray = (wStream**)calloc(pool->aCapacity, sizeof(wStream*));
 
 		if (!pool->aArray)
 		{
+			free(pool->sizeClasses);
 			free(pool);
 			return NULL;
 		}
@@ -398,6 +757,7 @@ wStreamPool* StreamPool_New(BOOL synchronized, size_t defaultSize)
 		if (!pool->uArray)
 		{
 			free(pool->aArray);
+			free(pool->sizeClasses);
 			free(pool);
 			return NULL;
 		}
@@ -413,6 +773,7 @@ void StreamPool_Free(wStreamPool* pool)
 	if (pool)
 	{
 		StreamPool_Clear(pool);
+		StreamPool_FreeSizeClass(pool);
 
 		DeleteCriticalSection(&pool->lock);
 
@@ -1,10 +1,203 @@
 
 #include <winpr/crt.h>
+#include <winpr/synch.h>
+#include <winpr/thread.h>
+#include <winpr/sysinfo.h>
 #include <winpr/stream.h>
 #include <winpr/collections.h>
 
 #define BUFFER_SIZE 16384
 
+#define CONTENTION_THREADS 4
+#define CONTENTION_ITERATIONS 200000
+
+static BOOL test_StreamPoolSizeClasses(void)
+{
+	BYTE* buffer;
+	wStream* s[4];
+	BOOL rc = FALSE;
+	wStreamPool* pool;
+
+	pool = StreamPool_NewEx(STREAMPOOL_SYNCHRONIZED | STREAMPOOL_SIZE_CLASSES, BUFFER_SIZE);
+
+	if (!pool)
+		return FALSE;
+
+	/* sizes are rounded up to the class size */
+	s[0] = StreamPool_Take(pool, 0);
+	s[1] = StreamPool_Take(pool, 1000);
+	s[2] = StreamPool_Take(pool, 1024);
+	s[3] = StreamPool_Take(pool, 1);
+
+	if (!s[0] || !s[1] || !s[2] || !s[3])
+		goto fail;
+
+	if ((Stream_Capacity(s[0]) != BUFFER_SIZE) || (Stream_Capacity(s[1]) != 1024) ||
+	    (Stream_Capacity(s[2]) != 1024) || (Stream_Capacity(s[3]) != 256))
+		goto fail;
+
+	if ((Stream_GetPosition(s[0]) != 0) || (Stream_Length(s[0]) != BUFFER_SIZE))
+		goto fail;
+
+	/* a returned stream is handed out again for its class only */
+	buffer = Stream_Buffer(s[1]);
+	Stream_Seek(s[1], 100);
+	Stream_Release(s[1]);
+	s[1] = StreamPool_Take(pool, 2048);
+
+	if (!s[1] || (Stream_Buffer(s[1]) == buffer))
+		goto fail;
+
+	Stream_Release(s[1]);
+	s[1] = StreamPool_Take(pool, 600);
+
+	if (!s[1] || (Stream_Buffer(s[1]) != buffer) || (Stream_GetPosition(s[1]) != 0))
+		goto fail;
+
+	/* lookup by pointer only finds streams in use */
+	if ((StreamPool_Find(pool, Stream_Buffer(s[2]) + 1023) != s[2]) ||
+	    (StreamPool_Find(pool, Stream_Buffer(s[2]) + 1024) == s[2]))
+		goto fail;
+
+	StreamPool_AddRef(pool, Stream_Buffer(s[2]) + 10);
+	StreamPool_Release(pool, Stream_Buffer(s[2]) + 20);
+
+	if (StreamPool_Find(pool, Stream_Buffer(s[2])) != s[2])
+		goto fail;
+
+	StreamPool_Release(pool, Stream_Buffer(s[2]));
+
+	if (StreamPool_Find(pool, Stream_Buffer(s[2])) != NULL)
+		goto fail;
+
+	/* a stream that grew while in use goes to the class of its new capacity */
+	if (!Stream_EnsureCapacity(s[3], 3000))
+		goto fail;
+
+	buffer = Stream_Buffer(s[3]);
+	Stream_Release(s[3]);
+	s[3] = StreamPool_Take(pool, 4096);
+
+	if (!s[3] || (Stream_Buffer(s[3]) != buffer))
+		goto fail;
+
+	/* streams larger than the biggest class are not kept */
+	Stream_Release(s[3]);
+	s[3] = StreamPool_Take(pool, 64 * 1024 * 1024);
+
+	if (!s[3] || (Stream_Capacity(s[3]) != 64 * 1024 * 1024))
+		goto fail;
+
+	Stream_Release(s[3]);
+	s[3] = StreamPool_Take(pool, 64 * 1024 * 1024);
+
+	if (!s[3])
+		goto fail;
+
+	Stream_Release(s[0]);
+	Stream_Release(s[1]);
+	Stream_Release(s[3]);
+	StreamPool_Clear(pool);
+	rc = TRUE;
+fail:
+	StreamPool_Free(pool);
+	return rc;
+}
+
+struct test_contention
+{
+	wStreamPool* pool;
+	HANDLE start;
+	BOOL failed;
+};
+
+static DWORD WINAPI test_contention_thread(LPVOID arg)
+{
+	size_t index;
+	wStream* s[4];
+	struct test_contention* ctx = (struct test_contention*)arg;
+
+	WaitForSingleObject(ctx->start, INFINITE);
+
+	for (index = 0; index < CONTENTION_ITERATIONS; index++)
+	{
+		size_t x;
+
+		for (x = 0; x < ARRAYSIZE(s); x++)
+		{
+			s[x] = StreamPool_Take(ctx->pool, 512 << ((index + x) % 6));
+
+			if (!s[x])
+			{
+				ctx->failed = TRUE;
+				return 1;
+			}
+
+			Stream_Write_UINT32(s[x], (UINT32)index);
+		}
+
+		Stream_AddRef(s[1]);
+
+		for (x = 0; x < ARRAYSIZE(s); x++)
+			Stream_Release(s[x]);
+
+		Stream_Release(s[1]);
+	}
+
+	return 0;
+}
+
+static BOOL test_StreamPoolContention(DWORD flags, const char* name)
+{
+	size_t index;
+	UINT64 begin, end;
+	BOOL rc = FALSE;
+	HANDLE threads[CONTENTION_THREADS] = { 0 };
+	struct test_contention ctx = { 0 };
+
+	ctx.pool = StreamPool_NewEx(flags, BUFFER_SIZE);
+	ctx.start = CreateEventA(NULL, TRUE, FALSE, NULL);
+
+	if (!ctx.pool || !ctx.start)
+		goto fail;
+
+	for (index = 0; index < ARRAYSIZE(threads); index++)
+	{
+		threads[index] = CreateThread(NULL, 0, test_contention_thread, &ctx, 0, NULL);
+
+		if (!threads[index])
+			goto fail;
+	}
+
+	begin = GetTickCount64();
+	SetEvent(ctx.start);
+
+	for (index = 0; index < ARRAYSIZE(threads); index++)
+		WaitForSingleObject(threads[index], INFINITE);
+
+	end = GetTickCount64();
+	printf("StreamPool contention [%s]: %d threads, %d iterations: %" PRIu64 " ms\n", name,
+	       CONTENTION_THREADS, CONTENTION_ITERATIONS, end - begin);
+	rc = !ctx.failed;
+fail:
+	SetEvent(ctx.start);
+
+	for (index = 0; index < ARRAYSIZE(threads); index++)
+	{
+		if (threads[index])
+		{
+			WaitForSingleObject(threads[index], INFINITE);
+			CloseHandle(threads[index]);
+		}
+	}
+
+	if (ctx.start)
+		CloseHandle(ctx.start);
+
+	StreamPool_Free(ctx.pool);
+	return rc;
+}
+
 int TestStreamPool(int argc, char* argv[])
 {
 	wStream* s[5];
@@ -96,5 +289,15 @@ int TestStreamPool(int argc, char* argv[])
 
 	StreamPool_Free(pool);
 
+	if (!test_StreamPoolSizeClasses())
+		return -1;
+
+	if (!test_StreamPoolContention(STREAMPOOL_SYNCHRONIZED, "synchronized"))
+		return -1;
+
+	if (!test_StreamPoolContention(STREAMPOOL_SYNCHRONIZED | STREAMPOOL_SIZE_CLASSES,
+	                               "size classes"))
+		return -1;
+
 	return 0;
 }